@@ -5,11 +5,18 @@
 #pragma once
 #ifndef ROCKSDB_LITE
 
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "rocksdb/utilities/stackable_db.h"
 #include "rocksdb/db.h"
 
 namespace rocksdb {
 
+class NemoWriteFence;
+
 struct KVOT {
   public:
   Slice key;
@@ -21,6 +28,115 @@ struct KVOT {
   KVOT(const char * k, const char * v, int o, int t) : key(k), val(v), ops(o), ttl(t) {}
 };
 
+// Counters of the per-DB meta (version, timestamp) cache.
+// misses is the number of meta lookups that went down to rocksdb.
+struct NemoMetaCacheStats {
+  uint64_t lookups;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t entries;
+  uint64_t usage;
+  NemoMetaCacheStats() : lookups(0), hits(0), misses(0), evictions(0),
+                         entries(0), usage(0) {}
+};
+
+// Counters of the per-DB row cache, see DBNemo::SetRowCacheCapacity.
+// usage is in bytes, as is the capacity.
+struct NemoRowCacheStats {
+  uint64_t lookups;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  uint64_t entries;
+  uint64_t usage;
+  NemoRowCacheStats() : lookups(0), hits(0), misses(0), evictions(0),
+                        entries(0), usage(0) {}
+};
+
+// State of the per-DB filter of user keys, see DBNemo::EnableKeyFilter.
+// keys counts the adds of keys the filter did not hold yet, capacity the
+// keys it was sized for.
+struct NemoKeyFilterStats {
+  bool ready;
+  uint64_t keys;
+  uint64_t capacity;
+  uint64_t builds;
+  uint64_t usage;
+  NemoKeyFilterStats() : ready(false), keys(0), capacity(0), builds(0),
+                         usage(0) {}
+};
+
+// A column family of a db opened by DBNemo::OpenColumnFamilies, and the
+// meta prefix of the nemo type stored in it
+struct NemoColumnFamilyDescriptor {
+  std::string name;
+  char meta_prefix;
+  ColumnFamilyOptions options;
+  NemoColumnFamilyDescriptor(const std::string& _name, char _meta_prefix,
+                             const ColumnFamilyOptions& _options)
+      : name(_name), meta_prefix(_meta_prefix), options(_options) {}
+};
+
+// The values of DBNemo::BatchGet, in the order of its keys. values[i] points
+// into buffers, so it lives as long as the result and the caller may reuse
+// one result, and its buffers, for batch after batch.
+struct NemoBatchGetResult {
+  std::vector<Slice> values;
+  std::vector<Status> statuses;
+  std::vector<std::string> buffers;
+};
+
+// A sample of the volume of the user keys of one sst file, see
+// DBNemo::GetVolumeSamples
+struct NemoVolumeSample {
+  std::string key;
+  int64_t volume;
+  NemoVolumeSample() : volume(0) {}
+  NemoVolumeSample(const std::string& _key, int64_t _volume)
+      : key(_key), volume(_volume) {}
+};
+
+// The volume samples of the live sst files of a DBNemo, by file name
+typedef std::map<std::string, std::vector<NemoVolumeSample> > NemoVolumeSamples;
+
+// Meta key written by a batch, applied to the meta cache once the batch is in
+struct NemoMetaUpdate {
+  std::string key;
+  bool deleted;
+  uint32_t version;
+  int32_t timestamp;
+};
+
+// The Write variants of DBNemo, by how they version and expire the keys
+enum NemoWriteKind {
+  kNemoWriteTTL,          // Write, arg is the ttl
+  kNemoWriteExpiredTime,  // WriteWithExpiredTime, arg is the expired time
+  kNemoWriteKeyVersion,   // WriteWithKeyVersion
+  kNemoWriteOldKeyTTL     // WriteWithOldKeyTTL
+};
+
+// A batch rewritten by DBNemo::PrepareWrite, with the versions and
+// timestamps of its keys, and the meta keys it writes
+struct NemoPreparedWrite {
+  WriteBatch batch;
+  std::vector<NemoMetaUpdate> meta_updates;
+};
+
+// Reads and writes of the calling thread through the DBNemos, kept as
+// rocksdb::perf_context is: take the counters before and after an
+// operation. gets counts the keys read by Get, MultiGet, BatchGet and
+// GetKeyTTL, but the Gets served by the row cache, meta_gets the meta keys
+// read from rocksdb because the meta cache missed, bytes_written the size of
+// the batches written.
+struct NemoIOContext {
+  uint64_t gets;
+  uint64_t meta_gets;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+};
+NemoIOContext* GetNemoIOContext();
+
 class DBNemo: public StackableDB {
  public:
 
@@ -35,9 +151,19 @@ class DBNemo: public StackableDB {
                      char meta_prefix = '\0',
                      bool read_only = false);
 
+  // Opens all column_families of one db, missing ones are created.
+  // dbptrs gets one DBNemo per column family, in the same order, which
+  // serves it as its default column family. The DBNemos share the WAL,
+  // memtables budget and background threads, the db is closed with the
+  // last of them.
+  static Status OpenColumnFamilies(const DBOptions& db_options,
+      const std::string& dbname,
+      const std::vector<NemoColumnFamilyDescriptor>& column_families,
+      std::vector<DBNemo*>* dbptrs);
+
   using StackableDB::Put;
   virtual Status Put(const WriteOptions& options, const Slice& key, const Slice& val, int32_t ttl) {
-    return Put(options, db_->DefaultColumnFamily(), key, val, ttl);
+    return Put(options, DefaultColumnFamily(), key, val, ttl);
   };
   virtual Status Put(const WriteOptions& options, ColumnFamilyHandle* column_family, const Slice& key, const Slice& val, int32_t ttl) = 0;
 
@@ -48,11 +174,63 @@ class DBNemo: public StackableDB {
   virtual Status PutWithExpiredTime(const WriteOptions& options, const Slice& key, const Slice& val, int32_t expired_time) = 0;
   virtual Status WriteWithExpiredTime(const WriteOptions& opts, WriteBatch* updates, int32_t expired_time) = 0;
   virtual Status PutWithKeyVersion(const WriteOptions& options, const Slice& key, const Slice& val) = 0;
+  // Every key of updates takes one new version, newer than the one of the
+  // meta of the first key, and no ttl: a batch of a meta key and data keys
+  // replaces the whole old value of the user key at once
   virtual Status WriteWithKeyVersion(const WriteOptions& opts, WriteBatch* updates) = 0;
   virtual Status WriteWithOldKeyTTL(const WriteOptions& opts, WriteBatch* updates) = 0;
+  // The two halves of the Write variants: PrepareWrite rewrites updates as
+  // the variant of kind does, reading the versions of the metas but writing
+  // nothing, and WritePrepared writes the batches of writes in one rocksdb
+  // write, then refreshes the caches. The writes of one user key must not
+  // be prepared before the previous ones of that key are written.
+  virtual Status PrepareWrite(NemoWriteKind kind, WriteBatch* updates,
+                              int32_t arg, NemoPreparedWrite* prepared) = 0;
+  virtual Status WritePrepared(const WriteOptions& opts,
+                               const std::vector<NemoPreparedWrite*>& writes) = 0;
   virtual Status GetKeyTTL(const ReadOptions& options, const Slice& key, int32_t *ttl) = 0;
+
+  // Get of many keys by one rocksdb MultiGet, so at one snapshot. The keys
+  // are read in sorted order, and the meta key of the data keys of a user
+  // key is read once, in the same MultiGet, instead of once per data key.
+  virtual void BatchGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                        NemoBatchGetResult* result) = 0;
   virtual void StopAllBackgroundWork(bool wait) = 0;
 
+  // capacity is the max number of cached meta keys, 0 disables the cache
+  virtual void SetMetaCacheCapacity(size_t capacity) = 0;
+  virtual void GetMetaCacheStats(NemoMetaCacheStats* stats) = 0;
+
+  // Keep the values Get reads of the default column family, up to capacity
+  // bytes of keys and values, 0 drops them. The values of the data keys are
+  // checked against the version and timestamp of their meta key on every
+  // hit, so a Del or an expire of a key invalidates its fields, and the
+  // writes refresh the values already cached.
+  virtual void SetRowCacheCapacity(size_t capacity) = 0;
+  virtual void GetRowCacheStats(NemoRowCacheStats* stats) = 0;
+
+  // Keep a bloom filter of the user keys of the db, bits_per_key bits each,
+  // 0 drops it. A background scan of the meta keys, of all keys for kv,
+  // builds it, every write adds its keys before reaching rocksdb, and it is
+  // rebuilt larger once twice the keys it was sized for were added.
+  virtual void EnableKeyFilter(int bits_per_key) = 0;
+  // false only if the db held no user_key since the filter was built,
+  // always true while there is no filter
+  virtual bool UserKeyMayExist(const Slice& user_key) = 0;
+  virtual void GetKeyFilterStats(NemoKeyFilterStats* stats) = 0;
+
+  // The samples of the sst files, by file name, each one holding the volume
+  // of the user keys of its file after the previous sample up to its user
+  // key included, see NemoVolumeCollector. The memtables are not sampled.
+  // The files already in files are not read again and the ones no longer
+  // live are dropped, so that the caller keeps files from call to call;
+  // changed tells whether any file came or went.
+  virtual Status GetVolumeSamples(NemoVolumeSamples* files, bool* changed) = 0;
+
+  // The writes of the db hold fence read locked, see NemoWriteFence. Set
+  // before the first write.
+  virtual void SetWriteFence(const std::shared_ptr<NemoWriteFence>& fence) = 0;
+
  protected:
   explicit DBNemo(DB* db) : StackableDB(db) {}
 };
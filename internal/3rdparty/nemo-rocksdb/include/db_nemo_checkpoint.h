@@ -29,9 +29,12 @@ class DBNemoCheckpoint {
   // The directory will be an absolute path
   virtual Status CreateCheckpoint(const std::string& checkpoint_dir) = 0;
 
+  // Without flush_memtable the memtables are left to the WAL files, of
+  // which the last one is copied up to its size at this call, so that a
+  // checkpoint holds the db as of this call even if written after it
   virtual Status GetCheckpointFiles(std::vector<std::string> &live_files,
       VectorLogPtr &live_wal_files, uint64_t &manifest_file_size,
-      uint64_t &sequence_number) = 0;
+      uint64_t &sequence_number, bool flush_memtable = true) = 0;
 
   virtual Status CreateCheckpointWithFiles(const std::string& checkpoint_dir,
       std::vector<std::string> &live_files, VectorLogPtr &live_wal_files,
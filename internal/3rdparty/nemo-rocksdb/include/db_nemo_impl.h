@@ -5,10 +5,20 @@
 #pragma once
 #ifndef ROCKSDB_LITE
 
+#include <atomic>
+#include <list>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include "db_nemo.h"
 #include "db/db_impl.h"
+#include "port/port.h"
 
 #include "rocksdb/merge_operator.h"
+#include "rocksdb/table_properties.h"
+#include "util/coding.h"
 
 #ifdef _WIN32
 // Windows API macro interference
@@ -29,12 +39,255 @@ const char kMetaPrefixRaft = '\0';
 class NemoCompactionFilter;
 class NemoCompactionFilterFactory;
 
+// Bounded, sharded LRU cache of meta key -> (version, timestamp) of a DBNemo,
+// so that the write handlers, Get, the iterator and the compaction filter
+// don't need a rocksdb Get of the meta key for every data key they touch.
+// Missing meta keys are cached too, as a new key is looked up several times
+// before its first write.
+//
+// Writers refresh the entries of the meta keys they wrote after db->Write
+// returns; writes to one meta key are expected to be serialized by the
+// caller (nemo's record locks). Readers fill the cache after a miss only if
+// no writer touched the shard in the meantime, see Lookup and Insert.
+class NemoMetaCache {
+ public:
+  typedef NemoMetaUpdate Update;
+
+  static const size_t kDefaultCapacity = 256 * 1024;
+
+  explicit NemoMetaCache(size_t capacity = kDefaultCapacity);
+
+  // Returns true on hit. On miss *epoch is set, and must be passed to the
+  // Insert of the value read from rocksdb.
+  bool Lookup(const Slice& meta_key, bool* found, uint32_t* version,
+              int32_t* timestamp, uint64_t* epoch);
+  // Drops the value if the shard was modified since Lookup returned epoch
+  void Insert(const Slice& meta_key, uint64_t epoch, bool found,
+              uint32_t version, int32_t timestamp);
+  void Refresh(const Slice& meta_key, uint32_t version, int32_t timestamp);
+  void Erase(const Slice& meta_key);
+  void Clear();
+
+  void SetCapacity(size_t capacity);
+  void GetStats(NemoMetaCacheStats* stats);
+
+ private:
+  static const int kNumShardBits = 4;
+  static const int kNumShards = 1 << kNumShardBits;
+
+  struct Entry {
+    std::string key;
+    bool found;
+    uint32_t version;
+    int32_t timestamp;
+  };
+
+  struct SliceHasher {
+    size_t operator()(const Slice& s) const;
+  };
+
+  typedef std::list<Entry> LRUList;
+  typedef std::unordered_map<Slice, LRUList::iterator, SliceHasher> Index;
+
+  struct Shard {
+    port::Mutex mu;
+    // most recently used first, index keys point into the list entries
+    LRUList lru;
+    Index index;
+    uint64_t epoch;
+    size_t usage;
+    Shard() : epoch(0), usage(0) {}
+  };
+
+  Shard* GetShard(const Slice& meta_key);
+  void SetLocked(Shard* shard, const Slice& meta_key, bool found,
+                 uint32_t version, int32_t timestamp);
+  void EraseLocked(Shard* shard, const Index::iterator& it);
+  static size_t Charge(const Entry& entry);
+
+  Shard shards_[kNumShards];
+  std::atomic<size_t> shard_capacity_;
+  std::atomic<uint64_t> lookups_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> evictions_;
+
+  // No copying allowed
+  NemoMetaCache(const NemoMetaCache&);
+  void operator=(const NemoMetaCache&);
+};
+
+// Bounded, sharded LRU cache of key -> value as stored, with its version
+// and timestamp, of the Gets of a DBNemo, charged by the bytes of the keys
+// and values. Get checks a hit as it checks a value read from rocksdb, so
+// the data keys of an older version than their meta, or expired, are not
+// found, without the writes of the meta having to know its data keys.
+//
+// As for NemoMetaCache, writers refresh the keys they wrote after db->Write
+// returns, and readers fill the cache after a miss only if no writer touched
+// the shard in the meantime. The writes update the keys already cached and
+// leave the others out, so that a write only workload does not evict the
+// hot values.
+class NemoRowCache {
+ public:
+  explicit NemoRowCache(size_t capacity = 0);
+
+  bool enabled() const {
+    return shard_capacity_.load(std::memory_order_relaxed) > 0;
+  }
+  // Returns true on hit. On miss *epoch is set, and must be passed to the
+  // Insert of the value read from rocksdb.
+  bool Lookup(const Slice& key, std::string* value, uint64_t* epoch);
+  // Drops the value if the shard was modified since Lookup returned epoch
+  void Insert(const Slice& key, uint64_t epoch, const Slice& value);
+  // Updates the value of key if it is cached
+  void Refresh(const Slice& key, const Slice& value);
+  void Erase(const Slice& key);
+  void Clear();
+
+  void SetCapacity(size_t capacity);
+  void GetStats(NemoRowCacheStats* stats);
+
+ private:
+  static const int kNumShardBits = 4;
+  static const int kNumShards = 1 << kNumShardBits;
+
+  struct Entry {
+    std::string key;
+    std::string value;
+  };
+
+  struct SliceHasher {
+    size_t operator()(const Slice& s) const;
+  };
+
+  typedef std::list<Entry> LRUList;
+  typedef std::unordered_map<Slice, LRUList::iterator, SliceHasher> Index;
+
+  struct Shard {
+    port::Mutex mu;
+    // most recently used first, index keys point into the list entries
+    LRUList lru;
+    Index index;
+    uint64_t epoch;
+    size_t usage;
+    Shard() : epoch(0), usage(0) {}
+  };
+
+  Shard* GetShard(const Slice& key);
+  void EvictLocked(Shard* shard, size_t capacity);
+  void EraseLocked(Shard* shard, const Index::iterator& it);
+  static size_t Charge(const Entry& entry);
+
+  Shard shards_[kNumShards];
+  std::atomic<size_t> shard_capacity_;
+  std::atomic<uint64_t> lookups_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> misses_;
+  std::atomic<uint64_t> evictions_;
+
+  // No copying allowed
+  NemoRowCache(const NemoRowCache&);
+  void operator=(const NemoRowCache&);
+};
+
+// Blocked bloom filter of user keys: a key sets num_probes bits of one 64
+// byte block, so a probe reads one cache line. Bits are set and read
+// atomically, adds and probes run without a lock. Keys are never removed,
+// the filter is rebuilt instead.
+class NemoKeyFilter {
+ public:
+  static const uint64_t kMinKeys = 64 * 1024;
+
+  NemoKeyFilter(uint64_t expected_keys, int bits_per_key);
+
+  // Returns true if the filter did not hold user_key yet
+  bool Add(const Slice& user_key);
+  bool MayContain(const Slice& user_key) const;
+
+  uint64_t keys() const { return keys_.load(std::memory_order_relaxed); }
+  uint64_t capacity() const { return capacity_; }
+  size_t usage() const { return num_blocks_ * kBlockBytes; }
+
+ private:
+  static const int kBlockBytes = 64;
+  static const int kBlockWords = kBlockBytes / 8;
+
+  uint64_t capacity_;
+  uint64_t num_blocks_;
+  int num_probes_;
+  std::unique_ptr<std::atomic<uint64_t>[]> words_;
+  std::atomic<uint64_t> keys_;
+
+  std::atomic<uint64_t>* Block(uint32_t h) const;
+
+  // No copying allowed
+  NemoKeyFilter(const NemoKeyFilter&);
+  void operator=(const NemoKeyFilter&);
+};
+
+// Shared by the DBNemos of one nemo instance. Their writes hold it read
+// locked, so that while Close holds it write locked none of the dbs takes a
+// write, and what the dbs hold at that point is one state of the instance,
+// which their checkpoints keep.
+class NemoWriteFence {
+ public:
+  // Holds fence, if any, read locked for the scope of one write
+  class Writer {
+   public:
+    explicit Writer(NemoWriteFence* fence) : fence_(fence) {
+      if (fence_ != nullptr) {
+        fence_->rw_.ReadLock();
+      }
+    }
+    ~Writer() {
+      if (fence_ != nullptr) {
+        fence_->rw_.ReadUnlock();
+      }
+    }
+
+   private:
+    NemoWriteFence* fence_;
+  };
+
+  NemoWriteFence() {}
+
+  // Waits for the writes in flight and blocks the next ones until Open
+  void Close() { rw_.WriteLock(); }
+  void Open() { rw_.WriteUnlock(); }
+
+ private:
+  port::RWMutex rw_;
+
+  // No copying allowed
+  NemoWriteFence(const NemoWriteFence&);
+  void operator=(const NemoWriteFence&);
+};
+
+// Base db of the DBNemos opened by DBNemo::OpenColumnFamilies, each of them
+// holds a reference and the db is closed with the last one
+struct NemoSharedDB {
+  DB* db;
+  std::vector<ColumnFamilyHandle*> handles;
+  // NemoCompactionFilters wrapping the user's, see SanitizeOptions
+  std::vector<const CompactionFilter*> compaction_filters;
+
+  NemoSharedDB() : db(nullptr) {}
+  ~NemoSharedDB();
+};
+
 class DBNemoImpl : public DBNemo {
  public:
-  static void SanitizeOptions(ColumnFamilyOptions* options,
-                              Env* env, char meta_prefix);
+  // Returns the compaction filter factory installed in options, nullptr if
+  // the user set a compaction filter. It must be bound to the opened column
+  // family with SetDBAndMP before compactions are enabled.
+  static NemoCompactionFilterFactory* SanitizeOptions(
+      ColumnFamilyOptions* options, Env* env, char meta_prefix);
 
   explicit DBNemoImpl(DB* db, char meta_prefix);
+  // Serves column_family of shared->db as if it was the default one
+  DBNemoImpl(const std::shared_ptr<NemoSharedDB>& shared,
+             ColumnFamilyHandle* column_family, char meta_prefix);
 
   virtual ~DBNemoImpl();
 
@@ -72,6 +325,12 @@ class DBNemoImpl : public DBNemo {
                            std::string* value,
                            bool* value_found = nullptr) override;
 
+  // Goes to the base db like in StackableDB, inside the write fence
+  using StackableDB::Delete;
+  virtual Status Delete(const WriteOptions& options,
+                        ColumnFamilyHandle* column_family,
+                        const Slice& key) override;
+
   using StackableDB::Merge;
   virtual Status Merge(const WriteOptions& options,
                        ColumnFamilyHandle* column_family, const Slice& key,
@@ -99,20 +358,73 @@ class DBNemoImpl : public DBNemo {
   using DBNemo::WriteWithOldKeyTTL;
   virtual Status WriteWithOldKeyTTL(const WriteOptions& opts, WriteBatch* updates) override;
 
+  virtual Status PrepareWrite(NemoWriteKind kind, WriteBatch* updates,
+                              int32_t arg, NemoPreparedWrite* prepared) override;
+  virtual Status WritePrepared(const WriteOptions& opts,
+                               const std::vector<NemoPreparedWrite*>& writes) override;
+
   using DBNemo::GetKeyTTL;
   virtual Status GetKeyTTL(const ReadOptions& options, const Slice& key, int32_t *ttl) override;
 
+  using DBNemo::BatchGet;
+  virtual void BatchGet(const ReadOptions& options, const std::vector<Slice>& keys,
+                        NemoBatchGetResult* result) override;
+
   using StackableDB::NewIterator;
   virtual Iterator* NewIterator(const ReadOptions& opts,
                                 ColumnFamilyHandle* column_family) override;
 
+  // Goes to the base db, as the handlers of Write know no range deletes,
+  // and drops the cached metas, which may be under the range
+  virtual Status DeleteRange(const WriteOptions& options,
+                             ColumnFamilyHandle* column_family,
+                             const Slice& begin_key,
+                             const Slice& end_key) override;
+
+  using StackableDB::IngestExternalFile;
+  virtual Status IngestExternalFile(
+      ColumnFamilyHandle* column_family,
+      const std::vector<std::string>& external_files,
+      const IngestExternalFileOptions& options) override;
+
   using DBNemo::StopAllBackgroundWork;
   virtual void StopAllBackgroundWork(bool wait) override;
 
+  virtual void SetMetaCacheCapacity(size_t capacity) override;
+  virtual void GetMetaCacheStats(NemoMetaCacheStats* stats) override;
+  virtual void SetRowCacheCapacity(size_t capacity) override;
+  virtual void GetRowCacheStats(NemoRowCacheStats* stats) override;
+
+  virtual void EnableKeyFilter(int bits_per_key) override;
+  virtual bool UserKeyMayExist(const Slice& user_key) override;
+  virtual void GetKeyFilterStats(NemoKeyFilterStats* stats) override;
+  virtual Status GetVolumeSamples(NemoVolumeSamples* files,
+                                  bool* changed) override;
+  virtual void SetWriteFence(
+      const std::shared_ptr<NemoWriteFence>& fence) override {
+    write_fence_ = fence;
+  }
+
   virtual DB* GetBaseDB() override { return db_; }
 
-  static bool GetVersionAndTS(DB* db, char meta_prefix,
-         const Slice& key, uint32_t* version, int32_t* timestamp);
+  // The column family bound by OpenColumnFamilies, so that the calls
+  // without a column family, and the batches written to the default one,
+  // go to it
+  virtual ColumnFamilyHandle* DefaultColumnFamily() const override {
+    return column_family_ != nullptr ? column_family_ : db_->DefaultColumnFamily();
+  }
+
+  // nullptr for kv, meta and raft db, which have no meta keys
+  const std::shared_ptr<NemoMetaCache>& meta_cache() const { return meta_cache_; }
+
+  // column_family nullptr means the default column family of db
+  static bool GetVersionAndTS(DB* db, ColumnFamilyHandle* column_family,
+         char meta_prefix, const Slice& key, uint32_t* version,
+         int32_t* timestamp, NemoMetaCache* meta_cache = nullptr);
+
+  static bool GetMetaVersionAndTS(DB* db, ColumnFamilyHandle* column_family,
+         const Slice& meta_key, uint32_t* version, int32_t* timestamp,
+         NemoMetaCache* meta_cache);
 
   static Status SanityCheckTimestamp(const Slice& str, Env* env);
 
@@ -138,16 +450,63 @@ class DBNemoImpl : public DBNemo {
   static const uint32_t kTSLength = sizeof(int32_t);  // size of timestamp
   static const uint32_t kVersionLength = sizeof(uint32_t);  // size of version
  private:
+  Status WriteAndRefreshMetaCache(const WriteOptions& opts, WriteBatch* batch,
+                                  const std::vector<NemoMetaCache::Update>& updates);
+  // Refreshes the cached rows batch wrote, or drops them if the write failed
+  void RefreshRowCache(WriteBatch* batch, bool written);
+  // The rewrites of the Write variants, see PrepareWrite
+  Status PrepareWithTTL(WriteBatch* updates, int32_t ttl,
+                        NemoPreparedWrite* prepared);
+  Status PrepareWithExpiredTime(WriteBatch* updates, int32_t expired_time,
+                                NemoPreparedWrite* prepared);
+  Status PrepareWithKeyVersion(WriteBatch* updates, NemoPreparedWrite* prepared);
+  Status PrepareWithOldKeyTTL(WriteBatch* updates, NemoPreparedWrite* prepared);
+
+  // Adds the user keys batch puts to the key filters, with key_filter_rw_
+  // read locked up to the write, returns true if the filter is overfull
+  bool AddToKeyFilter(WriteBatch* batch);
+  void ScheduleKeyFilterBuild();
+  // Runs on key_filter_thread_
+  void BuildKeyFilter();
+  Status BuildKeyFilterOnce(int bits_per_key);
+  void SeekUserKeys(Iterator* it);
+  bool IsUserKeyEntry(const Slice& key, Slice* user_key);
+
   char meta_prefix_;
+  std::shared_ptr<NemoMetaCache> meta_cache_;
+  std::unique_ptr<NemoRowCache> row_cache_;
+  // Set only for the DBNemos of OpenColumnFamilies
+  std::shared_ptr<NemoSharedDB> shared_db_;
+  ColumnFamilyHandle* column_family_;
+  std::shared_ptr<NemoWriteFence> write_fence_;
+
+  // The filter of the probes, changed by std::atomic_store, and the one
+  // being built. Writers hold key_filter_rw_ read locked from the add of
+  // their keys to the end of their write, so the build sees every write
+  // either in its scan or as an add.
+  std::shared_ptr<NemoKeyFilter> key_filter_;
+  std::shared_ptr<NemoKeyFilter> building_filter_;
+  port::RWMutex key_filter_rw_;
+  // Guards key_filter_thread_
+  port::Mutex key_filter_mu_;
+  std::thread key_filter_thread_;
+  std::atomic<int> key_filter_bits_;
+  // Bumped by IngestExternalFile, a build that saw it change starts over
+  std::atomic<uint64_t> key_filter_epoch_;
+  std::atomic<uint64_t> key_filter_builds_;
+  std::atomic<bool> key_filter_building_;
+  std::atomic<bool> shutting_down_;
 };
 
 class NemoIterator : public Iterator {
 
  public:
   explicit NemoIterator(Iterator* iter, Env* env, DB* db,
-                        char meta_prefix)
+                        char meta_prefix, NemoMetaCache* meta_cache = nullptr,
+                        ColumnFamilyHandle* column_family = nullptr)
     : iter_(iter), env_(env),
-      db_(db), meta_prefix_(meta_prefix),
+      db_(db), column_family_(column_family), meta_prefix_(meta_prefix),
+      meta_cache_(meta_cache),
       version_(0),
       timestamp_(0) { assert(iter_); }
 
@@ -243,7 +602,9 @@ class NemoIterator : public Iterator {
   Iterator* iter_;
   Env* env_;
   DB* db_;
+  ColumnFamilyHandle* column_family_;
   char meta_prefix_;
+  NemoMetaCache* meta_cache_;
   std::string user_key_;
   uint32_t version_;
   int32_t timestamp_;
@@ -286,7 +647,7 @@ class NemoIterator : public Iterator {
 
     if (user_key != user_key_) {
       user_key_ = user_key;
-      DBNemoImpl::GetVersionAndTS(db_, meta_prefix_, iter_->key(), &version_, &timestamp_);
+      DBNemoImpl::GetVersionAndTS(db_, column_family_, meta_prefix_, iter_->key(), &version_, &timestamp_, meta_cache_);
 //      std::cout << "Update Meta, meta_version: " << version_ << " meta_TS: " << timestamp_ << std::endl;
     }
 
@@ -306,11 +667,15 @@ class NemoCompactionFilter : public CompactionFilter {
       Env* env, const CompactionFilter* user_comp_filter,
       DB* db, char meta_prefix,
       std::unique_ptr<const CompactionFilter> user_comp_filter_from_factory =
-          nullptr)
+          nullptr,
+      NemoMetaCache* meta_cache = nullptr,
+      ColumnFamilyHandle* column_family = nullptr)
       : env_(env),
         user_comp_filter_(user_comp_filter),
         db_(db),
+        column_family_(column_family),
         meta_prefix_(meta_prefix),
+        meta_cache_(meta_cache),
         version_(0), timestamp_(0),
         find_meta_(true),
         user_comp_filter_from_factory_(
@@ -352,12 +717,22 @@ class NemoCompactionFilter : public CompactionFilter {
   Env* env_;
   const CompactionFilter* user_comp_filter_;
   DB* db_;
+  ColumnFamilyHandle* column_family_;
   char meta_prefix_;
+  NemoMetaCache* meta_cache_;
   mutable std::string user_key_;
   mutable uint32_t version_;
   mutable int32_t timestamp_;
   mutable bool find_meta_;
   std::unique_ptr<const CompactionFilter> user_comp_filter_from_factory_;
+
+  // The meta key is going away, the cached version must not outlive it
+  void DropCachedMeta(const Slice& meta_key) const {
+    if (meta_cache_ != nullptr) {
+      meta_cache_->Erase(meta_key);
+    }
+  }
+
   bool ShouldDrop(const Slice& key, const Slice& old_val) const {
 
     uint32_t ver;
@@ -399,6 +774,7 @@ class NemoCompactionFilter : public CompactionFilter {
 
       if (meta_timestamp != 0 && meta_timestamp < curtime) {
 //        std::cout << "meta_key: " <<key.ToString() << " timestamp: " << meta_timestamp << ", curtime: " << curtime << " Drop" << std::endl;
+        DropCachedMeta(key);
         return true;
       }
 
@@ -409,6 +785,7 @@ class NemoCompactionFilter : public CompactionFilter {
       }
       if (meta_version < curtime) {
 //        std::cout << "meta_key: " <<key.ToString() << " version: " << meta_version << " timestamp: " << meta_timestamp << " curtime: " << curtime << " Drop" << std::endl;
+        DropCachedMeta(key);
         return true;
       }
       return false;
@@ -424,7 +801,7 @@ class NemoCompactionFilter : public CompactionFilter {
 
     if (user_key != user_key_) {
       user_key_ = user_key;
-      find_meta_ = DBNemoImpl::GetVersionAndTS(db_, meta_prefix_, key, &version_, &timestamp_);
+      find_meta_ = DBNemoImpl::GetVersionAndTS(db_, column_family_, meta_prefix_, key, &version_, &timestamp_, meta_cache_);
 //      std::cout << "Update meta, meta_version: " << version_ << " meta_TS: " << timestamp_ << std::endl;
     }
 
@@ -446,7 +823,7 @@ class NemoCompactionFilterFactory : public CompactionFilterFactory {
       std::shared_ptr<CompactionFilterFactory> comp_filter_factory,
       DB* db, char meta_prefix)
       : env_(env), user_comp_filter_factory_(comp_filter_factory),
-        db_(db), meta_prefix_(meta_prefix) {}
+        db_(db), column_family_(nullptr), meta_prefix_(meta_prefix) {}
 
   virtual std::unique_ptr<CompactionFilter> CreateCompactionFilter(
       const CompactionFilter::Context& context) override {
@@ -458,23 +835,159 @@ class NemoCompactionFilterFactory : public CompactionFilterFactory {
     }
 
     return std::unique_ptr<NemoCompactionFilter>(new NemoCompactionFilter(
-        env_, nullptr, db_, meta_prefix_, std::move(user_comp_filter_from_factory)));
+        env_, nullptr, db_, meta_prefix_, std::move(user_comp_filter_from_factory),
+        meta_cache_.get(), column_family_));
   }
 
   virtual const char* Name() const override {
     return "NemoCompactionFilterFactory";
   }
   
-  void SetDBAndMP(DB* db, char meta_prefix) const {
+  // column_family is the one this factory was installed in, its meta keys
+  // are read from there
+  void SetDBAndMP(DB* db, ColumnFamilyHandle* column_family, char meta_prefix,
+                  std::shared_ptr<NemoMetaCache> meta_cache = nullptr) const {
     db_ = db;
+    column_family_ = column_family;
     meta_prefix_ = meta_prefix;
+    meta_cache_ = meta_cache;
   }
 
  private:
   Env* env_;
   std::shared_ptr<CompactionFilterFactory> user_comp_filter_factory_;
   mutable DB* db_;
+  mutable ColumnFamilyHandle* column_family_;
   mutable char meta_prefix_;
+  // shared with DBNemoImpl, compactions may still hold it on close
+  mutable std::shared_ptr<NemoMetaCache> meta_cache_;
+};
+
+// Samples the volume of the user keys of an sst file the way nemo's
+// VolumeIterator counts it: key and value of a kv, the vol of the meta value
+// of the other types, nothing for data keys and for the keys an iterator
+// would skip. A sample is recorded once sample_bytes of volume were added
+// since the previous one, at the user key that reached it, so that the
+// volume up to any key is known within sample_bytes per file plus the volume
+// of one user key. See DBNemo::GetVolumeSamples.
+class NemoVolumeCollector : public TablePropertiesCollector {
+ public:
+  static const char* kPropertyName;
+
+  NemoVolumeCollector(Env* env, char meta_prefix, int64_t sample_bytes)
+    : env_(env), meta_prefix_(meta_prefix), sample_bytes_(sample_bytes),
+      volume_(0), total_(0), samples_num_(0) {}
+
+  virtual Status AddUserKey(const Slice& key, const Slice& value,
+                            EntryType type, SequenceNumber seq,
+                            uint64_t file_size) override {
+    // The entries of a key come newest first
+    if (key == last_key_) {
+      return Status::OK();
+    }
+    last_key_.assign(key.data(), key.size());
+    if (type != kEntryPut ||
+        value.size() < DBNemoImpl::kVersionLength + DBNemoImpl::kTSLength) {
+      return Status::OK();
+    }
+    int32_t timestamp = DecodeFixed32(value.data() + value.size() -
+                                      DBNemoImpl::kTSLength);
+    if (DBNemoImpl::IsStale(timestamp, env_)) {
+      return Status::OK();
+    }
+
+    size_t value_size = value.size() - DBNemoImpl::kVersionLength -
+                        DBNemoImpl::kTSLength;
+    int64_t volume;
+    if (meta_prefix_ == kMetaPrefixKv) {
+      volume = key.size() + value_size;
+    } else if (key.size() > 1 && key[0] == meta_prefix_ &&
+               value_size >= 2 * sizeof(int64_t)) {
+      int64_t len, vol;
+      memcpy(&len, value.data(), sizeof(int64_t));
+      memcpy(&vol, value.data() + sizeof(int64_t), sizeof(int64_t));
+      if (len <= 0 || vol <= 0) {
+        return Status::OK();
+      }
+      volume = vol;
+    } else {
+      return Status::OK();
+    }
+
+    volume_ += volume;
+    if (volume_ >= sample_bytes_) {
+      AddSample();
+    }
+    return Status::OK();
+  }
+
+  virtual Status Finish(UserCollectedProperties* properties) override {
+    if (volume_ > 0) {
+      AddSample();
+    }
+    properties->insert({kPropertyName, samples_});
+    return Status::OK();
+  }
+
+  virtual UserCollectedProperties GetReadableProperties() const override {
+    return UserCollectedProperties{
+        {"nemo.volume.total", std::to_string(total_)},
+        {"nemo.volume.samples_num", std::to_string(samples_num_)}};
+  }
+
+  virtual const char* Name() const override { return "NemoVolumeCollector"; }
+
+  // Decodes the kPropertyName property of a file
+  static bool DecodeSamples(const Slice& property,
+                            std::vector<NemoVolumeSample>* samples);
+
+ private:
+  // Encoded as varint32 key size, user key, varint64 volume
+  void AddSample() {
+    Slice user_key(last_key_);
+    if (meta_prefix_ != kMetaPrefixKv) {
+      user_key.remove_prefix(1);
+    }
+    PutVarint32(&samples_, user_key.size());
+    samples_.append(user_key.data(), user_key.size());
+    PutVarint64(&samples_, volume_);
+    total_ += volume_;
+    samples_num_++;
+    volume_ = 0;
+  }
+
+  Env* env_;
+  char meta_prefix_;
+  int64_t sample_bytes_;
+  std::string last_key_;
+  int64_t volume_;
+  int64_t total_;
+  uint64_t samples_num_;
+  std::string samples_;
+};
+
+class NemoVolumeCollectorFactory : public TablePropertiesCollectorFactory {
+ public:
+  // 256 samples of a 64MB sst file of kv
+  static const int64_t kDefaultSampleBytes = 256 << 10;
+
+  NemoVolumeCollectorFactory(Env* env, char meta_prefix,
+                             int64_t sample_bytes = kDefaultSampleBytes)
+    : env_(env), meta_prefix_(meta_prefix), sample_bytes_(sample_bytes) {}
+
+  virtual TablePropertiesCollector* CreateTablePropertiesCollector(
+      TablePropertiesCollectorFactory::Context context) override {
+    return new NemoVolumeCollector(env_, meta_prefix_, sample_bytes_);
+  }
+
+  virtual const char* Name() const override {
+    return "NemoVolumeCollectorFactory";
+  }
+
+ private:
+  Env* env_;
+  char meta_prefix_;
+  int64_t sample_bytes_;
 };
 
 class NemoMergeOperator : public MergeOperator {
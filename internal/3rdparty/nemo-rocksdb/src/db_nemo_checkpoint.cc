@@ -46,7 +46,7 @@ class DBNemoCheckpointImpl : public DBNemoCheckpoint {
   using DBNemoCheckpoint::GetCheckpointFiles;
   virtual Status GetCheckpointFiles(std::vector<std::string> &live_files,
       VectorLogPtr &live_wal_files, uint64_t &manifest_file_size,
-      uint64_t &sequence_number) override;
+      uint64_t &sequence_number, bool flush_memtable = true) override;
 
   using DBNemoCheckpoint::CreateCheckpointWithFiles;
   virtual Status CreateCheckpointWithFiles(const std::string& checkpoint_dir,
@@ -80,7 +80,7 @@ Status DBNemoCheckpointImpl::CreateCheckpoint(const std::string& checkpoint_dir)
 
 Status DBNemoCheckpointImpl::GetCheckpointFiles(std::vector<std::string> &live_files,
     VectorLogPtr &live_wal_files, uint64_t &manifest_file_size,
-    uint64_t &sequence_number) {
+    uint64_t &sequence_number, bool flush_memtable) {
 
   Status s;
   sequence_number = db_->GetLatestSequenceNumber();
@@ -88,7 +88,7 @@ Status DBNemoCheckpointImpl::GetCheckpointFiles(std::vector<std::string> &live_f
   s = db_->DisableFileDeletions();
   if (s.ok()) {
     // this will return live_files prefixed with "/"
-    s = db_->GetLiveFiles(live_files, &manifest_file_size);
+    s = db_->GetLiveFiles(live_files, &manifest_file_size, flush_memtable);
   }
 
   // if we have more than one column family, we need to also get WAL files
@@ -185,10 +185,11 @@ Status DBNemoCheckpointImpl::CreateCheckpointWithFiles(const std::string& checkp
       live_wal_files.size());
 
   // Link WAL files. Copy exact size of last one because it is the only one
-  // that has changes after the last flush.
+  // that has changes after the last flush. All the alive ones are taken, as
+  // without a flush the older ones may hold what the memtables hold, and
+  // the recovery skips what was flushed already.
   for (size_t i = 0; s.ok() && i < wal_size; ++i) {
-    if ((live_wal_files[i]->Type() == kAliveLogFile) &&
-        (live_wal_files[i]->StartSequence() >= sequence_number)) {
+    if (live_wal_files[i]->Type() == kAliveLogFile) {
       if (i + 1 == wal_size) {
         Log(db_->GetOptions().info_log, "Copying %s",
             live_wal_files[i]->PathName().c_str());
@@ -6,36 +6,486 @@
 #include "db_nemo_impl.h"
 
 #include "rocksdb/convenience.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
 
+#include <algorithm>
 #include <iostream>
 namespace rocksdb {
 
-static NemoCompactionFilter* g_compaction_filter = nullptr;
-static NemoCompactionFilterFactory* g_compaction_filter_factory = nullptr;
+// The handlers rewrite batches built without a column family, into the one
+// the DBNemo is bound to
+static inline uint32_t BoundID(ColumnFamilyHandle* bound,
+                               uint32_t column_family_id) {
+  return column_family_id == 0 ? bound->GetID() : column_family_id;
+}
+
+static inline bool HasMetaKey(char meta_prefix) {
+  return meta_prefix != kMetaPrefixKv && meta_prefix != kMetaPrefixMeta &&
+         meta_prefix != kMetaPrefixRaft;
+}
+
+// Remember the meta keys a batch writes, the cache is refreshed after Write
+static void TrackMetaPut(char meta_prefix, const Slice& key,
+                         const std::string& value_with_ver_ts,
+                         std::vector<NemoMetaCache::Update>* updates) {
+  if (!HasMetaKey(meta_prefix) || key.size() == 0 || key[0] != meta_prefix) {
+    return;
+  }
+  NemoMetaCache::Update update;
+  update.key.assign(key.data(), key.size());
+  update.deleted = !DBNemoImpl::ExtractVersionAndTS(value_with_ver_ts,
+                       &update.version, &update.timestamp).ok();
+  updates->push_back(update);
+}
+
+static void TrackMetaDelete(char meta_prefix, const Slice& key,
+                            std::vector<NemoMetaCache::Update>* updates) {
+  if (!HasMetaKey(meta_prefix) || key.size() == 0 || key[0] != meta_prefix) {
+    return;
+  }
+  NemoMetaCache::Update update;
+  update.key.assign(key.data(), key.size());
+  update.deleted = true;
+  update.version = 0;
+  update.timestamp = 0;
+  updates->push_back(update);
+}
+
+size_t NemoMetaCache::SliceHasher::operator()(const Slice& s) const {
+  return Hash(s.data(), s.size(), 0x9e3779b9);
+}
+
+NemoMetaCache::NemoMetaCache(size_t capacity)
+  : shard_capacity_((capacity + kNumShards - 1) / kNumShards),
+    lookups_(0), hits_(0), misses_(0), evictions_(0) {}
+
+NemoMetaCache::Shard* NemoMetaCache::GetShard(const Slice& meta_key) {
+  uint32_t hash = Hash(meta_key.data(), meta_key.size(), 0);
+  return &shards_[hash >> (32 - kNumShardBits)];
+}
+
+size_t NemoMetaCache::Charge(const Entry& entry) {
+  // list node, hash node and the key itself
+  return sizeof(Entry) + 2 * sizeof(void*) + sizeof(Slice) +
+         sizeof(LRUList::iterator) + 2 * sizeof(void*) + entry.key.capacity();
+}
+
+bool NemoMetaCache::Lookup(const Slice& meta_key, bool* found,
+                           uint32_t* version, int32_t* timestamp,
+                           uint64_t* epoch) {
+  lookups_.fetch_add(1, std::memory_order_relaxed);
+  Shard* shard = GetShard(meta_key);
+  {
+    MutexLock l(&shard->mu);
+    Index::iterator it = shard->index.find(meta_key);
+    if (it != shard->index.end()) {
+      shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+      *found = it->second->found;
+      *version = it->second->version;
+      *timestamp = it->second->timestamp;
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    *epoch = shard->epoch;
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void NemoMetaCache::Insert(const Slice& meta_key, uint64_t epoch, bool found,
+                           uint32_t version, int32_t timestamp) {
+  Shard* shard = GetShard(meta_key);
+  MutexLock l(&shard->mu);
+  if (shard->epoch != epoch) {
+    // a writer got in between our Get and now, the value may be stale
+    return;
+  }
+  SetLocked(shard, meta_key, found, version, timestamp);
+}
+
+void NemoMetaCache::Refresh(const Slice& meta_key, uint32_t version,
+                            int32_t timestamp) {
+  Shard* shard = GetShard(meta_key);
+  MutexLock l(&shard->mu);
+  shard->epoch++;
+  SetLocked(shard, meta_key, true, version, timestamp);
+}
+
+void NemoMetaCache::Erase(const Slice& meta_key) {
+  Shard* shard = GetShard(meta_key);
+  MutexLock l(&shard->mu);
+  shard->epoch++;
+  Index::iterator it = shard->index.find(meta_key);
+  if (it != shard->index.end()) {
+    EraseLocked(shard, it);
+  }
+}
+
+void NemoMetaCache::Clear() {
+  for (int i = 0; i < kNumShards; i++) {
+    MutexLock l(&shards_[i].mu);
+    shards_[i].epoch++;
+    shards_[i].index.clear();
+    shards_[i].lru.clear();
+    shards_[i].usage = 0;
+  }
+}
+
+void NemoMetaCache::SetCapacity(size_t capacity) {
+  shard_capacity_.store((capacity + kNumShards - 1) / kNumShards,
+                        std::memory_order_relaxed);
+  for (int i = 0; i < kNumShards; i++) {
+    Shard* shard = &shards_[i];
+    MutexLock l(&shard->mu);
+    while (shard->index.size() > shard_capacity_.load(std::memory_order_relaxed)) {
+      EraseLocked(shard, shard->index.find(Slice(shard->lru.back().key)));
+      evictions_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+void NemoMetaCache::GetStats(NemoMetaCacheStats* stats) {
+  stats->lookups = lookups_.load(std::memory_order_relaxed);
+  stats->hits = hits_.load(std::memory_order_relaxed);
+  stats->misses = misses_.load(std::memory_order_relaxed);
+  stats->evictions = evictions_.load(std::memory_order_relaxed);
+  stats->entries = 0;
+  stats->usage = sizeof(NemoMetaCache);
+  for (int i = 0; i < kNumShards; i++) {
+    MutexLock l(&shards_[i].mu);
+    stats->entries += shards_[i].index.size();
+    stats->usage += shards_[i].usage;
+  }
+}
+
+void NemoMetaCache::SetLocked(Shard* shard, const Slice& meta_key, bool found,
+                              uint32_t version, int32_t timestamp) {
+  size_t capacity = shard_capacity_.load(std::memory_order_relaxed);
+  Index::iterator it = shard->index.find(meta_key);
+  if (it != shard->index.end()) {
+    it->second->found = found;
+    it->second->version = version;
+    it->second->timestamp = timestamp;
+    shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+    return;
+  }
+  if (capacity == 0) {
+    return;
+  }
+  while (shard->index.size() >= capacity) {
+    EraseLocked(shard, shard->index.find(Slice(shard->lru.back().key)));
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  Entry entry;
+  entry.key.assign(meta_key.data(), meta_key.size());
+  entry.found = found;
+  entry.version = version;
+  entry.timestamp = timestamp;
+  shard->lru.push_front(entry);
+  shard->index[Slice(shard->lru.front().key)] = shard->lru.begin();
+  shard->usage += Charge(shard->lru.front());
+}
+
+void NemoMetaCache::EraseLocked(Shard* shard, const Index::iterator& it) {
+  LRUList::iterator entry = it->second;
+  shard->usage -= Charge(*entry);
+  shard->index.erase(it);
+  shard->lru.erase(entry);
+}
+
+size_t NemoRowCache::SliceHasher::operator()(const Slice& s) const {
+  return Hash(s.data(), s.size(), 0x9e3779b9);
+}
+
+NemoRowCache::NemoRowCache(size_t capacity)
+  : shard_capacity_((capacity + kNumShards - 1) / kNumShards),
+    lookups_(0), hits_(0), misses_(0), evictions_(0) {}
+
+NemoRowCache::Shard* NemoRowCache::GetShard(const Slice& key) {
+  uint32_t hash = Hash(key.data(), key.size(), 0);
+  return &shards_[hash >> (32 - kNumShardBits)];
+}
+
+size_t NemoRowCache::Charge(const Entry& entry) {
+  // list node, hash node, the key and the value
+  return sizeof(Entry) + 2 * sizeof(void*) + sizeof(Slice) +
+         sizeof(LRUList::iterator) + 2 * sizeof(void*) +
+         entry.key.capacity() + entry.value.capacity();
+}
+
+bool NemoRowCache::Lookup(const Slice& key, std::string* value,
+                          uint64_t* epoch) {
+  lookups_.fetch_add(1, std::memory_order_relaxed);
+  Shard* shard = GetShard(key);
+  {
+    MutexLock l(&shard->mu);
+    Index::iterator it = shard->index.find(key);
+    if (it != shard->index.end()) {
+      shard->lru.splice(shard->lru.begin(), shard->lru, it->second);
+      value->assign(it->second->value);
+      hits_.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    *epoch = shard->epoch;
+  }
+  misses_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+void NemoRowCache::Insert(const Slice& key, uint64_t epoch,
+                          const Slice& value) {
+  Shard* shard = GetShard(key);
+  MutexLock l(&shard->mu);
+  size_t capacity = shard_capacity_.load(std::memory_order_relaxed);
+  if (shard->epoch != epoch || capacity == 0) {
+    // a writer got in between our Get and now, the value may be stale
+    return;
+  }
+  Index::iterator it = shard->index.find(key);
+  if (it != shard->index.end()) {
+    // filled by another reader of the same epoch, so the same value
+    return;
+  }
+  Entry entry;
+  entry.key.assign(key.data(), key.size());
+  entry.value.assign(value.data(), value.size());
+  size_t charge = Charge(entry);
+  if (charge > capacity) {
+    return;
+  }
+  EvictLocked(shard, capacity - charge);
+  shard->lru.push_front(Entry());
+  shard->lru.front().key.swap(entry.key);
+  shard->lru.front().value.swap(entry.value);
+  shard->index[Slice(shard->lru.front().key)] = shard->lru.begin();
+  shard->usage += charge;
+}
+
+void NemoRowCache::Refresh(const Slice& key, const Slice& value) {
+  Shard* shard = GetShard(key);
+  MutexLock l(&shard->mu);
+  shard->epoch++;
+  Index::iterator it = shard->index.find(key);
+  if (it == shard->index.end()) {
+    return;
+  }
+  LRUList::iterator entry = it->second;
+  shard->usage -= Charge(*entry);
+  entry->value.assign(value.data(), value.size());
+  shard->usage += Charge(*entry);
+  shard->lru.splice(shard->lru.begin(), shard->lru, entry);
+  // a larger value may take the shard over its capacity, and even be
+  // evicted itself
+  EvictLocked(shard, shard_capacity_.load(std::memory_order_relaxed));
+}
+
+void NemoRowCache::Erase(const Slice& key) {
+  Shard* shard = GetShard(key);
+  MutexLock l(&shard->mu);
+  shard->epoch++;
+  Index::iterator it = shard->index.find(key);
+  if (it != shard->index.end()) {
+    EraseLocked(shard, it);
+  }
+}
+
+void NemoRowCache::Clear() {
+  for (int i = 0; i < kNumShards; i++) {
+    MutexLock l(&shards_[i].mu);
+    shards_[i].epoch++;
+    shards_[i].index.clear();
+    shards_[i].lru.clear();
+    shards_[i].usage = 0;
+  }
+}
+
+// The writes skip the cache while it is disabled, so the epochs are bumped
+// for the lookups which started before to not fill it with what they read
+void NemoRowCache::SetCapacity(size_t capacity) {
+  shard_capacity_.store((capacity + kNumShards - 1) / kNumShards,
+                        std::memory_order_relaxed);
+  for (int i = 0; i < kNumShards; i++) {
+    Shard* shard = &shards_[i];
+    MutexLock l(&shard->mu);
+    shard->epoch++;
+    EvictLocked(shard, shard_capacity_.load(std::memory_order_relaxed));
+  }
+}
+
+void NemoRowCache::GetStats(NemoRowCacheStats* stats) {
+  stats->lookups = lookups_.load(std::memory_order_relaxed);
+  stats->hits = hits_.load(std::memory_order_relaxed);
+  stats->misses = misses_.load(std::memory_order_relaxed);
+  stats->evictions = evictions_.load(std::memory_order_relaxed);
+  stats->entries = 0;
+  stats->usage = sizeof(NemoRowCache);
+  for (int i = 0; i < kNumShards; i++) {
+    MutexLock l(&shards_[i].mu);
+    stats->entries += shards_[i].index.size();
+    stats->usage += shards_[i].usage;
+  }
+}
+
+// Evicts the least recently used entries until the shard holds at most
+// capacity bytes
+void NemoRowCache::EvictLocked(Shard* shard, size_t capacity) {
+  while (shard->usage > capacity && !shard->lru.empty()) {
+    EraseLocked(shard, shard->index.find(Slice(shard->lru.back().key)));
+    evictions_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void NemoRowCache::EraseLocked(Shard* shard, const Index::iterator& it) {
+  LRUList::iterator entry = it->second;
+  shard->usage -= Charge(*entry);
+  shard->index.erase(it);
+  shard->lru.erase(entry);
+}
 
-void DBNemoImpl::SanitizeOptions(ColumnFamilyOptions* options,
-                                    Env* env, char meta_prefix) {
+NemoKeyFilter::NemoKeyFilter(uint64_t expected_keys, int bits_per_key)
+  : capacity_(std::max(expected_keys, kMinKeys)), keys_(0) {
+  num_blocks_ = (capacity_ * bits_per_key + kBlockBytes * 8 - 1) / (kBlockBytes * 8);
+  // ln(2) * bits per key probes give the fewest false positives
+  num_probes_ = std::min(std::max(bits_per_key * 69 / 100, 1), 16);
+  words_.reset(new std::atomic<uint64_t>[num_blocks_ * kBlockWords]);
+  for (uint64_t i = 0; i < num_blocks_ * kBlockWords; i++) {
+    words_[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+std::atomic<uint64_t>* NemoKeyFilter::Block(uint32_t h) const {
+  return &words_[((uint64_t)h * num_blocks_ >> 32) * kBlockWords];
+}
+
+bool NemoKeyFilter::Add(const Slice& user_key) {
+  std::atomic<uint64_t>* block = Block(Hash(user_key.data(), user_key.size(), 0xbc9f1d34));
+  uint32_t h = Hash(user_key.data(), user_key.size(), 0x9e3779b9);
+  uint32_t delta = (h >> 17) | (h << 15);
+  bool added = false;
+  for (int i = 0; i < num_probes_; i++, h += delta) {
+    uint32_t bit = h % (kBlockBytes * 8);
+    uint64_t mask = 1ull << (bit % 64);
+    if ((block[bit / 64].fetch_or(mask, std::memory_order_release) & mask) == 0) {
+      added = true;
+    }
+  }
+  if (added) {
+    keys_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return added;
+}
+
+bool NemoKeyFilter::MayContain(const Slice& user_key) const {
+  std::atomic<uint64_t>* block = Block(Hash(user_key.data(), user_key.size(), 0xbc9f1d34));
+  uint32_t h = Hash(user_key.data(), user_key.size(), 0x9e3779b9);
+  uint32_t delta = (h >> 17) | (h << 15);
+  for (int i = 0; i < num_probes_; i++, h += delta) {
+    uint32_t bit = h % (kBlockBytes * 8);
+    if ((block[bit / 64].load(std::memory_order_acquire) & (1ull << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+NemoCompactionFilterFactory* DBNemoImpl::SanitizeOptions(
+    ColumnFamilyOptions* options, Env* env, char meta_prefix) {
+  NemoCompactionFilterFactory* factory = nullptr;
   if (options->compaction_filter) {
-    options->compaction_filter = g_compaction_filter = 
+    options->compaction_filter =
         new NemoCompactionFilter(env, options->compaction_filter, nullptr, meta_prefix);
   } else {
-    g_compaction_filter_factory = new NemoCompactionFilterFactory(
+    factory = new NemoCompactionFilterFactory(
      env, options->compaction_filter_factory, nullptr, meta_prefix);
     options->compaction_filter_factory =
-        std::shared_ptr<CompactionFilterFactory>(g_compaction_filter_factory);
+        std::shared_ptr<CompactionFilterFactory>(factory);
   }
 
   if (options->merge_operator) {
     options->merge_operator.reset(
         new NemoMergeOperator(options->merge_operator, env));
   }
+
+  options->table_properties_collector_factories.push_back(
+      std::make_shared<NemoVolumeCollectorFactory>(env, meta_prefix));
+  return factory;
+}
+
+const char* NemoVolumeCollector::kPropertyName = "nemo.volume.samples";
+
+bool NemoVolumeCollector::DecodeSamples(const Slice& property,
+                                        std::vector<NemoVolumeSample>* samples) {
+  Slice input = property;
+  uint32_t key_size;
+  uint64_t volume;
+  while (!input.empty()) {
+    if (!GetVarint32(&input, &key_size) || input.size() < key_size) {
+      return false;
+    }
+    NemoVolumeSample sample;
+    sample.key.assign(input.data(), key_size);
+    input.remove_prefix(key_size);
+    if (!GetVarint64(&input, &volume)) {
+      return false;
+    }
+    sample.volume = volume;
+    samples->push_back(sample);
+  }
+  return true;
+}
+
+NemoSharedDB::~NemoSharedDB() {
+  if (db != nullptr) {
+    // Need to stop background compaction before getting rid of the filters
+    CancelAllBackgroundWork(db, /* wait = */ true);
+    for (auto handle : handles) {
+      delete handle;
+    }
+    delete db;
+  }
+  for (auto filter : compaction_filters) {
+    delete filter;
+  }
 }
 
 // Open the db inside DBNemoImpl because options needs pointer to its ttl
 DBNemoImpl::DBNemoImpl(DB* db, char meta_prefix) :
-  DBNemo(db), meta_prefix_(meta_prefix) {}
+  DBNemo(db), meta_prefix_(meta_prefix), column_family_(nullptr),
+  key_filter_bits_(0), key_filter_epoch_(0), key_filter_builds_(0),
+  key_filter_building_(false), shutting_down_(false) {
+  if (HasMetaKey(meta_prefix_)) {
+    meta_cache_.reset(new NemoMetaCache());
+  }
+  row_cache_.reset(new NemoRowCache());
+}
+
+DBNemoImpl::DBNemoImpl(const std::shared_ptr<NemoSharedDB>& shared,
+    ColumnFamilyHandle* column_family, char meta_prefix) :
+  DBNemo(shared->db), meta_prefix_(meta_prefix), shared_db_(shared),
+  column_family_(column_family), key_filter_bits_(0), key_filter_epoch_(0),
+  key_filter_builds_(0), key_filter_building_(false), shutting_down_(false) {
+  if (HasMetaKey(meta_prefix_)) {
+    meta_cache_.reset(new NemoMetaCache());
+  }
+  row_cache_.reset(new NemoRowCache());
+}
 
 DBNemoImpl::~DBNemoImpl() {
+  shutting_down_ = true;
+  {
+    MutexLock l(&key_filter_mu_);
+    if (key_filter_thread_.joinable()) {
+      key_filter_thread_.join();
+    }
+  }
+  if (shared_db_ != nullptr) {
+    // The base db and the column family handles belong to shared_db_,
+    // keep StackableDB from deleting the db
+    db_ = nullptr;
+    return;
+  }
   // Need to stop background compaction before getting rid of the filter
   CancelAllBackgroundWork(db_, /* wait = */ true);
   delete GetOptions().compaction_filter;
@@ -69,11 +519,12 @@ Status DBNemo::Open(
 
   std::vector<ColumnFamilyDescriptor> column_families_sanitized =
       column_families;
+  std::vector<NemoCompactionFilterFactory*> factories;
   for (size_t i = 0; i < column_families_sanitized.size(); ++i) {
-    DBNemoImpl::SanitizeOptions(
+    factories.push_back(DBNemoImpl::SanitizeOptions(
         &column_families_sanitized[i].options,
         db_options.env == nullptr ? Env::Default() : db_options.env,
-        meta_prefix);
+        meta_prefix));
   }
   DB* db;
 
@@ -85,8 +536,15 @@ Status DBNemo::Open(
     st = DB::Open(db_options, dbname, column_families_sanitized, handles, &db);
   }
   if (st.ok()) {
-    *dbptr = new DBNemoImpl(db, meta_prefix);
-    g_compaction_filter_factory->SetDBAndMP(db, meta_prefix);
+    DBNemoImpl* impl = new DBNemoImpl(db, meta_prefix);
+    *dbptr = impl;
+    // meta keys are read from the default column family, whose handle the
+    // caller may delete
+    for (auto factory : factories) {
+      if (factory != nullptr) {
+        factory->SetDBAndMP(db, nullptr, meta_prefix, impl->meta_cache());
+      }
+    }
     db->EnableAutoCompaction(*handles);
   } else {
     *dbptr = nullptr;
@@ -94,14 +552,69 @@ Status DBNemo::Open(
   return st;
 }
 
+Status DBNemo::OpenColumnFamilies(const DBOptions& db_options,
+    const std::string& dbname,
+    const std::vector<NemoColumnFamilyDescriptor>& column_families,
+    std::vector<DBNemo*>* dbptrs) {
+  dbptrs->clear();
+
+  DBOptions options = db_options;
+  options.create_missing_column_families = true;
+  Env* env = options.env == nullptr ? Env::Default() : options.env;
+
+  std::vector<ColumnFamilyDescriptor> column_families_sanitized;
+  std::vector<NemoCompactionFilterFactory*> factories;
+  for (const auto& cf : column_families) {
+    ColumnFamilyOptions cf_options = cf.options;
+    // Enabled once the compaction filters know their column family
+    cf_options.disable_auto_compactions = true;
+    factories.push_back(
+        DBNemoImpl::SanitizeOptions(&cf_options, env, cf.meta_prefix));
+    column_families_sanitized.push_back(
+        ColumnFamilyDescriptor(cf.name, cf_options));
+  }
+
+  std::shared_ptr<NemoSharedDB> shared(new NemoSharedDB);
+  for (const auto& cf : column_families_sanitized) {
+    if (cf.options.compaction_filter != nullptr) {
+      shared->compaction_filters.push_back(cf.options.compaction_filter);
+    }
+  }
+  Status st = DB::Open(options, dbname, column_families_sanitized,
+                       &shared->handles, &shared->db);
+  if (!st.ok()) {
+    return st;
+  }
+
+  for (size_t i = 0; i < column_families.size(); ++i) {
+    DBNemoImpl* impl = new DBNemoImpl(shared, shared->handles[i],
+                                      column_families[i].meta_prefix);
+    if (factories[i] != nullptr) {
+      factories[i]->SetDBAndMP(shared->db, shared->handles[i],
+                               column_families[i].meta_prefix,
+                               impl->meta_cache());
+    }
+    dbptrs->push_back(impl);
+  }
+
+  shared->db->EnableAutoCompaction(shared->handles);
+  return st;
+}
+
 Status DBNemoImpl::CreateColumnFamily(const ColumnFamilyOptions& options,
                                          const std::string& column_family_name,
                                          ColumnFamilyHandle** handle) {
   ColumnFamilyOptions sanitized_options = options;
-  DBNemoImpl::SanitizeOptions(&sanitized_options, GetEnv(), meta_prefix_);
-
-  return DBNemo::CreateColumnFamily(sanitized_options, column_family_name,
-                                       handle);
+  NemoCompactionFilterFactory* factory =
+      DBNemoImpl::SanitizeOptions(&sanitized_options, GetEnv(), meta_prefix_);
+
+  Status s = DBNemo::CreateColumnFamily(sanitized_options, column_family_name,
+                                        handle);
+  if (s.ok() && factory != nullptr) {
+    // the meta cache only follows the writes to column_family_
+    factory->SetDBAndMP(db_, *handle, meta_prefix_);
+  }
+  return s;
 }
 
 // Returns corruption if the length of the string is lesser than timestamp
@@ -192,12 +705,31 @@ Status DBNemoImpl::Put(const WriteOptions& options, ColumnFamilyHandle* column_f
   return Write(options, &batch, ttl);
 }
 
+static thread_local NemoIOContext io_context;
+
+NemoIOContext* GetNemoIOContext() {
+  return &io_context;
+}
+
 Status DBNemoImpl::Get(const ReadOptions& options,
     ColumnFamilyHandle* column_family, const Slice& key,
     std::string* value) {
-  Status st = db_->Get(options, column_family, key, value);
-  if (!st.ok()) {
-    return st;
+  // The cache holds the latest values of the column family the DBNemo is
+  // bound to only
+  bool cached = row_cache_->enabled() && options.snapshot == nullptr &&
+                column_family->GetID() == DefaultColumnFamily()->GetID();
+  uint64_t epoch = 0;
+  Status st;
+  if (!cached || !row_cache_->Lookup(key, value, &epoch)) {
+    io_context.gets++;
+    st = db_->Get(options, column_family, key, value);
+    if (!st.ok()) {
+      return st;
+    }
+    io_context.bytes_read += value->size();
+    if (cached && options.fill_cache) {
+      row_cache_->Insert(key, epoch, *value);
+    }
   }
   st = SanityCheckVersionAndTS(key, *value);
   if (!st.ok()) {
@@ -211,19 +743,118 @@ std::vector<Status> DBNemoImpl::MultiGet(
     const std::vector<ColumnFamilyHandle*>& column_family,
     const std::vector<Slice>& keys, std::vector<std::string>* values) {
   auto statuses = db_->MultiGet(options, column_family, keys, values);
+  io_context.gets += keys.size();
   for (size_t i = 0; i < keys.size(); ++i) {
     if (!statuses[i].ok()) {
       continue;
     }
-    statuses[i] = SanityCheckTimestamp((*values)[i], db_->GetEnv());
+    io_context.bytes_read += (*values)[i].size();
+    // as Get does, the timestamp alone left the version on the value and
+    // let the data of a deleted key through
+    statuses[i] = SanityCheckVersionAndTS(keys[i], (*values)[i]);
     if (!statuses[i].ok()) {
       continue;
     }
-    statuses[i] = StripTS(&(*values)[i]);
+    statuses[i] = StripVersionAndTS(&(*values)[i]);
   }
   return statuses;
 }
 
+void DBNemoImpl::BatchGet(const ReadOptions& options,
+    const std::vector<Slice>& keys, NemoBatchGetResult* result) {
+  const size_t n = keys.size();
+  std::vector<size_t> order(n);
+  for (size_t i = 0; i < n; ++i) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+    return keys[a].compare(keys[b]) < 0;
+  });
+
+  // The data keys of a user key sort together, so that each meta key is
+  // only added once after the keys, read back at lookups[n + meta_of[i]]
+  std::vector<Slice> lookups;
+  lookups.reserve(n + 1);
+  std::vector<std::string> meta_keys;
+  std::vector<int> meta_of(n, -1);
+  Slice last_user_key;
+  for (size_t i = 0; i < n; ++i) {
+    const Slice& key = keys[order[i]];
+    lookups.push_back(key);
+    if (!HasMetaKey(meta_prefix_) || key.size() < 2 || key[0] == meta_prefix_) {
+      continue;
+    }
+    size_t len = static_cast<uint8_t>(key[1]);
+    if (key.size() < 2 + len) {
+      continue;
+    }
+    Slice user_key(key.data() + 2, len);
+    if (meta_keys.empty() || user_key.compare(last_user_key) != 0) {
+      meta_keys.push_back(std::string(1, meta_prefix_));
+      meta_keys.back().append(user_key.data(), user_key.size());
+      last_user_key = user_key;
+    }
+    meta_of[i] = static_cast<int>(meta_keys.size()) - 1;
+  }
+  for (size_t j = 0; j < meta_keys.size(); ++j) {
+    lookups.push_back(meta_keys[j]);
+  }
+
+  std::vector<Status> statuses = db_->MultiGet(options,
+      std::vector<ColumnFamilyHandle*>(lookups.size(), DefaultColumnFamily()),
+      lookups, &result->buffers);
+  io_context.gets += n;
+  io_context.meta_gets += meta_keys.size();
+  for (size_t i = 0; i < lookups.size(); ++i) {
+    io_context.bytes_read += result->buffers[i].size();
+  }
+
+  std::vector<bool> meta_found(meta_keys.size(), false);
+  std::vector<uint32_t> meta_version(meta_keys.size(), 0);
+  std::vector<int32_t> meta_timestamp(meta_keys.size(), 0);
+  for (size_t j = 0; j < meta_keys.size(); ++j) {
+    uint32_t version;
+    int32_t timestamp;
+    if (statuses[n + j].ok() &&
+        ExtractVersionAndTS(result->buffers[n + j], &version, &timestamp).ok()) {
+      meta_found[j] = true;
+      meta_version[j] = version;
+      meta_timestamp[j] = timestamp;
+    }
+  }
+
+  int64_t curtime;
+  // Treat the data as fresh if could not get current time
+  bool has_time = GetEnv()->GetCurrentTime(&curtime).ok();
+  result->values.assign(n, Slice());
+  result->statuses.assign(n, Status::OK());
+  for (size_t i = 0; i < n; ++i) {
+    Status st = statuses[i];
+    const std::string& value = result->buffers[i];
+    if (st.ok() && value.size() < kVersionLength + kTSLength) {
+      st = Status::Corruption("Bad version-timestamp in key-value");
+    }
+    if (st.ok()) {
+      int32_t timestamp = DecodeFixed32(value.data() + value.size() - kTSLength);
+      int j = meta_of[i];
+      if (j >= 0 && meta_found[j]) {
+        uint32_t version = DecodeFixed32(value.data() + value.size() - kTSLength - kVersionLength);
+        if (version < meta_version[j]) {
+          st = Status::NotFound("old version\n");
+        }
+        timestamp = meta_timestamp[j];
+      }
+      if (st.ok() && has_time && timestamp > 0 && timestamp < curtime) {
+        st = Status::NotFound("Is stale");
+      }
+    }
+    if (st.ok()) {
+      result->values[order[i]] = Slice(value.data(), value.size() - kVersionLength - kTSLength);
+    }
+    result->statuses[order[i]] = st;
+  }
+}
+
 bool DBNemoImpl::KeyMayExist(const ReadOptions& options,
     ColumnFamilyHandle* column_family,
     const Slice& key, std::string* value,
@@ -262,22 +893,36 @@ Status DBNemoImpl::Write(const WriteOptions& opts, WriteBatch* updates) {
 }
 
 Status DBNemoImpl::Write(const WriteOptions& opts, WriteBatch* updates, int32_t ttl) {
+  NemoPreparedWrite prepared;
+  Status s = PrepareWithTTL(updates, ttl, &prepared);
+  if (!s.ok()) {
+    return s;
+  }
+  return WriteAndRefreshMetaCache(opts, &prepared.batch, prepared.meta_updates);
+}
+
+Status DBNemoImpl::PrepareWithTTL(WriteBatch* updates, int32_t ttl,
+                                  NemoPreparedWrite* prepared) {
   class Handler : public WriteBatch::Handler {
    public:
     DBImpl* db_;
     WriteBatch updates_ttl;
     Status batch_rewrite_status;
+    std::vector<NemoMetaCache::Update> meta_updates;
 
-    explicit Handler(Env* env, int32_t ttl, DB* db, char meta_prefix)
+    explicit Handler(Env* env, int32_t ttl, DB* db,
+                     ColumnFamilyHandle* column_family, char meta_prefix,
+                     NemoMetaCache* meta_cache)
         : db_(reinterpret_cast<DBImpl*>(db)), env_(env), ttl_(ttl),
-          meta_prefix_(meta_prefix) {}
+          column_family_(column_family), meta_prefix_(meta_prefix),
+          meta_cache_(meta_cache) {}
 
     virtual Status PutCF(uint32_t column_family_id, const Slice& key,
                          const Slice& value) override {
       std::string value_with_ver_ts;
       uint32_t version;
       int32_t timestamp;
-      GetVersionAndTS(db_, meta_prefix_, key, &version, &timestamp);
+      GetVersionAndTS(db_, column_family_, meta_prefix_, key, &version, &timestamp, meta_cache_);
 
 //      std::cout << "Write, prefix: " << meta_prefix_ << " key: " << key.ToString() << " value: " << value.ToString() <<  " version: " << version << " timestamp: " << timestamp << std::endl;
 
@@ -286,8 +931,9 @@ Status DBNemoImpl::Write(const WriteOptions& opts, WriteBatch* updates, int32_t
       if (!st.ok()) {
         batch_rewrite_status = st;
       } else {
-        WriteBatchInternal::Put(&updates_ttl, column_family_id, key,
+        WriteBatchInternal::Put(&updates_ttl, BoundID(column_family_, column_family_id), key,
                                 value_with_ver_ts);
+        TrackMetaPut(meta_prefix_, key, value_with_ver_ts, &meta_updates);
       }
       return Status::OK();
     }
@@ -299,14 +945,16 @@ Status DBNemoImpl::Write(const WriteOptions& opts, WriteBatch* updates, int32_t
       if (!st.ok()) {
         batch_rewrite_status = st;
       } else {
-        WriteBatchInternal::Merge(&updates_ttl, column_family_id, key,
+        WriteBatchInternal::Merge(&updates_ttl, BoundID(column_family_, column_family_id), key,
                                   value_with_ver_ts);
+        TrackMetaDelete(meta_prefix_, key, &meta_updates);
       }
       return Status::OK();
     }
     virtual Status DeleteCF(uint32_t column_family_id,
                             const Slice& key) override {
-      WriteBatchInternal::Delete(&updates_ttl, column_family_id, key);
+      WriteBatchInternal::Delete(&updates_ttl, BoundID(column_family_, column_family_id), key);
+      TrackMetaDelete(meta_prefix_, key, &meta_updates);
       return Status::OK();
     }
     virtual void LogData(const Slice& blob) override {
@@ -316,17 +964,21 @@ Status DBNemoImpl::Write(const WriteOptions& opts, WriteBatch* updates, int32_t
    private:
     Env* env_;
     int32_t ttl_;
+    ColumnFamilyHandle* column_family_;
     char meta_prefix_;
+    NemoMetaCache* meta_cache_;
   };
   //@ADD assign the db pointer
-  Handler handler(GetEnv(), ttl, db_, meta_prefix_);
+  Handler handler(GetEnv(), ttl, db_, DefaultColumnFamily(), meta_prefix_,
+                  meta_cache_.get());
 
   updates->Iterate(&handler);
   if (!handler.batch_rewrite_status.ok()) {
     return handler.batch_rewrite_status;
-  } else {
-    return db_->Write(opts, &(handler.updates_ttl));
   }
+  prepared->batch = std::move(handler.updates_ttl);
+  prepared->meta_updates.swap(handler.meta_updates);
+  return Status::OK();
 }
 
 Status DBNemoImpl::WriteBatchTtl(const WriteOptions& opts, std::vector<KVOT>& kvots) {
@@ -334,18 +986,20 @@ Status DBNemoImpl::WriteBatchTtl(const WriteOptions& opts, std::vector<KVOT>& kv
    public:
     DBImpl* db_;
     WriteBatch updates_ttl;
-    explicit Handler(Env* env, DB* db, char meta_prefix)
-        : db_(reinterpret_cast<DBImpl*>(db)), env_(env),meta_prefix_(meta_prefix) {}
+    explicit Handler(Env* env, DB* db, ColumnFamilyHandle* column_family,
+                     char meta_prefix)
+        : db_(reinterpret_cast<DBImpl*>(db)), env_(env),
+          column_family_(column_family), meta_prefix_(meta_prefix) {}
 
     virtual Status PutCF(uint32_t column_family_id, const Slice& key,
                          const Slice& value) override {
 
-      WriteBatchInternal::Put(&updates_ttl, column_family_id, key, value);
+      WriteBatchInternal::Put(&updates_ttl, BoundID(column_family_, column_family_id), key, value);
       return Status::OK();
     }
     virtual Status DeleteCF(uint32_t column_family_id,
                             const Slice& key) override {
-      WriteBatchInternal::Delete(&updates_ttl, column_family_id, key);
+      WriteBatchInternal::Delete(&updates_ttl, BoundID(column_family_, column_family_id), key);
       return Status::OK();
     }
     virtual void LogData(const Slice& blob) override {
@@ -355,11 +1009,13 @@ Status DBNemoImpl::WriteBatchTtl(const WriteOptions& opts, std::vector<KVOT>& kv
    private:
     Env* env_;
     int32_t ttl_;
+    ColumnFamilyHandle* column_family_;
     char meta_prefix_;
   };
   //@ADD assign the db pointer
 
   WriteBatch updates;
+  std::vector<NemoMetaCache::Update> meta_updates;
   Env* env = GetEnv();
   for (auto & kvot : kvots){
     switch (kvot.ops) {
@@ -370,7 +1026,7 @@ Status DBNemoImpl::WriteBatchTtl(const WriteOptions& opts, std::vector<KVOT>& kv
         std::string value_with_ver_ts;
         uint32_t version;
         int32_t timestamp;
-        GetVersionAndTS(db_, meta_prefix_, kvot.key, &version, &timestamp);
+        GetVersionAndTS(db_, DefaultColumnFamily(), meta_prefix_, kvot.key, &version, &timestamp, meta_cache_.get());
         Status st = AppendVersionAndTS(kvot.val, &value_with_ver_ts, env, version, kvot.ttl);
         /*
         std::cout << "kvot \n";
@@ -383,11 +1039,13 @@ Status DBNemoImpl::WriteBatchTtl(const WriteOptions& opts, std::vector<KVOT>& kv
           return st;
         } else{
           updates.Put(kvot.key,value_with_ver_ts);
+          TrackMetaPut(meta_prefix_, kvot.key, value_with_ver_ts, &meta_updates);
         }
         break;
       }
       case 1:{
         updates.Delete(kvot.key);
+        TrackMetaDelete(meta_prefix_, kvot.key, &meta_updates);
         break;
       }
       default:
@@ -395,29 +1053,43 @@ Status DBNemoImpl::WriteBatchTtl(const WriteOptions& opts, std::vector<KVOT>& kv
     }
   }
 
-  Handler handler(env, db_, meta_prefix_);
+  Handler handler(env, db_, DefaultColumnFamily(), meta_prefix_);
   updates.Iterate(&handler);
-  return db_->Write(opts, &(handler.updates_ttl));
+  return WriteAndRefreshMetaCache(opts, &(handler.updates_ttl), meta_updates);
 
 }
 
 Status DBNemoImpl::WriteWithExpiredTime(const WriteOptions& opts, WriteBatch* updates, int32_t expired_time) {
+  NemoPreparedWrite prepared;
+  Status s = PrepareWithExpiredTime(updates, expired_time, &prepared);
+  if (!s.ok()) {
+    return s;
+  }
+  return WriteAndRefreshMetaCache(opts, &prepared.batch, prepared.meta_updates);
+}
+
+Status DBNemoImpl::PrepareWithExpiredTime(WriteBatch* updates,
+    int32_t expired_time, NemoPreparedWrite* prepared) {
   class Handler : public WriteBatch::Handler {
    public:
     DBImpl* db_;
     WriteBatch updates_ttl;
     Status batch_rewrite_status;
+    std::vector<NemoMetaCache::Update> meta_updates;
 
-    explicit Handler(Env* env, DB* db, char meta_prefix, int32_t expired_time)
+    explicit Handler(Env* env, DB* db, ColumnFamilyHandle* column_family,
+                     char meta_prefix, int32_t expired_time,
+                     NemoMetaCache* meta_cache)
         : db_(reinterpret_cast<DBImpl*>(db)), env_(env),
-          expired_time_(expired_time), meta_prefix_(meta_prefix) {}
+          expired_time_(expired_time), column_family_(column_family),
+          meta_prefix_(meta_prefix), meta_cache_(meta_cache) {}
 
     virtual Status PutCF(uint32_t column_family_id, const Slice& key,
                          const Slice& value) override {
       std::string value_with_ver_ts;
       uint32_t version;
       int32_t timestamp;
-      GetVersionAndTS(db_, meta_prefix_, key, &version, &timestamp);
+      GetVersionAndTS(db_, column_family_, meta_prefix_, key, &version, &timestamp, meta_cache_);
 
 //      std::cout << "WriteWithExpiredTime, prefix: " << meta_prefix_ << " key: " << key.ToString() << " value: " << value.ToString() <<  " version: " << version << " timestamp: " << timestamp << std::endl;
 
@@ -426,8 +1098,9 @@ Status DBNemoImpl::WriteWithExpiredTime(const WriteOptions& opts, WriteBatch* up
       if (!st.ok()) {
         batch_rewrite_status = st;
       } else {
-        WriteBatchInternal::Put(&updates_ttl, column_family_id, key,
+        WriteBatchInternal::Put(&updates_ttl, BoundID(column_family_, column_family_id), key,
                                 value_with_ver_ts);
+        TrackMetaPut(meta_prefix_, key, value_with_ver_ts, &meta_updates);
       }
       return Status::OK();
     }
@@ -439,14 +1112,16 @@ Status DBNemoImpl::WriteWithExpiredTime(const WriteOptions& opts, WriteBatch* up
       if (!st.ok()) {
         batch_rewrite_status = st;
       } else {
-        WriteBatchInternal::Merge(&updates_ttl, column_family_id, key,
+        WriteBatchInternal::Merge(&updates_ttl, BoundID(column_family_, column_family_id), key,
                                   value_with_ver_ts);
+        TrackMetaDelete(meta_prefix_, key, &meta_updates);
       }
       return Status::OK();
     }
     virtual Status DeleteCF(uint32_t column_family_id,
                             const Slice& key) override {
-      WriteBatchInternal::Delete(&updates_ttl, column_family_id, key);
+      WriteBatchInternal::Delete(&updates_ttl, BoundID(column_family_, column_family_id), key);
+      TrackMetaDelete(meta_prefix_, key, &meta_updates);
       return Status::OK();
     }
     virtual void LogData(const Slice& blob) override {
@@ -456,57 +1131,80 @@ Status DBNemoImpl::WriteWithExpiredTime(const WriteOptions& opts, WriteBatch* up
    private:
     Env* env_;
     int32_t expired_time_;
+    ColumnFamilyHandle* column_family_;
     char meta_prefix_;
+    NemoMetaCache* meta_cache_;
   };
   //@ADD assign the db pointer
-  Handler handler(GetEnv(), db_, meta_prefix_, expired_time);
+  Handler handler(GetEnv(), db_, DefaultColumnFamily(), meta_prefix_,
+                  expired_time, meta_cache_.get());
 
   updates->Iterate(&handler);
   if (!handler.batch_rewrite_status.ok()) {
     return handler.batch_rewrite_status;
-  } else {
-    return db_->Write(opts, &(handler.updates_ttl));
   }
+  prepared->batch = std::move(handler.updates_ttl);
+  prepared->meta_updates.swap(handler.meta_updates);
+  return Status::OK();
 }
 
 Status DBNemoImpl::WriteWithKeyVersion(const WriteOptions& opts, WriteBatch* updates) {
+  NemoPreparedWrite prepared;
+  Status s = PrepareWithKeyVersion(updates, &prepared);
+  if (!s.ok()) {
+    return s;
+  }
+  return WriteAndRefreshMetaCache(opts, &prepared.batch, prepared.meta_updates);
+}
+
+Status DBNemoImpl::PrepareWithKeyVersion(WriteBatch* updates,
+                                         NemoPreparedWrite* prepared) {
   class Handler : public WriteBatch::Handler {
    public:
     DBImpl* db_;
     WriteBatch updates_ttl;
     Status batch_rewrite_status;
+    std::vector<NemoMetaCache::Update> meta_updates;
 
-    explicit Handler(Env* env, DB* db, char meta_prefix)
+    explicit Handler(Env* env, DB* db, ColumnFamilyHandle* column_family,
+                     char meta_prefix, NemoMetaCache* meta_cache)
         : db_(reinterpret_cast<DBImpl*>(db)), env_(env),
-          meta_prefix_(meta_prefix) {}
+          column_family_(column_family), meta_prefix_(meta_prefix),
+          meta_cache_(meta_cache), new_version_(0), is_first_(true) {}
 
     virtual Status PutCF(uint32_t column_family_id, const Slice& key,
                          const Slice& value) override {
       std::string value_with_ver_ts;
-      uint32_t version;
-      int32_t timestamp;
-      GetVersionAndTS(db_, meta_prefix_, key, &version, &timestamp);
 
-//      std::cout << "WriteWithKeyVersionTTL, prefix: " << meta_prefix_ << " key: " << key.ToString() << " value: " << value.ToString() <<  " version: " << version << " timestamp: " << timestamp << std::endl;
+      // the whole batch takes the version of its first key, so the data
+      // keys of a batch land in the version of their meta
+      if (is_first_) {
+        uint32_t version;
+        int32_t timestamp;
+        GetVersionAndTS(db_, column_family_, meta_prefix_, key, &version, &timestamp, meta_cache_);
+
+//        std::cout << "WriteWithKeyVersionTTL, prefix: " << meta_prefix_ << " key: " << key.ToString() << " value: " << value.ToString() <<  " version: " << version << " timestamp: " << timestamp << std::endl;
 
-      int64_t curtime;
-      uint32_t new_version;
-      if (!env_->GetCurrentTime(&curtime).ok()) {
-        curtime = version;
-      }
-      new_version = curtime;
-      if (curtime <= version) {
-        new_version = version + 1;
+        int64_t curtime;
+        if (!env_->GetCurrentTime(&curtime).ok()) {
+          curtime = version;
+        }
+        new_version_ = curtime;
+        if (curtime <= version) {
+          new_version_ = version + 1;
+        }
+//        std::cout << "WriteWithKeyVersion, version: " << version << " curtime: " << curtime << " new_version: " << new_version_ << std::endl;
+        is_first_ = false;
       }
-//      std::cout << "WriteWithKeyVersion, version: " << version << " curtime: " << curtime << " new_version: " << new_version << std::endl;
 
       Status st = AppendVersionAndTS(value, &value_with_ver_ts,
-                      env_, new_version, 0);
+                      env_, new_version_, 0);
       if (!st.ok()) {
         batch_rewrite_status = st;
       } else {
-        WriteBatchInternal::Put(&updates_ttl, column_family_id, key,
+        WriteBatchInternal::Put(&updates_ttl, BoundID(column_family_, column_family_id), key,
                                 value_with_ver_ts);
+        TrackMetaPut(meta_prefix_, key, value_with_ver_ts, &meta_updates);
       }
       return Status::OK();
     }
@@ -518,14 +1216,16 @@ Status DBNemoImpl::WriteWithKeyVersion(const WriteOptions& opts, WriteBatch* upd
       if (!st.ok()) {
         batch_rewrite_status = st;
       } else {
-        WriteBatchInternal::Merge(&updates_ttl, column_family_id, key,
+        WriteBatchInternal::Merge(&updates_ttl, BoundID(column_family_, column_family_id), key,
                                   value_with_ver_ts);
+        TrackMetaDelete(meta_prefix_, key, &meta_updates);
       }
       return Status::OK();
     }
     virtual Status DeleteCF(uint32_t column_family_id,
                             const Slice& key) override {
-      WriteBatchInternal::Delete(&updates_ttl, column_family_id, key);
+      WriteBatchInternal::Delete(&updates_ttl, BoundID(column_family_, column_family_id), key);
+      TrackMetaDelete(meta_prefix_, key, &meta_updates);
       return Status::OK();
     }
     virtual void LogData(const Slice& blob) override {
@@ -534,29 +1234,48 @@ Status DBNemoImpl::WriteWithKeyVersion(const WriteOptions& opts, WriteBatch* upd
 
    private:
     Env* env_;
+    ColumnFamilyHandle* column_family_;
     char meta_prefix_;
+    NemoMetaCache* meta_cache_;
+    uint32_t new_version_;
+    bool is_first_;
   };
   //@ADD assign the db pointer
-  Handler handler(GetEnv(), db_, meta_prefix_);
+  Handler handler(GetEnv(), db_, DefaultColumnFamily(), meta_prefix_,
+                  meta_cache_.get());
 
   updates->Iterate(&handler);
   if (!handler.batch_rewrite_status.ok()) {
     return handler.batch_rewrite_status;
-  } else {
-    return db_->Write(opts, &(handler.updates_ttl));
   }
+  prepared->batch = std::move(handler.updates_ttl);
+  prepared->meta_updates.swap(handler.meta_updates);
+  return Status::OK();
 }
 
 Status DBNemoImpl::WriteWithOldKeyTTL(const WriteOptions& opts, WriteBatch* updates) {
+  NemoPreparedWrite prepared;
+  Status s = PrepareWithOldKeyTTL(updates, &prepared);
+  if (!s.ok()) {
+    return s;
+  }
+  return WriteAndRefreshMetaCache(opts, &prepared.batch, prepared.meta_updates);
+}
+
+Status DBNemoImpl::PrepareWithOldKeyTTL(WriteBatch* updates,
+                                        NemoPreparedWrite* prepared) {
   class Handler : public WriteBatch::Handler {
    public:
     DBImpl* db_;
     WriteBatch updates_ttl;
     Status batch_rewrite_status;
+    std::vector<NemoMetaCache::Update> meta_updates;
 
-    explicit Handler(Env* env, DB* db, char meta_prefix)
+    explicit Handler(Env* env, DB* db, ColumnFamilyHandle* column_family,
+                     char meta_prefix, NemoMetaCache* meta_cache)
         : db_(reinterpret_cast<DBImpl*>(db)), env_(env),
-          meta_prefix_(meta_prefix), version_(0),
+          column_family_(column_family), meta_prefix_(meta_prefix),
+          meta_cache_(meta_cache), version_(0),
           timestamp_(0), is_first_(true) {
             env_->GetCurrentTime(&now_);
           }
@@ -567,7 +1286,7 @@ Status DBNemoImpl::WriteWithOldKeyTTL(const WriteOptions& opts, WriteBatch* upda
 
       if (is_first_) {
 //        std::cout << "is first, now: " << now_ << std::endl;
-        bool find_meta = GetVersionAndTS(db_, meta_prefix_, key, &version_, &timestamp_);
+        bool find_meta = GetVersionAndTS(db_, column_family_, meta_prefix_, key, &version_, &timestamp_, meta_cache_);
         if (!find_meta) {
 //          std::cout <<  "Update version " << key.ToString() << ", meta not found, use now: " << now_ << std::endl;
           version_ = now_;
@@ -607,8 +1326,9 @@ Status DBNemoImpl::WriteWithOldKeyTTL(const WriteOptions& opts, WriteBatch* upda
       if (!st.ok()) {
         batch_rewrite_status = st;
       } else {
-        WriteBatchInternal::Put(&updates_ttl, column_family_id, key,
+        WriteBatchInternal::Put(&updates_ttl, BoundID(column_family_, column_family_id), key,
                                 value_with_ver_ts);
+        TrackMetaPut(meta_prefix_, key, value_with_ver_ts, &meta_updates);
       }
       return Status::OK();
     }
@@ -620,14 +1340,16 @@ Status DBNemoImpl::WriteWithOldKeyTTL(const WriteOptions& opts, WriteBatch* upda
       if (!st.ok()) {
         batch_rewrite_status = st;
       } else {
-        WriteBatchInternal::Merge(&updates_ttl, column_family_id, key,
+        WriteBatchInternal::Merge(&updates_ttl, BoundID(column_family_, column_family_id), key,
                                   value_with_ver_ts);
+        TrackMetaDelete(meta_prefix_, key, &meta_updates);
       }
       return Status::OK();
     }
     virtual Status DeleteCF(uint32_t column_family_id,
                             const Slice& key) override {
-      WriteBatchInternal::Delete(&updates_ttl, column_family_id, key);
+      WriteBatchInternal::Delete(&updates_ttl, BoundID(column_family_, column_family_id), key);
+      TrackMetaDelete(meta_prefix_, key, &meta_updates);
       return Status::OK();
     }
     virtual void LogData(const Slice& blob) override {
@@ -636,30 +1358,70 @@ Status DBNemoImpl::WriteWithOldKeyTTL(const WriteOptions& opts, WriteBatch* upda
 
    private:
     Env* env_;
+    ColumnFamilyHandle* column_family_;
     char meta_prefix_;
+    NemoMetaCache* meta_cache_;
     int64_t now_;
     uint32_t version_;
     int32_t timestamp_;
     bool is_first_;
   };
   //@ADD assign the db pointer
-  Handler handler(GetEnv(), db_, meta_prefix_);
+  Handler handler(GetEnv(), db_, DefaultColumnFamily(), meta_prefix_,
+                  meta_cache_.get());
 
   updates->Iterate(&handler);
   if (!handler.batch_rewrite_status.ok()) {
     return handler.batch_rewrite_status;
-  } else {
-    return db_->Write(opts, &(handler.updates_ttl));
+  }
+  prepared->batch = std::move(handler.updates_ttl);
+  prepared->meta_updates.swap(handler.meta_updates);
+  return Status::OK();
+}
+
+Status DBNemoImpl::PrepareWrite(NemoWriteKind kind, WriteBatch* updates,
+                                int32_t arg, NemoPreparedWrite* prepared) {
+  switch (kind) {
+    case kNemoWriteTTL:
+      return PrepareWithTTL(updates, arg, prepared);
+    case kNemoWriteExpiredTime:
+      return PrepareWithExpiredTime(updates, arg, prepared);
+    case kNemoWriteKeyVersion:
+      return PrepareWithKeyVersion(updates, prepared);
+    case kNemoWriteOldKeyTTL:
+      return PrepareWithOldKeyTTL(updates, prepared);
+    default:
+      return Status::NotSupported("unknown write kind");
   }
 }
 
+Status DBNemoImpl::WritePrepared(const WriteOptions& opts,
+    const std::vector<NemoPreparedWrite*>& writes) {
+  if (writes.size() == 1) {
+    return WriteAndRefreshMetaCache(opts, &writes[0]->batch,
+                                    writes[0]->meta_updates);
+  }
+  // The meta updates keep the order of the batches, so the last write of a
+  // meta key is the one left in the cache
+  WriteBatch batch;
+  std::vector<NemoMetaCache::Update> meta_updates;
+  for (auto write : writes) {
+    WriteBatchInternal::Append(&batch, &write->batch);
+    meta_updates.insert(meta_updates.end(), write->meta_updates.begin(),
+                        write->meta_updates.end());
+  }
+  return WriteAndRefreshMetaCache(opts, &batch, meta_updates);
+}
+
 Status DBNemoImpl::GetKeyTTL(const ReadOptions& options, const Slice& key, int32_t *ttl) {
 
     std::string value;
+    io_context.gets++;
     Status st = db_->Get(options, DefaultColumnFamily(), key, &value);
     if (!st.ok()) {
         return st;
     }
+    io_context.bytes_read += value.size();
 
     uint32_t version;
     int32_t timestamp;
@@ -714,13 +1476,380 @@ Status DBNemoImpl::GetKeyTTL(const ReadOptions& options, const Slice& key, int32
 
 Iterator* DBNemoImpl::NewIterator(const ReadOptions& opts,
                                      ColumnFamilyHandle* column_family) {
-  return new NemoIterator(db_->NewIterator(opts, column_family), db_->GetEnv(), db_, meta_prefix_);
+  return new NemoIterator(db_->NewIterator(opts, column_family), db_->GetEnv(), db_, meta_prefix_,
+                          meta_cache_.get(), DefaultColumnFamily());
+}
+
+Status DBNemoImpl::IngestExternalFile(
+    ColumnFamilyHandle* column_family,
+    const std::vector<std::string>& external_files,
+    const IngestExternalFileOptions& options) {
+  // Nor does the key filter know the ingested keys, there is none until it
+  // is built again
+  {
+    WriteLock l(&key_filter_rw_);
+    key_filter_epoch_++;
+    std::atomic_store(&key_filter_, std::shared_ptr<NemoKeyFilter>());
+  }
+  Status s = db_->IngestExternalFile(column_family, external_files, options);
+  // Ingested files may carry any meta key, and bypass the write handlers
+  if (meta_cache_ != nullptr) {
+    meta_cache_->Clear();
+  }
+  row_cache_->Clear();
+  if (key_filter_bits_ > 0) {
+    ScheduleKeyFilterBuild();
+  }
+  return s;
 }
 
 void DBNemoImpl::StopAllBackgroundWork(bool wait) {
   CancelAllBackgroundWork(db_, wait);
 }
 
+void DBNemoImpl::SetMetaCacheCapacity(size_t capacity) {
+  if (meta_cache_ != nullptr) {
+    meta_cache_->SetCapacity(capacity);
+  }
+}
+
+void DBNemoImpl::GetMetaCacheStats(NemoMetaCacheStats* stats) {
+  *stats = NemoMetaCacheStats();
+  if (meta_cache_ != nullptr) {
+    meta_cache_->GetStats(stats);
+  }
+}
+
+void DBNemoImpl::SetRowCacheCapacity(size_t capacity) {
+  row_cache_->SetCapacity(capacity);
+}
+
+void DBNemoImpl::GetRowCacheStats(NemoRowCacheStats* stats) {
+  row_cache_->GetStats(stats);
+}
+
+void DBNemoImpl::EnableKeyFilter(int bits_per_key) {
+  key_filter_bits_ = std::max(bits_per_key, 0);
+  if (bits_per_key > 0) {
+    ScheduleKeyFilterBuild();
+  } else {
+    WriteLock l(&key_filter_rw_);
+    std::atomic_store(&key_filter_, std::shared_ptr<NemoKeyFilter>());
+  }
+}
+
+bool DBNemoImpl::UserKeyMayExist(const Slice& user_key) {
+  std::shared_ptr<NemoKeyFilter> filter = std::atomic_load(&key_filter_);
+  return filter == nullptr || filter->MayContain(user_key);
+}
+
+void DBNemoImpl::GetKeyFilterStats(NemoKeyFilterStats* stats) {
+  *stats = NemoKeyFilterStats();
+  std::shared_ptr<NemoKeyFilter> filter = std::atomic_load(&key_filter_);
+  if (filter != nullptr) {
+    stats->ready = true;
+    stats->keys = filter->keys();
+    stats->capacity = filter->capacity();
+    stats->usage = filter->usage();
+  }
+  stats->builds = key_filter_builds_.load(std::memory_order_relaxed);
+}
+
+Status DBNemoImpl::Delete(const WriteOptions& options,
+                          ColumnFamilyHandle* column_family,
+                          const Slice& key) {
+  Status s;
+  {
+    NemoWriteFence::Writer fence(write_fence_.get());
+    s = db_->Delete(options, column_family, key);
+  }
+  // The key may be a meta key, erased once the delete is in as by
+  // DeleteRange
+  if (meta_cache_ != nullptr) {
+    meta_cache_->Erase(key);
+  }
+  if (row_cache_->enabled()) {
+    row_cache_->Erase(key);
+  }
+  return s;
+}
+
+Status DBNemoImpl::DeleteRange(const WriteOptions& options,
+                               ColumnFamilyHandle* column_family,
+                               const Slice& begin_key, const Slice& end_key) {
+  Status s;
+  {
+    NemoWriteFence::Writer fence(write_fence_.get());
+    s = db_->DeleteRange(options, column_family, begin_key, end_key);
+  }
+  // Cleared once the tombstone is in, so that the lookups which read a meta
+  // before it don't fill the cache again, see NemoMetaCache::Insert
+  if (meta_cache_ != nullptr) {
+    meta_cache_->Clear();
+  }
+  row_cache_->Clear();
+  return s;
+}
+
+Status DBNemoImpl::GetVolumeSamples(NemoVolumeSamples* files,
+                                    bool* changed) {
+  *changed = false;
+  TablePropertiesCollection props;
+  Status s = db_->GetPropertiesOfAllTables(DefaultColumnFamily(), &props);
+  if (!s.ok()) {
+    return s;
+  }
+
+  for (auto it = files->begin(); it != files->end(); ) {
+    if (props.find(it->first) == props.end()) {
+      it = files->erase(it);
+      *changed = true;
+    } else {
+      ++it;
+    }
+  }
+  for (const auto& prop : props) {
+    if (files->find(prop.first) != files->end()) {
+      continue;
+    }
+    std::vector<NemoVolumeSample>& samples = (*files)[prop.first];
+    *changed = true;
+    const UserCollectedProperties& user_props =
+        prop.second->user_collected_properties;
+    auto found = user_props.find(NemoVolumeCollector::kPropertyName);
+    if (found != user_props.end() &&
+        !NemoVolumeCollector::DecodeSamples(found->second, &samples)) {
+      Log(db_->GetOptions().info_log, "bad volume samples in %s",
+          prop.first.c_str());
+    }
+  }
+  return Status::OK();
+}
+
+// The user key of an entry of the db, false for the data keys
+bool DBNemoImpl::IsUserKeyEntry(const Slice& key, Slice* user_key) {
+  if (!HasMetaKey(meta_prefix_)) {
+    *user_key = key;
+    return true;
+  }
+  if (key.size() == 0 || key[0] != meta_prefix_) {
+    return false;
+  }
+  *user_key = Slice(key.data() + 1, key.size() - 1);
+  return true;
+}
+
+void DBNemoImpl::SeekUserKeys(Iterator* it) {
+  if (HasMetaKey(meta_prefix_)) {
+    it->Seek(Slice(&meta_prefix_, 1));
+  } else {
+    it->SeekToFirst();
+  }
+}
+
+bool DBNemoImpl::AddToKeyFilter(WriteBatch* batch) {
+  class Handler : public WriteBatch::Handler {
+   public:
+    DBNemoImpl* db;
+    NemoKeyFilter* filter;
+    NemoKeyFilter* building;
+    bool overfull;
+
+    void Add(const Slice& key) {
+      Slice user_key;
+      if (!db->IsUserKeyEntry(key, &user_key)) {
+        return;
+      }
+      if (filter != nullptr && filter->Add(user_key) &&
+          filter->keys() > 2 * filter->capacity()) {
+        overfull = true;
+      }
+      if (building != nullptr) {
+        building->Add(user_key);
+      }
+    }
+    virtual Status PutCF(uint32_t column_family_id, const Slice& key,
+                         const Slice& value) override {
+      Add(key);
+      return Status::OK();
+    }
+    virtual Status MergeCF(uint32_t column_family_id, const Slice& key,
+                           const Slice& value) override {
+      Add(key);
+      return Status::OK();
+    }
+    virtual Status DeleteCF(uint32_t column_family_id,
+                            const Slice& key) override {
+      return Status::OK();
+    }
+  };
+
+  // key_filter_ only changes under the write lock, no atomic_load needed
+  if (key_filter_ == nullptr && building_filter_ == nullptr) {
+    return false;
+  }
+  Handler handler;
+  handler.db = this;
+  handler.filter = key_filter_.get();
+  handler.building = building_filter_.get();
+  handler.overfull = false;
+  batch->Iterate(&handler);
+  return handler.overfull;
+}
+
+void DBNemoImpl::ScheduleKeyFilterBuild() {
+  MutexLock l(&key_filter_mu_);
+  if (key_filter_building_ || shutting_down_) {
+    return;
+  }
+  // the last build is over, its thread is about to exit
+  if (key_filter_thread_.joinable()) {
+    key_filter_thread_.join();
+  }
+  key_filter_building_ = true;
+  key_filter_thread_ = std::thread(&DBNemoImpl::BuildKeyFilter, this);
+}
+
+void DBNemoImpl::BuildKeyFilter() {
+  while (!shutting_down_ && key_filter_bits_ > 0) {
+    int bits_per_key = key_filter_bits_;
+    uint64_t epoch = key_filter_epoch_;
+    Status s = BuildKeyFilterOnce(bits_per_key);
+    if (!s.ok()) {
+      Log(db_->GetOptions().info_log, "Build key filter failed -- %s",
+          s.ToString().c_str());
+      break;
+    }
+    if (bits_per_key == key_filter_bits_ && epoch == key_filter_epoch_) {
+      break;
+    }
+  }
+  key_filter_building_ = false;
+}
+
+// Count the user keys to size the filter, then fill it from a second scan.
+// Writes from the start of the second scan on are added by the writers.
+Status DBNemoImpl::BuildKeyFilterOnce(int bits_per_key) {
+  ReadOptions options;
+  options.fill_cache = false;
+  uint64_t epoch = key_filter_epoch_;
+
+  uint64_t count = 0;
+  Slice user_key;
+  Iterator* it = db_->NewIterator(options, DefaultColumnFamily());
+  for (SeekUserKeys(it); it->Valid() && IsUserKeyEntry(it->key(), &user_key) &&
+       !shutting_down_; it->Next()) {
+    count++;
+  }
+  Status s = it->status();
+  delete it;
+  if (!s.ok() || shutting_down_) {
+    return s;
+  }
+
+  std::shared_ptr<NemoKeyFilter> filter(new NemoKeyFilter(count, bits_per_key));
+  {
+    WriteLock l(&key_filter_rw_);
+    building_filter_ = filter;
+    it = db_->NewIterator(options, DefaultColumnFamily());
+  }
+  for (SeekUserKeys(it); it->Valid() && IsUserKeyEntry(it->key(), &user_key) &&
+       !shutting_down_; it->Next()) {
+    filter->Add(user_key);
+  }
+  s = it->status();
+  delete it;
+
+  WriteLock l(&key_filter_rw_);
+  building_filter_.reset();
+  if (s.ok() && !shutting_down_ && bits_per_key == key_filter_bits_ &&
+      epoch == key_filter_epoch_) {
+    std::atomic_store(&key_filter_, filter);
+    key_filter_builds_++;
+  }
+  return s;
+}
+
+Status DBNemoImpl::WriteAndRefreshMetaCache(const WriteOptions& opts,
+    WriteBatch* batch, const std::vector<NemoMetaCache::Update>& updates) {
+  Status s;
+  bool overfull;
+  {
+    NemoWriteFence::Writer fence(write_fence_.get());
+    ReadLock l(&key_filter_rw_);
+    overfull = AddToKeyFilter(batch);
+    s = db_->Write(opts, batch);
+  }
+  io_context.bytes_written += batch->GetDataSize();
+  if (overfull) {
+    ScheduleKeyFilterBuild();
+  }
+  if (row_cache_->enabled()) {
+    RefreshRowCache(batch, s.ok());
+  }
+  if (meta_cache_ == nullptr) {
+    return s;
+  }
+  for (const auto& update : updates) {
+    // If the write failed we don't know what is in the db, just forget it
+    if (s.ok() && !update.deleted) {
+      meta_cache_->Refresh(update.key, update.version, update.timestamp);
+    } else {
+      meta_cache_->Erase(update.key);
+    }
+  }
+  return s;
+}
+
+void DBNemoImpl::RefreshRowCache(WriteBatch* batch, bool written) {
+  class Handler : public WriteBatch::Handler {
+   public:
+    Handler(NemoRowCache* row_cache, uint32_t column_family_id, bool written)
+        : row_cache_(row_cache), column_family_id_(column_family_id),
+          written_(written) {}
+
+    virtual Status PutCF(uint32_t column_family_id, const Slice& key,
+                         const Slice& value) override {
+      if (column_family_id == column_family_id_) {
+        // If the write failed we don't know what is in the db, just forget it
+        if (written_) {
+          row_cache_->Refresh(key, value);
+        } else {
+          row_cache_->Erase(key);
+        }
+      }
+      return Status::OK();
+    }
+    // The result of a merge is only known once read
+    virtual Status MergeCF(uint32_t column_family_id, const Slice& key,
+                           const Slice& value) override {
+      if (column_family_id == column_family_id_) {
+        row_cache_->Erase(key);
+      }
+      return Status::OK();
+    }
+    virtual Status DeleteCF(uint32_t column_family_id,
+                            const Slice& key) override {
+      if (column_family_id == column_family_id_) {
+        row_cache_->Erase(key);
+      }
+      return Status::OK();
+    }
+    virtual Status SingleDeleteCF(uint32_t column_family_id,
+                                  const Slice& key) override {
+      return DeleteCF(column_family_id, key);
+    }
+    virtual void LogData(const Slice& blob) override {}
+
+   private:
+    NemoRowCache* row_cache_;
+    uint32_t column_family_id_;
+    bool written_;
+  };
+  Handler handler(row_cache_.get(), DefaultColumnFamily()->GetID(), written);
+  batch->Iterate(&handler);
+}
+
 Status DBNemoImpl::AppendVersionAndTS(const Slice& val, 
     std::string* val_with_ver_ts, Env* env, uint32_t version, int32_t ttl) {
 
@@ -767,49 +1896,64 @@ Status DBNemoImpl::AppendVersionAndExpiredTime(const Slice& val,
   return Status::OK(); 
 }
 
-bool DBNemoImpl::GetVersionAndTS(DB* db, char meta_prefix,
-      const Slice& key, uint32_t* version, int32_t* timestamp) {
+bool DBNemoImpl::GetVersionAndTS(DB* db, ColumnFamilyHandle* column_family,
+      char meta_prefix, const Slice& key, uint32_t* version,
+      int32_t* timestamp, NemoMetaCache* meta_cache) {
   *version = *timestamp = 0;
 
   if (meta_prefix == kMetaPrefixKv || meta_prefix == kMetaPrefixMeta || meta_prefix == kMetaPrefixRaft ) {
     return true;
   }
 
-  std::string value;
-  Status s;
-
   if (meta_prefix == key[0]) {
-    s = db->Get(ReadOptions(), key, &value);
-//    std::cout << "GetVersionAndTS, meta, " << s.ToString() << " key: " << key.ToString() << " value: " << *((int64_t*)value.data()) << std::endl;
-  } else {
-    if (key.size() == 1) {
-      // this is Seperator between meta and data, just ignore
-      *version = *timestamp = 0;
-      return true;
-    }
-
-    std::string meta_key(1, meta_prefix);
-    int32_t len = *((uint8_t*)(key.data()+1));
-    meta_key.append(key.data()+2, len);
-    s = db->Get(ReadOptions(), meta_key, &value);
-//    std::cout << "GetVersionAndTS, data, " << s.ToString() << " key: " << meta_key << " value: " << (*(int64_t*)value.data()) << std::endl;
+    return GetMetaVersionAndTS(db, column_family, key, version, timestamp, meta_cache);
   }
 
-  if (s.ok()) {
-    *version = DecodeFixed32(value.data() + value.size() - kVersionLength - kTSLength);
-    *timestamp = DecodeFixed32(value.data() + value.size() - kTSLength);
+  if (key.size() == 1) {
+    // this is Seperator between meta and data, just ignore
+    *version = *timestamp = 0;
     return true;
   }
 
-  return false; 
+  std::string meta_key(1, meta_prefix);
+  int32_t len = *((uint8_t*)(key.data()+1));
+  meta_key.append(key.data()+2, len);
+  return GetMetaVersionAndTS(db, column_family, meta_key, version, timestamp, meta_cache);
+}
 
+// Returns false if the meta key doesn't exist
+bool DBNemoImpl::GetMetaVersionAndTS(DB* db, ColumnFamilyHandle* column_family,
+      const Slice& meta_key, uint32_t* version, int32_t* timestamp,
+      NemoMetaCache* meta_cache) {
+  *version = *timestamp = 0;
+
+  bool found = false;
+  uint64_t epoch = 0;
+  if (meta_cache != nullptr &&
+      meta_cache->Lookup(meta_key, &found, version, timestamp, &epoch)) {
+    return found;
+  }
+
+  std::string value;
+  if (column_family == nullptr) {
+    column_family = db->DefaultColumnFamily();
+  }
+  io_context.meta_gets++;
+  Status s = db->Get(ReadOptions(), column_family, meta_key, &value);
+//    std::cout << "GetMetaVersionAndTS, " << s.ToString() << " key: " << meta_key.ToString() << std::endl;
+  if (s.ok()) {
+    found = ExtractVersionAndTS(value, version, timestamp).ok();
+  }
+
+  if (meta_cache != nullptr && (s.ok() || s.IsNotFound())) {
+    meta_cache->Insert(meta_key, epoch, found, *version, *timestamp);
+  }
+  return found;
 }
 
 Status DBNemoImpl::SanityCheckVersionAndTS(const Slice& key,
                     const Slice& val) {
 
-  std::string meta_value;
-
   int32_t timestamp_value = DecodeFixed32(val.data() + val.size() - kTSLength);
   // data key
   if (meta_prefix_ != kMetaPrefixKv && meta_prefix_ != kMetaPrefixMeta && meta_prefix_ != kMetaPrefixRaft && meta_prefix_ != key[0]) {
@@ -817,16 +1961,17 @@ Status DBNemoImpl::SanityCheckVersionAndTS(const Slice& key,
     int32_t len = *((uint8_t *)(key.data() + 1));
     meta_key.append(key.data() + 2, len);
 
-    Status st = db_->Get(ReadOptions(), meta_key, &meta_value);
-    if (st.ok()) {
+    uint32_t meta_version;
+    int32_t meta_timestamp;
+    if (GetMetaVersionAndTS(db_, DefaultColumnFamily(), meta_key, &meta_version, &meta_timestamp,
+                            meta_cache_.get())) {
       // Checks that Version is not older than key version
-      uint32_t meta_version = DecodeFixed32(meta_value.data() + meta_value.size() - kTSLength - kVersionLength);
       uint32_t data_version = DecodeFixed32(val.data() + val.size() - kTSLength - kVersionLength);
       if (data_version < meta_version) {
         return Status::NotFound("old version\n");
       }
+      timestamp_value = meta_timestamp;
     }
-    timestamp_value = DecodeFixed32(meta_value.data() + meta_value.size() - kTSLength);
   }
 
   int64_t curtime;
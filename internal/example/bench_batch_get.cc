@@ -0,0 +1,99 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Batches of 100 and 1000 random keys read through MGetBatch and HMGetBatch,
+// beside the Get and HGet per key that MGet and HMGet did before
+Nemo *n;
+int cnt;
+
+void Report(int batch, const char *op, int64_t used) {
+  printf ("  batch %-6d %-14s %10.3lf us per batch, %8.3lf us per key\n", batch, op,
+          (double)used / cnt, (double)used / cnt / batch);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf ("Usage: ./bench_batch_get key_num batch_num\n");
+    exit(0);
+  }
+
+  char *pend;
+  int key_num = strtol(argv[1], &pend, 10);
+  cnt = strtol(argv[2], &pend, 10);
+  if (key_num < 1000 || cnt <= 0) {
+    printf ("key_num should be at least 1000, batch_num should be positive\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  n = new Nemo("./tmp_batch_get/", options);
+
+  int res;
+  string hash_key = "bench_batch_get_hash";
+  vector<string> keys, fields;
+  for (int i = 0; i < key_num; i++) {
+    keys.push_back("bench_batch_get_" + to_string(i));
+    fields.push_back("field_" + to_string(i));
+    n->Set(keys[i], string(100, 'v'));
+    n->HSet(hash_key, fields[i], string(100, 'v'), &res);
+  }
+  srand(1);
+
+  int batches[] = {100, 1000};
+  for (int b = 0; b < 2; b++) {
+    int batch = batches[b];
+    vector<vector<rocksdb::Slice> > key_batches(cnt), field_batches(cnt);
+    for (int i = 0; i < cnt; i++) {
+      for (int j = 0; j < batch; j++) {
+        int k = rand() % key_num;
+        key_batches[i].push_back(keys[k]);
+        field_batches[i].push_back(fields[k]);
+      }
+    }
+
+    string val;
+    int64_t st = NowMicros();
+    for (int i = 0; i < cnt; i++) {
+      for (int j = 0; j < batch; j++) {
+        n->Get(key_batches[i][j], &val);
+      }
+    }
+    Report(batch, "Get loop", NowMicros() - st);
+
+    rocksdb::NemoBatchGetResult result;
+    st = NowMicros();
+    for (int i = 0; i < cnt; i++) {
+      n->MGetBatch(key_batches[i], &result);
+    }
+    Report(batch, "MGetBatch", NowMicros() - st);
+
+    st = NowMicros();
+    for (int i = 0; i < cnt; i++) {
+      for (int j = 0; j < batch; j++) {
+        n->HGet(hash_key, field_batches[i][j], &val);
+      }
+    }
+    Report(batch, "HGet loop", NowMicros() - st);
+
+    st = NowMicros();
+    for (int i = 0; i < cnt; i++) {
+      n->HMGetBatch(hash_key, field_batches[i], &result);
+    }
+    Report(batch, "HMGetBatch", NowMicros() - st);
+  }
+
+  delete n;
+  return 0;
+}
@@ -0,0 +1,115 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Latency of foreground Get and HSet, alone and while hashes of 1000 fields
+// are deleted and the hash db compacted in the background, with bg_threads
+// threads per type db running the compactions
+Nemo *n;
+int64_t key_num;
+std::atomic<bool> deleting;
+
+void *Deleter(void *arg) {
+  int hres;
+  int64_t res;
+  string val(100, 'd');
+  for (int64_t r = 0; deleting; r++) {
+    string key = "bench_bg_compact_big_" + to_string(r % 100);
+    for (int f = 0; f < 1000; f++) {
+      n->HSet(key, to_string(f), val, &hres);
+    }
+    n->Del(key, &res);
+    if (r % 1000 == 999) {
+      n->Compact(kHASH_DB, false);
+    }
+  }
+  return NULL;
+}
+
+void Report(const char *when, vector<int64_t> &get_used, vector<int64_t> &hset_used) {
+  sort(get_used.begin(), get_used.end());
+  sort(hset_used.begin(), hset_used.end());
+  size_t cnt = get_used.size();
+  printf ("  %-24s Get p50 %6" PRId64 " us p99 %6" PRId64 " us, HSet p50 %6" PRId64 " us p99 %6" PRId64 " us\n",
+          when, get_used[cnt / 2], get_used[cnt * 99 / 100],
+          hset_used[cnt / 2], hset_used[cnt * 99 / 100]);
+}
+
+void Foreground(const char *when, int cnt) {
+  vector<int64_t> get_used, hset_used;
+  string val;
+  int hres;
+  for (int r = 0; r < cnt; r++) {
+    string key = "bench_bg_compact_" + to_string(rand() % key_num);
+    int64_t st = NowMicros();
+    n->Get(key, &val);
+    get_used.push_back(NowMicros() - st);
+    st = NowMicros();
+    n->HSet(key + "_h", "f", "v", &hres);
+    hset_used.push_back(NowMicros() - st);
+  }
+  Report(when, get_used, hset_used);
+}
+
+int main(int argc, char* argv[]) {
+  key_num = 1000000;
+  int cnt = 100000;
+  int bg_threads = 1;
+  if (argc > 1) {
+    key_num = strtoll(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    cnt = strtol(argv[2], NULL, 10);
+  }
+  if (argc > 3) {
+    bg_threads = strtol(argv[3], NULL, 10);
+  }
+  if (key_num <= 0 || cnt <= 0 || bg_threads <= 0) {
+    printf ("Usage: ./bench_bg_compact [key_num] [op_num] [bg_threads]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  options.bg_threads = bg_threads;
+  n = new Nemo("./tmp_bg_compact/", options);
+  string val(100, 'v');
+  vector<KV> kvs;
+  for (int64_t i = 0; i < key_num; i++) {
+    kvs.push_back({"bench_bg_compact_" + to_string(i), val});
+    if (kvs.size() == 1000 || i == key_num - 1) {
+      n->MSet(kvs);
+      kvs.clear();
+    }
+  }
+  printf ("%" PRId64 " keys, %d bg threads per db\n", key_num, bg_threads);
+  Foreground("idle", cnt);
+
+  deleting = true;
+  pthread_t tid;
+  pthread_create(&tid, NULL, &Deleter, NULL);
+  Foreground("background compactions", cnt);
+  deleting = false;
+  pthread_join(tid, NULL);
+
+  BGTaskStats stats;
+  n->GetBGTaskStats(&stats);
+  printf ("  bg tasks added %" PRIu64 " executed %" PRIu64 " merged %" PRIu64
+          " pending %" PRIu64 " waits %" PRIu64 " oldest %" PRIu64 " us\n",
+          stats.added, stats.executed, stats.merged, stats.pending,
+          stats.waits, stats.oldest_age);
+  delete n;
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// BGSave of data_mb MB of kvs of 1KB and hashes of 10 fields of 1KB, part
+// of them still in the memtables, while a writer keeps writing, then the
+// open of the saved dbs and reads of random keys from them
+string Key(int64_t i) {
+  char buf[32];
+  snprintf (buf, sizeof(buf), "bench_bgsave_%012" PRId64, i);
+  return buf;
+}
+
+int64_t key_num;
+Nemo *n;
+std::atomic<bool> saving;
+std::atomic<int64_t> writes;
+
+void *Writer(void *arg) {
+  string val(1024, 'w');
+  while (saving) {
+    n->Set(Key(rand() % key_num), val);
+    writes++;
+  }
+  return NULL;
+}
+
+int main(int argc, char* argv[]) {
+  int64_t data_mb = 100 * 1024;
+  if (argc > 1) {
+    data_mb = strtoll(argv[1], NULL, 10);
+  }
+  if (data_mb <= 0) {
+    printf ("Usage: ./bench_bgsave [data_mb]\n");
+    exit(0);
+  }
+  // each key writes a kv and a tenth of a hash of 10 fields
+  key_num = data_mb * 1024 / 2;
+
+  nemo::Options options;
+  options.target_file_size_base = 64 * 1024 * 1024;
+  n = new Nemo("./tmp_bgsave_src/", options);
+  string val(1024, 'v');
+  vector<KV> kvs;
+  int hres;
+  int64_t st = NowMicros();
+  for (int64_t i = 0; i < key_num; i++) {
+    kvs.push_back({Key(i), val});
+    if (kvs.size() == 1000 || i == key_num - 1) {
+      n->MSet(kvs);
+      kvs.clear();
+    }
+    if (i % 10 == 0) {
+      for (int f = 0; f < 10; f++) {
+        n->HSet(Key(i), to_string(f), val, &hres);
+      }
+    }
+  }
+  printf ("%" PRId64 " keys, about %" PRId64 " MB, loaded in %.3lf s\n",
+          key_num, data_mb, (double)(NowMicros() - st) / 1000000);
+
+  saving = true;
+  writes = 0;
+  pthread_t tid;
+  pthread_create(&tid, NULL, &Writer, NULL);
+  Snapshots snapshots;
+  n->BGSaveGetSnapshot(snapshots);
+  st = NowMicros();
+  Status s = n->BGSave(snapshots, "./tmp_bgsave_dump");
+  int64_t used = NowMicros() - st;
+  saving = false;
+  pthread_join(tid, NULL);
+  printf ("  BGSave %s %10.3lf s, %" PRId64 " writes meanwhile\n",
+          s.ToString().c_str(), (double)used / 1000000, writes.load());
+  delete n;
+
+  st = NowMicros();
+  n = new Nemo("./tmp_bgsave_dump/", options);
+  printf ("  open of the saved dbs %10.3lf s\n", (double)(NowMicros() - st) / 1000000);
+  int64_t found = 0;
+  string got;
+  for (int r = 0; r < 1000; r++) {
+    if (n->Get(Key(rand() % key_num), &got).ok()) {
+      found++;
+    }
+  }
+  printf ("  %" PRId64 " of 1000 random kvs found in the saved dbs\n", found);
+  delete n;
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "nemo_bit_kernel.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Throughput of every bit kernel the CPU runs, over bitmaps of 1KB, 4KB, ...
+// up to 64MB, then of BitCount and BitOp AND of two keys through Nemo with the
+// kernel it picked
+Nemo *n;
+
+void Report(const char *name, const char *op, size_t size, int64_t rounds, int64_t used) {
+  printf ("  %-8s %-8s %10zu bytes %10.2lf GB/s\n", name, op, size,
+          (double)size * rounds / (used ? used : 1) / 1000);
+}
+
+int main(int argc, char* argv[]) {
+  size_t max_size = 64 << 20;
+  if (argc > 1) {
+    max_size = strtoull(argv[1], NULL, 10);
+  }
+
+  string a, b;
+  srand(1);
+  for (size_t i = 0; i < max_size; i++) {
+    a.push_back(rand());
+    b.push_back(rand());
+  }
+  // BitPos scans to the last byte
+  string zeros(max_size, 0);
+  zeros[max_size - 1] = 1;
+
+  for (size_t size = 1024; size <= max_size; size *= 4) {
+    // about 256MB per measure
+    int64_t rounds = std::max((size_t)1, ((size_t)256 << 20) / size);
+    for (int level = kBitKernelScalar; level < kBitKernelLevels; level++) {
+      const BitKernel *kernel = GetBitKernel((BitKernelLevel)level);
+      if (kernel == NULL) {
+        continue;
+      }
+      volatile uint64_t sink = 0;
+      int64_t st = NowMicros();
+      for (int64_t r = 0; r < rounds; r++) {
+        sink += kernel->count((const uint8_t *)a.data(), size);
+      }
+      Report(kernel->name, "count", size, rounds, NowMicros() - st);
+
+      st = NowMicros();
+      for (int64_t r = 0; r < rounds; r++) {
+        sink += kernel->find((const uint8_t *)zeros.data() + max_size - size, size, 0);
+      }
+      Report(kernel->name, "find", size, rounds, NowMicros() - st);
+
+      string dest(a, 0, size);
+      st = NowMicros();
+      for (int64_t r = 0; r < rounds; r++) {
+        kernel->op(kBitOpXor, (uint8_t *)&dest[0], (const uint8_t *)b.data(), size);
+      }
+      Report(kernel->name, "xor", size, rounds, NowMicros() - st);
+    }
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  n = new Nemo("./tmp_bit_kernel/", options);
+  printf ("Nemo with the %s kernel\n", GetBitKernel().name);
+
+  vector<string> keys;
+  keys.push_back("bench_bit_a");
+  keys.push_back("bench_bit_b");
+  for (size_t size = 1024; size <= max_size; size *= 4) {
+    n->Set(keys[0], a.substr(0, size));
+    n->Set(keys[1], b.substr(0, size));
+    int64_t rounds = std::max((size_t)1, ((size_t)64 << 20) / size);
+
+    int64_t res;
+    int64_t st = NowMicros();
+    for (int64_t r = 0; r < rounds; r++) {
+      n->BitCount(keys[0], &res);
+    }
+    Report("nemo", "BitCount", size, rounds, NowMicros() - st);
+
+    st = NowMicros();
+    for (int64_t r = 0; r < rounds; r++) {
+      n->BitOp(kBitOpAnd, "bench_bit_dest", keys, &res);
+    }
+    Report("nemo", "BitOp", size, rounds, NowMicros() - st);
+  }
+
+  delete n;
+  return 0;
+}
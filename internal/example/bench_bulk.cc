@@ -0,0 +1,152 @@
+#include <new>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo_c.h"
+#include "bench_util.h"
+
+// Allocations and ns per op of HGetall of 10k fields and Scan of 1000 keys
+// through the C API, the per string results of nemo_HGetall and nemo_Scan
+// against the bulk ones of nemo_HGetallBulk and nemo_ScanBulk, with a bulk
+// kept across the calls. Only the C API is used, as a cgo caller would.
+//
+// The allocations of the calling thread are counted by replacing operator
+// new and by wrapping malloc, which the rule of bench_bulk in the Makefile
+// links with -Wl,--wrap=malloc.
+
+static thread_local uint64_t allocs = 0;
+
+extern "C" void *__real_malloc(size_t size);
+extern "C" void *__wrap_malloc(size_t size) {
+  allocs++;
+  return __real_malloc(size);
+}
+
+void *operator new(size_t size) {
+  allocs++;
+  void *p = __real_malloc(size > 0 ? size : 1);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void Check(char *err) {
+  if (err != NULL) {
+    fprintf (stderr, "%s\n", err);
+    exit(-1);
+  }
+}
+
+void FreeStrings(int count, char **list, size_t *lens) {
+  for (int i = 0; i < count; i++) {
+    free(list[i]);
+  }
+  delete [] list;
+  delete [] lens;
+}
+
+void Report(const char *name, int iterations, int64_t micros, uint64_t alloc_count) {
+  printf ("%-16s %10.0f ns/op %10.1f allocs/op\n", name,
+          micros * 1000.0 / iterations, static_cast<double>(alloc_count) / iterations);
+}
+
+int main(int argc, char* argv[]) {
+  int iterations = 1000;
+  if (argc > 1) {
+    iterations = strtol(argv[1], NULL, 10);
+  }
+  if (iterations <= 0) {
+    printf ("Usage: ./bench_bulk [iterations]\n");
+    exit(0);
+  }
+
+  nemo_options_t *options = nemo_CreateOption();
+  nemo_t *n = nemo_Create("./tmp_bulk/", options);
+  char *err = NULL;
+  int res;
+  std::string val(100, 'v');
+  std::string hkey = "bench_bulk_hash";
+  for (int i = 0; i < 10000; i++) {
+    std::string field = "field_" + std::to_string(i);
+    nemo_HSet(n, hkey.data(), hkey.size(), field.data(), field.size(), val.data(), val.size(), &res, &err);
+    Check(err);
+  }
+  for (int i = 0; i < 1000; i++) {
+    std::string key = "bench_bulk_key_" + std::to_string(i);
+    nemo_Set(n, key.data(), key.size(), val.data(), val.size(), 0, &err);
+    Check(err);
+  }
+  std::string pattern = "bench_bulk_key_*";
+
+  // HGetall
+  int count;
+  char **fields, **values;
+  size_t *fields_len, *values_len;
+  uint64_t before = allocs;
+  int64_t st = NowMicros();
+  for (int i = 0; i < iterations; i++) {
+    nemo_HGetall(n, hkey.data(), hkey.size(), &count, &fields, &fields_len, &values, &values_len, &err);
+    Check(err);
+    FreeStrings(count, fields, fields_len);
+    FreeStrings(count, values, values_len);
+  }
+  Report("HGetall", iterations, NowMicros() - st, allocs - before);
+
+  nemo_bulk_t bulk;
+  nemo_BulkInit(&bulk, NULL, 0, NULL, 0);
+  before = allocs;
+  st = NowMicros();
+  for (int i = 0; i < iterations; i++) {
+    nemo_HGetallBulk(n, hkey.data(), hkey.size(), &bulk, &err);
+    Check(err);
+  }
+  Report("HGetallBulk", iterations, NowMicros() - st, allocs - before);
+
+  // Scan
+  char **keys;
+  size_t *keys_len;
+  int64_t cursor_ret;
+  before = allocs;
+  st = NowMicros();
+  for (int i = 0; i < iterations; i++) {
+    nemo_Scan(n, 0, pattern.data(), pattern.size(), 1000, &count, &keys, &keys_len, &cursor_ret, &err);
+    Check(err);
+    FreeStrings(count, keys, keys_len);
+  }
+  Report("Scan", iterations, NowMicros() - st, allocs - before);
+
+  before = allocs;
+  st = NowMicros();
+  for (int i = 0; i < iterations; i++) {
+    nemo_ScanBulk(n, 0, pattern.data(), pattern.size(), 1000, &bulk, &cursor_ret, &err);
+    Check(err);
+  }
+  Report("ScanBulk", iterations, NowMicros() - st, allocs - before);
+
+  nemo_bulk_t *thread_bulk = nemo_ThreadBulk();
+  before = allocs;
+  st = NowMicros();
+  for (int i = 0; i < iterations; i++) {
+    nemo_ScanBulk(n, 0, pattern.data(), pattern.size(), 1000, thread_bulk, &cursor_ret, &err);
+    Check(err);
+  }
+  Report("ScanBulk thread", iterations, NowMicros() - st, allocs - before);
+
+  const char *data;
+  size_t len;
+  if (bulk.count > 0 && nemo_BulkGet(&bulk, 0, &data, &len)) {
+    printf ("first key %.*s of %zu, %zu bytes in the bulk\n", static_cast<int>(len), data, bulk.count, bulk.size);
+  }
+  nemo_BulkFree(&bulk);
+  nemo_free(n);
+  return 0;
+}
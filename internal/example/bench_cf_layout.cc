@@ -0,0 +1,95 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// fsync bound writes over all the types, with one rocksdb per type and with
+// one rocksdb of column families. Each thread does Set, HSet, LPush, SAdd
+// and ZAdd in turn with sync_write on, so every op waits for a WAL fsync.
+
+Nemo *n;
+int tn;
+int cnt;
+int length;
+
+void* ThreadMain(void *arg) {
+  int64_t id = reinterpret_cast<int64_t>(arg);
+  unsigned int seed = id + 1;
+  char member[1024];
+  string prefix = "bench:" + to_string(id) + ":";
+  Status s;
+
+  for (int i = 0; i < cnt; i++) {
+    string key = prefix + to_string(i % 100);
+    gen_random(member, length, &seed);
+    int res;
+    int64_t llen;
+    int64_t ret;
+    switch (i % 5) {
+      case 0: s = n->Set(key, member); break;
+      case 1: s = n->HSet(key, member, member, &res); break;
+      case 2: s = n->LPush(key, member, &llen); break;
+      case 3: s = n->SAdd(key, member, &ret); break;
+      case 4: s = n->ZAdd(key, rand_r(&seed) % 10000, member, &ret); break;
+    }
+    if (!s.ok()) {
+      log_err("write failed, %s", s.ToString().c_str());
+      break;
+    }
+  }
+  return NULL;
+}
+
+void Run(const string &path, bool column_family_layout) {
+  nemo::Options options;
+  options.sync_write = true;
+  options.column_family_layout = column_family_layout;
+  n = new Nemo(path, options);
+
+  vector<pthread_t> tids(tn);
+  int64_t st = NowMicros();
+  for (int i = 0; i < tn; i++) {
+    pthread_create(&tids[i], NULL, ThreadMain, reinterpret_cast<void *>(i));
+  }
+  for (int i = 0; i < tn; i++) {
+    pthread_join(tids[i], NULL);
+  }
+  int64_t used = NowMicros() - st;
+
+  printf ("  %-13s threads %3d, ops %10d, QPS %10.3lf, avg latency %8.3lf us\n",
+          column_family_layout ? "column family" : "db per type", tn, tn * cnt,
+          (double)1000000.0 * tn * cnt / used, (double)used / cnt);
+  delete n;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    printf ("Usage: ./bench_cf_layout thread_num query_num member_length\n");
+    exit(0);
+  }
+
+  char *pend;
+  tn = strtol(argv[1], &pend, 10);
+  cnt = strtol(argv[2], &pend, 10);
+  length = strtol(argv[3], &pend, 10);
+  if (tn <= 0 || length <= 0 || length >= 1024) {
+    printf ("thread_num should be positive, member_length should be in (0, 1024)\n");
+    exit(0);
+  }
+
+  printf ("thread_num %d, query %d per thread, member_length is %d\n", tn, cnt, length);
+
+  Run("./tmp_db_per_type/", false);
+  Run("./tmp_column_family/", true);
+
+  return 0;
+}
@@ -8,6 +8,7 @@
 
 #include "nemo.h"
 #include "xdebug.h"
+#include "bench_util.h"
 
 using namespace nemo;
 using namespace std;
@@ -25,25 +26,6 @@ int64_t total = 0;
 char field[MAXN];
 char value[MAXN];
 
-inline int64_t NowMicros() {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
-}
-
-void gen_random(char *s, const int len, unsigned int * seedp) {
-  static const char alphanum[] =
-      "0123456789"
-      "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-      "abcdefghijklmnopqrstuvwxyz";
-
-  for (int i = 0; i < len; ++i) {
-    s[i] = alphanum[rand_r(seedp) % (sizeof(alphanum) - 1)];
-  }
-
-  s[len] = 0;
-}
-
 void* ThreadMain1(void *arg) {
   int64_t st, ed, t_sum = 0LL;
   Status s;
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <math.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// PfAdd throughput in batches of batch_size elements and the PfCount error
+// of one HLL at 1000, 10000, ... elements up to max_size, then the PfCount
+// and PfMerge latency over the HLLs of every size
+Nemo *n;
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf ("Usage: ./bench_hyperloglog max_size batch_size\n");
+    exit(0);
+  }
+
+  char *pend;
+  int64_t max_size = strtoll(argv[1], &pend, 10);
+  int batch = strtol(argv[2], &pend, 10);
+  if (max_size < 1000 || batch <= 0 || batch >= (int)KEY_MAX_LENGTH) {
+    printf ("max_size should be at least 1000, batch_size in [1, %d)\n", KEY_MAX_LENGTH);
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  n = new Nemo("./tmp_hyperloglog/", options);
+
+  int64_t del;
+  vector<string> keys;
+  for (int64_t size = 1000; size <= max_size; size *= 10) {
+    string key = "bench_hyperloglog_" + to_string(size);
+    n->Del(key, &del);
+    keys.push_back(key);
+
+    bool update;
+    vector<string> values;
+    int64_t st = NowMicros();
+    for (int64_t i = 0; i < size; i++) {
+      values.push_back("element:" + to_string(i));
+      if ((int)values.size() == batch || i == size - 1) {
+        Status s = n->PfAdd(key, values, update);
+        if (!s.ok()) {
+          log_err("PfAdd failed, %s", s.ToString().c_str());
+        }
+        values.clear();
+      }
+    }
+    int64_t used = NowMicros() - st;
+
+    int result;
+    vector<string> one(1, key);
+    st = NowMicros();
+    n->PfCount(one, result);
+    int64_t count_used = NowMicros() - st;
+
+    printf ("  %-10" PRId64 " PfAdd %10.0lf elements/s, PfCount %8" PRId64 " us, count %-10d error %6.3lf%%\n",
+            size, size * 1000000.0 / (used ? used : 1), count_used, result,
+            fabs((double)result - size) * 100 / size);
+  }
+
+  int result;
+  int64_t st = NowMicros();
+  n->PfCount(keys, result);
+  printf ("PfCount of %zu keys in %" PRId64 " us, count %d\n", keys.size(), NowMicros() - st, result);
+
+  vector<string> merge_keys(1, "bench_hyperloglog_merged");
+  n->Del(merge_keys[0], &del);
+  merge_keys.insert(merge_keys.end(), keys.begin(), keys.end());
+  st = NowMicros();
+  n->PfMerge(merge_keys);
+  printf ("PfMerge of %zu keys in %" PRId64 " us\n", keys.size(), NowMicros() - st);
+
+  delete n;
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Type, Exists and Del of keys held by one type only and of missing keys,
+// with the key filters on, then with them off. key_num keys are spread over
+// the 5 types, Exists probes batches of 100 keys.
+Nemo *n;
+int cnt;
+
+void Report(const char *filter, const char *op, const char *keys, int64_t used) {
+  printf ("  filter %-4s %-8s %-8s %8.3lf us per key\n", filter, op, keys,
+          (double)used / cnt);
+}
+
+string Key(int i) {
+  return "bench_key_type_" + to_string(i);
+}
+
+void Load(int key_num) {
+  int hres;
+  int64_t res;
+  for (int i = 0; i < key_num; i++) {
+    string key = Key(i);
+    switch (i % 5) {
+      case 0: n->Set(key, "v"); break;
+      case 1: n->HSet(key, "f", "v", &hres); break;
+      case 2: n->LPush(key, "v", &res); break;
+      case 3: n->ZAdd(key, 1.0, "m", &res); break;
+      default: n->SAdd(key, "m", &res); break;
+    }
+  }
+}
+
+void Run(const char *filter, int key_num) {
+  // the keys of type i % 5 == 4 are the last one probed
+  vector<string> hits, misses;
+  for (int i = 0; i < cnt; i++) {
+    hits.push_back(Key((rand() % (key_num / 5)) * 5 + 4));
+    misses.push_back("bench_key_type_missing_" + to_string(rand()));
+  }
+
+  string type;
+  int64_t st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    n->Type(hits[i], &type);
+  }
+  Report(filter, "Type", "hit", NowMicros() - st);
+
+  st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    n->Type(misses[i], &type);
+  }
+  Report(filter, "Type", "miss", NowMicros() - st);
+
+  int64_t res;
+  st = NowMicros();
+  for (int i = 0; i + 100 <= cnt; i += 100) {
+    n->Exists(vector<string>(hits.begin() + i, hits.begin() + i + 100), &res);
+  }
+  Report(filter, "Exists", "hit", NowMicros() - st);
+
+  st = NowMicros();
+  for (int i = 0; i + 100 <= cnt; i += 100) {
+    n->Exists(vector<string>(misses.begin() + i, misses.begin() + i + 100), &res);
+  }
+  Report(filter, "Exists", "miss", NowMicros() - st);
+
+  st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    n->Del(misses[i], &res);
+  }
+  Report(filter, "Del", "miss", NowMicros() - st);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf ("Usage: ./bench_key_type key_num probe_num\n");
+    exit(0);
+  }
+
+  int key_num = strtol(argv[1], NULL, 10);
+  cnt = strtol(argv[2], NULL, 10);
+  if (key_num < 5 || cnt < 100) {
+    printf ("key_num should be at least 5, probe_num at least 100\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  options.key_filter_bits_per_key = 10;
+  n = new Nemo("./tmp_key_type/", options);
+  Load(key_num);
+
+  rocksdb::NemoKeyFilterStats stats;
+  int64_t st = NowMicros();
+  do {
+    usleep(100000);
+    n->GetKeyFilterStats(&stats);
+  } while (!stats.ready);
+  printf ("key filters of %" PRIu64 " keys, %" PRIu64 " bytes, ready in %.3lf s\n",
+          stats.keys, stats.usage, (double)(NowMicros() - st) / 1000000);
+
+  srand(1);
+  Run("on", key_num);
+  delete n;
+
+  options.key_filter_bits_per_key = 0;
+  n = new Nemo("./tmp_key_type/", options);
+  srand(1);
+  Run("off", key_num);
+
+  delete n;
+  return 0;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// KEYS and a full SCAN of key_num keys spread over the 5 types, with a
+// pattern of a literal prefix, which seeks, and one starting with a star,
+// which tests every key, KEYS with 1 and with scan_threads threads
+void Report(const char *op, const string &pattern, size_t keys, int64_t used) {
+  printf ("  %-14s %-24s %10zu keys %10.3lf s\n", op, pattern.c_str(), keys, (double)used / 1000000);
+}
+
+int main(int argc, char* argv[]) {
+  int64_t key_num = 1000000;
+  int threads = 8;
+  if (argc > 1) {
+    key_num = strtoll(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    threads = strtol(argv[2], NULL, 10);
+  }
+  if (key_num <= 0 || threads <= 0) {
+    printf ("Usage: ./bench_keys [key_num] [scan_threads]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  Nemo *n = new Nemo("./tmp_keys/", options);
+  int hres;
+  int64_t res;
+  for (int64_t i = 0; i < key_num; i++) {
+    string key = "bench_keys_" + to_string(i % 5) + "_" + to_string(i);
+    switch (i % 5) {
+      case 0: n->Set(key, "v"); break;
+      case 1: n->HSet(key, "f", "v", &hres); break;
+      case 2: n->LPush(key, "v", &res); break;
+      case 3: n->ZAdd(key, 1, "m", &res); break;
+      case 4: n->SAdd(key, "m", &res); break;
+    }
+  }
+  delete n;
+
+  // the hashes whose number starts with 1, then the same without the prefix
+  const char *patterns[] = {"bench_keys_1_1*", "*keys_1_1*"};
+  int thread_nums[] = {1, threads};
+  for (int t = 0; t < 2; t++) {
+    options.scan_threads = thread_nums[t];
+    n = new Nemo("./tmp_keys/", options);
+    printf ("scan_threads %d\n", thread_nums[t]);
+    for (int p = 0; p < 2; p++) {
+      vector<string> keys;
+      int64_t st = NowMicros();
+      n->Keys(patterns[p], keys);
+      Report("Keys", patterns[p], keys.size(), NowMicros() - st);
+
+      if (t == 0) {
+        size_t total = 0;
+        string cursor = "0", next_cursor;
+        st = NowMicros();
+        do {
+          n->Scan(cursor, patterns[p], 1000, keys, &next_cursor);
+          total += keys.size();
+          cursor = next_cursor;
+        } while (cursor != "0");
+        Report("Scan count 1000", patterns[p], total, NowMicros() - st);
+      }
+    }
+    delete n;
+  }
+  return 0;
+}
@@ -0,0 +1,140 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// LIndex(mid) and LRange(mid, mid + 100) latency on one long list in both
+// encodings. The linked list is written raw and walked the way the linked
+// encoding was read, one Get per hop from the head; it is then converted
+// with LConvert and read again through the indexed commands.
+
+Nemo *n;
+rocksdb::DBNemo *db;
+int64_t list_len;
+int cnt;
+
+string LinkedKey(const string &key, int64_t seq) {
+  string buf(1, DataType::kList);
+  buf.append(1, (uint8_t)key.size());
+  buf.append(key);
+  buf.append((char *)&seq, sizeof(int64_t));
+  return buf;
+}
+
+// | len | vol | left | right | cur_seq |, elements are | priv | next | val |
+void WriteLinked(const string &key) {
+  int64_t meta[5] = {list_len, 0, 1, list_len, list_len + 1};
+  rocksdb::WriteBatch batch;
+  for (int64_t seq = 1; seq <= list_len; seq++) {
+    string val = "member:" + to_string(seq - 1);
+    int64_t priv = seq - 1;
+    int64_t next = seq == list_len ? 0 : seq + 1;
+    string en_val((char *)&priv, sizeof(int64_t));
+    en_val.append((char *)&next, sizeof(int64_t));
+    en_val.append(val);
+    batch.Put(LinkedKey(key, seq), en_val);
+    meta[1] += key.size() + val.size();
+    if (batch.Count() == 10000 || seq == list_len) {
+      if (seq == batch.Count()) {
+        // the element versions follow the meta, so it goes first
+        db->Put(rocksdb::WriteOptions(), string(1, DataType::kLMeta) + key, string((char *)meta, sizeof(meta)));
+      }
+      db->Write(rocksdb::WriteOptions(), &batch);
+      batch.Clear();
+    }
+  }
+  db->Put(rocksdb::WriteOptions(), string(1, DataType::kLMeta) + key, string((char *)meta, sizeof(meta)));
+}
+
+// Follow next from the head, as the linked LIndex and LRange did
+int64_t WalkLinked(const string &key, int64_t begin, int64_t end) {
+  string en_val;
+  int64_t cur = 1;
+  int64_t found = 0;
+  for (int64_t i = 0; i <= end && cur != 0; i++) {
+    if (!db->Get(rocksdb::ReadOptions(), LinkedKey(key, cur), &en_val).ok()) {
+      break;
+    }
+    if (i >= begin) {
+      found++;
+    }
+    cur = *((int64_t *)(en_val.data() + sizeof(int64_t)));
+  }
+  return found;
+}
+
+void Report(const char *name, const char *op, int64_t used) {
+  printf ("  %-8s %-28s avg latency %12.3lf us\n", name, op, (double)used / cnt);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf ("Usage: ./bench_list_index list_length query_num\n");
+    exit(0);
+  }
+
+  char *pend;
+  list_len = strtoll(argv[1], &pend, 10);
+  cnt = strtol(argv[2], &pend, 10);
+  if (list_len <= 200 || cnt <= 0) {
+    printf ("list_length should be over 200, query_num should be positive\n");
+    exit(0);
+  }
+  int64_t mid = list_len / 2;
+  printf ("list_length %" PRId64 ", query %d, LIndex(%" PRId64 ") and LRange(%" PRId64 ", %" PRId64 ")\n",
+          list_len, cnt, mid, mid, mid + 100);
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  n = new Nemo("./tmp_list_index/", options);
+  db = n->GetDBByType(LIST_DB);
+
+  string key = "bench_list_linked";
+  WriteLinked(key);
+
+  int64_t st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    WalkLinked(key, mid, mid);
+  }
+  Report("linked", "LIndex", NowMicros() - st);
+
+  st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    WalkLinked(key, mid, mid + 100);
+  }
+  Report("linked", "LRange", NowMicros() - st);
+
+  st = NowMicros();
+  Status s = n->LConvert(key);
+  if (!s.ok()) {
+    log_err("LConvert failed, %s", s.ToString().c_str());
+  }
+  printf ("  LConvert of %" PRId64 " elements took %.3lf s\n", list_len, (double)(NowMicros() - st) / 1000000);
+
+  string val;
+  st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    n->LIndex(key, mid, &val);
+  }
+  Report("indexed", "LIndex", NowMicros() - st);
+
+  st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    vector<IV> ivs;
+    n->LRange(key, mid, mid + 100, ivs);
+  }
+  Report("indexed", "LRange", NowMicros() - st);
+
+  n->LTrim(key, 1, 0);
+  delete n;
+
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <ctime>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Count the meta version lookups per HSet/ZAdd/SAdd, with the meta cache
+// disabled and enabled. misses are the lookups that reach rocksdb.
+
+int cnt;
+int key_num;
+int length;
+
+void Report(const char *name, rocksdb::DBNemo *db, const rocksdb::NemoMetaCacheStats &before, int64_t used) {
+  rocksdb::NemoMetaCacheStats after;
+  db->GetMetaCacheStats(&after);
+
+  uint64_t lookups = after.lookups - before.lookups;
+  uint64_t hits = after.hits - before.hits;
+  uint64_t misses = after.misses - before.misses;
+  printf ("  %-5s lookups/op %6.3lf, rocksdb gets/op %6.3lf, hit %6.2lf%%, evictions %10lu, entries %10lu, QPS %10.3lf\n",
+          name, (double)lookups / cnt, (double)misses / cnt,
+          lookups == 0 ? 0.0 : 100.0 * hits / lookups,
+          after.evictions - before.evictions, after.entries,
+          (double)1000000.0 * cnt / used);
+}
+
+void Run(const string &path, int capacity) {
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  options.meta_cache_capacity = capacity;
+
+  Nemo *n = new Nemo(path, options);
+  unsigned int seed = 1;
+  char member[1024];
+  char value[1024];
+  rocksdb::NemoMetaCacheStats before;
+  int64_t st;
+  Status s;
+
+  printf ("meta_cache_capacity %d\n", capacity);
+
+  rocksdb::DBNemo *db = n->GetDBByType(HASH_DB);
+  db->GetMetaCacheStats(&before);
+  st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    string key = "hash_key:" + to_string(rand_r(&seed) % key_num);
+    gen_random(member, length, &seed);
+    gen_random(value, length, &seed);
+    int res;
+    s = n->HSet(key, member, value, &res);
+  }
+  Report("HSet", db, before, NowMicros() - st);
+
+  db = n->GetDBByType(ZSET_DB);
+  db->GetMetaCacheStats(&before);
+  st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    string key = "zset_key:" + to_string(rand_r(&seed) % key_num);
+    gen_random(member, length, &seed);
+    int64_t res;
+    s = n->ZAdd(key, rand_r(&seed) % 10000, member, &res);
+  }
+  Report("ZAdd", db, before, NowMicros() - st);
+
+  db = n->GetDBByType(SET_DB);
+  db->GetMetaCacheStats(&before);
+  st = NowMicros();
+  for (int i = 0; i < cnt; i++) {
+    string key = "set_key:" + to_string(rand_r(&seed) % key_num);
+    gen_random(member, length, &seed);
+    int64_t res;
+    s = n->SAdd(key, member, &res);
+  }
+  Report("SAdd", db, before, NowMicros() - st);
+
+  delete n;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 4) {
+    printf ("Usage: ./bench_meta_cache query_num key_num member_length\n");
+    exit(0);
+  }
+
+  char *pend;
+  cnt = strtol(argv[1], &pend, 10);
+  key_num = strtol(argv[2], &pend, 10);
+  length = strtol(argv[3], &pend, 10);
+  if (length <= 0 || length >= 1024) {
+    printf ("member_length should be in (0, 1024)\n");
+    exit(0);
+  }
+
+  printf ("query %d, key_num is %d, member_length is %d\n", cnt, key_num, length);
+
+  Run("./tmp_meta_cache_off/", 0);
+  Run("./tmp_meta_cache_on/", 256 * 1024);
+
+  return 0;
+}
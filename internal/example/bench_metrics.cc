@@ -0,0 +1,109 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Throughput and latency of Set, Get and HSet from thread_num threads with
+// the metrics off, on, and on with a PerfContext sample of one call in 100,
+// the overhead of the metrics, then the metrics recorded by the last run.
+void Worker(Nemo *n, int id, int64_t op_num, int64_t key_num, vector<int64_t> *used) {
+  string val(100, 'v');
+  string getval;
+  int hres;
+  unsigned int seed = id;
+  used->reserve(op_num);
+  for (int64_t i = 0; i < op_num; i++) {
+    string key = "bench_metrics_" + to_string(rand_r(&seed) % key_num);
+    int64_t st = NowMicros();
+    switch (i % 3) {
+      case 0:
+        n->Set(key, val);
+        break;
+      case 1:
+        n->Get(key, &getval);
+        break;
+      default:
+        n->HSet(key, "f", val, &hres);
+        break;
+    }
+    used->push_back(NowMicros() - st);
+  }
+}
+
+void Run(Nemo *n, const char *mode, int thread_num, int64_t op_num, int64_t key_num) {
+  vector<vector<int64_t> > used(thread_num);
+  vector<thread> threads;
+  int64_t st = NowMicros();
+  for (int t = 0; t < thread_num; t++) {
+    threads.push_back(thread(Worker, n, t, op_num, key_num, &used[t]));
+  }
+  for (int t = 0; t < thread_num; t++) {
+    threads[t].join();
+  }
+  int64_t elapsed = NowMicros() - st;
+
+  vector<int64_t> all;
+  for (int t = 0; t < thread_num; t++) {
+    all.insert(all.end(), used[t].begin(), used[t].end());
+  }
+  sort(all.begin(), all.end());
+  size_t cnt = all.size();
+  printf ("%-12s %10.0f ops/s, p50 %5" PRId64 " us p99 %5" PRId64 " us p999 %6" PRId64 " us\n",
+          mode, cnt * 1000000.0 / elapsed, all[cnt / 2], all[cnt * 99 / 100], all[cnt * 999 / 1000]);
+}
+
+int main(int argc, char* argv[]) {
+  int thread_num = 8;
+  int64_t op_num = 300000;
+  int64_t key_num = 100000;
+  if (argc > 1) {
+    thread_num = strtol(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    op_num = strtoll(argv[2], NULL, 10);
+  }
+  if (thread_num <= 0 || op_num <= 0) {
+    printf ("Usage: ./bench_metrics [thread_num] [op_num per thread]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  Nemo *n = new Nemo("./tmp_metrics/", options);
+
+  // warm the memtables and the meta cache first
+  Run(n, "warmup", thread_num, op_num / 4, key_num);
+  n->EnableMetrics(false);
+  Run(n, "off", thread_num, op_num, key_num);
+  n->EnableMetrics(true, 0);
+  Run(n, "on", thread_num, op_num, key_num);
+  n->EnableMetrics(true, 100);
+  n->ResetMetrics();
+  Run(n, "on+perf", thread_num, op_num, key_num);
+
+  vector<CommandMetrics> metrics;
+  n->GetMetrics(&metrics);
+  for (size_t i = 0; i < metrics.size(); i++) {
+    const CommandMetrics &m = metrics[i];
+    printf ("  %-6s calls %9" PRIu64 " avg %5" PRIu64 " us p99 %5" PRIu64 " us max %7" PRIu64
+            " us, lock waits %7" PRIu64 " p99 %5" PRIu64 " us, gets %8" PRIu64 " meta gets %7" PRIu64
+            ", perf samples %6" PRIu64 " memtable get %6" PRIu64 " ns wal %6" PRIu64 " ns\n",
+            m.name.c_str(), m.calls, m.micros / m.calls, m.p99, m.max,
+            m.lock_waits, m.lock_wait_p99, m.gets, m.meta_gets, m.perf_samples,
+            m.perf_samples ? m.perf_memtable_get_nanos / m.perf_samples : 0,
+            m.perf_samples ? m.perf_wal_nanos / m.perf_samples : 0);
+  }
+  delete n;
+  return 0;
+}
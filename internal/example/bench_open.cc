@@ -0,0 +1,87 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Startup time of a Nemo whose dbs all have a WAL to replay.
+//   ./bench_open write [mb per db]  fills the memtables of every db, then
+//                                   exits without closing, the WALs kept
+//   ./bench_open open [lazy]        times Nemo::Open, and the open of each
+//                                   db against the sum of them
+const char *kPath = "./tmp_open/";
+
+void Write(int64_t mb) {
+  nemo::Options options;
+  // large enough that nothing is flushed, all is left to the WALs
+  options.write_buffer_size = (mb + 64) * 1024 * 1024;
+  Nemo *n = new Nemo(kPath, options);
+  string val(1000, 'v');
+  int64_t num = mb * 1024;
+  int64_t res;
+  int hres;
+  rocksdb::WriteOptions wopts;
+  for (int64_t i = 0; i < num; i++) {
+    string key = "bench_open_" + to_string(i);
+    n->Set(key, val);
+    n->HSet("bench_open_hash", key, val, &hres);
+    n->RPush("bench_open_list", val, &res);
+    n->ZAdd("bench_open_zset", i, key + val, &res);
+    n->SAdd("bench_open_set", key + val, &res);
+    n->GetMetaHandle()->Put(wopts, key, val);
+    n->GetRaftHandle()->Put(wopts, key, val);
+  }
+  printf ("wrote %" PRId64 " MB to each db of %s\n", mb, kPath);
+  // no delete, the memtables are not flushed
+  _exit(0);
+}
+
+void Open(bool lazy) {
+  nemo::Options options;
+  options.lazy_open = lazy;
+  Nemo *n = NULL;
+  int64_t st = NowMicros();
+  Status s = Nemo::Open(kPath, options, &n);
+  int64_t wall = NowMicros() - st;
+  if (!s.ok()) {
+    printf ("open %s failed, %s\n", kPath, s.ToString().c_str());
+    exit(-1);
+  }
+
+  vector<DBOpenStats> stats;
+  n->GetOpenStats(&stats);
+  int64_t sum = 0;
+  for (size_t i = 0; i < stats.size(); i++) {
+    if (stats[i].deferred) {
+      printf ("  %-6s deferred\n", stats[i].type.c_str());
+      continue;
+    }
+    printf ("  %-6s %8.1f ms, %8.1f MB of WAL\n", stats[i].type.c_str(),
+            stats[i].micros / 1000.0, stats[i].wal_bytes / 1048576.0);
+    sum += stats[i].micros;
+  }
+  printf ("open %8.1f ms, %8.1f ms one after another\n", wall / 1000.0, sum / 1000.0);
+  delete n;
+}
+
+int main(int argc, char* argv[]) {
+  if (argc > 1 && strcmp(argv[1], "write") == 0) {
+    Write(argc > 2 ? strtoll(argv[2], NULL, 10) : 64);
+  } else if (argc > 1 && strcmp(argv[1], "open") == 0) {
+    Open(argc > 2 && strcmp(argv[2], "lazy") == 0);
+  } else {
+    printf ("Usage: ./bench_open write [mb per db] | open [lazy]\n");
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdlib.h>
+#include <math.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Throughput of Set, Get, HSet and ZAdd from thread_num threads over Zipf
+// keys with the key profiler off, then sampling 1%, 10% and 100% of the
+// calls, the overhead of each, then the hot and big keys of the last run.
+void Worker(Nemo *n, int id, int64_t op_num, int64_t key_num) {
+  string val(100, 'v');
+  string getval;
+  int hres;
+  int64_t zres;
+  unsigned int seed = id;
+  for (int64_t i = 0; i < op_num; i++) {
+    // Zipf: key k is called in proportion to 1 / (k + 1)
+    int64_t k = static_cast<int64_t>(exp(rand_r(&seed) / (RAND_MAX + 1.0) * log(key_num))) - 1;
+    string key = "bench_profiler_" + to_string(k);
+    string field = to_string(rand_r(&seed) % 1000);
+    switch (i % 4) {
+      case 0:
+        n->Set(key, val);
+        break;
+      case 1:
+        n->Get(key, &getval);
+        break;
+      case 2:
+        n->HSet(key, field, val, &hres);
+        break;
+      default:
+        n->ZAdd(key, i, field, &zres);
+        break;
+    }
+  }
+}
+
+double Run(Nemo *n, const char *mode, int thread_num, int64_t op_num, int64_t key_num, double base) {
+  vector<thread> threads;
+  int64_t st = NowMicros();
+  for (int t = 0; t < thread_num; t++) {
+    threads.push_back(thread(Worker, n, t, op_num, key_num));
+  }
+  for (int t = 0; t < thread_num; t++) {
+    threads[t].join();
+  }
+  double ops = thread_num * op_num * 1000000.0 / (NowMicros() - st);
+  if (base > 0) {
+    printf ("%-8s %10.0f ops/s, overhead %5.1f%%\n", mode, ops, (base - ops) * 100 / base);
+  } else {
+    printf ("%-8s %10.0f ops/s\n", mode, ops);
+  }
+  return ops;
+}
+
+int main(int argc, char* argv[]) {
+  int thread_num = 8;
+  int64_t op_num = 200000;
+  int64_t key_num = 100000;
+  if (argc > 1) {
+    thread_num = strtol(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    op_num = strtoll(argv[2], NULL, 10);
+  }
+  if (thread_num <= 0 || op_num <= 0) {
+    printf ("Usage: ./bench_profiler [thread_num] [op_num per thread]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  Nemo *n = new Nemo("./tmp_profiler/", options);
+
+  // warm the memtables and the meta cache first
+  Run(n, "warmup", thread_num, op_num / 4, key_num, 0);
+  n->EnableKeyProfiler(false);
+  double base = Run(n, "off", thread_num, op_num, key_num, 0);
+  n->EnableKeyProfiler(true, 100);
+  Run(n, "1%", thread_num, op_num, key_num, base);
+  n->EnableKeyProfiler(true, 10);
+  Run(n, "10%", thread_num, op_num, key_num, base);
+  n->EnableKeyProfiler(true, 1);
+  n->ResetKeyProfile();
+  Run(n, "100%", thread_num, op_num, key_num, base);
+
+  KeyProfile profile;
+  n->GetKeyProfile(&profile);
+  printf ("samples %" PRIu64 " dropped %" PRIu64 "\n", profile.samples, profile.dropped);
+  for (size_t i = 0; i < profile.hot_keys.size() && i < 10; i++) {
+    const ProfiledKey &k = profile.hot_keys[i];
+    printf ("  hot %-5s %-24s calls %8" PRIu64 " (+-%" PRIu64 ") avg %5" PRIu64 " us\n",
+            k.type.c_str(), k.key.c_str(), k.calls, k.error, k.micros / k.calls);
+  }
+  for (size_t i = 0; i < profile.big_keys.size() && i < 10; i++) {
+    const ProfiledKey &k = profile.big_keys[i];
+    printf ("  big %-5s %-24s len %8" PRId64 " vol %10" PRId64 "\n",
+            k.type.c_str(), k.key.c_str(), k.len, k.vol);
+  }
+  delete n;
+  return 0;
+}
@@ -0,0 +1,103 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// RangeDel of the middle half of key_num kvs and key_num / 10 hashes of 10
+// fields, with and without the sst files fast path, then reads of random
+// kvs and hashes inside and outside of the range, under the range
+// tombstones and once they were compacted away
+string Key(int64_t i) {
+  char buf[32];
+  snprintf (buf, sizeof(buf), "bench_range_del_%010" PRId64, i);
+  return buf;
+}
+
+void Load(Nemo *n, int64_t key_num) {
+  string val(100, 'v');
+  vector<KV> kvs;
+  int hres;
+  for (int64_t i = 0; i < key_num; i++) {
+    kvs.push_back({Key(i), val});
+    if (kvs.size() == 1000 || i == key_num - 1) {
+      n->MSet(kvs);
+      kvs.clear();
+    }
+    if (i % 10 == 0) {
+      for (int f = 0; f < 10; f++) {
+        n->HSet(Key(i), to_string(f), val, &hres);
+      }
+    }
+  }
+  n->Compact(kALL, true);
+}
+
+void Reads(Nemo *n, int64_t key_num, int cnt, const char *when) {
+  string val;
+  vector<FV> fvs;
+  int64_t found = 0;
+  int64_t st = NowMicros();
+  for (int r = 0; r < cnt; r++) {
+    if (n->Get(Key(rand() % key_num), &val).ok()) {
+      found++;
+    }
+  }
+  int64_t get_used = NowMicros() - st;
+  st = NowMicros();
+  for (int r = 0; r < cnt; r++) {
+    fvs.clear();
+    n->HGetall(Key(rand() % key_num / 10 * 10), fvs);
+  }
+  int64_t hgetall_used = NowMicros() - st;
+  printf ("  %-22s Get %8.3lf us (%" PRId64 " of %d found) HGetall %8.3lf us\n", when,
+          (double)get_used / cnt, found, cnt, (double)hgetall_used / cnt);
+}
+
+int main(int argc, char* argv[]) {
+  int64_t key_num = 1000000;
+  int cnt = 100000;
+  if (argc > 1) {
+    key_num = strtoll(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    cnt = strtol(argv[2], NULL, 10);
+  }
+  if (key_num <= 0 || cnt <= 0) {
+    printf ("Usage: ./bench_range_del [key_num] [read_num]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  bool delete_files[] = {false, true};
+  for (int d = 0; d < 2; d++) {
+    Nemo *n = new Nemo("./tmp_range_del_" + to_string(d) + "/", options);
+    Load(n, key_num);
+    printf ("%" PRId64 " keys, delete_files %d\n", key_num, delete_files[d]);
+    Reads(n, key_num, cnt, "before");
+
+    int64_t st = NowMicros();
+    if (delete_files[d]) {
+      n->RangeDelFiles(Key(key_num / 4), Key(key_num / 4 * 3));
+    } else {
+      n->RangeDel(Key(key_num / 4), Key(key_num / 4 * 3));
+    }
+    printf ("  RangeDel %10.3lf ms\n", (double)(NowMicros() - st) / 1000);
+    Reads(n, key_num, cnt, "under tombstones");
+
+    n->Compact(kALL, true);
+    Reads(n, key_num, cnt, "compacted");
+    delete n;
+  }
+  return 0;
+}
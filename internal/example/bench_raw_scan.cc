@@ -0,0 +1,100 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// RawScanSaveAll of a range of key_num kvs and key_num / 10 hashes, sets
+// and zsets of 10 members, the values sized so that the range holds about
+// data_mb MB, then IngestFile of the files into an empty db
+string Key(int64_t i) {
+  char buf[32];
+  snprintf (buf, sizeof(buf), "bench_raw_scan_%010" PRId64, i);
+  return buf;
+}
+
+void Load(Nemo *n, int64_t key_num, const string &val) {
+  vector<KV> kvs;
+  int hres;
+  int64_t res;
+  for (int64_t i = 0; i < key_num; i++) {
+    kvs.push_back({Key(i), val});
+    if (kvs.size() == 1000 || i == key_num - 1) {
+      n->MSet(kvs);
+      kvs.clear();
+    }
+    if (i % 10 == 0) {
+      vector<string> members;
+      vector<SM> sms;
+      for (int f = 0; f < 10; f++) {
+        n->HSet(Key(i), to_string(f), val, &hres);
+        members.push_back(to_string(f) + val);
+        sms.push_back({(double)f, to_string(f) + val});
+      }
+      n->SMAdd(Key(i), members, &res);
+      n->ZMAdd(Key(i), sms, &res);
+    }
+  }
+  n->Compact(kALL, true);
+}
+
+int main(int argc, char* argv[]) {
+  int64_t data_mb = 10 * 1024;
+  int64_t key_num = 10000000;
+  if (argc > 1) {
+    data_mb = strtoll(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    key_num = strtoll(argv[2], NULL, 10);
+  }
+  if (data_mb <= 0 || key_num <= 0) {
+    printf ("Usage: ./bench_raw_scan [data_mb] [key_num]\n");
+    exit(0);
+  }
+  // each key writes 4 values: its kv and a tenth of its hash, set and zset
+  int64_t val_size = data_mb * 1024 * 1024 / key_num / 4;
+  if (val_size < 1) {
+    val_size = 1;
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 64 * 1024 * 1024;
+  Nemo *n = new Nemo("./tmp_raw_scan_src/", options);
+  Load(n, key_num, string(val_size, 'v'));
+  printf ("%" PRId64 " keys, %" PRId64 " bytes values, about %" PRId64 " MB\n",
+          key_num, val_size, data_mb);
+
+  int64_t st = NowMicros();
+  Status s = n->RawScanSaveAll("./tmp_raw_scan_files", Key(0), Key(key_num), true);
+  int64_t used = NowMicros() - st;
+  printf ("  RawScanSaveAll %s %10.3lf s %10.3lf MB/s\n", s.ToString().c_str(),
+          (double)used / 1000000, (double)data_mb * 1000000 / used);
+  delete n;
+
+  n = new Nemo("./tmp_raw_scan_dst/", options);
+  st = NowMicros();
+  s = n->IngestFile("./tmp_raw_scan_files");
+  used = NowMicros() - st;
+  printf ("  IngestFile     %s %10.3lf s %10.3lf MB/s\n", s.ToString().c_str(),
+          (double)used / 1000000, (double)data_mb * 1000000 / used);
+
+  string val;
+  int64_t found = 0;
+  for (int r = 0; r < 1000; r++) {
+    if (n->Get(Key(rand() % key_num), &val).ok()) {
+      found++;
+    }
+  }
+  printf ("  %" PRId64 " of 1000 random kvs found after the ingest\n", found);
+  delete n;
+  return 0;
+}
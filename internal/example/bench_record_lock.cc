@@ -0,0 +1,188 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cmath>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "port.h"
+#include "bench_util.h"
+
+using namespace std;
+
+// Per-key lock throughput from 1 to 64 threads, uniform and zipfian keys.
+// "map" is the old RecordMutex design: one global mutex guarding a map of
+// refcounted per-key mutexes; "stripe" is nemo::port::RecordMutex and
+// "exact" is it with a mutex per key in the overflow maps of the stripes.
+
+int cnt;
+int key_num;
+
+class MapRecordMutex {
+public:
+  MapRecordMutex() { pthread_mutex_init(&mutex_, NULL); }
+  ~MapRecordMutex() { pthread_mutex_destroy(&mutex_); }
+
+  void Lock(const string &key) {
+    pthread_mutex_lock(&mutex_);
+    RefMutex *ref;
+    unordered_map<string, RefMutex *>::iterator it = records_.find(key);
+    if (it != records_.end()) {
+      ref = it->second;
+    } else {
+      ref = new RefMutex;
+      records_.insert(make_pair(key, ref));
+    }
+    ref->refs++;
+    pthread_mutex_unlock(&mutex_);
+
+    pthread_mutex_lock(&ref->mu);
+  }
+
+  void Unlock(const string &key) {
+    pthread_mutex_lock(&mutex_);
+    unordered_map<string, RefMutex *>::iterator it = records_.find(key);
+    if (it != records_.end()) {
+      RefMutex *ref = it->second;
+      pthread_mutex_unlock(&ref->mu);
+      if (--ref->refs == 0) {
+        records_.erase(it);
+        delete ref;
+      }
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+
+private:
+  struct RefMutex {
+    RefMutex() : refs(0) { pthread_mutex_init(&mu, NULL); }
+    ~RefMutex() { pthread_mutex_destroy(&mu); }
+    pthread_mutex_t mu;
+    int refs;
+  };
+
+  pthread_mutex_t mutex_;
+  unordered_map<string, RefMutex *> records_;
+};
+
+// Zipfian key ranks with theta 0.99, same construction as YCSB
+class Zipfian {
+public:
+  Zipfian(int n, double theta) : n_(n), theta_(theta) {
+    zetan_ = 0;
+    for (int i = 1; i <= n; i++) {
+      zetan_ += 1.0 / pow(i, theta);
+    }
+    double zeta2 = 1.0 + 1.0 / pow(2, theta);
+    alpha_ = 1.0 / (1.0 - theta);
+    eta_ = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan_);
+  }
+
+  int Next(unsigned int *seedp) const {
+    double u = (double)rand_r(seedp) / RAND_MAX;
+    double uz = u * zetan_;
+    if (uz < 1.0) return 0;
+    if (uz < 1.0 + pow(0.5, theta_)) return 1;
+    int r = (int)(n_ * pow(eta_ * u - eta_ + 1, alpha_));
+    return r < n_ ? r : n_ - 1;
+  }
+
+private:
+  int n_;
+  double theta_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+};
+
+struct Arg {
+  vector<string> *keys;
+  vector<int> ranks;
+  MapRecordMutex *map_mu;
+  nemo::port::RecordMutex *stripe_mu;
+  uint64_t counter;
+};
+
+void *ThreadMain(void *p) {
+  Arg *arg = reinterpret_cast<Arg *>(p);
+  for (size_t i = 0; i < arg->ranks.size(); i++) {
+    const string &key = (*arg->keys)[arg->ranks[i]];
+    if (arg->map_mu != NULL) {
+      arg->map_mu->Lock(key);
+      arg->counter++;
+      arg->map_mu->Unlock(key);
+    } else {
+      nemo::port::RecordMutex::Held held = arg->stripe_mu->Lock(key);
+      arg->counter++;
+      arg->stripe_mu->Unlock(held);
+    }
+  }
+  return NULL;
+}
+
+void Run(const char *dist, const char *name, int thread_num, vector<string> *keys, const Zipfian *zipf) {
+  MapRecordMutex map_mu;
+  nemo::port::RecordMutex stripe_mu(nemo::port::RecordMutex::kDefaultStripes, name[0] == 'e');
+  vector<Arg> args(thread_num);
+  vector<pthread_t> tids(thread_num);
+
+  for (int t = 0; t < thread_num; t++) {
+    unsigned int seed = t + 1;
+    args[t].keys = keys;
+    args[t].map_mu = name[0] == 'm' ? &map_mu : NULL;
+    args[t].stripe_mu = &stripe_mu;
+    args[t].counter = 0;
+    args[t].ranks.reserve(cnt / thread_num);
+    for (int i = 0; i < cnt / thread_num; i++) {
+      args[t].ranks.push_back(zipf != NULL ? zipf->Next(&seed) : rand_r(&seed) % key_num);
+    }
+  }
+
+  int64_t st = NowMicros();
+  for (int t = 0; t < thread_num; t++) {
+    pthread_create(&tids[t], NULL, ThreadMain, &args[t]);
+  }
+  for (int t = 0; t < thread_num; t++) {
+    pthread_join(tids[t], NULL);
+  }
+  int64_t used = NowMicros() - st;
+
+  printf ("  %-7s %-6s threads %2d, QPS %12.3lf\n", dist, name, thread_num,
+          (double)1000000.0 * (cnt / thread_num * thread_num) / used);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf ("Usage: ./bench_record_lock query_num key_num\n");
+    exit(0);
+  }
+
+  char *pend;
+  cnt = strtol(argv[1], &pend, 10);
+  key_num = strtol(argv[2], &pend, 10);
+  if (key_num <= 0) {
+    printf ("key_num should be positive\n");
+    exit(0);
+  }
+
+  printf ("query %d, key_num is %d\n", cnt, key_num);
+
+  vector<string> keys;
+  for (int i = 0; i < key_num; i++) {
+    keys.push_back("record_key:" + to_string(i));
+  }
+  Zipfian zipf(key_num, 0.99);
+
+  for (int thread_num = 1; thread_num <= 64; thread_num *= 2) {
+    Run("uniform", "map", thread_num, &keys, NULL);
+    Run("uniform", "stripe", thread_num, &keys, NULL);
+    Run("uniform", "exact", thread_num, &keys, NULL);
+    Run("zipfian", "map", thread_num, &keys, &zipf);
+    Run("zipfian", "stripe", thread_num, &keys, &zipf);
+    Run("zipfian", "exact", thread_num, &keys, &zipf);
+  }
+
+  return 0;
+}
@@ -0,0 +1,131 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <stdlib.h>
+#include <math.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Throughput, latency and hit ratio of Get and HGet from thread_num threads
+// over Zipf keys, with the row caches of the kv and hash dbs off, on, and on
+// with one HSet or Set in 10 calls, which refresh the cached values.
+const int kFields = 10;
+
+void Worker(Nemo *n, int id, int64_t op_num, int64_t key_num, int write_every, vector<int64_t> *used) {
+  string val(100, 'v');
+  string getval;
+  int hres;
+  unsigned int seed = id;
+  used->reserve(op_num);
+  for (int64_t i = 0; i < op_num; i++) {
+    // Zipf: key k is called in proportion to 1 / (k + 1)
+    int64_t k = static_cast<int64_t>(exp(rand_r(&seed) / (RAND_MAX + 1.0) * log(key_num))) - 1;
+    string key = "bench_row_cache_" + to_string(k);
+    string field = "field_" + to_string(k % kFields);
+    bool write = write_every > 0 && i % write_every == 0;
+    int64_t st = NowMicros();
+    if (i % 2 == 0) {
+      if (write) {
+        n->Set(key, val);
+      } else {
+        n->Get(key, &getval);
+      }
+    } else {
+      if (write) {
+        n->HSet(key, field, val, &hres);
+      } else {
+        n->HGet(key, field, &getval);
+      }
+    }
+    used->push_back(NowMicros() - st);
+  }
+}
+
+void Run(Nemo *n, const char *mode, int thread_num, int64_t op_num, int64_t key_num, int write_every) {
+  rocksdb::NemoRowCacheStats before, after;
+  n->GetRowCacheStats(&before);
+  vector<vector<int64_t> > used(thread_num);
+  vector<thread> threads;
+  int64_t st = NowMicros();
+  for (int t = 0; t < thread_num; t++) {
+    threads.push_back(thread(Worker, n, t, op_num, key_num, write_every, &used[t]));
+  }
+  for (int t = 0; t < thread_num; t++) {
+    threads[t].join();
+  }
+  int64_t elapsed = NowMicros() - st;
+  n->GetRowCacheStats(&after);
+
+  vector<int64_t> all;
+  for (int t = 0; t < thread_num; t++) {
+    all.insert(all.end(), used[t].begin(), used[t].end());
+  }
+  sort(all.begin(), all.end());
+  size_t cnt = all.size();
+  uint64_t lookups = after.lookups - before.lookups;
+  uint64_t hits = after.hits - before.hits;
+  printf ("%-10s %10.0f ops/s, p50 %5" PRId64 " us p99 %5" PRId64 " us, hit %6.2f%%, entries %8" PRIu64
+          " usage %10" PRIu64 " evictions %8" PRIu64 "\n",
+          mode, cnt * 1000000.0 / elapsed, all[cnt / 2], all[cnt * 99 / 100],
+          lookups == 0 ? 0.0 : 100.0 * hits / lookups, after.entries, after.usage,
+          after.evictions - before.evictions);
+}
+
+int main(int argc, char* argv[]) {
+  int thread_num = 8;
+  int64_t op_num = 200000;
+  int64_t key_num = 1000000;
+  uint64_t capacity = 64 << 20;
+  if (argc > 1) {
+    thread_num = strtol(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    op_num = strtoll(argv[2], NULL, 10);
+  }
+  if (argc > 3) {
+    capacity = strtoull(argv[3], NULL, 10);
+  }
+  if (thread_num <= 0 || op_num <= 0) {
+    printf ("Usage: ./bench_row_cache [thread_num] [op_num per thread] [capacity bytes per db]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  Nemo *n = new Nemo("./tmp_row_cache/", options);
+  string val(100, 'v');
+  int hres;
+  for (int64_t k = 0; k < key_num; k++) {
+    string key = "bench_row_cache_" + to_string(k);
+    n->Set(key, val);
+    n->HSet(key, "field_" + to_string(k % kFields), val, &hres);
+  }
+  n->Compact(kALL, true);
+
+  rocksdb::DBNemo *kv_db = n->GetDBByType(KV_DB);
+  rocksdb::DBNemo *hash_db = n->GetDBByType(HASH_DB);
+  // warm the block cache and the meta cache first
+  Run(n, "warmup", thread_num, op_num / 4, key_num, 0);
+  kv_db->SetRowCacheCapacity(0);
+  hash_db->SetRowCacheCapacity(0);
+  Run(n, "off", thread_num, op_num, key_num, 0);
+  kv_db->SetRowCacheCapacity(capacity);
+  hash_db->SetRowCacheCapacity(capacity);
+  Run(n, "on", thread_num, op_num, key_num, 0);
+  Run(n, "on+writes", thread_num, op_num, key_num, 10);
+
+  uint64_t usage;
+  n->GetUsage(USAGE_TYPE_NEMO, &usage);
+  printf ("nemo usage %" PRIu64 " bytes\n", usage);
+  delete n;
+  return 0;
+}
@@ -0,0 +1,144 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <new>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "rocksdb/perf_context.h"
+#include "rocksdb/perf_level.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// HGetall, SMembers, ZRange and KScan of a key of 1000, 10000 and 100000
+// entries, the key after it deleted, with the bytes rocksdb read from blocks,
+// the block cache hits, the entries it skipped and the allocations per entry
+Nemo *n;
+int cnt;
+int64_t allocs;
+
+void *operator new(size_t size) {
+  allocs++;
+  void *p = malloc(size ? size : 1);
+  if (p == NULL) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+int64_t st, st_allocs;
+
+void Start() {
+  rocksdb::perf_context.Reset();
+  st_allocs = allocs;
+  st = NowMicros();
+}
+
+void Report(int entries, const char *op, int64_t res) {
+  int64_t used = NowMicros() - st;
+  double total = (double)res * cnt;
+  printf ("  %-7d entries %-9s %8.3lf ms per scan, %8.1lf block bytes, %6.3lf cache hits, "
+          "%6.3lf skipped, %6.3lf allocs per entry\n",
+          entries, op, (double)used / cnt / 1000,
+          rocksdb::perf_context.block_read_byte / total,
+          rocksdb::perf_context.block_cache_hit_count / total,
+          (rocksdb::perf_context.internal_key_skipped_count +
+           rocksdb::perf_context.internal_delete_skipped_count) / total,
+          (allocs - st_allocs) / total);
+}
+
+int main(int argc, char* argv[]) {
+  cnt = 3;
+  if (argc > 1) {
+    cnt = strtol(argv[1], NULL, 10);
+  }
+  if (cnt <= 0) {
+    printf ("Usage: ./bench_scan [round_num]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  n = new Nemo("./tmp_scan/", options);
+  rocksdb::SetPerfLevel(rocksdb::kEnableCount);
+
+  int sizes[] = {1000, 10000, 100000};
+  for (int z = 0; z < 3; z++) {
+    int entries = sizes[z];
+    string key = "bench_scan_" + to_string(entries);
+    // the deleted key sorts right after key in every db
+    string next = key + "_";
+    int hres;
+    int64_t res;
+    vector<SM> sms;
+    vector<string> members;
+    for (int i = 0; i < entries; i++) {
+      string member = "member_" + to_string(i);
+      n->HSet(key, member, string(100, 'v'), &hres);
+      n->HSet(next, member, string(100, 'v'), &hres);
+      n->Set(key + "_kv_" + to_string(i), string(100, 'v'));
+      sms.push_back({(double)i, member});
+      members.push_back(member);
+      if (sms.size() == 1000) {
+        n->ZMAdd(key, sms, &res);
+        n->ZMAdd(next, sms, &res);
+        n->SMAdd(key, members, &res);
+        n->SMAdd(next, members, &res);
+        sms.clear();
+        members.clear();
+      }
+    }
+    n->Del(next, &res);
+    // deleted kv keys right after the scanned ones
+    for (int i = 0; i < entries; i++) {
+      n->Set(key + "_kw_" + to_string(i), string(100, 'v'));
+      n->Del(key + "_kw_" + to_string(i), &res);
+    }
+
+    vector<FV> fvs;
+    Start();
+    for (int r = 0; r < cnt; r++) {
+      fvs.clear();
+      n->HGetall(key, fvs);
+    }
+    Report(entries, "HGetall", fvs.size());
+
+    vector<string> vals;
+    Start();
+    for (int r = 0; r < cnt; r++) {
+      vals.clear();
+      n->SMembers(key, vals);
+    }
+    Report(entries, "SMembers", vals.size());
+
+    Start();
+    for (int r = 0; r < cnt; r++) {
+      sms.clear();
+      n->ZRange(key, entries / 2, -1, sms);
+    }
+    Report(entries, "ZRange", sms.size());
+
+    int64_t scanned = 0;
+    Start();
+    for (int r = 0; r < cnt; r++) {
+      KIteratorRO *it = n->KScanRO(key + "_kv_", key + "_kw_", -1);
+      for (scanned = 0; it->Valid(); it->Next()) {
+        scanned++;
+      }
+      delete it;
+    }
+    Report(entries, "KScan", scanned);
+  }
+
+  delete n;
+  return 0;
+}
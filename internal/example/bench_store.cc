@@ -0,0 +1,103 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// ZUnionStore, ZInterStore, SUnionStore, SInterStore and SDiffStore of 2, 4
+// and 8 source keys of 1000, 10000 and 100000 members each, half of the
+// members of a source shared with the next one, into a destination that
+// already holds the result of the previous round. Past 2 keys the sources
+// share no member, so the intersections stop at the end of the first one
+Nemo *n;
+int cnt;
+
+void Report(int keys, int members, const char *op, int64_t res, int64_t used) {
+  printf ("  %d keys %-7d members %-12s %8" PRId64 " results %10.3lf ms per store\n",
+          keys, members, op, res, (double)used / cnt / 1000);
+}
+
+int main(int argc, char* argv[]) {
+  cnt = 3;
+  if (argc > 1) {
+    cnt = strtol(argv[1], NULL, 10);
+  }
+  if (cnt <= 0) {
+    printf ("Usage: ./bench_store [round_num]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  n = new Nemo("./tmp_store/", options);
+
+  int sizes[] = {1000, 10000, 100000};
+  int key_nums[] = {2, 4, 8};
+  for (int z = 0; z < 3; z++) {
+    int members = sizes[z];
+    vector<string> keys;
+    int64_t res;
+    for (int k = 0; k < 8; k++) {
+      keys.push_back("bench_store_" + to_string(members) + "_" + to_string(k));
+      vector<SM> sms;
+      vector<string> set_members;
+      for (int i = 0; i < members; i++) {
+        string member = "member_" + to_string(k * members / 2 + i);
+        sms.push_back({(double)i, member});
+        set_members.push_back(member);
+        if (sms.size() == 1000) {
+          n->ZMAdd(keys[k], sms, &res);
+          n->SMAdd(keys[k], set_members, &res);
+          sms.clear();
+          set_members.clear();
+        }
+      }
+    }
+
+    for (int j = 0; j < 3; j++) {
+      vector<string> srcs(keys.begin(), keys.begin() + key_nums[j]);
+      vector<double> weights;
+
+      int64_t st = NowMicros();
+      for (int r = 0; r < cnt; r++) {
+        n->ZUnionStore("bench_store_dest", srcs.size(), srcs, weights, SUM, &res);
+      }
+      Report(srcs.size(), members, "ZUnionStore", res, NowMicros() - st);
+
+      st = NowMicros();
+      for (int r = 0; r < cnt; r++) {
+        n->ZInterStore("bench_store_dest", srcs.size(), srcs, weights, SUM, &res);
+      }
+      Report(srcs.size(), members, "ZInterStore", res, NowMicros() - st);
+
+      st = NowMicros();
+      for (int r = 0; r < cnt; r++) {
+        n->SUnionStore("bench_store_dest", srcs, &res);
+      }
+      Report(srcs.size(), members, "SUnionStore", res, NowMicros() - st);
+
+      st = NowMicros();
+      for (int r = 0; r < cnt; r++) {
+        n->SInterStore("bench_store_dest", srcs, &res);
+      }
+      Report(srcs.size(), members, "SInterStore", res, NowMicros() - st);
+
+      st = NowMicros();
+      for (int r = 0; r < cnt; r++) {
+        n->SDiffStore("bench_store_dest", srcs, &res);
+      }
+      Report(srcs.size(), members, "SDiffStore", res, NowMicros() - st);
+    }
+  }
+
+  delete n;
+  return 0;
+}
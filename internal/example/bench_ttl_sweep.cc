@@ -0,0 +1,106 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Size of the sst files of the kv and hash dbs, second after second, once
+// kv keys and hashes written with a 5 seconds ttl expire, and the latency of
+// foreground Get and Set meanwhile. Run with sweep_rate 0 for the baseline
+// without expire sweeper, where only the compactions of the writes reclaim
+// them.
+uint64_t SstSize(Nemo *n, const string &type) {
+  string out;
+  n->GetDBByType(type)->GetProperty("rocksdb.total-sst-files-size", &out);
+  return strtoull(out.c_str(), NULL, 10);
+}
+
+int main(int argc, char* argv[]) {
+  int64_t key_num = 200000;
+  int seconds = 30;
+  int sweep_rate = 10000;
+  if (argc > 1) {
+    key_num = strtoll(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    seconds = strtol(argv[2], NULL, 10);
+  }
+  if (argc > 3) {
+    sweep_rate = strtol(argv[3], NULL, 10);
+  }
+  if (key_num <= 0 || seconds <= 0 || sweep_rate < 0) {
+    printf ("Usage: ./bench_ttl_sweep [key_num] [seconds] [sweep_rate]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  options.expire_sweep_rate = sweep_rate;
+  Nemo *n = new Nemo("./tmp_ttl_sweep/", options);
+
+  string val(1000, 'v');
+  int hres;
+  int64_t res;
+  for (int64_t i = 0; i < key_num; i++) {
+    n->Set("bench_ttl_sweep_" + to_string(i), val, 5);
+    // and one hash of 100 fields per 100 keys
+    if (i % 100 == 0) {
+      string key = "bench_ttl_sweep_h_" + to_string(i);
+      for (int f = 0; f < 100; f++) {
+        n->HSet(key, to_string(f), val, &hres);
+      }
+      n->Expire(key, 5, &res);
+    }
+    // the keys of the foreground
+    if (i % 10 == 0) {
+      n->Set("bench_ttl_sweep_live_" + to_string(i / 10), val);
+    }
+  }
+  n->GetDBByType(KV_DB)->Flush(rocksdb::FlushOptions());
+  n->GetDBByType(HASH_DB)->Flush(rocksdb::FlushOptions());
+  printf ("%" PRId64 " keys with ttl, sweep rate %d\n", key_num, sweep_rate);
+
+  int64_t live_num = key_num / 10;
+  for (int s = 0; s < seconds; s++) {
+    vector<int64_t> get_used, set_used;
+    int64_t end = NowMicros() + 1000000;
+    while (NowMicros() < end) {
+      string key = "bench_ttl_sweep_live_" + to_string(rand() % live_num);
+      string getval;
+      int64_t st = NowMicros();
+      n->Get(key, &getval);
+      get_used.push_back(NowMicros() - st);
+      st = NowMicros();
+      n->Set(key, val);
+      set_used.push_back(NowMicros() - st);
+      usleep(100);
+    }
+    sort(get_used.begin(), get_used.end());
+    sort(set_used.begin(), set_used.end());
+    size_t cnt = get_used.size();
+
+    ExpireStats stats;
+    n->GetExpireStats(&stats);
+    BGTaskStats bg_stats;
+    n->GetBGTaskStats(&bg_stats);
+    printf ("  %3ds kv %8" PRIu64 " KB hash %8" PRIu64 " KB, expired %8" PRIu64
+            " stale %6" PRIu64 " bg pending %6" PRIu64 ", Get p99 %6" PRId64
+            " us Set p99 %6" PRId64 " us\n",
+            s + 1, SstSize(n, KV_DB) / 1024, SstSize(n, HASH_DB) / 1024,
+            stats.expired, stats.stale, bg_stats.pending,
+            get_used[cnt * 99 / 100], set_used[cnt * 99 / 100]);
+  }
+  delete n;
+  return 0;
+}
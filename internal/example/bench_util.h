@@ -0,0 +1,30 @@
+#ifndef NEMO_EXAMPLE_BENCH_UTIL_H_
+#define NEMO_EXAMPLE_BENCH_UTIL_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+// Helpers shared by the bench_* programs
+
+inline int64_t NowMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// len random alphanumeric chars and a NUL into s
+inline void gen_random(char *s, const int len, unsigned int * seedp) {
+  static const char alphanum[] =
+      "0123456789"
+      "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+      "abcdefghijklmnopqrstuvwxyz";
+
+  for (int i = 0; i < len; ++i) {
+    s[i] = alphanum[rand_r(seedp) % (sizeof(alphanum) - 1)];
+  }
+
+  s[len] = 0;
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "nemo_volume_iterator.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Split checks, the key at half the volume of a range, on ranges of 1M, 10M
+// and 100M keys of 100 byte values, up to key_num, by the scan of
+// VolumeIterator::targetScan once and by VolumeIndex::TargetKey cnt times.
+// The first VolumeIndex call merges the samples of all the sst files.
+string Key(int64_t i) {
+  char buf[32];
+  snprintf (buf, sizeof(buf), "bench_volume_%010" PRId64, i);
+  return buf;
+}
+
+int main(int argc, char* argv[]) {
+  int64_t key_num = 1000000;
+  int cnt = 1000;
+  if (argc > 1) {
+    key_num = strtoll(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    cnt = strtol(argv[2], NULL, 10);
+  }
+  if (key_num <= 0 || cnt <= 0) {
+    printf ("Usage: ./bench_volume [key_num] [round_num]\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 64 * 1024 * 1024;
+  Nemo *n = new Nemo("./tmp_volume/", options);
+  string val(100, 'v');
+  vector<KV> kvs;
+  for (int64_t i = 0; i < key_num; i++) {
+    kvs.push_back({Key(i), val});
+    if (kvs.size() == 1000 || i == key_num - 1) {
+      n->MSet(kvs);
+      kvs.clear();
+    }
+  }
+  n->Compact(kALL, true);
+
+  VolumeIndex index(n);
+  int64_t sizes[] = {1000000, 10000000, 100000000};
+  for (int z = 0; z < 3 && (z == 0 || sizes[z] <= key_num); z++) {
+    int64_t range = min(sizes[z], key_num);
+    string start = Key(0), end = Key(range);
+
+    int64_t st = NowMicros();
+    VolumeIterator *it = new VolumeIterator(n, start, end);
+    it->targetScan(1LL << 60);
+    int64_t total = it->totalVolume();
+    delete it;
+    it = new VolumeIterator(n, start, end);
+    it->targetScan(total / 2);
+    string exact_key = it->targetKey();
+    delete it;
+    int64_t scan_used = NowMicros() - st;
+
+    string key;
+    int64_t volume = 0;
+    st = NowMicros();
+    index.Volume(start, end, &volume);
+    index.TargetKey(start, end, volume / 2, &key);
+    int64_t first_used = NowMicros() - st;
+    st = NowMicros();
+    for (int r = 0; r < cnt; r++) {
+      index.Volume(start, end, &volume);
+      index.TargetKey(start, end, volume / 2, &key);
+    }
+    int64_t index_used = NowMicros() - st;
+
+    printf ("%" PRId64 " keys, volume %" PRId64 " exact, %" PRId64 " indexed of %zu samples\n",
+            range, total, volume, index.samples());
+    printf ("  targetScan   %-28s %12.3lf ms\n", exact_key.c_str(), (double)scan_used / 1000);
+    printf ("  VolumeIndex  %-28s %12.3lf ms first, %10.3lf us per split check\n",
+            key.c_str(), (double)first_used / 1000, (double)index_used / cnt);
+  }
+
+  delete n;
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <stdlib.h>
+#include <stdio.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// Throughput of Set and HSet, one of each per op, from 1 to 128 threads,
+// with sync writes off and on, and the write groups off and on, each run on
+// a new Nemo. With the groups on, writes/group is the number of batches one
+// rocksdb write took on average.
+void Worker(Nemo *n, int id, int64_t op_num) {
+  string val(100, 'v');
+  int hres;
+  for (int64_t i = 0; i < op_num; i++) {
+    string key = "bench_write_group_" + to_string(id) + "_" + to_string(i);
+    n->Set(key, val);
+    n->HSet(key, "field", val, &hres);
+  }
+}
+
+void Run(bool sync, bool group, int thread_num, int64_t op_num) {
+  string path = "./tmp_write_group_" + to_string(sync) + to_string(group) + "_" + to_string(thread_num) + "/";
+  nemo::Options options;
+  options.sync_write = sync;
+  options.write_group = group;
+  Nemo *n = new Nemo(path, options);
+
+  vector<thread> threads;
+  int64_t st = NowMicros();
+  for (int t = 0; t < thread_num; t++) {
+    threads.push_back(thread(Worker, n, t, op_num));
+  }
+  for (int t = 0; t < thread_num; t++) {
+    threads[t].join();
+  }
+  int64_t elapsed = NowMicros() - st;
+
+  WriteGroupStats stats;
+  n->GetWriteGroupStats(&stats);
+  uint64_t writes = thread_num * op_num * 2;
+  printf ("sync %d group %d threads %3d %10.0f writes/s, %6.2f writes/group, max %4" PRIu64 "\n",
+          sync, group, thread_num, writes * 1000000.0 / elapsed,
+          stats.groups == 0 ? 0.0 : static_cast<double>(stats.writes) / stats.groups, stats.max_group);
+  delete n;
+}
+
+int main(int argc, char* argv[]) {
+  int64_t op_num = 2000;
+  int max_threads = 128;
+  if (argc > 1) {
+    op_num = strtoll(argv[1], NULL, 10);
+  }
+  if (argc > 2) {
+    max_threads = strtol(argv[2], NULL, 10);
+  }
+  if (op_num <= 0 || max_threads <= 0) {
+    printf ("Usage: ./bench_write_group [op_num per thread] [max thread_num]\n");
+    exit(0);
+  }
+
+  for (int sync = 0; sync < 2; sync++) {
+    for (int thread_num = 1; thread_num <= max_threads; thread_num *= 2) {
+      for (int group = 0; group < 2; group++) {
+        Run(sync, group, thread_num, op_num);
+      }
+    }
+  }
+  return 0;
+}
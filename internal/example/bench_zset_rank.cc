@@ -0,0 +1,117 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <sys/time.h>
+
+#include "nemo.h"
+#include "xdebug.h"
+#include "bench_util.h"
+
+using namespace nemo;
+using namespace std;
+
+// ZRank, ZRevrank and ZRange(mid, mid + 9) latency through the rank index
+// on sets of 1000, 10000, ... members up to max_size, beside the scan from
+// the lowest score that ZRank did before the index
+Nemo *n;
+int cnt;
+
+string Member(int64_t i) {
+  return "member:" + to_string(i);
+}
+
+void Fill(const string &key, int64_t size) {
+  int64_t res;
+  vector<SM> sms;
+  for (int64_t i = 0; i < size; i++) {
+    sms.push_back({(double)(rand() % 1000000), Member(i)});
+    if (sms.size() == 1000 || i == size - 1) {
+      Status s = n->ZMAdd(key, sms, &res);
+      if (!s.ok()) {
+        log_err("ZMAdd failed, %s", s.ToString().c_str());
+      }
+      sms.clear();
+    }
+  }
+}
+
+// How ZRank found a member before the index
+int64_t ScanRank(const string &key, const string &member) {
+  int64_t rank = 0;
+  ZIterator *iter = n->ZScan(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, -1, true);
+  for (; iter->Valid() && iter->member() != member; iter->Next()) {
+    rank++;
+  }
+  delete iter;
+  return rank;
+}
+
+void Report(int64_t size, const char *op, int64_t used) {
+  printf ("  %-10" PRId64 " %-22s avg latency %12.3lf us\n", size, op, (double)used / cnt);
+}
+
+int main(int argc, char* argv[]) {
+  if (argc < 3) {
+    printf ("Usage: ./bench_zset_rank max_size query_num\n");
+    exit(0);
+  }
+
+  char *pend;
+  int64_t max_size = strtoll(argv[1], &pend, 10);
+  cnt = strtol(argv[2], &pend, 10);
+  if (max_size < 1000 || cnt <= 0) {
+    printf ("max_size should be at least 1000, query_num should be positive\n");
+    exit(0);
+  }
+
+  nemo::Options options;
+  options.target_file_size_base = 20 * 1024 * 1024;
+  n = new Nemo("./tmp_zset_rank/", options);
+  srand(1);
+
+  for (int64_t size = 1000; size <= max_size; size *= 10) {
+    string key = "bench_zset_rank_" + to_string(size);
+    int64_t st = NowMicros();
+    Fill(key, size);
+    printf ("size %" PRId64 ", filled in %.3lf s\n", size, (double)(NowMicros() - st) / 1000000);
+
+    vector<string> members;
+    for (int i = 0; i < cnt; i++) {
+      members.push_back(Member(rand() % size));
+    }
+
+    int64_t rank;
+    st = NowMicros();
+    for (int i = 0; i < cnt; i++) {
+      n->ZRank(key, members[i], &rank);
+    }
+    Report(size, "ZRank", NowMicros() - st);
+
+    st = NowMicros();
+    for (int i = 0; i < cnt; i++) {
+      n->ZRevrank(key, members[i], &rank);
+    }
+    Report(size, "ZRevrank", NowMicros() - st);
+
+    st = NowMicros();
+    for (int i = 0; i < cnt; i++) {
+      vector<SM> sms;
+      n->ZRange(key, size / 2, size / 2 + 9, sms);
+    }
+    Report(size, "ZRange(mid, mid + 9)", NowMicros() - st);
+
+    st = NowMicros();
+    for (int i = 0; i < cnt; i++) {
+      ScanRank(key, members[i]);
+    }
+    Report(size, "scan rank", NowMicros() - st);
+
+    int64_t res;
+    n->ZRemrangebyrank(key, 0, -1, &res);
+  }
+
+  delete n;
+  return 0;
+}
@@ -45,7 +45,7 @@ int main()
     int i = 0;
     for (; scan_iter->Valid(); scan_iter->Next()) {
         //log_info("Test Scan key: %s, value: %s", scan_iter->key().c_str(), scan_iter->value().c_str());
-        std::string iter_key = scan_iter->key();
+        std::string iter_key = scan_iter->key().ToString();
         std::cout<< "Test Scan key: " << iter_key << "\n";
         i++;
         if (i>10)
@@ -73,7 +73,7 @@ int main()
     log_info("Scan test-key-TTL iterator!");
 
     for (; scan_iter->Valid(); scan_iter->Next()) {
-        std::string iter_key = scan_iter->key();
+        std::string iter_key = scan_iter->key().ToString();
         std::cout << "Test Scan key: " << iter_key << "\n";
     }
     log_info("Scan test-key-TTL over!");
@@ -23,6 +23,12 @@ typedef rocksdb::Status Status;
 typedef const rocksdb::Snapshot Snapshot;
 typedef std::vector<const rocksdb::Snapshot *> Snapshots;
 
+class ZRankIndex;
+class BGScheduler;
+class ExpireSweeper;
+class Metrics;
+class WriteGroup;
+
 template <typename T1, typename T2>
 struct ItemListMap{
     int64_t cur_size_;
@@ -47,25 +53,160 @@ struct BGTask {
   BGTask(const DBType _type, const OPERATION _op, const std::string &_argv1, const std::string &_argv2)
       : type(_type), op(_op), argv1(_argv1), argv2(_argv2) {}
 };
+
+// Counters of the background tasks, see BGScheduler. A range or a
+// compaction of a whole db added is pending or running until it is
+// executed, merged into another one, or dropped at shutdown.
+struct BGTaskStats {
+  uint64_t pending;
+  uint64_t running;
+  // Micros the oldest pending one has waited, 0 if none
+  uint64_t oldest_age;
+  uint64_t added;
+  uint64_t executed;
+  uint64_t merged;
+  uint64_t dropped;
+  // Adds that waited for room in the queue
+  uint64_t waits;
+  BGTaskStats() : pending(0), running(0), oldest_age(0), added(0),
+                  executed(0), merged(0), dropped(0), waits(0) {}
+};
+
+// Counters of the expire index, see ExpireSweeper. An entry swept is
+// expired if its key was, and queued for compaction, or stale if the key
+// was deleted, persisted or given another ttl since.
+struct ExpireStats {
+  uint64_t indexed;
+  uint64_t swept;
+  uint64_t expired;
+  uint64_t stale;
+  uint64_t rounds;
+  ExpireStats() : indexed(0), swept(0), expired(0), stale(0), rounds(0) {}
+};
+
+// Metrics of one command since they were enabled or reset, see
+// Nemo::EnableMetrics. The latencies, in micros, are read from a log linear
+// histogram and are within 1/8 of the exact ones. The perf fields are the
+// sums of rocksdb::PerfContext over the perf_samples calls sampled.
+struct CommandMetrics {
+  std::string name;
+  uint64_t calls;
+  uint64_t micros;
+  uint64_t p50;
+  uint64_t p99;
+  uint64_t p999;
+  uint64_t max;
+  // Calls which waited for a record lock, and how long
+  uint64_t lock_waits;
+  uint64_t lock_wait_micros;
+  uint64_t lock_wait_p99;
+  // Reads and writes of the DBNemos, the meta reads the meta cache missed
+  uint64_t gets;
+  uint64_t meta_gets;
+  uint64_t bytes_read;
+  uint64_t bytes_written;
+  uint64_t perf_samples;
+  uint64_t perf_block_reads;
+  uint64_t perf_block_read_nanos;
+  uint64_t perf_memtable_get_nanos;
+  uint64_t perf_sst_get_nanos;
+  uint64_t perf_wal_nanos;
+  uint64_t perf_memtable_write_nanos;
+  CommandMetrics() : calls(0), micros(0), p50(0), p99(0), p999(0), max(0),
+                     lock_waits(0), lock_wait_micros(0), lock_wait_p99(0),
+                     gets(0), meta_gets(0), bytes_read(0), bytes_written(0),
+                     perf_samples(0), perf_block_reads(0), perf_block_read_nanos(0),
+                     perf_memtable_get_nanos(0), perf_sst_get_nanos(0),
+                     perf_wal_nanos(0), perf_memtable_write_nanos(0) {}
+};
+
+// A key of Nemo::GetKeyProfile. A hot key has the calls, latency and bytes
+// read and written of its sampled calls, calls overestimating them by at
+// most error; a big key has the len and vol of its meta.
+struct ProfiledKey {
+  std::string type;
+  std::string key;
+  uint64_t calls;
+  uint64_t error;
+  uint64_t micros;
+  uint64_t bytes;
+  int64_t len;
+  int64_t vol;
+  ProfiledKey() : calls(0), error(0), micros(0), bytes(0), len(0), vol(0) {}
+};
+
+// The hot keys of each type by calls, then the big keys of each type by
+// vol, since the profiler was enabled or reset, see Nemo::EnableKeyProfiler
+struct KeyProfile {
+  uint64_t samples;
+  // Sampled calls lost as the ring of samples was overrun
+  uint64_t dropped;
+  std::vector<ProfiledKey> hot_keys;
+  std::vector<ProfiledKey> big_keys;
+  KeyProfile() : samples(0), dropped(0) {}
+};
+
+// How long a db took to open, its WAL replay included, and the WAL bytes
+// it found to replay, see Nemo::GetOpenStats
+struct DBOpenStats {
+  std::string type;
+  uint64_t micros;
+  uint64_t wal_bytes;
+  // Not opened yet, see Options::lazy_open
+  bool deferred;
+  DBOpenStats() : micros(0), wal_bytes(0), deferred(false) {}
+};
+
+// Counters of the write groups of the dbs, see Options::write_group. A
+// group is one rocksdb write of the batches of writes, max_group the most
+// writes of a group.
+struct WriteGroupStats {
+  uint64_t writes;
+  uint64_t groups;
+  uint64_t bytes;
+  uint64_t max_group;
+  WriteGroupStats() : writes(0), groups(0), bytes(0), max_group(0) {}
+};
+
+// The completion of a write queued to a write group, see Nemo::SetAsync.
+// Copies wait for the same write, a default one is done and OK.
+class WriteFuture {
+public:
+    struct State;
+
+    WriteFuture() {}
+    // Done already, with status
+    explicit WriteFuture(const Status &status);
+
+    // Whether the write is done, Wait then returns at once
+    bool Ready() const;
+    // Waits for the write and returns its status
+    Status Wait() const;
+
+private:
+    friend class WriteGroup;
+    std::shared_ptr<State> state_;
+};
 class Nemo {
 public:
+    // Exits the process if a db fails to open, see Open
     Nemo(const std::string &db_path, const Options &options);
     ~Nemo() {
 
         bgtask_flag_ = false;
-        bg_cv_.Signal();
-
-        kv_db_->StopAllBackgroundWork(true);
-        hash_db_->StopAllBackgroundWork(true);
-        list_db_->StopAllBackgroundWork(true);
-        zset_db_->StopAllBackgroundWork(true);
-        set_db_->StopAllBackgroundWork(true);
-
-        int ret = 0;
-        if ((ret = pthread_join(bg_tid_, NULL)) != 0) {
-          log_warn("pthread_join failed with bgtask thread error %d", ret);
+        StopExpireSweeper();
+        DeleteWriteGroups();
+
+        // the dbs may be partly opened, see Open
+        rocksdb::DBNemo *dbs[] = {kv_db_.get(), hash_db_.get(), list_db_.get(), zset_db_.get(), set_db_.get()};
+        for (int i = 0; i < 5; i++) {
+            if (dbs[i] != NULL) {
+                dbs[i]->StopAllBackgroundWork(true);
+            }
         }
 
+        StopBGThread();
+
         kv_db_.reset();
         hash_db_.reset();
         list_db_.reset();
@@ -73,6 +214,8 @@ public:
         set_db_.reset();
         meta_db_.reset();
         raft_db_.reset();
+        expire_db_.reset();
+        DeleteMetrics();
 
         pthread_mutex_destroy(&(mutex_cursors_));
         pthread_mutex_destroy(&(mutex_dump_));
@@ -80,10 +223,39 @@ public:
         //pthread_mutex_destroy(&(mutex_bgtask_));
     };
 
+    // Opens the dbs concurrently, as the constructor does, but returns the
+    // failure instead of exiting, *nemo NULL then
+    static Status Open(const std::string &db_path, const Options &options, Nemo **nemo);
+    // One per db, or one for all with Options::column_family_layout
+    void GetOpenStats(std::vector<DBOpenStats> *stats);
+
     // Used for pika
     Status Compact(DBType type, bool sync = false);
+    // Runs the background tasks of all the types, beside the workers of
+    // each type, until the instance is deleted
     Status RunBGTask();
+    // One of the running tasks if there are several
     std::string GetCurrentTaskType();
+    void GetBGTaskStats(BGTaskStats *stats);
+    // Checks the entries of the expire index due by now, up to max_entries,
+    // and reclaims the keys which expired. The sweeper calls it every
+    // Options::expire_sweep_interval. Without Options::expire_sweep_rate no
+    // key is indexed, so there is nothing to sweep.
+    Status SweepExpired(int64_t max_entries, int64_t *expired);
+    void GetExpireStats(ExpireStats *stats);
+    // Per command counters and latencies, off unless Options::metrics. One
+    // call in perf_sample, 0 for none, also sums rocksdb::PerfContext.
+    void EnableMetrics(bool enabled, int perf_sample = 100);
+    // The commands called since the metrics were enabled or reset
+    void GetMetrics(std::vector<CommandMetrics> *metrics);
+    void ResetMetrics();
+    // Hot keys and big keys, off unless Options::key_profiler. One call in
+    // sample_every of the single key commands is sampled, and the hash,
+    // list, zset and set writes keep the largest keys by vol.
+    void EnableKeyProfiler(bool enabled, int sample_every = 100);
+    // The big keys are read again, those gone since are left out
+    void GetKeyProfile(KeyProfile *profile);
+    void ResetKeyProfile();
 
 
     // =================String=====================
@@ -98,6 +270,11 @@ public:
 
     // =================KV=====================
     Status Set(const rocksdb::Slice &key, const rocksdb::Slice &val, const int32_t ttl=0);
+    // Set without waiting for the write, which the future tells the end
+    // of. The writes of a thread are written in order, the kv writes after
+    // it wait for it. Without
+    // Options::write_group the value is written before SetAsync returns.
+    WriteFuture SetAsync(const rocksdb::Slice &key, const rocksdb::Slice &val, const int32_t ttl=0);
     Status Get(const rocksdb::Slice &key, std::string *val);
     Status MSet(const std::vector<KV> &kvs);
     Status MSetSlice(const std::vector<KVSlice> &kvs);
@@ -105,6 +282,8 @@ public:
     Status KMDel(const std::vector<std::string> &keys, int64_t* count);
     Status MGet(const std::vector<std::string> &keys, std::vector<KVS> &kvss);
     Status MGetSlice(const std::vector<rocksdb::Slice> &keys, std::vector<SS> &vs);
+    // One MultiGet for all keys, the values point into result
+    Status MGetBatch(const std::vector<rocksdb::Slice> &keys, rocksdb::NemoBatchGetResult *result);
     Status Incrby(const std::string &key, const int64_t by, std::string &new_val);
     Status Decrby(const std::string &key, const int64_t by, std::string &new_val);
     Status Incrbyfloat(const std::string &key, const double by, std::string &new_val);
@@ -119,6 +298,9 @@ public:
     KIterator* KScan(const std::string &start, const std::string &end, uint64_t limit, bool use_snapshot = false);
     KIteratorRO* KScanRO(const std::string &start, const std::string &end, uint64_t limit, bool use_snapshot = false);    
     Status Scan(int64_t cursor, std::string &pattern, int64_t count, std::vector<std::string>& keys, int64_t* cursor_ret);
+    // SCAN with a cursor that holds the position itself, "0" to start and
+    // once done, in place of the cursor store of the one above
+    Status Scan(const std::string &cursor, const std::string &pattern, int64_t count, std::vector<std::string>& keys, std::string *next_cursor);
 
     Status Keys(const std::string &pattern, std::vector<std::string>& keys);
 
@@ -149,6 +331,7 @@ public:
     Status HMSetSlice(const rocksdb::Slice &key, const std::vector<FVSlice> &fvs,int * res_list);
     Status HMGet(const std::string &key, const std::vector<std::string> &keys, std::vector<FVS> &fvss);
     Status HMGetSlice(const rocksdb::Slice &key, const std::vector<rocksdb::Slice> &fields, std::vector<SS> &ss);
+    Status HMGetBatch(const rocksdb::Slice &key, const std::vector<rocksdb::Slice> &fields, rocksdb::NemoBatchGetResult *result);
     Status HSetnx(const std::string &key, const std::string &field, const std::string &val, int64_t * res);    
     Status HStrlen(const std::string &key, const std::string &field, int64_t * res_len);
     HIterator* HScan(const std::string &key, const std::string &start, const std::string &end, uint64_t limit, bool use_snapshot = false);
@@ -177,6 +360,10 @@ public:
     Status LInsert(const std::string &key, Position pos, const std::string &pivot, const std::string &val, int64_t *llen);
     Status LRem(const std::string &key, const int64_t count, const std::string &val, int64_t *rem_count);
     LmetaIterator * LmetaScan( const std::string &start, const std::string &end, uint64_t limit, bool use_snapshot );
+    // Rewrite lists still in the linked encoding to the indexed one. Other
+    // list commands convert such a list on first use, these do it up front.
+    Status LConvert(const std::string &key);
+    Status LConvertAll(int64_t *converted);
 
     // ==============ZSet=====================
     Status ZAdd(const std::string &key, const double score, const std::string &member, int64_t *res);
@@ -196,6 +383,8 @@ public:
     Status ZRank(const std::string &key, const std::string &member, int64_t *rank);
     Status ZRevrank(const std::string &key, const std::string &member, int64_t *rank);
     Status ZScore(const std::string &key, const std::string &member, double *score);
+    // statuses[i] is NotFound if members[i] is not in the set
+    Status ZMScore(const std::string &key, const std::vector<std::string> &members, std::vector<double> &scores, std::vector<Status> &statuses);
     Status ZRangebylex(const std::string &key, const std::string &min, const std::string &max, std::vector<std::string> &members, bool is_lo, bool is_ro);
     Status ZLexcount(const std::string &key, const std::string &min, const std::string &max, int64_t* count, bool is_lo, bool is_ro);
     Status ZRemrangebylex(const std::string &key, const std::string &min, const std::string &max, bool is_lo, bool is_ro, int64_t* count);
@@ -220,6 +409,7 @@ public:
     Status SDiffStore(const std::string &destination, const std::vector<std::string> &keys, int64_t *res);
     Status SDiff(const std::vector<std::string> &keys, std::vector<std::string>& members);
     Status SIsMember(const std::string &key, const std::string &member,bool * isMember);
+    Status SMIsMember(const std::string &key, const std::vector<std::string> &members, std::vector<bool> &is_members);
     Status SPop(const std::string &key, std::string &member);
     Status SRandMember(const std::string &key, std::vector<std::string> &members, const int count = 1);
     Status SMove(const std::string &source, const std::string &destination, const std::string &member, int64_t *res);
@@ -240,12 +430,12 @@ public:
 
     rocksdb::DBNemo * GetMetaHandle()
     {
-        return meta_db_.get();
+        return lazy_open_ ? OpenDeferred(META_DB) : meta_db_.get();
     }
 
     rocksdb::DBNemo * GetRaftHandle()
     {
-        return raft_db_.get();        
+        return lazy_open_ ? OpenDeferred(RAFT_DB) : raft_db_.get();
     }
 
     rocksdb::DBNemo * GetKvHandle()
@@ -298,8 +488,20 @@ public:
     Status StopScanKeyNum();
     
     Status GetUsage(const std::string& type, uint64_t *result);
+    // Key filters of the 5 DBs, ready once all of them are built
+    void GetKeyFilterStats(rocksdb::NemoKeyFilterStats *stats);
+    // Row caches of the kv and hash DBs, see Options::row_cache_capacity
+    void GetRowCacheStats(rocksdb::NemoRowCacheStats *stats);
+    // Write groups of the 5 DBs, see Options::write_group
+    void GetWriteGroupStats(WriteGroupStats *stats);
 
     rocksdb::DBNemo* GetDBByType(const std::string& type); 
+    // Closed over the start of a checkpoint of all the dbs, so that they
+    // are saved at one point, see rocksdb::NemoWriteFence
+    rocksdb::NemoWriteFence* GetWriteFence() { return write_fence_.get(); }
+    // true if all the types are column families of one db, see
+    // Options::column_family_layout
+    bool IsColumnFamilyLayout() const { return column_family_layout_; }
     
     /* Meta */
     // Scan all metas of db specified by given type
@@ -323,9 +525,17 @@ public:
     void HashRawScan(const std::string &start, const std::string &end, bool use_snapshot); 
     void ZsetRawScan(const std::string path,const std::string &start, const std::string &end, bool use_snapshot);
 
+    // Saves the keys of [start, end) of all types to sst files under path,
+    // the types concurrently, each in files of Options::raw_scan_file_size
     Status RawScanSaveAll(const std::string path,const std::string &start, const std::string &end, bool use_snapshot);     
     Status IngestFile(const std::string path);
+    // Deletes the keys of all types in [start, end) by range tombstones,
+    // end empty for no bound. A limit below the default deletes only the
+    // first limit keys of each type, found by a scan of them.
     Status RangeDel(const std::string  & start, const std::string & end, uint64_t limit = 1LL << 60);
+    // RangeDel of all the keys, which first drops the sst files the range
+    // holds whole, so the snapshots taken before lose them too
+    Status RangeDelFiles(const std::string &start, const std::string &end);
     Status RangeDelWithHandle(rocksdb::DBNemo * db,const std::string  & start, const std::string & end, uint64_t limit = 1LL << 60);    
 
 private:
@@ -340,6 +550,7 @@ private:
     std::unique_ptr<rocksdb::DBNemo> set_db_;
     std::unique_ptr<rocksdb::DBNemo> meta_db_;
     std::unique_ptr<rocksdb::DBNemo> raft_db_;
+    std::unique_ptr<rocksdb::DBNemo> expire_db_;
     //std::vector<rocksdb::ColumnFamilyHandle*> cf_handle_;
 
     port::RecordMutex mutex_hash_record_;
@@ -350,23 +561,44 @@ private:
 
     bool save_flag_;
 
-    //pthread_mutex_t mutex_bgtask_;
-    port::Mutex mutex_bgtask_;
     std::atomic<bool> bgtask_flag_;
+    BGScheduler *bg_scheduler_;
+    ExpireSweeper *expire_sweeper_;
+    Metrics *metrics_;
+    // The writes of Set, HSet, SAdd, ZAdd and LPush go through them, see
+    // Options::write_group. The other kv writes drain kv_group_ first, so
+    // that they land after the SetAsync writes queued before them.
+    WriteGroup *kv_group_;
+    WriteGroup *hash_group_;
+    WriteGroup *list_group_;
+    WriteGroup *zset_group_;
+    WriteGroup *set_group_;
 
     // Maybe 0 for none, 1 for compact_key, and 2 for compact all;
     std::atomic<int> current_task_type_;
-    pthread_t bg_tid_;
-    std::queue<BGTask> bg_tasks_;
-    port::CondVar bg_cv_;
 
     // Used for compact tools and internal
     Status DoCompact(DBType type);
     Status AddBGTask(const BGTask& task);
     Status CompactKey(const DBType type, const rocksdb::Slice& key);
+    // The raw key ranges CompactKey compacts in the db of type
+    void KeyCompactRanges(const DBType type, const rocksdb::Slice& key, KeyRanges *ranges);
+    // The raw keys [begin, end) of the db of type, an empty end is no end.
+    // op is the task type shown while it runs.
+    Status CompactRange(const DBType type, const std::string& begin, const std::string& end,
+                        OPERATION op = OPERATION::kCLEAN_RANGE);
     Status StartBGThread();
+    void StopBGThread();
+    // RangeDel, delete_files for RangeDelFiles
+    Status DoRangeDel(const std::string &start, const std::string &end, uint64_t limit, bool delete_files);
+    void StopExpireSweeper();
+    // Writes what the groups hold, then stops them
+    void DeleteWriteGroups();
+    void DeleteMetrics();
 
     Status ExistsSingleKey(const std::string &key);
+    // Bit 1 << DBType of each of the 5 DBs whose key filter may hold key
+    int KeyTypes(const std::string &key);
 
     Status KDel(const std::string &key, int64_t *res);
     Status KExpire(const std::string &key, const int32_t seconds, int64_t *res);
@@ -404,14 +636,10 @@ private:
     void ResetSpopCount(const std::string &key);
 
     Status GetSnapshot(Snapshots &snapshots);
-    Status ScanKeysWithTTL(std::unique_ptr<rocksdb::DBNemo> &db, Snapshot *snapshot, const std::string pattern, std::vector<std::string>& keys);
-    bool ScanKeysWithTTL(std::unique_ptr<rocksdb::DBNemo> &db, std::string &start_key, const std::string &pattern, std::vector<std::string>& keys, int64_t* count, std::string* next_key);
     // Remeber the snapshot will be release inside!!
     Status ScanKeys(std::unique_ptr<rocksdb::DBNemo> &db, Snapshot *snapshot, const char kType, const std::string &pattern, std::vector<std::string>& keys);
-    bool ScanKeys(std::unique_ptr<rocksdb::DBNemo> &db, const char kType, std::string &start_key, const std::string &pattern, std::vector<std::string>& keys, int64_t* count, std::string* next_key);
     Status GetStartKey(int64_t cursor, std::string* start_key);
     int64_t StoreAndGetCursor(int64_t cursor, const std::string& next_key);
-    Status SeekCursor(int64_t cursor, std::string* start_key);
 
     int DoHSet(const rocksdb::Slice &key, const rocksdb::Slice &field, const rocksdb::Slice val, rocksdb::WriteBatch &writebatch);       
     int64_t DoHDel(const rocksdb::Slice &key, const rocksdb::Slice &field, rocksdb::WriteBatch &writebatch);
@@ -420,9 +648,14 @@ private:
     Status ZAddNoLock(const std::string &key, const double score, const std::string &member, int64_t *res);
     Status ZRemrangebyrankNoLock(const std::string &key, const int64_t start, const int64_t stop, int64_t* count);
     ZLexIterator* ZScanbylex(const std::string &key, const std::string &min, const std::string &max, uint64_t limit, bool use_snapshot = false);
-    int DoZSet(const std::string &key, const double score, const std::string &member, rocksdb::WriteBatch &writebatch);
-    int32_t L2R(const std::string &key, const int64_t index, const int64_t left, int64_t *priv, int64_t *cur, int64_t *next);
-    int32_t R2L(const std::string &key, const int64_t index, const int64_t right, int64_t *priv, int64_t *cur, int64_t *next);
+    int DoZSet(const std::string &key, const double score, const std::string &member, rocksdb::WriteBatch &writebatch, ZRankIndex &rank);
+    Status ZStore(const std::string &destination, const int numkeys, const std::vector<std::string> &keys, const std::vector<double> &weights, Aggregate agg, bool inter, int64_t *res);
+    ZIterator* ZScanFromRank(const std::string &key, const int64_t rank, ZRankIndex &index, const rocksdb::ReadOptions &read_options, Status *s);
+    Status LGetIndexedMeta(const std::string &key, ListMeta &meta);
+    Status LConvertNoLock(const std::string &key, ListMeta &meta);
+    Status LGetPositions(const std::string &key, const int64_t from, const int64_t to, std::vector<std::string> *vals, int64_t *vol);
+    Status LPushNoLock(const std::string &key, const std::string &val, const bool left, int64_t *llen);
+    Status LPopNoLock(const std::string &key, const bool left, std::string *val);
 
     Status RPopLPushInternal(const std::string &src, const std::string &dest, std::string &val);
 
@@ -433,10 +666,7 @@ private:
 
     Status SAddNoLock(const std::string &key, const std::string &member, int64_t *res);
     Status SRemNoLock(const std::string &key, const std::string &member, int64_t *res);
-
-    Status SaveDBNemo(const std::string &db_path, const std::string &key_type, const char meta_prefix, std::unique_ptr<rocksdb::DBNemo> &src_db, const rocksdb::Snapshot *snapshot);
-    //Status SaveDBNemo(const std::string &db_path, const std::string &key_type, std::unique_ptr<rocksdb::DBNemo> &src_db, const rocksdb::Snapshot *snapshot);
-    Status SaveDB(const std::string &db_path, std::unique_ptr<rocksdb::DB> &src_db, const rocksdb::Snapshot *snapshot);
+    Status SStore(const std::string &destination, const std::vector<std::string> &keys, SetOperation op, int64_t *res);
 
     /* Meta */
     char GetMetaPrefix(DBType type);
@@ -445,6 +675,8 @@ private:
     uint64_t GetProperty(const std::string &property);
     // Get estimate RecordMutex memory usage
     uint64_t GetLockUsage();
+    // Get estimate meta version cache memory usage
+    uint64_t GetMetaCacheUsage();
 
     // Scan metas on given db
     Status ScanDBMetas(std::unique_ptr<rocksdb::DBNemo> &db, DBType type,
@@ -465,7 +697,7 @@ private:
     Status ZDressZSetforZScore(const std::string& key, int *count,int64_t * vol);    
 
     std::tuple<int64_t, int64_t> BitOpGetSrcValue(const std::vector<std::string> &src_keys, std::vector<std::string> &src_values);
-    std::string BitOpOperate(BitOpType op, const std::vector<std::string> &src_values, int64_t max_len, int64_t min_len);
+    std::string BitOpOperate(BitOpType op, std::vector<std::string> &src_values, int64_t max_len, int64_t min_len);
 
 
     Nemo(const Nemo &rval);
@@ -475,11 +707,40 @@ private:
 
     pthread_mutex_t mutex_dump_;
     std::string dump_path_;
-    std::atomic<bool> dump_to_terminate_;
-    std::map<std::string, pthread_t> dump_pthread_ts_;
+    // true while a BGSave runs, guarded by mutex_dump_
+    bool dumping_;
     Snapshots dump_snapshots_;
 
+    // see Options::column_family_layout
+    bool column_family_layout_;
+    // see Options::scan_threads
+    int scan_threads_;
+    // see Options::raw_scan_file_size
+    uint64_t raw_scan_file_size_;
+    // Shared by all the dbs, see GetWriteFence
+    std::shared_ptr<rocksdb::NemoWriteFence> write_fence_;
+    // see Options::lazy_open
+    bool lazy_open_;
+    // Guards the deferred opens and open_stats_
+    port::Mutex open_mu_;
+    std::vector<DBOpenStats> open_stats_;
+    Status RawScanSave(const std::vector<DBType> &types, const std::string &path, const std::string &start, const std::string &end, bool use_snapshot);
+    struct NoOpen {};
+    // Up to the opening of the dbs, which Init does
+    Nemo(const std::string &db_path, const Options &options, NoOpen);
+    Status Init(const Options &options);
+    Status OpenDB(const std::string &type, char meta_prefix, std::unique_ptr<rocksdb::DBNemo> *db,
+                  DBOpenStats *stats);
+    Status OpenDBs();
+    Status OpenColumnFamilies(const Options &options);
+    // The meta or raft db, opened now if lazy_open_ deferred it, NULL if
+    // that fails
+    rocksdb::DBNemo *OpenDeferred(const std::string &type);
+
     friend class VolumeIterator;
+    friend class VolumeIndex;
+    friend class BGScheduler;
+    friend class ExpireSweeper;
 };
 
 }
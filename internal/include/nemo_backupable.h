@@ -35,6 +35,7 @@ namespace nemo {
             ~BackupEngine();
             static Status Open(nemo::Nemo *db, BackupEngine** backup_engine_ptr);
 
+            // Takes the files of all the dbs at one point of the writes
             Status SetBackupContent();
             
             Status CreateNewBackup(const std::string &dir);
@@ -43,8 +44,10 @@ namespace nemo {
     
             Status CreateNewBackupSpecify(const std::string &dir, const std::string &type);
         private:
-            BackupEngine() {}
+            BackupEngine() : write_fence_(NULL) {}
 
+            // Of the nemo the engines are of, see Nemo::GetWriteFence
+            rocksdb::NemoWriteFence* write_fence_;
             std::map<std::string, rocksdb::DBNemoCheckpoint*> engines_;
             std::map<std::string, BackupContent> backup_content_;
             std::map<std::string, pthread_t> backup_pthread_ts_;
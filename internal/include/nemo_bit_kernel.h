@@ -0,0 +1,41 @@
+#ifndef NEMO_INCLUDE_NEMO_BIT_KERNEL_H_
+#define NEMO_INCLUDE_NEMO_BIT_KERNEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include "rocksdb/slice.h"
+#include "rocksdb/status.h"
+#include "nemo_const.h"
+
+namespace nemo {
+
+// Byte range kernels of the bitmap commands. Every level is built into the
+// library, whatever the compiler flags, and GetBitKernel() picks the best one
+// the CPU runs once, at the first call.
+enum BitKernelLevel {
+    kBitKernelScalar = 0,
+    kBitKernelSSE42 = 1,    // popcnt, 16 bytes per compare and op
+    kBitKernelAVX2 = 2,
+    kBitKernelAVX512 = 3,   // AVX-512BW
+    kBitKernelLevels = 4
+};
+
+struct BitKernel {
+    BitKernelLevel level;
+    const char *name;
+    // Set bits of p[0, n)
+    uint64_t (*count)(const uint8_t *p, size_t n);
+    // Offset of the first byte of p[0, n) other than skip, n if none
+    size_t (*find)(const uint8_t *p, size_t n, uint8_t skip);
+    // dst[i] = dst[i] op src[i] for i in [0, n), kBitOpNot ignores src
+    void (*op)(BitOpType op, uint8_t *dst, const uint8_t *src, size_t n);
+};
+
+const BitKernel& GetBitKernel();
+// The kernel of level, NULL if the CPU can not run it
+const BitKernel* GetBitKernel(BitKernelLevel level);
+
+}
+#endif
@@ -24,6 +24,7 @@ typedef	struct nemo_SIterator_t nemo_SIterator_t;
 typedef struct nemo_Snaptshot_t nemo_Snaptshot_t;
 
 typedef struct nemo_VolumeIterator_t nemo_VolumeIterator_t;
+typedef struct nemo_VolumeIndex_t nemo_VolumeIndex_t;
 typedef struct nemo_DBNemo_t nemo_DBNemo_t;
 typedef struct nemo_WriteBatch_t nemo_WriteBatch_t;
 
@@ -79,7 +80,11 @@ extern void nemo_delCppStr(void * p);
 
 extern void nemo_delSSVector(void * p);
 
+extern void nemo_delBatchGetResult(void * p);
+
 extern nemo_t * nemo_Create(const char * db_path,const nemo_options_t * options);
+// NULL with errptr set if a db fails to open, where nemo_Create exits
+extern nemo_t * nemo_Open(const char * db_path,const nemo_options_t * options, char ** errptr);
 
 extern nemo_options_t * nemo_CreateOption();
 
@@ -123,6 +128,10 @@ extern void nemo_WriteBatchTtl(nemo_t * nemo, int const num, const char ** key,
 
 extern void * nemo_MGet(nemo_t * nemo,  const int num, const char ** key, size_t * keylen, \
 													   const char ** val, size_t * vallen, char ** errs);
+// As nemo_MGet by one batched read, val points into the returned result,
+// which is freed by nemo_delBatchGetResult
+extern void * nemo_MGetBatch(nemo_t * nemo,  const int num, const char ** key, size_t * keylen, \
+													   const char ** val, size_t * vallen, char ** errs);
 extern nemo_KIterator_t  * nemo_KScan(nemo_t *nemo, const char * start,const size_t startlen, 
 								const char * end, const size_t endlen, uint64_t limit,bool use_snapshot);					
 extern void KNext(nemo_KIterator_t * it);
@@ -208,6 +217,10 @@ extern void * nemo_HMGet(nemo_t * nemo, const char * key,const size_t keylen, co
 									    const char ** field_list,const size_t * field_list_len,	\
 	 									const char ** value_list,size_t * value_list_strlen, char ** errs,char ** errptr); 
 
+extern void * nemo_HMGetBatch(nemo_t * nemo, const char * key,const size_t keylen, const int num,		\
+									    const char ** field_list,const size_t * field_list_len,	\
+	 									const char ** value_list,size_t * value_list_strlen, char ** errs,char ** errptr); 
+
 extern void nemo_HSetnx(nemo_t * nemo,const char * key,const size_t keylen,const char * field,const size_t fieldlen,const char * value, const size_t vallen,int64_t * res, char ** errptr);
 
 extern void nemo_HStrlen(nemo_t * nemo,const char * key,const size_t keylen,const char * field,const size_t fieldlen,int64_t * res_len ,char **errptr);
@@ -321,6 +334,9 @@ extern	void nemo_SDiff(nemo_t * nemo, const int num, const char ** key_list,cons
 		
 extern 	void nemo_SIsMember(nemo_t * nemo,const char * key,const size_t keylen, const char * member,const size_t memlen,bool * isMember,char ** errptr);
 
+extern 	void nemo_SMIsMember(nemo_t * nemo,const char * key,const size_t keylen, const int num, const char ** member_list,const size_t * member_list_len, \
+									bool * isMember_list,char ** errptr);
+
 extern 	void nemo_SPop(nemo_t * nemo,const char * key,const size_t keylen,  char ** member, size_t * len, int64_t * res, char ** errptr);
 
 extern 	void nemo_SRandomMember(nemo_t * nemo,  const char * key,const size_t keylen,		\
@@ -366,6 +382,10 @@ extern void nemo_ZRevrank(nemo_t * nemo,const char * key, const size_t keylen, c
 
 extern void nemo_ZScore(nemo_t * nemo,const char * key, const size_t keylen, const char * member,const size_t memlen, double * score, int64_t * res ,char ** errptr);
 
+// res_list[i] is 1 if member_list[i] has a score, else 0
+extern void nemo_ZMScore(nemo_t * nemo,const char * key, const size_t keylen, const int num, const char ** member_list,const size_t * member_list_len, \
+									double * score_list, int64_t * res_list, char ** errptr);
+
 extern void nemo_ZRangebylex(nemo_t * nemo,const char * key,const size_t keylen,const char * min,const size_t minlen,const char * max, const size_t maxlen, \
 				int * num,char *** member_list, size_t ** member_list_strlen, bool is_lo, bool is_ro, char ** errptr);
 
@@ -457,6 +477,16 @@ extern bool VoltargetScan(nemo_VolumeIterator_t * it,int64_t target);
 extern int64_t VoltotalVolume(nemo_VolumeIterator_t * it);
 extern void VoltargetKey(nemo_VolumeIterator_t * it,char ** key ,size_t* keylen);
 extern void VolIteratorFree(nemo_VolumeIterator_t * it);
+extern nemo_VolumeIndex_t * createVolumeIndex(nemo_t * nemo);
+extern void VolIndexVolume(nemo_VolumeIndex_t * index,
+								const char * start, const size_t startlen, 
+								const char * end ,const size_t endlen,
+								int64_t * volume, char ** errptr);
+extern bool VolIndexTargetKey(nemo_VolumeIndex_t * index,
+								const char * start, const size_t startlen, 
+								const char * end ,const size_t endlen,
+								int64_t target, char ** key, size_t * keylen, char ** errptr);
+extern void VolIndexFree(nemo_VolumeIndex_t * index);
 extern 	void nemo_RangeDel(nemo_t * nemo,const char * start, const size_t startlen, 
 								const char * end ,const size_t endlen,
 								char ** errptr);
@@ -470,6 +500,70 @@ extern void nemo_RawScanSaveAll(nemo_t * nemo, const char * path, const char * s
 												bool use_snapshot,char ** errptr);
 extern void nemo_IngestFile(nemo_t * nemo, const char * path, char ** errptr);
 
+// The values of nemo_GetMetrics are NEMO_METRICS_FIELDS per command, in the
+// order of the fields of nemo::CommandMetrics after name: calls, micros,
+// p50, p99, p999, max, lock_waits, lock_wait_micros, lock_wait_p99, gets,
+// meta_gets, bytes_read, bytes_written, perf_samples, perf_block_reads,
+// perf_block_read_nanos, perf_memtable_get_nanos, perf_sst_get_nanos,
+// perf_wal_nanos, perf_memtable_write_nanos
+#define NEMO_METRICS_FIELDS 20
+extern void nemo_EnableMetrics(nemo_t * nemo, bool enabled, int perf_sample);
+extern void nemo_GetMetrics(nemo_t * nemo, int * count, char *** name_list, size_t ** name_list_strlen,
+												uint64_t ** value_list);
+extern void nemo_ResetMetrics(nemo_t * nemo);
+
+// The keys of nemo_GetKeyProfile are the hot keys then the big keys of
+// nemo::KeyProfile, with NEMO_KEY_PROFILE_FIELDS values each: big, 0 for a
+// hot key and 1 for a big one, type, as nemo::DBType, calls, error, micros,
+// bytes, len, vol
+#define NEMO_KEY_PROFILE_FIELDS 8
+extern void nemo_EnableKeyProfiler(nemo_t * nemo, bool enabled, int sample_every);
+extern void nemo_GetKeyProfile(nemo_t * nemo, uint64_t * samples, uint64_t * dropped, int * count,
+												char *** key_list, size_t ** key_list_strlen, int64_t ** value_list);
+extern void nemo_ResetKeyProfile(nemo_t * nemo);
+
+// The result of the nemo_*Bulk functions, count strings packed one after
+// another in buf, each after its length in 4 bytes of host order:
+//
+//   | len | bytes | len | bytes | ...
+//
+// offsets[i] is the offset of the bytes of string i, a nil string, as a
+// missing value of nemo_MGetBulk, has the length NEMO_BULK_NIL and no bytes.
+// buf and offsets are the caller's, given by nemo_BulkInit, until a result
+// outgrows them, then the library's, kept for the next calls until
+// nemo_BulkFree. Each call replaces the result of the one before.
+#define NEMO_BULK_NIL 0xffffffffu
+typedef struct {
+	char * buf;
+	size_t size;
+	size_t cap;
+	size_t * offsets;
+	size_t count;
+	size_t offsets_cap;
+	// 1 if buf, 2 if offsets, is the library's
+	int owned;
+} nemo_bulk_t;
+// buf and offsets may be NULL with 0 for the library to allocate them
+extern void nemo_BulkInit(nemo_bulk_t * bulk, char * buf, size_t cap, size_t * offsets, size_t offsets_cap);
+extern void nemo_BulkFree(nemo_bulk_t * bulk);
+// The bulk of the calling thread, whose result lasts until the next call
+// with it on the thread; not for callers that may move between threads
+extern nemo_bulk_t * nemo_ThreadBulk(void);
+// false for a nil string
+extern bool nemo_BulkGet(const nemo_bulk_t * bulk, size_t i, const char ** data, size_t * len);
+
+// The fields and values alternate
+extern void nemo_HGetallBulk(nemo_t * nemo,const char * key,const size_t keylen, nemo_bulk_t * bulk, char ** errptr);
+extern void nemo_KeysBulk(nemo_t * nemo,const char * pattern,const size_t patternlen, nemo_bulk_t * bulk, char ** errptr);
+extern void nemo_ScanBulk(nemo_t * nemo, int64_t cursor, const char * pattern, const size_t patternlen, int64_t count, \
+							nemo_bulk_t * bulk, int64_t * cursor_ret, char ** errptr);
+extern void nemo_LRangeBulk(nemo_t * nemo,const char * key,const size_t keylen,const int64_t begin,const int64_t end, \
+							nemo_bulk_t * bulk, char ** errptr);
+extern void nemo_SMembersBulk(nemo_t * nemo,const char * key,const size_t keylen, nemo_bulk_t * bulk, char ** errptr);
+// The values of the keys, nil if missing or failed, errptr the first error
+extern void nemo_MGetBulk(nemo_t * nemo, const int num, const char ** key, size_t * keylen, \
+							nemo_bulk_t * bulk, char ** errptr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -9,6 +9,8 @@ const int64_t ZSET_SCORE_SHIFT = 1000000000000000000LL;
 const int64_t ZSET_SCORE_MAX = 10000000000000LL;
 const int64_t ZSET_SCORE_MIN = -ZSET_SCORE_MAX;
 const double eps = 1e-5;
+// Entries per level 1 block of the zset rank index, see ZRankIndex
+const int64_t ZSET_RANK_BLOCK = 256;
 
 const std::string ALL_DB = "all";
 const std::string KV_DB = "kv";
@@ -16,6 +18,15 @@ const std::string HASH_DB = "hash";
 const std::string LIST_DB = "list";
 const std::string ZSET_DB = "zset";
 const std::string SET_DB = "set";
+const std::string META_DB = "meta";
+const std::string RAFT_DB = "raft";
+// The expire index of the keys of all types, see ExpireSweeper
+const std::string EXPIRE_DB = "expire";
+
+// Directory of the single db of Options::column_family_layout, which holds
+// each type above in the column family of the same name, but kv in the
+// default one
+const std::string CF_LAYOUT_DB = "cf";
 
 enum DBType {
   kNONE_DB = 0,
@@ -57,6 +68,12 @@ enum Aggregate {
   MAX
 };
 
+enum SetOperation {
+  kSetUnion = 0,
+  kSetInter,
+  kSetDiff
+};
+
 enum BitOpType {
     kBitOpNot = 1,
     kBitOpAnd = 2,
@@ -120,6 +137,7 @@ namespace DataType {
     static const char kZSet      = 'z';
     static const char kZSize     = 'Z';
     static const char kZScore    = 'y';
+    static const char kZRank     = 'r';
     static const char kSet      = 's';
     static const char kSSize     = 'S';
 //    static const char QUEUE     = 'q';
@@ -26,13 +26,24 @@ struct IteratorOptions {
       : end(_end), limit(_limit), read_options(roptions), direction(_dir) {}
 };
 
+// Iterators open their rocksdb iterator at target, forward on the first key
+// at or after it, backward on the last key at or before it, and stop at
+// end, inclusive for Iterator and exclusive for IteratorRO. Keys outside
+// prefix, when given, are out of the range too. The upper end of the range
+// is the iterate_upper_bound of the rocksdb iterator, so that it does not
+// read past the range; rocksdb has no lower bound, backward iterators
+// compare it.
+//
+// The slices of key(), value() and of the accessors of the subclasses are
+// valid until the next Next() or Skip().
 class Iterator {
 public:
-    Iterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo,const IteratorOptions& iter_options);
+    Iterator(rocksdb::DBNemo *db_nemo, const IteratorOptions& iter_options,
+             const rocksdb::Slice &target, const rocksdb::Slice &prefix = rocksdb::Slice());
     virtual ~Iterator() {
+      delete it_;
       if(ioptions_.read_options.snapshot!=nullptr)
         db_nemo_->ReleaseSnapshot(ioptions_.read_options.snapshot);
-      delete it_;
     }
 
     rocksdb::Slice key();
@@ -51,6 +62,9 @@ private:
     
     rocksdb::DBNemo * db_nemo_;    
     IteratorOptions ioptions_;
+    std::string upper_bound_;
+    rocksdb::Slice upper_bound_slice_;
+    std::string lower_bound_;
 
     //No Copying Allowed
     Iterator(Iterator&);
@@ -59,11 +73,12 @@ private:
 
 class IteratorRO {
 public:
-    IteratorRO(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo,const IteratorOptions& iter_options);
+    IteratorRO(rocksdb::DBNemo *db_nemo, const IteratorOptions& iter_options,
+               const rocksdb::Slice &target, const rocksdb::Slice &prefix = rocksdb::Slice());
     virtual ~IteratorRO() {
+      delete it_;
       if(ioptions_.read_options.snapshot!=nullptr)
         db_nemo_->ReleaseSnapshot(ioptions_.read_options.snapshot);
-      delete it_;
     }
 
     rocksdb::Slice key();
@@ -82,6 +97,9 @@ private:
     
     rocksdb::DBNemo * db_nemo_;    
     IteratorOptions ioptions_;
+    std::string upper_bound_;
+    rocksdb::Slice upper_bound_slice_;
+    std::string lower_bound_;
 
     //No Copying Allowed
     IteratorRO(IteratorRO&);
@@ -90,19 +108,14 @@ private:
 
 class KIterator : public Iterator {
 public:
-    KIterator(rocksdb::Iterator *it, rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options);
+    KIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target);
     virtual void Next();
     virtual void Skip(int64_t offset);
     virtual bool Valid();
-    std::string key()       { return key_; };
-    std::string value()     { return value_; };
+    rocksdb::Slice key()       { return Iterator::key(); };
+    rocksdb::Slice value()     { return Iterator::value(); };
     
 private:
-    void CheckAndLoadData();
-
-    std::string key_;
-    std::string value_;
-
     //No Copying Allowed
     KIterator(KIterator&);
     void operator=(KIterator&);
@@ -111,7 +124,7 @@ private:
 // KIteratorRO with endpoint: Right Open
 class KIteratorRO : public IteratorRO {
 public:
-    KIteratorRO(rocksdb::Iterator *it, rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options);
+    KIteratorRO(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target);
     virtual void Next();
     virtual void Skip(int64_t offset);
     virtual bool Valid();
@@ -128,20 +141,19 @@ private:
 
 class HIterator : public Iterator {
 public:
-    HIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key);
+    HIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, const rocksdb::Slice &target);
     virtual void Next();
     virtual void Skip(int64_t offset);
     virtual bool Valid();
-    std::string key()   { return key_; };
-    std::string field() { return field_; };
-    std::string value() { return value_; };
+    rocksdb::Slice key()   { return key_; };
+    rocksdb::Slice field() { return field_; };
+    rocksdb::Slice value() { return Iterator::value(); };
 
 private:
     void CheckAndLoadData();
 
     std::string key_;
-    std::string field_;
-    std::string value_;
+    rocksdb::Slice field_;
 
     //No Copying Allowed
     HIterator(HIterator&);
@@ -150,20 +162,20 @@ private:
 
 class ZIterator : public Iterator {
 public:
-    ZIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key);
+    ZIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, const rocksdb::Slice &target);
     virtual bool Valid();
     virtual void Skip(int64_t offset);
     virtual void Next();
-    std::string key()    { return key_; };
-    double score()       { return score_; };
-    std::string member() { return member_; };
+    rocksdb::Slice key()    { return key_; };
+    double score()          { return score_; };
+    rocksdb::Slice member() { return member_; };
 
 private:
     void CheckAndLoadData();
 
     std::string key_;
     double score_;
-    std::string member_;
+    rocksdb::Slice member_;
 
     //No Copying Allowed
     ZIterator(ZIterator&);
@@ -173,18 +185,18 @@ private:
 
 class ZLexIterator : public Iterator {
 public:
-    ZLexIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key);
+    ZLexIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, const rocksdb::Slice &target);
     virtual bool Valid();
     virtual void Skip(int64_t offset);
     virtual void Next();
-    std::string key()       { return key_; };
-    std::string member()    { return member_; };
+    rocksdb::Slice key()       { return key_; };
+    rocksdb::Slice member()    { return member_; };
 
 private:
     void CheckAndLoadData();
 
     std::string key_;
-    std::string member_;
+    rocksdb::Slice member_;
 
     //No Copying Allowed
     ZLexIterator(ZLexIterator&);
@@ -193,18 +205,18 @@ private:
 
 class SIterator : public Iterator {
 public:
-    SIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key);
+    SIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, const rocksdb::Slice &target);
     virtual void Skip(int64_t offset);
     virtual void Next();
     virtual bool Valid();
-    std::string key()       { return key_; };
-    std::string member()    { return member_; };
+    rocksdb::Slice key()       { return key_; };
+    rocksdb::Slice member()    { return member_; };
 
 private:
     void CheckAndLoadData();
 
     std::string key_;
-    std::string member_;
+    rocksdb::Slice member_;
 
     //No Copying Allowed
     SIterator(SIterator&);
@@ -213,7 +225,7 @@ private:
 
 class HmetaIterator : public IteratorRO{
 public:
-    HmetaIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options,const rocksdb::Slice &key, bool skip_nil_index=false);
+    HmetaIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target, bool skip_nil_index=false);
     virtual void Next();
     virtual void Skip(int64_t offset);
     virtual bool Valid();
@@ -230,7 +242,7 @@ private:
 
 class LmetaIterator : public IteratorRO{
 public:
-    LmetaIterator(rocksdb::Iterator *it, rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options,const rocksdb::Slice &key);
+    LmetaIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target);
     virtual void Next();
     virtual void Skip(int64_t offset);
     virtual bool Valid();
@@ -245,7 +257,7 @@ private:
 
 class SmetaIterator : public IteratorRO{
 public:
-    SmetaIterator(rocksdb::Iterator *it, rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options,const rocksdb::Slice &key);
+    SmetaIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target);
     virtual void Next();
     virtual void Skip(int64_t offset);
     virtual bool Valid();
@@ -260,7 +272,7 @@ private:
 
 class ZmetaIterator : public IteratorRO{
 public:
-    ZmetaIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options,const rocksdb::Slice &key);
+    ZmetaIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target);
     virtual void Next();
     virtual void Skip(int64_t offset);
     virtual bool Valid();
@@ -94,15 +94,25 @@ struct HashMeta : public NemoMeta {
 };
 
 struct ListMeta : public NemoMeta {
+  // kLinked lists key their elements by seq and link them through the
+  // priv/next stored in each value, left and right being the end seqs.
+  // kIndexed lists store element i at position left + i, so the positions
+  // [left, right] are dense and len == right - left + 1.
+  enum Encoding {
+    kLinked = 0,
+    kIndexed = 1
+  };
+
   int64_t len;
   int64_t vol;
   int64_t left;
   int64_t right;
   int64_t cur_seq;
+  int64_t encoding;
 
-  ListMeta() : len(0), vol(0), left(0), right(0), cur_seq(1) {}
+  ListMeta() : len(0), vol(0), left(0), right(-1), cur_seq(0), encoding(kIndexed) {}
   ListMeta(int64_t _len, int64_t _vol, int64_t _left, int64_t _right, int64_t cseq)
-      : len(_len), vol(_vol), left(_left), right(_right), cur_seq(cseq) {}
+      : len(_len), vol(_vol), left(_left), right(_right), cur_seq(cseq), encoding(kLinked) {}
   virtual bool DecodeFrom(const std::string& raw_meta);
   virtual bool EncodeTo(std::string& raw_meta);
   virtual std::string ToString();
@@ -150,6 +150,55 @@ void MurmurHash3_x86_32( const void * key, int len, uint32_t seed, void * out )
     *(uint32_t*)out = h1;
 }
 
+//-----------------------------------------------------------------------------
+// MurmurHash64A, the 64 bit hash of MurmurHash2, reading little endian
+// blocks on every platform
+
+inline uint64_t MurmurHash64A( const void * key, int len, uint64_t seed )
+{
+    const uint64_t m = BIG_CONSTANT(0xc6a4a7935bd1e995);
+    const int r = 47;
+    
+    uint64_t h = seed ^ (len * m);
+    
+    const uint8_t * data = (const uint8_t *)key;
+    const uint8_t * end = data + (len - (len & 7));
+    
+    while(data != end)
+    {
+        uint64_t k = 0;
+        for (int i = 7; i >= 0; i--) {
+            k = (k << 8) | data[i];
+        }
+        
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        
+        h ^= k;
+        h *= m;
+        data += 8;
+    }
+    
+    switch(len & 7)
+    {
+        case 7: h ^= (uint64_t)data[6] << 48;
+        case 6: h ^= (uint64_t)data[5] << 40;
+        case 5: h ^= (uint64_t)data[4] << 32;
+        case 4: h ^= (uint64_t)data[3] << 24;
+        case 3: h ^= (uint64_t)data[2] << 16;
+        case 2: h ^= (uint64_t)data[1] << 8;
+        case 1: h ^= (uint64_t)data[0];
+            h *= m;
+    };
+    
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    
+    return h;
+}
+
 } // end namespace nemo
 
 #endif
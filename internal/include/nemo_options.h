@@ -26,6 +26,60 @@ struct Options {
     int delayed_write_rate;
     int max_write_buffer_number;
     bool disable_wal;
+    // fsync the WAL before each write returns
+    bool sync_write;
+    // max number of meta keys whose version and timestamp are cached
+    // per hash/list/zset/set db, 0 to disable
+    int meta_cache_capacity;
+    // bytes of the values of Get and HGet cached by the kv db and by the
+    // hash db each, 0 to disable, see rocksdb::DBNemo::SetRowCacheCapacity
+    uint64_t row_cache_capacity;
+    // bits per key of the bloom filter of the keys of each db, which lets
+    // Type, Exists, Del and the ttl commands skip the dbs that cannot hold
+    // a key, 0 to disable. Each filter is built by a scan of its db at open
+    // and every write of the db then updates it, so it is off by default.
+    int key_filter_bits_per_key;
+    // store all types as column families of one rocksdb under
+    // db_path/cf instead of one rocksdb per type, so that they share the
+    // WAL, memtable budget and background threads. tools/migrate converts
+    // an existing data dir.
+    bool column_family_layout;
+    // memtable budget of all the column families, 0 means
+    // write_buffer_size * max_write_buffer_number for each of them
+    int db_write_buffer_size;
+    // threads KEYS scans the dbs with, each db cut into as many ranges
+    int scan_threads;
+    // bytes of keys and values per sst file of RawScanSaveAll
+    uint64_t raw_scan_file_size;
+    // threads running the background compactions of each type db
+    int bg_threads;
+    // background compactions pending past which an add waits for one to run
+    int bg_queue_size;
+    // entries of the expire index the sweeper checks per second, 0 for no
+    // sweeper, which also leaves the keys given a ttl unindexed, see
+    // Nemo::SweepExpired
+    int expire_sweep_rate;
+    // millis between two rounds of the sweeper
+    int expire_sweep_interval;
+    // per command metrics from the start, see Nemo::EnableMetrics
+    bool metrics;
+    int metrics_perf_sample;
+    // opens the meta and raft dbs at their first access, by GetMetaHandle,
+    // GetRaftHandle or GetDBByType, instead of with the others, not with
+    // column_family_layout
+    bool lazy_open;
+    // hot and big keys from the start, see Nemo::EnableKeyProfiler
+    bool key_profiler;
+    int key_profiler_sample;
+    // group commit of the writes of Set, HSet, SAdd, ZAdd and LPush: the
+    // batches of the writers waiting while one write runs are written by
+    // the next one rocksdb write, of at most write_group_bytes bytes
+    bool write_group;
+    int write_group_bytes;
+    // a mutex per locked key instead of one per stripe of keys, so that
+    // writers of distinct keys never wait on each other, see
+    // port::RecordMutex
+    bool exact_record_locks;
 
 	Options() : create_if_missing(true),
         write_buffer_size(64 * 1024 * 1024),
@@ -46,7 +100,27 @@ struct Options {
         level0_file_num_compaction_trigger(4),
         delayed_write_rate(2 * 1024 * 1024),
         max_write_buffer_number(2),
-        disable_wal(false) {}
+        disable_wal(false),
+        sync_write(false),
+        meta_cache_capacity(256 * 1024),
+        row_cache_capacity(0),
+        key_filter_bits_per_key(0),
+        column_family_layout(false),
+        db_write_buffer_size(0),
+        scan_threads(4),
+        raw_scan_file_size(256 * 1024 * 1024),
+        bg_threads(1),
+        bg_queue_size(10000),
+        expire_sweep_rate(0),
+        expire_sweep_interval(1000),
+        metrics(false),
+        metrics_perf_sample(100),
+        lazy_open(false),
+        key_profiler(false),
+        key_profiler_sample(100),
+        write_group(false),
+        write_group_bytes(1024 * 1024),
+        exact_record_locks(false) {}
 };
 
 }; // end namespace nemo
@@ -46,5 +46,47 @@ private:
     void operator=(VolumeIterator&);
 };
 
+// Cumulative volume of the user keys of the kv, hash, list, set and zset
+// dbs, as VolumeIterator sums it, from the samples the sst files keep, see
+// rocksdb::NemoVolumeCollector. The samples of all the files are merged in
+// key order with their prefix sums, again only once a flush or compaction
+// changed the files, so a query costs two binary searches instead of a scan
+// of the range. An end of [start, end) is off by at most one sample step,
+// plus the volume of one user key, per file holding keys near it, and the
+// writes still in the memtables and the older versions of keys not yet
+// compacted away are missed or counted twice.
+class VolumeIndex {
+public:
+    explicit VolumeIndex(Nemo *nemo);
+
+    // end empty for no bound
+    Status Volume(const std::string &start, const std::string &end, int64_t *volume);
+    // The first sampled key of [start, end) at which the volume from start
+    // reaches target, as VolumeIterator::targetScan, NotFound if the range
+    // holds less
+    Status TargetKey(const std::string &start, const std::string &end, int64_t target, std::string *key);
+    // Sample keys merged, and times the files changed
+    size_t samples();
+    uint64_t rebuilds();
+
+private:
+    Status Refresh();
+    size_t Find(const std::string &key);
+    int64_t SumBefore(size_t i) { return i == 0 ? 0 : sums_[i - 1]; }
+
+    Nemo *n;
+    port::Mutex mu_;
+    std::vector<rocksdb::DBNemo *> dbs_;
+    std::vector<rocksdb::NemoVolumeSamples> files_;
+    std::vector<std::string> keys_;
+    // sums_[i] is the volume of the samples up to keys_[i] included
+    std::vector<int64_t> sums_;
+    uint64_t rebuilds_;
+
+    //No Copying Allowed
+    VolumeIndex(VolumeIndex&);
+    void operator=(VolumeIndex&);
+};
+
 }
 #endif
\ No newline at end of file
@@ -44,6 +44,10 @@
 #include <string.h>
 #include <unordered_map>
 #include <list>
+#include <vector>
+#include <atomic>
+
+#include "rocksdb/slice.h"
 
 #ifndef PLATFORM_IS_LITTLE_ENDIAN
 #define PLATFORM_IS_LITTLE_ENDIAN (__BYTE_ORDER == __LITTLE_ENDIAN)
@@ -85,6 +89,8 @@ class Mutex {
 
   void Lock();
   void Unlock();
+  // false at once if another thread holds it
+  bool TryLock();
   // this will assert if the mutex is not locked
   // it does NOT verify that mutex is held by a calling thread
   void AssertHeld() {}
@@ -103,6 +109,8 @@ class CondVar {
   explicit CondVar(Mutex* mu);
   ~CondVar();
   void Wait();
+  // Returns true if abs_time_us, micros since the epoch, passed first
+  bool TimedWait(uint64_t abs_time_us);
   void Signal();
   void SignalAll();
 
@@ -155,21 +163,75 @@ class RefMutex {
   void operator=(const RefMutex&);
 };
 
+// Waits of the calling thread for RecordMutex stripes another thread held,
+// only a stripe found locked is timed
+struct LockWaits {
+  uint64_t waits;
+  uint64_t micros;
+};
+LockWaits *ThisThreadLockWaits();
+
+// Per-key lock table. Keys are hashed onto a fixed array of cache-line
+// padded mutexes, so locking a key never allocates and different keys
+// only contend when they share a stripe.
+//
+// As two unrelated keys may share a stripe, a thread holding the lock of
+// one key and then locking another key of the same table can deadlock,
+// even with itself. Lock keys of one table together with MultiLock, which
+// takes them in (stripe, key) order; debug builds assert that order on
+// every lock of the table.
+//
+// With exact, each locked key also gets a refcounted mutex of its own in
+// an overflow map of its stripe, which the stripe only guards while the
+// key is looked up. Keys then never share a lock, at the cost of a map
+// insert per lock.
 class RecordMutex {
 public:
-  RecordMutex() : charge_(0) {}
+  static const size_t kDefaultStripes = 1024;
+
+  explicit RecordMutex(size_t stripes = kDefaultStripes, bool exact = false);
   ~RecordMutex();
 
-  void Lock(const std::string &key);
-  void Unlock(const std::string &key);
+  struct KeyMutex;
+
+  // A lock taken by Lock or MultiLock, given back to Unlock or MultiUnlock
+  struct Held {
+    size_t stripe;
+    KeyMutex *key;  // NULL unless exact
+  };
+
+  Held Lock(const rocksdb::Slice &key);
+  void Unlock(const Held &held);
+
+  // Locks each distinct key once, in (stripe, key) order
+  void MultiLock(const std::vector<rocksdb::Slice> &keys, std::vector<Held> *held);
+  void MultiUnlock(const std::vector<Held> &held);
+
+  size_t Stripe(const rocksdb::Slice &key) const;
+  bool exact() const { return keys_ != NULL; }
+
   int64_t GetUsage();
 
 private:
+  static const size_t kCacheLineSize = 64;
+
+  struct PaddedMutex {
+    pthread_mutex_t mu;
+    char padding[kCacheLineSize - sizeof(pthread_mutex_t) % kCacheLineSize];
+  };
+
+  typedef std::unordered_map<std::string, KeyMutex *> KeyMap;
 
-  Mutex mutex_;
+  Held Acquire(size_t stripe, const rocksdb::Slice &key);
+  void LockTimed(pthread_mutex_t *mu);
+  void CheckOrder(const Held &held);
+  void ForgetHeld(const Held &held);
 
-  std::unordered_map<std::string, RefMutex *> records_;
-  int64_t charge_;
+  PaddedMutex *stripes_;
+  size_t mask_;
+  // one map per stripe, guarded by the stripe, NULL unless exact
+  KeyMap *keys_;
+  std::atomic<int64_t> key_count_;
 
   // No copying
   RecordMutex(const RecordMutex&);
@@ -19,6 +19,9 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <byteswap.h>
+#include <string>
+#include <utility>
+#include <vector>
 
 #ifndef htobe64
 # if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -50,6 +53,18 @@ int mkpath(const char *path, mode_t mode);
 
 int stringmatchlen(const char *pattern, int patternLen, const char *string, int stringLen, int nocase);
 
+// The least key after all the keys starting with prefix, empty if none is
+std::string PrefixSuccessor(const std::string &prefix);
+
+typedef std::vector<std::pair<std::string, std::string> > KeyRanges;
+
+// The meta keys, prefix | key, of the user keys of [start, end), end empty
+// for no bound
+void MetaKeyRange(char prefix, const std::string &start, const std::string &end, KeyRanges *ranges);
+// The data keys, prefix | len | key | ..., of the same user keys, one range
+// per key length, in key order
+void DataKeyRanges(char prefix, const std::string &start, const std::string &end, KeyRanges *ranges);
+
 int is_dir(const char* filename);
 int delete_dir(const char* dirname);
 }
@@ -6,10 +6,16 @@
 #include <iostream>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/time.h>
+#include <thread>
 #include "nemo_list.h"
 #include "nemo_zset.h"
 #include "nemo_set.h"
 #include "nemo_hash.h"
+#include "nemo_bg_scheduler.h"
+#include "nemo_expire.h"
+#include "nemo_metrics.h"
+#include "nemo_write_group.h"
 #include "port.h"
 #include "util.h"
 #include "xdebug.h"
@@ -17,22 +23,90 @@
 namespace nemo {
 
 bool DisableWAL = false;
+bool SyncWrite = false;
 
 rocksdb::WriteOptions w_opts_nolog(){
     rocksdb::WriteOptions opts;
     opts.disableWAL = DisableWAL;
+    opts.sync = SyncWrite;
     return opts;
 };
 
+static uint64_t NowMicros() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// The bytes of the WAL files under path, those the open of the db there
+// replays
+static uint64_t WalBytes(const std::string &path) {
+    uint64_t bytes = 0;
+    DIR *dir = opendir(path.c_str());
+    if (dir == NULL) {
+        return 0;
+    }
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        std::string name(entry->d_name);
+        struct stat st;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".log") == 0
+            && stat((path + "/" + name).c_str(), &st) == 0) {
+            bytes += st.st_size;
+        }
+    }
+    closedir(dir);
+    return bytes;
+}
+
 Nemo::Nemo(const std::string &db_path, const Options &options)
+    : Nemo(db_path, options, NoOpen()) {
+   Status s = Init(options);
+   if (!s.ok()) {
+     fprintf (stderr, "[FATAL] open db failed, %s\n", s.ToString().c_str());
+     exit(-1);
+   }
+}
+
+Status Nemo::Open(const std::string &db_path, const Options &options, Nemo **nemo) {
+   *nemo = NULL;
+   Nemo *n = new Nemo(db_path, options, NoOpen());
+   Status s = n->Init(options);
+   if (!s.ok()) {
+     delete n;
+     return s;
+   }
+   *nemo = n;
+   return s;
+}
+
+Nemo::Nemo(const std::string &db_path, const Options &options, NoOpen)
     : db_path_(db_path),
+    mutex_hash_record_(port::RecordMutex::kDefaultStripes, options.exact_record_locks),
+    mutex_kv_record_(port::RecordMutex::kDefaultStripes, options.exact_record_locks),
+    mutex_list_record_(port::RecordMutex::kDefaultStripes, options.exact_record_locks),
+    mutex_zset_record_(port::RecordMutex::kDefaultStripes, options.exact_record_locks),
+    mutex_set_record_(port::RecordMutex::kDefaultStripes, options.exact_record_locks),
     save_flag_(false),
     bgtask_flag_(true),
-    bg_cv_(&mutex_bgtask_),
+    bg_scheduler_(new BGScheduler(this, options.bg_threads, options.bg_queue_size)),
+    expire_sweeper_(new ExpireSweeper(this, options.expire_sweep_rate, options.expire_sweep_interval)),
+    metrics_(new Metrics()),
+    kv_group_(NULL),
+    hash_group_(NULL),
+    list_group_(NULL),
+    zset_group_(NULL),
+    set_group_(NULL),
     scan_keynum_exit_(false),
-    dump_to_terminate_(false) {
+    dumping_(false),
+    column_family_layout_(options.column_family_layout),
+    scan_threads_(options.scan_threads > 0 ? options.scan_threads : 1),
+    raw_scan_file_size_(options.raw_scan_file_size > 0 ? options.raw_scan_file_size : 1),
+    write_fence_(new rocksdb::NemoWriteFence()),
+    lazy_open_(options.lazy_open && !options.column_family_layout) {
 
    DisableWAL = options.disable_wal;
+   SyncWrite = options.sync_write;
    
    std::cout << "disable wal is " << DisableWAL << "\n";
 
@@ -42,15 +116,20 @@ Nemo::Nemo(const std::string &db_path, const Options &options)
    if (db_path_[db_path_.length() - 1] != '/') {
      db_path_.append("/");
    }
+}
 
+Status Nemo::Init(const Options &options) {
    mkpath(db_path_.c_str(), 0755);
-   mkpath((db_path_ + "kv").c_str(), 0755);
-   mkpath((db_path_ + "hash").c_str(), 0755);
-   mkpath((db_path_ + "list").c_str(), 0755);
-   mkpath((db_path_ + "zset").c_str(), 0755);
-   mkpath((db_path_ + "set").c_str(), 0755);
-   mkpath((db_path_ + "meta").c_str(), 0755);   
-   mkpath((db_path_ + "raft").c_str(), 0755);
+   if (!column_family_layout_) {
+     mkpath((db_path_ + "kv").c_str(), 0755);
+     mkpath((db_path_ + "hash").c_str(), 0755);
+     mkpath((db_path_ + "list").c_str(), 0755);
+     mkpath((db_path_ + "zset").c_str(), 0755);
+     mkpath((db_path_ + "set").c_str(), 0755);
+     mkpath((db_path_ + "meta").c_str(), 0755);   
+     mkpath((db_path_ + "raft").c_str(), 0755);
+     mkpath((db_path_ + "expire").c_str(), 0755);
+   }
 
    cursors_store_.cur_size_ = 0;
    cursors_store_.max_size_ = 5000;
@@ -119,72 +198,207 @@ Nemo::Nemo(const std::string &db_path, const Options &options)
 
    //open_options_.max_bytes_for_level_base = (128 << 20);
 
-   rocksdb::DBNemo *db_ttl;
-
-   rocksdb::Status s = rocksdb::DBNemo::Open(open_options_, db_path_ + "kv", &db_ttl, rocksdb::kMetaPrefixKv);
+   rocksdb::Status s;
+   if (column_family_layout_) {
+     s = OpenColumnFamilies(options);
+   } else {
+     s = OpenDBs();
+   }
    if (!s.ok()) {
-     fprintf (stderr, "[FATAL] open kv db failed, %s\n", s.ToString().c_str());
-     exit(-1);
+     return s;
    }
-   kv_db_ = std::unique_ptr<rocksdb::DBNemo>(db_ttl);
 
-   s = rocksdb::DBNemo::Open(open_options_, db_path_ + "hash", &db_ttl, rocksdb::kMetaPrefixHash);
+   size_t meta_cache_capacity = options.meta_cache_capacity > 0 ? options.meta_cache_capacity : 0;
+   hash_db_->SetMetaCacheCapacity(meta_cache_capacity);
+   list_db_->SetMetaCacheCapacity(meta_cache_capacity);
+   zset_db_->SetMetaCacheCapacity(meta_cache_capacity);
+   set_db_->SetMetaCacheCapacity(meta_cache_capacity);
+
+   kv_db_->SetRowCacheCapacity(options.row_cache_capacity);
+   hash_db_->SetRowCacheCapacity(options.row_cache_capacity);
+
+   int key_filter_bits = options.key_filter_bits_per_key > 0 ? options.key_filter_bits_per_key : 0;
+   kv_db_->EnableKeyFilter(key_filter_bits);
+   hash_db_->EnableKeyFilter(key_filter_bits);
+   list_db_->EnableKeyFilter(key_filter_bits);
+   zset_db_->EnableKeyFilter(key_filter_bits);
+   set_db_->EnableKeyFilter(key_filter_bits);
+
+   kv_group_ = new WriteGroup(kv_db_.get(), options.write_group, options.write_group_bytes);
+   hash_group_ = new WriteGroup(hash_db_.get(), options.write_group, options.write_group_bytes);
+   list_group_ = new WriteGroup(list_db_.get(), options.write_group, options.write_group_bytes);
+   zset_group_ = new WriteGroup(zset_db_.get(), options.write_group, options.write_group_bytes);
+   set_group_ = new WriteGroup(set_db_.get(), options.write_group, options.write_group_bytes);
+
+   // Add separator of Meta and data
+   hash_db_->Put(rocksdb::WriteOptions(), "h", "");
+   list_db_->Put(rocksdb::WriteOptions(), "l", "");
+   zset_db_->Put(rocksdb::WriteOptions(), "y", "");
+   zset_db_->Put(rocksdb::WriteOptions(), "z", "");
+   set_db_->Put(rocksdb::WriteOptions(), "s", "");
+
+   // Start BGThread
+   s = StartBGThread();
    if (!s.ok()) {
-     fprintf (stderr, "[FATAL] open hash db failed, %s\n", s.ToString().c_str());
-     exit(-1);
+     log_warn("start bg thread error: %s", s.ToString().c_str());
+     return s;
    }
-   hash_db_ = std::unique_ptr<rocksdb::DBNemo>(db_ttl);
+   expire_sweeper_->Start();
+   if (options.metrics) {
+     EnableMetrics(true, options.metrics_perf_sample);
+   }
+   if (options.key_profiler) {
+     EnableKeyProfiler(true, options.key_profiler_sample);
+   }
+   return s;
+}
 
-   s = rocksdb::DBNemo::Open(open_options_, db_path_ + "list", &db_ttl, rocksdb::kMetaPrefixList);
+Status Nemo::OpenDB(const std::string &type, char meta_prefix, std::unique_ptr<rocksdb::DBNemo> *db,
+                    DBOpenStats *stats) {
+   stats->type = type;
+   stats->deferred = false;
+   stats->wal_bytes = WalBytes(db_path_ + type);
+   uint64_t start = NowMicros();
+   // a copy each, Open writes to it and the dbs open concurrently
+   rocksdb::Options options(open_options_);
+   rocksdb::DBNemo *db_ttl;
+   Status s = rocksdb::DBNemo::Open(options, db_path_ + type, &db_ttl, meta_prefix);
+   stats->micros = NowMicros() - start;
    if (!s.ok()) {
-     fprintf (stderr, "[FATAL] open list db failed, %s\n", s.ToString().c_str());
-     exit(-1);
+     log_warn("open %s db failed, %s", type.c_str(), s.ToString().c_str());
+     return s;
    }
-   list_db_ = std::unique_ptr<rocksdb::DBNemo>(db_ttl);
+   db_ttl->SetWriteFence(write_fence_);
+   db->reset(db_ttl);
+   return s;
+}
 
-   s = rocksdb::DBNemo::Open(open_options_, db_path_ + "zset", &db_ttl, rocksdb::kMetaPrefixZset);
-   if (!s.ok()) {
-     fprintf (stderr, "[FATAL] open zset db failed, %s\n", s.ToString().c_str());
-     exit(-1);
+// Each db on its own thread, so that the WAL replays overlap. The first
+// failure is returned, the dbs opened are closed by the destructor.
+Status Nemo::OpenDBs() {
+   if (is_dir((db_path_ + CF_LAYOUT_DB + "/CURRENT").c_str()) == 1) {
+     return Status::InvalidArgument(db_path_ + " is in the column family layout, set column_family_layout");
    }
-   zset_db_ = std::unique_ptr<rocksdb::DBNemo>(db_ttl);
 
-   s = rocksdb::DBNemo::Open(open_options_, db_path_ + "set", &db_ttl, rocksdb::kMetaPrefixSet);
-   if (!s.ok()) {
-     fprintf (stderr, "[FATAL] open set db failed, %s\n", s.ToString().c_str());
-     exit(-1);
+   struct DBToOpen {
+     std::string type;
+     char meta_prefix;
+     std::unique_ptr<rocksdb::DBNemo> *db;
+   };
+   DBToOpen dbs[] = {
+     {KV_DB, rocksdb::kMetaPrefixKv, &kv_db_},
+     {HASH_DB, rocksdb::kMetaPrefixHash, &hash_db_},
+     {LIST_DB, rocksdb::kMetaPrefixList, &list_db_},
+     {ZSET_DB, rocksdb::kMetaPrefixZset, &zset_db_},
+     {SET_DB, rocksdb::kMetaPrefixSet, &set_db_},
+     {META_DB, rocksdb::kMetaPrefixMeta, &meta_db_},
+     {RAFT_DB, rocksdb::kMetaPrefixRaft, &raft_db_},
+     {EXPIRE_DB, rocksdb::kMetaPrefixMeta, &expire_db_}
+   };
+   const int n = sizeof(dbs) / sizeof(dbs[0]);
+   std::vector<Status> statuses(n);
+   std::vector<DBOpenStats> stats(n);
+   std::vector<std::thread> threads;
+   for (int i = 0; i < n; i++) {
+     if (lazy_open_ && (dbs[i].type == META_DB || dbs[i].type == RAFT_DB)) {
+       stats[i].type = dbs[i].type;
+       stats[i].deferred = true;
+       continue;
+     }
+     threads.push_back(std::thread([this, &dbs, &statuses, &stats, i]() {
+       statuses[i] = OpenDB(dbs[i].type, dbs[i].meta_prefix, dbs[i].db, &stats[i]);
+     }));
+   }
+   for (size_t i = 0; i < threads.size(); i++) {
+     threads[i].join();
    }
-   set_db_ = std::unique_ptr<rocksdb::DBNemo>(db_ttl);
 
-   s = rocksdb::DBNemo::Open(open_options_, db_path_ + "meta", &db_ttl, rocksdb::kMetaPrefixMeta);
-   if (!s.ok()) {
-     fprintf (stderr, "[FATAL] open meta db failed, %s\n", s.ToString().c_str());
-     exit(-1);
+   open_mu_.Lock();
+   open_stats_ = stats;
+   open_mu_.Unlock();
+   for (int i = 0; i < n; i++) {
+     if (!statuses[i].ok()) {
+       return statuses[i];
+     }
    }
-   meta_db_ = std::unique_ptr<rocksdb::DBNemo>(db_ttl);
+   return Status::OK();
+}
 
-  s = rocksdb::DBNemo::Open(open_options_, db_path_ + "raft", &db_ttl, rocksdb::kMetaPrefixRaft);
-   if (!s.ok()) {
-     fprintf (stderr, "[FATAL] open raft db failed, %s\n", s.ToString().c_str());
-     exit(-1);
+rocksdb::DBNemo *Nemo::OpenDeferred(const std::string &type) {
+   std::unique_ptr<rocksdb::DBNemo> *db = type == META_DB ? &meta_db_ : &raft_db_;
+   char meta_prefix = type == META_DB ? rocksdb::kMetaPrefixMeta : rocksdb::kMetaPrefixRaft;
+   open_mu_.Lock();
+   if (*db == NULL) {
+     DBOpenStats stats;
+     if (OpenDB(type, meta_prefix, db, &stats).ok()) {
+       for (size_t i = 0; i < open_stats_.size(); i++) {
+         if (open_stats_[i].type == type) {
+           open_stats_[i] = stats;
+         }
+       }
+     }
    }
-   raft_db_ = std::unique_ptr<rocksdb::DBNemo>(db_ttl);
+   rocksdb::DBNemo *result = db->get();
+   open_mu_.Unlock();
+   return result;
+}
 
-   // Add separator of Meta and data
-   hash_db_->Put(rocksdb::WriteOptions(), "h", "");
-   list_db_->Put(rocksdb::WriteOptions(), "l", "");
-   zset_db_->Put(rocksdb::WriteOptions(), "y", "");
-   zset_db_->Put(rocksdb::WriteOptions(), "z", "");
-   set_db_->Put(rocksdb::WriteOptions(), "s", "");
+void Nemo::GetOpenStats(std::vector<DBOpenStats> *stats) {
+   open_mu_.Lock();
+   *stats = open_stats_;
+   open_mu_.Unlock();
+}
 
-   // Start BGThread
-   s = StartBGThread();
+// All the types in one db, kv in the default column family.
+// The DBNemos share the base db, whichever is deleted last closes it.
+Status Nemo::OpenColumnFamilies(const Options &options) {
+   if (is_dir((db_path_ + KV_DB + "/CURRENT").c_str()) == 1) {
+     return Status::InvalidArgument(db_path_ + " has one db per type, convert it with tools/migrate first");
+   }
+
+   rocksdb::DBOptions db_options(open_options_);
+   if (options.db_write_buffer_size > 0) {
+     db_options.db_write_buffer_size = options.db_write_buffer_size;
+   }
+   rocksdb::ColumnFamilyOptions cf_options(open_options_);
+
+   std::vector<rocksdb::NemoColumnFamilyDescriptor> column_families;
+   column_families.push_back(rocksdb::NemoColumnFamilyDescriptor(rocksdb::kDefaultColumnFamilyName, rocksdb::kMetaPrefixKv, cf_options));
+   column_families.push_back(rocksdb::NemoColumnFamilyDescriptor(HASH_DB, rocksdb::kMetaPrefixHash, cf_options));
+   column_families.push_back(rocksdb::NemoColumnFamilyDescriptor(LIST_DB, rocksdb::kMetaPrefixList, cf_options));
+   column_families.push_back(rocksdb::NemoColumnFamilyDescriptor(ZSET_DB, rocksdb::kMetaPrefixZset, cf_options));
+   column_families.push_back(rocksdb::NemoColumnFamilyDescriptor(SET_DB, rocksdb::kMetaPrefixSet, cf_options));
+   column_families.push_back(rocksdb::NemoColumnFamilyDescriptor(META_DB, rocksdb::kMetaPrefixMeta, cf_options));
+   column_families.push_back(rocksdb::NemoColumnFamilyDescriptor(RAFT_DB, rocksdb::kMetaPrefixRaft, cf_options));
+   column_families.push_back(rocksdb::NemoColumnFamilyDescriptor(EXPIRE_DB, rocksdb::kMetaPrefixMeta, cf_options));
+
+   std::vector<rocksdb::DBNemo*> dbs;
+   DBOpenStats stats;
+   stats.type = CF_LAYOUT_DB;
+   stats.wal_bytes = WalBytes(db_path_ + CF_LAYOUT_DB);
+   uint64_t start = NowMicros();
+   Status s = rocksdb::DBNemo::OpenColumnFamilies(db_options, db_path_ + CF_LAYOUT_DB, column_families, &dbs);
+   stats.micros = NowMicros() - start;
+   open_mu_.Lock();
+   open_stats_.assign(1, stats);
+   open_mu_.Unlock();
    if (!s.ok()) {
-     log_err("start bg thread error: %s", s.ToString().c_str());
-     fprintf (stderr, "[FATAL] start bg thread failed, %s\n", s.ToString().c_str());
-     exit(-1);
+     log_warn("open column families failed, %s", s.ToString().c_str());
+     return s;
    }
-};
+   for (size_t i = 0; i < dbs.size(); i++) {
+     dbs[i]->SetWriteFence(write_fence_);
+   }
+   kv_db_.reset(dbs[0]);
+   hash_db_.reset(dbs[1]);
+   list_db_.reset(dbs[2]);
+   zset_db_.reset(dbs[3]);
+   set_db_.reset(dbs[4]);
+   meta_db_.reset(dbs[5]);
+   raft_db_.reset(dbs[6]);
+   expire_db_.reset(dbs[7]);
+   return s;
+}
 
 /*
 rocksdb::ColumnFamilyHandle* Nemo::GetCFHandleByname(const std::string name){
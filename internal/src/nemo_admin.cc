@@ -14,6 +14,11 @@
 #include "nemo_zset.h"
 #include "nemo_set.h"
 #include "nemo_list.h"
+#include "nemo_backupable.h"
+#include "nemo_bg_scheduler.h"
+#include "nemo_expire.h"
+#include "nemo_metrics.h"
+#include "nemo_write_group.h"
 #include "util.h"
 #include "xdebug.h"
 #include "rocksdb/sst_file_writer.h"
@@ -21,6 +26,7 @@
 //#include "nemo_meta.h"
 #include <algorithm>
 #include <vector>
+#include <thread>
 
 #include <iostream>
 
@@ -28,113 +34,6 @@ using namespace nemo;
 
 const std::string DEFAULT_BG_PATH = "dump";
 
-Status Nemo::SaveDBNemo(const std::string &db_path, const std::string &key_type, const char meta_prefix, std::unique_ptr<rocksdb::DBNemo> &src_db, const rocksdb::Snapshot *snapshot) {
-  //printf ("db_path=%s\n", db_path.c_str());
-
-  rocksdb::DBNemo *dst_db;
-  rocksdb::Options option(open_options_);
-
-  rocksdb::Status s = rocksdb::DBNemo::Open(option, db_path, &dst_db, meta_prefix);
-  if (!s.ok()) {
-    log_err("save db %s, open error %s", db_path.c_str(), s.ToString().c_str());
-    return s;
-  }
-
-  //printf ("\nSaveDBNemo seqnumber=%d\n", snapshot->GetSequenceNumber());
-  int64_t ttl;
-  rocksdb::ReadOptions iterate_options;
-  iterate_options.snapshot = snapshot;
-  iterate_options.fill_cache = false;
-
-  rocksdb::Iterator* it = src_db->NewIterator(iterate_options);
-  for (it->SeekToFirst(); it->Valid() && !dump_to_terminate_; it->Next()) {
-    std::string raw_key(it->key().data(), it->key().size());
-
-    if (key_type == KV_DB) {
-      s = KTTL(it->key().ToString(), &ttl);
-    } else if (key_type == HASH_DB) {
-      if (raw_key[0] == meta_prefix) {
-        s = HTTL(raw_key.substr(1), &ttl);
-        //printf ("0.1 DB:%s meta_prefix=%c raw_key(%s) ttl return %s, ttl is %ld\n", key_type.c_str(), meta_prefix, raw_key.c_str(), s.ToString().c_str(), ttl);
-      } else {
-        int32_t len = *((uint8_t *)(raw_key.data() + 1));
-        std::string key(raw_key.data() + 2, len);
-        s = HTTL(key, &ttl);
-        //printf ("0.2 DB:%s meta_prefix=%c raw_key(%s) key(%s) ttl return %s, ttl is %ld\n", key_type.c_str(), meta_prefix, raw_key.c_str(), key.c_str(), s.ToString().c_str(), ttl);
-      }
-    } else if (key_type == LIST_DB) {
-      if (raw_key[0] == meta_prefix) {
-        s = LTTL(raw_key.substr(1), &ttl);
-      } else {
-        int32_t len = *((uint8_t *)(raw_key.data() + 1));
-        std::string key(raw_key.data() + 2, len);
-        s = LTTL(key, &ttl);
-      }
-    } else if (key_type == ZSET_DB) {
-      if (raw_key[0] == meta_prefix) {
-        s = ZTTL(raw_key.substr(1), &ttl);
-      } else {
-        int32_t len = *((uint8_t *)(raw_key.data() + 1));
-        std::string key(raw_key.data() + 2, len);
-        s = ZTTL(key, &ttl);
-      }
-    } else if (key_type == SET_DB) {
-      if (raw_key[0] == meta_prefix) {
-        s = STTL(raw_key.substr(1), &ttl);
-      } else {
-        int32_t len = *((uint8_t *)(raw_key.data() + 1));
-        std::string key(raw_key.data() + 2, len);
-        s = STTL(key, &ttl);
-      }
-    }
-    if (s.ok()) {
-      if (ttl == -1) {
-        s = dst_db->Put(rocksdb::WriteOptions(), it->key().ToString(), it->value().ToString());
-      } else if (ttl > 0) {
-        s = dst_db->Put(rocksdb::WriteOptions(), it->key().ToString(), it->value().ToString(), ttl);
-      }
-    }
-  }
-  delete it;
-  //src_db->ReleaseSnapshot(iterate_options.snapshot);
-  delete dst_db;
-
-  return Status::OK();
-}
-
-Status Nemo::SaveDB(const std::string &db_path, std::unique_ptr<rocksdb::DB> &src_db, const rocksdb::Snapshot *snapshot) {
-  if (opendir(db_path.c_str()) == NULL) {
-    mkdir(db_path.c_str(), 0755);
-  }
-
-  //printf ("db_path=%s\n", db_path.c_str());
-
-  rocksdb::DB* dst_db;
-  rocksdb::Status s = rocksdb::DB::Open(open_options_, db_path, &dst_db);
-  if (!s.ok()) {
-    log_err("save db %s, open error %s", db_path.c_str(), s.ToString().c_str());
-    return s;
-  }
-
-  //printf ("\nSaveDB seqnumber=%d\n", snapshot->GetSequenceNumber());
-  rocksdb::ReadOptions iterate_options;
-  iterate_options.snapshot = snapshot;
-  iterate_options.fill_cache = false;
-
-  rocksdb::Iterator* it = src_db->NewIterator(iterate_options);
-  for (it->SeekToFirst(); it->Valid(); it->Next()) {
-    // printf ("SaveDB key=(%s) value=(%s) val_size=%u\n", it->key().ToString().c_str(), it->value().ToString().c_str(),
-    //        it->value().ToString().size());
-
-    s = dst_db->Put(rocksdb::WriteOptions(), it->key().ToString(), it->value().ToString());
-  }
-  delete it;
-  src_db->ReleaseSnapshot(iterate_options.snapshot);
-  delete dst_db;
-
-  return Status::OK();
-}
-
 //Status Nemo::BGSaveReleaseSnapshot(Snapshots &snapshots) {
 //
 //    // Note the order which is decided by GetSnapshot
@@ -216,50 +115,49 @@ Status Nemo::BGSaveGetSnapshot(Snapshots &snapshots) {
   return Status::OK();
 }
 
-struct SaveArgs {
-  void *p;
-  const std::string key_type;
-  Snapshot *snapshot;
-
-  SaveArgs(void *_p, const std::string &_key_type, Snapshot* _snapshot)
-      : p(_p), key_type(_key_type), snapshot(_snapshot) {};
-};
-
-void* call_BGSaveSpecify(void *arg) {
-
-  Nemo* p = (Nemo*)(((SaveArgs*)arg)->p);
-  Snapshot* snapshot = ((SaveArgs*)arg)->snapshot;
-  std::string key_type = ((SaveArgs*)arg)->key_type;
-  Status s = p->BGSaveSpecify(key_type, snapshot);
-  return nullptr;
-}
-
+// A checkpoint of the db of key_type, or of the only db in the column
+// family layout, under dump_path_ as of the call, not of snapshot
 Status Nemo::BGSaveSpecify(const std::string key_type, Snapshot* snapshot) {
-  //void* Nemo::BGSaveSpecify(void *arg) {
-  Status s;
-
-  if (key_type == KV_DB) {
-    s = SaveDBNemo(dump_path_ + KV_DB, key_type, '\0', kv_db_, snapshot);
-  } else if (key_type == HASH_DB) {
-    s = SaveDBNemo(dump_path_ + HASH_DB, key_type, DataType::kHSize, hash_db_, snapshot);
-  } else if (key_type == ZSET_DB) {
-    s = SaveDBNemo(dump_path_ + ZSET_DB, key_type, DataType::kZSize, zset_db_, snapshot);
-  } else if (key_type == SET_DB) {
-    s = SaveDBNemo(dump_path_ + SET_DB, key_type, DataType::kSSize, set_db_, snapshot);
-  } else if (key_type == LIST_DB) {
-    s = SaveDBNemo(dump_path_ + LIST_DB, key_type, DataType::kLMeta, list_db_, snapshot);
-  } else {
-    s = Status::InvalidArgument("");
+  rocksdb::DBNemo *db = GetDBByType(key_type);
+  if (db == NULL) {
+    return Status::InvalidArgument("");
   }
-
+  std::string path;
   {
     MutexLock l(&mutex_dump_);
-    dump_pthread_ts_.erase(key_type);
+    path = dump_path_.empty() ? DEFAULT_BG_PATH + "/" : dump_path_;
+  }
+  mkpath(path.c_str(), 0755);
+  std::string dir = path + (column_family_layout_ ? CF_LAYOUT_DB : key_type);
+
+  rocksdb::DBNemoCheckpoint *checkpoint;
+  Status s = rocksdb::DBNemoCheckpoint::Create(db, &checkpoint);
+  if (!s.ok()) {
+    return s;
+  }
+  std::vector<std::string> live_files;
+  rocksdb::VectorLogPtr live_wal_files;
+  uint64_t manifest_file_size, sequence_number;
+  s = checkpoint->GetCheckpointFiles(live_files, live_wal_files, manifest_file_size,
+                                     sequence_number, w_opts_nolog().disableWAL);
+  if (s.ok()) {
+    delete_dir(dir.c_str());
+    s = checkpoint->CreateCheckpointWithFiles(dir, live_files, live_wal_files,
+                                              manifest_file_size, sequence_number);
+  }
+  delete checkpoint;
+  if (!s.ok()) {
+    log_warn("save %s to %s failed, %s", key_type.c_str(), dir.c_str(), s.ToString().c_str());
   }
   return s;
 }
 
-
+// A checkpoint of every db, the sst files hard linked and the WAL files up
+// to the point where the write fence was closed over all of them, so that
+// the saved dbs hold one state of the instance and open as one with
+// path as db_path. Nothing is copied key by key: the expired keys go with
+// the compactions of the restored instance. The snapshots are released
+// only, the save is as of the call.
 Status Nemo::BGSave(Snapshots &snapshots, const std::string &db_path) {
   std::string path = db_path;
   if (path.empty()) {
@@ -275,84 +173,45 @@ Status Nemo::BGSave(Snapshots &snapshots, const std::string &db_path) {
 
   {
     MutexLock l(&mutex_dump_);
-    if (dump_pthread_ts_.size() != 0 || dump_snapshots_.size() != 0) {
+    if (dumping_) {
       return Status::Corruption("DB dumping is performing.");
     }
     dump_path_ = path;
-    dump_to_terminate_ = false;
-  }
-
-  Status s;
-
-  pthread_t tid[5];
-  SaveArgs *arg_kv = new SaveArgs(this, KV_DB, snapshots[0]);
-  if (pthread_create(&tid[0], NULL, &call_BGSaveSpecify, arg_kv) != 0) {
-    return Status::Corruption("pthead_create failed.");
-  }
-
-  SaveArgs *arg_hash = new SaveArgs(this, HASH_DB, snapshots[1]);
-  if (pthread_create(&tid[1], NULL, &call_BGSaveSpecify, arg_hash) != 0) {
-    return Status::Corruption("pthead_create failed.");
-  }
-
-  SaveArgs *arg_zset = new SaveArgs(this, ZSET_DB, snapshots[2]);
-  if (pthread_create(&tid[2], NULL, &call_BGSaveSpecify, arg_zset) != 0) {
-    return Status::Corruption("pthead_create failed.");
-  }
-
-  SaveArgs *arg_set = new SaveArgs(this, SET_DB, snapshots[3]);
-  if (pthread_create(&tid[3], NULL, &call_BGSaveSpecify, arg_set) != 0) {
-    return Status::Corruption("pthead_create failed.");
-  }
-
-  SaveArgs *arg_list = new SaveArgs(this, LIST_DB, snapshots[4]);
-  if (pthread_create(&tid[4], NULL, &call_BGSaveSpecify, arg_list) != 0) {
-    return Status::Corruption("pthead_create failed.");
-  }
-
-  {
-    MutexLock l(&mutex_dump_);
-    dump_pthread_ts_[KV_DB] = tid[0];
-    dump_pthread_ts_[HASH_DB] = tid[1];
-    dump_pthread_ts_[ZSET_DB] = tid[2];
-    dump_pthread_ts_[SET_DB] = tid[3];
-    dump_pthread_ts_[LIST_DB] = tid[4];
+    dumping_ = true;
     dump_snapshots_ = snapshots;
   }
 
-  int ret;
-  void *retval;
-  for (int i = 0; i < 5; i++) {
-    if ((ret = pthread_join(tid[i], &retval)) != 0) {
-      std::string msg = std::to_string(ret);
-      return Status::Corruption("pthead_join failed with " + msg);
+  BackupEngine *engine = NULL;
+  Status s = BackupEngine::Open(this, &engine);
+  if (s.ok()) {
+    s = engine->SetBackupContent();
+    if (s.ok()) {
+      s = engine->CreateNewBackup(path);
     }
+    delete engine;
+  }
+  if (!s.ok()) {
+    log_warn("save to %s failed, %s", path.c_str(), s.ToString().c_str());
   }
 
   {
     MutexLock l(&mutex_dump_);
-    kv_db_->ReleaseSnapshot(dump_snapshots_[0]);
-    hash_db_->ReleaseSnapshot(dump_snapshots_[1]);
-    zset_db_->ReleaseSnapshot(dump_snapshots_[2]);
-    set_db_->ReleaseSnapshot(dump_snapshots_[3]);
-    list_db_->ReleaseSnapshot(dump_snapshots_[4]);
-    dump_pthread_ts_.clear();
+    if (dump_snapshots_.size() == 5) {
+      kv_db_->ReleaseSnapshot(dump_snapshots_[0]);
+      hash_db_->ReleaseSnapshot(dump_snapshots_[1]);
+      zset_db_->ReleaseSnapshot(dump_snapshots_[2]);
+      set_db_->ReleaseSnapshot(dump_snapshots_[3]);
+      list_db_->ReleaseSnapshot(dump_snapshots_[4]);
+    }
     dump_snapshots_.clear();
-    dump_to_terminate_ = true;
+    dumping_ = false;
   }
-
-  delete arg_kv;
-  delete arg_hash;
-  delete arg_zset;
-  delete arg_set;
-  delete arg_list;
-
-  return Status::OK();
+  return s;
 }
 
+// A checkpoint is not stopped halfway, BGSave returns once its files are
+// linked, which takes no longer than stopping it would
 Status Nemo::BGSaveOff() {
-  sleep(1);
-  dump_to_terminate_ = true;
   return Status::OK();
 }
 
@@ -565,6 +424,8 @@ std::string Nemo::GetCurrentTaskType() {
   switch (type) {
     case kDEL_KEY:
       return "Key";
+    case kCLEAN_RANGE:
+      return "Range";
     case kCLEAN_ALL:
       return "All";
     case kNONE_OP:
@@ -585,6 +446,12 @@ rocksdb::DBNemo* Nemo::GetDBByType(const std::string& type) {
     return set_db_.get();
   else if (type == ZSET_DB)
     return zset_db_.get();
+  else if (type == META_DB)
+    return GetMetaHandle();
+  else if (type == RAFT_DB)
+    return GetRaftHandle();
+  else if (type == EXPIRE_DB)
+    return expire_db_.get();
   else
     return NULL;
 }
@@ -603,150 +470,182 @@ void FindLongSuccessor(std::string* key) {
 
 //
 // BGTask related 
-Status Nemo::CompactKey(const DBType type, const rocksdb::Slice& key) {
+void Nemo::KeyCompactRanges(const DBType type, const rocksdb::Slice& key, KeyRanges *ranges) {
   std::string key_begin;
   std::string key_end;
 
-  current_task_type_ = OPERATION::kDEL_KEY;
-  rocksdb::CompactRangeOptions ops;
-  ops.exclusive_manual_compaction = false;
-
   if (type == DBType::kALL || type == DBType::kHASH_DB) {
     key_begin = EncodeHashKey(key, "");
     key_end = key_begin;
     FindLongSuccessor(&key_end);
-    rocksdb::Slice sb(key_begin);
-    rocksdb::Slice se(key_end);
-
-    hash_db_->CompactRange(ops, &sb, &se);
+    ranges->push_back(std::make_pair(key_begin, key_end));
   }
 
   if (type == DBType::kALL || type == DBType::kLIST_DB) {
     key_begin = EncodeListKey(key, 0);
     key_end = EncodeListKey(key, -1);
-    //key_end = key_begin;
-    //key_end.append(str);
-    //FindLongSuccessor(key_end);
-    rocksdb::Slice sb(key_begin);
-    rocksdb::Slice se(key_end);
-    //int result = memcmp(sb.data(), se.data(), sb.size());
-    //printf ("LIST Memcmp sb=(%s),%u se=(%s),%u return %d\n", sb.data(), sb.size(), se.data(), se.size(), result);
-    //printf (" Slice.compare return %d\n", sb.compare(se));
-
-    list_db_->CompactRange(ops, &sb, &se);
+    ranges->push_back(std::make_pair(key_begin, key_end));
   }
 
   if (type == DBType::kALL || type == DBType::kSET_DB) {
     key_begin = EncodeSetKey(key, "");
     key_end = key_begin;
     FindLongSuccessor(&key_end);
-    rocksdb::Slice sb(key_begin);
-    rocksdb::Slice se(key_end);
-
-    set_db_->CompactRange(ops, &sb, &se);
+    ranges->push_back(std::make_pair(key_begin, key_end));
   }
 
   if (type == DBType::kALL || type == DBType::kZSET_DB) {
     key_begin = EncodeZSetKey(key, "");
     key_end = key_begin;
     FindLongSuccessor(&key_end);
-    rocksdb::Slice sb(key_begin);
-    rocksdb::Slice se(key_end);
-    //int result = memcmp(sb.data(), se.data(), sb.size());
-    //printf ("ZSET Memcmp sb=(%s),%u se=(%s),%u return %d\n", sb.data(), sb.size(), se.data(), se.size(), result);
-    //printf (" Slice.compare return %d\n", sb.compare(se));
-    zset_db_->CompactRange(ops, &sb, &se);
+    ranges->push_back(std::make_pair(key_begin, key_end));
 
     key_begin = EncodeZScoreKey(key, "", ZSET_SCORE_MIN);
     key_end = EncodeZScoreKey(key, "", ZSET_SCORE_MAX);
-    rocksdb::Slice zb(key_begin);
-    rocksdb::Slice ze(key_end);
-
-    zset_db_->CompactRange(ops, &zb, &ze);
+    ranges->push_back(std::make_pair(key_begin, key_end));
   }
+}
 
-  current_task_type_ = OPERATION::kNONE_OP;
-
+Status Nemo::CompactKey(const DBType type, const rocksdb::Slice& key) {
+  DBType types[] = {DBType::kHASH_DB, DBType::kLIST_DB, DBType::kSET_DB, DBType::kZSET_DB};
+  for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+    if (type != DBType::kALL && type != types[i]) {
+      continue;
+    }
+    KeyRanges ranges;
+    KeyCompactRanges(types[i], key, &ranges);
+    for (size_t j = 0; j < ranges.size(); j++) {
+      CompactRange(types[i], ranges[j].first, ranges[j].second, OPERATION::kDEL_KEY);
+    }
+  }
   return Status::OK();
 }
 
-Status Nemo::AddBGTask(const BGTask& task) {
-  //printf ("AddBGTask task{ type=%d, op=%d argv1= %s}\n", task.type, task.op, task.argv1.c_str());
-#define BG_TASK_THRESHOLD 10000 
-  mutex_bgtask_.Lock();
-  if (task.op == kCLEAN_ALL) {
-    std::queue<BGTask> empty_queue;
-    std::swap(bg_tasks_, empty_queue);
-    bg_tasks_.push(task);
-    bg_cv_.Signal();
-  } else if (bg_tasks_.size() <= BG_TASK_THRESHOLD) {
-    bg_tasks_.push(task);
-    bg_cv_.Signal();
+Status Nemo::CompactRange(const DBType type, const std::string& begin, const std::string& end, OPERATION op) {
+  rocksdb::DBNemo* db;
+  switch (type) {
+    case DBType::kKV_DB: db = kv_db_.get(); break;
+    case DBType::kHASH_DB: db = hash_db_.get(); break;
+    case DBType::kLIST_DB: db = list_db_.get(); break;
+    case DBType::kZSET_DB: db = zset_db_.get(); break;
+    case DBType::kSET_DB: db = set_db_.get(); break;
+    default: return Status::InvalidArgument("no db of type");
   }
-  //printf ("AddBGTask push task{ type=%d, op=%d argv1= %s}, Signal\n", task.type, task.op, task.argv1.c_str());
-  mutex_bgtask_.Unlock();
-  //printf ("AddBGTask push task{ type=%d, op=%d argv1= %s}, after Signal\n", task.type, task.op, task.argv1.c_str());
 
+  current_task_type_ = op;
+  rocksdb::CompactRangeOptions ops;
+  ops.exclusive_manual_compaction = false;
+  rocksdb::Slice sb(begin);
+  rocksdb::Slice se(end);
+  Status s = db->CompactRange(ops, &sb, end.empty() ? NULL : &se);
+  current_task_type_ = OPERATION::kNONE_OP;
+  return s;
+}
+
+// Waits while the queue is full, see BGScheduler
+Status Nemo::AddBGTask(const BGTask& task) {
+  bg_scheduler_->Add(task);
   return Status::OK();
 }
 
 Status Nemo::RunBGTask() {
-  BGTask task;
+  bg_scheduler_->Work(-1);
+  return Status::Incomplete("bgtask return with bgtask_flag_ false");
+}
+
+Status Nemo::StartBGThread() {
+  return bg_scheduler_->Start();
+}
 
-  while (bgtask_flag_) {
-    //printf ("RunBGTask main loop\n");
-    mutex_bgtask_.Lock();
-    //printf ("RunBGTask main loop mutex-lock\n");
+void Nemo::StopBGThread() {
+  bg_scheduler_->Stop();
+  delete bg_scheduler_;
+  bg_scheduler_ = NULL;
+}
 
-    while (bg_tasks_.empty() && bgtask_flag_ ) {
-      //printf ("RunBGTask main loop task.empty, bg_cv_ will Wait\n");
-      bg_cv_.Wait();
-      //printf ("RunBGTask main loop task.empty, bg_cv_ startup\n");
-    }
+void Nemo::GetBGTaskStats(BGTaskStats *stats) {
+  bg_scheduler_->GetStats(stats);
+}
 
-    if (!bg_tasks_.empty()) {
-      task = bg_tasks_.front();
-      bg_tasks_.pop();
-    }
-    mutex_bgtask_.Unlock();
+Status Nemo::SweepExpired(int64_t max_entries, int64_t *expired) {
+  return expire_sweeper_->Sweep(max_entries, expired);
+}
 
-    if (!bgtask_flag_) {
-      return Status::Incomplete("bgtask return with bgtask_flag_ false");
-    }
+void Nemo::StopExpireSweeper() {
+  expire_sweeper_->Stop();
+  delete expire_sweeper_;
+  expire_sweeper_ = NULL;
+}
+
+void Nemo::GetExpireStats(ExpireStats *stats) {
+  expire_sweeper_->GetStats(stats);
+}
+
+void Nemo::EnableMetrics(bool enabled, int perf_sample) {
+  metrics_->Enable(enabled, perf_sample);
+}
+
+void Nemo::GetMetrics(std::vector<CommandMetrics> *metrics) {
+  metrics_->Get(metrics);
+}
 
-    switch (task.op) {
-      case kDEL_KEY:
-        //printf ("BGTask run task { type=%d, argv1=%s}\n", task.type, task.argv1.c_str());
-        CompactKey(task.type, task.argv1);
-        break;
-      case kCLEAN_RANGE:
-        break;
-      case kCLEAN_ALL:
-        DoCompact(task.type);
-        break;
-      default:
-        break;
+void Nemo::ResetMetrics() {
+  metrics_->Reset();
+}
+
+void Nemo::EnableKeyProfiler(bool enabled, int sample_every) {
+  metrics_->profiler()->Enable(enabled, sample_every);
+}
+
+void Nemo::GetKeyProfile(KeyProfile *profile) {
+  metrics_->profiler()->Get(profile);
+  std::vector<ProfiledKey> big_keys;
+  for (size_t i = 0; i < profile->big_keys.size(); i++) {
+    ProfiledKey &k = profile->big_keys[i];
+    Status s;
+    if (k.type == HASH_DB) {
+      HashMeta meta;
+      s = HGetMetaByKey(k.key, meta);
+      k.len = meta.len;
+      k.vol = meta.vol;
+    } else if (k.type == LIST_DB) {
+      ListMeta meta;
+      s = LGetMetaByKey(k.key, meta);
+      k.len = meta.len;
+      k.vol = meta.vol;
+    } else if (k.type == ZSET_DB) {
+      ZSetMeta meta;
+      s = ZGetMetaByKey(k.key, meta);
+      k.len = meta.len;
+      k.vol = meta.vol;
+    } else if (k.type == SET_DB) {
+      SetMeta meta;
+      s = SGetMetaByKey(k.key, meta);
+      k.len = meta.len;
+      k.vol = meta.vol;
+    }
+    if (s.ok() && k.len > 0) {
+      big_keys.push_back(k);
     }
   }
-
-  return Status::OK();
+  profile->big_keys.swap(big_keys);
 }
 
-static void* StartBGThreadWrapper(void* arg) {
-  Nemo* n = reinterpret_cast<Nemo*>(arg);
-  n->RunBGTask();
-  return NULL;
+void Nemo::ResetKeyProfile() {
+  metrics_->profiler()->Reset();
 }
 
-Status Nemo::StartBGThread() {
-  int result = pthread_create(&bg_tid_, NULL,  &StartBGThreadWrapper, this);
-  if (result != 0) {
-    char msg[128];
-    snprintf (msg, 128, "pthread create: %s", strerror(result));
-    return Status::Corruption(msg);
+void Nemo::DeleteWriteGroups() {
+  WriteGroup **groups[] = {&kv_group_, &hash_group_, &list_group_, &zset_group_, &set_group_};
+  for (int i = 0; i < 5; i++) {
+    delete *groups[i];
+    *groups[i] = NULL;
   }
+}
 
-  return Status::OK();
+void Nemo::DeleteMetrics() {
+  delete metrics_;
+  metrics_ = NULL;
 }
 
 uint64_t Nemo::GetProperty(const std::string &property) {
@@ -779,6 +678,68 @@ uint64_t Nemo::GetLockUsage() {
   return result;
 }
 
+uint64_t Nemo::GetMetaCacheUsage() {
+  uint64_t result = 0;
+  rocksdb::NemoMetaCacheStats stats;
+  hash_db_->GetMetaCacheStats(&stats);
+  result += stats.usage;
+  list_db_->GetMetaCacheStats(&stats);
+  result += stats.usage;
+  zset_db_->GetMetaCacheStats(&stats);
+  result += stats.usage;
+  set_db_->GetMetaCacheStats(&stats);
+  result += stats.usage;
+
+  return result;
+}
+
+void Nemo::GetKeyFilterStats(rocksdb::NemoKeyFilterStats *stats) {
+  rocksdb::DBNemo* dbs[] = {kv_db_.get(), hash_db_.get(), list_db_.get(),
+                            zset_db_.get(), set_db_.get()};
+  *stats = rocksdb::NemoKeyFilterStats();
+  stats->ready = true;
+  for (int i = 0; i < 5; i++) {
+    rocksdb::NemoKeyFilterStats db_stats;
+    dbs[i]->GetKeyFilterStats(&db_stats);
+    stats->ready = stats->ready && db_stats.ready;
+    stats->keys += db_stats.keys;
+    stats->capacity += db_stats.capacity;
+    stats->builds += db_stats.builds;
+    stats->usage += db_stats.usage;
+  }
+}
+
+void Nemo::GetRowCacheStats(rocksdb::NemoRowCacheStats *stats) {
+  rocksdb::DBNemo* dbs[] = {kv_db_.get(), hash_db_.get()};
+  *stats = rocksdb::NemoRowCacheStats();
+  for (int i = 0; i < 2; i++) {
+    rocksdb::NemoRowCacheStats db_stats;
+    dbs[i]->GetRowCacheStats(&db_stats);
+    stats->lookups += db_stats.lookups;
+    stats->hits += db_stats.hits;
+    stats->misses += db_stats.misses;
+    stats->evictions += db_stats.evictions;
+    stats->entries += db_stats.entries;
+    stats->usage += db_stats.usage;
+  }
+}
+
+void Nemo::GetWriteGroupStats(WriteGroupStats *stats) {
+  WriteGroup *groups[] = {kv_group_, hash_group_, list_group_, zset_group_, set_group_};
+  *stats = WriteGroupStats();
+  for (int i = 0; i < 5; i++) {
+    if (groups[i] == NULL) {
+      continue;
+    }
+    WriteGroupStats group_stats;
+    groups[i]->GetStats(&group_stats);
+    stats->writes += group_stats.writes;
+    stats->groups += group_stats.groups;
+    stats->bytes += group_stats.bytes;
+    stats->max_group = std::max(stats->max_group, group_stats.max_group);
+  }
+}
+
 Status Nemo::GetUsage(const std::string& type, uint64_t *result) {
   *result = 0;
 
@@ -812,171 +773,199 @@ Status Nemo::GetUsage(const std::string& type, uint64_t *result) {
   }
   if (type == USAGE_TYPE_ALL || type == USAGE_TYPE_NEMO) {
     *result += GetLockUsage(); 
+    *result += GetMetaCacheUsage();
+    rocksdb::NemoKeyFilterStats stats;
+    GetKeyFilterStats(&stats);
+    *result += stats.usage;
+    rocksdb::NemoRowCacheStats row_cache_stats;
+    GetRowCacheStats(&row_cache_stats);
+    *result += row_cache_stats.usage;
   }
 
   return Status::OK();
 }
 
-inline bool lex_less(std::string * s1, std::string * s2)
-{
-  return *s1 < *s2;
-}
+namespace {
 
-Status Nemo::KvRawScanSave(const std::string path,const std::string &start, const std::string &end, bool use_snapshot) {
-    rocksdb::Slice start_slc(start);
-    rocksdb::Slice end_slc(end);
-    rocksdb::Iterator* it = nullptr;
-    rocksdb::ReadOptions read_options;
-    rocksdb::Options opts;
-    rocksdb::SstFileWriter f(rocksdb::EnvOptions(),opts,opts.comparator);
-    mkpath(path.c_str(), 0755);
-    Status s = f.Open(path+"/kv.sst");
-    if(!s.ok()){
-      return s;
-    }
+// The keys of one db saved to path/<name>_<n>.sst, n from 0, a new file
+// once max_file_size bytes of keys and values went to the current one. The
+// keys come in order, so the files are disjoint and ingested in one call.
+class RawScanWriter {
+public:
+    RawScanWriter(const std::string &path, const std::string &name, uint64_t max_file_size)
+        : path_(path), name_(name), max_file_size_(max_file_size), files_(0), size_(0) {}
 
-    if(use_snapshot)
-      read_options.snapshot = kv_db_->GetSnapshot();
-    read_options.fill_cache = false;
-    it = kv_db_->NewIterator(read_options);
-
-    it->Seek(start_slc);
-    if(!it->Valid()){
-      std::string value_with_ver_ts="";
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&value_with_ver_ts,kv_db_->GetEnv(),0,0);
-      f.Add("rubish_to_delete",value_with_ver_ts);
-      f.Finish();
-      return Status::OK();
-    }
-    int count = 0;
-    for(;it->Valid();it->Next(),count++){
-        rocksdb::Slice iKey = it->key();
-        if(!end_slc.empty()){
-          if(iKey.compare(end_slc) >= 0){
-            break;
-          }
+    Status Add(const rocksdb::Slice &key, const rocksdb::Slice &value) {
+        Status s;
+        if (writer_ != nullptr && size_ >= max_file_size_) {
+            s = Finish();
         }
-        s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(it))->raw_value());
-        if(!s.ok()){
-          if(use_snapshot)
-            kv_db_->ReleaseSnapshot(read_options.snapshot);   
-          delete it;
-          return s;
+        if (s.ok() && writer_ == nullptr) {
+            writer_.reset(new rocksdb::SstFileWriter(rocksdb::EnvOptions(), opts_, opts_.comparator));
+            s = writer_->Open(path_ + "/" + name_ + "_" + std::to_string(files_) + ".sst");
+            files_++;
+            size_ = 0;
         }
+        if (s.ok()) {
+            size_ += key.size() + value.size();
+            s = writer_->Add(key, value);
+        }
+        return s;
     }
-    delete it;
-    if(use_snapshot)
-      kv_db_->ReleaseSnapshot(read_options.snapshot);
-    if(count ==0){
-      std::string value_with_ver_ts="";
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&value_with_ver_ts,kv_db_->GetEnv(),0,0);
-      f.Add("rubish_to_delete",value_with_ver_ts);
+
+    Status Finish() {
+        Status s;
+        if (writer_ != nullptr) {
+            s = writer_->Finish();
+            writer_.reset();
+        }
+        return s;
     }
-    s = f.Finish();
-    return s;
+
+private:
+    std::string path_;
+    std::string name_;
+    uint64_t max_file_size_;
+    rocksdb::Options opts_;
+    std::unique_ptr<rocksdb::SstFileWriter> writer_;
+    int files_;
+    uint64_t size_;
+};
+
+// <name>_<n>.sst, or <name>.sst as the saves wrote before they were split
+bool IsRawScanFile(const std::string &file, const std::string &name) {
+    if (file == name + ".sst") {
+        return true;
+    }
+    return file.size() > name.size() + 5 && file.compare(0, name.size() + 1, name + "_") == 0 &&
+        file.compare(file.size() - 4, 4, ".sst") == 0;
 }
 
-Status Nemo::HashRawScanSave(const std::string path,const std::string &start, const std::string &end, bool use_snapshot) {
-    std::string en_start,en_end;
-    rocksdb::Iterator* it = nullptr;
+// One db of a RawScanSave, saved by its own thread
+struct RawScanJob {
+    rocksdb::DBNemo *db;
+    const char *name;
+    const rocksdb::Snapshot *snapshot;
+    KeyRanges ranges;
+    Status status;
+};
+
+// The metas of the range come first, then the data keys of each prefix,
+// which sort after them, range by range: one seek per key length streams
+// the keys in order with no list of them kept.
+void RawScanWorker(RawScanJob *job, const std::string *path, uint64_t max_file_size) {
+    RawScanWriter writer(*path, job->name, max_file_size);
     rocksdb::ReadOptions read_options;
-    rocksdb::Options opts;
-    rocksdb::SstFileWriter f(rocksdb::EnvOptions(),opts,opts.comparator);
-    mkpath(path.c_str(), 0755);
-    Status s = f.Open(path+"/hash.sst");
-    if(!s.ok()){
-      return s;
+    read_options.snapshot = job->snapshot;
+    read_options.fill_cache = false;
+    rocksdb::Iterator *it = job->db->NewIterator(read_options);
+    Status s;
+    for (size_t i = 0; i < job->ranges.size() && s.ok(); i++) {
+        rocksdb::Slice end(job->ranges[i].second);
+        for (it->Seek(job->ranges[i].first); it->Valid() && s.ok(); it->Next()) {
+            if (!end.empty() && it->key().compare(end) >= 0) {
+                break;
+            }
+            s = writer.Add(it->key(), (dynamic_cast<rocksdb::NemoIterator *>(it))->raw_value());
+        }
     }
-    // need some init argment to set the size
-    std::vector<std::string *> * sort_key_set = new std::vector<std::string *>;
-    std::string * sort_key;
-
-    en_start = EncodeHsizeKey(rocksdb::Slice(start.data(),start.size()));
-    if (end.empty()) {
-        en_end = "";
-    } else {
-        en_end = EncodeHsizeKey(rocksdb::Slice(end.data(),end.size()));
+    if (s.ok()) {
+        s = it->status();
     }
-    if(use_snapshot)    
-      read_options.snapshot = hash_db_->GetSnapshot();
-    read_options.fill_cache = false;
-    it = hash_db_->NewIterator(read_options);
+    delete it;
+    if (s.ok()) {
+        s = writer.Finish();
+    }
+    job->status = s;
+}
 
-    it->Seek(en_start);
+}
 
-    if(!it->Valid()){
-      HashMeta meta;
-      std::string meta_val;
-      meta.EncodeTo(meta_val);
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&meta_val,hash_db_->GetEnv(),0,0);
-      f.Add("HRubish_to_delete",meta_val);
-      f.Finish();
-      return Status::OK();
-    }
-    int count = 0;
-    for(;it->Valid();it->Next(),count++){
-        rocksdb::Slice iKey = it->key();
-        if(!end.empty()){
-          if(iKey.compare(en_end)>=0){
-            break;
-          }
-        }         
-        if(iKey[0]!= DataType::kHSize ){
-          break;
+// The dbs of types are saved concurrently, each from its own snapshot
+Status Nemo::RawScanSave(const std::vector<DBType> &types, const std::string &path, const std::string &start, const std::string &end, bool use_snapshot) {
+    mkpath(path.c_str(), 0755);
+    std::vector<std::string> children;
+    kv_db_->GetEnv()->GetChildren(path, &children);
+    std::vector<RawScanJob> jobs(types.size());
+    for (size_t i = 0; i < types.size(); i++) {
+        RawScanJob &job = jobs[i];
+        switch (types[i]) {
+            case DBType::kKV_DB:
+                job.db = kv_db_.get();
+                job.name = "kv";
+                job.ranges.push_back(std::make_pair(start, end));
+                break;
+            case DBType::kHASH_DB:
+                job.db = hash_db_.get();
+                job.name = "hash";
+                MetaKeyRange(DataType::kHSize, start, end, &job.ranges);
+                DataKeyRanges(DataType::kHash, start, end, &job.ranges);
+                break;
+            case DBType::kLIST_DB:
+                job.db = list_db_.get();
+                job.name = "list";
+                MetaKeyRange(DataType::kLMeta, start, end, &job.ranges);
+                DataKeyRanges(DataType::kList, start, end, &job.ranges);
+                break;
+            case DBType::kSET_DB:
+                job.db = set_db_.get();
+                job.name = "set";
+                MetaKeyRange(DataType::kSSize, start, end, &job.ranges);
+                DataKeyRanges(DataType::kSet, start, end, &job.ranges);
+                break;
+            case DBType::kZSET_DB:
+                // rank index keys sort between the metas and the kZScore keys
+                job.db = zset_db_.get();
+                job.name = "zset";
+                MetaKeyRange(DataType::kZSize, start, end, &job.ranges);
+                DataKeyRanges(DataType::kZRank, start, end, &job.ranges);
+                DataKeyRanges(DataType::kZScore, start, end, &job.ranges);
+                DataKeyRanges(DataType::kZSet, start, end, &job.ranges);
+                break;
+            default:
+                return Status::InvalidArgument("no db of type");
         }
-        s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(it))->raw_value());
-        if(!s.ok()){
-          if(use_snapshot)
-            hash_db_->ReleaseSnapshot(read_options.snapshot);   
-          delete it;
-          return s;
+        job.snapshot = use_snapshot ? job.db->GetSnapshot() : NULL;
+
+        // the files of a previous save, which IngestFile would take too
+        for (size_t j = 0; j < children.size(); j++) {
+            if (IsRawScanFile(children[j], job.name)) {
+                kv_db_->GetEnv()->DeleteFile(path + "/" + children[j]);
+            }
         }
-        sort_key = new std::string;
-        sort_key->append(1,DataType::kHash);
-        sort_key->append(1,iKey.size()-1);
-        sort_key->append(iKey.data()+1,iKey.size()-1);
-        sort_key_set->push_back(sort_key);
     }
-    delete it;
-    std::sort(sort_key_set->begin(),sort_key_set->end(),lex_less);
-    for(size_t i = 0;i< sort_key_set->size();i++)
-    {
-        rocksdb::Iterator* sub_it =nullptr;
-        rocksdb::Slice sub_key(*((*sort_key_set)[i]));
-        sub_it = hash_db_->NewIterator(read_options);
-        sub_it->Seek(sub_key);
-        while (sub_it->Valid()) {
-          rocksdb::Slice iKey = sub_it->key();          
-          if (iKey[0] != DataType::kHash) {
-              break;
-          }
-          rocksdb::Slice entry_key(iKey.data(),iKey[1]+2);
-          if(entry_key != sub_key) {
-            break;
-          }
-          s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(sub_it))->raw_value()); 
-          if(!s.ok()){
-            if(use_snapshot)
-              hash_db_->ReleaseSnapshot(read_options.snapshot);
-            delete sub_it;                    
-            return s;
-          }                            
-          sub_it->Next();
+
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < jobs.size(); i++) {
+        workers.push_back(std::thread(RawScanWorker, &jobs[i], &path, raw_scan_file_size_));
+    }
+    if (!jobs.empty()) {
+        RawScanWorker(&jobs[0], &path, raw_scan_file_size_);
+    }
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    Status s;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        if (jobs[i].snapshot != NULL) {
+            jobs[i].db->ReleaseSnapshot(jobs[i].snapshot);
+        }
+        if (s.ok()) {
+            s = jobs[i].status;
         }
-        delete sub_it;
-        delete (*sort_key_set)[i];
     }
-    if(use_snapshot)
-      hash_db_->ReleaseSnapshot(read_options.snapshot);
-    delete sort_key_set;
-    if(count ==0){
-      std::string value_with_ver_ts="";
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&value_with_ver_ts,kv_db_->GetEnv(),0,0);
-      f.Add("rubish_to_delete",value_with_ver_ts);
-    }    
-    s = f.Finish();
     return s;
 }
+
+Status Nemo::KvRawScanSave(const std::string path,const std::string &start, const std::string &end, bool use_snapshot) {
+    return RawScanSave({DBType::kKV_DB}, path, start, end, use_snapshot);
+}
+
+Status Nemo::HashRawScanSave(const std::string path,const std::string &start, const std::string &end, bool use_snapshot) {
+    return RawScanSave({DBType::kHASH_DB}, path, start, end, use_snapshot);
+}
+
 /*
 void Nemo::HashRawScan(const std::string &start, const std::string &end, bool use_snapshot) {
     std::string en_start,en_end;
@@ -1063,345 +1052,15 @@ void Nemo::HashRawScan(const std::string &start, const std::string &end, bool us
 }
 */
 Status Nemo::ListRawScanSave(const std::string path,const std::string &start, const std::string &end, bool use_snapshot) {
-    std::string en_start,en_end;
-    rocksdb::Iterator* it = nullptr;
-    rocksdb::ReadOptions read_options;
-    rocksdb::Options opts;
-    rocksdb::SstFileWriter f(rocksdb::EnvOptions(),opts,opts.comparator);
-    mkpath(path.c_str(), 0755);
-    Status s = f.Open(path+"/list.sst");
-    if(!s.ok()){
-      return s;
-    }
-    // need some init argment to set the size
-    std::vector<std::string *> * sort_key_set = new std::vector<std::string *>;
-    std::string * sort_key;
-
-    en_start = EncodeLMetaKey(rocksdb::Slice(start.data(),start.size()));
-    if (end.empty()) {
-        en_end = "";
-    } else {
-        en_end = EncodeLMetaKey(rocksdb::Slice(end.data(),end.size()));
-    }
-    if(use_snapshot)    
-      read_options.snapshot = list_db_->GetSnapshot();
-    read_options.fill_cache = false;
-    it = list_db_->NewIterator(read_options);
-    it->Seek(en_start);
-
-    if(!it->Valid()){
-      ListMeta meta;
-      std::string meta_val;
-      meta.EncodeTo(meta_val);
-
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&meta_val,list_db_->GetEnv(),0,0);
-      f.Add("LRubish_to_delete",meta_val);
-      f.Finish();
-      return Status::OK();
-    }
-    int count = 0;
-    for(;it->Valid();it->Next(),count++){
-        rocksdb::Slice iKey = it->key();
-        if(!end.empty()){
-          if(iKey.compare(en_end) >=0){
-            break;
-          }
-        }         
-        if(iKey[0]!= DataType::kLMeta ){
-          break;
-        }
-        s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(it))->raw_value());
-        if(!s.ok()){
-          if(use_snapshot)          
-            list_db_->ReleaseSnapshot(read_options.snapshot);   
-          delete it;
-          return s;
-        }
-        sort_key = new std::string;
-        sort_key->append(1,DataType::kList);
-        sort_key->append(1,iKey.size()-1);
-        sort_key->append(iKey.data()+1,iKey.size()-1);
-        sort_key_set->push_back(sort_key);
-    }
-    delete it;
-    std::sort(sort_key_set->begin(),sort_key_set->end(),lex_less);
-    for(size_t i = 0;i< sort_key_set->size();i++)
-    {
-        rocksdb::Iterator* sub_it =nullptr;
-        rocksdb::Slice sub_key(*((*sort_key_set)[i]));
-        sub_it = list_db_->NewIterator(read_options);
-        sub_it->Seek(sub_key);
-        while (sub_it->Valid()) {
-          rocksdb::Slice iKey = sub_it->key();
-          if (iKey[0] != DataType::kList) {
-              break;
-          }
-          rocksdb::Slice entry_key(iKey.data(),iKey[1]+2);
-          if(sub_key != entry_key) {
-            break;
-          }
-          s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(sub_it))->raw_value()); 
-          if(!s.ok()){
-            if(use_snapshot)
-              list_db_->ReleaseSnapshot(read_options.snapshot);
-            delete sub_it;                    
-            return s;
-          }                            
-          sub_it->Next();
-        }
-        delete sub_it;
-        delete (*sort_key_set)[i];
-    }
-    if(use_snapshot)
-      list_db_->ReleaseSnapshot(read_options.snapshot);
-    delete sort_key_set;
-    if(count ==0){
-      std::string value_with_ver_ts="";
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&value_with_ver_ts,kv_db_->GetEnv(),0,0);
-      f.Add("rubish_to_delete",value_with_ver_ts);
-    }
-    s = f.Finish();
-    return s;
+    return RawScanSave({DBType::kLIST_DB}, path, start, end, use_snapshot);
 }
 
 Status Nemo::SetRawScanSave(const std::string path,const std::string &start, const std::string &end, bool use_snapshot) {
-    std::string en_start,en_end;
-    rocksdb::Iterator* it = nullptr;
-    rocksdb::ReadOptions read_options;
-    rocksdb::Options opts;
-    rocksdb::SstFileWriter f(rocksdb::EnvOptions(),opts,opts.comparator);
-    mkpath(path.c_str(), 0755);
-    Status s = f.Open(path+"/set.sst");
-    if(!s.ok()){
-      return s;
-    }
-    // need some init argment to set the size
-    std::vector<std::string *> * sort_key_set = new std::vector<std::string *>;
-    std::string * sort_key;
-
-    en_start = EncodeSSizeKey(rocksdb::Slice(start.data(),start.size()));
-    if (end.empty()) {
-        en_end = "";
-    } else {
-        en_end = EncodeSSizeKey(rocksdb::Slice(end.data(),end.size()));
-    }
-    if(use_snapshot)
-      read_options.snapshot = set_db_->GetSnapshot();
-    read_options.fill_cache = false;
-    it = set_db_->NewIterator(read_options);
-
-    it->Seek(en_start);
-
-    if(!it->Valid()){
-      SetMeta meta;
-      std::string meta_val;
-      meta.EncodeTo(meta_val);
-
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&meta_val,set_db_->GetEnv(),0,0);
-      f.Add("SRubish_to_delete",meta_val);
-      f.Finish();
-      return Status::OK();
-    }
-    int count = 0;
-    for(;it->Valid();it->Next(),count++){
-        rocksdb::Slice iKey = it->key();
-        if(!end.empty()){
-          if(iKey.compare(en_end) >=0 ){
-            break;
-          }
-        }         
-        if(iKey[0]!= DataType::kSSize ){
-          break;
-        }
-        s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(it))->raw_value());
-        if(!s.ok()){
-          if(use_snapshot)          
-            set_db_->ReleaseSnapshot(read_options.snapshot);   
-          delete it;
-          return s;
-        }
-        sort_key = new std::string;
-        sort_key->append(1,DataType::kSet);
-        sort_key->append(1,iKey.size()-1);
-        sort_key->append(iKey.data()+1,iKey.size()-1);
-        sort_key_set->push_back(sort_key);
-    }
-    delete it;
-    std::sort(sort_key_set->begin(),sort_key_set->end(),lex_less);
-    for(size_t i = 0;i< sort_key_set->size();i++)
-    {
-        rocksdb::Iterator* sub_it =nullptr; 
-        rocksdb::Slice sub_key(*((*sort_key_set)[i]));
-        sub_it = set_db_->NewIterator(read_options);
-        sub_it->Seek(sub_key);
-        while (sub_it->Valid()) {
-          rocksdb::Slice iKey = sub_it->key();
-          if (iKey[0] != DataType::kSet) {
-              break;
-          }
-          rocksdb::Slice entry_key(iKey.data(),iKey[1]+2);
-          if(sub_key != entry_key) {
-            break;
-          }
-          s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(sub_it))->raw_value()); 
-          if(!s.ok()){
-            if(use_snapshot)            
-              set_db_->ReleaseSnapshot(read_options.snapshot);
-            delete sub_it;                    
-            return s;
-          }                            
-          sub_it->Next();
-        }
-        delete sub_it;
-        delete (*sort_key_set)[i];
-    }
-    if(use_snapshot)
-      set_db_->ReleaseSnapshot(read_options.snapshot);
-    delete sort_key_set;
-    if(count ==0){
-      std::string value_with_ver_ts="";
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&value_with_ver_ts,kv_db_->GetEnv(),0,0);
-      f.Add("rubish_to_delete",value_with_ver_ts);
-    }    
-    s = f.Finish();
-    return s;
+    return RawScanSave({DBType::kSET_DB}, path, start, end, use_snapshot);
 }
 
 Status Nemo::ZsetRawScanSave(const std::string path,const std::string &start, const std::string &end, bool use_snapshot) {
-    std::string en_start,en_end;
-    rocksdb::Iterator* it = nullptr;
-    rocksdb::ReadOptions read_options;
-    rocksdb::Options opts;
-    rocksdb::SstFileWriter f(rocksdb::EnvOptions(),opts,opts.comparator);
-    mkpath(path.c_str(), 0755);
-    Status s = f.Open(path+"/zset.sst");
-    if(!s.ok()){
-      return s;
-    }
-    // need some init argment to set the size
-    std::vector<std::string *> * sort_key_set = new std::vector<std::string *>;
-    std::string * sort_key;
-
-    en_start = EncodeZSizeKey(rocksdb::Slice(start.data(),start.size()));
-    if (end.empty()) {
-        en_end = "";
-    } else {
-        en_end = EncodeZSizeKey(rocksdb::Slice(end.data(),end.size()));
-    }
-    if(use_snapshot)    
-      read_options.snapshot = zset_db_->GetSnapshot();
-    read_options.fill_cache = false;
-    it = zset_db_->NewIterator(read_options);
-    it->Seek(en_start);
-
-    if(!it->Valid()){
-      ZSetMeta meta;
-      std::string meta_val;
-      meta.EncodeTo(meta_val);
-
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&meta_val,zset_db_->GetEnv(),0,0);
-      f.Add("SRubish_to_delete",meta_val);
-      f.Finish();
-      return Status::OK();
-    }
-    int count = 0;
-    for(;it->Valid();it->Next(),count++){
-        rocksdb::Slice iKey = it->key();
-        if(!en_end.empty()){
-          if(iKey.compare(en_end) >= 0 ){
-            break;
-          }
-        }         
-        if(iKey[0]!= DataType::kZSize ){
-          break;
-        }
-        s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(it))->raw_value());
-        if(!s.ok()){
-          if(use_snapshot)          
-            zset_db_->ReleaseSnapshot(read_options.snapshot);   
-          delete it;
-          return s;
-        }
-        sort_key = new std::string;
-        sort_key->append(1,it->key().size()-1);
-        sort_key->append(it->key().data()+1,it->key().size()-1);
-        sort_key_set->push_back(sort_key);
-    }
-    delete it;
-    std::sort(sort_key_set->begin(),sort_key_set->end(),lex_less);
-    for(size_t i = 0;i< sort_key_set->size();i++)
-    {
-        rocksdb::Iterator* sub_it =nullptr; 
-        rocksdb::Slice sub_key(*((*sort_key_set)[i]));
-        std::string sub_key_str;
-        sub_key_str.append(1,DataType::kZScore);
-        sub_key_str.append(sub_key.data(),sub_key.size());
-        rocksdb::Slice sub_key_p(sub_key_str);
-        sub_it = zset_db_->NewIterator(read_options);
-        sub_it->Seek(sub_key_p);
-        while (sub_it->Valid()) {
-          rocksdb::Slice iKey = sub_it->key();
-          if (iKey[0] != DataType::kZScore) {
-              break;
-          }
-          rocksdb::Slice entry_key(iKey.data(),iKey[1]+2);
-          if(sub_key_p != entry_key) {
-            break;
-          }
-          s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(sub_it))->raw_value());
-          if(!s.ok()){
-            if(use_snapshot)
-              zset_db_->ReleaseSnapshot(read_options.snapshot);
-            delete sub_it;
-            return s;
-          }                            
-          sub_it->Next();
-        }
-        delete sub_it;
-    }
-
-    for(size_t i = 0;i< sort_key_set->size();i++)
-    {
-        rocksdb::Iterator* sub_it =nullptr;
-        rocksdb::Slice sub_key(*((*sort_key_set)[i]));
-        std::string sub_key_str;
-        sub_key_str.append(1,DataType::kZSet);
-        sub_key_str.append(sub_key.data(),sub_key.size());
-        rocksdb::Slice sub_key_p(sub_key_str);        
-        sub_it = zset_db_->NewIterator(read_options);
-        sub_it->Seek(sub_key_p);
-        while (sub_it->Valid()) {
-          rocksdb::Slice iKey = sub_it->key();          
-          if (iKey[0] != DataType::kZSet) {
-              break;
-          }
-          rocksdb::Slice entry_key(iKey.data(),iKey[1]+2);
-          if(entry_key != sub_key_p) {
-            break;
-          }
-          s = f.Add(iKey,(dynamic_cast<rocksdb::NemoIterator *>(sub_it))->raw_value()); 
-          if(!s.ok()){
-            if(use_snapshot)
-              zset_db_->ReleaseSnapshot(read_options.snapshot);
-            delete sub_it;                    
-            return s;
-          }                            
-          sub_it->Next();
-        }
-        delete sub_it;
-        delete (*sort_key_set)[i];
-    }
-
-    if(use_snapshot)
-      zset_db_->ReleaseSnapshot(read_options.snapshot);
-    delete sort_key_set;
-    if(count ==0){
-      std::string value_with_ver_ts="";
-      rocksdb::DBNemoImpl::AppendVersionAndTS("",&value_with_ver_ts,kv_db_->GetEnv(),0,0);
-      f.Add("rubish_to_delete",value_with_ver_ts);
-    }    
-    s = f.Finish();
-    return s;
+    return RawScanSave({DBType::kZSET_DB}, path, start, end, use_snapshot);
 }
 /*
 void Nemo::ZsetRawScan(const std::string path,const std::string &start, const std::string &end, bool use_snapshot) {
@@ -1508,57 +1167,43 @@ void Nemo::ZsetRawScan(const std::string path,const std::string &start, const st
 */
 Status Nemo::RawScanSaveAll(const std::string path,const std::string &start, const std::string &end, bool use_snapshot)
 {
-  Status s;
-  s = KvRawScanSave(path,start,end,use_snapshot); 
-  if(!s.ok())
-  {
-    return s;
-  } 
-  s = HashRawScanSave(path,start,end,use_snapshot);
-  if(!s.ok())
-  {
-    return s;
-  }   
-  s = ListRawScanSave(path,start,end,use_snapshot);
-  if(!s.ok())
-  {
-    return s;
-  }   
-  s = SetRawScanSave(path,start,end,use_snapshot);
-  if(!s.ok())
-  {
-    return s;
-  } 
-  s = ZsetRawScanSave(path,start,end,use_snapshot);
-  if(!s.ok())
-  {
-    return s;
-  } 
-  return Status::OK();
+  return RawScanSave({DBType::kKV_DB, DBType::kHASH_DB, DBType::kLIST_DB, DBType::kSET_DB, DBType::kZSET_DB},
+                     path, start, end, use_snapshot);
 }
 
+// Each db takes all its files in one IngestExternalFile, which moves them
+// into the db instead of copying them
 Status Nemo::IngestFile(const std::string path)
 {
-  Status s ;
-  s = kv_db_->IngestExternalFile({path+"/kv.sst"},rocksdb::IngestExternalFileOptions());
-  if(!s.ok())
-    return s;
-
-  s = hash_db_->IngestExternalFile({path+"/hash.sst"},rocksdb::IngestExternalFileOptions());
-  if(!s.ok())
+  std::vector<std::string> children;
+  Status s = kv_db_->GetEnv()->GetChildren(path, &children);
+  if (!s.ok())
     return s;
 
-  s = list_db_->IngestExternalFile({path+"/list.sst"},rocksdb::IngestExternalFileOptions());
-  if(!s.ok())
-    return s;
-
-  s = set_db_->IngestExternalFile({path+"/set.sst"},rocksdb::IngestExternalFileOptions());
-  if(!s.ok())
-    return s;
-
-  s = zset_db_->IngestExternalFile({path+"/zset.sst"},rocksdb::IngestExternalFileOptions());
-  if(!s.ok())
-    return s;  
-
+  struct {
+    rocksdb::DBNemo *db;
+    std::string name;
+  } dbs[] = {
+    {kv_db_.get(), "kv"},
+    {hash_db_.get(), "hash"},
+    {list_db_.get(), "list"},
+    {set_db_.get(), "set"},
+    {zset_db_.get(), "zset"},
+  };
+  rocksdb::IngestExternalFileOptions ingest_options;
+  ingest_options.move_files = true;
+  for (size_t i = 0; i < sizeof(dbs) / sizeof(dbs[0]); i++) {
+    std::vector<std::string> files;
+    for (size_t j = 0; j < children.size(); j++) {
+      if (IsRawScanFile(children[j], dbs[i].name)) {
+        files.push_back(path + "/" + children[j]);
+      }
+    }
+    if (files.empty())
+      continue;
+    s = dbs[i].db->IngestExternalFile(files, ingest_options);
+    if (!s.ok())
+      return s;
+  }
   return Status::OK();
 }
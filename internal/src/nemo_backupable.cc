@@ -36,11 +36,21 @@ Status BackupEngine::Open(nemo::Nemo *db,
   if (!*backup_engine_ptr){
     return Status::Corruption("New BackupEngine failed!");
   }
+  (*backup_engine_ptr)->write_fence_ = db->GetWriteFence();
+
+  // One checkpoint holds all the column families
+  if (db->IsColumnFamilyLayout()) {
+    rocksdb::Status s = (*backup_engine_ptr)->NewCheckpoint(db->GetDBByType(KV_DB), CF_LAYOUT_DB);
+    if (!s.ok()) {
+      delete *backup_engine_ptr;
+    }
+    return s;
+  }
 
   // Create BackupEngine for each db type
   rocksdb::Status s;
   rocksdb::DBNemo *tdb;
-  std::string types[] = {KV_DB, HASH_DB, LIST_DB, SET_DB, ZSET_DB};
+  std::string types[] = {KV_DB, HASH_DB, LIST_DB, SET_DB, ZSET_DB, META_DB, RAFT_DB, EXPIRE_DB};
   for (auto& type : types) {
     if ((tdb = db->GetDBByType(type)) == NULL) {
       s = Status::Corruption("Error db type");
@@ -58,20 +68,30 @@ Status BackupEngine::Open(nemo::Nemo *db,
   return s;
 }
 
+// The files of all the dbs are taken with the write fence closed, the WAL
+// files without a flush unless the writes skip the WAL
 Status BackupEngine::SetBackupContent() {
   Status s;
+  bool flush_memtable = w_opts_nolog().disableWAL;
+  if (write_fence_ != NULL) {
+    write_fence_->Close();
+  }
   for (auto& engine : engines_) {
     //Get backup content
     BackupContent bcontent;
     s = engine.second->GetCheckpointFiles(bcontent.live_files,
         bcontent.live_wal_files,
-        bcontent.manifest_file_size, bcontent.sequence_number);
+        bcontent.manifest_file_size, bcontent.sequence_number,
+        flush_memtable);
     if (!s.ok()) {
       log_warn("get backup files faild for type: %s", engine.first.c_str());
-      return s;
+      break;
     }
     backup_content_[engine.first] = std::move(bcontent);
   }
+  if (write_fence_ != NULL) {
+    write_fence_->Open();
+  }
   return s;
 }
 
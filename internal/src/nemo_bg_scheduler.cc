@@ -0,0 +1,292 @@
+#include <sys/time.h>
+#include <algorithm>
+
+#include "nemo_bg_scheduler.h"
+#include "util.h"
+
+namespace nemo {
+
+static uint64_t NowMicros() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// true if a range ending at end is before one beginning at begin, an empty
+// end being no end
+static bool EndsBefore(const std::string &end, const std::string &begin) {
+    return !end.empty() && end < begin;
+}
+
+static void BGWorker(BGScheduler *scheduler, int lane) {
+    scheduler->Work(lane);
+}
+
+BGScheduler::BGScheduler(Nemo *nemo, int threads_per_type, size_t capacity)
+    : nemo_(nemo),
+    threads_per_type_(threads_per_type > 0 ? threads_per_type : 1),
+    capacity_(capacity > 0 ? capacity : 1),
+    work_cv_(&mu_),
+    room_cv_(&mu_),
+    stopping_(false),
+    working_(0),
+    pending_(0),
+    running_(0),
+    added_(0),
+    executed_(0),
+    merged_(0),
+    dropped_(0),
+    waits_(0) {
+    for (int i = 0; i < kLanes; i++) {
+        lanes_[i].type = static_cast<DBType>(kKV_DB + i);
+    }
+}
+
+BGScheduler::~BGScheduler() {
+    Stop();
+}
+
+Status BGScheduler::Start() {
+    for (int i = 0; i < kLanes; i++) {
+        for (int t = 0; t < threads_per_type_; t++) {
+            workers_.push_back(std::thread(&BGWorker, this, i));
+        }
+    }
+    return Status::OK();
+}
+
+void BGScheduler::Stop() {
+    mu_.Lock();
+    stopping_ = true;
+    dropped_ += pending_;
+    pending_ = 0;
+    for (int i = 0; i < kLanes; i++) {
+        lanes_[i].ranges.clear();
+        lanes_[i].all = false;
+    }
+    work_cv_.SignalAll();
+    room_cv_.SignalAll();
+    mu_.Unlock();
+
+    for (size_t i = 0; i < workers_.size(); i++) {
+        if (workers_[i].joinable()) {
+            workers_[i].join();
+        }
+    }
+    workers_.clear();
+
+    // and the threads of RunBGTask, which are not ours to join
+    mu_.Lock();
+    while (working_ > 0) {
+        work_cv_.Wait();
+    }
+    mu_.Unlock();
+}
+
+void BGScheduler::Add(const BGTask &task) {
+    std::vector<Lane *> lanes;
+    for (int i = 0; i < kLanes; i++) {
+        if (task.type == kALL || task.type == lanes_[i].type) {
+            lanes.push_back(&lanes_[i]);
+        }
+    }
+
+    for (size_t i = 0; i < lanes.size(); i++) {
+        Lane *lane = lanes[i];
+        if (task.op == kCLEAN_ALL) {
+            mu_.Lock();
+            added_++;
+            if (stopping_) {
+                dropped_++;
+            } else if (lane->all) {
+                merged_++;
+            } else {
+                lane->all = true;
+                lane->all_since = NowMicros();
+                pending_++;
+            }
+            merged_ += lane->ranges.size();
+            pending_ -= lane->ranges.size();
+            lane->ranges.clear();
+            work_cv_.SignalAll();
+            room_cv_.SignalAll();
+            mu_.Unlock();
+        } else if (task.op == kDEL_KEY) {
+            KeyRanges ranges;
+            nemo_->KeyCompactRanges(lane->type, task.argv1, &ranges);
+            for (size_t j = 0; j < ranges.size(); j++) {
+                AddRange(lane, ranges[j].first, ranges[j].second, kDEL_KEY);
+            }
+        } else if (task.op == kCLEAN_RANGE) {
+            AddRange(lane, task.argv1, task.argv2, kCLEAN_RANGE);
+        }
+    }
+}
+
+void BGScheduler::AddRange(Lane *lane, const std::string &begin, const std::string &end, OPERATION op) {
+    uint64_t now = NowMicros();
+    bool waited = false;
+    mu_.Lock();
+    added_++;
+    while (true) {
+        if (lane->all) {
+            merged_++;
+            break;
+        }
+        if (Merge(lane, begin, end, op, now)) {
+            break;
+        }
+        if (stopping_) {
+            dropped_++;
+            break;
+        }
+        if (pending_ < capacity_) {
+            Range range;
+            range.end = end;
+            range.op = op;
+            range.since = now;
+            lane->ranges[begin] = range;
+            pending_++;
+            work_cv_.SignalAll();
+            break;
+        }
+        if (!waited) {
+            waits_++;
+            waited = true;
+        }
+        room_cv_.Wait();
+    }
+    mu_.Unlock();
+}
+
+// The ranges overlapping or touching [begin, end) are erased and merged
+// with it into one
+bool BGScheduler::Merge(Lane *lane, std::string begin, std::string end, OPERATION op, uint64_t now) {
+    std::map<std::string, Range> &ranges = lane->ranges;
+    std::map<std::string, Range>::iterator it = ranges.upper_bound(begin);
+    if (it != ranges.begin()) {
+        std::map<std::string, Range>::iterator prev = it;
+        --prev;
+        if (!EndsBefore(prev->second.end, begin)) {
+            it = prev;
+        }
+    }
+
+    bool merged = false;
+    uint64_t since = now;
+    while (it != ranges.end() && !EndsBefore(end, it->first)) {
+        begin = std::min(begin, it->first);
+        if (end.empty() || it->second.end.empty()) {
+            end.clear();
+        } else {
+            end = std::max(end, it->second.end);
+        }
+        since = std::min(since, it->second.since);
+        if (it->second.op != op) {
+            op = kCLEAN_RANGE;
+        }
+        it = ranges.erase(it);
+        pending_--;
+        merged_++;
+        merged = true;
+    }
+    if (merged) {
+        Range range;
+        range.end = end;
+        range.op = op;
+        range.since = since;
+        ranges[begin] = range;
+        pending_++;
+    }
+    return merged;
+}
+
+bool BGScheduler::PickFrom(Lane *lane, bool high, Job *job) {
+    if (high && !lane->ranges.empty()) {
+        std::map<std::string, Range>::iterator it = lane->ranges.begin();
+        job->type = lane->type;
+        job->op = it->second.op;
+        job->begin = it->first;
+        job->end = it->second.end;
+        lane->ranges.erase(it);
+    } else if (!high && lane->all) {
+        job->type = lane->type;
+        job->op = kCLEAN_ALL;
+        lane->all = false;
+    } else {
+        return false;
+    }
+    pending_--;
+    room_cv_.SignalAll();
+    return true;
+}
+
+bool BGScheduler::Pick(int lane, Job *job) {
+    if (lane >= 0) {
+        return PickFrom(&lanes_[lane], true, job) || PickFrom(&lanes_[lane], false, job);
+    }
+    for (int i = 0; i < kLanes; i++) {
+        if (PickFrom(&lanes_[i], true, job)) {
+            return true;
+        }
+    }
+    for (int i = 0; i < kLanes; i++) {
+        if (PickFrom(&lanes_[i], false, job)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void BGScheduler::Work(int lane) {
+    mu_.Lock();
+    working_++;
+    while (!stopping_) {
+        Job job;
+        if (!Pick(lane, &job)) {
+            work_cv_.Wait();
+            continue;
+        }
+        running_++;
+        mu_.Unlock();
+
+        if (job.op == kCLEAN_ALL) {
+            nemo_->DoCompact(job.type);
+        } else {
+            nemo_->CompactRange(job.type, job.begin, job.end, job.op);
+        }
+
+        mu_.Lock();
+        running_--;
+        executed_++;
+    }
+    working_--;
+    work_cv_.SignalAll();
+    mu_.Unlock();
+}
+
+void BGScheduler::GetStats(BGTaskStats *stats) {
+    uint64_t now = NowMicros();
+    mu_.Lock();
+    uint64_t oldest = now;
+    for (int i = 0; i < kLanes; i++) {
+        std::map<std::string, Range>::const_iterator it = lanes_[i].ranges.begin();
+        for (; it != lanes_[i].ranges.end(); ++it) {
+            oldest = std::min(oldest, it->second.since);
+        }
+        if (lanes_[i].all) {
+            oldest = std::min(oldest, lanes_[i].all_since);
+        }
+    }
+    stats->pending = pending_;
+    stats->running = running_;
+    stats->oldest_age = now - oldest;
+    stats->added = added_;
+    stats->executed = executed_;
+    stats->merged = merged_;
+    stats->dropped = dropped_;
+    stats->waits = waits_;
+    mu_.Unlock();
+}
+
+}
@@ -0,0 +1,102 @@
+#ifndef NEMO_INCLUDE_NEMO_BG_SCHEDULER_H_
+#define NEMO_INCLUDE_NEMO_BG_SCHEDULER_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nemo.h"
+#include "nemo_const.h"
+#include "port.h"
+
+namespace nemo {
+
+// The background compactions of the BGTasks, one lane per type db, each run
+// by its own workers. A lane keeps the raw key ranges to compact, disjoint
+// and sorted, and whether a compaction of the whole db is due:
+//
+//   - kDEL_KEY is turned into the ranges of the data keys of the key and
+//     kCLEAN_RANGE is one range, a range overlapping or touching pending ones
+//     is merged with them into one, so a key deleted many times, or the keys
+//     of a range, are compacted once
+//   - kCLEAN_ALL takes the pending ranges of its lane, as it covers them,
+//     and so do the tasks added to the lane until it runs
+//
+// The ranges are the high priority class and are run first, in key order,
+// the compaction of the whole db is the low one. Adds that would queue a new
+// range past capacity wait for a worker to take one instead of dropping it,
+// only the ones still waiting when the scheduler stops are dropped.
+class BGScheduler {
+public:
+    BGScheduler(Nemo *nemo, int threads_per_type, size_t capacity);
+    ~BGScheduler();
+
+    Status Start();
+    // Stops the workers once their running tasks are done, the pending
+    // ones are dropped
+    void Stop();
+
+    void Add(const BGTask &task);
+    // Runs the tasks of lane, or of all lanes for -1, until Stop
+    void Work(int lane);
+    void GetStats(BGTaskStats *stats);
+
+private:
+    static const int kLanes = 5;
+
+    struct Range {
+        std::string end;    // empty for no end
+        OPERATION op;
+        uint64_t since;     // add of the oldest task merged into it
+    };
+    struct Lane {
+        DBType type;
+        std::map<std::string, Range> ranges;
+        bool all;
+        uint64_t all_since;
+        Lane() : type(kNONE_DB), all(false), all_since(0) {}
+    };
+    struct Job {
+        DBType type;
+        OPERATION op;
+        std::string begin;
+        std::string end;
+    };
+
+    // Merges [begin, end) into the pending ranges of lane, false if it
+    // overlaps none of them and needs room of its own
+    bool Merge(Lane *lane, std::string begin, std::string end, OPERATION op, uint64_t now);
+    void AddRange(Lane *lane, const std::string &begin, const std::string &end, OPERATION op);
+    bool Pick(int lane, Job *job);
+    bool PickFrom(Lane *lane, bool high, Job *job);
+
+    Nemo *nemo_;
+    int threads_per_type_;
+    size_t capacity_;
+    std::vector<std::thread> workers_;
+
+    port::Mutex mu_;
+    port::CondVar work_cv_;
+    port::CondVar room_cv_;
+    Lane lanes_[kLanes];
+    bool stopping_;
+    // Threads in Work
+    int working_;
+    // Ranges and compactions of whole dbs pending
+    size_t pending_;
+    uint64_t running_;
+    uint64_t added_;
+    uint64_t executed_;
+    uint64_t merged_;
+    uint64_t dropped_;
+    uint64_t waits_;
+
+    //No Copying Allowed
+    BGScheduler(const BGScheduler&);
+    void operator=(const BGScheduler&);
+};
+
+}
+#endif
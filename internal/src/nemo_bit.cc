@@ -1,10 +1,13 @@
 #include <ctime>
 #include <climits>
+#include <cstring>
 #include <list>
 #include <climits>
 
 #include "nemo.h"
+#include "nemo_bit_kernel.h"
 #include "nemo_mutex.h"
+#include "nemo_write_group.h"
 #include "nemo_iterator.h"
 #include "util.h"
 #include "xdebug.h"
@@ -12,6 +15,8 @@
 using namespace nemo;
 
 Status Nemo::BitSet(const std::string &key, const std::int64_t offset, const int64_t on, int64_t* res) {
+    RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     std::string value;
     Status s = kv_db_->Get(rocksdb::ReadOptions(), key, &value);
     if (s.ok() || s.IsNotFound()) {
@@ -69,15 +74,6 @@ Status Nemo::BitGet(const std::string &key, const std::int64_t offset, std::int6
     return Status::OK();
 }
 
-int GetBitCount(const unsigned char* value,int64_t bytes){
-  int bit_num = 0;
-  static const unsigned char bitsinbyte[256] = {0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,1,2,2,3,2,3,3,4,2,3,3,4,3,4,4,5,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,2,3,3,4,3,4,4,5,3,4,4,5,4,5,5,6,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,3,4,4,5,4,5,5,6,4,5,5,6,5,6,6,7,4,5,5,6,5,6,6,7,5,6,6,7,6,7,7,8};
-  for (int i = 0; i < bytes; i++) {
-    bit_num += bitsinbyte[(unsigned int)value[i]];
-  }
-  return bit_num;
-}
-
 Status Nemo::BitCount(const std::string &key, std::int64_t* res) {
     std::string value_str;
     Status s = kv_db_->Get(rocksdb::ReadOptions(), key, &value_str);
@@ -86,7 +82,7 @@ Status Nemo::BitCount(const std::string &key, std::int64_t* res) {
         int64_t value_length = value_str.length();
         int64_t start_offset = 0;
         int64_t end_offset = std::max(value_length - 1, (int64_t)0);
-        *res = GetBitCount(value + start_offset, end_offset - start_offset + 1);
+        *res = GetBitKernel().count(value + start_offset, end_offset - start_offset + 1);
     } else if (s.IsNotFound()) {
         *res = 0;
     } else {
@@ -101,7 +97,7 @@ Status Nemo::BitCount(const std::string &key, std::int64_t start_offset, std::in
     Status s = kv_db_->Get(rocksdb::ReadOptions(), key, &value_str);
     if (s.ok()) {
         const unsigned char * value = (const unsigned char *) (value_str.data());
-        int value_length = value_str.length();
+        int64_t value_length = value_str.length();
         if (start_offset < 0) {
             start_offset = start_offset + value_length;
         }
@@ -123,7 +119,7 @@ Status Nemo::BitCount(const std::string &key, std::int64_t start_offset, std::in
             *res = 0;
             return Status::OK();
         }
-        *res = GetBitCount(value + start_offset, end_offset - start_offset + 1);
+        *res = GetBitKernel().count(value + start_offset, end_offset - start_offset + 1);
     } else if (s.IsNotFound()) {
         *res = 0;
     } else {
@@ -137,50 +133,14 @@ Status Nemo::BitCount(const std::string &key, std::int64_t start_offset, std::in
 // When can't find bit val from s[0] to s[bytes-1]:
 //  return 8*bytes if bit = 0
 //  return -1 if bit = 1
-int GetBitPos(const unsigned char *s, unsigned int bytes, int bit) {
-    uint64_t word = 0;
-    uint64_t skip_val = 0;
-    uint64_t * l = (uint64_t *) s;
-    int pos = 0;
-    if (bit == 0) {
-      skip_val = std::numeric_limits<uint64_t>::max();
-    } else {
-      skip_val = 0;
-    }
-    // skip 8 bytes at one time, find the first int64 that should not be skipped
-    while (bytes >= sizeof(*l)) {
-      if (*l != skip_val) {
-        break;
-      }
-      l++;
-      bytes = bytes - sizeof(*l);
-      pos = pos + 8 * sizeof(*l);
+int64_t GetBitPos(const unsigned char *s, int64_t bytes, int bit) {
+    int64_t i = GetBitKernel().find(s, bytes, bit ? 0 : 0xff);
+    if (i == bytes) {
+      return bit ? -1 : 8 * bytes;
     }
-    unsigned char * c = (unsigned char *) l;
-    for (unsigned int j = 0; j < sizeof(*l); j++) {
-      word = word << 8;
-      if (bytes) {
-        word = word | *c;
-        c++;
-        bytes --;
-      }
-    }
-    if (bit == 1 && word == 0) {
-      return -1;
-    }
-    // set each bit of mask to 0 except msb
-    uint64_t mask = std::numeric_limits<uint64_t>::max();
-    mask = mask >> 1;
-    mask = ~(mask);
-    while (mask) {
-      if (((word & mask) != 0) == bit) {
-        return pos;
-      }
-      pos++;
-      mask = mask >> 1;
-    }
-    return pos;
-
+    unsigned int byte = bit ? s[i] : (unsigned char)~s[i];
+    // the bits of a byte count from its msb
+    return 8 * i + __builtin_clz(byte) - 24;
 }
 
 // [bitpos key 1 ] returns -1 if there is no 1 in the value we found
@@ -191,11 +151,11 @@ Status Nemo::BitPos(const std::string &key, const int64_t bit_val, std::int64_t*
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &value_str);
     if (s.ok()) {
         const unsigned char * value = (const unsigned char *) (value_str.data());
-        int value_length = value_str.length();
+        int64_t value_length = value_str.length();
         int64_t start_offset = 0;
-        int64_t end_offset = std::max(value_length - 1, 0);
-        int bytes = end_offset - start_offset + 1;
-        int pos = GetBitPos(value + start_offset, bytes, bit_val);
+        int64_t end_offset = std::max(value_length - 1, (int64_t)0);
+        int64_t bytes = end_offset - start_offset + 1;
+        int64_t pos = GetBitPos(value + start_offset, bytes, bit_val);
         if (pos != -1) {
             pos = pos + 8 * start_offset;
         }
@@ -220,8 +180,8 @@ Status Nemo::BitPos(const std::string &key, const int64_t bit_val, std::int64_t
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &value_str);
     if (s.ok()) {
         const unsigned char * value = (const unsigned char *) (value_str.data());
-        int value_length = value_str.length();
-        int64_t end_offset = std::max(value_length - 1, 0);
+        int64_t value_length = value_str.length();
+        int64_t end_offset = std::max(value_length - 1, (int64_t)0);
         if (start_offset < 0) {
             start_offset = start_offset + value_length;
         }
@@ -236,8 +196,8 @@ Status Nemo::BitPos(const std::string &key, const int64_t bit_val, std::int64_t
             *res = -1;
             return Status::OK();
         }
-        int bytes = end_offset - start_offset + 1;
-        int pos = GetBitPos(value + start_offset, bytes, bit_val);
+        int64_t bytes = end_offset - start_offset + 1;
+        int64_t pos = GetBitPos(value + start_offset, bytes, bit_val);
         if (pos != -1) {
             pos = pos + 8 * start_offset;
         }
@@ -261,7 +221,7 @@ Status Nemo::BitPos(const std::string &key, const int64_t bit_val, std::int64_t
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &value_str);
     if (s.ok()) {
         const unsigned char * value = (const unsigned char *) (value_str.data());
-        int value_length = value_str.length();
+        int64_t value_length = value_str.length();
         if (start_offset < 0) {
             start_offset = start_offset + value_length;
         }
@@ -271,8 +231,7 @@ Status Nemo::BitPos(const std::string &key, const int64_t bit_val, std::int64_t
         if (end_offset < 0) {
             end_offset = end_offset + value_length;
         }
-        // converting to int64_t just avoid warning 
-        if (end_offset > (int64_t)value_str.length() - 1) {
+        if (end_offset > value_length - 1) {
             end_offset = value_length - 1;
         }
         if (end_offset < 0) {
@@ -287,8 +246,8 @@ Status Nemo::BitPos(const std::string &key, const int64_t bit_val, std::int64_t
             return Status::OK();
         }
 
-        int bytes = end_offset - start_offset + 1;
-        int pos = GetBitPos(value + start_offset, bytes, bit_val);
+        int64_t bytes = end_offset - start_offset + 1;
+        int64_t pos = GetBitPos(value + start_offset, bytes, bit_val);
         if (pos == (8 * bytes) && bit_val == 0)
             pos = -1;
         if (pos != -1) {
@@ -315,15 +274,18 @@ std::tuple<int64_t, int64_t> Nemo::BitOpGetSrcValue(const std::vector<std::strin
     int64_t value_len = 0;
     int64_t src_key_num = src_keys.size();
     Status s;
-    std::string value_str;
+    src_values.reserve(src_key_num);
     for (int i = 0; i <= src_key_num - 1; i++) {
-        s = kv_db_->Get(rocksdb::ReadOptions(), src_keys[i], &value_str);
+        // read straight into place, bitmaps run to megabytes
+        src_values.push_back(std::string());
+        s = kv_db_->Get(rocksdb::ReadOptions(), src_keys[i], &src_values.back());
         if (s.ok()) {
-            src_values.push_back(value_str);
-            value_len = value_str.size();
+            value_len = src_values.back().size();
         } else if (s.IsNotFound()) {
-            src_values.push_back(std::string(""));
+            src_values.back().clear();
             value_len = 0;
+        } else {
+            src_values.pop_back();
         }
         max_len = std::max(max_len, value_len);
         if (i == 0) {
@@ -335,59 +297,31 @@ std::tuple<int64_t, int64_t> Nemo::BitOpGetSrcValue(const std::vector<std::strin
     return std::make_tuple(max_len, min_len);
 }
 
-std::string Nemo::BitOpOperate(BitOpType op, const std::vector<std::string> &src_values, int64_t max_len, int64_t min_len) {
-    unsigned char dest_value[max_len];
-    std::vector<int64_t> values_length;
-    for (uint64_t i = 0; i <= src_values.size() - 1; i++) {
-      values_length.push_back(src_values[i].size());
+// The first source becomes the result, the others are folded into it in
+// place; bytes past the end of a source count as 0
+std::string Nemo::BitOpOperate(BitOpType op, std::vector<std::string> &src_values, int64_t max_len, int64_t min_len) {
+    const BitKernel &kernel = GetBitKernel();
+    std::string dest_str;
+    dest_str.swap(src_values[0]);
+    dest_str.resize(max_len, 0);
+    uint8_t *dest_value = (uint8_t *)&dest_str[0];
+    if (op == kBitOpNot) {
+        kernel.op(op, dest_value, NULL, max_len);
+        return dest_str;
     }
-    unsigned char byte;
-    unsigned char output;
-    for (int64_t j = 0; j <= max_len - 1; j++) {
-        if (j <= values_length[0] - 1) {
-            output = src_values[0][j];
-        } else {
-            output = 0;
-        }
-        if (op == kBitOpNot) {
-            output = ~(output);
-        }
-        for (uint64_t i = 1; i <= src_values.size() - 1; i++) {
-            if (values_length[i] - 1 >= j) {
-                byte = src_values[i][j];
-                log_info("set byte:%c",byte);
-            }
-            else {
-                byte = 0;
-                log_info("default byte:%c",byte);
-            }
-            log_info("output:%c",output);
-            switch (op) {
-              case kBitOpNot:
-                break;
-              case kBitOpAnd:
-                output &= byte;
-                break;
-              case kBitOpOr:
-                output |= byte;
-                break;
-              case kBitOpXor:
-                output ^= byte;
-                break;
-              case kBitOpDefault:
-                break;
-            }
-        }
-        dest_value[j] = output;
-    
+    for (uint64_t i = 1; i < src_values.size(); i++) {
+        int64_t len = src_values[i].size();
+        kernel.op(op, dest_value, (const uint8_t *)src_values[i].data(), len);
+        if (op == kBitOpAnd) {
+            memset(dest_value + len, 0, max_len - len);
+        }
     }
-    std::string dest_str = std::string(reinterpret_cast<char*>(dest_value),max_len);
-    //dest_str.insert(reinterpret_cast<char*>(dest_value), max_len);
-
     return dest_str;
 }
 
 Status Nemo::BitOp(BitOpType op, const std::string &dest_key, const std::vector<std::string> &src_keys, int64_t* result_length) {
+    RecordLock l(&mutex_kv_record_, dest_key);
+    kv_group_->Drain();
     Status s;
     uint64_t src_key_num = src_keys.size();
     if (op == kBitOpNot && src_key_num != 1) {
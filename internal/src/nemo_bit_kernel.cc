@@ -0,0 +1,384 @@
+#include <string.h>
+
+#include "nemo_bit_kernel.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define NEMO_BIT_KERNEL_X86 1
+#include <immintrin.h>
+#endif
+
+namespace nemo {
+
+static inline uint64_t LoadWord(const uint8_t *p) {
+    uint64_t w;
+    memcpy(&w, p, sizeof(w));
+    return w;
+}
+
+static inline void StoreWord(uint8_t *p, uint64_t w) {
+    memcpy(p, &w, sizeof(w));
+}
+
+static inline uint64_t PopCountWord(uint64_t w) {
+    w = w - ((w >> 1) & 0x5555555555555555ULL);
+    w = (w & 0x3333333333333333ULL) + ((w >> 2) & 0x3333333333333333ULL);
+    w = (w + (w >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (w * 0x0101010101010101ULL) >> 56;
+}
+
+static uint64_t CountScalar(const uint8_t *p, size_t n) {
+    uint64_t count = 0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        count += PopCountWord(LoadWord(p + i));
+    }
+    for (; i < n; i++) {
+        count += PopCountWord(p[i]);
+    }
+    return count;
+}
+
+static size_t FindScalar(const uint8_t *p, size_t n, uint8_t skip) {
+    const uint64_t skip_word = skip ? ~0ULL : 0;
+    size_t i = 0;
+    while (i + 8 <= n && LoadWord(p + i) == skip_word) {
+        i += 8;
+    }
+    while (i < n && p[i] == skip) {
+        i++;
+    }
+    return i;
+}
+
+static void OpScalar(BitOpType op, uint8_t *dst, const uint8_t *src, size_t n) {
+    size_t i = 0;
+    switch (op) {
+      case kBitOpNot:
+        for (; i + 8 <= n; i += 8) {
+            StoreWord(dst + i, ~LoadWord(dst + i));
+        }
+        for (; i < n; i++) {
+            dst[i] = ~dst[i];
+        }
+        break;
+      case kBitOpAnd:
+        for (; i + 8 <= n; i += 8) {
+            StoreWord(dst + i, LoadWord(dst + i) & LoadWord(src + i));
+        }
+        for (; i < n; i++) {
+            dst[i] &= src[i];
+        }
+        break;
+      case kBitOpOr:
+        for (; i + 8 <= n; i += 8) {
+            StoreWord(dst + i, LoadWord(dst + i) | LoadWord(src + i));
+        }
+        for (; i < n; i++) {
+            dst[i] |= src[i];
+        }
+        break;
+      case kBitOpXor:
+        for (; i + 8 <= n; i += 8) {
+            StoreWord(dst + i, LoadWord(dst + i) ^ LoadWord(src + i));
+        }
+        for (; i < n; i++) {
+            dst[i] ^= src[i];
+        }
+        break;
+      case kBitOpDefault:
+        break;
+    }
+}
+
+#ifdef NEMO_BIT_KERNEL_X86
+
+// The vector loops leave the tail of a range, shorter than a vector, to the
+// scalar ones; src is NULL for kBitOpNot
+static inline const uint8_t* Advance(const uint8_t *src, size_t i) {
+    return src ? src + i : src;
+}
+
+__attribute__((target("popcnt,sse4.2")))
+static uint64_t CountSSE42(const uint8_t *p, size_t n) {
+    uint64_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        c0 += _mm_popcnt_u64(LoadWord(p + i));
+        c1 += _mm_popcnt_u64(LoadWord(p + i + 8));
+        c2 += _mm_popcnt_u64(LoadWord(p + i + 16));
+        c3 += _mm_popcnt_u64(LoadWord(p + i + 24));
+    }
+    for (; i + 8 <= n; i += 8) {
+        c0 += _mm_popcnt_u64(LoadWord(p + i));
+    }
+    return c0 + c1 + c2 + c3 + CountScalar(p + i, n - i);
+}
+
+__attribute__((target("sse4.2")))
+static size_t FindSSE42(const uint8_t *p, size_t n, uint8_t skip) {
+    const __m128i skip_v = _mm_set1_epi8((char)skip);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, skip_v));
+        if (mask != 0xffff) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + FindScalar(p + i, n - i, skip);
+}
+
+__attribute__((target("sse4.2")))
+static void OpSSE42(BitOpType op, uint8_t *dst, const uint8_t *src, size_t n) {
+    size_t i = 0;
+    switch (op) {
+      case kBitOpNot: {
+        const __m128i ones = _mm_set1_epi8(-1);
+        for (; i + 16 <= n; i += 16) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, ones));
+        }
+        break;
+      }
+      case kBitOpAnd:
+        for (; i + 16 <= n; i += 16) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_and_si128(d, s));
+        }
+        break;
+      case kBitOpOr:
+        for (; i + 16 <= n; i += 16) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(d, s));
+        }
+        break;
+      case kBitOpXor:
+        for (; i + 16 <= n; i += 16) {
+            __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+            __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+            _mm_storeu_si128((__m128i *)(dst + i), _mm_xor_si128(d, s));
+        }
+        break;
+      case kBitOpDefault:
+        return;
+    }
+    OpScalar(op, dst + i, Advance(src, i), n - i);
+}
+
+// Nibble lookup popcount: the per byte counts are summed bytewise for up to
+// 8 vectors, which stays below 256, then widened by a sum of absolute
+// differences against zero
+__attribute__((target("avx2")))
+static uint64_t CountAVX2(const uint8_t *p, size_t n) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low_mask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i total = zero;
+    size_t i = 0;
+    while (i + 32 <= n) {
+        __m256i local = zero;
+        for (int j = 0; j < 8 && i + 32 <= n; j++, i += 32) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+            __m256i lo = _mm256_and_si256(v, low_mask);
+            __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+            local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, lo));
+            local = _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, hi));
+        }
+        total = _mm256_add_epi64(total, _mm256_sad_epu8(local, zero));
+    }
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i *)lanes, total);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + CountSSE42(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t FindAVX2(const uint8_t *p, size_t n, uint8_t skip) {
+    const __m256i skip_v = _mm256_set1_epi8((char)skip);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, skip_v));
+        if (mask != 0xffffffffU) {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+    return i + FindScalar(p + i, n - i, skip);
+}
+
+__attribute__((target("avx2")))
+static void OpAVX2(BitOpType op, uint8_t *dst, const uint8_t *src, size_t n) {
+    size_t i = 0;
+    switch (op) {
+      case kBitOpNot: {
+        const __m256i ones = _mm256_set1_epi8(-1);
+        for (; i + 32 <= n; i += 32) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(d, ones));
+        }
+        break;
+      }
+      case kBitOpAnd:
+        for (; i + 32 <= n; i += 32) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_and_si256(d, s));
+        }
+        break;
+      case kBitOpOr:
+        for (; i + 32 <= n; i += 32) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(d, s));
+        }
+        break;
+      case kBitOpXor:
+        for (; i + 32 <= n; i += 32) {
+            __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+            __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+            _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(d, s));
+        }
+        break;
+      case kBitOpDefault:
+        return;
+    }
+    OpScalar(op, dst + i, Advance(src, i), n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static uint64_t CountAVX512(const uint8_t *p, size_t n) {
+    const __m512i lookup = _mm512_broadcast_i32x4(
+        _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4));
+    const __m512i low_mask = _mm512_set1_epi8(0x0f);
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i total = zero;
+    size_t i = 0;
+    while (i + 64 <= n) {
+        __m512i local = zero;
+        for (int j = 0; j < 8 && i + 64 <= n; j++, i += 64) {
+            __m512i v = _mm512_loadu_si512((const void *)(p + i));
+            __m512i lo = _mm512_and_si512(v, low_mask);
+            __m512i hi = _mm512_and_si512(_mm512_srli_epi16(v, 4), low_mask);
+            local = _mm512_add_epi8(local, _mm512_shuffle_epi8(lookup, lo));
+            local = _mm512_add_epi8(local, _mm512_shuffle_epi8(lookup, hi));
+        }
+        total = _mm512_add_epi64(total, _mm512_sad_epu8(local, zero));
+    }
+    uint64_t lanes[8];
+    _mm512_storeu_si512((void *)lanes, total);
+    uint64_t count = 0;
+    for (int j = 0; j < 8; j++) {
+        count += lanes[j];
+    }
+    return count + CountSSE42(p + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t FindAVX512(const uint8_t *p, size_t n, uint8_t skip) {
+    const __m512i skip_v = _mm512_set1_epi8((char)skip);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512i v = _mm512_loadu_si512((const void *)(p + i));
+        __mmask64 mask = _mm512_cmpneq_epi8_mask(v, skip_v);
+        if (mask != 0) {
+            return i + __builtin_ctzll(mask);
+        }
+    }
+    return i + FindScalar(p + i, n - i, skip);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static void OpAVX512(BitOpType op, uint8_t *dst, const uint8_t *src, size_t n) {
+    size_t i = 0;
+    switch (op) {
+      case kBitOpNot: {
+        const __m512i ones = _mm512_set1_epi8(-1);
+        for (; i + 64 <= n; i += 64) {
+            __m512i d = _mm512_loadu_si512((const void *)(dst + i));
+            _mm512_storeu_si512((void *)(dst + i), _mm512_xor_si512(d, ones));
+        }
+        break;
+      }
+      case kBitOpAnd:
+        for (; i + 64 <= n; i += 64) {
+            __m512i d = _mm512_loadu_si512((const void *)(dst + i));
+            __m512i s = _mm512_loadu_si512((const void *)(src + i));
+            _mm512_storeu_si512((void *)(dst + i), _mm512_and_si512(d, s));
+        }
+        break;
+      case kBitOpOr:
+        for (; i + 64 <= n; i += 64) {
+            __m512i d = _mm512_loadu_si512((const void *)(dst + i));
+            __m512i s = _mm512_loadu_si512((const void *)(src + i));
+            _mm512_storeu_si512((void *)(dst + i), _mm512_or_si512(d, s));
+        }
+        break;
+      case kBitOpXor:
+        for (; i + 64 <= n; i += 64) {
+            __m512i d = _mm512_loadu_si512((const void *)(dst + i));
+            __m512i s = _mm512_loadu_si512((const void *)(src + i));
+            _mm512_storeu_si512((void *)(dst + i), _mm512_xor_si512(d, s));
+        }
+        break;
+      case kBitOpDefault:
+        return;
+    }
+    OpScalar(op, dst + i, Advance(src, i), n - i);
+}
+
+#endif
+
+static const BitKernel kBitKernels[kBitKernelLevels] = {
+    { kBitKernelScalar, "scalar", CountScalar, FindScalar, OpScalar },
+#ifdef NEMO_BIT_KERNEL_X86
+    { kBitKernelSSE42, "sse4.2", CountSSE42, FindSSE42, OpSSE42 },
+    { kBitKernelAVX2, "avx2", CountAVX2, FindAVX2, OpAVX2 },
+    { kBitKernelAVX512, "avx512", CountAVX512, FindAVX512, OpAVX512 },
+#endif
+};
+
+static bool BitKernelSupported(BitKernelLevel level) {
+#ifdef NEMO_BIT_KERNEL_X86
+    __builtin_cpu_init();
+    bool sse42 = __builtin_cpu_supports("popcnt") && __builtin_cpu_supports("sse4.2");
+    switch (level) {
+      case kBitKernelScalar:
+        return true;
+      case kBitKernelSSE42:
+        return sse42;
+      case kBitKernelAVX2:
+        return sse42 && __builtin_cpu_supports("avx2");
+      case kBitKernelAVX512:
+        return sse42 && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+      default:
+        return false;
+    }
+#else
+    return level == kBitKernelScalar;
+#endif
+}
+
+const BitKernel* GetBitKernel(BitKernelLevel level) {
+    if (level < kBitKernelScalar || level >= kBitKernelLevels || !BitKernelSupported(level)) {
+        return NULL;
+    }
+    return &kBitKernels[level];
+}
+
+static const BitKernel* BestBitKernel() {
+    for (int level = kBitKernelLevels - 1; level > kBitKernelScalar; level--) {
+        if (BitKernelSupported((BitKernelLevel)level)) {
+            return &kBitKernels[level];
+        }
+    }
+    return &kBitKernels[kBitKernelScalar];
+}
+
+const BitKernel& GetBitKernel() {
+    static const BitKernel *kernel = BestBitKernel();
+    return *kernel;
+}
+
+}
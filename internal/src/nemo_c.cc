@@ -14,6 +14,7 @@
 #include "rocksdb/write_batch.h"
 
 #include <iostream>
+#include <algorithm>
 
 using nemo::Nemo;
 using nemo::Options;
@@ -57,6 +58,7 @@ extern "C"	{
 	struct nemo_SIterator_t { SIterator * rep;};
 	struct nemo_Snaptshot_t { Snapshot * rep;};
 	struct nemo_VolumeIterator_t { nemo::VolumeIterator * rep;};
+	struct nemo_VolumeIndex_t { nemo::VolumeIndex * rep;};
 	struct nemo_DBNemo_t {rocksdb::DBNemo * rep;};
 	struct nemo_WriteBatch_t { rocksdb::WriteBatch rep;};
 
@@ -74,9 +76,14 @@ extern "C"	{
 		delete ssp;
 	}
 
+	void nemo_delBatchGetResult(void * p)
+	{
+		delete ((rocksdb::NemoBatchGetResult *) p);
+	}
+
 //	struct nemo_MetaPtr { MetaPtr rep};
 #ifdef __GO_WRAPPER__
-	static char* CopyString(const std::string& str) {
+	static char* CopyString(const rocksdb::Slice& str) {
 	  char* result = reinterpret_cast<char*>(malloc(sizeof(char) * str.size()));
 	  memcpy(result, str.data(), sizeof(char) * str.size());
 	  // There is no '\0' in origin CopyString in file: rocksdb/db/c.cc
@@ -84,7 +91,7 @@ extern "C"	{
 	  return result;
 	}
 #else
-        static char* CopyString(const std::string& str) {
+        static char* CopyString(const rocksdb::Slice& str) {
           char* result = reinterpret_cast<char*>(malloc(sizeof(char) *( str.size()+1)));
           memcpy(result, str.data(), sizeof(char) * str.size());
           result[str.size()]='\0';
@@ -117,6 +124,16 @@ extern "C"	{
 		return nemo;
 	}
 
+	nemo_t * nemo_Open(const char * db_path,const nemo_options_t * options, char ** errptr){
+		Nemo * nemo_instance_p;
+		if(nemo_SaveError(errptr,Nemo::Open(std::string(db_path),options->rep,&nemo_instance_p))){
+			return nullptr;
+		}
+		nemo_t * nemo = new nemo_t;
+		nemo->rep = nemo_instance_p;
+		return nemo;
+	}
+
 	nemo_options_t * nemo_CreateOption()
 	{
 		return new nemo_options_t;
@@ -294,6 +311,41 @@ extern "C"	{
 		return (void *)vsp;
 	}
 	
+	// The errors of the keys, the values point into result
+	static void nemo_SaveBatchGetResult(const rocksdb::NemoBatchGetResult &result, const char ** val, size_t * vallen, char ** errs){
+		for(size_t i=0;i<result.values.size();i++){
+			if(result.statuses[i].ok()){
+				val[i]   = result.values[i].data();
+				vallen[i] = result.values[i].size();
+				errs[i] = NULL;
+			}
+			else if(result.statuses[i].IsNotFound())
+			{
+				val[i]   = nullptr;
+				vallen[i] = 0;
+				errs[i] = NULL;
+			}
+			else {
+				val[i] = NULL;
+				vallen[i] = 0;
+				errs[i] = strdup(result.statuses[i].ToString().c_str());
+			}
+		}
+	}
+
+	void * nemo_MGetBatch(nemo_t * nemo,  const int num, const char ** key, size_t * keylen, \
+	 		             		                    const char ** val, size_t * vallen, char ** errs){
+		std::vector<rocksdb::Slice> keys(num);
+		for(int i=0;i<num;i++){
+			keys[i] = rocksdb::Slice(key[i],keylen[i]);
+		}
+
+		rocksdb::NemoBatchGetResult * result = new rocksdb::NemoBatchGetResult;
+		nemo->rep->MGetBatch(keys,result);
+		nemo_SaveBatchGetResult(*result,val,vallen,errs);
+		return (void *)result;
+	}
+
 	void nemo_Keys(nemo_t * nemo,  char * pattern, const size_t patternlen, int * key_num, \
 					char *** key_list, size_t ** key_list_strlen , char ** errptr){
 			std::vector<std::string> keys;
@@ -682,6 +734,20 @@ extern "C"	{
 		return (void *) ss;
 	}
 
+	void * nemo_HMGetBatch(nemo_t * nemo,const char * key,const size_t keylen, const int num,		\
+									 const char ** field_list,const size_t * field_list_len,	\
+					 			     const char ** value_list,size_t * value_list_strlen, char ** errs,char ** errptr){
+		std::vector<rocksdb::Slice> fields(num);
+		for (int i = 0; i < num; ++i)
+		{
+			fields[i] = rocksdb::Slice(field_list[i],field_list_len[i]);
+		}
+		rocksdb::NemoBatchGetResult * result = new rocksdb::NemoBatchGetResult;
+		nemo_SaveError(errptr,nemo->rep->HMGetBatch(rocksdb::Slice(key,keylen),fields,result));
+		nemo_SaveBatchGetResult(*result,value_list,value_list_strlen,errs);
+		return (void *)result;
+	}
+
 	void nemo_HSetnx(nemo_t * nemo,const char * key,const size_t keylen,const char * field,const size_t fieldlen,const char * value,const size_t vallen, int64_t * res, char ** errptr){
 		nemo_SaveError(errptr,nemo->rep->HSetnx(std::string(key,keylen),std::string(field,fieldlen),std::string(value,vallen),res));
 	}
@@ -1230,6 +1296,22 @@ extern "C"	{
 		}			
 	}
 
+	void nemo_SMIsMember(nemo_t * nemo,const char * key,const size_t keylen, const int num, const char ** member_list,const size_t * member_list_len, \
+									bool * isMember_list,char ** errptr){
+		std::vector<std::string> members(num);
+		for (int i = 0; i < num; ++i)
+		{
+			members[i] = std::string(member_list[i],member_list_len[i]);
+		}
+		std::vector<bool> is_members;
+		Status s = nemo->rep->SMIsMember(std::string(key,keylen),members,is_members);
+		for (int i = 0; i < num && i < (int)is_members.size(); ++i)
+		{
+			isMember_list[i] = is_members[i];
+		}
+		nemo_SaveError(errptr,s);
+	}
+
 	void nemo_SPop(nemo_t * nemo,const char * key,const size_t keylen,  char ** member, size_t * len, int64_t * res, char ** errptr){
 		std::string member_str;
 		Status s = nemo->rep->SPop(std::string(key,keylen),member_str);
@@ -1474,6 +1556,28 @@ extern "C"	{
 		}
 
 	}
+	void nemo_ZMScore(nemo_t * nemo,const char * key, const size_t keylen, const int num, const char ** member_list,const size_t * member_list_len, \
+									double * score_list, int64_t * res_list, char ** errptr){
+		std::vector<std::string> members(num);
+		for (int i = 0; i < num; ++i)
+		{
+			members[i] = std::string(member_list[i],member_list_len[i]);
+		}
+		std::vector<double> scores;
+		std::vector<Status> statuses;
+		Status s = nemo->rep->ZMScore(std::string(key,keylen),members,scores,statuses);
+		for (int i = 0; i < num && i < (int)scores.size(); ++i)
+		{
+			score_list[i] = scores[i];
+			res_list[i] = statuses[i].ok() ? 1 : 0;
+			if (s.ok() && !statuses[i].ok() && !statuses[i].IsNotFound())
+			{
+				s = statuses[i];
+			}
+		}
+		nemo_SaveError(errptr,s);
+	}
+
     void nemo_ZRangebylex(nemo_t * nemo,const char * key,const size_t keylen,const char * min,const size_t minlen,const char * max, const size_t maxlen, \
 				int * num,char *** member_list, size_t ** member_list_strlen, bool is_lo, bool is_ro,char ** errptr){
     	std::vector<std::string> members;
@@ -1757,6 +1861,50 @@ extern "C"	{
 		delete it;
 	}
 
+	nemo_VolumeIndex_t * createVolumeIndex(nemo_t * nemo)
+	{
+		nemo_VolumeIndex_t * index = new nemo_VolumeIndex_t;
+		index->rep = new nemo::VolumeIndex(nemo->rep);
+		return index;
+	}
+	void VolIndexVolume(nemo_VolumeIndex_t * index,
+								const char * start, const size_t startlen, 
+								const char * end ,const size_t endlen,
+								int64_t * volume, char ** errptr)
+	{
+		std::string startstr(start,startlen);
+		std::string endstr(end,endlen);	
+		nemo_SaveError(errptr,index->rep->Volume(startstr,endstr,volume));
+	}
+	// false with no error if the range holds less than target
+	bool VolIndexTargetKey(nemo_VolumeIndex_t * index,
+								const char * start, const size_t startlen, 
+								const char * end ,const size_t endlen,
+								int64_t target, char ** key, size_t * keylen, char ** errptr)
+	{
+		std::string startstr(start,startlen);
+		std::string endstr(end,endlen);	
+		std::string keystr;
+		Status s = index->rep->TargetKey(startstr,endstr,target,&keystr);
+		if(s.IsNotFound())
+		{
+			*errptr = nullptr;
+			return false;
+		}
+		if(nemo_SaveError(errptr,s))
+		{
+			return false;
+		}
+		*key = CopyString(keystr);
+		*keylen = keystr.size();
+		return true;
+	}
+	void VolIndexFree(nemo_VolumeIndex_t * index)
+	{
+		delete index->rep;
+		delete index;
+	}
+
 	void nemo_RangeDel(nemo_t * nemo,const char * start, const size_t startlen, 
 								const char * end ,const size_t endlen,
 								char ** errptr)
@@ -1789,5 +1937,300 @@ extern "C"	{
 		nemo_SaveError(errptr,nemo->rep->IngestFile(std::string(path)));
 	}
 
+	void nemo_EnableMetrics(nemo_t * nemo, bool enabled, int perf_sample)
+	{
+		nemo->rep->EnableMetrics(enabled,perf_sample);
+	}
+
+	void nemo_GetMetrics(nemo_t * nemo, int * count, char *** name_list, size_t ** name_list_strlen,
+												uint64_t ** value_list)
+	{
+		std::vector<nemo::CommandMetrics> metrics;
+		nemo->rep->GetMetrics(&metrics);
+		*count = metrics.size();
+		if(*count>0){
+			*name_list = new char * [*count];
+			*name_list_strlen = new size_t [*count];
+			*value_list = new uint64_t [*count * NEMO_METRICS_FIELDS];
+			for (int i = 0; i < *count; ++i)
+			{
+				const nemo::CommandMetrics &m = metrics[i];
+				(*name_list)[i] = CopyString(m.name);
+				(*name_list_strlen)[i] = m.name.size();
+				uint64_t values[NEMO_METRICS_FIELDS] = {
+					m.calls, m.micros, m.p50, m.p99, m.p999, m.max,
+					m.lock_waits, m.lock_wait_micros, m.lock_wait_p99,
+					m.gets, m.meta_gets, m.bytes_read, m.bytes_written,
+					m.perf_samples, m.perf_block_reads, m.perf_block_read_nanos,
+					m.perf_memtable_get_nanos, m.perf_sst_get_nanos,
+					m.perf_wal_nanos, m.perf_memtable_write_nanos};
+				memcpy(*value_list + i * NEMO_METRICS_FIELDS, values, sizeof(values));
+			}
+		}
+		else{
+			*name_list = nullptr;
+			*name_list_strlen = nullptr;
+			*value_list = nullptr;
+		}
+	}
+
+	void nemo_ResetMetrics(nemo_t * nemo)
+	{
+		nemo->rep->ResetMetrics();
+	}
+
+	void nemo_EnableKeyProfiler(nemo_t * nemo, bool enabled, int sample_every)
+	{
+		nemo->rep->EnableKeyProfiler(enabled, sample_every);
+	}
+
+	static int64_t ProfiledKeyType(const std::string &type)
+	{
+		if(type == nemo::HASH_DB) return nemo::kHASH_DB;
+		if(type == nemo::LIST_DB) return nemo::kLIST_DB;
+		if(type == nemo::ZSET_DB) return nemo::kZSET_DB;
+		if(type == nemo::SET_DB) return nemo::kSET_DB;
+		return nemo::kKV_DB;
+	}
+
+	void nemo_GetKeyProfile(nemo_t * nemo, uint64_t * samples, uint64_t * dropped, int * count,
+												char *** key_list, size_t ** key_list_strlen, int64_t ** value_list)
+	{
+		nemo::KeyProfile profile;
+		nemo->rep->GetKeyProfile(&profile);
+		*samples = profile.samples;
+		*dropped = profile.dropped;
+		std::vector<nemo::ProfiledKey> keys(profile.hot_keys);
+		keys.insert(keys.end(), profile.big_keys.begin(), profile.big_keys.end());
+		*count = keys.size();
+		if(*count>0){
+			*key_list = new char * [*count];
+			*key_list_strlen = new size_t [*count];
+			*value_list = new int64_t [*count * NEMO_KEY_PROFILE_FIELDS];
+			for (int i = 0; i < *count; ++i)
+			{
+				const nemo::ProfiledKey &k = keys[i];
+				(*key_list)[i] = CopyString(k.key);
+				(*key_list_strlen)[i] = k.key.size();
+				int64_t values[NEMO_KEY_PROFILE_FIELDS] = {
+					i < (int)profile.hot_keys.size() ? 0 : 1, ProfiledKeyType(k.type),
+					(int64_t)k.calls, (int64_t)k.error, (int64_t)k.micros, (int64_t)k.bytes,
+					k.len, k.vol};
+				memcpy(*value_list + i * NEMO_KEY_PROFILE_FIELDS, values, sizeof(values));
+			}
+		}
+		else{
+			*key_list = nullptr;
+			*key_list_strlen = nullptr;
+			*value_list = nullptr;
+		}
+	}
+
+	void nemo_ResetKeyProfile(nemo_t * nemo)
+	{
+		nemo->rep->ResetKeyProfile();
+	}
+
+	void nemo_BulkInit(nemo_bulk_t * bulk, char * buf, size_t cap, size_t * offsets, size_t offsets_cap)
+	{
+		bulk->buf = buf;
+		bulk->size = 0;
+		bulk->cap = buf != NULL ? cap : 0;
+		bulk->offsets = offsets;
+		bulk->count = 0;
+		bulk->offsets_cap = offsets != NULL ? offsets_cap : 0;
+		bulk->owned = 0;
+	}
+
+	void nemo_BulkFree(nemo_bulk_t * bulk)
+	{
+		if(bulk->owned & 1)
+		{
+			free(bulk->buf);
+		}
+		if(bulk->owned & 2)
+		{
+			free(bulk->offsets);
+		}
+		nemo_BulkInit(bulk,NULL,0,NULL,0);
+	}
+
+	// Freed as the thread exits
+	struct ThreadBulk {
+		nemo_bulk_t bulk;
+		ThreadBulk() { nemo_BulkInit(&bulk,NULL,0,NULL,0); }
+		~ThreadBulk() { nemo_BulkFree(&bulk); }
+	};
+
+	nemo_bulk_t * nemo_ThreadBulk()
+	{
+		static thread_local ThreadBulk thread_bulk;
+		return &thread_bulk.bulk;
+	}
+
+	bool nemo_BulkGet(const nemo_bulk_t * bulk, size_t i, const char ** data, size_t * len)
+	{
+		uint32_t size;
+		memcpy(&size, bulk->buf + bulk->offsets[i] - sizeof(size), sizeof(size));
+		if(size == NEMO_BULK_NIL)
+		{
+			*data = nullptr;
+			*len = 0;
+			return false;
+		}
+		*data = bulk->buf + bulk->offsets[i];
+		*len = size;
+		return true;
+	}
+
+	// Empties bulk with room for count more strings of bytes in all, the
+	// memory of a caller outgrown for the library's, which then doubles
+	static void BulkReset(nemo_bulk_t * bulk, size_t count, size_t bytes)
+	{
+		bulk->size = 0;
+		bulk->count = 0;
+		size_t need = bytes + count * sizeof(uint32_t);
+		if(need > bulk->cap)
+		{
+			size_t cap = std::max(need, bulk->cap * 2);
+			if(bulk->owned & 1)
+			{
+				free(bulk->buf);
+			}
+			bulk->buf = reinterpret_cast<char *>(malloc(cap));
+			bulk->cap = cap;
+			bulk->owned |= 1;
+		}
+		if(count > bulk->offsets_cap)
+		{
+			size_t cap = std::max(count, bulk->offsets_cap * 2);
+			if(bulk->owned & 2)
+			{
+				free(bulk->offsets);
+			}
+			bulk->offsets = reinterpret_cast<size_t *>(malloc(cap * sizeof(size_t)));
+			bulk->offsets_cap = cap;
+			bulk->owned |= 2;
+		}
+	}
+
+	// Within the room of BulkReset
+	static void BulkAppend(nemo_bulk_t * bulk, const char * data, uint32_t len)
+	{
+		memcpy(bulk->buf + bulk->size, &len, sizeof(len));
+		bulk->size += sizeof(len);
+		bulk->offsets[bulk->count++] = bulk->size;
+		if(len != NEMO_BULK_NIL)
+		{
+			memcpy(bulk->buf + bulk->size, data, len);
+			bulk->size += len;
+		}
+	}
+
+	static void BulkStrings(nemo_bulk_t * bulk, const std::vector<std::string> &strs)
+	{
+		size_t bytes = 0;
+		for(size_t i=0;i<strs.size();i++)
+		{
+			bytes += strs[i].size();
+		}
+		BulkReset(bulk,strs.size(),bytes);
+		for(size_t i=0;i<strs.size();i++)
+		{
+			BulkAppend(bulk,strs[i].data(),strs[i].size());
+		}
+	}
+
+	void nemo_HGetallBulk(nemo_t * nemo,const char * key,const size_t keylen, nemo_bulk_t * bulk, char ** errptr)
+	{
+		std::vector<FV> fvs;
+		nemo_SaveError(errptr,nemo->rep->HGetall(std::string(key,keylen),fvs));
+		size_t bytes = 0;
+		for(size_t i=0;i<fvs.size();i++)
+		{
+			bytes += fvs[i].field.size() + fvs[i].val.size();
+		}
+		BulkReset(bulk,fvs.size() * 2,bytes);
+		for(size_t i=0;i<fvs.size();i++)
+		{
+			BulkAppend(bulk,fvs[i].field.data(),fvs[i].field.size());
+			BulkAppend(bulk,fvs[i].val.data(),fvs[i].val.size());
+		}
+	}
+
+	void nemo_KeysBulk(nemo_t * nemo,const char * pattern,const size_t patternlen, nemo_bulk_t * bulk, char ** errptr)
+	{
+		std::vector<std::string> keys;
+		nemo_SaveError(errptr,nemo->rep->Keys(std::string(pattern,patternlen),keys));
+		BulkStrings(bulk,keys);
+	}
+
+	void nemo_ScanBulk(nemo_t * nemo, int64_t cursor, const char * pattern, const size_t patternlen, int64_t count, \
+							nemo_bulk_t * bulk, int64_t * cursor_ret, char ** errptr)
+	{
+		std::vector<std::string> keys;
+		std::string pattern_str(pattern,patternlen);
+		nemo_SaveError(errptr,nemo->rep->Scan(cursor,pattern_str,count,keys,cursor_ret));
+		BulkStrings(bulk,keys);
+	}
+
+	void nemo_LRangeBulk(nemo_t * nemo,const char * key,const size_t keylen,const int64_t begin,const int64_t end, \
+							nemo_bulk_t * bulk, char ** errptr)
+	{
+		std::vector<IV> ivs;
+		Status s = nemo->rep->LRange(std::string(key,keylen),begin,end,ivs);
+		if(!s.IsNotFound())
+		{
+			nemo_SaveError(errptr,s);
+		}
+		size_t bytes = 0;
+		for(size_t i=0;i<ivs.size();i++)
+		{
+			bytes += ivs[i].val.size();
+		}
+		BulkReset(bulk,ivs.size(),bytes);
+		for(size_t i=0;i<ivs.size();i++)
+		{
+			BulkAppend(bulk,ivs[i].val.data(),ivs[i].val.size());
+		}
+	}
+
+	void nemo_SMembersBulk(nemo_t * nemo,const char * key,const size_t keylen, nemo_bulk_t * bulk, char ** errptr)
+	{
+		std::vector<std::string> members;
+		nemo_SaveError(errptr,nemo->rep->SMembers(std::string(key,keylen),members));
+		BulkStrings(bulk,members);
+	}
+
+	void nemo_MGetBulk(nemo_t * nemo, const int num, const char ** key, size_t * keylen, \
+							nemo_bulk_t * bulk, char ** errptr)
+	{
+		std::vector<rocksdb::Slice> keys(num);
+		for(int i=0;i<num;i++){
+			keys[i] = rocksdb::Slice(key[i],keylen[i]);
+		}
+		rocksdb::NemoBatchGetResult result;
+		bool failed = nemo_SaveError(errptr,nemo->rep->MGetBatch(keys,&result));
+		size_t bytes = 0;
+		for(size_t i=0;i<result.values.size();i++)
+		{
+			bytes += result.values[i].size();
+		}
+		BulkReset(bulk,result.values.size(),bytes);
+		for(size_t i=0;i<result.values.size();i++)
+		{
+			if(result.statuses[i].ok())
+			{
+				BulkAppend(bulk,result.values[i].data(),result.values[i].size());
+				continue;
+			}
+			if(!result.statuses[i].IsNotFound() && !failed)
+			{
+				failed = nemo_SaveError(errptr,result.statuses[i]);
+			}
+			BulkAppend(bulk,NULL,NEMO_BULK_NIL);
+		}
+	}
+
 } // end of extern "C"
 
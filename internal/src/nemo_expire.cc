@@ -0,0 +1,333 @@
+#include <sys/time.h>
+#include <climits>
+#include <ctime>
+#include <algorithm>
+#include <map>
+
+#include "nemo_expire.h"
+#include "nemo_hash.h"
+#include "nemo_list.h"
+#include "nemo_set.h"
+#include "nemo_zset.h"
+#include "nemo_metrics.h"
+#include "nemo_mutex.h"
+#include "nemo_write_group.h"
+#include "xdebug.h"
+
+namespace nemo {
+
+// Keys reclaimed under one set of record locks, by one write
+static const size_t kReclaimChunk = 64;
+
+static uint64_t NowMicros() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static void SweeperThread(ExpireSweeper *sweeper) {
+    sweeper->Run();
+}
+
+ExpireSweeper::ExpireSweeper(Nemo *nemo, int rate, int interval)
+    : nemo_(nemo),
+    rate_(rate > 0 ? rate : 0),
+    interval_(interval > 0 ? interval : 1000),
+    cv_(&mu_),
+    stopping_(false),
+    cursor_(0),
+    rewind_(INT32_MAX),
+    indexed_(0),
+    swept_(0),
+    expired_(0),
+    stale_(0),
+    rounds_(0) {
+}
+
+ExpireSweeper::~ExpireSweeper() {
+    Stop();
+}
+
+void ExpireSweeper::Start() {
+    if (rate_ > 0) {
+        thread_ = std::thread(&SweeperThread, this);
+    }
+}
+
+void ExpireSweeper::Stop() {
+    mu_.Lock();
+    stopping_ = true;
+    cv_.SignalAll();
+    mu_.Unlock();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void ExpireSweeper::Run() {
+    int64_t budget = std::max<int64_t>(1, static_cast<int64_t>(rate_) * interval_ / 1000);
+    mu_.Lock();
+    while (!stopping_) {
+        uint64_t deadline = NowMicros() + static_cast<uint64_t>(interval_) * 1000;
+        while (!stopping_ && !cv_.TimedWait(deadline)) {
+        }
+        if (stopping_) {
+            break;
+        }
+        mu_.Unlock();
+
+        int64_t expired;
+        Status s = Sweep(budget, &expired);
+        if (!s.ok()) {
+            log_warn("sweep expire index failed, %s", s.ToString().c_str());
+        }
+
+        mu_.Lock();
+    }
+    mu_.Unlock();
+}
+
+// Written before the ttl, so that no key expires unindexed, an entry of a
+// write which then failed is stale. An entry of a timestamp already passed
+// may be behind the cursor, the next round seeks from it then; the entries
+// to expire later are always ahead of it.
+Status ExpireSweeper::Index(char type, const rocksdb::Slice &key, int32_t timestamp) {
+    if (!indexing()) {
+        return Status::OK();
+    }
+    indexed_++;
+    Status s = nemo_->expire_db_->Put(w_opts_nolog(), EncodeExpireKey(timestamp, type, key), "");
+    if (s.ok() && timestamp <= static_cast<int32_t>(std::time(0))) {
+        Rewind(timestamp);
+    }
+    return s;
+}
+
+void ExpireSweeper::Rewind(int32_t timestamp) {
+    int32_t rewind = rewind_.load();
+    while (timestamp < rewind && !rewind_.compare_exchange_weak(rewind, timestamp)) {
+    }
+}
+
+Status ExpireSweeper::IndexBatch(rocksdb::WriteBatch *entries) {
+    if (!indexing()) {
+        return Status::OK();
+    }
+    indexed_ += entries->Count();
+    return nemo_->expire_db_->Write(w_opts_nolog(), entries);
+}
+
+// The entries swept are deleted in one batch at the end, a sweep stopped
+// halfway, or failing to reclaim its keys, checks them again
+Status ExpireSweeper::Sweep(int64_t max_entries, int64_t *expired) {
+    *expired = 0;
+    sweep_mu_.Lock();
+    // GetKeyTTL holds a key one second past its timestamp
+    int32_t due = static_cast<int32_t>(std::time(0)) - 1;
+    // Taken before the iterator, which then sees the entries rewound to
+    int32_t start = std::min(cursor_, rewind_.exchange(INT32_MAX));
+    int32_t last = start;
+
+    rocksdb::ReadOptions read_options;
+    read_options.fill_cache = false;
+    rocksdb::Iterator *it = nemo_->expire_db_->NewIterator(read_options);
+    rocksdb::WriteBatch batch;
+    // The keys still expired, by type, checked again once locked
+    std::map<char, std::vector<std::string> > candidates;
+    int64_t swept = 0;
+    for (it->Seek(EncodeExpireKey(start, '\0', "")); it->Valid() && swept < max_entries; it->Next()) {
+        int32_t timestamp;
+        char type;
+        std::string key;
+        if (DecodeExpireKey(it->key(), &timestamp, &type, &key) == 0) {
+            if (timestamp >= due) {
+                break;
+            }
+            last = timestamp;
+            TypeDB t;
+            if (GetTypeDB(type, &t) && Expired(t.db, EncodeMetaKey(type, key))) {
+                candidates[type].push_back(key);
+            }
+        }
+        batch.Delete(it->key());
+        swept++;
+    }
+    Status s = it->status();
+    delete it;
+
+    std::map<char, std::vector<std::string> >::iterator cit;
+    for (cit = candidates.begin(); s.ok() && cit != candidates.end(); cit++) {
+        int64_t reclaimed = 0;
+        s = Reclaim(cit->first, cit->second, &reclaimed);
+        *expired += reclaimed;
+    }
+    if (s.ok() && batch.Count() > 0) {
+        s = nemo_->expire_db_->Write(w_opts_nolog(), &batch);
+    }
+    if (s.ok()) {
+        cursor_ = last;
+    } else {
+        Rewind(start);
+    }
+
+    swept_ += swept;
+    expired_ += *expired;
+    stale_ += swept - *expired;
+    rounds_++;
+    sweep_mu_.Unlock();
+    return s;
+}
+
+std::string ExpireSweeper::EncodeMetaKey(char type, const std::string &key) {
+    switch (type) {
+        case DataType::kHSize:
+            return EncodeHsizeKey(key);
+        case DataType::kLMeta:
+            return EncodeLMetaKey(key);
+        case DataType::kZSize:
+            return EncodeZSizeKey(key);
+        case DataType::kSSize:
+            return EncodeSSizeKey(key);
+        default:
+            return key;
+    }
+}
+
+bool ExpireSweeper::GetTypeDB(char type, TypeDB *t) {
+    switch (type) {
+        case DataType::kKv:
+            *t = TypeDB{kKV_DB, nemo_->kv_db_.get(), &nemo_->mutex_kv_record_, nemo_->kv_group_};
+            return true;
+        case DataType::kHSize:
+            *t = TypeDB{kHASH_DB, nemo_->hash_db_.get(), &nemo_->mutex_hash_record_, nemo_->hash_group_};
+            return true;
+        case DataType::kLMeta:
+            *t = TypeDB{kLIST_DB, nemo_->list_db_.get(), &nemo_->mutex_list_record_, nemo_->list_group_};
+            return true;
+        case DataType::kZSize:
+            *t = TypeDB{kZSET_DB, nemo_->zset_db_.get(), &nemo_->mutex_zset_record_, nemo_->zset_group_};
+            return true;
+        case DataType::kSSize:
+            *t = TypeDB{kSET_DB, nemo_->set_db_.get(), &nemo_->mutex_set_record_, nemo_->set_group_};
+            return true;
+        default:
+            return false;
+    }
+}
+
+// -2 and NotFound only for a value still there but expired
+bool ExpireSweeper::Expired(rocksdb::DBNemo *db, const std::string &meta_key) {
+    int32_t ttl = 0;
+    Status s = db->GetKeyTTL(rocksdb::ReadOptions(), meta_key, &ttl);
+    return s.IsNotFound() && ttl == -2;
+}
+
+// Sorted, the ranges which overlap or touch as one
+static void MergeTouching(KeyRanges *ranges) {
+    std::sort(ranges->begin(), ranges->end());
+    size_t n = 0;
+    for (size_t i = 0; i < ranges->size(); i++) {
+        if (n > 0 && (*ranges)[i].first <= (*ranges)[n - 1].second) {
+            if ((*ranges)[i].second > (*ranges)[n - 1].second) {
+                (*ranges)[n - 1].second = (*ranges)[i].second;
+            }
+        } else {
+            (*ranges)[n++] = (*ranges)[i];
+        }
+    }
+    ranges->resize(n);
+}
+
+// The keys are taken kReclaimChunk at a time. The record locks of a chunk
+// keep the writers of its keys out until its writes land, one rocksdb write
+// of them all, and the writes queued to the group before them, as by
+// SetAsync, land before the keys are checked again. Each key is prepared
+// alone, for a version of its own.
+Status ExpireSweeper::Reclaim(char type, const std::vector<std::string> &candidates, int64_t *reclaimed) {
+    *reclaimed = 0;
+    TypeDB t;
+    if (!GetTypeDB(type, &t)) {
+        return Status::OK();
+    }
+    std::vector<std::string> keys(candidates);
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    // The empty meta of the type, as Del writes it
+    std::string empty_meta;
+    if (t.db_type == kHASH_DB) {
+        HashMeta().EncodeTo(empty_meta);
+    } else if (t.db_type == kLIST_DB) {
+        ListMeta().EncodeTo(empty_meta);
+    } else if (t.db_type != kKV_DB) {
+        DefaultMeta().EncodeTo(empty_meta);
+    }
+    rocksdb::NemoWriteKind kind = t.db_type == kKV_DB ? rocksdb::kNemoWriteTTL : rocksdb::kNemoWriteKeyVersion;
+
+    Status s;
+    KeyRanges ranges;
+    for (size_t first = 0; first < keys.size() && s.ok(); first += kReclaimChunk) {
+        std::vector<std::string> chunk(keys.begin() + first,
+                                       keys.begin() + std::min(first + kReclaimChunk, keys.size()));
+        std::vector<rocksdb::NemoPreparedWrite> prepared(chunk.size());
+        std::vector<rocksdb::NemoPreparedWrite *> writes;
+        std::vector<std::string> written;
+
+        MultiRecordLock l(t.mu, chunk);
+        s = t.group->Drain();
+        for (size_t i = 0; i < chunk.size() && s.ok(); i++) {
+            std::string meta_key = EncodeMetaKey(type, chunk[i]);
+            if (!Expired(t.db, meta_key)) {
+                continue;
+            }
+            rocksdb::WriteBatch batch;
+            if (t.db_type == kKV_DB) {
+                batch.Delete(meta_key);
+            } else {
+                batch.Put(meta_key, empty_meta);
+            }
+            s = t.db->PrepareWrite(kind, &batch, 0, &prepared[i]);
+            if (s.ok()) {
+                writes.push_back(&prepared[i]);
+                written.push_back(chunk[i]);
+            }
+        }
+        if (!s.ok() || writes.empty()) {
+            continue;
+        }
+        s = t.db->WritePrepared(w_opts_nolog(), writes);
+        if (!s.ok()) {
+            continue;
+        }
+
+        *reclaimed += written.size();
+        for (size_t i = 0; i < written.size(); i++) {
+            std::string meta_key = EncodeMetaKey(type, written[i]);
+            std::string meta_end = meta_key;
+            meta_end.push_back('\0');
+            ranges.push_back(std::make_pair(meta_key, meta_end));
+            if (t.db_type != kKV_DB) {
+                nemo_->KeyCompactRanges(t.db_type, written[i], &ranges);
+                nemo_->metrics_->profiler()->Meta(t.db_type, written[i], 0, 0);
+            }
+        }
+    }
+
+    // The ranges of the keys, apart from each other but for those which
+    // touch, so that no compaction spans the keys between them
+    MergeTouching(&ranges);
+    for (size_t i = 0; i < ranges.size(); i++) {
+        nemo_->AddBGTask(BGTask(t.db_type, OPERATION::kCLEAN_RANGE, ranges[i].first, ranges[i].second));
+    }
+    return s;
+}
+
+void ExpireSweeper::GetStats(ExpireStats *stats) {
+    stats->indexed = indexed_;
+    stats->swept = swept_;
+    stats->expired = expired_;
+    stats->stale = stale_;
+    stats->rounds = rounds_;
+}
+
+}
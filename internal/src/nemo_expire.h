@@ -0,0 +1,133 @@
+#ifndef NEMO_INCLUDE_NEMO_EXPIRE_H_
+#define NEMO_INCLUDE_NEMO_EXPIRE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "nemo.h"
+#include "nemo_const.h"
+#include "port.h"
+
+namespace nemo {
+
+// An entry of the expire index is the timestamp a key expires at, big
+// endian so that the entries sort by it, the meta prefix of its type, 'k'
+// for kv, and the key:
+//
+//   | timestamp (4 bytes) | type (1 byte) | key |
+//
+inline std::string EncodeExpireKey(int32_t timestamp, char type, const rocksdb::Slice &key) {
+    std::string buf;
+    uint32_t ts = static_cast<uint32_t>(timestamp);
+    buf.append(1, static_cast<char>(ts >> 24));
+    buf.append(1, static_cast<char>(ts >> 16));
+    buf.append(1, static_cast<char>(ts >> 8));
+    buf.append(1, static_cast<char>(ts));
+    buf.append(1, type);
+    buf.append(key.data(), key.size());
+    return buf;
+}
+
+inline int DecodeExpireKey(const rocksdb::Slice &slice, int32_t *timestamp, char *type, std::string *key) {
+    if (slice.size() < 5) {
+        return -1;
+    }
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(slice.data());
+    *timestamp = static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+    *type = slice[4];
+    key->assign(slice.data() + 5, slice.size() - 5);
+    return 0;
+}
+
+// Reclaims the keys with a ttl soon after they expire, instead of whenever
+// a compaction happens to reach them. With a rate, every Expire, Expireat
+// and write with a ttl first indexes the key by its expire timestamp in the
+// expire db, and the sweeper takes the index in timestamp order:
+//
+//   - an entry whose key has expired gets, under the record lock of the
+//     key, a delete of a kv key or an empty meta of a new version for the
+//     other types, as Del writes; the keys are locked and written a few
+//     dozens at a time, once the write group of their db is drained
+//   - an entry whose key was deleted, persisted or given another ttl since,
+//     which has its own entry, is stale and only dropped
+//
+// Each key reclaimed then takes the compactions of its meta and data key
+// ranges, queued to the BGScheduler, where the compaction filter drops the
+// old versions; only the ranges which touch are merged.
+//
+// A round checks up to rate * interval / 1000 entries, so rate bounds the
+// reads of the sweeper, and the backpressure of the BGScheduler the
+// compactions it queues. A round seeks from the timestamp the last one
+// stopped at, rather than over the deletes of the entries swept before.
+class ExpireSweeper {
+public:
+    // rate entries per second, 0 for no sweeper thread nor index, interval
+    // millis between two rounds
+    ExpireSweeper(Nemo *nemo, int rate, int interval);
+    ~ExpireSweeper();
+
+    void Start();
+    void Stop();
+
+    // Whether Index writes the entries
+    bool indexing() const { return rate_ > 0; }
+    // Indexes key of type, by the meta prefix, to expire at timestamp
+    Status Index(char type, const rocksdb::Slice &key, int32_t timestamp);
+    // Writes the entries of many keys, put by EncodeExpireKey, all of them
+    // to expire after now
+    Status IndexBatch(rocksdb::WriteBatch *entries);
+    Status Sweep(int64_t max_entries, int64_t *expired);
+    void GetStats(ExpireStats *stats);
+
+    void Run();
+
+private:
+    // The db of the keys of a meta prefix, and what guards their writes
+    struct TypeDB {
+        DBType db_type;
+        rocksdb::DBNemo *db;
+        port::RecordMutex *mu;
+        WriteGroup *group;
+    };
+
+    // Has the next round seek from timestamp, if it is behind the cursor
+    void Rewind(int32_t timestamp);
+    static std::string EncodeMetaKey(char type, const std::string &key);
+    bool GetTypeDB(char type, TypeDB *t);
+    // Whether the meta key, or kv key, of db holds a value expired
+    static bool Expired(rocksdb::DBNemo *db, const std::string &meta_key);
+    // Reclaims the keys of type still expired once locked, see above
+    Status Reclaim(char type, const std::vector<std::string> &keys, int64_t *reclaimed);
+
+    Nemo *nemo_;
+    int rate_;
+    int interval_;
+    std::thread thread_;
+
+    port::Mutex mu_;
+    port::CondVar cv_;
+    bool stopping_;
+    // One sweep at a time
+    port::Mutex sweep_mu_;
+    // The timestamp the next round seeks from, under sweep_mu_
+    int32_t cursor_;
+    // The lowest timestamp indexed behind the cursor since the last round
+    // started, INT32_MAX for none
+    std::atomic<int32_t> rewind_;
+
+    std::atomic<uint64_t> indexed_;
+    std::atomic<uint64_t> swept_;
+    std::atomic<uint64_t> expired_;
+    std::atomic<uint64_t> stale_;
+    std::atomic<uint64_t> rounds_;
+
+    //No Copying Allowed
+    ExpireSweeper(const ExpireSweeper&);
+    void operator=(const ExpireSweeper&);
+};
+
+}
+#endif
@@ -0,0 +1,117 @@
+#include <string.h>
+#include <algorithm>
+
+#include "nemo_glob.h"
+
+namespace nemo {
+
+GlobMatcher::GlobMatcher(const std::string &pattern) : matches_all_(false) {
+    std::vector<Token> tokens;
+    size_t n = pattern.size();
+    size_t i = 0;
+    while (i < n) {
+        Token token;
+        token.c = 0;
+        token.cls = -1;
+        switch (pattern[i]) {
+            case '*':
+                token.type = kStar;
+                while (i < n && pattern[i] == '*') {
+                    i++;
+                }
+                break;
+            case '?':
+                token.type = kAnyChar;
+                i++;
+                break;
+            case '[': {
+                // an unclosed class runs to the end of the pattern
+                std::bitset<256> cls;
+                i++;
+                bool not_flag = i < n && pattern[i] == '^';
+                if (not_flag) {
+                    i++;
+                }
+                while (i < n && pattern[i] != ']') {
+                    if (pattern[i] == '\\' && i + 1 < n) {
+                        cls.set((unsigned char)pattern[i + 1]);
+                        i += 2;
+                    } else if (i + 2 < n && pattern[i + 1] == '-') {
+                        unsigned char start = pattern[i];
+                        unsigned char end = pattern[i + 2];
+                        if (start > end) {
+                            std::swap(start, end);
+                        }
+                        for (int c = start; c <= end; c++) {
+                            cls.set(c);
+                        }
+                        i += 3;
+                    } else {
+                        cls.set((unsigned char)pattern[i]);
+                        i++;
+                    }
+                }
+                i++;
+                if (not_flag) {
+                    cls.flip();
+                }
+                token.type = kClass;
+                token.cls = classes_.size();
+                classes_.push_back(cls);
+                break;
+            }
+            case '\\':
+                if (i + 1 < n) {
+                    i++;
+                }
+                /* fall through */
+            default:
+                token.type = kLiteral;
+                token.c = pattern[i];
+                i++;
+                break;
+        }
+        tokens.push_back(token);
+    }
+
+    size_t first = 0;
+    while (first < tokens.size() && tokens[first].type == kLiteral) {
+        prefix_.push_back(tokens[first].c);
+        first++;
+    }
+    tokens_.assign(tokens.begin() + first, tokens.end());
+    matches_all_ = tokens_.size() == 1 && tokens_[0].type == kStar;
+}
+
+// Every token but the stars takes one char, so a star backs off one char at
+// a time from where it last matched and no state is kept but the last star
+bool GlobMatcher::Match(const char *str, size_t len) const {
+    if (len < prefix_.size() || memcmp(str, prefix_.data(), prefix_.size()) != 0) {
+        return false;
+    }
+    const unsigned char *s = (const unsigned char *)str;
+    size_t si = prefix_.size();
+    size_t ti = 0;
+    size_t star = tokens_.size();
+    size_t star_si = 0;
+    while (si < len) {
+        if (ti < tokens_.size() && tokens_[ti].type == kStar) {
+            star = ti++;
+            star_si = si;
+        } else if (ti < tokens_.size() && MatchChar(tokens_[ti], s[si])) {
+            ti++;
+            si++;
+        } else if (star < tokens_.size()) {
+            ti = star + 1;
+            si = ++star_si;
+        } else {
+            return false;
+        }
+    }
+    while (ti < tokens_.size() && tokens_[ti].type == kStar) {
+        ti++;
+    }
+    return ti == tokens_.size();
+}
+
+}
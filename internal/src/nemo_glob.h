@@ -0,0 +1,55 @@
+#ifndef NEMO_INCLUDE_NEMO_GLOB_H_
+#define NEMO_INCLUDE_NEMO_GLOB_H_
+
+#include <bitset>
+#include <string>
+#include <vector>
+
+#include "rocksdb/slice.h"
+
+namespace nemo {
+
+// A glob pattern of KEYS and SCAN compiled once, matching as stringmatchlen
+// does. Every key it matches starts with prefix(), so that a scan seeks to
+// the prefix and stops past it instead of testing all the keys, and the keys
+// starting with prefix() need no test at all when MatchesAll().
+class GlobMatcher {
+public:
+    explicit GlobMatcher(const std::string &pattern);
+
+    bool Match(const char *str, size_t len) const;
+    bool Match(const rocksdb::Slice &str) const { return Match(str.data(), str.size()); }
+
+    const std::string &prefix() const { return prefix_; }
+    bool MatchesAll() const { return matches_all_; }
+
+private:
+    enum TokenType {
+        kLiteral,
+        kAnyChar,
+        kStar,
+        kClass
+    };
+    struct Token {
+        TokenType type;
+        unsigned char c;    // kLiteral
+        int cls;            // kClass, index in classes_
+    };
+
+    bool MatchChar(const Token &token, unsigned char c) const {
+        switch (token.type) {
+            case kLiteral: return token.c == c;
+            case kClass:   return classes_[token.cls].test(c);
+            default:       return true;
+        }
+    }
+
+    // The tokens after the prefix
+    std::vector<Token> tokens_;
+    std::vector<std::bitset<256> > classes_;
+    std::string prefix_;
+    bool matches_all_;
+};
+
+}
+#endif
@@ -1,4 +1,7 @@
 #include "nemo_hash.h"
+#include "nemo_expire.h"
+#include "nemo_metrics.h"
+#include "nemo_write_group.h"
 
 #include <climits>
 #include <ctime>
@@ -115,18 +118,17 @@ Status Nemo::HCheckMetaKey(const std::string& key) {
 }
 
 Status Nemo::HSet(const rocksdb::Slice &key, const rocksdb::Slice &field, const rocksdb::Slice &val, int * res) {
+    MetricsScope metrics(metrics_, kCmdHSet, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
 
     Status s;
 
-    //RecordLock l(&mutex_hash_record_, key);
-    //MutexLock l(&mutex_hash_);
+    // The meta len read by IncrHSize must not change until the write
+    RecordLock l(&mutex_hash_record_, key);
     rocksdb::WriteBatch writebatch;
 
-    //sleep(8);
-
     int ret = DoHSet(key, field, val, writebatch);
     if (ret > 0) {
         if (IncrHSize(key, ret, key.size()+field.size() + val.size() , writebatch) == -1) {
@@ -137,7 +139,7 @@ Status Nemo::HSet(const rocksdb::Slice &key, const rocksdb::Slice &field, const
     }
     else
         *res = 0;
-    s = hash_db_->WriteWithOldKeyTTL(w_opts_nolog(), &(writebatch));
+    s = hash_group_->Write(w_opts_nolog(), rocksdb::kNemoWriteOldKeyTTL, &writebatch);
 
     //hash_record_.Unlock(key);
     return s;
@@ -157,6 +159,7 @@ Status Nemo::HSetNoLock(const std::string &key, const std::string &field, const
 }
 
 Status Nemo::HGet(const rocksdb::Slice &key, const rocksdb::Slice &field, std::string *val) {
+    MetricsScope metrics(metrics_, kCmdHGet, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -167,6 +170,7 @@ Status Nemo::HGet(const rocksdb::Slice &key, const rocksdb::Slice &field, std::s
 }
 
 Status Nemo::HDel(const rocksdb::Slice &key, const rocksdb::Slice &field) {
+    MetricsScope metrics(metrics_, kCmdHDel, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -243,6 +247,7 @@ Status Nemo::HDelKey(const std::string &key, int64_t *res) {
         meta.vol = 0;
         meta.EncodeTo(val);
         s = hash_db_->PutWithKeyVersion(rocksdb::WriteOptions(), size_key, val);
+        metrics_->profiler()->Meta(kHASH_DB, key, 0, 0);
       }
     }
 
@@ -274,7 +279,10 @@ Status Nemo::HExpire(const std::string &key, const int32_t seconds, int64_t *res
       meta.EncodeTo(val);
       if (seconds > 0) {
         //MutexLock l(&mutex_hash_);
-        s = hash_db_->Put(w_opts_nolog(), size_key, val, seconds);
+        s = expire_sweeper_->Index(DataType::kHSize, key, std::time(0) + seconds);
+        if (s.ok()) {
+          s = hash_db_->Put(w_opts_nolog(), size_key, val, seconds);
+        }
       } else { 
         int64_t count;
         s = HDelKey(key, &count);
@@ -305,6 +313,7 @@ Status Nemo::HTTL(const std::string &key, int64_t *res) {
 }
 
 Status Nemo::HExists(const std::string &key, const std::string &field, bool * ifExist) {
+    MetricsScope metrics(metrics_, kCmdHExists, key);
     Status s;
     std::string dbkey = EncodeHashKey(key, field);
     std::string val;
@@ -371,7 +380,10 @@ Status Nemo::HExpireat(const std::string &key, const int32_t timestamp, int64_t
         int64_t count;
         s = HDelKey(key, &count);
       } else {
-        s = hash_db_->PutWithExpiredTime(w_opts_nolog(), size_key, val, timestamp);
+        s = expire_sweeper_->Index(DataType::kHSize, key, timestamp);
+        if (s.ok()) {
+          s = hash_db_->PutWithExpiredTime(w_opts_nolog(), size_key, val, timestamp);
+        }
       }
       *res = 1;
     }
@@ -379,33 +391,16 @@ Status Nemo::HExpireat(const std::string &key, const int32_t timestamp, int64_t
 }
 
 Status Nemo::HKeys(const std::string &key, std::vector<std::string> &fields) {
-    std::string dbkey;
-    std::string dbfield;
-    std::string key_start = EncodeHashKey(key, "");
-    rocksdb::Iterator *it;
-    rocksdb::ReadOptions iterate_options;
-    iterate_options.snapshot = hash_db_->GetSnapshot();
-    iterate_options.fill_cache = false;
-    it = hash_db_->NewIterator(iterate_options);
-    it->Seek(key_start);
-    while (it->Valid()) {
-       if ((it->key())[0] != DataType::kHash) {
-           break;
-       }
-       DecodeHashKey(it->key(), &dbkey, &dbfield);
-       if (dbkey == key) {
-           fields.push_back(dbfield);
-       } else {
-           break;
-       }
-       it->Next();
+    HIterator *iter = HScan(key, "", "", -1, true);
+    for (; iter->Valid(); iter->Next()) {
+        fields.push_back(iter->field().ToString());
     }
-    hash_db_->ReleaseSnapshot(iterate_options.snapshot);
-    delete it;
+    delete iter;
     return Status::OK();
 }
 
 Status Nemo::HLen(const rocksdb::Slice &key,int64_t * len) {
+    MetricsScope metrics(metrics_, kCmdHLen, key);
     HashMeta meta;
     if(HSize(key,meta)){
         *len = meta.len;
@@ -418,37 +413,21 @@ Status Nemo::HLen(const rocksdb::Slice &key,int64_t * len) {
 }
 
 Status Nemo::HGetall(const std::string &key, std::vector<FV> &fvs) {
+    MetricsScope metrics(metrics_, kCmdHGetall, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
 
-    std::string dbkey;
-    std::string dbfield;
-    std::string key_start = EncodeHashKey(key, "");
-    rocksdb::Iterator *it;
-    rocksdb::ReadOptions iterate_options;
-    iterate_options.snapshot = hash_db_->GetSnapshot();
-    iterate_options.fill_cache = false;
-    it = hash_db_->NewIterator(iterate_options);
-    it->Seek(key_start);
-    while (it->Valid()) {
-       if ((it->key())[0] != DataType::kHash) {
-           break;
-       }
-       DecodeHashKey(it->key(), &dbkey, &dbfield);
-       if(dbkey == key) {
-           fvs.push_back(FV{dbfield, it->value().ToString()});
-       } else {
-           break;
-       }
-       it->Next();
+    HIterator *iter = HScan(key, "", "", -1, true);
+    for (; iter->Valid(); iter->Next()) {
+        fvs.push_back(FV{iter->field().ToString(), iter->value().ToString()});
     }
-    hash_db_->ReleaseSnapshot(iterate_options.snapshot);
-    delete it;
+    delete iter;
     return Status::OK();
 }
 
 Status Nemo::HMSet(const std::string &key, const std::vector<FV> &fvs,int * res_list ) {
+    MetricsScope metrics(metrics_, kCmdHMSet, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -516,33 +495,44 @@ Status Nemo::HMSetSlice(const rocksdb::Slice &key, const std::vector<FVSlice> &f
 
     meta.EncodeTo(new_meta_val);
     writebatch.Put(size_key, new_meta_val);
+    metrics_->profiler()->Meta(kHASH_DB, key, meta.len, meta.vol);
     s = hash_db_->WriteWithOldKeyTTL(w_opts_nolog(), &(writebatch));
     return s;
 }
 
 Status Nemo::HMGet(const std::string &key, const std::vector<std::string> &fields, std::vector<FVS> &fvss) {
-    Status s;
-    std::vector<std::string>::const_iterator it_key;
-    for (it_key = fields.begin(); it_key != fields.end(); it_key++) {
-        std::string en_key = EncodeHashKey(key, *(it_key));
-        std::string val("");
-        s = hash_db_->Get(rocksdb::ReadOptions(), en_key, &val);
-        fvss.push_back((FVS){*(it_key), val, s});
+    MetricsScope metrics(metrics_, kCmdHMGet, key);
+    std::vector<rocksdb::Slice> field_slices(fields.begin(), fields.end());
+    rocksdb::NemoBatchGetResult result;
+    HMGetBatch(key, field_slices, &result);
+    for (size_t i = 0; i < fields.size(); i++) {
+        fvss.push_back((FVS){fields[i], result.values[i].ToString(), result.statuses[i]});
     }
     return Status::OK();
 }
 
 Status Nemo::HMGetSlice(const rocksdb::Slice &key, const std::vector<rocksdb::Slice> &fields, std::vector<SS> &ss) {
-    Status s;
+    rocksdb::NemoBatchGetResult result;
+    HMGetBatch(key, fields, &result);
     for (size_t i = 0; i < fields.size(); i++) {
-        std::string en_key = EncodeHashKey(key, fields[i]);
-        std::string * val = new std::string;
-        s = hash_db_->Get(rocksdb::ReadOptions(), en_key, val);
-        ss[i] = SS{val,s};
+        std::string * val = new std::string(result.values[i].data(), result.values[i].size());
+        ss[i] = SS{val, result.statuses[i]};
     }
     return Status::OK();
 }
 
+// The fields share one read of the hash meta in BatchGet
+Status Nemo::HMGetBatch(const rocksdb::Slice &key, const std::vector<rocksdb::Slice> &fields, rocksdb::NemoBatchGetResult *result) {
+    std::vector<std::string> en_keys;
+    en_keys.reserve(fields.size());
+    for (size_t i = 0; i < fields.size(); i++) {
+        en_keys.push_back(EncodeHashKey(key, fields[i]));
+    }
+    std::vector<rocksdb::Slice> key_slices(en_keys.begin(), en_keys.end());
+    hash_db_->BatchGet(rocksdb::ReadOptions(), key_slices, result);
+    return Status::OK();
+}
+
 HIterator* Nemo::HScan(const std::string &key, const std::string &start, const std::string &end, uint64_t limit, bool use_snapshot) {
     std::string key_start, key_end;
     key_start = EncodeHashKey(key, start);
@@ -561,9 +551,7 @@ HIterator* Nemo::HScan(const std::string &key, const std::string &start, const s
 
     IteratorOptions iter_options(key_end, limit, read_options);
     
-    rocksdb::Iterator *it = hash_db_->NewIterator(read_options);
-    it->Seek(key_start);
-    return new HIterator(it,hash_db_.get() ,iter_options, key); 
+    return new HIterator(hash_db_.get(), iter_options, key, key_start); 
 }
 
 HmetaIterator * Nemo::HmetaScan( const std::string &start, const std::string &end, uint64_t limit, bool use_snapshot, bool skip_nil_index){
@@ -583,9 +571,7 @@ HmetaIterator * Nemo::HmetaScan( const std::string &start, const std::string &en
 
     IteratorOptions iter_options(key_end, limit, read_options);
     
-    rocksdb::Iterator *it = hash_db_->NewIterator(read_options);
-    it->Seek(key_start);
-    return new HmetaIterator(it, hash_db_.get() ,iter_options,start,skip_nil_index); 
+    return new HmetaIterator(hash_db_.get(), iter_options, key_start, skip_nil_index); 
 }
 
 Status Nemo::HSetnx(const std::string &key, const std::string &field, const std::string &val, int64_t * res) {
@@ -634,33 +620,16 @@ Status Nemo::HVals(const std::string &key, std::vector<std::string> &vals) {
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
-    std::string dbkey;
-    std::string dbfield;
-    std::string key_start = EncodeHashKey(key, "");
-    rocksdb::Iterator *it;
-    rocksdb::ReadOptions iterate_options;
-    iterate_options.snapshot = hash_db_->GetSnapshot();
-    iterate_options.fill_cache = false;
-    it = hash_db_->NewIterator(iterate_options);
-    it->Seek(key_start);
-    while (it->Valid()) {
-       if ((it->key())[0] != DataType::kHash) {
-           break;
-       }
-       DecodeHashKey(it->key(), &dbkey, &dbfield);
-       if (dbkey == key) {
-           vals.push_back(it->value().ToString());
-       } else {
-           break;
-       }
-       it->Next();
+    HIterator *iter = HScan(key, "", "", -1, true);
+    for (; iter->Valid(); iter->Next()) {
+        vals.push_back(iter->value().ToString());
     }
-    hash_db_->ReleaseSnapshot(iterate_options.snapshot);
-    delete it;
+    delete iter;
     return Status::OK();
 }
 
 Status Nemo::HIncrby(const std::string &key, const std::string &field, int64_t by, std::string &new_val) {
+    MetricsScope metrics(metrics_, kCmdHIncrby, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -841,6 +810,7 @@ int Nemo::IncrHSize(const rocksdb::Slice &key, int64_t incrlen ,int64_t incrvol,
     std::string meta_val;
     meta.EncodeTo(meta_val);
     writebatch.Put(size_key, meta_val);
+    metrics_->profiler()->Meta(kHASH_DB, key, meta.len, meta.vol);
     return 0;
 }
 
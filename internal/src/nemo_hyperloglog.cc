@@ -1,110 +1,262 @@
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "nemo_hyperloglog.h"
 #include "nemo_list.h"
 #include "nemo_mutex.h"
 #include "nemo_murmur3.h"
+#include "nemo_write_group.h"
 
 using namespace nemo;
 
 #define HLL_HASH_SEED 313
 
-HyperLogLog::HyperLogLog(uint8_t precision, std::string origin_register) {
-  b_ = precision;
-  m_ = 1 << precision;
-  alpha_ = Alpha();
-  register_ = new char[m_];
-  for (uint32_t i = 0; i < m_; ++i)
-    register_[i] = 0;
-  if (origin_register != "") {
-    for (uint32_t i = 0; i < m_; ++i) {
-      register_[i] = origin_register[i];
+static const char kHllMagic[] = "HYLL";
+
+// dst[i] = max(dst[i], src[i]) for n bytes, n a multiple of 16
+static inline void MaxRegisters(uint8_t *dst, const uint8_t *src, size_t n) {
+#if defined(__SSE2__)
+  for (size_t i = 0; i < n; i += 16) {
+    __m128i a = _mm_loadu_si128((const __m128i *)(dst + i));
+    __m128i b = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_max_epu8(a, b));
+  }
+#else
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = std::max(dst[i], src[i]);
+  }
+#endif
+}
+
+// 4 dense registers out of 3 bytes
+static inline void Unpack4(const uint8_t *p, uint8_t *regs) {
+  regs[0] = p[0] & 63;
+  regs[1] = ((p[0] >> 6) | (p[1] << 2)) & 63;
+  regs[2] = ((p[1] >> 4) | (p[2] << 4)) & 63;
+  regs[3] = p[2] >> 2;
+}
+
+HyperLogLog::HyperLogLog() {
+  Reset(kSparse, kMurmur64);
+}
+
+void HyperLogLog::Reset(Encoding encoding, Hash hash) {
+  value_.assign(kHllMagic, 4);
+  value_.append(1, (char)encoding);
+  value_.append(1, (char)hash);
+  value_.append(2, 0);
+  if (encoding == kDense) {
+    value_.append(HLL_DENSE_SIZE - HLL_HEADER_SIZE, 0);
+  }
+}
+
+bool HyperLogLog::Decode(const std::string &value) {
+  if (value.empty()) {
+    // PfAdd of no element used to store an empty value
+    Reset(kSparse, kMurmur64);
+    return true;
+  }
+  if (value.size() == HLL_REGISTERS) {
+    // one byte per register, as written before the header existed
+    Reset(kSparse, kLegacyMurmur32);
+    for (uint32_t i = 0; i < HLL_REGISTERS; i++) {
+      uint8_t rank = (uint8_t)value[i];
+      if (rank > 63) {
+        return false;
+      }
+      if (rank != 0) {
+        Set(i, rank);
+      }
     }
+    return true;
+  }
+  if (value.size() < HLL_HEADER_SIZE || value.compare(0, 4, kHllMagic) != 0
+      || (uint8_t)value[5] > kLegacyMurmur32) {
+    return false;
   }
+  if ((value[4] == kDense && value.size() == HLL_DENSE_SIZE)
+      || (value[4] == kSparse && (value.size() - HLL_HEADER_SIZE) % 4 == 0)) {
+    value_ = value;
+    return true;
+  }
+  return false;
 }
 
-HyperLogLog::~HyperLogLog() {
-  delete [] register_;
+uint32_t HyperLogLog::SparseEntry(uint32_t i) const {
+  uint32_t entry;
+  memcpy(&entry, value_.data() + HLL_HEADER_SIZE + i * 4, 4);
+  return entry;
 }
 
-std::string HyperLogLog::Add(const char * str, uint32_t len) {
-  uint32_t hash;
-  MurmurHash3_x86_32(str, len, HLL_HASH_SEED, (void*) &hash);
-  int index = hash & ((1 << b_) - 1);
-  uint8_t rank = Nclz((hash << b_), 32 - b_);
-  if (rank > register_[index])
-    register_[index] = rank;
-  std::string result_str(m_, 0);
-  for (uint32_t i = 0; i < m_; ++i) {
-    result_str[i] = register_[i];
+// Position of the first entry not below index
+uint32_t HyperLogLog::SparseFind(uint32_t index) const {
+  uint32_t lo = 0, hi = SparseCount();
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if ((SparseEntry(mid) >> 6) < index) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
   }
-  return result_str;
+  return lo;
 }
 
-double HyperLogLog::Estimate() const {
-  double estimate = FirstEstimate();
-    
-  if (estimate <= 2.5* m_) {
-    uint32_t zeros = CountZero();
-    if (zeros != 0) {
-      estimate = m_ * log((double)m_ / zeros);
-    }
-  } else if (estimate > pow(2, 32) / 30.0) {
-    estimate = log1p(estimate * -1 / pow(2, 32)) * pow(2, 32) * -1;
+bool HyperLogLog::Set(uint32_t index, uint8_t rank) {
+  if (encoding() == kDense) {
+    uint8_t *p = (uint8_t *)&value_[HLL_HEADER_SIZE];
+    size_t byte = index * 6 / 8;
+    int fb = index * 6 % 8;
+    uint8_t cur = ((p[byte] >> fb) | (p[byte + 1] << (8 - fb))) & 63;
+    if (rank <= cur) {
+      return false;
+    }
+    p[byte] = (p[byte] & ~(63 << fb)) | (rank << fb);
+    p[byte + 1] = (p[byte + 1] & ~(63 >> (8 - fb))) | (rank >> (8 - fb));
+    return true;
   }
-  return estimate;
+
+  uint32_t pos = SparseFind(index);
+  uint32_t entry = index << 6 | rank;
+  if (pos < SparseCount() && (SparseEntry(pos) >> 6) == index) {
+    if (rank <= (SparseEntry(pos) & 63)) {
+      return false;
+    }
+    memcpy(&value_[HLL_HEADER_SIZE + pos * 4], &entry, 4);
+    return true;
+  }
+  if (SparseCount() >= HLL_SPARSE_MAX_REGISTERS) {
+    ToDense();
+    return Set(index, rank);
+  }
+  value_.insert(HLL_HEADER_SIZE + pos * 4, (const char *)&entry, 4);
+  return true;
 }
 
-double HyperLogLog::FirstEstimate() const {
-  double estimate, sum = 0.0;
-  for (uint32_t i = 0; i < m_; i++)
-    sum += 1.0 / (1 << register_[i]);
-    
-  estimate = alpha_ * m_ * m_ / sum;
-  return estimate;
+void HyperLogLog::ToDense() {
+  std::string sparse;
+  sparse.swap(value_);
+  Reset(kDense, (Hash)sparse[5]);
+  for (size_t off = HLL_HEADER_SIZE; off < sparse.size(); off += 4) {
+    uint32_t entry;
+    memcpy(&entry, sparse.data() + off, 4);
+    Set(entry >> 6, entry & 63);
+  }
+}
+
+bool HyperLogLog::Add(const char *str, uint32_t len) {
+  uint32_t index;
+  uint8_t rank;
+  if (hash() == kLegacyMurmur32) {
+    uint32_t hash;
+    MurmurHash3_x86_32(str, len, HLL_HASH_SEED, (void *)&hash);
+    index = hash & (HLL_REGISTERS - 1);
+    uint32_t x = hash << HLL_PRECISION;
+    rank = (uint8_t)(x == 0 ? 32 - HLL_PRECISION : std::min(32 - HLL_PRECISION, ::__builtin_clz(x))) + 1;
+  } else {
+    // the bit above the hash ends the run of zeros, rank is at most 48
+    uint64_t hash = MurmurHash64A(str, len, HLL_HASH_SEED);
+    index = hash & (HLL_REGISTERS - 1);
+    uint64_t x = (hash >> HLL_PRECISION) | (1ULL << (64 - HLL_PRECISION));
+    rank = (uint8_t)::__builtin_ctzll(x) + 1;
+  }
+  return Set(index, rank);
 }
 
-double HyperLogLog::Alpha() const {
-  switch (m_) {
-    case 16:
-      return 0.673;
-    case 32:
-      return 0.697;
-    case 64:
-      return 0.709;
-    default:
-      return 0.7213/(1 + 1.079 / m_);
+void HyperLogLog::MaxInto(uint8_t *regs) const {
+  if (encoding() == kSparse) {
+    for (uint32_t i = 0; i < SparseCount(); i++) {
+      uint32_t entry = SparseEntry(i);
+      regs[entry >> 6] = std::max(regs[entry >> 6], (uint8_t)(entry & 63));
+    }
+    return;
+  }
+  // 64 registers from 48 bytes at a time, then a vector max
+  const uint8_t *p = (const uint8_t *)value_.data() + HLL_HEADER_SIZE;
+  uint8_t block[64];
+  for (uint32_t i = 0; i < HLL_REGISTERS; i += 64, p += 48) {
+    for (int j = 0; j < 16; j++) {
+      Unpack4(p + j * 3, block + j * 4);
     }
+    MaxRegisters(regs + i, block, 64);
+  }
 }
 
-int HyperLogLog::CountZero() const {
-  int count = 0;
-  for(uint32_t i = 0;i < m_; i++) {
-    if (register_[i] == 0) {
-      count++;
+void HyperLogLog::Assign(const uint8_t *regs) {
+  Hash h = hash();
+  uint32_t used = 0;
+  for (uint32_t i = 0; i < HLL_REGISTERS; i++) {
+    used += regs[i] != 0;
+  }
+  if (used <= HLL_SPARSE_MAX_REGISTERS) {
+    Reset(kSparse, h);
+    value_.reserve(HLL_HEADER_SIZE + used * 4);
+    for (uint32_t i = 0; i < HLL_REGISTERS; i++) {
+      if (regs[i] != 0) {
+        uint32_t entry = i << 6 | regs[i];
+        value_.append((const char *)&entry, 4);
+      }
     }
+    return;
+  }
+  Reset(kDense, h);
+  uint8_t *p = (uint8_t *)&value_[HLL_HEADER_SIZE];
+  for (uint32_t i = 0; i < HLL_REGISTERS; i += 4, p += 3) {
+    p[0] = regs[i] | (regs[i + 1] << 6);
+    p[1] = (regs[i + 1] >> 2) | (regs[i + 2] << 4);
+    p[2] = (regs[i + 2] >> 4) | (regs[i + 3] << 2);
   }
-  return count;
 }
 
-std::string HyperLogLog::Merge(const HyperLogLog & hll) {
-  if (m_ != hll.m_) {
-    // TODO: ERROR "number of registers doesn't match"
+double HyperLogLog::EstimateHistogram(const uint32_t *histogram, Hash hash) {
+  const double m = HLL_REGISTERS;
+  const double alpha = 0.7213 / (1 + 1.079 / m);
+  double sum = 0.0;
+  for (int v = 63; v >= 0; v--) {
+    sum += histogram[v] / (double)(1ULL << v);
   }
-  for (uint32_t r = 0; r < m_; r++) {
-    if (register_[r] < hll.register_[r]) {
-      register_[r] |= hll.register_[r];
+  double estimate = alpha * m * m / sum;
+
+  if (estimate <= 2.5 * m) {
+    if (histogram[0] != 0) {
+      estimate = m * log(m / histogram[0]);
     }
+  } else if (hash == kLegacyMurmur32 && estimate > pow(2, 32) / 30.0) {
+    // a 32 bit hash collides near its range
+    estimate = log1p(estimate * -1 / pow(2, 32)) * pow(2, 32) * -1;
   }
-    
-  std::string result_str(m_, 0);
-  for (uint32_t i = 0; i < m_; ++i) {
-    result_str[i] = register_[i];
+  return estimate;
+}
+
+double HyperLogLog::Estimate(const uint8_t *regs, Hash hash) {
+  uint32_t histogram[64] = {0};
+  for (uint32_t i = 0; i < HLL_REGISTERS; i++) {
+    histogram[regs[i]]++;
   }
-  return result_str;
+  return EstimateHistogram(histogram, hash);
 }
 
-//::__builtin_clz(x): 返回左起第一个‘1’之前0的个数
-uint8_t HyperLogLog::Nclz(uint32_t x, int b) {
-  return (uint8_t)std::min(b, ::__builtin_clz(x)) + 1;
+double HyperLogLog::Estimate() const {
+  uint32_t histogram[64] = {0};
+  if (encoding() == kSparse) {
+    histogram[0] = HLL_REGISTERS - SparseCount();
+    for (uint32_t i = 0; i < SparseCount(); i++) {
+      histogram[SparseEntry(i) & 63]++;
+    }
+  } else {
+    const uint8_t *p = (const uint8_t *)value_.data() + HLL_HEADER_SIZE;
+    uint8_t regs[4];
+    for (uint32_t i = 0; i < HLL_REGISTERS; i += 4, p += 3) {
+      Unpack4(p, regs);
+      histogram[regs[0]]++;
+      histogram[regs[1]]++;
+      histogram[regs[2]]++;
+      histogram[regs[3]]++;
+    }
+  }
+  return EstimateHistogram(histogram, hash());
 }
 
 Status Nemo::PfAdd(const std::string &key, const std::vector<std::string> &values, bool & update) {
@@ -113,55 +265,74 @@ Status Nemo::PfAdd(const std::string &key, const std::vector<std::string> &value
   }
 
   Status s;
-  std::string val, str_register = "", result = "";
-  s = Get(key, &val);
-  if (s.ok()) {
-    str_register = val;
-  } else if (s.IsNotFound()) {
-    str_register = "";
-  }
-  HyperLogLog log(17, str_register);
-  int previous = int(log.Estimate());
+  std::string val;
+  HyperLogLog log;
+  update = false;
+  RecordLock l(&mutex_kv_record_, key);
+  kv_group_->Drain();
+
+  s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
+  if (s.IsNotFound()) {
+    update = true;
+  } else if (!s.ok()) {
+    return s;
+  } else if (!log.Decode(val)) {
+    return Status::Corruption("value is not a valid HyperLogLog");
+  }
   for (unsigned int i = 0; i < values.size(); ++i) {
-    result = log.Add(values[i].data(), values[i].size());
+    if (log.Add(values[i].data(), values[i].size())) {
+      update = true;
+    }
   }
-  HyperLogLog update_log(17, result);
-  int now= int(update_log.Estimate());
-  if (previous != now || (s.IsNotFound() && values.size()==0)) {
-    update = true;
+  if (!update) {
+    return Status::OK();
   }
-  s = kv_db_->Put(w_opts_nolog(), key, result);
-  return s;
+  return kv_db_->Put(w_opts_nolog(), key, log.Encoded());
 }
-   
+
 Status Nemo::PfCount(const std::vector<std::string> &keys, int & result) {
   if (keys.size() >= KEY_MAX_LENGTH || keys.size() <= 0) {
     return Status::InvalidArgument("Invalid key length");
   }
 
-  Status s, ok;
-  std::string value, str_register;
-  s = Get(keys[0], &value);
-  if (s.ok()) {
-    str_register = std::string(value.data(), value.size());
-  } else if (s.IsNotFound()) {
-    str_register = "";
-  }
-	
-  HyperLogLog first_log(17, str_register);
-  for (unsigned int i = 1; i < keys.size(); ++i) {
-    std::string value, str_register;
-    s = Get(keys[i], &value);
-    if (s.ok()) {
-      str_register = value;
-    } else if (s.IsNotFound()) {
+  Status s;
+  std::string value;
+  HyperLogLog log;
+  result = 0;
+  if (keys.size() == 1) {
+    s = kv_db_->Get(rocksdb::ReadOptions(), keys[0], &value);
+    if (s.IsNotFound()) {
+      return Status::OK();
+    } else if (!s.ok()) {
+      return s;
+    } else if (!log.Decode(value)) {
+      return Status::Corruption("value is not a valid HyperLogLog");
+    }
+    result = int(log.Estimate());
+    return Status::OK();
+  }
+
+  // the union of the registers, estimated with the hash of the first key
+  std::vector<uint8_t> regs(HLL_REGISTERS, 0);
+  bool found = false;
+  HyperLogLog::Hash hash = HyperLogLog::kMurmur64;
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    s = kv_db_->Get(rocksdb::ReadOptions(), keys[i], &value);
+    if (s.IsNotFound()) {
       continue;
+    } else if (!s.ok()) {
+      return s;
+    } else if (!log.Decode(value)) {
+      return Status::Corruption("value is not a valid HyperLogLog");
+    }
+    if (!found) {
+      hash = log.hash();
+      found = true;
     }
-    HyperLogLog log(17, str_register);
-    first_log.Merge(log);
+    log.MaxInto(&regs[0]);
   }
-  result = int(first_log.Estimate());
-  return ok;
+  result = int(HyperLogLog::Estimate(&regs[0], hash));
+  return Status::OK();
 }
 
 Status Nemo::PfMerge(const std::vector<std::string> &keys) {
@@ -170,28 +341,26 @@ Status Nemo::PfMerge(const std::vector<std::string> &keys) {
   }
 
   Status s;
-  std::string value, str_register, result;
-  s = Get(keys[0], &value);
-  if (s.ok()) {
-    str_register = std::string(value.data(), value.size());
-  } else if (s.IsNotFound()) {
-    str_register = "";
-  }
-
-  result = str_register;
-  HyperLogLog first_log(17, str_register);
-  for (unsigned int i = 1; i < keys.size(); ++i) {
-    std::string value, str_register;
-    s = Get(keys[i], &value);
-    if (s.ok()) {
-      str_register = std::string(value.data(), value.size());
-    } else if (s.IsNotFound()) {
+  std::string value;
+  HyperLogLog log, merged;
+  std::vector<uint8_t> regs(HLL_REGISTERS, 0);
+  RecordLock l(&mutex_kv_record_, keys[0]);
+  kv_group_->Drain();
+
+  // keys[0] is a source too, and keeps its hash
+  for (unsigned int i = 0; i < keys.size(); ++i) {
+    s = kv_db_->Get(rocksdb::ReadOptions(), keys[i], &value);
+    if (s.IsNotFound()) {
       continue;
+    } else if (!s.ok()) {
+      return s;
+    }
+    HyperLogLog &source = i == 0 ? merged : log;
+    if (!source.Decode(value)) {
+      return Status::Corruption("value is not a valid HyperLogLog");
     }
-    HyperLogLog log(17, str_register);
-    result = first_log.Merge(log); 
+    source.MaxInto(&regs[0]);
   }
-  s = kv_db_->Put(w_opts_nolog(), keys[0], result);
-  return s;
+  merged.Assign(&regs[0]);
+  return kv_db_->Put(w_opts_nolog(), keys[0], merged.Encoded());
 }
-
@@ -13,25 +13,59 @@
 
 namespace nemo {
 
-struct HyperLogLog {
+// A stored HLL is
+//
+//   | "HYLL" | encoding | hash | 2 reserved | registers |
+//
+// with 2^HLL_PRECISION registers, either sparse, as the sorted 4 bytes
+// little endian (index << 6 | value) of the non zero registers, or dense,
+// 6 bits per register packed from the low bits of each byte. Values written
+// before the header existed are one byte per register, 32 bit hashed; they
+// are read as they are and keep their hash once rewritten.
+const int HLL_PRECISION = 17;
+const uint32_t HLL_REGISTERS = 1 << HLL_PRECISION;
+const size_t HLL_HEADER_SIZE = 8;
+// one padding byte lets every register be read from two bytes
+const size_t HLL_DENSE_SIZE = HLL_HEADER_SIZE + (HLL_REGISTERS * 6 + 7) / 8 + 1;
+// Sparse HLLs turn dense past this many registers, 1/8 of the dense size
+const size_t HLL_SPARSE_MAX_REGISTERS = 3072;
+
+class HyperLogLog {
  public:
-  HyperLogLog(uint8_t precision, std::string origin_register);
-  ~HyperLogLog();
-    
+  enum Encoding { kDense = 0, kSparse = 1 };
+  enum Hash { kMurmur64 = 0, kLegacyMurmur32 = 1 };
+
+  // An empty sparse HLL
+  HyperLogLog();
+
+  // Load a stored value, false if it is no HLL
+  bool Decode(const std::string &value);
+  // The value to store, which is kept encoded so that adding is in place
+  const std::string& Encoded() const { return value_; }
+
+  // true if a register grew
+  bool Add(const char *str, uint32_t len);
+  // Raise each of regs, HLL_REGISTERS bytes, to the matching register
+  void MaxInto(uint8_t *regs) const;
+  // Take the registers of regs, keeping the hash of this HLL
+  void Assign(const uint8_t *regs);
+  Hash hash() const { return (Hash)value_[5]; }
+
+  static double Estimate(const uint8_t *regs, Hash hash);
   double Estimate() const;
-  double FirstEstimate() const;
-  int CountZero() const;
-  double Alpha() const;
-  uint8_t Nclz(uint32_t x, int b);
-    
-  std::string Add(const char * str, uint32_t len);
-  std::string Merge(const HyperLogLog & hll);
-    
- protected:
-  uint32_t m_;                    // register bit width
-  uint8_t b_;                     // register size
-  double alpha_;
-  char * register_;               // registers
+
+ private:
+  static double EstimateHistogram(const uint32_t *histogram, Hash hash);
+
+  std::string value_;
+
+  Encoding encoding() const { return (Encoding)value_[4]; }
+  uint32_t SparseCount() const { return (value_.size() - HLL_HEADER_SIZE) / 4; }
+  uint32_t SparseEntry(uint32_t i) const;
+  uint32_t SparseFind(uint32_t index) const;
+  bool Set(uint32_t index, uint8_t rank);
+  void ToDense();
+  void Reset(Encoding encoding, Hash hash);
 };
 
 }
@@ -1,18 +1,58 @@
 #include "nemo_iterator.h"
 
+#include <cstring>
 #include <iostream>
 #include "nemo_set.h"
 #include "nemo_hash.h"
 #include "nemo_zset.h"
+#include "util.h"
 #include "xdebug.h"
 
-nemo::Iterator::Iterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions& iter_options)
-  : it_(it),
-    db_nemo_(db_nemo),
+namespace {
+
+// The exclusive upper and the inclusive lower bound of the keys of the
+// range, empty for none
+void RangeBounds(const nemo::IteratorOptions &ioptions, bool closed_end,
+                 const rocksdb::Slice &prefix, std::string *upper, std::string *lower) {
+  *upper = nemo::PrefixSuccessor(prefix.ToString());
+  lower->assign(prefix.data(), prefix.size());
+  if (ioptions.end.empty()) {
+    return;
+  }
+  if (ioptions.direction == nemo::kForward) {
+    std::string end = ioptions.end;
+    if (closed_end) {
+      end.push_back('\0');
+    }
+    if (upper->empty() || end < *upper) {
+      upper->swap(end);
+    }
+  } else if (ioptions.end > *lower) {
+    *lower = ioptions.end;
+  }
+}
+
+}
+
+nemo::Iterator::Iterator(rocksdb::DBNemo *db_nemo, const IteratorOptions& iter_options,
+                         const rocksdb::Slice &target, const rocksdb::Slice &prefix)
+  : db_nemo_(db_nemo),
     ioptions_(iter_options) {
+      RangeBounds(ioptions_, true, prefix, &upper_bound_, &lower_bound_);
+      if (!upper_bound_.empty()) {
+        upper_bound_slice_ = upper_bound_;
+        ioptions_.read_options.iterate_upper_bound = &upper_bound_slice_;
+      }
+      it_ = db_nemo_->NewIterator(ioptions_.read_options);
+      if (ioptions_.direction == kForward) {
+        it_->Seek(target);
+      } else {
+        it_->SeekForPrev(target);
+      }
       Check();
     }
 
+// rocksdb stops forward iterators at upper_bound_
 bool nemo::Iterator::Check() {
   valid_ = false;
   if (ioptions_.limit == 0 || !it_->Valid()) {
@@ -20,13 +60,8 @@ bool nemo::Iterator::Check() {
     ioptions_.limit = 0;
     return false;
   } else {
-    if (ioptions_.direction == kForward) {
-      if (!ioptions_.end.empty() && it_->key().compare(ioptions_.end) > 0) {
-        ioptions_.limit = 0;
-        return false;
-      }
-    } else {
-      if(!ioptions_.end.empty() && it_->key().compare(ioptions_.end) < 0) {
+    if (ioptions_.direction == kBackward) {
+      if(!lower_bound_.empty() && it_->key().compare(lower_bound_) < 0) {
         ioptions_.limit = 0;
         return false;
       }
@@ -38,20 +73,20 @@ bool nemo::Iterator::Check() {
 }
 
 rocksdb::Slice nemo::Iterator::key() {
-  return it_->key();
+  return valid_ ? it_->key() : rocksdb::Slice();
 }
 
 rocksdb::Slice nemo::Iterator::value() {
-  return it_->value();
+  return valid_ ? it_->value() : rocksdb::Slice();
 }
 
 bool nemo::Iterator::Valid() {
   return valid_;
 }
 
-//  non-positive offset don't skip at all
+//  non-positive offset don't skip at all, the entries skipped are not decoded
 void nemo::Iterator::Skip(int64_t offset) {
-  if (offset > 0) {
+  if (offset > 0 && valid_) {
     while (offset-- > 0) {
       if (ioptions_.direction == kForward){
         it_->Next();
@@ -79,10 +114,21 @@ void nemo::Iterator::Next() {
 }
 
 // Iterator endpoint: Right Open
-nemo::IteratorRO::IteratorRO(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions& iter_options)
-  : it_(it),
-    db_nemo_(db_nemo),
+nemo::IteratorRO::IteratorRO(rocksdb::DBNemo *db_nemo, const IteratorOptions& iter_options,
+                             const rocksdb::Slice &target, const rocksdb::Slice &prefix)
+  : db_nemo_(db_nemo),
     ioptions_(iter_options) {
+      RangeBounds(ioptions_, false, prefix, &upper_bound_, &lower_bound_);
+      if (!upper_bound_.empty()) {
+        upper_bound_slice_ = upper_bound_;
+        ioptions_.read_options.iterate_upper_bound = &upper_bound_slice_;
+      }
+      it_ = db_nemo_->NewIterator(ioptions_.read_options);
+      if (ioptions_.direction == kForward) {
+        it_->Seek(target);
+      } else {
+        it_->SeekForPrev(target);
+      }
       Check();
     }
 
@@ -93,13 +139,8 @@ bool nemo::IteratorRO::Check() {
     ioptions_.limit = 0;
     return false;
   } else {
-    if (ioptions_.direction == kForward) {
-      if (!ioptions_.end.empty() && it_->key().compare(ioptions_.end) >= 0) {
-        ioptions_.limit = 0;
-        return false;
-      }
-    } else {
-      if(!ioptions_.end.empty() && it_->key().compare(ioptions_.end) < 0) {
+    if (ioptions_.direction == kBackward) {
+      if(!lower_bound_.empty() && it_->key().compare(lower_bound_) < 0) {
         ioptions_.limit = 0;
         return false;
       }
@@ -111,20 +152,20 @@ bool nemo::IteratorRO::Check() {
 }
 
 rocksdb::Slice nemo::IteratorRO::key() {
-  return it_->key();
+  return valid_ ? it_->key() : rocksdb::Slice();
 }
 
 rocksdb::Slice nemo::IteratorRO::value() {
-  return it_->value();
+  return valid_ ? it_->value() : rocksdb::Slice();
 }
 
 bool nemo::IteratorRO::Valid() {
   return valid_;
 }
 
-//  non-positive offset don't skip at all
+//  non-positive offset don't skip at all, the entries skipped are not decoded
 void nemo::IteratorRO::Skip(int64_t offset) {
-  if (offset > 0) {
+  if (offset > 0 && valid_) {
     while (offset-- > 0) {
       if (ioptions_.direction == kForward){
         it_->Next();
@@ -152,19 +193,9 @@ void nemo::IteratorRO::Next() {
 }
 
 // KV
-nemo::KIterator::KIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options)
-  : Iterator(it, db_nemo, iter_options) {
-  CheckAndLoadData();
-  }
-
-void nemo::KIterator::CheckAndLoadData() {
-  if (valid_) {
-    rocksdb::Slice ks = Iterator::key();
-    rocksdb::Slice vs = Iterator::value();
-    this->key_.assign(ks.data(), ks.size());
-    this->value_.assign(vs.data(), vs.size());
+nemo::KIterator::KIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target)
+  : Iterator(db_nemo, iter_options, target) {
   }
-}
 
 bool nemo::KIterator::Valid() {
   return valid_;
@@ -172,17 +203,15 @@ bool nemo::KIterator::Valid() {
 
 void nemo::KIterator::Next() {
   Iterator::Next();
-  CheckAndLoadData();
 }
 
 void nemo::KIterator::Skip(int64_t offset) {
   Iterator::Skip(offset);
-  CheckAndLoadData();
 }
 
 // KV KIteratorRO endpoint: Right Open
-nemo::KIteratorRO::KIteratorRO(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options)
-  : IteratorRO(it, db_nemo, iter_options) {
+nemo::KIteratorRO::KIteratorRO(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target)
+  : IteratorRO(db_nemo, iter_options, target) {
   }
 
 bool nemo::KIteratorRO::Valid() {
@@ -197,30 +226,23 @@ void nemo::KIteratorRO::Skip(int64_t offset) {
   IteratorRO::Skip(offset);
 }
 
+// The data iterators are bounded to the keys of key_, the prefix of their
+// data keys is type, key length and key, and the field or member follows
+
 // HASH
-nemo::HIterator::HIterator(rocksdb::Iterator *it, rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key)
-  : Iterator(it,db_nemo,iter_options) {
-    this->key_.assign(key.data(), key.size());
+nemo::HIterator::HIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, const rocksdb::Slice &target)
+  : Iterator(db_nemo, iter_options, target, EncodeHashKey(key, "")),
+    key_(key.data(), key.size()) {
     CheckAndLoadData();
   }
 
-// check valid and load field_, value_
+// check valid and load field_
 void nemo::HIterator::CheckAndLoadData() {
   if (valid_) {
     rocksdb::Slice ks = Iterator::key();
-
-    if (ks[0] == DataType::kHash) {
-      std::string k;
-      if (DecodeHashKey(ks, &k, &this->field_) != -1) {
-        if (k == this->key_) {
-          rocksdb::Slice vs = Iterator::value();
-          this->value_.assign(vs.data(), vs.size());
-          return ;
-        }
-      }
-    }
+    size_t header = 2 + key_.size();
+    field_ = rocksdb::Slice(ks.data() + header, ks.size() - header);
   }
-  valid_ = false;
 }
 
 bool nemo::HIterator::Valid() {
@@ -238,9 +260,9 @@ void nemo::HIterator::Skip(int64_t offset) {
 }
 
 // ZSET
-nemo::ZIterator::ZIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key)
-  : Iterator(it,db_nemo, iter_options) {
-    this->key_.assign(key.data(), key.size());
+nemo::ZIterator::ZIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, const rocksdb::Slice &target)
+  : Iterator(db_nemo, iter_options, target, EncodeZScorePrefix(key)),
+    key_(key.data(), key.size()) {
     CheckAndLoadData();
   }
 
@@ -248,13 +270,14 @@ nemo::ZIterator::ZIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, cons
 void nemo::ZIterator::CheckAndLoadData() {
   if (valid_) {
     rocksdb::Slice ks = Iterator::key();
-    if (ks[0] == DataType::kZScore) {
-      std::string k;
-      if (DecodeZScoreKey(ks, &k, &this->member_, &this->score_) != -1) {
-        if (k == this->key_) {
-          return ;
-        }
-      }
+    size_t header = 2 + key_.size();
+    if (ks.size() >= header + sizeof(uint64_t)) {
+      uint64_t iscore;
+      memcpy(&iscore, ks.data() + header, sizeof(uint64_t));
+      score_ = DecodeScore(be64toh(iscore));
+      header += sizeof(uint64_t);
+      member_ = rocksdb::Slice(ks.data() + header, ks.size() - header);
+      return ;
     }
   }
   valid_ = false;
@@ -275,26 +298,18 @@ void nemo::ZIterator::Skip(int64_t offset) {
 }
 
 // ZLexIterator
-nemo::ZLexIterator::ZLexIterator(rocksdb::Iterator *it, rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key)
-  : Iterator(it,db_nemo, iter_options) {
-    this->key_.assign(key.data(), key.size());
+nemo::ZLexIterator::ZLexIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, const rocksdb::Slice &target)
+  : Iterator(db_nemo, iter_options, target, EncodeZSetKey(key, "")),
+    key_(key.data(), key.size()) {
     CheckAndLoadData();
   }
 
 void nemo::ZLexIterator::CheckAndLoadData() {
   if (valid_) {
     rocksdb::Slice ks = Iterator::key();
-
-    if (ks[0] == DataType::kZSet) {
-      std::string k;
-      if (DecodeZSetKey(ks, &k, &this->member_) != -1) {
-        if (k == this->key_) {
-          return ;
-        }
-      }
-    }
+    size_t header = 2 + key_.size();
+    member_ = rocksdb::Slice(ks.data() + header, ks.size() - header);
   }
-  valid_ = false;
 }
 
 bool nemo::ZLexIterator::Valid() {
@@ -312,9 +327,9 @@ void nemo::ZLexIterator::Skip(int64_t offset) {
 }
 
 // SET
-nemo::SIterator::SIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key)
-  : Iterator(it, db_nemo, iter_options) {
-    this->key_.assign(key.data(), key.size());
+nemo::SIterator::SIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, const rocksdb::Slice &target)
+  : Iterator(db_nemo, iter_options, target, EncodeSetKey(key, "")),
+    key_(key.data(), key.size()) {
     CheckAndLoadData();
   }
 
@@ -322,17 +337,9 @@ nemo::SIterator::SIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, cons
 void nemo::SIterator::CheckAndLoadData() {
   if (valid_) {
     rocksdb::Slice ks = Iterator::key();
-
-    if (ks[0] == DataType::kSet) {
-      std::string k;
-      if (DecodeSetKey(ks, &k, &this->member_) != -1) {
-        if (k == this->key_) {
-          return ;
-        }
-      }
-    }
+    size_t header = 2 + key_.size();
+    member_ = rocksdb::Slice(ks.data() + header, ks.size() - header);
   }
-  valid_ = false;
 }
 
 bool nemo::SIterator::Valid() {
@@ -350,8 +357,8 @@ void nemo::SIterator::Skip(int64_t offset) {
 }
 
 // HASH meta key
-nemo::HmetaIterator::HmetaIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key, bool skip_nil_index)
-  : IteratorRO(it,db_nemo, iter_options), _skip_nil_index(skip_nil_index) {
+nemo::HmetaIterator::HmetaIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target, bool skip_nil_index)
+  : IteratorRO(db_nemo, iter_options, target, std::string(1, DataType::kHSize)), _skip_nil_index(skip_nil_index) {
     CheckAndLoadData();
   }
 
@@ -403,8 +410,8 @@ void nemo::HmetaIterator::Skip(int64_t offset) {
 }
 
 // List meta key
-nemo::LmetaIterator::LmetaIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key)
-  : IteratorRO(it,db_nemo, iter_options) {    
+nemo::LmetaIterator::LmetaIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target)
+  : IteratorRO(db_nemo, iter_options, target, std::string(1, DataType::kLMeta)) {    
     CheckAndLoadData();
   }
 
@@ -447,8 +454,8 @@ void nemo::LmetaIterator::Skip(int64_t offset) {
 }
 
 // Set meta key
-nemo::SmetaIterator::SmetaIterator(rocksdb::Iterator *it, rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key)
-  : IteratorRO(it,db_nemo, iter_options) {  
+nemo::SmetaIterator::SmetaIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target)
+  : IteratorRO(db_nemo, iter_options, target, std::string(1, DataType::kSSize)) {  
     CheckAndLoadData();
   }
 
@@ -492,8 +499,8 @@ void nemo::SmetaIterator::Skip(int64_t offset) {
 }
 
 // ZSet meta key
-nemo::ZmetaIterator::ZmetaIterator(rocksdb::Iterator *it,rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &key)
-  : IteratorRO(it,db_nemo, iter_options) {     
+nemo::ZmetaIterator::ZmetaIterator(rocksdb::DBNemo * db_nemo, const IteratorOptions iter_options, const rocksdb::Slice &target)
+  : IteratorRO(db_nemo, iter_options, target, std::string(1, DataType::kZSize)) {     
     CheckAndLoadData();
   }
 
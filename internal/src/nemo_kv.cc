@@ -2,8 +2,14 @@
 #include <climits>
 #include <list>
 #include <climits>
+#include <algorithm>
+#include <thread>
 
 #include "nemo.h"
+#include "nemo_glob.h"
+#include "nemo_expire.h"
+#include "nemo_metrics.h"
+#include "nemo_write_group.h"
 #include "nemo_mutex.h"
 #include "nemo_iterator.h"
 #include "util.h"
@@ -12,16 +18,37 @@
 using namespace nemo;
 
 Status Nemo::Set(const rocksdb::Slice &key, const rocksdb::Slice &val, const int32_t ttl) {
+    MetricsScope metrics(metrics_, kCmdSet, key);
+    // The expire sweeper deletes a kv key under its lock
+    RecordLock l(&mutex_kv_record_, key);
     Status s;
-    if (ttl <= 0) {
-        s = kv_db_->Put(w_opts_nolog(), key, val);
-    } else {
-        s = kv_db_->Put(w_opts_nolog(), key, val, ttl);
+    if (ttl > 0) {
+        s = expire_sweeper_->Index(DataType::kKv, key, std::time(0) + ttl);
+        if (!s.ok()) {
+            return s;
+        }
     }
-    return s;
+    rocksdb::WriteBatch batch;
+    batch.Put(key, val);
+    return kv_group_->Write(w_opts_nolog(), rocksdb::kNemoWriteTTL, &batch, ttl > 0 ? ttl : 0);
+}
+
+WriteFuture Nemo::SetAsync(const rocksdb::Slice &key, const rocksdb::Slice &val, const int32_t ttl) {
+    // Queued under the lock, so the expire sweeper waits for the write
+    RecordLock l(&mutex_kv_record_, key);
+    if (ttl > 0) {
+        Status s = expire_sweeper_->Index(DataType::kKv, key, std::time(0) + ttl);
+        if (!s.ok()) {
+            return WriteFuture(s);
+        }
+    }
+    rocksdb::WriteBatch batch;
+    batch.Put(key, val);
+    return kv_group_->Submit(w_opts_nolog(), rocksdb::kNemoWriteTTL, &batch, ttl > 0 ? ttl : 0);
 }
 
 Status Nemo::Get(const rocksdb::Slice &key, std::string *val) {
+    MetricsScope metrics(metrics_, kCmdGet, key);
     Status s;
     s = kv_db_->Get(rocksdb::ReadOptions(), key, val);
     return s;
@@ -31,6 +58,7 @@ Status Nemo::Get(const rocksdb::Slice &key, std::string *val) {
 Status Nemo::KDel(const std::string &key, int64_t *res) {
     Status s;
     std::string val;
+    kv_group_->Drain();
 
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     *res = 0;
@@ -42,12 +70,17 @@ Status Nemo::KDel(const std::string &key, int64_t *res) {
 }
 
 Status Nemo::MSet(const std::vector<KV> &kvs) {
+    MetricsScope metrics(metrics_, kCmdMSet);
     Status s;
     std::vector<KV>::const_iterator it;
     rocksdb::WriteBatch batch;
+    std::vector<std::string> keys;
     for (it = kvs.begin(); it != kvs.end(); it++) {
         batch.Put(it->key, it->val); 
+        keys.push_back(it->key);
     }
+    MultiRecordLock l(&mutex_kv_record_, keys);
+    kv_group_->Drain();
     s = kv_db_->Write(w_opts_nolog(), &(batch), 0);
     return s;
 }
@@ -56,9 +89,13 @@ Status Nemo::MSetSlice(const std::vector<KVSlice> &kvs) {
     Status s;
     std::vector<KVSlice>::const_iterator it;
     rocksdb::WriteBatch batch;
+    std::vector<rocksdb::Slice> keys;
     for (it = kvs.begin(); it != kvs.end(); it++) {
         batch.Put(it->key, it->val);
+        keys.push_back(it->key);
     }
+    MultiRecordLock l(&mutex_kv_record_, keys);
+    kv_group_->Drain();
     s = kv_db_->Write(w_opts_nolog(), &(batch), 0);
     return s;
 }
@@ -67,11 +104,29 @@ Status Nemo::WriteBatchTtl(std::vector<rocksdb::KVOT>& kvots, bool sync) {
     Status s;
     rocksdb::WriteOptions wo;
     wo.sync = sync;
+    rocksdb::WriteBatch entries;
+    std::time_t now = std::time(0);
+    std::vector<rocksdb::Slice> keys;
+    for (size_t i = 0; i < kvots.size(); i++) {
+        keys.push_back(kvots[i].key);
+        if (kvots[i].ops == 0 && kvots[i].ttl > 0 && expire_sweeper_->indexing()) {
+            entries.Put(EncodeExpireKey(now + kvots[i].ttl, DataType::kKv, kvots[i].key), "");
+        }
+    }
+    if (entries.Count() > 0) {
+        s = expire_sweeper_->IndexBatch(&entries);
+        if (!s.ok()) {
+            return s;
+        }
+    }
+    MultiRecordLock l(&mutex_kv_record_, keys);
+    kv_group_->Drain();
     s = kv_db_->WriteBatchTtl(wo, kvots);
     return s;
 }
 
 Status Nemo::KMDel(const std::vector<std::string> &keys, int64_t* count) {
+    kv_group_->Drain();
     *count = 0;
     Status s;
     std::string val;
@@ -89,30 +144,37 @@ Status Nemo::KMDel(const std::vector<std::string> &keys, int64_t* count) {
 }
 
 Status Nemo::MGet(const std::vector<std::string> &keys, std::vector<KVS> &kvss) {
-    Status s;
-    std::vector<std::string>::const_iterator it_key;
-    for (it_key = keys.begin(); it_key != keys.end(); it_key++) {
-        std::string val("");
-        s = kv_db_->Get(rocksdb::ReadOptions(), *it_key, &val);
-        kvss.push_back((KVS){*(it_key), val, s});
+    MetricsScope metrics(metrics_, kCmdMGet);
+    std::vector<rocksdb::Slice> key_slices(keys.begin(), keys.end());
+    rocksdb::NemoBatchGetResult result;
+    kv_db_->BatchGet(rocksdb::ReadOptions(), key_slices, &result);
+    for (size_t i = 0; i < keys.size(); i++) {
+        kvss.push_back((KVS){keys[i], result.values[i].ToString(), result.statuses[i]});
     }
     return Status::OK();
 }
 
 Status Nemo::MGetSlice(const std::vector<rocksdb::Slice> &keys, std::vector<SS> &vs) {
-    Status s;
+    rocksdb::NemoBatchGetResult result;
+    kv_db_->BatchGet(rocksdb::ReadOptions(), keys, &result);
     for (size_t i=0; i<keys.size(); i++) {
-        std::string * val = new std::string();
-        s = kv_db_->Get(rocksdb::ReadOptions(), keys[i], val);
-        vs[i] = SS{val, s};
+        std::string * val = new std::string(result.values[i].data(), result.values[i].size());
+        vs[i] = SS{val, result.statuses[i]};
     }
     return Status::OK();
 }
 
+Status Nemo::MGetBatch(const std::vector<rocksdb::Slice> &keys, rocksdb::NemoBatchGetResult *result) {
+    kv_db_->BatchGet(rocksdb::ReadOptions(), keys, result);
+    return Status::OK();
+}
+
 Status Nemo::Incrby(const std::string &key, const int64_t by, std::string &new_val) {
+    MetricsScope metrics(metrics_, kCmdIncrby, key);
     Status s;
     std::string val;
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     //MutexLock l(&mutex_kv_);
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.IsNotFound()) {
@@ -143,6 +205,7 @@ Status Nemo::Decrby(const std::string &key, const int64_t by, std::string &new_v
     Status s;
     std::string val;
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     //MutexLock l(&mutex_kv_);
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.IsNotFound()) {
@@ -174,6 +237,7 @@ Status Nemo::Incrbyfloat(const std::string &key, const double by, std::string &n
     std::string val;
     std::string res;
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     //MutexLock l(&mutex_kv_);
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.IsNotFound()) {
@@ -213,6 +277,7 @@ Status Nemo::GetSet(const std::string &key, const std::string &new_val, std::str
     std::string val;
     *old_val = "";
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     //MutexLock l(&mutex_kv_);
     s = kv_db_->Get(rocksdb::ReadOptions(), key, old_val);
     if (!s.ok() && !s.IsNotFound()) {
@@ -229,6 +294,7 @@ Status Nemo::Append(const std::string &key, const std::string &value, int64_t *n
     std::string old_val;
     //MutexLock l(&mutex_kv_);
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &old_val);
     std::string new_val;
     if (s.ok()) {
@@ -251,16 +317,21 @@ Status Nemo::Append(const std::string &key, const std::string &value, int64_t *n
 }
 
 Status Nemo::Setnx(const std::string &key, const std::string &value, int64_t *ret, const int32_t ttl) {
+    MetricsScope metrics(metrics_, kCmdSetnx, key);
     *ret = 0;
     std::string val;
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     //MutexLock l(&mutex_kv_);
     Status s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.IsNotFound()) {
         if (ttl <= 0) {
             s = kv_db_->Put(w_opts_nolog(), key, value);
         } else {
-            s = kv_db_->Put(w_opts_nolog(), key, value, ttl);
+            s = expire_sweeper_->Index(DataType::kKv, key, std::time(0) + ttl);
+            if (s.ok()) {
+                s = kv_db_->Put(w_opts_nolog(), key, value, ttl);
+            }
         }
         *ret = 1;
     }
@@ -271,13 +342,17 @@ Status Nemo::Setxx(const std::string &key, const std::string &value, int64_t *re
     *ret = 0;
     std::string val;
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     //MutexLock l(&mutex_kv_);
     Status s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.ok()) {
         if (ttl <= 0) {
             s = kv_db_->Put(w_opts_nolog(), key, value);
         } else {
-            s = kv_db_->Put(w_opts_nolog(), key, value, ttl);
+            s = expire_sweeper_->Index(DataType::kKv, key, std::time(0) + ttl);
+            if (s.ok()) {
+                s = kv_db_->Put(w_opts_nolog(), key, value, ttl);
+            }
         }
         *ret = 1;
     }
@@ -289,6 +364,12 @@ Status Nemo::MSetnx(const std::vector<KV> &kvs, int64_t *ret) {
     std::vector<KV>::const_iterator it;
     rocksdb::WriteBatch batch;
     std::string val;
+    std::vector<std::string> keys;
+    for (it = kvs.begin(); it != kvs.end(); it++) {
+        keys.push_back(it->key);
+    }
+    MultiRecordLock l(&mutex_kv_record_, keys);
+    kv_group_->Drain();
     *ret = 1;
     for (it = kvs.begin(); it != kvs.end(); it++) {
         s = kv_db_->Get(rocksdb::ReadOptions(), it->key, &val);
@@ -337,6 +418,7 @@ Status Nemo::Setrange(const std::string key, const int64_t offset, const std::st
     }
     //MutexLock l(&mutex_kv_);
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     Status s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.ok()) {
         if (val.length() + offset > (1<<29)) {
@@ -396,10 +478,7 @@ KIterator* Nemo::KScan(const std::string &start, const std::string &end, uint64_
 
     IteratorOptions iter_options(key_end, limit, read_options);
 
-    rocksdb::Iterator *it = kv_db_->NewIterator(read_options);
-    it->Seek(start);
-
-    return new KIterator(it, kv_db_.get(), iter_options); 
+    return new KIterator(kv_db_.get(), iter_options, start); 
 }
 
 KIteratorRO* Nemo::KScanRO(const std::string &start, const std::string &end, uint64_t limit, bool use_snapshot) {
@@ -417,10 +496,7 @@ KIteratorRO* Nemo::KScanRO(const std::string &start, const std::string &end, uin
 
     IteratorOptions iter_options(key_end, limit, read_options);
 
-    rocksdb::Iterator *it = kv_db_->NewIterator(read_options);
-    it->Seek(start);
-
-    return new KIteratorRO(it, kv_db_.get(), iter_options); 
+    return new KIteratorRO(kv_db_.get(), iter_options, start); 
 }
 
 KIteratorRO* Nemo::KScanWithHandle(rocksdb::DBNemo * db, const std::string &start, const std::string &end, uint64_t limit, bool use_snapshot) {
@@ -438,10 +514,7 @@ KIteratorRO* Nemo::KScanWithHandle(rocksdb::DBNemo * db, const std::string &star
 
     IteratorOptions iter_options(key_end, limit, read_options);
 
-    rocksdb::Iterator *it = db->NewIterator(read_options);
-    it->Seek(start);
-
-    return new KIteratorRO(it, db, iter_options); 
+    return new KIteratorRO(db, iter_options, start); 
 }
 
 Status Nemo::SeekWithHandle( rocksdb::DBNemo * db, std::string & start,std::string * nextKey,std::string * nextValue ){
@@ -481,179 +554,223 @@ int64_t Nemo::StoreAndGetCursor(int64_t cursor, const std::string& next_key) {
     } else {
         cursors_store_.cur_size_++;
     }
-    std::map<int64_t, std::string>::iterator iter_map = cursors_map.begin();
-    while (iter_map != cursors_map.end()) {
-        if (cursor < iter_map->first) {
-            break;
-        } else if (cursor == iter_map->first) {
-            cursor++;
-            iter_map++;
-        } else {
-            iter_map++;
-        }
+    // the first cursor from cursor on not in use
+    std::map<int64_t, std::string>::iterator iter_map = cursors_map.lower_bound(cursor);
+    while (iter_map != cursors_map.end() && iter_map->first == cursor) {
+        cursor++;
+        iter_map++;
     }
     cursors_list.push_back(cursor);
     cursors_map[cursor] = next_key;
     return cursor;
 }
 
-bool Nemo::ScanKeysWithTTL(std::unique_ptr<rocksdb::DBNemo>& db, std::string& start_key, const std::string& pattern, std::vector<std::string>& keys, int64_t* count, std::string* next_key) {
-    assert(*count > 0);
-    rocksdb::ReadOptions iterate_options;
-    iterate_options.fill_cache = false;
-    bool is_over = true;
-    std::string scan_keys_store_pre = std::string(100, '\0');;
-//    int64_t ttl;
-    Status s;
+namespace {
 
-    rocksdb::Iterator *it = db->NewIterator(iterate_options);
+// The kv db keeps the cursors of an older SCAN under this prefix
+const std::string kScanStorePrefix(100, '\0');
 
-    std::string key;
-    it->Seek(start_key);
-    while (it->Valid() && (*count) > 0) {
-        key = it->key().ToString();
-        if (stringmatchlen(pattern.data(), pattern.size(), key.data(), key.size(), 0) && key.substr(0, scan_keys_store_pre.size()) != scan_keys_store_pre) {
-            keys.push_back(key);
-            (*count)--;
-        }
-        it->Next();
+// The letters of the dbs in a SCAN cursor, in the order SCAN walks them
+const char kScanLetters[] = {'k', 'h', 'l', 'z', 's'};
+const int kScanDBNum = 5;
+
+inline std::string ScanRawKey(char type, const std::string &key) {
+    return type == '\0' ? key : std::string(1, type) + key;
+}
+
+// Appends the keys of [start, end) of db that match, without the type
+// byte, end empty for no bound. Stops once count of them were found when
+// count is not NULL, and returns false with the key, without the type
+// byte, to resume at in next_key. Returns true once the range is done.
+bool ScanRange(rocksdb::DBNemo *db, const rocksdb::Snapshot *snapshot, char type,
+               const std::string &start, const std::string &end, const GlobMatcher &matcher,
+               std::vector<std::string> *keys, int64_t *count, std::string *next_key) {
+    size_t header = type == '\0' ? 0 : 1;
+    rocksdb::ReadOptions read_options;
+    read_options.snapshot = snapshot;
+    read_options.fill_cache = false;
+    rocksdb::Slice upper(end);
+    if (!end.empty()) {
+        read_options.iterate_upper_bound = &upper;
     }
-    if (it->Valid()) {//the scan is over in the kv_db_
-        is_over = false;
-        *next_key = it->key().ToString();
-    } else { // the kv_db is over, but the scan is over or not
-        *next_key = "";
+
+    bool is_over = true;
+    rocksdb::Iterator *it = db->NewIterator(read_options);
+    for (it->Seek(start); it->Valid(); it->Next()) {
+        rocksdb::Slice key = it->key();
+        if (header == 1 && (key.size() == 0 || key[0] != type)) {
+            break;
+        }
+        key.remove_prefix(header);
+        // the keys are in order, none after the first past the prefix matches
+        if (!key.starts_with(matcher.prefix())) {
+            break;
+        }
+        if (count != NULL && *count == 0) {
+            is_over = false;
+            next_key->assign(key.data(), key.size());
+            break;
+        }
+        if (header == 0 && key.starts_with(kScanStorePrefix)) {
+            continue;
+        }
+        if (matcher.MatchesAll() || matcher.Match(key)) {
+            keys->push_back(key.ToString());
+            if (count != NULL) {
+                (*count)--;
+            }
+        }
     }
     delete it;
     return is_over;
 }
 
+// The start of the range of the keys of type matching, and its end, empty
+// for no bound
+void ScanBounds(char type, const GlobMatcher &matcher, std::string *start, std::string *end) {
+    *start = ScanRawKey(type, matcher.prefix());
+    *end = PrefixSuccessor(*start);
+}
 
-bool Nemo::ScanKeys(std::unique_ptr<rocksdb::DBNemo>& db, const char kType, std::string& start_key, const std::string& pattern, std::vector<std::string>& keys, int64_t* count, std::string *next_key) {
-    rocksdb::ReadOptions iterate_options;
-    iterate_options.fill_cache = false;
-    bool is_over = true;
-
-    rocksdb::Iterator *it = db->NewIterator(iterate_options);
-
-    std::string start_key_real;
-    start_key_real.assign(1, kType);
-    start_key_real.append(start_key.data(), start_key.size());
-    it->Seek(start_key_real);
-    std::string key;
-    while (it->Valid() && *count) {
-        key = it->key().ToString();
-        if (key.size() == 0 || key.at(0) != kType) {
-        break;
+// A range of a db one worker of KEYS scans
+struct ScanPartition {
+    rocksdb::DBNemo *db;
+    const rocksdb::Snapshot *snapshot;
+    char type;
+    std::string start;
+    std::string end;
+    std::vector<std::string> keys;
+};
+
+// Cuts [start, end) of db at the smallest keys of its sst files into at
+// most n partitions of about as many files each. The files only tell
+// where to cut, whatever they hold the partitions cover the range.
+void SplitRange(rocksdb::DBNemo *db, const rocksdb::Snapshot *snapshot, char type,
+                const std::string &start, const std::string &end, int n,
+                std::vector<ScanPartition> *parts) {
+    std::vector<std::string> cuts;
+    if (n > 1) {
+        std::vector<rocksdb::LiveFileMetaData> files;
+        db->GetLiveFilesMetaData(&files);
+        const std::string &cf_name = db->DefaultColumnFamily()->GetName();
+        for (size_t i = 0; i < files.size(); i++) {
+            const std::string &key = files[i].smallestkey;
+            if (files[i].column_family_name == cf_name && key > start && (end.empty() || key < end)) {
+                cuts.push_back(key);
+            }
         }
-        if (stringmatchlen(pattern.data(), pattern.size(), key.data() + 1, key.size() - 1, 0)) {
-            key.erase(key.begin());//erase the first marked letter
-            keys.push_back(key);
-            (*count)--;
+        std::sort(cuts.begin(), cuts.end());
+        cuts.erase(std::unique(cuts.begin(), cuts.end()), cuts.end());
+    }
+
+    ScanPartition part;
+    part.db = db;
+    part.snapshot = snapshot;
+    part.type = type;
+    part.start = start;
+    for (int i = 1; i < n && !cuts.empty(); i++) {
+        const std::string &cut = cuts[cuts.size() * i / n];
+        if (cut > part.start) {
+            part.end = cut;
+            parts->push_back(part);
+            part.start = cut;
         }
-        it->Next();
     }
-    if (it->Valid() && it->key().ToString().at(0) == kType) {
-        is_over = false;
-        *next_key = it->key().ToString();
-        next_key->erase(next_key->begin());
-    } else {
-        *next_key = "";
+    part.end = end;
+    parts->push_back(part);
+}
+
+void ScanWorker(std::vector<ScanPartition> *parts, std::atomic<size_t> *next, const GlobMatcher *matcher) {
+    size_t i;
+    std::string next_key;
+    while ((i = (*next)++) < parts->size()) {
+        ScanPartition &part = (*parts)[i];
+        ScanRange(part.db, part.snapshot, part.type, part.start, part.end, *matcher,
+                  &part.keys, NULL, &next_key);
     }
-    delete it;
+}
 
-    return is_over;
 }
 
-Status Nemo::Scan(int64_t cursor, std::string& pattern, int64_t count, std::vector<std::string>& keys, int64_t* cursor_ret_ptr) {//the sequence is kv, hash, zset, set, list
-    std::string scan_store_key = "Scan_Key_Store";
-    std::string start_key = "k";
-    std::string next_key;
-    std::string field;
+// The cursor is "0" to start, or the letter of the db to resume in followed
+// by the key to resume at, so that nothing is kept between the calls
+Status Nemo::Scan(const std::string &cursor, const std::string &pattern, int64_t count,
+                  std::vector<std::string>& keys, std::string *next_cursor) {
+    rocksdb::DBNemo *dbs[] = {kv_db_.get(), hash_db_.get(), list_db_.get(), zset_db_.get(), set_db_.get()};
+    const char types[] = {'\0', DataType::kHSize, DataType::kLMeta, DataType::kZSize, DataType::kSSize};
+
+    keys.clear();
+    *next_cursor = "0";
+    if (count <= 0) {
+        return Status::InvalidArgument("count should be positive");
+    }
+    int i = 0;
+    if (cursor != "0" && !cursor.empty()) {
+        while (i < kScanDBNum && kScanLetters[i] != cursor[0]) {
+            i++;
+        }
+        if (i == kScanDBNum) {
+            return Status::InvalidArgument("invalid cursor");
+        }
+    }
+
+    GlobMatcher matcher(pattern);
+    for (; i < kScanDBNum; i++) {
+        if (count == 0) {
+            next_cursor->assign(1, kScanLetters[i]);
+            break;
+        }
+        std::string start, end;
+        ScanBounds(types[i], matcher, &start, &end);
+        if (!cursor.empty() && cursor[0] == kScanLetters[i]) {
+            start = std::max(start, ScanRawKey(types[i], cursor.substr(1)));
+        }
+        std::string next_key;
+        if (!ScanRange(dbs[i], NULL, types[i], start, end, matcher, &keys, &count, &next_key)) {
+            *next_cursor = std::string(1, kScanLetters[i]) + next_key;
+            break;
+        }
+    }
+    return Status::OK();
+}
+
+Status Nemo::Scan(int64_t cursor, std::string& pattern, int64_t count, std::vector<std::string>& keys, int64_t* cursor_ret_ptr) {//the sequence is kv, hash, list, zset, set
+    std::string token = "0";
     Status s;
-    bool is_over;
-    int64_t count_origin = count;
 
     *cursor_ret_ptr = 0;
     keys.clear();
-    if (count < 0) {
-        start_key = "k";
-    }
     if (cursor < 0) {
         return Status::OK();
     } else if (cursor > 0) {
-        s = GetStartKey(cursor, &start_key);
+        s = GetStartKey(cursor, &token);
     }
     if (s.IsNotFound()) {
-        start_key = "k";
         cursor = 0;
     }
 
-    char key_type = start_key.at(0);
-    start_key.erase(start_key.begin());
-    switch (key_type) {
-        case 'k':
-            is_over = ScanKeysWithTTL(kv_db_, start_key, pattern, keys, &count, &next_key);
-            if (count == 0 && is_over) {
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("h"));
-                break;
-            } else if (count == 0 && !is_over) {
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("k")+next_key);
-                break;
-            }
-            start_key = next_key;
-        case 'h':
-            is_over = ScanKeys(hash_db_, DataType::kHSize, start_key, pattern, keys, &count, &next_key);
-            if (count == 0 && is_over) {
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("l"));
-                break;
-            } else if (count == 0 && !is_over) {
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("h")+next_key);
-                break;
-            }
-            start_key= next_key;
-        case 'l':
-            is_over = ScanKeys(list_db_, DataType::kLMeta, start_key, pattern, keys, &count, &next_key);
-            start_key = next_key;
-            if (count == 0 && is_over) {
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("z"));
-                break;
-            } else if (count ==0 && !is_over){
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("l")+next_key);
-                break;
-            }
-            start_key = next_key;
-        case 'z':
-            is_over = ScanKeys(zset_db_, DataType::kZSize, start_key, pattern, keys, &count, &next_key);
-            if (count == 0 && is_over) {
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("s"));
-                break;
-            } else if (count == 0 && !is_over) {
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("z")+next_key);
-                break;
-            }
-            start_key = next_key;
-        case 's':
-            is_over = ScanKeys(set_db_, DataType::kSSize, start_key, pattern, keys, &count, &next_key);
-            if (!is_over) {
-                *cursor_ret_ptr = StoreAndGetCursor(cursor+count_origin, std::string("s")+next_key);
-            } else {
-                *cursor_ret_ptr = 0;
-            }
+    std::string next_cursor;
+    s = Scan(token, pattern, count, keys, &next_cursor);
+    if (s.ok() && next_cursor != "0") {
+        *cursor_ret_ptr = StoreAndGetCursor(cursor + count, next_cursor);
     }
-    return Status::OK();
+    return s;
 }
 
 Status Nemo::KExpire(const std::string &key, const int32_t seconds, int64_t *res) {
     Status s;
     std::string val;
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.IsNotFound()) {
         *res = 0;
     } else if (s.ok()) {
         if (seconds > 0) {
-            s = kv_db_->Put(w_opts_nolog(), key, val, seconds);
+            s = expire_sweeper_->Index(DataType::kKv, key, std::time(0) + seconds);
+            if (s.ok()) {
+                s = kv_db_->Put(w_opts_nolog(), key, val, seconds);
+            }
         } else { 
             s = kv_db_->Delete(w_opts_nolog(), key);
         }
@@ -683,6 +800,7 @@ Status Nemo::KPersist(const std::string &key, int64_t *res) {
     std::string val;
  
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     *res = 0;
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.ok()) {
@@ -701,6 +819,7 @@ Status Nemo::KExpireat(const std::string &key, const int32_t timestamp, int64_t
     std::string val;
 
     RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
     if (s.IsNotFound()) {
         *res = 0;
@@ -709,7 +828,10 @@ Status Nemo::KExpireat(const std::string &key, const int32_t timestamp, int64_t
         if (timestamp <= cur) {
             s = kv_db_->Delete(w_opts_nolog(), key);
         } else {
-            s = kv_db_->PutWithExpiredTime(w_opts_nolog(), key, val, timestamp);
+            s = expire_sweeper_->Index(DataType::kKv, key, timestamp);
+            if (s.ok()) {
+                s = kv_db_->PutWithExpiredTime(w_opts_nolog(), key, val, timestamp);
+            }
         }
         *res = 1;
     }
@@ -719,11 +841,16 @@ Status Nemo::KExpireat(const std::string &key, const int32_t timestamp, int64_t
 // we don't check timestamp here
 Status Nemo::SetWithExpireAt(const std::string &key, const std::string &val, const int32_t timestamp) {
     //std::time_t cur = std::time(0);
+    RecordLock l(&mutex_kv_record_, key);
+    kv_group_->Drain();
     Status s;
     if (timestamp <= 0) {
         s = kv_db_->Put(w_opts_nolog(), key, val);
     } else {
-        s = kv_db_->PutWithExpiredTime(w_opts_nolog(), key, val, timestamp);
+        s = expire_sweeper_->Index(DataType::kKv, key, timestamp);
+        if (s.ok()) {
+            s = kv_db_->PutWithExpiredTime(w_opts_nolog(), key, val, timestamp);
+        }
     }
     return s;
 }
@@ -764,89 +891,89 @@ Status Nemo::GetSnapshot(Snapshots &snapshots) {
     return Status::OK();
 }
 
-Status Nemo::ScanKeysWithTTL(std::unique_ptr<rocksdb::DBNemo> &db, Snapshot *snapshot, const std::string pattern, std::vector<std::string>& keys) {
-    rocksdb::ReadOptions iterate_options;
-
-    iterate_options.snapshot = snapshot;
-    iterate_options.fill_cache = false;
-
-    rocksdb::Iterator *it = db->NewIterator(iterate_options);
-
-    it->SeekToFirst();
-    for (; it->Valid(); it->Next()) {
-      std::string key = it->key().ToString();
-      if (stringmatchlen(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
-          keys.push_back(key);
-      }
-  //     printf ("ScanDB key=(%s) value=(%s) val_size=%u\n", it->key().ToString().c_str(), it->value().ToString().c_str(),
-   //           it->value().ToString().size());
-    }
-
-    db->ReleaseSnapshot(iterate_options.snapshot);
-    delete it;
-
-    return Status::OK();
-}
-
+// Remeber the snapshot will be release inside!!
 Status Nemo::ScanKeys(std::unique_ptr<rocksdb::DBNemo> &db, Snapshot *snapshot, const char kType, const std::string &pattern, std::vector<std::string>& keys) {
-    rocksdb::ReadOptions iterate_options;
-
-    iterate_options.snapshot = snapshot;
-    iterate_options.fill_cache = false;
-
-    rocksdb::Iterator *it = db->NewIterator(iterate_options);
-
-    std::string key_start = "a";
-    key_start[0] = kType;
-    it->Seek(key_start);
-
-    for (; it->Valid(); it->Next()) {
-      if (kType != it->key().ToString().at(0)) {
-        break;
-      }
-      std::string key = it->key().ToString().substr(1);
-      if (stringmatchlen(pattern.data(), pattern.size(), key.data(), key.size(), 0)) {
-          keys.push_back(key);
-      }
-//       printf ("ScanDB key=(%s) value=(%s) val_size=%u\n", it->key().ToString().c_str(), it->value().ToString().c_str(),
- //             it->value().ToString().size());
-    }
-
-    db->ReleaseSnapshot(iterate_options.snapshot);
-    delete it;
+    GlobMatcher matcher(pattern);
+    std::string start, end, next_key;
+    ScanBounds(kType, matcher, &start, &end);
+    ScanRange(db.get(), snapshot, kType, start, end, matcher, &keys, NULL, &next_key);
 
+    db->ReleaseSnapshot(snapshot);
     return Status::OK();
 }
 
 // String APIs
 
+// Each db is cut into scan_threads_ partitions, which the workers take in
+// turn, and their keys are put together in order at the end
 Status Nemo::Keys(const std::string &pattern, std::vector<std::string>& keys) {
-    Status s;
+    rocksdb::DBNemo *dbs[] = {kv_db_.get(), hash_db_.get(), zset_db_.get(), set_db_.get(), list_db_.get()};
+    const char types[] = {'\0', DataType::kHSize, DataType::kZSize, DataType::kSSize, DataType::kLMeta};
     std::vector<const rocksdb::Snapshot*> snapshots;
 
-    s = GetSnapshot(snapshots);
-    if (!s.ok()) return s;
-
-    s = ScanKeysWithTTL(kv_db_, snapshots[0], pattern, keys);
-    if (!s.ok()) return s;
-
-    s = ScanKeys(hash_db_, snapshots[1], DataType::kHSize, pattern, keys);
-    if (!s.ok()) return s;
-
-    s = ScanKeys(zset_db_, snapshots[2], DataType::kZSize, pattern, keys);
-    if (!s.ok()) return s;
+    Status s = GetSnapshot(snapshots);
+    if (!s.ok()) {
+        for (size_t i = 0; i < snapshots.size(); i++) {
+            dbs[i]->ReleaseSnapshot(snapshots[i]);
+        }
+        return s;
+    }
 
-    s = ScanKeys(set_db_, snapshots[3], DataType::kSSize, pattern, keys);
-    if (!s.ok()) return s;
+    GlobMatcher matcher(pattern);
+    std::vector<ScanPartition> parts;
+    for (int i = 0; i < 5; i++) {
+        std::string start, end;
+        ScanBounds(types[i], matcher, &start, &end);
+        SplitRange(dbs[i], snapshots[i], types[i], start, end, scan_threads_, &parts);
+    }
 
-    s = ScanKeys(list_db_, snapshots[4], DataType::kLMeta, pattern, keys);
-    if (!s.ok()) return s;
+    std::atomic<size_t> next(0);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < (size_t)scan_threads_ && i < parts.size(); i++) {
+        workers.push_back(std::thread(ScanWorker, &parts, &next, &matcher));
+    }
+    ScanWorker(&parts, &next, &matcher);
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
 
+    for (size_t i = 0; i < parts.size(); i++) {
+        keys.insert(keys.end(), parts[i].keys.begin(), parts[i].keys.end());
+    }
+    for (int i = 0; i < 5; i++) {
+        dbs[i]->ReleaseSnapshot(snapshots[i]);
+    }
     return s;
 }
 
+// The key filters only answer for the keys the types may hold, the others
+// go through every type and fail as they did
+int Nemo::KeyTypes(const std::string &key) {
+    int types = 1 << kKV_DB;
+    if (!kv_db_->UserKeyMayExist(key)) {
+        types = 0;
+    }
+    if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
+        return types | 1 << kHASH_DB | 1 << kLIST_DB | 1 << kZSET_DB | 1 << kSET_DB;
+    }
+    if (hash_db_->UserKeyMayExist(key)) {
+        types |= 1 << kHASH_DB;
+    }
+    if (list_db_->UserKeyMayExist(key)) {
+        types |= 1 << kLIST_DB;
+    }
+    if (zset_db_->UserKeyMayExist(key)) {
+        types |= 1 << kZSET_DB;
+    }
+    if (set_db_->UserKeyMayExist(key)) {
+        types |= 1 << kSET_DB;
+    }
+    return types;
+}
+
 // Note: return Status::OK()
 Status Nemo::MDel(const std::vector<std::string> &keys, int64_t* count) {
+    MetricsScope metrics(metrics_, kCmdMDel);
     *count = 0;
     Status s;
     std::string val;
@@ -871,13 +998,15 @@ Status Nemo::MDel(const std::vector<std::string> &keys, int64_t* count) {
 
 // Note: return only Status::OK(), not Status::NotFound()
 Status Nemo::Del(const std::string &key, int64_t *count) {
+    MetricsScope metrics(metrics_, kCmdDel, key);
     int ok_cnt = 0;
     int64_t del_cnt = 0;
     Status s;
+    int types = KeyTypes(key);
     
     std::string tmp;
 
-    {
+    if (types & (1 << kKV_DB)) {
       RecordLock l(&mutex_kv_record_, key);
       s = KDel(key, count);
       if (s.ok()) {
@@ -891,7 +1020,7 @@ Status Nemo::Del(const std::string &key, int64_t *count) {
       }
     }
 
-    {
+    if (types & (1 << kHASH_DB)) {
       RecordLock l(&mutex_hash_record_, key);
       s = HDelKey(key, count);
       if (s.ok()) {
@@ -905,7 +1034,7 @@ Status Nemo::Del(const std::string &key, int64_t *count) {
       }
     }
 
-    {
+    if (types & (1 << kZSET_DB)) {
       RecordLock l(&mutex_zset_record_, key);
       s = ZDelKey(key, count);
       if (s.ok()) {
@@ -919,7 +1048,7 @@ Status Nemo::Del(const std::string &key, int64_t *count) {
       }
     }
 
-    {
+    if (types & (1 << kSET_DB)) {
       RecordLock l(&mutex_set_record_, key);
       s = SDelKey(key, count);
       if (s.ok()) {
@@ -933,7 +1062,7 @@ Status Nemo::Del(const std::string &key, int64_t *count) {
       }
     }
 
-    {
+    if (types & (1 << kLIST_DB)) {
       RecordLock l(&mutex_list_record_, key);
       s = LDelKey(key, count);
       if (s.ok()) {
@@ -958,38 +1087,40 @@ Status Nemo::Del(const std::string &key, int64_t *count) {
 }
 
 Status Nemo::Expire(const std::string &key, const int32_t seconds, int64_t *res) {
+    MetricsScope metrics(metrics_, kCmdExpire, key);
+    int types = KeyTypes(key);
     int cnt = 0;
     Status kv_result, s;
     
-    kv_result = KExpire(key, seconds, res);
+    kv_result = (types & (1 << kKV_DB)) ? KExpire(key, seconds, res) : Status::NotFound("");
     if (kv_result.ok()) {
       cnt++;
     } else if (!kv_result.IsNotFound()) {
       return kv_result;
     }
 
-    s = HExpire(key, seconds, res);
+    s = (types & (1 << kHASH_DB)) ? HExpire(key, seconds, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!kv_result.ok() && !s.IsNotFound()) {
       return s;
     }
 
-    s = ZExpire(key, seconds, res);
+    s = (types & (1 << kZSET_DB)) ? ZExpire(key, seconds, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!kv_result.ok() && !s.IsNotFound()) {
       return s;
     }
 
-    s = SExpire(key, seconds, res);
+    s = (types & (1 << kSET_DB)) ? SExpire(key, seconds, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!kv_result.ok() && !s.IsNotFound()) {
       return s;
     }
 
-    s = LExpire(key, seconds, res);
+    s = (types & (1 << kLIST_DB)) ? LExpire(key, seconds, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!kv_result.ok() && !s.IsNotFound()) {
@@ -1006,32 +1137,46 @@ Status Nemo::Expire(const std::string &key, const int32_t seconds, int64_t *res)
 }
 
 Status Nemo::TTL(const std::string &key, int64_t *res) {
-    Status s;
+    MetricsScope metrics(metrics_, kCmdTTL, key);
+    int types = KeyTypes(key);
+    Status s = Status::NotFound("");
+    *res = -2;
     
-    s = KTTL(key, res);
-    if (s.ok()) return s;
+    if (types & (1 << kKV_DB)) {
+        s = KTTL(key, res);
+        if (s.ok()) return s;
+    }
 
-    s = HTTL(key, res);
-    if (s.ok()) return s;
+    if (types & (1 << kHASH_DB)) {
+        s = HTTL(key, res);
+        if (s.ok()) return s;
+    }
 
-    s = ZTTL(key, res);
-    if (s.ok()) return s;
+    if (types & (1 << kZSET_DB)) {
+        s = ZTTL(key, res);
+        if (s.ok()) return s;
+    }
 
-    s = STTL(key, res);
-    if (s.ok()) return s;
+    if (types & (1 << kSET_DB)) {
+        s = STTL(key, res);
+        if (s.ok()) return s;
+    }
 
-    s = LTTL(key, res);
-    if (s.ok()) return s;
+    if (types & (1 << kLIST_DB)) {
+        s = LTTL(key, res);
+        if (s.ok()) return s;
+    }
 
     return s; 
 }
 
 Status Nemo::Persist(const std::string &key, int64_t *res) {
+    int types = KeyTypes(key);
     int ok_cnt = 0;
     int res_total = 0;
     Status s;
     
-    s = KPersist(key, res);
+    s = (types & (1 << kKV_DB)) ? KPersist(key, res) : Status::NotFound("");
     if (s.ok()) {
       ok_cnt++;
       res_total += *res;
@@ -1039,7 +1184,7 @@ Status Nemo::Persist(const std::string &key, int64_t *res) {
       return s;
     }
 
-    s = HPersist(key, res);
+    s = (types & (1 << kHASH_DB)) ? HPersist(key, res) : Status::NotFound("");
     if (s.ok()) {
       ok_cnt++;
       res_total += *res;
@@ -1047,7 +1192,7 @@ Status Nemo::Persist(const std::string &key, int64_t *res) {
       return s;
     }
 
-    s = ZPersist(key, res);
+    s = (types & (1 << kZSET_DB)) ? ZPersist(key, res) : Status::NotFound("");
     if (s.ok()) {
       ok_cnt++;
       res_total += *res;
@@ -1055,7 +1200,7 @@ Status Nemo::Persist(const std::string &key, int64_t *res) {
       return s;
     }
 
-    s = SPersist(key, res);
+    s = (types & (1 << kSET_DB)) ? SPersist(key, res) : Status::NotFound("");
     if (s.ok()) {
       ok_cnt++;
       res_total += *res;
@@ -1063,7 +1208,7 @@ Status Nemo::Persist(const std::string &key, int64_t *res) {
       return s;
     }
 
-    s = LPersist(key, res);
+    s = (types & (1 << kLIST_DB)) ? LPersist(key, res) : Status::NotFound("");
     if (s.ok()) {
       ok_cnt++;
       res_total += *res;
@@ -1085,38 +1230,39 @@ Status Nemo::Persist(const std::string &key, int64_t *res) {
 }
 
 Status Nemo::Expireat(const std::string &key, const int32_t timestamp, int64_t *res) {
+    int types = KeyTypes(key);
     int cnt = 0;
     Status s;
     
-    s = KExpireat(key, timestamp, res);
+    s = (types & (1 << kKV_DB)) ? KExpireat(key, timestamp, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!s.IsNotFound()) {
       return s;
     }
 
-    s = HExpireat(key, timestamp, res);
+    s = (types & (1 << kHASH_DB)) ? HExpireat(key, timestamp, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!s.IsNotFound()) {
       return s;
     }
 
-    s = ZExpireat(key, timestamp, res);
+    s = (types & (1 << kZSET_DB)) ? ZExpireat(key, timestamp, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!s.IsNotFound()) {
       return s;
     }
 
-    s = SExpireat(key, timestamp, res);
+    s = (types & (1 << kSET_DB)) ? SExpireat(key, timestamp, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!s.IsNotFound()) {
       return s;
     }
 
-    s = LExpireat(key, timestamp, res);
+    s = (types & (1 << kLIST_DB)) ? LExpireat(key, timestamp, res) : Status::NotFound("");
     if (s.ok()) {
       cnt++;
     } else if (!s.IsNotFound()) {
@@ -1137,8 +1283,9 @@ Status Nemo::Type(const std::string& key, std::string* type) {//the sequence is
     std::string val;
 
     type->clear();
+    int types = KeyTypes(key);
 
-    s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
+    s = (types & (1 << kKV_DB)) ? kv_db_->Get(rocksdb::ReadOptions(), key, &val) : Status::NotFound("");
     if (s.ok()) {
         *type = "string";
         return s;
@@ -1146,7 +1293,7 @@ Status Nemo::Type(const std::string& key, std::string* type) {//the sequence is
         return s;
     }
     
-    s = hash_db_->Get(rocksdb::ReadOptions(), std::string(1, DataType::kHSize) + key, &val);
+    s = (types & (1 << kHASH_DB)) ? hash_db_->Get(rocksdb::ReadOptions(), std::string(1, DataType::kHSize) + key, &val) : Status::NotFound("");
     if (s.ok() && *(reinterpret_cast<const int64_t*>(val.data())) > 0) { 
         *type = "hash";
         return s;
@@ -1154,7 +1301,7 @@ Status Nemo::Type(const std::string& key, std::string* type) {//the sequence is
         return s;
     }
 
-    s = list_db_->Get(rocksdb::ReadOptions(), std::string(1, DataType::kLMeta) + key, &val);
+    s = (types & (1 << kLIST_DB)) ? list_db_->Get(rocksdb::ReadOptions(), std::string(1, DataType::kLMeta) + key, &val) : Status::NotFound("");
     if (s.ok() && *(reinterpret_cast<const int64_t*>(val.data())) > 0) {
         *type = "list";
         return s;
@@ -1162,7 +1309,7 @@ Status Nemo::Type(const std::string& key, std::string* type) {//the sequence is
         return s;
     }
 
-    s = zset_db_->Get(rocksdb::ReadOptions(), std::string(1, DataType::kZSize) + key, &val);
+    s = (types & (1 << kZSET_DB)) ? zset_db_->Get(rocksdb::ReadOptions(), std::string(1, DataType::kZSize) + key, &val) : Status::NotFound("");
     if (s.ok() && *(reinterpret_cast<const int64_t*>(val.data())) > 0) { 
         *type = "zset";
         return s;
@@ -1170,7 +1317,7 @@ Status Nemo::Type(const std::string& key, std::string* type) {//the sequence is
         return s;
     }
 
-    s = set_db_->Get(rocksdb::ReadOptions(), std::string(1, DataType::kSSize) + key, &val);
+    s = (types & (1 << kSET_DB)) ? set_db_->Get(rocksdb::ReadOptions(), std::string(1, DataType::kSSize) + key, &val) : Status::NotFound("");
     if (s.ok() && *(reinterpret_cast<const int64_t*>(val.data())) > 0) {
         *type = "set";
         return s;
@@ -1183,52 +1330,91 @@ Status Nemo::Type(const std::string& key, std::string* type) {//the sequence is
 }
 
 // We treat single key as exists, when at least 1 type exists;
+// Each type reads the keys its key filter may hold and no earlier type
+// found, in one BatchGet of their meta keys, the kv keys themselves
 Status Nemo::Exists(const std::vector<std::string> &keys, int64_t* res) {
+    MetricsScope metrics(metrics_, kCmdExists);
     *res = 0;
-    Status s;
-    std::string val;
-
-    for (auto it = keys.begin(); it != keys.end(); it++) {
-      s = ExistsSingleKey(*it);
-      //printf ("Nemo::Exists key(%s) return %s\n", it->c_str(), s.ToString().c_str());
-      if (s.ok()) {
-        (*res)++;
-      } else if (!s.IsNotFound()) {
-        return s;
-      }
+    rocksdb::DBNemo* dbs[] = {kv_db_.get(), hash_db_.get(), list_db_.get(), zset_db_.get(), set_db_.get()};
+    // kv keys have no meta prefix
+    const char prefixes[] = {0, DataType::kHSize, DataType::kLMeta, DataType::kZSize, DataType::kSSize};
+
+    std::vector<bool> found(keys.size(), false);
+    std::vector<std::string> meta_keys;
+    std::vector<rocksdb::Slice> lookups;
+    std::vector<size_t> index;
+    rocksdb::NemoBatchGetResult result;
+    for (int t = 0; t < 5; t++) {
+        meta_keys.clear();
+        index.clear();
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (found[i] || !dbs[t]->UserKeyMayExist(keys[i])) {
+                continue;
+            }
+            meta_keys.push_back(prefixes[t] ? std::string(1, prefixes[t]) + keys[i] : keys[i]);
+            index.push_back(i);
+        }
+        if (index.empty()) {
+            continue;
+        }
+        lookups.assign(meta_keys.begin(), meta_keys.end());
+        dbs[t]->BatchGet(rocksdb::ReadOptions(), lookups, &result);
+        for (size_t j = 0; j < index.size(); j++) {
+            const Status &s = result.statuses[j];
+            if (s.IsNotFound()) {
+                continue;
+            } else if (!s.ok()) {
+                return s;
+            }
+            const rocksdb::Slice &val = result.values[j];
+            if (t == 0 || (val.size() >= sizeof(int64_t) &&
+                           *(reinterpret_cast<const int64_t*>(val.data())) > 0)) {
+                found[index[j]] = true;
+                (*res)++;
+            }
+        }
     }
-
-    //printf ("Nemo::Exists return ok, number is %ld\n", *res);
     return Status::OK();
 }
 
 Status Nemo::ExistsSingleKey(const std::string &key) {
     Status s;
     std::string val;
-    s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
-    if (s.ok() || !s.IsNotFound()) {
-        return s;
+    int types = KeyTypes(key);
+    if (types & (1 << kKV_DB)) {
+        s = kv_db_->Get(rocksdb::ReadOptions(), key, &val);
+        if (s.ok() || !s.IsNotFound()) {
+            return s;
+        }
     }
 
     int64_t len =0;
-    s = HLen(key,&len);
-    if (len > 0) {
-      return Status::OK();
+    if (types & (1 << kHASH_DB)) {
+        s = HLen(key,&len);
+        if (len > 0) {
+          return Status::OK();
+        }
     }
 
-    s = LLen(key, &len);
-    if (s.ok() || !s.IsNotFound()) {
-      return s;
+    if (types & (1 << kLIST_DB)) {
+        s = LLen(key, &len);
+        if (s.ok() || !s.IsNotFound()) {
+          return s;
+        }
     }
 
-    s = ZCard(key,&len);
-    if (len > 0) {
-      return Status::OK();
+    if (types & (1 << kZSET_DB)) {
+        s = ZCard(key,&len);
+        if (len > 0) {
+          return Status::OK();
+        }
     }
 
-    s = SCard(key,&len);
-    if (len > 0) {
-      return Status::OK();
+    if (types & (1 << kSET_DB)) {
+        s = SCard(key,&len);
+        if (len > 0) {
+          return Status::OK();
+        }
     }
 
     return Status::NotFound();
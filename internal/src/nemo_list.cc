@@ -1,6 +1,10 @@
 #include <ctime>
+#include <algorithm>
 
 #include "nemo_list.h"
+#include "nemo_expire.h"
+#include "nemo_metrics.h"
+#include "nemo_write_group.h"
 #include "nemo_mutex.h"
 #include "nemo_iterator.h"
 #include "util.h"
@@ -10,24 +14,32 @@ using namespace nemo;
 
 //static int32_t ParseMeta(std::string &meta_val, ListMeta &meta) {
 bool ListMeta::DecodeFrom(const std::string &meta_val) {
-  if (meta_val.size() != sizeof(int64_t) * 5) {
+  // metas written before the indexed encoding have no encoding field
+  if (meta_val.size() != sizeof(int64_t) * 5 && meta_val.size() != sizeof(int64_t) * 6) {
     return false;
   }
 
   len = *((int64_t *)(meta_val.data()));
-  vol = *((int64_t *)(meta_val.data() + sizeof(int64_t) ));  
+  vol = *((int64_t *)(meta_val.data() + sizeof(int64_t) ));
   left = *((int64_t *)(meta_val.data() + sizeof(int64_t) * 2 ));
   right = *((int64_t *)(meta_val.data() + sizeof(int64_t) * 3));
   cur_seq = *((int64_t *)(meta_val.data() + sizeof(int64_t) * 4));
+  encoding = kLinked;
+  if (meta_val.size() == sizeof(int64_t) * 6) {
+    encoding = *((int64_t *)(meta_val.data() + sizeof(int64_t) * 5));
+  }
   return true;
 }
 bool ListMeta::EncodeTo(std::string& meta_val) {
   meta_val.clear();
   meta_val.append((char *)&len, sizeof(int64_t));
-  meta_val.append((char *)&vol, sizeof(int64_t));  
+  meta_val.append((char *)&vol, sizeof(int64_t));
   meta_val.append((char *)&left, sizeof(int64_t));
   meta_val.append((char *)&right, sizeof(int64_t));
   meta_val.append((char *)&cur_seq, sizeof(int64_t));
+  if (encoding != kLinked) {
+    meta_val.append((char *)&encoding, sizeof(int64_t));
+  }
   return true;
 }
 std::string ListMeta::ToString() {
@@ -46,6 +58,7 @@ std::string ListMeta::ToString() {
   res.append(buf);
   res.append(", Cur_seq : ");
   res.append(buf);
+  res.append(encoding == kLinked ? ", Encoding : linked" : ", Encoding : indexed");
   return res;
 }
 
@@ -60,6 +73,7 @@ Status Nemo::LGetMetaByKey(const std::string& key, ListMeta& meta) {
   else
     return Status::Corruption("parse listmeta error");
 }
+
 Status Nemo::LChecknRecover(const std::string& key) {
   RecordLock l(&mutex_list_record_, key);
   ListMeta meta;
@@ -67,17 +81,54 @@ Status Nemo::LChecknRecover(const std::string& key) {
   if (!s.ok()) {
     return s;
   }
-  // Traverse from head and find the break before point
   int count = 0;
   int64_t volume = 0;
+  rocksdb::WriteBatch batch;
+
+  if (meta.encoding == ListMeta::kIndexed) {
+    // Keep the dense run from meta.left, everything after a hole is dropped
+    std::string ikey;
+    int64_t pos;
+    rocksdb::Iterator *it = list_db_->NewIterator(rocksdb::ReadOptions());
+    for (it->Seek(EncodeListIndexKey(key, meta.left)); it->Valid(); it->Next()) {
+      if (it->key()[0] != DataType::kList
+          || DecodeListIndexKey(it->key(), &ikey, &pos) == -1
+          || ikey != key || pos > meta.right) {
+        break;
+      }
+      if (pos == meta.left + count) {
+        ++count;
+        volume += key.size() + it->value().size();
+      } else {
+        batch.Delete(it->key());
+      }
+    }
+    delete it;
+
+    if (count == meta.len && volume == meta.vol) {
+      return Status::OK();
+    }
+    if (count == 0) {
+      batch.Delete(EncodeLMetaKey(key));
+    } else {
+      meta.len = count;
+      meta.vol = volume;
+      meta.right = meta.left + count - 1;
+      std::string meta_val;
+      meta.EncodeTo(meta_val);
+      batch.Put(EncodeLMetaKey(key), meta_val);
+    }
+    return list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+  }
+
+  // Traverse from head and find the break before point
   int64_t next = meta.left, cur = 0;
   ListData cur_data;
-  rocksdb::WriteBatch batch;
   std::string cur_listkey, en_val, raw_val;
   do {
     cur_listkey = EncodeListKey(key, next);
     s = list_db_->Get(rocksdb::ReadOptions(), cur_listkey, &en_val);
-    if (s.IsNotFound()) { 
+    if (s.IsNotFound()) {
       // We cant find the next one, so we now stand on the break before point
       break;
     } else if (!s.ok()) {
@@ -101,10 +152,10 @@ Status Nemo::LChecknRecover(const std::string& key) {
   if (next == 0 && cur == meta.right) {
     return Status::OK();
   }
-  
+
   if (cur == 0) {
     //Delete if no data found
-    batch.Delete(EncodeLMetaKey(key)); 
+    batch.Delete(EncodeLMetaKey(key));
   } else {
     // Truncate list
     std::string right_key = EncodeListKey(key, cur);
@@ -123,110 +174,138 @@ Status Nemo::LChecknRecover(const std::string& key) {
   return list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
 }
 
-int32_t Nemo::L2R(const std::string &key, const int64_t index, const int64_t left, int64_t *priv, int64_t *cur, int64_t *next) {
-    int64_t t = index;
-    int64_t t_cur = left;
+// Caller should hold the record lock of key, a list still in the linked
+// encoding is converted before returning its meta
+Status Nemo::LGetIndexedMeta(const std::string &key, ListMeta &meta) {
+    std::string meta_val;
+    Status s = list_db_->Get(rocksdb::ReadOptions(), EncodeLMetaKey(key), &meta_val);
+    if (s.IsNotFound()) {
+        return s;
+    } else if (!s.ok()) {
+        return Status::Corruption("get listmeta error");
+    }
+    if (!meta.DecodeFrom(meta_val)) {
+        return Status::Corruption("parse listmeta error");
+    }
+    if (meta.encoding == ListMeta::kIndexed) {
+        return Status::OK();
+    }
+    if (meta.len <= 0) {
+        // nothing to move, the next write stores an indexed meta
+        meta = ListMeta();
+        return Status::OK();
+    }
+    return LConvertNoLock(key, meta);
+}
+
+Status Nemo::LConvertNoLock(const std::string &key, ListMeta &meta) {
     Status s;
+    rocksdb::WriteBatch batch;
+    std::vector<std::string> vals;
     std::string db_key;
     std::string en_val;
     std::string raw_val;
-    while (t >= 0) {
-        *cur = t_cur;
-        db_key = EncodeListKey(key, *cur);
-        s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val); 
+    int64_t priv;
+    int64_t next;
+    int64_t cur = meta.left;
+
+    vals.reserve(meta.len);
+    while (cur != 0 && (int64_t)vals.size() < meta.len) {
+        db_key = EncodeListKey(key, cur);
+        s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val);
         if (!s.ok()) {
-            break;
+            return Status::Corruption("get listkey error");
         }
-        DecodeListVal(en_val, priv, next, raw_val); 
-        t--;
-        t_cur = *next;
+        DecodeListVal(en_val, &priv, &next, raw_val);
+        batch.Delete(db_key);
+        vals.push_back(raw_val);
+        cur = next;
     }
-    if ( t < 0 ) {
-        return 0;
-    } else {
-        return -1;
+    if (cur != 0 || (int64_t)vals.size() != meta.len) {
+        return Status::Corruption("broken linked list, LChecknRecover it first");
     }
-} 
 
-int32_t Nemo::R2L(const std::string &key, const int64_t index, const int64_t right, int64_t *priv, int64_t *cur, int64_t *next) {
-    int64_t t = index;
-    int64_t t_cur = right;
-    Status s;
-    std::string db_key;
-    std::string en_val;
-    std::string raw_val;
-    while (t >= 0) {
-        *cur = t_cur;
-        db_key = EncodeListKey(key, *cur);
-        s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val); 
-        if (!s.ok()) {
+    // Both encodings share the key prefix and an old seq key may equal a new
+    // position key, so every Delete has to precede the Puts in the batch
+    ListMeta indexed;
+    indexed.len = meta.len;
+    indexed.vol = meta.vol;
+    indexed.left = 0;
+    indexed.right = meta.len - 1;
+    for (size_t i = 0; i < vals.size(); i++) {
+        batch.Put(EncodeListIndexKey(key, i), vals[i]);
+    }
+    std::string meta_val;
+    indexed.EncodeTo(meta_val);
+    batch.Put(EncodeLMetaKey(key), meta_val);
+    s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+    if (s.ok()) {
+        meta = indexed;
+    }
+    return s;
+}
+
+// Read the elements at positions [from, to], vals and vol may be NULL,
+// vol sums the volume of the elements read
+Status Nemo::LGetPositions(const std::string &key, const int64_t from, const int64_t to, std::vector<std::string> *vals, int64_t *vol) {
+    int64_t pos = from;
+    rocksdb::Iterator *it = list_db_->NewIterator(rocksdb::ReadOptions());
+    for (it->Seek(EncodeListIndexKey(key, from)); pos <= to && it->Valid(); it->Next(), pos++) {
+        if (it->key() != EncodeListIndexKey(key, pos)) {
             break;
         }
-        DecodeListVal(en_val, priv, next, raw_val); 
-        t--;
-        t_cur = *priv;
+        if (vals != NULL) {
+            vals->push_back(it->value().ToString());
+        }
+        if (vol != NULL) {
+            *vol += key.size() + it->value().size();
+        }
     }
-    if ( t < 0 ) {
-        return 0;
-    } else {
-        return -1;
+    delete it;
+    if (pos <= to) {
+        return Status::Corruption("get element error");
     }
-} 
+    return Status::OK();
+}
 
 Status Nemo::LIndex(const std::string &key, const int64_t index, std::string *val) {
+    MetricsScope metrics(metrics_, kCmdLIndex, key);
     Status s;
-    rocksdb::WriteBatch batch;
-    std::string meta_val;
     ListMeta meta;
     RecordLock l(&mutex_list_record_, key);
-    
-    int64_t priv;
-    int64_t cur;
-    int64_t next;
-    std::string en_val;
-    std::string meta_key = EncodeLMetaKey(key);
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.len <= 0) {
-                return Status::NotFound("not found the key");
-            }
-            if (index >= meta.len || -index > meta.len ) {
-                return Status::NotFound("index out of range");
-            }
-            if (index >= 0) {
-                if (L2R(key, index, meta.left, &priv, &cur, &next) != 0) {
-                    return Status::Corruption("error in iterate");
-                }
-            } else {
-                if (R2L(key, -index-1, meta.right, &priv, &cur, &next) != 0) {
-                    return Status::Corruption("error in iterate");
-                }
-            }
-            std::string db_key = EncodeListKey(key, cur);
-            s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val);
-            DecodeListVal(en_val, &priv, &next, *val);
-            return s;
-        } else {
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
+
+    s = LGetIndexedMeta(key, meta);
+    if (s.IsNotFound()) {
         return Status::NotFound("not found the key");
-    } else {
-        return Status::Corruption("get listmeta error");
+    } else if (!s.ok()) {
+        return s;
     }
+    if (meta.len <= 0) {
+        return Status::NotFound("not found the key");
+    }
+    if (index >= meta.len || -index > meta.len ) {
+        return Status::NotFound("index out of range");
+    }
+    int64_t pos = index >= 0 ? meta.left + index : meta.right + index + 1;
+    s = list_db_->Get(rocksdb::ReadOptions(), EncodeListIndexKey(key, pos), val);
+    if (s.IsNotFound()) {
+        return Status::Corruption("get element error");
+    }
+    return s;
 }
 
 Status Nemo::LLen(const std::string &key, int64_t *llen) {
+    MetricsScope metrics(metrics_, kCmdLLen, key);
     Status s;
+    ListMeta meta;
     std::string meta_key = EncodeLMetaKey(key);
     std::string meta_val;
     s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
     if (s.ok()) {
-        if(meta_val.size() != sizeof(int64_t) * 5) {
+        if (!meta.DecodeFrom(meta_val)) {
             return Status::Corruption("list meta error");
         }
-        *llen = *((int64_t *)(meta_val.data()));
+        *llen = meta.len;
 
         if (*llen <= 0) {
             return Status::NotFound("not found the key");
@@ -237,144 +316,90 @@ Status Nemo::LLen(const std::string &key, int64_t *llen) {
     return s;
 }
 
-Status Nemo::LPush(const std::string &key, const std::string &val, int64_t *llen) {
-    if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
-       return Status::InvalidArgument("Invalid key length");
-    }
-
+Status Nemo::LPushNoLock(const std::string &key, const std::string &val, const bool left, int64_t *llen) {
     Status s;
     rocksdb::WriteBatch batch;
     ListMeta meta;
     std::string meta_val;
 
-    int64_t priv;
-    int64_t next;
-    std::string en_val;
-    std::string raw_val;
-    std::string meta_key = EncodeLMetaKey(key);
-    //MutexLock l(&mutex_list_);
-    RecordLock l(&mutex_list_record_, key);
-    //sleep(8);
+    s = LGetIndexedMeta(key, meta);
+    if (!s.ok() && !s.IsNotFound()) {
+        return s;
+    }
+    if (s.IsNotFound() || meta.len <= 0) {
+        meta = ListMeta();
+    }
 
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.left > 0) {
-                std::string l_key = EncodeListKey(key, meta.left);
-                s = list_db_->Get(rocksdb::ReadOptions(), l_key, &en_val);
-                if (!s.ok()) {
-                    return Status::Corruption("get left error");
-                }
-                DecodeListVal(en_val, &priv, &next, raw_val);
-                EncodeListVal(raw_val, meta.cur_seq, next, en_val);
-                batch.Put(l_key, en_val);
-            }
+    int64_t pos = left ? --meta.left : ++meta.right;
+    batch.Put(EncodeListIndexKey(key, pos), val);
 
-            std::string db_key = EncodeListKey(key, meta.cur_seq);
-            EncodeListVal(val, 0, meta.left, en_val);
-            batch.Put(db_key, en_val);
+    meta.len++;
+    meta.vol += key.size() + val.size();
+    meta.EncodeTo(meta_val);
+    batch.Put(EncodeLMetaKey(key), meta_val);
+    metrics_->profiler()->Meta(kLIST_DB, key, meta.len, meta.vol);
+    s = list_group_->Write(w_opts_nolog(), rocksdb::kNemoWriteOldKeyTTL, &batch);
+    *llen = meta.len;
+    return s;
+}
 
-            meta.len++;
-            meta.vol += key.size() + val.size();
-            meta.left = meta.cur_seq;
-            if (meta.right == 0) {
-                meta.right = meta.cur_seq;
-            }
-            meta.cur_seq++;
-            //char buf[64];
-            //memcpy(buf, (char *)&meta, sizeof(ListMeta));
-
-            //batch.Put(meta_key, std::string((char *)&meta, sizeof(ListMeta)));
-            meta.EncodeTo(meta_val);
-            batch.Put(meta_key, meta_val);
-            s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-            *llen = meta.len;
-            return s;
-        } else {
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
-        ListMeta meta(1, key.size() + val.size() ,1, 1, 2); // | len | vol | left | right | cur_seq |
-        
-        meta_val.reserve(5 * sizeof(int64_t));
-        meta.EncodeTo(meta_val);
+Status Nemo::LPopNoLock(const std::string &key, const bool left, std::string *val) {
+    Status s;
+    rocksdb::WriteBatch batch;
+    ListMeta meta;
+    std::string meta_val;
 
-        batch.Put(meta_key, meta_val);
-        EncodeListVal(val, 0, 0, en_val);
-        batch.Put(EncodeListKey(key, 1), en_val);
-        s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-        *llen = 1;
+    s = LGetIndexedMeta(key, meta);
+    if (s.IsNotFound()) {
+        return Status::NotFound("not found key");
+    } else if (!s.ok()) {
         return s;
+    }
+    if (meta.len <= 0) {
+        return Status::NotFound("not found key");
+    }
+
+    std::string db_key = EncodeListIndexKey(key, left ? meta.left : meta.right);
+    s = list_db_->Get(rocksdb::ReadOptions(), db_key, val);
+    if (!s.ok()) {
+        return Status::Corruption(left ? "get meta.left error" : "get meta.right error");
+    }
+    batch.Delete(db_key);
+
+    if (left) {
+        meta.left++;
     } else {
-        return Status::Corruption("get listmeta error");
+        meta.right--;
     }
+    --meta.len;
+    meta.vol -= key.size() + val->size();
+    if (meta.len == 0) {
+        meta = ListMeta();
+    }
+    meta.EncodeTo(meta_val);
+    batch.Put(EncodeLMetaKey(key), meta_val);
+    metrics_->profiler()->Meta(kLIST_DB, key, meta.len, meta.vol);
+    return list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
 }
 
-Status Nemo::LPop(const std::string &key, std::string *val) {
+Status Nemo::LPush(const std::string &key, const std::string &val, int64_t *llen) {
+    MetricsScope metrics(metrics_, kCmdLPush, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
 
-    Status s;
-    rocksdb::WriteBatch batch;
-    ListMeta meta;
-    std::string meta_val;
-
-    int64_t priv = 0;
-    int64_t next = 0;
-    std::string en_val;
-    std::string raw_val;
-    std::string meta_key = EncodeLMetaKey(key);
-    //MutexLock l(&mutex_list_);
     RecordLock l(&mutex_list_record_, key);
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.len <= 0) {
-                return Status::NotFound("not found key");
-            }
-
-            std::string db_key = EncodeListKey(key, meta.left);
-            s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val);
-            if (!s.ok()) {
-                return Status::Corruption("get meta.left error");
-            }
-            DecodeListVal(en_val, &priv, &next, *val);
-
-            meta.left = next;
-            if (next != 0) {
-                std::string l_key = EncodeListKey(key, next);
-                s = list_db_->Get(rocksdb::ReadOptions(), l_key, &en_val);
-                if (!s.ok()) {
-                    return Status::Corruption("get next left error");
-                }
-                DecodeListVal(en_val, &priv, &next, raw_val);
-                EncodeListVal(raw_val, 0, next, en_val);
-                batch.Put(l_key, en_val);
-            }
-
-            --meta.len;
-            meta.vol -= (key.size()+val->size());
-            if (meta.len == 0) {
-                meta.right = 0;
-                meta.cur_seq = 1;
-            }
-            //memcpy(meta_val, (char *)&meta, sizeof(ListMeta));
-            //batch.Put(meta_key, meta_val);
-            meta.EncodeTo(meta_val);
-            batch.Put(meta_key, meta_val);
+    return LPushNoLock(key, val, true, llen);
+}
 
-            batch.Delete(db_key);
-            s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-            return s;
-        } else {
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
-        return Status::NotFound("not found key");
-    } else {
-        return Status::Corruption("get listmeta error");
+Status Nemo::LPop(const std::string &key, std::string *val) {
+    MetricsScope metrics(metrics_, kCmdLPop, key);
+    if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
+       return Status::InvalidArgument("Invalid key length");
     }
+
+    RecordLock l(&mutex_list_record_, key);
+    return LPopNoLock(key, true, val);
 }
 
 Status Nemo::LPushx(const std::string &key, const std::string &val, int64_t *llen) {
@@ -409,133 +434,74 @@ Status Nemo::LPushx(const std::string &key, const std::string &val, int64_t *lle
     }
 }
 
+
 Status Nemo::LRange(const std::string &key, const int64_t begin, const int64_t end, std::vector<IV> &ivs) {
+    MetricsScope metrics(metrics_, kCmdLRange, key);
     Status s;
     ListMeta meta;
-    std::string meta_val;
-    std::string res;
-    std::string meta_key = EncodeLMetaKey(key);
-    std::string db_key;
-//    MutexLock l(&mutex_list_);
     RecordLock l(&mutex_list_record_, key);
 
-    const rocksdb::Snapshot* ss = list_db_->GetSnapshot();
-    rocksdb::ReadOptions rop = rocksdb::ReadOptions();
-    rop.snapshot = ss;
-    s = list_db_->Get(rop, meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.len == 0) {
-                return Status::NotFound("not found the key");
-            } else if (meta.len > 0) {
-                int64_t index_b = begin >= 0 ? begin : meta.len + begin;
-                int64_t index_e = end >= 0 ? end : meta.len + end;
-                if (index_b > index_e || index_b >= meta.len || index_e < 0) {
-                    list_db_->ReleaseSnapshot(ss);
-                    return Status::OK();
-                }
-                if (index_b < 0) {
-                    index_b = 0;
-                }
-                if (index_e >= meta.len) {
-                    index_e = meta.len - 1;
-                }
-                int64_t priv;
-                int64_t cur;
-                int64_t next;
-                if (L2R(key, index_b, meta.left, &priv, &cur, &next) != 0) {
-                    list_db_->ReleaseSnapshot(ss);
-                    return Status::Corruption("error in iterate");
-                }
-                int32_t t = index_e - index_b + 1;
-                std::string i_key;
-                std::string i_en_val;
-                std::string i_raw_val;
-                int32_t i = 0;
-                while (i<t) {
-                    i_key = EncodeListKey(key, cur);
-                    s = list_db_->Get(rocksdb::ReadOptions(), i_key, &i_en_val);
-                    if (!s.ok()) {
-                        break;
-                    }
-                    DecodeListVal(i_en_val, &priv, &next, i_raw_val);
-                    ivs.push_back(IV{i+index_b, i_raw_val});
-                    cur = next;
-                    i++;
-                }
-                if (i<t) {
-                    list_db_->ReleaseSnapshot(ss);
-                    return Status::Corruption("get element error");
-                }
-                list_db_->ReleaseSnapshot(ss);
-                return Status::OK();
-            } else {
-                list_db_->ReleaseSnapshot(ss);
-                return Status::Corruption("get invalid listlen");
-            }
-        } else {
-            list_db_->ReleaseSnapshot(ss);
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
-        list_db_->ReleaseSnapshot(ss);
+    s = LGetIndexedMeta(key, meta);
+    if (s.IsNotFound()) {
         return Status::NotFound("not found the key");
-    } else {
-        list_db_->ReleaseSnapshot(ss);
-        return Status::Corruption("get listmeta error");
+    } else if (!s.ok()) {
+        return s;
     }
+    if (meta.len == 0) {
+        return Status::NotFound("not found the key");
+    } else if (meta.len < 0) {
+        return Status::Corruption("get invalid listlen");
+    }
+
+    int64_t index_b = begin >= 0 ? begin : meta.len + begin;
+    int64_t index_e = end >= 0 ? end : meta.len + end;
+    if (index_b > index_e || index_b >= meta.len || index_e < 0) {
+        return Status::OK();
+    }
+    if (index_b < 0) {
+        index_b = 0;
+    }
+    if (index_e >= meta.len) {
+        index_e = meta.len - 1;
+    }
+
+    std::vector<std::string> vals;
+    vals.reserve(index_e - index_b + 1);
+    s = LGetPositions(key, meta.left + index_b, meta.left + index_e, &vals, NULL);
+    if (!s.ok()) {
+        return s;
+    }
+    ivs.reserve(ivs.size() + vals.size());
+    for (size_t i = 0; i < vals.size(); i++) {
+        ivs.push_back(IV{index_b + (int64_t)i, std::move(vals[i])});
+    }
+    return Status::OK();
 }
 
 Status Nemo::LSet(const std::string &key, const int64_t index, const std::string &val) {
+    MetricsScope metrics(metrics_, kCmdLSet, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
 
     Status s;
-    rocksdb::WriteBatch batch;
-    std::string meta_val;
     ListMeta meta;
-
-    int64_t priv;
-    int64_t cur;
-    int64_t next;
-    std::string en_val;
-    std::string meta_key = EncodeLMetaKey(key);
     RecordLock l(&mutex_list_record_, key);
-    //MutexLock l(&mutex_list_);
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.len <= 0) {
-                return Status::NotFound("not found key");
-            }
-            if ( index >= meta.len || -index > meta.len ) {
-                return Status::Corruption("index out of range");
-            }
-            if (index >= 0) {
-                if (L2R(key, index, meta.left, &priv, &cur, &next) != 0) {
-                    return Status::Corruption("error in iterate");
-                }
-            } else {
-                if (R2L(key, -index-1, meta.right, &priv, &cur, &next) != 0) {
-                    return Status::Corruption("error in iterate");
-                }
-            }
-            std::string db_key = EncodeListKey(key, cur);
-            s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val);
-            std::string raw_val;
-            DecodeListVal(en_val, &priv, &next, raw_val);
-            EncodeListVal(val, priv, next, en_val);
-            s = list_db_->Put(w_opts_nolog(), db_key, en_val);
-            return s;
-        } else {
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
+
+    s = LGetIndexedMeta(key, meta);
+    if (s.IsNotFound()) {
         return Status::NotFound("not found the key");
-    } else {
-        return Status::Corruption("get listmeta error");
+    } else if (!s.ok()) {
+        return s;
+    }
+    if (meta.len <= 0) {
+        return Status::NotFound("not found key");
+    }
+    if ( index >= meta.len || -index > meta.len ) {
+        return Status::Corruption("index out of range");
     }
+    int64_t pos = index >= 0 ? meta.left + index : meta.right + index + 1;
+    return list_db_->Put(w_opts_nolog(), EncodeListIndexKey(key, pos), val);
 }
 
 Status Nemo::LTrim(const std::string &key, const int64_t begin, const int64_t end) {
@@ -546,252 +512,90 @@ Status Nemo::LTrim(const std::string &key, const int64_t begin, const int64_t en
     Status s;
     ListMeta meta;
     std::string meta_val;
-    std::string meta_key = EncodeLMetaKey(key);
-    std::string db_key;
     rocksdb::WriteBatch batch;
     RecordLock l(&mutex_list_record_, key);
-    //MutexLock l(&mutex_list_);
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.len == 0) {
-                return Status::NotFound("not found the key");
-            } else if (meta.len > 0) {
-                int64_t index_b = begin >= 0 ? begin : meta.len + begin;
-                int64_t index_e = end >= 0 ? end : meta.len + end;
-                if (index_b > index_e || index_b >= meta.len || index_e < 0) {
-                    index_b = meta.len;
-                    index_e = meta.len;
-                }
-                if (index_b < 0) {
-                    index_b = 0;
-                }
-                if (index_e >= meta.len) {
-                    index_e = meta.len - 1;
-                }
-                int64_t trim_num = 0;
-                int64_t trim_vol = 0;
-                int64_t t_cur;
-                int64_t priv = 0;
-                int64_t next = 0;
-                std::string en_val;
-                std::string raw_val;
-                t_cur = meta.left;
-                for (int64_t i = 0; i < index_b; i++) {
-                    db_key = EncodeListKey(key, t_cur);
-                    s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val);
-                    DecodeListVal(en_val, &priv, &next, raw_val);
-                    batch.Delete(db_key);
-                    t_cur = next;
-                    trim_num++;
-                    trim_vol += key.size()+raw_val.size();
-                }
-                if (next != 0) {
-                    meta.left = next;
-                    //*((int64_t *)(meta_val.data() + sizeof(int64_t))) = next;
-                    std::string l_key = EncodeListKey(key, next);
-                    s = list_db_->Get(rocksdb::ReadOptions(), l_key, &en_val);
-                    if (!s.ok()) {
-                        return Status::Corruption("get next meta.left error");
-                    }
-                    DecodeListVal(en_val, &priv, &next, raw_val);
-                    EncodeListVal(raw_val, 0, next, en_val);
-                    s = list_db_->Put(w_opts_nolog(), l_key, en_val);
-                    //batch.Put(l_key, en_val);
-                }
-
-                priv = 0;
-                t_cur = meta.right;
-                for (int64_t i = meta.len - 1; i > index_e; i--) {
-                    db_key = EncodeListKey(key, t_cur);
-                    s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val);
-                    DecodeListVal(en_val, &priv, &next, raw_val);
-                    batch.Delete(db_key);
-                    t_cur = priv;
-                    trim_num++;
-                    trim_vol += key.size()+raw_val.size();
-                }
-                if (priv != 0) {
-                    meta.right = priv;
-                    //*((int64_t *)(meta_val.data() + sizeof(int64_t) * 2)) = priv;
-                    std::string r_key = EncodeListKey(key, priv);
-                    s = list_db_->Get(rocksdb::ReadOptions(), r_key, &en_val);
-                    if (!s.ok()) {
-                        return Status::Corruption("get next meta.right error");
-                    }
-                    DecodeListVal(en_val, &priv, &next, raw_val);
-                    EncodeListVal(raw_val, priv, 0, en_val);
-                    s = list_db_->Put(w_opts_nolog(), r_key, en_val);
-                    //batch.Put(r_key, en_val);
-                }
-                if (trim_num < meta.len) {
-                    meta.len -= trim_num;
-                    meta.vol -= trim_vol;
-                } else {
-                   meta = ListMeta(); 
-                }
-
-                //memcpy(meta_val, (char *)&meta, sizeof(ListMeta));
-                //batch.Put(meta_key, std::string((char *)&meta, sizeof(ListMeta)));
-
-                meta.EncodeTo(meta_val);
-                batch.Put(meta_key, meta_val);
-                s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-                return s;
-            } else {
-                return Status::Corruption("get invalid listlen");
-            }
-        } else {
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
+
+    s = LGetIndexedMeta(key, meta);
+    if (s.IsNotFound()) {
+        return Status::NotFound("not found the key");
+    } else if (!s.ok()) {
+        return s;
+    }
+    if (meta.len == 0) {
         return Status::NotFound("not found the key");
+    } else if (meta.len < 0) {
+        return Status::Corruption("get invalid listlen");
+    }
+
+    int64_t index_b = begin >= 0 ? begin : meta.len + begin;
+    int64_t index_e = end >= 0 ? end : meta.len + end;
+    if (index_b > index_e || index_b >= meta.len || index_e < 0) {
+        index_b = meta.len;
+        index_e = meta.len;
+    }
+    if (index_b < 0) {
+        index_b = 0;
+    }
+    if (index_e >= meta.len) {
+        index_e = meta.len - 1;
+    }
+
+    // keep the positions [keep_b, keep_e], empty when keep_b > keep_e
+    int64_t keep_b = meta.left + index_b;
+    int64_t keep_e = meta.left + index_e;
+    int64_t trim_vol = 0;
+    if (keep_b > meta.left) {
+        s = LGetPositions(key, meta.left, std::min(keep_b, meta.right + 1) - 1, NULL, &trim_vol);
+        if (!s.ok()) {
+            return s;
+        }
+        for (int64_t pos = meta.left; pos < keep_b && pos <= meta.right; pos++) {
+            batch.Delete(EncodeListIndexKey(key, pos));
+        }
+    }
+    if (keep_e < meta.right) {
+        int64_t from = std::max(keep_e, keep_b - 1) + 1;
+        s = LGetPositions(key, from, meta.right, NULL, &trim_vol);
+        if (!s.ok()) {
+            return s;
+        }
+        for (int64_t pos = from; pos <= meta.right; pos++) {
+            batch.Delete(EncodeListIndexKey(key, pos));
+        }
+    }
+
+    if (keep_b <= keep_e) {
+        meta.len = keep_e - keep_b + 1;
+        meta.vol -= trim_vol;
+        meta.left = keep_b;
+        meta.right = keep_e;
     } else {
-        return Status::Corruption("get listmeta error");
+        meta = ListMeta();
     }
+    meta.EncodeTo(meta_val);
+    batch.Put(EncodeLMetaKey(key), meta_val);
+    metrics_->profiler()->Meta(kLIST_DB, key, meta.len, meta.vol);
+    return list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
 }
 
 Status Nemo::RPush(const std::string &key, const std::string &val, int64_t *llen) {
+    MetricsScope metrics(metrics_, kCmdRPush, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
 
-    Status s;
-    rocksdb::WriteBatch batch;
-    ListMeta meta;
-    std::string meta_val;
-
-    int64_t priv;
-    int64_t next;
-    std::string en_val;
-    std::string raw_val;
-    std::string meta_key = EncodeLMetaKey(key);
-    //MutexLock l(&mutex_list_);
     RecordLock l(&mutex_list_record_, key);
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.right != 0) {
-                std::string r_key = EncodeListKey(key, meta.right);
-                s = list_db_->Get(rocksdb::ReadOptions(), r_key, &en_val);
-                if (!s.ok()) {
-                    return Status::Corruption("get meta.right error");
-                }
-                DecodeListVal(en_val, &priv, &next, raw_val);
-                EncodeListVal(raw_val, priv, meta.cur_seq, en_val);
-                batch.Put(r_key, en_val);
-            }
-
-            std::string db_key = EncodeListKey(key, meta.cur_seq);
-            EncodeListVal(val, meta.right, 0, en_val);
-            batch.Put(db_key, en_val);
-
-            meta.len++;
-            meta.vol += key.size() + val.size();
-            if (meta.left == 0) {
-              meta.left = meta.cur_seq;
-            }
-            meta.right = meta.cur_seq;
-            ++meta.cur_seq;
-            //memcpy(meta_val, (char *)&meta, sizeof(ListMeta));
-            //batch.Put(meta_key, meta_val);
-
-            //batch.Put(meta_key, std::string((char *)&meta, sizeof(ListMeta)));
-
-            meta.EncodeTo(meta_val);
-            batch.Put(meta_key, meta_val);
-            s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-            *llen = meta.len;
-            return s;
-        } else {
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
-        ListMeta meta(1, val.size() ,1, 1, 2);
-        
-        //std::string meta_val((char *)&meta, 4 * sizeof(int64_t));
-        
-        meta.EncodeTo(meta_val);
-        batch.Put(meta_key, meta_val);
-        EncodeListVal(val, 0, 0, en_val);
-        batch.Put(EncodeListKey(key, 1), en_val);
-        s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-        *llen = 1;
-        return s;
-    } else {
-        return Status::Corruption("get listmeta error");
-    }
+    return LPushNoLock(key, val, false, llen);
 }
 
 Status Nemo::RPop(const std::string &key, std::string *val) {
+    MetricsScope metrics(metrics_, kCmdRPop, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
 
-    Status s;
-    rocksdb::WriteBatch batch;
-    ListMeta meta;
-    std::string meta_val;
-
-    int64_t priv = 0;
-    int64_t next = 0;
-    std::string en_val;
-    std::string raw_val;
-    std::string meta_key = EncodeLMetaKey(key);
-    //MutexLock l(&mutex_list_);
     RecordLock l(&mutex_list_record_, key);
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.len <= 0) {
-                return Status::NotFound("not found key");
-            }
-
-            std::string db_key = EncodeListKey(key, meta.right);
-            s = list_db_->Get(rocksdb::ReadOptions(), db_key, &en_val);
-            if (!s.ok()) {
-                return Status::Corruption("get meta.right error");
-            }
-            DecodeListVal(en_val, &priv, &next, *val);
-
-            meta.right = priv;
-
-            if (priv != 0) {
-                std::string r_key = EncodeListKey(key, priv);
-                s = list_db_->Get(rocksdb::ReadOptions(), r_key, &en_val);
-                if (!s.ok()) {
-                    return Status::Corruption("get next meta.right error");
-                }
-                DecodeListVal(en_val, &priv, &next, raw_val);
-                EncodeListVal(raw_val, priv, 0, en_val);
-                batch.Put(r_key, en_val);
-            }
-            
-            --meta.len;
-            meta.vol -= (key.size()+ val->size());
-            if (meta.len == 0) {
-                meta.left = 0;
-                meta.cur_seq = 1;
-            }
-            //memcpy(meta_val, (char *)&meta, sizeof(ListMeta));
-            //batch.Put(meta_key, meta_val);
-
-            //batch.Put(meta_key, std::string((char *)&meta, sizeof(ListMeta)));
-
-            meta.EncodeTo(meta_val);
-            batch.Put(meta_key, meta_val);
-
-            batch.Delete(db_key);
-            s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-            return s;
-        } else {
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
-        return Status::NotFound("not found key");
-    } else {
-        return Status::Corruption("get listmeta error");
-    }
+    return LPopNoLock(key, false, val);
 }
 
 Status Nemo::RPushx(const std::string &key, const std::string &val, int64_t *llen) {
@@ -827,133 +631,30 @@ Status Nemo::RPushx(const std::string &key, const std::string &val, int64_t *lle
 }
 
 
+
 Status Nemo::RPopLPushInternal(const std::string &src, const std::string &dest, std::string &val) {
     if (src.size() >= KEY_MAX_LENGTH || src.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
-    Status s;
-    rocksdb::WriteBatch batch;
-    ListMeta meta;
-    std::string meta_r;
-    std::string meta_l;
-    std::string db_key_r;
-    std::string meta_key_r = EncodeLMetaKey(src);
-    std::string db_key_l;
-    std::string meta_key_l = EncodeLMetaKey(dest);
-
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key_r, &meta_r);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_r)) {
-            if (meta.len == 0 || meta.right == 0) {
-                return Status::NotFound("not found the source key");
-            }
-            std::string en_val;
-            std::string raw_val;
-            int64_t priv = 0;
-            int64_t next = 0;
-            db_key_r = EncodeListKey(src, meta.right);
-            s = list_db_->Get(rocksdb::ReadOptions(), db_key_r, &en_val);
-            DecodeListVal(en_val, &priv, &next, val);
-            meta.right = priv;
-            if (priv != 0) {
-                std::string r_key = EncodeListKey(src, priv);
-                s = list_db_->Get(rocksdb::ReadOptions(), r_key, &en_val);
-                if (!s.ok()) {
-                    return Status::Corruption("get next meta.right error");
-                }
-                DecodeListVal(en_val, &priv, &next, raw_val);
-                EncodeListVal(raw_val, priv, 0, en_val);
-                batch.Put(r_key, en_val);
-            }
-            --meta.len;
-            meta.vol -= (src.size()+val.size());
-            if (meta.len == 0) { // change meta.left to 0 when no element
-                meta.left = 0;
-            }
-            //memcpy(meta_r, (char *)&meta, sizeof(ListMeta));
-            //s = list_db_->Put(w_opts_nolog(), meta_key_r, meta_r);
-
-            std::string meta_val;
-            meta.EncodeTo(meta_val);
-            s = list_db_->Put(w_opts_nolog(), meta_key_r, meta_val);
-            
-            batch.Delete(db_key_r);
-            s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-        }
-    } else if (s.IsNotFound()) {
+    Status s = LPopNoLock(src, false, &val);
+    if (s.IsNotFound()) {
         return Status::NotFound("not found the source key");
-    } else {
-        return Status::Corruption("get listmeta error");
-    }
-
-    rocksdb::WriteBatch batch_d;
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key_l, &meta_l);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_l)) {
-            std::string en_val;
-
-            if (meta.left > 0) {
-                db_key_l = EncodeListKey(dest, meta.left);
-                std::string raw_val;
-                int64_t priv = 0;
-                int64_t next = 0;
-                s = list_db_->Get(rocksdb::ReadOptions(), db_key_l, &en_val);
-                DecodeListVal(en_val, &priv, &next, raw_val);
-                EncodeListVal(raw_val, meta.cur_seq, next, en_val);
-                batch.Put(db_key_l, en_val);
-            }
-
-            db_key_l = EncodeListKey(dest, meta.cur_seq);
-            EncodeListVal(val, 0, meta.left, en_val);
-            batch_d.Put(db_key_l, en_val);
-            meta.len++;
-            meta.vol += dest.size()+val.size();
-            meta.left = meta.cur_seq;
-            if (meta.right == 0) {
-              meta.right = meta.cur_seq;
-            }
-            ++meta.cur_seq;
-            //memcpy(meta_l, (char *)&meta, sizeof(ListMeta));
-            //batch.Put(meta_key_l, meta_l);
-
-            std::string meta_val;
-            meta.EncodeTo(meta_val);
-            batch_d.Put(meta_key_l, meta_val); 
-            s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch_d);
-            return s;
-        } else {
-            return Status::Corruption("parse listmeta error");
-        }
-    } else if (s.IsNotFound()) {
-        ListMeta meta(1, val.size() , 1, 1, 2);
-        std::string en_val;
-        
-        //std::string meta_str((char *)meta, 4 * sizeof(int64_t));
-        //batch.Put(meta_key_l, meta_str);
-        //batch.Put(meta_key_l, std::string((char *)&meta, sizeof(ListMeta)));
-
-        std::string meta_val;
-        meta.EncodeTo(meta_val);
-        batch_d.Put(meta_key_l, meta_val);
-
-        EncodeListVal(val, 0, 0, en_val);
-        batch_d.Put(EncodeListKey(dest, 1), en_val);
-        s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch_d);
+    } else if (!s.ok()) {
         return s;
-    } else {
-        return Status::Corruption("get listmeta error");
     }
+    int64_t llen;
+    return LPushNoLock(dest, val, true, &llen);
 }
 Status Nemo::RPopLPush(const std::string &src, const std::string &dest, std::string &val) {
-    RecordLock l1(&mutex_list_record_, dest);
-    if (src == dest) {
-      return RPopLPushInternal(src, dest, val);
-    } else {
-      RecordLock l2(&mutex_list_record_, src);
-      return RPopLPushInternal(src, dest, val);
-    }
+    std::vector<std::string> lock_keys;
+    lock_keys.push_back(src);
+    lock_keys.push_back(dest);
+    MultiRecordLock l(&mutex_list_record_, lock_keys);
+    return RPopLPushInternal(src, dest, val);
 }
 
+
+// The elements on the shorter side of the new one move by one position
 Status Nemo::LInsert(const std::string &key, Position pos, const std::string &pivot, const std::string &val, int64_t *llen) {
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
@@ -963,104 +664,79 @@ Status Nemo::LInsert(const std::string &key, Position pos, const std::string &pi
     rocksdb::WriteBatch batch;
     ListMeta meta;
     std::string meta_val;
-    int64_t before_seq;
-    int64_t after_seq;
-
-    int64_t priv;
-    int64_t next;
-    std::string en_val;
-    std::string raw_val;
-    std::string meta_key = EncodeLMetaKey(key);
-    //MutexLock l(&mutex_list_);
     RecordLock l(&mutex_list_record_, key);
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
 
-            // traverse to find pivot
-            next = meta.left;
-            int64_t tmp_seq;
-            do {
-              tmp_seq = next;
-              std::string cur_listkey = EncodeListKey(key, tmp_seq);
-              s = list_db_->Get(rocksdb::ReadOptions(), cur_listkey, &en_val);
-              if (!s.ok()) {
-                return Status::Corruption("get listkey error");
-              }
-              DecodeListVal(en_val, &priv, &next, raw_val);
-            } while (next != 0 && raw_val != pivot);
-
-            if (raw_val == pivot) {
-                if (pos == AFTER) {
-                    before_seq = tmp_seq;
-                    after_seq = next;
-                } else {
-                    before_seq = priv;
-                    after_seq = tmp_seq;
-                }
-
-                // modify before node
-                if (before_seq != 0) {
-                    std::string cur_listkey = EncodeListKey(key, before_seq);
-                    s = list_db_->Get(rocksdb::ReadOptions(), cur_listkey, &en_val);
-                    if (!s.ok()) {
-                        return Status::Corruption("get listkey error");
-                    }
-                    DecodeListVal(en_val, &priv, &next, raw_val);
-                    EncodeListVal(raw_val, priv, meta.cur_seq, en_val);
-                    batch.Put(cur_listkey, en_val);
-                }
-                // modify after node
-                if (after_seq != 0) {
-                    std::string cur_listkey = EncodeListKey(key, after_seq);
-                    s = list_db_->Get(rocksdb::ReadOptions(), cur_listkey, &en_val);
-                    if (!s.ok()) {
-                        return Status::Corruption("get listkey error");
-                    }
-                    DecodeListVal(en_val, &priv, &next, raw_val);
-                    EncodeListVal(raw_val, meta.cur_seq, next, en_val);
-                    batch.Put(cur_listkey, en_val);
-                }
-                // add new node
-                std::string add_key = EncodeListKey(key, meta.cur_seq);
-                EncodeListVal(val, before_seq, after_seq, en_val);
-                batch.Put(add_key, en_val);
-
-                meta.len++;
-                meta.vol += key.size()+ val.size();
-                if (before_seq == 0) {
-                    meta.left = meta.cur_seq;
-                }
-                if (after_seq == 0) {
-                    meta.right = meta.cur_seq;
-                }
-                ++meta.cur_seq;
-                //memcpy(meta_val, (char *)&meta, sizeof(ListMeta));
-                //batch.Put(meta_key, meta_val);
-                
-                //batch.Put(meta_key, std::string((char *)&meta, sizeof(ListMeta)));
-
-                meta.EncodeTo(meta_val);
-                batch.Put(meta_key, meta_val);
-                s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-                *llen = meta.len;
-                return s;
-            } else {
-                *llen = -1;
+    s = LGetIndexedMeta(key, meta);
+    if (!s.ok()) {
+        *llen = 0;
+        return s;
+    }
+    if (meta.len <= 0) {
+        *llen = 0;
+        return Status::NotFound("not found the key");
+    }
+
+    // traverse to find pivot
+    int64_t index = -1;
+    int64_t i = 0;
+    rocksdb::Iterator *it = list_db_->NewIterator(rocksdb::ReadOptions());
+    for (it->Seek(EncodeListIndexKey(key, meta.left)); i < meta.len && it->Valid(); it->Next(), i++) {
+        if (it->key() != EncodeListIndexKey(key, meta.left + i)) {
+            break;
+        }
+        if (it->value() == pivot) {
+            index = i;
+            break;
+        }
+    }
+    delete it;
+    if (index == -1) {
+        if (i < meta.len) {
+            return Status::Corruption("get element error");
+        }
+        *llen = -1;
+        return Status::OK();
+    }
+
+    // the new element takes index ins
+    int64_t ins = (pos == AFTER) ? index + 1 : index;
+    std::vector<std::string> vals;
+    if (ins < meta.len - ins) {
+        if (ins > 0) {
+            s = LGetPositions(key, meta.left, meta.left + ins - 1, &vals, NULL);
+            if (!s.ok()) {
                 return s;
             }
-        } else {
-            return Status::Corruption("parse listmeta error");
         }
-    } else if (s.IsNotFound()) {
-        *llen = 0;
-        return s;
+        for (int64_t j = 0; j < ins; j++) {
+            batch.Put(EncodeListIndexKey(key, meta.left + j - 1), vals[j]);
+        }
+        meta.left--;
     } else {
-        *llen = 0;
-        return Status::Corruption("get key error");
+        if (ins < meta.len) {
+            s = LGetPositions(key, meta.left + ins, meta.right, &vals, NULL);
+            if (!s.ok()) {
+                return s;
+            }
+        }
+        for (size_t j = 0; j < vals.size(); j++) {
+            batch.Put(EncodeListIndexKey(key, meta.left + ins + j + 1), vals[j]);
+        }
+        meta.right++;
     }
+    batch.Put(EncodeListIndexKey(key, meta.left + ins), val);
+
+    meta.len++;
+    meta.vol += key.size() + val.size();
+    meta.EncodeTo(meta_val);
+    batch.Put(EncodeLMetaKey(key), meta_val);
+    metrics_->profiler()->Meta(kLIST_DB, key, meta.len, meta.vol);
+    s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+    *llen = meta.len;
+    return s;
 }
 
+// The kept elements close the holes towards whichever end moves fewer of them
 Status Nemo::LRem(const std::string &key, const int64_t count, const std::string &val, int64_t *rem_count) {
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
@@ -1068,110 +744,91 @@ Status Nemo::LRem(const std::string &key, const int64_t count, const std::string
 
     Status s;
     rocksdb::WriteBatch batch;
-    std::string meta_val;
     ListMeta meta;
-
-    int64_t priv;
-    int64_t next;
-    std::string en_val;
-    std::string raw_val;
+    std::string meta_val;
     std::string meta_key = EncodeLMetaKey(key);
-    //MutexLock l(&mutex_list_);
     RecordLock l(&mutex_list_record_, key);
-    s = list_db_->Get(rocksdb::ReadOptions(), meta_key, &meta_val);
-    if (s.ok()) {
-        if (meta.DecodeFrom(meta_val)) {
-            if (meta.len == 0) {
-                *rem_count = 0;
-                return Status::NotFound("not found key");
-            }
 
-            int64_t tmp_seq;
-            int64_t tmp_priv, tmp_next;
-            priv = meta.right;
-            next = meta.left;
-            *rem_count = 0;
+    *rem_count = 0;
+    s = LGetIndexedMeta(key, meta);
+    if (!s.ok()) {
+        return s;
+    }
+    if (meta.len <= 0) {
+        return Status::NotFound("not found key");
+    }
 
-            int64_t total_rem = abs(count);
-            if (total_rem > meta.len) {
-                total_rem = meta.len;
-            }
+    std::vector<std::string> vals;
+    vals.reserve(meta.len);
+    s = LGetPositions(key, meta.left, meta.right, &vals, NULL);
+    if (!s.ok()) {
+        return s;
+    }
 
-            do {
-              if (meta.len == 0) return s;
-
-              if (count < 0) {
-                  tmp_seq = priv;
-              } else {
-                  tmp_seq = next;
-              }
-
-              std::string cur_listkey = EncodeListKey(key, tmp_seq);
-              s = list_db_->Get(rocksdb::ReadOptions(), cur_listkey, &en_val);
-              if (!s.ok()) {
-                return Status::Corruption("get listkey error");
-              }
-              DecodeListVal(en_val, &priv, &next, raw_val);
-
-              if (raw_val == val) {
-                (*rem_count)++;
-
-                // modify before node
-                if (priv != 0) {
-                    std::string priv_listkey = EncodeListKey(key, priv);
-                    s = list_db_->Get(rocksdb::ReadOptions(), priv_listkey, &en_val);
-                    if (!s.ok()) {
-                        return Status::Corruption("get listkey error");
-                    }
-                    DecodeListVal(en_val, &tmp_priv, &tmp_next, raw_val);
-                    EncodeListVal(raw_val, tmp_priv, next, en_val);
-                    batch.Put(priv_listkey, en_val);
-                }
-                // modify after node
-                if (next != 0) {
-                    std::string next_listkey = EncodeListKey(key, next);
-                    s = list_db_->Get(rocksdb::ReadOptions(), next_listkey, &en_val);
-                    if (!s.ok()) {
-                        return Status::Corruption("get listkey error");
-                    }
-                    DecodeListVal(en_val, &tmp_priv, &tmp_next, raw_val);
-                    EncodeListVal(raw_val, priv, tmp_next, en_val);
-                    batch.Put(next_listkey, en_val);
-                }
-                // delete new node
-                batch.Delete(cur_listkey);
-
-                meta.len--;
-                meta.vol -= (key.size()+val.size());
-                if (meta.len == 0) {
-                  batch.Delete(meta_key);
-                } else {
-                  if (priv == 0) {
-                    meta.left = next;
-                  }
-                  if (next == 0) {
-                    meta.right = priv;
-                  }
-                  //memcpy(meta_val, (char *)&meta, sizeo(ListMeta));
-                  //batch.Put(meta_key, meta_val);
-
-                  meta.EncodeTo(meta_val);
-                  batch.Put(meta_key, meta_val);
-                }
-                s = list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-              }
-            } while ((count == 0 || *rem_count < total_rem) 
-                     && ((count < 0 && priv != 0) || (count >= 0 && next != 0)));
-            return Status::OK();
-        } else {
-            return Status::Corruption("parse listmeta error");
+    int64_t total_rem = count < 0 ? -count : count;
+    if (count == 0 || total_rem > meta.len) {
+        total_rem = meta.len;
+    }
+    std::vector<bool> removed(meta.len, false);
+    int64_t first = meta.len;
+    int64_t last = -1;
+    for (int64_t k = 0; k < meta.len && *rem_count < total_rem; k++) {
+        int64_t i = count < 0 ? meta.len - 1 - k : k;
+        if (vals[i] == val) {
+            removed[i] = true;
+            (*rem_count)++;
+            first = std::min(first, i);
+            last = std::max(last, i);
         }
-    } else if (s.IsNotFound()) {
-        *rem_count = 0;
-        return s;
+    }
+    if (*rem_count == 0) {
+        return Status::OK();
+    }
+
+    if (last + 1 <= meta.len - first) {
+        // shift [0, last] towards the tail
+        int64_t j = last;
+        for (int64_t i = last; i >= 0; i--) {
+            if (removed[i]) {
+                continue;
+            }
+            if (i != j) {
+                batch.Put(EncodeListIndexKey(key, meta.left + j), vals[i]);
+            }
+            j--;
+        }
+        for (int64_t i = 0; i <= j; i++) {
+            batch.Delete(EncodeListIndexKey(key, meta.left + i));
+        }
+        meta.left += j + 1;
     } else {
-        return Status::Corruption("get key error");
+        // shift [first, len) towards the head
+        int64_t j = first;
+        for (int64_t i = first; i < meta.len; i++) {
+            if (removed[i]) {
+                continue;
+            }
+            if (i != j) {
+                batch.Put(EncodeListIndexKey(key, meta.left + j), vals[i]);
+            }
+            j++;
+        }
+        for (int64_t i = j; i < meta.len; i++) {
+            batch.Delete(EncodeListIndexKey(key, meta.left + i));
+        }
+        meta.right = meta.left + j - 1;
     }
+
+    meta.len -= *rem_count;
+    meta.vol -= *rem_count * (key.size() + val.size());
+    metrics_->profiler()->Meta(kLIST_DB, key, meta.len, meta.vol);
+    if (meta.len == 0) {
+        batch.Delete(meta_key);
+    } else {
+        meta.EncodeTo(meta_val);
+        batch.Put(meta_key, meta_val);
+    }
+    return list_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
 }
 
 Status Nemo::LDelKey(const std::string &key, int64_t *res) {
@@ -1197,6 +854,7 @@ Status Nemo::LDelKey(const std::string &key, int64_t *res) {
         std::string new_val;
         meta.EncodeTo(new_val);
         s = list_db_->PutWithKeyVersion(rocksdb::WriteOptions(), meta_key, new_val);
+        metrics_->profiler()->Meta(kLIST_DB, key, 0, 0);
       }
     }
 
@@ -1227,7 +885,10 @@ Status Nemo::LExpire(const std::string &key, const int32_t seconds, int64_t *res
 
         if (seconds > 0) {
             //MutexLock l(&mutex_list_);
-            s = list_db_->Put(w_opts_nolog(), meta_key, meta_val, seconds);
+            s = expire_sweeper_->Index(DataType::kLMeta, key, std::time(0) + seconds);
+            if (s.ok()) {
+                s = list_db_->Put(w_opts_nolog(), meta_key, meta_val, seconds);
+            }
         } else { 
             int64_t count; 
             s = LDelKey(key, &count);
@@ -1329,7 +990,10 @@ Status Nemo::LExpireat(const std::string &key, const int32_t timestamp, int64_t
         s = LDelKey(key, &count);
       } else { 
         //MutexLock l(&mutex_list_);
-        s = list_db_->PutWithExpiredTime(w_opts_nolog(), meta_key, meta_val, timestamp);
+        s = expire_sweeper_->Index(DataType::kLMeta, key, timestamp);
+        if (s.ok()) {
+          s = list_db_->PutWithExpiredTime(w_opts_nolog(), meta_key, meta_val, timestamp);
+        }
       }
     }
 
@@ -1353,7 +1017,48 @@ LmetaIterator * Nemo::LmetaScan( const std::string &start, const std::string &en
 
     IteratorOptions iter_options(key_end, limit, read_options);
     
+    return new LmetaIterator(list_db_.get(), iter_options, key_start); 
+}
+
+Status Nemo::LConvert(const std::string &key) {
+    if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
+       return Status::InvalidArgument("Invalid key length");
+    }
+
+    ListMeta meta;
+    RecordLock l(&mutex_list_record_, key);
+    return LGetIndexedMeta(key, meta);
+}
+
+Status Nemo::LConvertAll(int64_t *converted) {
+    Status s;
+    ListMeta meta;
+    std::vector<std::string> keys;
+    rocksdb::ReadOptions read_options;
+    read_options.fill_cache = false;
+
+    // Collect the linked lists first, each one is converted under its lock
     rocksdb::Iterator *it = list_db_->NewIterator(read_options);
-    it->Seek(key_start);
-    return new LmetaIterator(it, list_db_.get(), iter_options,start); 
+    for (it->Seek(std::string(1, DataType::kLMeta)); it->Valid(); it->Next()) {
+        rocksdb::Slice meta_key = it->key();
+        if (meta_key[0] != DataType::kLMeta) {
+            break;
+        }
+        if (meta.DecodeFrom(it->value().ToString()) && meta.encoding == ListMeta::kLinked && meta.len > 0) {
+            keys.push_back(std::string(meta_key.data() + 1, meta_key.size() - 1));
+        }
+    }
+    delete it;
+
+    *converted = 0;
+    for (size_t i = 0; i < keys.size(); i++) {
+        s = LConvert(keys[i]);
+        if (s.IsNotFound()) {
+            continue;
+        } else if (!s.ok()) {
+            return s;
+        }
+        (*converted)++;
+    }
+    return Status::OK();
 }
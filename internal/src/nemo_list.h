@@ -62,6 +62,34 @@ inline int DecodeListKey(const rocksdb::Slice &slice, std::string *key, int64_t
     return 0;
 }
 
+// Keys of kIndexed lists end with the big endian position, its sign bit
+// flipped so that negative positions sort before the positive ones.
+inline std::string EncodeListIndexKey(const rocksdb::Slice &key, const int64_t pos) {
+    std::string buf;
+    buf.append(1, DataType::kList);
+    buf.append(1, (uint8_t)key.size());
+    buf.append(key.data(), key.size());
+    uint64_t upos = htobe64((uint64_t)pos ^ (1ULL << 63));
+    buf.append((char *)&upos, sizeof(uint64_t));
+    return buf;
+}
+
+inline int DecodeListIndexKey(const rocksdb::Slice &slice, std::string *key, int64_t *pos) {
+    Decoder decoder(slice.data(), slice.size());
+    uint64_t upos;
+    if (decoder.Skip(1) == -1) {
+        return -1;
+    }
+    if (decoder.ReadLenData(key) == -1) {
+        return -1;
+    }
+    if (decoder.ReadUInt64(&upos) == -1) {
+        return -1;
+    }
+    *pos = (int64_t)(upos ^ (1ULL << 63));
+    return 0;
+}
+
 inline void EncodeListVal(const std::string &raw_val, const int64_t priv, const int64_t next, std::string &en_val) {
     en_val.clear();
     en_val.append((char *)&priv, sizeof(int64_t));
@@ -0,0 +1,93 @@
+#ifndef NEMO_INCLUDE_NEMO_MERGE_H_
+#define NEMO_INCLUDE_NEMO_MERGE_H_
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace nemo {
+
+// K way merge of member ordered iterators, the SIterator or ZLexIterator of
+// every source set of a store command. A heap of the source heads yields the
+// members in order, each once with the sources holding it, so the sources are
+// read in one pass and nothing but the heads is kept in memory.
+template <typename Iter>
+class MemberMerger {
+public:
+    // Takes the iterators, a NULL one is an empty source
+    explicit MemberMerger(const std::vector<Iter *> &iters)
+        : iters_(iters), heads_(iters.size()), cmp_(this) {
+        for (size_t i = 0; i < iters_.size(); i++) {
+            Push(i);
+        }
+        Load();
+    }
+
+    ~MemberMerger() {
+        for (size_t i = 0; i < iters_.size(); i++) {
+            delete iters_[i];
+        }
+    }
+
+    bool Valid() { return !sources_.empty(); }
+    // The least member left and the sources holding it, in ascending order
+    const std::string &member() { return member_; }
+    const std::vector<int> &sources() { return sources_; }
+    // Source i, at member() if it holds it. It is not Valid once drained.
+    Iter *iter(int i) { return iters_[i]; }
+    // Sources not drained yet
+    int live() { return heap_.size() + sources_.size(); }
+
+    void Next() {
+        for (size_t i = 0; i < sources_.size(); i++) {
+            iters_[sources_[i]]->Next();
+            Push(sources_[i]);
+        }
+        Load();
+    }
+
+private:
+    struct Greater {
+        MemberMerger *m;
+        explicit Greater(MemberMerger *_m) : m(_m) {}
+        bool operator()(int a, int b) const {
+            int c = m->heads_[a].compare(m->heads_[b]);
+            return c > 0 || (c == 0 && a > b);
+        }
+    };
+
+    std::vector<Iter *> iters_;
+    std::vector<std::string> heads_;
+    std::vector<int> heap_;
+    Greater cmp_;
+    std::string member_;
+    std::vector<int> sources_;
+
+    void Push(int i) {
+        if (iters_[i] != NULL && iters_[i]->Valid()) {
+            heads_[i] = iters_[i]->member().ToString();
+            heap_.push_back(i);
+            std::push_heap(heap_.begin(), heap_.end(), cmp_);
+        }
+    }
+
+    void Load() {
+        sources_.clear();
+        if (heap_.empty()) {
+            return;
+        }
+        member_ = heads_[heap_.front()];
+        while (!heap_.empty() && heads_[heap_.front()] == member_) {
+            std::pop_heap(heap_.begin(), heap_.end(), cmp_);
+            sources_.push_back(heap_.back());
+            heap_.pop_back();
+        }
+    }
+
+    //No Copying Allowed
+    MemberMerger(const MemberMerger&);
+    void operator=(const MemberMerger&);
+};
+
+}
+#endif
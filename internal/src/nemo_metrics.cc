@@ -0,0 +1,291 @@
+#include <sys/time.h>
+#include <string.h>
+#include <algorithm>
+
+#include "nemo_metrics.h"
+#include "rocksdb/perf_context.h"
+
+namespace nemo {
+
+static const char *kCommandNames[kCmdCount] = {
+    "set", "get", "mset", "mget", "del", "mdel", "incrby", "setnx",
+    "expire", "ttl", "exists",
+    "hset", "hget", "hdel", "hmset", "hmget", "hgetall", "hlen", "hincrby",
+    "hexists",
+    "lpush", "rpush", "lpop", "rpop", "lrange", "lindex", "llen", "lset",
+    "sadd", "srem", "smembers", "sismember", "scard", "spop",
+    "zadd", "zrem", "zscore", "zrange", "zrangebyscore", "zrank", "zincrby"
+};
+
+static uint64_t NowMicros() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static void Add(std::atomic<uint64_t> *counter, uint64_t value) {
+    counter->fetch_add(value, std::memory_order_relaxed);
+}
+
+static uint64_t Load(const std::atomic<uint64_t> &counter) {
+    return counter.load(std::memory_order_relaxed);
+}
+
+int LatencyHistogram::Bucket(uint64_t value) {
+    if (value < (1u << kSubBits)) {
+        return static_cast<int>(value);
+    }
+    int exp = 63 - __builtin_clzll(value);
+    if (exp >= kMaxBits) {
+        return kBuckets - 1;
+    }
+    int sub = static_cast<int>(value >> (exp - kSubBits)) & ((1 << kSubBits) - 1);
+    return (1 << kSubBits) + (exp - kSubBits) * (1 << kSubBits) + sub;
+}
+
+uint64_t LatencyHistogram::BucketMax(int bucket) {
+    if (bucket < (1 << kSubBits)) {
+        return bucket;
+    }
+    int exp = (bucket - (1 << kSubBits)) / (1 << kSubBits) + kSubBits;
+    uint64_t sub = (bucket - (1 << kSubBits)) % (1 << kSubBits);
+    uint64_t lower = ((1ull << kSubBits) + sub) << (exp - kSubBits);
+    return lower + (1ull << (exp - kSubBits)) - 1;
+}
+
+uint64_t LatencyHistogram::Percentile(const uint64_t *buckets, uint64_t count, double rank) {
+    if (count == 0) {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(count * rank);
+    if (target >= count) {
+        target = count - 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; i++) {
+        seen += buckets[i];
+        if (seen > target) {
+            return BucketMax(i);
+        }
+    }
+    return BucketMax(kBuckets - 1);
+}
+
+Metrics::Metrics()
+    : enabled_(false),
+    perf_sample_(0),
+    shards_(NULL),
+    next_shard_(0) {
+}
+
+Metrics::~Metrics() {
+    delete [] shards_.load();
+}
+
+void Metrics::Enable(bool enabled, int perf_sample) {
+    mu_.Lock();
+    if (enabled && shards_.load() == NULL) {
+        Shard *shards = new Shard[kShards];
+        memset(static_cast<void *>(shards), 0, sizeof(Shard) * kShards);
+        shards_.store(shards);
+    }
+    perf_sample_.store(perf_sample > 0 ? perf_sample : 0);
+    enabled_.store(enabled);
+    mu_.Unlock();
+}
+
+// The calls running meanwhile are counted or not, but not half
+void Metrics::Reset() {
+    mu_.Lock();
+    Shard *shards = shards_.load();
+    if (shards != NULL) {
+        for (int s = 0; s < kShards; s++) {
+            for (int c = 0; c < kCmdCount; c++) {
+                Command *command = &shards[s].commands[c];
+                command->calls.store(0, std::memory_order_relaxed);
+                command->micros.store(0, std::memory_order_relaxed);
+                for (int b = 0; b < LatencyHistogram::kBuckets; b++) {
+                    command->latency[b].store(0, std::memory_order_relaxed);
+                    command->lock_wait[b].store(0, std::memory_order_relaxed);
+                }
+                command->lock_waits.store(0, std::memory_order_relaxed);
+                command->lock_wait_micros.store(0, std::memory_order_relaxed);
+                command->gets.store(0, std::memory_order_relaxed);
+                command->meta_gets.store(0, std::memory_order_relaxed);
+                command->bytes_read.store(0, std::memory_order_relaxed);
+                command->bytes_written.store(0, std::memory_order_relaxed);
+                command->perf_samples.store(0, std::memory_order_relaxed);
+                command->perf_block_reads.store(0, std::memory_order_relaxed);
+                command->perf_block_read_nanos.store(0, std::memory_order_relaxed);
+                command->perf_memtable_get_nanos.store(0, std::memory_order_relaxed);
+                command->perf_sst_get_nanos.store(0, std::memory_order_relaxed);
+                command->perf_wal_nanos.store(0, std::memory_order_relaxed);
+                command->perf_memtable_write_nanos.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+    mu_.Unlock();
+}
+
+void Metrics::Get(std::vector<CommandMetrics> *metrics) {
+    metrics->clear();
+    Shard *shards = shards_.load();
+    if (shards == NULL) {
+        return;
+    }
+    std::vector<uint64_t> latency(LatencyHistogram::kBuckets);
+    std::vector<uint64_t> lock_wait(LatencyHistogram::kBuckets);
+    for (int c = 0; c < kCmdCount; c++) {
+        CommandMetrics m;
+        m.name = kCommandNames[c];
+        std::fill(latency.begin(), latency.end(), 0);
+        std::fill(lock_wait.begin(), lock_wait.end(), 0);
+        for (int s = 0; s < kShards; s++) {
+            const Command &command = shards[s].commands[c];
+            m.calls += Load(command.calls);
+            m.micros += Load(command.micros);
+            for (int b = 0; b < LatencyHistogram::kBuckets; b++) {
+                latency[b] += Load(command.latency[b]);
+                lock_wait[b] += Load(command.lock_wait[b]);
+            }
+            m.lock_waits += Load(command.lock_waits);
+            m.lock_wait_micros += Load(command.lock_wait_micros);
+            m.gets += Load(command.gets);
+            m.meta_gets += Load(command.meta_gets);
+            m.bytes_read += Load(command.bytes_read);
+            m.bytes_written += Load(command.bytes_written);
+            m.perf_samples += Load(command.perf_samples);
+            m.perf_block_reads += Load(command.perf_block_reads);
+            m.perf_block_read_nanos += Load(command.perf_block_read_nanos);
+            m.perf_memtable_get_nanos += Load(command.perf_memtable_get_nanos);
+            m.perf_sst_get_nanos += Load(command.perf_sst_get_nanos);
+            m.perf_wal_nanos += Load(command.perf_wal_nanos);
+            m.perf_memtable_write_nanos += Load(command.perf_memtable_write_nanos);
+        }
+        if (m.calls == 0) {
+            continue;
+        }
+        // the buckets were read after calls, they may hold a few more
+        uint64_t count = 0;
+        uint64_t waited = 0;
+        for (int b = 0; b < LatencyHistogram::kBuckets; b++) {
+            count += latency[b];
+            waited += lock_wait[b];
+            if (latency[b] > 0) {
+                m.max = LatencyHistogram::BucketMax(b);
+            }
+        }
+        m.p50 = LatencyHistogram::Percentile(&latency[0], count, 0.5);
+        m.p99 = LatencyHistogram::Percentile(&latency[0], count, 0.99);
+        m.p999 = LatencyHistogram::Percentile(&latency[0], count, 0.999);
+        m.lock_wait_p99 = LatencyHistogram::Percentile(&lock_wait[0], waited, 0.99);
+        metrics->push_back(m);
+    }
+}
+
+Metrics::Command *Metrics::ThisThreadCommand(MetricsCommand cmd) {
+    static thread_local int shard = -1;
+    if (shard < 0) {
+        shard = next_shard_.fetch_add(1, std::memory_order_relaxed) % kShards;
+    }
+    return &shards_.load(std::memory_order_acquire)[shard].commands[cmd];
+}
+
+// The outermost scope of the thread, if any
+static thread_local bool in_scope = false;
+
+// The types of the commands, kv for Del, Expire, TTL and Exists of any type
+static DBType CommandType(MetricsCommand cmd) {
+    if (cmd < kCmdHSet) {
+        return kKV_DB;
+    } else if (cmd < kCmdLPush) {
+        return kHASH_DB;
+    } else if (cmd < kCmdSAdd) {
+        return kLIST_DB;
+    } else if (cmd < kCmdZAdd) {
+        return kSET_DB;
+    }
+    return kZSET_DB;
+}
+
+void MetricsScope::Begin(Metrics *metrics, MetricsCommand cmd, bool profiled) {
+    if (in_scope) {
+        return;
+    }
+    in_scope = true;
+    metrics_ = metrics;
+    cmd_ = cmd;
+    command_ = metrics->enabled() ? metrics->ThisThreadCommand(cmd) : NULL;
+    profiled_ = profiled;
+    lock_waits_ = *port::ThisThreadLockWaits();
+    io_ = *rocksdb::GetNemoIOContext();
+
+    static thread_local uint64_t calls = 0;
+    int perf_sample = metrics->perf_sample_.load(std::memory_order_relaxed);
+    sampled_ = command_ != NULL && perf_sample > 0 && ++calls % perf_sample == 0;
+    if (sampled_) {
+        perf_level_ = rocksdb::GetPerfLevel();
+        rocksdb::SetPerfLevel(rocksdb::kEnableTimeExceptForMutex);
+        ReadPerfContext(perf_);
+    }
+    start_ = NowMicros();
+}
+
+// The fields of the PerfContext are added to, never reset, so that the
+// counting of a caller of the command goes on
+void MetricsScope::ReadPerfContext(uint64_t *fields) {
+    fields[0] = rocksdb::perf_context.block_read_count;
+    fields[1] = rocksdb::perf_context.block_read_time;
+    fields[2] = rocksdb::perf_context.get_from_memtable_time;
+    fields[3] = rocksdb::perf_context.get_from_output_files_time;
+    fields[4] = rocksdb::perf_context.write_wal_time;
+    fields[5] = rocksdb::perf_context.write_memtable_time;
+}
+
+void MetricsScope::End() {
+    uint64_t micros = NowMicros() - start_;
+    const rocksdb::NemoIOContext *io = rocksdb::GetNemoIOContext();
+    uint64_t bytes_read = io->bytes_read - io_.bytes_read;
+    uint64_t bytes_written = io->bytes_written - io_.bytes_written;
+    if (profiled_) {
+        metrics_->profiler()->Record(CommandType(cmd_), key_, micros, bytes_read + bytes_written);
+    }
+
+    Metrics::Command *command = command_;
+    if (command == NULL) {
+        in_scope = false;
+        return;
+    }
+    Add(&command->calls, 1);
+    Add(&command->micros, micros);
+    Add(&command->latency[LatencyHistogram::Bucket(micros)], 1);
+
+    const port::LockWaits *lock_waits = port::ThisThreadLockWaits();
+    if (lock_waits->waits != lock_waits_.waits) {
+        uint64_t waited = lock_waits->micros - lock_waits_.micros;
+        Add(&command->lock_waits, 1);
+        Add(&command->lock_wait_micros, waited);
+        Add(&command->lock_wait[LatencyHistogram::Bucket(waited)], 1);
+    }
+
+    Add(&command->gets, io->gets - io_.gets);
+    Add(&command->meta_gets, io->meta_gets - io_.meta_gets);
+    Add(&command->bytes_read, bytes_read);
+    Add(&command->bytes_written, bytes_written);
+
+    if (sampled_) {
+        uint64_t perf[kPerfFields];
+        ReadPerfContext(perf);
+        rocksdb::SetPerfLevel(perf_level_);
+        Add(&command->perf_samples, 1);
+        Add(&command->perf_block_reads, perf[0] - perf_[0]);
+        Add(&command->perf_block_read_nanos, perf[1] - perf_[1]);
+        Add(&command->perf_memtable_get_nanos, perf[2] - perf_[2]);
+        Add(&command->perf_sst_get_nanos, perf[3] - perf_[3]);
+        Add(&command->perf_wal_nanos, perf[4] - perf_[4]);
+        Add(&command->perf_memtable_write_nanos, perf[5] - perf_[5]);
+    }
+    in_scope = false;
+}
+
+}
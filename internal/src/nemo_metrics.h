@@ -0,0 +1,189 @@
+#ifndef NEMO_INCLUDE_NEMO_METRICS_H_
+#define NEMO_INCLUDE_NEMO_METRICS_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "nemo.h"
+#include "nemo_profiler.h"
+#include "port.h"
+#include "rocksdb/perf_level.h"
+
+namespace nemo {
+
+enum MetricsCommand {
+    kCmdSet = 0,
+    kCmdGet,
+    kCmdMSet,
+    kCmdMGet,
+    kCmdDel,
+    kCmdMDel,
+    kCmdIncrby,
+    kCmdSetnx,
+    kCmdExpire,
+    kCmdTTL,
+    kCmdExists,
+    kCmdHSet,
+    kCmdHGet,
+    kCmdHDel,
+    kCmdHMSet,
+    kCmdHMGet,
+    kCmdHGetall,
+    kCmdHLen,
+    kCmdHIncrby,
+    kCmdHExists,
+    kCmdLPush,
+    kCmdRPush,
+    kCmdLPop,
+    kCmdRPop,
+    kCmdLRange,
+    kCmdLIndex,
+    kCmdLLen,
+    kCmdLSet,
+    kCmdSAdd,
+    kCmdSRem,
+    kCmdSMembers,
+    kCmdSIsMember,
+    kCmdSCard,
+    kCmdSPop,
+    kCmdZAdd,
+    kCmdZRem,
+    kCmdZScore,
+    kCmdZRange,
+    kCmdZRangebyscore,
+    kCmdZRank,
+    kCmdZIncrby,
+    kCmdCount
+};
+
+// Log linear histogram of micros, as HDR histograms are: the values below
+// 2^kSubBits have a bucket each, then every power of 2 is cut into
+// 2^kSubBits buckets, so that a bucket is at most 1/8 of its values wide.
+// The values from 2^kMaxBits on share the last bucket.
+class LatencyHistogram {
+public:
+    static const int kSubBits = 3;
+    static const int kMaxBits = 36;
+    static const int kBuckets = (1 << kSubBits) + (kMaxBits - kSubBits) * (1 << kSubBits);
+
+    static int Bucket(uint64_t value);
+    // The largest value of bucket
+    static uint64_t BucketMax(int bucket);
+    // The value below which rank of the count values in buckets are
+    static uint64_t Percentile(const uint64_t *buckets, uint64_t count, double rank);
+};
+
+// Per command counters and latency histograms. Each thread adds to one of
+// kShards shards, taken in turn by the threads as they first record, with
+// relaxed atomics, so that threads rarely share the cache lines they write;
+// Get sums the shards. The shards are allocated by the first Enable.
+class Metrics {
+public:
+    Metrics();
+    ~Metrics();
+
+    void Enable(bool enabled, int perf_sample);
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    void Get(std::vector<CommandMetrics> *metrics);
+    void Reset();
+    KeyProfiler *profiler() { return &profiler_; }
+
+private:
+    friend class MetricsScope;
+
+    static const int kShards = 8;
+
+    struct Command {
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> micros;
+        std::atomic<uint64_t> latency[LatencyHistogram::kBuckets];
+        std::atomic<uint64_t> lock_waits;
+        std::atomic<uint64_t> lock_wait_micros;
+        std::atomic<uint64_t> lock_wait[LatencyHistogram::kBuckets];
+        std::atomic<uint64_t> gets;
+        std::atomic<uint64_t> meta_gets;
+        std::atomic<uint64_t> bytes_read;
+        std::atomic<uint64_t> bytes_written;
+        std::atomic<uint64_t> perf_samples;
+        std::atomic<uint64_t> perf_block_reads;
+        std::atomic<uint64_t> perf_block_read_nanos;
+        std::atomic<uint64_t> perf_memtable_get_nanos;
+        std::atomic<uint64_t> perf_sst_get_nanos;
+        std::atomic<uint64_t> perf_wal_nanos;
+        std::atomic<uint64_t> perf_memtable_write_nanos;
+    };
+    struct Shard {
+        Command commands[kCmdCount];
+    };
+
+    Command *ThisThreadCommand(MetricsCommand cmd);
+
+    std::atomic<bool> enabled_;
+    std::atomic<int> perf_sample_;
+    std::atomic<Shard *> shards_;
+    std::atomic<int> next_shard_;
+    port::Mutex mu_;
+    KeyProfiler profiler_;
+
+    //No Copying Allowed
+    Metrics(const Metrics&);
+    void operator=(const Metrics&);
+};
+
+// Records one call of cmd, from construction to destruction, when metrics
+// is enabled: its latency, the record locks it waited for, its reads and
+// writes through the DBNemos and, one call in perf_sample, the timings of
+// rocksdb::PerfContext. The commands it calls, as MDel calls Del, are part
+// of it and not recorded on their own. The calls of the single key commands,
+// which pass their key, are also sampled by the KeyProfiler of metrics.
+class MetricsScope {
+public:
+    MetricsScope(Metrics *metrics, MetricsCommand cmd) : metrics_(NULL) {
+        if (metrics != NULL && metrics->enabled()) {
+            Begin(metrics, cmd, false);
+        }
+    }
+    MetricsScope(Metrics *metrics, MetricsCommand cmd, const rocksdb::Slice &key)
+        : metrics_(NULL), key_(key) {
+        if (metrics != NULL) {
+            bool sampled = metrics->profiler()->Sample();
+            if (sampled || metrics->enabled()) {
+                Begin(metrics, cmd, sampled);
+            }
+        }
+    }
+    ~MetricsScope() {
+        if (metrics_ != NULL) {
+            End();
+        }
+    }
+
+private:
+    static const int kPerfFields = 6;
+
+    void Begin(Metrics *metrics, MetricsCommand cmd, bool profiled);
+    void End();
+    static void ReadPerfContext(uint64_t *fields);
+
+    Metrics *metrics_;
+    MetricsCommand cmd_;
+    // NULL while metrics is disabled
+    Metrics::Command *command_;
+    rocksdb::Slice key_;
+    bool profiled_;
+    uint64_t start_;
+    port::LockWaits lock_waits_;
+    rocksdb::NemoIOContext io_;
+    bool sampled_;
+    rocksdb::PerfLevel perf_level_;
+    uint64_t perf_[kPerfFields];
+
+    //No Copying Allowed
+    MetricsScope(const MetricsScope&);
+    void operator=(const MetricsScope&);
+};
+
+}
+#endif
@@ -4,6 +4,10 @@
 #include "port.h"
 
 #include <pthread.h>
+#include <string>
+#include <vector>
+
+#include "rocksdb/slice.h"
 
 namespace nemo {
 
@@ -41,22 +45,48 @@ class RWLock {
   void operator=(const RWLock&);
 };
 
+// Lock one key of a table. Keys sharing a stripe share the lock, so do not
+// take a second RecordLock of the same table while holding one, see
+// port::RecordMutex; use MultiRecordLock
 class RecordLock {
  public:
-  RecordLock(port::RecordMutex *mu, const std::string &key)
-      : mu_(mu), key_(key) {
-        mu_->Lock(key_);
+  RecordLock(port::RecordMutex *mu, const rocksdb::Slice &key)
+      : mu_(mu), held_(mu->Lock(key)) {
       }
-  ~RecordLock() { mu_->Unlock(key_); }
+  ~RecordLock() { mu_->Unlock(held_); }
 
  private:
   port::RecordMutex *const mu_;
-  std::string key_;
+  const port::RecordMutex::Held held_;
 
   // No copying allowed
   RecordLock(const RecordLock&);
   void operator=(const RecordLock&);
 };
 
+// Lock several keys of the same table at once, they are taken in
+// (stripe, key) order so concurrent callers can not deadlock
+class MultiRecordLock {
+ public:
+  MultiRecordLock(port::RecordMutex *mu, const std::vector<rocksdb::Slice> &keys)
+      : mu_(mu) {
+        mu_->MultiLock(keys, &held_);
+      }
+  MultiRecordLock(port::RecordMutex *mu, const std::vector<std::string> &keys)
+      : mu_(mu) {
+        std::vector<rocksdb::Slice> slices(keys.begin(), keys.end());
+        mu_->MultiLock(slices, &held_);
+      }
+  ~MultiRecordLock() { mu_->MultiUnlock(held_); }
+
+ private:
+  port::RecordMutex *const mu_;
+  std::vector<port::RecordMutex::Held> held_;
+
+  // No copying allowed
+  MultiRecordLock(const MultiRecordLock&);
+  void operator=(const MultiRecordLock&);
+};
+
 }
 #endif
@@ -0,0 +1,335 @@
+#include <string.h>
+#include <algorithm>
+
+#include "nemo_profiler.h"
+
+namespace nemo {
+
+static const DBType kProfiledTypes[KeyProfiler::kTypes] = {
+    kKV_DB, kHASH_DB, kLIST_DB, kZSET_DB, kSET_DB
+};
+static const std::string *kProfiledTypeNames[KeyProfiler::kTypes] = {
+    &KV_DB, &HASH_DB, &LIST_DB, &ZSET_DB, &SET_DB
+};
+
+// FNV-1a, never 0, which marks a free slot of BigKeys::hashes
+static uint64_t KeyHash(const rocksdb::Slice &key) {
+    uint64_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < key.size(); i++) {
+        h ^= static_cast<unsigned char>(key[i]);
+        h *= 1099511628211ull;
+    }
+    return h | 1;
+}
+
+KeyProfiler::KeyProfiler()
+    : enabled_(false),
+    sample_every_(1),
+    ring_(NULL),
+    head_(0),
+    drained_(0),
+    tail_(0),
+    samples_(0),
+    dropped_(0) {
+    for (int t = 0; t < kTypes; t++) {
+        for (int i = 0; i < kBigKeys; i++) {
+            big_keys_[t].hashes[i].store(0);
+        }
+        big_keys_[t].min_vol.store(0);
+    }
+}
+
+KeyProfiler::~KeyProfiler() {
+    delete [] ring_.load();
+}
+
+void KeyProfiler::Enable(bool enabled, int sample_every) {
+    mu_.Lock();
+    if (enabled && ring_.load() == NULL) {
+        Slot *ring = new Slot[kRingSize];
+        for (int i = 0; i < kRingSize; i++) {
+            ring[i].seq.store(0);
+        }
+        ring_.store(ring);
+    }
+    sample_every_.store(sample_every > 0 ? sample_every : 1);
+    enabled_.store(enabled);
+    mu_.Unlock();
+}
+
+int KeyProfiler::TypeIndex(DBType type) {
+    for (int t = 0; t < kTypes; t++) {
+        if (kProfiledTypes[t] == type) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+void KeyProfiler::Record(DBType type, const rocksdb::Slice &key, uint64_t micros, uint64_t bytes) {
+    int t = TypeIndex(type);
+    Slot *ring = ring_.load(std::memory_order_acquire);
+    if (t < 0 || ring == NULL) {
+        return;
+    }
+    uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+    Slot *slot = &ring[index % kRingSize];
+    slot->seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot->micros = micros;
+    slot->bytes = bytes;
+    slot->type = static_cast<uint8_t>(t);
+    slot->key_len = static_cast<uint8_t>(std::min<size_t>(key.size(), KEY_MAX_LENGTH));
+    memcpy(slot->key, key.data(), slot->key_len);
+    slot->seq.store(2 * index + 2, std::memory_order_release);
+
+    // A drain running already takes these samples or leaves them to the
+    // next batch, unless half of the ring waits for a drain: the writers
+    // then wait too, rather than overrun the ring
+    if (index % kDrainBatch == kDrainBatch - 1) {
+        if (index - drained_.load(std::memory_order_relaxed) >= static_cast<uint64_t>(kRingSize / 2)) {
+            mu_.Lock();
+        } else if (!mu_.TryLock()) {
+            return;
+        }
+        Drain();
+        mu_.Unlock();
+    }
+}
+
+// A slot still being written is left to the next drain while half of the
+// ring is free, then given up as dropped, so that a writer preempted in the
+// middle of a sample does not hold the drains back until the ring overruns
+void KeyProfiler::Drain() {
+    Slot *ring = ring_.load(std::memory_order_acquire);
+    if (ring == NULL) {
+        return;
+    }
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head - tail_ > static_cast<uint64_t>(kRingSize)) {
+        dropped_ += head - tail_ - kRingSize;
+        tail_ = head - kRingSize;
+    }
+    Slot copy;
+    for (; tail_ < head; tail_++) {
+        Slot *slot = &ring[tail_ % kRingSize];
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        if (seq < 2 * tail_ + 2 && head - tail_ < static_cast<uint64_t>(kRingSize / 2)) {
+            break;
+        }
+        if (seq == 2 * tail_ + 2) {
+            copy.micros = slot->micros;
+            copy.bytes = slot->bytes;
+            copy.type = slot->type;
+            copy.key_len = slot->key_len;
+            memcpy(copy.key, slot->key, copy.key_len);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot->seq.load(std::memory_order_relaxed) == seq) {
+                samples_++;
+                Count(copy.type, std::string(copy.key, copy.key_len), copy.micros, copy.bytes);
+                continue;
+            }
+        }
+        // still being written, or taken by a writer a lap ahead
+        dropped_++;
+    }
+    drained_.store(tail_, std::memory_order_relaxed);
+}
+
+// Space-Saving: a key not counted yet takes the counter of the smallest
+// count, which it inherits as its error. As the counts only grow, min_count
+// stays a lower bound of them, and the counters of min_count are looked for
+// from the last one taken before the counters are scanned for a new one.
+void KeyProfiler::Count(int type, const std::string &key, uint64_t micros, uint64_t bytes) {
+    Sketch *sketch = &sketches_[type];
+    std::unordered_map<std::string, int>::iterator it = sketch->index.find(key);
+    Counter *counter;
+    if (it != sketch->index.end()) {
+        counter = &sketch->counters[it->second];
+    } else if (sketch->counters.size() < static_cast<size_t>(kCounters)) {
+        sketch->index[key] = sketch->counters.size();
+        sketch->counters.push_back(Counter());
+        counter = &sketch->counters.back();
+        counter->key = key;
+        counter->count = 0;
+        counter->error = 0;
+        counter->micros = 0;
+        counter->bytes = 0;
+    } else {
+        int min = -1;
+        for (int i = 0; i < kCounters && min < 0; i++) {
+            int j = (sketch->min_hint + i) % kCounters;
+            if (sketch->counters[j].count == sketch->min_count) {
+                min = j;
+            }
+        }
+        if (min < 0) {
+            min = 0;
+            for (int j = 1; j < kCounters; j++) {
+                if (sketch->counters[j].count < sketch->counters[min].count) {
+                    min = j;
+                }
+            }
+            sketch->min_count = sketch->counters[min].count;
+        }
+        sketch->min_hint = min;
+        counter = &sketch->counters[min];
+        sketch->index.erase(counter->key);
+        sketch->index[key] = min;
+        counter->key = key;
+        counter->error = counter->count;
+        counter->micros = 0;
+        counter->bytes = 0;
+    }
+    counter->count++;
+    counter->micros += micros;
+    counter->bytes += bytes;
+}
+
+void KeyProfiler::UpdateMeta(DBType type, const rocksdb::Slice &key, int64_t len, int64_t vol) {
+    int t = TypeIndex(type);
+    if (t < 0) {
+        return;
+    }
+    BigKeys *big = &big_keys_[t];
+    uint64_t hash = KeyHash(key);
+    bool kept = false;
+    for (int i = 0; i < kBigKeys && !kept; i++) {
+        kept = big->hashes[i].load(std::memory_order_relaxed) == hash;
+    }
+    if (!kept && (len <= 0 || vol <= big->min_vol.load(std::memory_order_relaxed))) {
+        return;
+    }
+
+    big->mu.Lock();
+    size_t i = 0;
+    while (i < big->keys.size() && key.compare(big->keys[i].key) != 0) {
+        i++;
+    }
+    if (i < big->keys.size()) {
+        if (len <= 0) {
+            big->keys[i] = big->keys.back();
+            big->hashes[i].store(big->hashes[big->keys.size() - 1].load(std::memory_order_relaxed),
+                                 std::memory_order_relaxed);
+            big->hashes[big->keys.size() - 1].store(0, std::memory_order_relaxed);
+            big->keys.pop_back();
+        } else {
+            big->keys[i].len = len;
+            big->keys[i].vol = vol;
+        }
+    } else if (len > 0) {
+        bool keep = true;
+        if (big->keys.size() < static_cast<size_t>(kBigKeys)) {
+            big->keys.push_back(BigKey());
+        } else {
+            i = 0;
+            for (size_t j = 1; j < big->keys.size(); j++) {
+                if (big->keys[j].vol < big->keys[i].vol) {
+                    i = j;
+                }
+            }
+            keep = vol > big->keys[i].vol;
+        }
+        if (keep) {
+            big->keys[i].key = key.ToString();
+            big->keys[i].len = len;
+            big->keys[i].vol = vol;
+            big->hashes[i].store(hash, std::memory_order_relaxed);
+        }
+    }
+    UpdateMinVol(big);
+    big->mu.Unlock();
+}
+
+// Every vol is a candidate while fewer than kBigKeys are kept
+void KeyProfiler::UpdateMinVol(BigKeys *big) {
+    int64_t min_vol = 0;
+    if (big->keys.size() == static_cast<size_t>(kBigKeys)) {
+        min_vol = big->keys[0].vol;
+        for (size_t i = 1; i < big->keys.size(); i++) {
+            min_vol = std::min(min_vol, big->keys[i].vol);
+        }
+    }
+    big->min_vol.store(min_vol, std::memory_order_relaxed);
+}
+
+static bool ByCalls(const ProfiledKey &a, const ProfiledKey &b) {
+    return a.calls > b.calls;
+}
+
+static bool ByVol(const ProfiledKey &a, const ProfiledKey &b) {
+    return a.vol > b.vol;
+}
+
+void KeyProfiler::Get(KeyProfile *profile) {
+    profile->hot_keys.clear();
+    profile->big_keys.clear();
+    mu_.Lock();
+    Drain();
+    profile->samples = samples_;
+    profile->dropped = dropped_;
+    for (int t = 0; t < kTypes; t++) {
+        std::vector<ProfiledKey> keys;
+        const std::vector<Counter> &counters = sketches_[t].counters;
+        for (size_t i = 0; i < counters.size(); i++) {
+            ProfiledKey k;
+            k.type = *kProfiledTypeNames[t];
+            k.key = counters[i].key;
+            k.calls = counters[i].count;
+            k.error = counters[i].error;
+            k.micros = counters[i].micros;
+            k.bytes = counters[i].bytes;
+            keys.push_back(k);
+        }
+        std::sort(keys.begin(), keys.end(), ByCalls);
+        if (keys.size() > static_cast<size_t>(kTopKeys)) {
+            keys.resize(kTopKeys);
+        }
+        profile->hot_keys.insert(profile->hot_keys.end(), keys.begin(), keys.end());
+    }
+    mu_.Unlock();
+
+    for (int t = 0; t < kTypes; t++) {
+        std::vector<ProfiledKey> keys;
+        BigKeys *big = &big_keys_[t];
+        big->mu.Lock();
+        for (size_t i = 0; i < big->keys.size(); i++) {
+            ProfiledKey k;
+            k.type = *kProfiledTypeNames[t];
+            k.key = big->keys[i].key;
+            k.len = big->keys[i].len;
+            k.vol = big->keys[i].vol;
+            keys.push_back(k);
+        }
+        big->mu.Unlock();
+        std::sort(keys.begin(), keys.end(), ByVol);
+        profile->big_keys.insert(profile->big_keys.end(), keys.begin(), keys.end());
+    }
+}
+
+void KeyProfiler::Reset() {
+    mu_.Lock();
+    tail_ = head_.load(std::memory_order_acquire);
+    drained_.store(tail_, std::memory_order_relaxed);
+    samples_ = 0;
+    dropped_ = 0;
+    for (int t = 0; t < kTypes; t++) {
+        sketches_[t].counters.clear();
+        sketches_[t].index.clear();
+        sketches_[t].min_count = 0;
+        sketches_[t].min_hint = 0;
+    }
+    mu_.Unlock();
+    for (int t = 0; t < kTypes; t++) {
+        BigKeys *big = &big_keys_[t];
+        big->mu.Lock();
+        big->keys.clear();
+        for (int i = 0; i < kBigKeys; i++) {
+            big->hashes[i].store(0, std::memory_order_relaxed);
+        }
+        big->min_vol.store(0, std::memory_order_relaxed);
+        big->mu.Unlock();
+    }
+}
+
+}
@@ -0,0 +1,134 @@
+#ifndef NEMO_INCLUDE_NEMO_PROFILER_H_
+#define NEMO_INCLUDE_NEMO_PROFILER_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "nemo.h"
+#include "nemo_const.h"
+#include "port.h"
+#include "rocksdb/slice.h"
+
+namespace nemo {
+
+// Hot keys and big keys, see Nemo::EnableKeyProfiler.
+//
+// One call in sample_every of the single key commands is sampled: its key,
+// type, latency and bytes go to a ring of kRingSize slots, which the writers
+// take by a fetch_add and publish by a sequence number, as a seqlock, so
+// that sampling takes no lock. Every kDrainBatch samples, the writer of the
+// last one drains the ring into a Space-Saving sketch of kCounters keys per
+// type, the hot keys being its top counts, unless another drain is running.
+// Only once half of the ring waits for a drain does the writer wait for it.
+// The samples a drain finds already overwritten are counted as dropped.
+//
+// The writes of the hash, zset, set and list metas pass their len and vol to
+// Meta, which keeps the kBigKeys largest keys by vol per type. Only a write
+// of a key already kept or larger than the smallest one kept takes the lock.
+class KeyProfiler {
+public:
+    static const int kTypes = 5;
+    static const int kCounters = 256;
+    static const int kTopKeys = 32;
+    static const int kBigKeys = 32;
+
+    KeyProfiler();
+    ~KeyProfiler();
+
+    void Enable(bool enabled, int sample_every);
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // Whether to sample the call about to run, the calling thread counts
+    // its calls
+    bool Sample() {
+        if (!enabled()) {
+            return false;
+        }
+        static thread_local uint64_t calls = 0;
+        return ++calls % sample_every_.load(std::memory_order_relaxed) == 0;
+    }
+    void Record(DBType type, const rocksdb::Slice &key, uint64_t micros, uint64_t bytes);
+    void Meta(DBType type, const rocksdb::Slice &key, int64_t len, int64_t vol) {
+        if (enabled()) {
+            UpdateMeta(type, key, len, vol);
+        }
+    }
+    // The big keys are as last written, Nemo::GetKeyProfile reads them again
+    void Get(KeyProfile *profile);
+    void Reset();
+
+private:
+    static const int kRingSize = 2048;
+    static const int kDrainBatch = 256;
+
+    struct Slot {
+        // 2 * index + 1 while written, 2 * index + 2 once written
+        std::atomic<uint64_t> seq;
+        uint64_t micros;
+        uint64_t bytes;
+        uint8_t type;
+        uint8_t key_len;
+        char key[KEY_MAX_LENGTH];
+    };
+
+    struct Counter {
+        std::string key;
+        uint64_t count;
+        // count overestimates the calls by at most error
+        uint64_t error;
+        uint64_t micros;
+        uint64_t bytes;
+    };
+    struct Sketch {
+        std::vector<Counter> counters;
+        std::unordered_map<std::string, int> index;
+        uint64_t min_count;
+        int min_hint;
+        Sketch() : min_count(0), min_hint(0) {}
+    };
+
+    struct BigKey {
+        std::string key;
+        int64_t len;
+        int64_t vol;
+    };
+    struct BigKeys {
+        port::Mutex mu;
+        std::vector<BigKey> keys;
+        // The hashes of keys, and the smallest vol kept once kBigKeys are,
+        // read without mu
+        std::atomic<uint64_t> hashes[kBigKeys];
+        std::atomic<int64_t> min_vol;
+    };
+
+    static int TypeIndex(DBType type);
+    void Drain();
+    void Count(int type, const std::string &key, uint64_t micros, uint64_t bytes);
+    void UpdateMeta(DBType type, const rocksdb::Slice &key, int64_t len, int64_t vol);
+    void UpdateMinVol(BigKeys *big);
+
+    std::atomic<bool> enabled_;
+    std::atomic<int> sample_every_;
+    std::atomic<Slot *> ring_;
+    std::atomic<uint64_t> head_;
+    // tail_, read without mu_
+    std::atomic<uint64_t> drained_;
+
+    // Guards the drain and the sketches
+    port::Mutex mu_;
+    uint64_t tail_;
+    uint64_t samples_;
+    uint64_t dropped_;
+    Sketch sketches_[kTypes];
+
+    BigKeys big_keys_[kTypes];
+
+    //No Copying Allowed
+    KeyProfiler(const KeyProfiler&);
+    void operator=(const KeyProfiler&);
+};
+
+}
+#endif
@@ -3,6 +3,10 @@
 #include <set>
 
 #include "nemo_set.h"
+#include "nemo_expire.h"
+#include "nemo_metrics.h"
+#include "nemo_merge.h"
+#include "nemo_write_group.h"
 #include "nemo_mutex.h"
 #include "nemo_iterator.h"
 #include "util.h"
@@ -68,6 +72,7 @@ Status Nemo::SChecknRecover(const std::string& key) {
 }
 
 Status Nemo::SAdd(const std::string &key, const std::string &member, int64_t *res) {
+    MetricsScope metrics(metrics_, kCmdSAdd, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -93,7 +98,7 @@ Status Nemo::SAdd(const std::string &key, const std::string &member, int64_t *re
         return Status::Corruption("sadd check member error");
     }
 
-    s = set_db_->WriteWithOldKeyTTL(w_opts_nolog(), &(writebatch));
+    s = set_group_->Write(w_opts_nolog(), rocksdb::kNemoWriteOldKeyTTL, &writebatch);
     return s;
 }
 
@@ -162,6 +167,7 @@ Status Nemo::SAddNoLock(const std::string &key, const std::string &member, int64
 }
 
 Status Nemo::SRem(const std::string &key, const std::string &member, int64_t *res) {
+    MetricsScope metrics(metrics_, kCmdSRem, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -272,6 +278,7 @@ int Nemo::IncrSSize(const std::string &key, int64_t incrCount, int64_t incrVol,
     std::string meta_val;
     meta.EncodeTo(meta_val);
     writebatch.Put(size_key, meta_val);
+    metrics_->profiler()->Meta(kSET_DB, key, len, vol);
 
    // if (len == 0) {
    //     writebatch.Delete(size_key);
@@ -282,6 +289,7 @@ int Nemo::IncrSSize(const std::string &key, int64_t incrCount, int64_t incrVol,
 }
 
 Status Nemo::SCard(const std::string &key,int64_t * sum) {
+    MetricsScope metrics(metrics_, kCmdSCard, key);
     std::string size_key = EncodeSSizeKey(key);
     std::string val;
     Status s;
@@ -338,19 +346,17 @@ SIterator* Nemo::SScan(const std::string &key, uint64_t limit, bool use_snapshot
     }
     read_options.fill_cache = false;
 
-    rocksdb::Iterator *it = set_db_->NewIterator(read_options);
-    it->Seek(set_key);
-
     IteratorOptions iter_options("", limit, read_options);
 
-    return new SIterator(it, set_db_.get(), iter_options, key); 
+    return new SIterator(set_db_.get(), iter_options, key, set_key); 
 }
 
 Status Nemo::SMembers(const std::string &key, std::vector<std::string> &members) {
+    MetricsScope metrics(metrics_, kCmdSMembers, key);
     SIterator *iter = SScan(key, -1, true);
     members.clear();
     for (; iter->Valid(); iter->Next()) {
-        members.push_back(iter->member());
+        members.push_back(iter->member().ToString());
     }
     delete iter;
     return Status::OK();
@@ -359,16 +365,13 @@ Status Nemo::SMembers(const std::string &key, std::vector<std::string> &members)
 // Modify for dead lock
 Status Nemo::SUnion(const std::vector<std::string> &keys, std::vector<std::string>& members) {
     std::map<std::string, bool> result_flag;
-    std::set<std::string> lock_keys(keys.begin(), keys.end());
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      RecordLock l(&mutex_set_record_, *iter);
-    }
+    MultiRecordLock l(&mutex_set_record_, keys);
     for (int i = 0; i < (int)keys.size(); i++) {
 //      RecordLock l(&mutex_set_record_, keys[i]);
         SIterator *iter = SScan(keys[i], -1, true);
         
         for (; iter->Valid(); iter->Next()) {
-            std::string member = iter->member();
+            std::string member = iter->member().ToString();
             if (result_flag.find(member) == result_flag.end()) {
                 members.push_back(member);
                 result_flag[member] = 1;
@@ -386,56 +389,11 @@ Status Nemo::SUnionStore(const std::string &destination, const std::vector<std::
     if (numkey <= 0) {
         return Status::InvalidArgument("invalid parameter, no keys");
     }
-
-    std::map<std::string, int> member_result;
-    std::map<std::string, int>::iterator it;
-
-    std::set<std::string> lock_keys(keys.begin(), keys.end());
-    lock_keys.insert(destination);
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      RecordLock l(&mutex_set_record_, *iter);
-    }
-
-    for (int i = 0; i < numkey; i++) {
-//      RecordLock l(&mutex_set_record_, keys[i]);
-        SIterator *iter = SScan(keys[i], -1, true);
-        
-        for (; iter->Valid(); iter->Next()) {
-            member_result[iter->member()] = 1;
-        }
-        delete iter;
-    }
-
-    // we delete the destination if it exists
-    Status s;
-    int64_t tmp_res;
-
-//  RecordLock l(&mutex_set_record_, destination);
-    int64_t sum = 0;
-    SCard(destination,&sum);
-    if (sum > 0) {
-        SIterator *iter = SScan(destination, -1, true);
-        for (; iter->Valid(); iter->Next()) {
-            s = SRemNoLock(destination, iter->member(), &tmp_res);
-            if (!s.ok()) {
-                delete iter;
-                return s;
-            }
-        }
-        delete iter;
-    }
-
-    for (it = member_result.begin(); it != member_result.end(); it++) {
-        s = SAddNoLock(destination, it->first, &tmp_res);
-        if (!s.ok()) {
-            return s;
-        }
-    }
-    *res = member_result.size();
-    return Status::OK();
+    return SStore(destination, keys, kSetUnion, res);
 }
 
 Status Nemo::SIsMember(const std::string &key, const std::string &member,bool * isMember) {
+    MetricsScope metrics(metrics_, kCmdSIsMember, key);
     std::string val;
 
     std::string set_key = EncodeSetKey(key, member);
@@ -447,13 +405,30 @@ Status Nemo::SIsMember(const std::string &key, const std::string &member,bool *
     return s;
 }
 
+Status Nemo::SMIsMember(const std::string &key, const std::vector<std::string> &members, std::vector<bool> &is_members) {
+    std::vector<std::string> set_keys;
+    set_keys.reserve(members.size());
+    for (size_t i = 0; i < members.size(); i++) {
+        set_keys.push_back(EncodeSetKey(key, members[i]));
+    }
+    std::vector<rocksdb::Slice> key_slices(set_keys.begin(), set_keys.end());
+    rocksdb::NemoBatchGetResult result;
+    set_db_->BatchGet(rocksdb::ReadOptions(), key_slices, &result);
+
+    Status s;
+    for (size_t i = 0; i < members.size(); i++) {
+        is_members.push_back(result.statuses[i].ok());
+        if (s.ok() && !result.statuses[i].ok() && !result.statuses[i].IsNotFound()) {
+            s = result.statuses[i];
+        }
+    }
+    return s;
+}
+
 //Note: no lock
 Status Nemo::SInter(const std::vector<std::string> &keys, std::vector<std::string>& members) {
 
-    std::set<std::string> lock_keys(keys.begin(), keys.end());
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      RecordLock l(&mutex_set_record_, *iter);
-    }
+    MultiRecordLock l(&mutex_set_record_, keys);
 
     int numkey = keys.size();
     if (numkey <= 0) {
@@ -464,7 +439,7 @@ Status Nemo::SInter(const std::vector<std::string> &keys, std::vector<std::strin
     
     for (; iter->Valid(); iter->Next()) {
         int i = 1;
-        std::string member = iter->member();
+        std::string member = iter->member().ToString();
         for (; i < numkey; i++) {
             bool isMember;
             SIsMember(keys[i], member,&isMember);
@@ -486,81 +461,14 @@ Status Nemo::SInterStore(const std::string &destination, const std::vector<std::
     if (numkey <= 0) {
         return Status::Corruption("SInter invalid parameter, no keys");
     }
-
-    // TODO: maybe a MultiRecordLock is a better way;
-    std::set<std::string> lock_keys(keys.begin(), keys.end());
-    lock_keys.insert(destination);
-
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      mutex_set_record_.Lock(*iter);
-      //printf ("SInter lock key(%s)\n", iter->c_str());
-    }
-
-    std::map<std::string, int> member_result;
-    std::map<std::string, int>::iterator it;
-    SIterator *iter = SScan(keys[0], -1, true);
-
-    for (; iter->Valid(); iter->Next()) {
-        int i = 1;
-        std::string member = iter->member();
-        for (; i < numkey; i++) {
-            bool isMember;
-            SIsMember(keys[i], member,&isMember);
-            if (!isMember) {
-                break;
-            }
-        }
-        if (i >= numkey) {
-            member_result[member] = 1;
-        }
-    }
-    delete iter;
-
-    // we delete the destination if it exists
-    Status s;
-    int64_t tmp_res;
-
-    //RecordLock l(&mutex_set_record_, destination);
-    int64_t sum = 0;
-    SCard(destination,&sum);
-    if ( sum > 0) {
-        SIterator *iter = SScan(destination, -1, true);
-        for (; iter->Valid(); iter->Next()) {
-            s = SRemNoLock(destination, iter->member(), &tmp_res);
-            if (!s.ok()) {
-                break;
-                //delete iter;
-                //return s;
-            }
-        }
-        delete iter;
-    }
-
-    if (s.ok()) {
-      for (it = member_result.begin(); it != member_result.end(); it++) {
-        s = SAddNoLock(destination, it->first, &tmp_res);
-        if (!s.ok()) {
-          break;
-        }
-      }
-    }
-
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      mutex_set_record_.Unlock(*iter);
-    }
-
-    *res = member_result.size();
-    return s;
+    return SStore(destination, keys, kSetInter, res);
 }
 
 // TODO need lock
 Status Nemo::SDiff(const std::vector<std::string> &keys, std::vector<std::string>& members) {
 
 
-    std::set<std::string> lock_keys(keys.begin(), keys.end());
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      RecordLock l(&mutex_set_record_, *iter);
-    }
+    MultiRecordLock l(&mutex_set_record_, keys);
 
     int numkey = keys.size();
     if (numkey <= 0) {
@@ -571,7 +479,7 @@ Status Nemo::SDiff(const std::vector<std::string> &keys, std::vector<std::string
     
     for (; iter->Valid(); iter->Next()) {
         int i = 1;
-        std::string member = iter->member();
+        std::string member = iter->member().ToString();
         for (; i < numkey; i++) {
             bool isMember;
             SIsMember(keys[i], member,&isMember);
@@ -588,68 +496,71 @@ Status Nemo::SDiff(const std::vector<std::string> &keys, std::vector<std::string
 }
 
 Status Nemo::SDiffStore(const std::string &destination, const std::vector<std::string> &keys, int64_t *res) {
-
-    std::set<std::string> lock_keys(keys.begin(), keys.end());
-    lock_keys.insert(destination);
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      RecordLock l(&mutex_set_record_, *iter);
-    }
-
     int numkey = keys.size();
     //MutexLock l(&mutex_set_);
     if (numkey <= 0) {
         return Status::Corruption("SDiff invalid parameter, no keys");
     }
+    return SStore(destination, keys, kSetDiff, res);
+}
 
-    std::map<std::string, int> member_result;
-    std::map<std::string, int>::iterator it;
+// Merge the member ordered kSet keys of the sources in one pass and write
+// the result as the whole destination by one batch, whose new version drops
+// the old members without reading them
+Status Nemo::SStore(const std::string &destination, const std::vector<std::string> &keys, SetOperation op, int64_t *res) {
+    if (destination.size() >= KEY_MAX_LENGTH || destination.size() <= 0) {
+       return Status::InvalidArgument("Invalid key length");
+    }
+    *res = 0;
 
-    SIterator *iter = SScan(keys[0], -1, true);
+    std::vector<std::string> lock_keys(keys);
+    lock_keys.push_back(destination);
+    MultiRecordLock l(&mutex_set_record_, lock_keys);
 
-    for (; iter->Valid(); iter->Next()) {
-        int i = 1;
-        std::string member = iter->member();
-        for (; i < numkey; i++) {
-            bool isMember;
-            SIsMember(keys[i], member,&isMember);       
-            if (isMember) {
+    int numkey = keys.size();
+    std::vector<SIterator *> iters;
+    for (int i = 0; i < numkey; i++) {
+        iters.push_back(SScan(keys[i], -1, true));
+    }
+    MemberMerger<SIterator> merger(iters);
+
+    rocksdb::WriteBatch batch;
+    int64_t len = 0;
+    int64_t volume = 0;
+    for (; merger.Valid(); merger.Next()) {
+        const std::vector<int> &sources = merger.sources();
+        if (op == kSetInter && (int)sources.size() < numkey) {
+            // nothing is left in all sources once one is drained
+            if (merger.live() < numkey) {
                 break;
             }
+            continue;
         }
-        if (i >= numkey) {
-            member_result[member] = 1;
-        }
-    }
-    delete iter;
-
-    // we delete the destination if it exists
-    Status s;
-    int64_t tmp_res;
-
-//  RecordLock l(&mutex_set_record_, destination);
-    int64_t sum = 0;
-    SCard(destination,&sum);
-    if (sum > 0) {
-        SIterator *iter = SScan(destination, -1, true);
-        for (; iter->Valid(); iter->Next()) {
-            s = SRemNoLock(destination, iter->member(), &tmp_res);
-            if (!s.ok()) {
-                delete iter;
-                return s;
+        if (op == kSetDiff && (sources[0] != 0 || sources.size() > 1)) {
+            if (!merger.iter(0)->Valid()) {
+                break;
             }
+            continue;
         }
-        delete iter;
+
+        batch.Put(EncodeSetKey(destination, merger.member()), rocksdb::Slice());
+        len++;
+        volume += destination.size() + merger.member().size();
     }
 
+    SetMeta meta;
+    meta.len = len;
+    meta.vol = volume;
+    std::string meta_val;
+    meta.EncodeTo(meta_val);
+    batch.Put(EncodeSSizeKey(destination), meta_val);
+    metrics_->profiler()->Meta(kSET_DB, destination, meta.len, meta.vol);
 
-    for (it = member_result.begin(); it != member_result.end(); it++) {
-        s = SAddNoLock(destination, it->first, &tmp_res);
-        if (!s.ok()) {
-            return s;
-        }
+    Status s = set_db_->WriteWithKeyVersion(w_opts_nolog(), &batch);
+    if (s.ok()) {
+        *res = len;
     }
-    *res = member_result.size();
-    return Status::OK();
+    return s;
 }
 
 int64_t Nemo::AddAndGetSpopCount(const std::string &key) {
@@ -691,6 +602,7 @@ void Nemo::ResetSpopCount(const std::string &key) {
 }
 
 Status Nemo::SPop(const std::string &key, std::string &member) {
+    MetricsScope metrics(metrics_, kCmdSPop, key);
 #define SPOP_COMPACT_THRESHOLD_COUNT 500
     int64_t card = 0;
     SCard(key,&card);
@@ -708,7 +620,7 @@ Status Nemo::SPop(const std::string &key, std::string &member) {
     for (int i = 0; i < k - 1; i++) {
         iter->Next();
     }
-    member = iter->member();
+    member = iter->member().ToString();
     delete iter;
    
     duration_us = NowMicros() - start_us;
@@ -779,7 +691,7 @@ Status Nemo::SRandMember(const std::string &key, std::vector<std::string> &membe
     for (int i = 0, cnt = 0; iter->Valid() && cnt < ncount; iter->Next(), i++) {
         if (idx_flag.find(i) != idx_flag.end()) {
             for (int j = 0; j < idx_flag[i]; j++) {
-                members.push_back(iter->member());
+                members.push_back(iter->member().ToString());
                 cnt++;
             }
         }
@@ -807,12 +719,10 @@ Status Nemo::SMove(const std::string &source, const std::string &destination, co
     std::string destination_key = EncodeSetKey(destination, member);
 
 
-    std::set<std::string> lock_keys;
-    lock_keys.insert(source);
-    lock_keys.insert(destination);    
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      RecordLock l(&mutex_set_record_, *iter);
-    }
+    std::vector<std::string> lock_keys;
+    lock_keys.push_back(source);
+    lock_keys.push_back(destination);
+    MultiRecordLock l(&mutex_set_record_, lock_keys);
 
 //  RecordLock l1(&mutex_set_record_, source);
 //  RecordLock l2(&mutex_set_record_, destination);
@@ -875,6 +785,7 @@ Status Nemo::SDelKey(const std::string &key, int64_t *res) {
         std::string meta_val;
         meta.EncodeTo(meta_val);        
         s = set_db_->PutWithKeyVersion(rocksdb::WriteOptions(), size_key, meta_val);
+        metrics_->profiler()->Meta(kSET_DB, key, 0, 0);
       }
     }
     return s;
@@ -903,7 +814,10 @@ Status Nemo::SExpire(const std::string &key, const int32_t seconds, int64_t *res
 
       if (seconds > 0) {
         //MutexLock l(&mutex_set_);
-        s = set_db_->Put(w_opts_nolog(), size_key, val, seconds);
+        s = expire_sweeper_->Index(DataType::kSSize, key, std::time(0) + seconds);
+        if (s.ok()) {
+          s = set_db_->Put(w_opts_nolog(), size_key, val, seconds);
+        }
       } else { 
         int64_t count;
         s = SDelKey(key, &count);
@@ -988,7 +902,10 @@ Status Nemo::SExpireat(const std::string &key, const int32_t timestamp, int64_t
         s = SDelKey(key, &count);
       } else {
         //MutexLock l(&mutex_set_);
-        s = set_db_->PutWithExpiredTime(w_opts_nolog(), size_key, val, timestamp);
+        s = expire_sweeper_->Index(DataType::kSSize, key, timestamp);
+        if (s.ok()) {
+          s = set_db_->PutWithExpiredTime(w_opts_nolog(), size_key, val, timestamp);
+        }
       }
       *res = 1;
     }
@@ -1012,7 +929,5 @@ SmetaIterator * Nemo::SmetaScan( const std::string &start, const std::string &en
 
     IteratorOptions iter_options(key_end, limit, read_options);
     
-    rocksdb::Iterator *it = set_db_->NewIterator(read_options);
-    it->Seek(key_start);
-    return new SmetaIterator(it,set_db_.get() ,iter_options,start); 
+    return new SmetaIterator(set_db_.get(), iter_options, key_start); 
 }
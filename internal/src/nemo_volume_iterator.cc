@@ -1,5 +1,6 @@
 #include "nemo_volume_iterator.h"
 #include <algorithm>
+#include "rocksdb/convenience.h"
 //#include <iostream>
 //volume scan
 
@@ -28,6 +29,10 @@ inline bool cmp(const nemo::KVT & kvt1, const nemo::KVT & kvt2){
     return false;
 }
 
+inline bool SampleLess(const rocksdb::NemoVolumeSample * a, const rocksdb::NemoVolumeSample * b){
+  return a->key < b->key;
+}
+
 void nemo::VolumeIterator::Init(){
   valid_ = false;
 
@@ -172,102 +177,274 @@ std::string nemo::VolumeIterator::targetKey(){
   return targetKey_;
 }
 
-nemo::Status nemo::Nemo::RangeDel(const std::string  & start, const std::string & end, uint64_t limit){
-    nemo::Status s;
+nemo::VolumeIndex::VolumeIndex(Nemo * nemo) : n(nemo), rebuilds_(0) {
+  dbs_.push_back(n->kv_db_.get());
+  dbs_.push_back(n->hash_db_.get());
+  dbs_.push_back(n->list_db_.get());
+  dbs_.push_back(n->zset_db_.get());
+  dbs_.push_back(n->set_db_.get());
+  files_.resize(dbs_.size());
+}
 
-    KIteratorRO* kit = KScanRO(start,end,limit,true);
-    while(kit->Valid()){
-      s = kv_db_->Delete(rocksdb::WriteOptions(), kit->key());
-      if(s.ok()){
-        kit->Next();
-      }
-      else{
-        delete kit;
-        return s;
-      }
+// The samples are only merged again if a file of one of the dbs came or went
+nemo::Status nemo::VolumeIndex::Refresh(){
+  bool rebuild = false;
+  for (size_t i = 0; i < dbs_.size(); i++) {
+    bool changed;
+    Status s = dbs_[i]->GetVolumeSamples(&files_[i], &changed);
+    if (!s.ok()) {
+      return s;
     }
-    delete kit;
-
-    HmetaIterator * Hit = HmetaScan(start,end,limit,true);
-    HashMeta hmeta;
-    std::string meta_val;
-    hmeta.len = 0;
-    hmeta.vol = 0;
-    hmeta.EncodeTo(meta_val);
-    while(Hit->Valid()){
-      s = hash_db_->PutWithKeyVersion(rocksdb::WriteOptions(), Hit->rawkey(),meta_val);
-      if(s.ok()){
-        Hit->Next();
-      }
-      else{
-        delete Hit;        
-        return s;
+    rebuild = rebuild || changed;
+  }
+  if (!rebuild) {
+    return Status::OK();
+  }
+
+  std::vector<const rocksdb::NemoVolumeSample *> samples;
+  for (size_t i = 0; i < files_.size(); i++) {
+    rocksdb::NemoVolumeSamples::const_iterator it = files_[i].begin();
+    for (; it != files_[i].end(); ++it) {
+      for (size_t j = 0; j < it->second.size(); j++) {
+        samples.push_back(&it->second[j]);
       }
     }
-    delete Hit;
-
-    LmetaIterator *Lit = LmetaScan(start,end,limit,true);
-    ListMeta lmeta = ListMeta();
-    lmeta.EncodeTo(meta_val);
-    while(Lit->Valid()){
-      s = list_db_->PutWithKeyVersion(rocksdb::WriteOptions(), Lit->rawkey(),meta_val);
-      if(s.ok()){
-        Lit->Next();
-      }
-      else{
-        delete Lit;        
-        return s;
+  }
+  std::sort(samples.begin(), samples.end(), SampleLess);
+
+  keys_.resize(samples.size());
+  sums_.resize(samples.size());
+  int64_t sum = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    keys_[i] = samples[i]->key;
+    sum += samples[i]->volume;
+    sums_[i] = sum;
+  }
+  rebuilds_++;
+  return Status::OK();
+}
+
+size_t nemo::VolumeIndex::Find(const std::string &key){
+  return std::lower_bound(keys_.begin(), keys_.end(), key) - keys_.begin();
+}
+
+nemo::Status nemo::VolumeIndex::Volume(const std::string &start, const std::string &end, int64_t *volume){
+  mu_.Lock();
+  Status s = Refresh();
+  if (s.ok()) {
+    size_t lo = Find(start);
+    size_t hi = end.empty() ? keys_.size() : Find(end);
+    *volume = hi > lo ? SumBefore(hi) - SumBefore(lo) : 0;
+  }
+  mu_.Unlock();
+  return s;
+}
+
+nemo::Status nemo::VolumeIndex::TargetKey(const std::string &start, const std::string &end, int64_t target, std::string *key){
+  mu_.Lock();
+  Status s = Refresh();
+  if (s.ok()) {
+    size_t lo = Find(start);
+    size_t hi = end.empty() ? keys_.size() : Find(end);
+    if (hi <= lo) {
+      s = Status::NotFound("");
+    } else {
+      // sums_ never decreases, the volumes are positive
+      std::vector<int64_t>::iterator it = std::lower_bound(sums_.begin() + lo,
+          sums_.begin() + hi, SumBefore(lo) + target);
+      if (it == sums_.begin() + hi) {
+        s = Status::NotFound("");
+      } else {
+        *key = keys_[it - sums_.begin()];
       }
     }
-    delete Lit;
-
-    SmetaIterator * Sit = SmetaScan(start,end,limit,true);
-    SetMeta smeta;
-    smeta.len = 0;
-    smeta.vol = 0;
-    smeta.EncodeTo(meta_val);
-    while(Sit->Valid()){
-      s = set_db_->PutWithKeyVersion(rocksdb::WriteOptions(), Sit->rawkey(),meta_val);
-      if(s.ok()){
-        Sit->Next();
-      }
-      else{
-        delete Sit;
-        return s;
-      }
+  }
+  mu_.Unlock();
+  return s;
+}
+
+size_t nemo::VolumeIndex::samples(){
+  mu_.Lock();
+  size_t size = keys_.size();
+  mu_.Unlock();
+  return size;
+}
+
+uint64_t nemo::VolumeIndex::rebuilds(){
+  mu_.Lock();
+  uint64_t rebuilds = rebuilds_;
+  mu_.Unlock();
+  return rebuilds;
+}
+
+namespace {
+
+// The end of [start, end) raw keys of db, end empty for past its last key.
+// false if db holds nothing from start on
+bool RangeEnd(rocksdb::DBNemo *db, const std::string &start, const std::string &end, std::string *range_end) {
+  if (!end.empty()) {
+    range_end->assign(end);
+    return start < end;
+  }
+  rocksdb::Iterator *it = db->GetBaseDB()->NewIterator(rocksdb::ReadOptions(), db->DefaultColumnFamily());
+  it->SeekToLast();
+  bool valid = it->Valid() && it->key().compare(start) >= 0;
+  if (valid) {
+    range_end->assign(it->key().data(), it->key().size());
+    range_end->push_back('\0');
+  }
+  delete it;
+  return valid;
+}
+
+// The data key ranges db holds a key of, so that no tombstone or compaction
+// is spent on the others
+void NonEmptyRanges(rocksdb::DBNemo *db, const nemo::KeyRanges &ranges, nemo::KeyRanges *non_empty) {
+  rocksdb::Iterator *it = db->GetBaseDB()->NewIterator(rocksdb::ReadOptions(), db->DefaultColumnFamily());
+  for (size_t i = 0; i < ranges.size(); i++) {
+    it->Seek(ranges[i].first);
+    if (it->Valid() && it->key().compare(ranges[i].second) < 0) {
+      non_empty->push_back(ranges[i]);
+    }
+  }
+  delete it;
+}
+
+// A key below end, by at most the keys starting with it and 16 0xff bytes,
+// as DeleteFilesInRange also drops the files ending at its end
+std::string FilesRangeEnd(const std::string &end) {
+  std::string last = end;
+  if (last[last.size() - 1] == '\0') {
+    last.resize(last.size() - 1);
+  } else {
+    last[last.size() - 1]--;
+    last.append(16, '\xff');
+  }
+  return last;
+}
+
+// The default limit of RangeDel, which takes no scan
+const uint64_t kNoLimit = 1ULL << 60;
+
+// Lowers *end, of the user keys [start, *end), to just past the limit-th key
+// of db from start, by the meta keys of meta_prefix or by the kv keys for 0
+void LimitEnd(rocksdb::DBNemo *db, char meta_prefix, const std::string &start, uint64_t limit, std::string *end) {
+  nemo::KeyRanges ranges;
+  if (meta_prefix == 0) {
+    ranges.push_back(std::make_pair(start, *end));
+  } else {
+    nemo::MetaKeyRange(meta_prefix, start, *end, &ranges);
+  }
+  if (ranges.empty()) {
+    return;
+  }
+  size_t skip = meta_prefix == 0 ? 0 : 1;
+  const std::string &range_end = ranges[0].second;
+  rocksdb::Iterator *it = db->GetBaseDB()->NewIterator(rocksdb::ReadOptions(), db->DefaultColumnFamily());
+  uint64_t n = 0;
+  for (it->Seek(ranges[0].first); it->Valid(); it->Next()) {
+    if (!range_end.empty() && it->key().compare(range_end) >= 0) {
+      break;
+    }
+    if (++n == limit) {
+      end->assign(it->key().data() + skip, it->key().size() - skip);
+      end->push_back('\0');
+      break;
+    }
+  }
+  delete it;
+}
+
+nemo::Status DeleteKeyRanges(rocksdb::DBNemo *db, const nemo::KeyRanges &ranges, bool delete_files) {
+  nemo::Status s;
+  for (size_t i = 0; i < ranges.size() && s.ok(); i++) {
+    rocksdb::Slice b(ranges[i].first), e(ranges[i].second);
+    if (delete_files) {
+      std::string last = FilesRangeEnd(ranges[i].second);
+      rocksdb::Slice l(last);
+      s = rocksdb::DeleteFilesInRange(db->GetBaseDB(), db->DefaultColumnFamily(), &b, &l);
+    }
+    if (s.ok()) {
+      s = db->DeleteRange(rocksdb::WriteOptions(), db->DefaultColumnFamily(), b, e);
     }
-    delete Sit;
-
-    ZmetaIterator * Zit = ZmetaScan(start,end,limit,true);
-    ZSetMeta zmeta;
-    zmeta.len = 0;
-    zmeta.vol = 0;
-    zmeta.EncodeTo(meta_val);
-    while(Zit->Valid()){
-      s = zset_db_->PutWithKeyVersion(rocksdb::WriteOptions(), Zit->rawkey(),meta_val);
-      if(s.ok()){
-        Zit->Next();
+  }
+  return s;
+}
+
+}
+
+// Range tombstones over the kv keys, the meta keys and the data keys of
+// every length of each type, the metas first so that a failure leaves no
+// meta whose data is gone. The ranges are compacted in the background, which
+// drops the tombstones with the keys under them.
+nemo::Status nemo::Nemo::RangeDel(const std::string  & start, const std::string & end, uint64_t limit){
+    return DoRangeDel(start, end, limit, false);
+}
+
+nemo::Status nemo::Nemo::RangeDelFiles(const std::string &start, const std::string &end){
+    return DoRangeDel(start, end, kNoLimit, true);
+}
+
+nemo::Status nemo::Nemo::DoRangeDel(const std::string &start, const std::string &end, uint64_t limit, bool delete_files){
+    if (limit == 0) {
+      return nemo::Status::OK();
+    }
+    struct TypeDB {
+      DBType type;
+      rocksdb::DBNemo *db;
+      char meta_prefix;
+      char data_prefixes[4];
+    } dbs[] = {
+      {DBType::kKV_DB, kv_db_.get(), 0, {0}},
+      {DBType::kHASH_DB, hash_db_.get(), DataType::kHSize, {DataType::kHash, 0}},
+      {DBType::kLIST_DB, list_db_.get(), DataType::kLMeta, {DataType::kList, 0}},
+      {DBType::kSET_DB, set_db_.get(), DataType::kSSize, {DataType::kSet, 0}},
+      {DBType::kZSET_DB, zset_db_.get(), DataType::kZSize, {DataType::kZSet, DataType::kZScore, DataType::kZRank, 0}},
+    };
+
+    for (size_t i = 0; i < sizeof(dbs) / sizeof(dbs[0]); i++) {
+      std::string type_end = end;
+      if (limit < kNoLimit) {
+        LimitEnd(dbs[i].db, dbs[i].meta_prefix, start, limit, &type_end);
+      }
+      KeyRanges ranges;
+      if (dbs[i].meta_prefix == 0) {
+        std::string range_end;
+        if (RangeEnd(dbs[i].db, start, type_end, &range_end)) {
+          ranges.push_back(std::make_pair(start, range_end));
+        }
+      } else {
+        MetaKeyRange(dbs[i].meta_prefix, start, type_end, &ranges);
+        KeyRanges data_ranges;
+        for (const char *p = dbs[i].data_prefixes; *p != '\0'; p++) {
+          DataKeyRanges(*p, start, type_end, &data_ranges);
+        }
+        NonEmptyRanges(dbs[i].db, data_ranges, &ranges);
       }
-      else{
-        delete Zit;
+
+      Status s = DeleteKeyRanges(dbs[i].db, ranges, delete_files);
+      if (!s.ok()) {
         return s;
       }
+      for (size_t j = 0; j < ranges.size(); j++) {
+        AddBGTask({dbs[i].type, OPERATION::kCLEAN_RANGE, ranges[j].first, ranges[j].second});
+      }
     }
-    delete Zit;
-
     return nemo::Status::OK();
 }
 
 nemo::Status nemo::Nemo::RangeDelWithHandle(rocksdb::DBNemo * db,const std::string  & start, const std::string & end, uint64_t limit){
-    KIteratorRO * it = KScanWithHandle(db,start,end,limit);
-    nemo::Status s;
-    for(;it->Valid();it->Next()){
-            s = db->Delete(rocksdb::WriteOptions(),it->key());
-            if(!s.ok()){
-                delete it;
-                return s;
-            }
+    if (limit == 0) {
+      return nemo::Status::OK();
     }
-    delete it;
-    return nemo::Status::OK();
+    std::string limit_end = end;
+    if (limit < kNoLimit) {
+      LimitEnd(db, 0, start, limit, &limit_end);
+    }
+    KeyRanges ranges;
+    std::string range_end;
+    if (RangeEnd(db, start, limit_end, &range_end)) {
+      ranges.push_back(std::make_pair(start, range_end));
+    }
+    return DeleteKeyRanges(db, ranges, false);
 }
@@ -0,0 +1,230 @@
+#include "nemo_write_group.h"
+#include "xdebug.h"
+
+namespace nemo {
+
+WriteFuture::WriteFuture(const Status &status) : state_(new State()) {
+    state_->status = status;
+    state_->done.store(true);
+}
+
+bool WriteFuture::Ready() const {
+    return state_ == NULL || state_->done.load(std::memory_order_acquire);
+}
+
+Status WriteFuture::Wait() const {
+    if (state_ == NULL) {
+        return Status::OK();
+    }
+    if (!state_->done.load(std::memory_order_acquire)) {
+        state_->mu.Lock();
+        while (!state_->done.load(std::memory_order_relaxed)) {
+            state_->cv.Wait();
+        }
+        state_->mu.Unlock();
+    }
+    return state_->status;
+}
+
+static void WriteGroupThread(WriteGroup *group) {
+    group->Run();
+}
+
+WriteGroup::WriteGroup(rocksdb::DBNemo *db, bool enabled, int max_bytes)
+    : db_(db),
+    enabled_(enabled),
+    max_bytes_(max_bytes > 0 ? max_bytes : 1),
+    cv_(&mu_),
+    running_(false),
+    stopping_(false),
+    writes_(0),
+    groups_(0),
+    bytes_(0),
+    max_group_(0) {
+    if (enabled_) {
+        thread_ = std::thread(&WriteGroupThread, this);
+    }
+}
+
+WriteGroup::~WriteGroup() {
+    mu_.Lock();
+    stopping_ = true;
+    cv_.SignalAll();
+    mu_.Unlock();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+// The WriteOptions of a rocksdb write are those of all its batches
+bool WriteGroup::Compatible(const rocksdb::WriteOptions &a, const rocksdb::WriteOptions &b) {
+    return a.sync == b.sync && a.disableWAL == b.disableWAL;
+}
+
+void WriteGroup::Complete(WriteFuture::State *state, const Status &status) {
+    state->mu.Lock();
+    state->status = status;
+    state->done.store(true, std::memory_order_release);
+    state->cv.SignalAll();
+    state->mu.Unlock();
+}
+
+void WriteGroup::Record(uint64_t writes, uint64_t bytes) {
+    writes_.fetch_add(writes, std::memory_order_relaxed);
+    groups_.fetch_add(1, std::memory_order_relaxed);
+    bytes_.fetch_add(bytes, std::memory_order_relaxed);
+    uint64_t max = max_group_.load(std::memory_order_relaxed);
+    while (writes > max && !max_group_.compare_exchange_weak(max, writes, std::memory_order_relaxed)) {
+    }
+}
+
+WriteFuture WriteGroup::Submit(const rocksdb::WriteOptions &opts, rocksdb::NemoWriteKind kind,
+                               rocksdb::WriteBatch *updates, int32_t arg) {
+    if (!enabled_) {
+        return WriteFuture(Write(opts, kind, updates, arg));
+    }
+    Request *request = new Request();
+    Status s = db_->PrepareWrite(kind, updates, arg, &request->prepared);
+    if (!s.ok()) {
+        delete request;
+        return WriteFuture(s);
+    }
+    request->opts = opts;
+    request->state.reset(new WriteFuture::State());
+    WriteFuture future;
+    future.state_ = request->state;
+
+    mu_.Lock();
+    queue_.push_back(request);
+    if (!running_) {
+        cv_.Signal();
+    }
+    mu_.Unlock();
+    return future;
+}
+
+Status WriteGroup::Write(const rocksdb::WriteOptions &opts, rocksdb::NemoWriteKind kind,
+                         rocksdb::WriteBatch *updates, int32_t arg) {
+    rocksdb::NemoPreparedWrite prepared;
+    Status s = db_->PrepareWrite(kind, updates, arg, &prepared);
+    if (!s.ok()) {
+        return s;
+    }
+    std::vector<rocksdb::NemoPreparedWrite *> writes(1, &prepared);
+    if (!enabled_) {
+        return db_->WritePrepared(opts, writes);
+    }
+
+    mu_.Lock();
+    if (!running_ && queue_.empty()) {
+        // Nothing to group with, no need for a trip to the thread
+        running_ = true;
+        mu_.Unlock();
+        s = db_->WritePrepared(opts, writes);
+        Record(1, prepared.batch.GetDataSize());
+        mu_.Lock();
+        running_ = false;
+        if (!queue_.empty() || stopping_) {
+            cv_.Signal();
+        }
+        mu_.Unlock();
+        return s;
+    }
+    Request *request = new Request();
+    request->opts = opts;
+    request->prepared.batch = std::move(prepared.batch);
+    request->prepared.meta_updates.swap(prepared.meta_updates);
+    request->state.reset(new WriteFuture::State());
+    WriteFuture future;
+    future.state_ = request->state;
+    queue_.push_back(request);
+    mu_.Unlock();
+    return future.Wait();
+}
+
+// An empty write queued behind the others, with the options of the last
+// one so that it joins its group
+Status WriteGroup::Drain() {
+    if (!enabled_) {
+        return Status::OK();
+    }
+    mu_.Lock();
+    if (!running_ && queue_.empty()) {
+        mu_.Unlock();
+        return Status::OK();
+    }
+    Request *request = new Request();
+    if (!queue_.empty()) {
+        request->opts = queue_.back()->opts;
+    }
+    request->state.reset(new WriteFuture::State());
+    WriteFuture future;
+    future.state_ = request->state;
+    queue_.push_back(request);
+    if (!running_) {
+        cv_.Signal();
+    }
+    mu_.Unlock();
+    return future.Wait();
+}
+
+void WriteGroup::Run() {
+    std::vector<Request *> group;
+    std::vector<rocksdb::NemoPreparedWrite *> writes;
+    mu_.Lock();
+    while (true) {
+        // A direct write may still run while stopping, the queue waits for it
+        while (running_ || (!stopping_ && queue_.empty())) {
+            cv_.Wait();
+        }
+        if (queue_.empty()) {
+            break;
+        }
+        // The first write goes whatever its size
+        size_t bytes = 0;
+        group.clear();
+        writes.clear();
+        while (!queue_.empty()) {
+            Request *request = queue_.front();
+            size_t size = request->prepared.batch.GetDataSize();
+            if (!group.empty() && (bytes + size > max_bytes_ || !Compatible(group[0]->opts, request->opts))) {
+                break;
+            }
+            queue_.pop_front();
+            group.push_back(request);
+            // the empty ones of Drain only wait for the others
+            if (request->prepared.batch.Count() > 0) {
+                writes.push_back(&request->prepared);
+            }
+            bytes += size;
+        }
+        running_ = true;
+        mu_.Unlock();
+
+        Status s;
+        if (!writes.empty()) {
+            s = db_->WritePrepared(group[0]->opts, writes);
+            if (!s.ok()) {
+                log_warn("write group of %zu writes failed, %s", writes.size(), s.ToString().c_str());
+            }
+            Record(writes.size(), bytes);
+        }
+        for (size_t i = 0; i < group.size(); i++) {
+            Complete(group[i]->state.get(), s);
+            delete group[i];
+        }
+
+        mu_.Lock();
+        running_ = false;
+    }
+    mu_.Unlock();
+}
+
+void WriteGroup::GetStats(WriteGroupStats *stats) {
+    stats->writes = writes_.load(std::memory_order_relaxed);
+    stats->groups = groups_.load(std::memory_order_relaxed);
+    stats->bytes = bytes_.load(std::memory_order_relaxed);
+    stats->max_group = max_group_.load(std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,94 @@
+#ifndef NEMO_INCLUDE_NEMO_WRITE_GROUP_H_
+#define NEMO_INCLUDE_NEMO_WRITE_GROUP_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "nemo.h"
+#include "port.h"
+
+namespace nemo {
+
+struct WriteFuture::State {
+    port::Mutex mu;
+    port::CondVar cv;
+    std::atomic<bool> done;
+    Status status;
+    State() : cv(&mu), done(false) {}
+};
+
+// Group commit of the writes to one DBNemo, see Options::write_group.
+//
+// A write is rewritten by DBNemo::PrepareWrite on the thread of its caller,
+// who holds the record lock of its key if the write reads its meta, as all
+// but the kv ones do, then written by one of:
+//
+//   - the caller itself, if no write of the group is running nor queued
+//   - the thread of the group, which takes the writes queued while a write
+//     runs, up to max_bytes of batches of one WriteOptions, and writes them
+//     by one DBNemo::WritePrepared, so one WAL write, and one fsync with
+//     sync, for all of them
+//
+// Each write has its future, done with the status of the rocksdb write of
+// its group. One write runs at a time, the writes queued by a thread are
+// written in order.
+class WriteGroup {
+public:
+    // enabled false writes every batch on the thread of its caller, as the
+    // Write variants of DBNemo do
+    WriteGroup(rocksdb::DBNemo *db, bool enabled, int max_bytes);
+    // Writes the queued writes first
+    ~WriteGroup();
+
+    // Queues the write, done at once if it fails to prepare, or without a
+    // thread
+    WriteFuture Submit(const rocksdb::WriteOptions &opts, rocksdb::NemoWriteKind kind,
+                       rocksdb::WriteBatch *updates, int32_t arg = 0);
+    // Writes and waits for the write
+    Status Write(const rocksdb::WriteOptions &opts, rocksdb::NemoWriteKind kind,
+                 rocksdb::WriteBatch *updates, int32_t arg = 0);
+    // Waits for the writes queued before the call
+    Status Drain();
+    void GetStats(WriteGroupStats *stats);
+
+    void Run();
+
+private:
+    struct Request {
+        rocksdb::WriteOptions opts;
+        rocksdb::NemoPreparedWrite prepared;
+        std::shared_ptr<WriteFuture::State> state;
+    };
+
+    static bool Compatible(const rocksdb::WriteOptions &a, const rocksdb::WriteOptions &b);
+    static void Complete(WriteFuture::State *state, const Status &status);
+    void Record(uint64_t writes, uint64_t bytes);
+
+    rocksdb::DBNemo *db_;
+    bool enabled_;
+    size_t max_bytes_;
+    std::thread thread_;
+
+    // Guards queue_, running_ and stopping_
+    port::Mutex mu_;
+    port::CondVar cv_;
+    std::deque<Request *> queue_;
+    bool running_;
+    bool stopping_;
+
+    std::atomic<uint64_t> writes_;
+    std::atomic<uint64_t> groups_;
+    std::atomic<uint64_t> bytes_;
+    std::atomic<uint64_t> max_group_;
+
+    //No Copying Allowed
+    WriteGroup(const WriteGroup&);
+    void operator=(const WriteGroup&);
+};
+
+}
+#endif
@@ -4,6 +4,10 @@
 #include <set>
 
 #include "nemo_zset.h"
+#include "nemo_expire.h"
+#include "nemo_metrics.h"
+#include "nemo_zset_rank.h"
+#include "nemo_merge.h"
 #include "nemo_mutex.h"
 #include "nemo_iterator.h"
 #include "util.h"
@@ -139,18 +143,34 @@ Status Nemo::ZChecknRecover(const std::string& key) {
     return s;
   }
   // Compare
-  if (meta.len == field_count) {
-    return Status::OK();
+  if (meta.len != field_count) {
+    // Fix if needed
+    rocksdb::WriteBatch writebatch;
+    if (IncrZLen(key, (field_count - meta.len),(volume - meta.vol) , writebatch) == -1) {
+      return Status::Corruption("fix zset meta error");
+    }
+    s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &(writebatch));
+    if (!s.ok()) {
+      return s;
+    }
   }
-  // Fix if needed
-  rocksdb::WriteBatch writebatch;
-  if (IncrZLen(key, (field_count - meta.len),(volume - meta.vol) , writebatch) == -1) {
-    return Status::Corruption("fix zset meta error");
+  // Rebuild the rank index if its counts are off, or the set has none yet
+  ZRankIndex rank(zset_db_.get(), key);
+  bool consistent = false;
+  s = rank.Check(&consistent);
+  if (!s.ok() || consistent) {
+    return s;
+  }
+  s = rank.Build();
+  if (!s.ok()) {
+    return s;
   }
-  return zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &(writebatch));
+  rocksdb::WriteBatch rank_batch;
+  return rank.Commit(w_opts_nolog(), &rank_batch);
 }
 
 Status Nemo::ZAdd(const std::string &key, const double score, const std::string &member, int64_t *res) {
+    MetricsScope metrics(metrics_, kCmdZAdd, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -169,10 +189,16 @@ Status Nemo::ZAdd(const std::string &key, const double score, const std::string
     rocksdb::WriteBatch batch;
     //MutexLock l(&mutex_zset_);
     RecordLock l(&mutex_zset_record_, key);
-    int ret = DoZSet(key, score, member, batch);
+    ZRankIndex rank(zset_db_.get(), key);
+    rank.SetWriteGroup(zset_group_);
+    s = rank.Open();
+    if (!s.ok()) {
+        return s;
+    }
+    int ret = DoZSet(key, score, member, batch, rank);
     if (ret == 2) {
         if (IncrZLen(key, 1, key.size()*2+member.size()*2+sizeof(double)+sizeof(int64_t), batch) == 0) {
-            s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+            s = rank.Commit(w_opts_nolog(), &batch);
             *res = 1;
             return s;
         } else {
@@ -180,7 +206,7 @@ Status Nemo::ZAdd(const std::string &key, const double score, const std::string
         }
     } else if (ret == 1) {
         *res = 0;
-        s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+        s = rank.Commit(w_opts_nolog(), &batch);
         return s;
     } else if (ret == 0) {
         *res = 0;
@@ -212,14 +238,25 @@ Status Nemo::ZMAdd(const std::string &key, const std::vector<SM> &sms, int64_t *
     rocksdb::WriteBatch batch;
     //MutexLock l(&mutex_zset_);
     RecordLock l(&mutex_zset_record_, key);
+    ZRankIndex rank(zset_db_.get(), key);
+    s = rank.Open();
+    if (!s.ok()) {
+        return s;
+    }
 
     int64_t count = 0;
     (*res) = 0;
     int64_t sum = 0;
     int64_t volume = 0;     
-    for(SM sm:sms)
+    // DoZSet reads no pending write, so the last score of a member wins
+    std::set<std::string> seen;
+    for (std::vector<SM>::const_reverse_iterator it = sms.rbegin(); it != sms.rend(); ++it)
     {
-        int ret = DoZSet(key, sm.score, sm.member, batch);
+        const SM &sm = *it;
+        if (!seen.insert(sm.member).second) {
+            continue;
+        }
+        int ret = DoZSet(key, sm.score, sm.member, batch, rank);
         if (ret == 2) {
             (*res)++;
             sum++;
@@ -239,7 +276,7 @@ Status Nemo::ZMAdd(const std::string &key, const std::vector<SM> &sms, int64_t *
         if(sum>0)
             if (IncrZLen(key, sum, volume, batch) < 0)
                 return Status::Corruption("incr zsize error");             
-        s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);                     
+        s = rank.Commit(w_opts_nolog(), &batch);
     }
     return s;
 }
@@ -254,10 +291,15 @@ Status Nemo::ZAddNoLock(const std::string &key, const double score, const std::s
     //std::string size_key = EncodeZSizeKey(key);
     //std::string score_key = EncodeZScoreKey(key, member, score); 
     rocksdb::WriteBatch batch;
-    int ret = DoZSet(key, score, member, batch);
+    ZRankIndex rank(zset_db_.get(), key);
+    s = rank.Open();
+    if (!s.ok()) {
+        return s;
+    }
+    int ret = DoZSet(key, score, member, batch, rank);
     if (ret == 2) {
         if (IncrZLen(key, 1, key.size()*2+member.size()*2+sizeof(double)+sizeof(int64_t),batch) == 0) {
-            s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+            s = rank.Commit(w_opts_nolog(), &batch);
             *res = 1;
             return s;
         } else {
@@ -265,7 +307,7 @@ Status Nemo::ZAddNoLock(const std::string &key, const double score, const std::s
         }
     } else if (ret == 1) {
         *res = 0;
-        s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+        s = rank.Commit(w_opts_nolog(), &batch);
         return s;
     } else if (ret == 0) {
         *res = 0;
@@ -342,9 +384,7 @@ ZIterator* Nemo::ZScan(const std::string &key, const double begin, const double
 
     IteratorOptions iter_options(key_end, limit, read_options);
 
-    rocksdb::Iterator *it = zset_db_->NewIterator(read_options);
-    it->Seek(key_start);
-    return new ZIterator(it, zset_db_.get(), iter_options, key); 
+    return new ZIterator(zset_db_.get(), iter_options, key, key_start); 
 }
 
 ZLexIterator* Nemo::ZScanbylex(const std::string &key, const std::string &min, const std::string &max, uint64_t limit, bool use_snapshot) {
@@ -364,9 +404,21 @@ ZLexIterator* Nemo::ZScanbylex(const std::string &key, const std::string &min, c
 
     IteratorOptions iter_options(key_end, limit, read_options);
 
-    rocksdb::Iterator *it = zset_db_->NewIterator(read_options);
-    it->Seek(key_start);
-    return new ZLexIterator(it, zset_db_.get(), iter_options, key); 
+    return new ZLexIterator(zset_db_.get(), iter_options, key, key_start); 
+}
+
+// Iterate from the entry at rank, which index finds through the same
+// snapshot as read_options; the iterator owns that snapshot, NULL on error
+ZIterator* Nemo::ZScanFromRank(const std::string &key, const int64_t rank, ZRankIndex &index, const rocksdb::ReadOptions &read_options, Status *s) {
+    std::string score_key;
+    *s = index.Seek(rank, &score_key);
+    if (!s->ok()) {
+        return NULL;
+    }
+
+    IteratorOptions iter_options("", -1, read_options);
+
+    return new ZIterator(zset_db_.get(), iter_options, key, score_key);
 }
 
 Status Nemo::ZCount(const std::string &key, const double begin, const double end, int64_t * sum, bool is_lo, bool is_ro) {
@@ -390,6 +442,7 @@ Status Nemo::ZCount(const std::string &key, const double begin, const double end
 }
 
 Status Nemo::ZIncrby(const std::string &key, const std::string &member, const double by, std::string &new_score) {
+    MetricsScope metrics(metrics_, kCmdZIncrby, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -401,6 +454,11 @@ Status Nemo::ZIncrby(const std::string &key, const std::string &member, const do
     rocksdb::WriteBatch writebatch;
     //MutexLock l(&mutex_zset_);
     RecordLock l(&mutex_zset_record_, key);
+    ZRankIndex rank(zset_db_.get(), key);
+    s = rank.Open();
+    if (!s.ok()) {
+        return s;
+    }
 
     s = zset_db_->Get(rocksdb::ReadOptions(), db_key, &old_score);
     double dval;
@@ -408,6 +466,10 @@ Status Nemo::ZIncrby(const std::string &key, const std::string &member, const do
         dval = *((double *)old_score.data());
         score_key = EncodeZScoreKey(key, member, dval);
         writebatch.Delete(score_key);
+        s = rank.Update(score_key, -1);
+        if (!s.ok()) {
+            return s;
+        }
 
         dval += by;
         if (dval < ZSET_SCORE_MIN || dval > ZSET_SCORE_MAX) {
@@ -415,6 +477,10 @@ Status Nemo::ZIncrby(const std::string &key, const std::string &member, const do
         }
         score_key = EncodeZScoreKey(key, member, dval);
         writebatch.Put(score_key, "");
+        s = rank.Update(score_key, 1);
+        if (!s.ok()) {
+            return s;
+        }
 
         std::string buf;
         buf.append((char *)(&dval), sizeof(double));
@@ -426,6 +492,10 @@ Status Nemo::ZIncrby(const std::string &key, const std::string &member, const do
         dval = by;
         score_key = EncodeZScoreKey(key, member, by);
         writebatch.Put(score_key, "");
+        s = rank.Update(score_key, 1);
+        if (!s.ok()) {
+            return s;
+        }
 
         std::string buf;
         buf.append((char *)(&by), sizeof(double));
@@ -443,11 +513,12 @@ Status Nemo::ZIncrby(const std::string &key, const std::string &member, const do
     if (new_score[new_score.size()-1] == '.') {
         new_score = new_score.substr(0, new_score.size()-1);
     }
-    s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &writebatch);
+    s = rank.Commit(w_opts_nolog(), &writebatch);
     return s;
 }
 
 Status Nemo::ZRange(const std::string &key, const int64_t start, const int64_t stop, std::vector<SM> &sms) {
+    MetricsScope metrics(metrics_, kCmdZRange, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -466,6 +537,31 @@ Status Nemo::ZRange(const std::string &key, const int64_t start, const int64_t s
         if (t_start > t_stop || t_start > t_size - 1 || t_stop < 0) {
             return Status::OK();
         } else {
+            rocksdb::ReadOptions read_options;
+            read_options.snapshot = zset_db_->GetSnapshot();
+            read_options.fill_cache = false;
+            ZRankIndex rank(zset_db_.get(), key, read_options.snapshot);
+            bool indexed = false;
+            Status s = rank.Load(&indexed);
+            if (s.ok() && indexed) {
+                ZIterator *iter = ZScanFromRank(key, t_start, rank, read_options, &s);
+                if (iter == NULL) {
+                    zset_db_->ReleaseSnapshot(read_options.snapshot);
+                    // the set shrank since ZCard
+                    return s.IsNotFound() ? Status::OK() : s;
+                }
+                for (int64_t n = t_start; n <= t_stop && iter->Valid(); iter->Next(), n++) {
+                    sms.push_back({iter->score(), iter->member().ToString()});
+                }
+                delete iter;
+                return Status::OK();
+            }
+            zset_db_->ReleaseSnapshot(read_options.snapshot);
+            if (!s.ok()) {
+                return s;
+            }
+
+            // sets written before the rank index are scanned
             int n = 0;
             ZIterator* iter = NULL;
             if (t_size > 1000 && t_start > t_size / 2) {
@@ -476,19 +572,19 @@ Status Nemo::ZRange(const std::string &key, const int64_t start, const int64_t s
               read_options.snapshot = zset_db_->GetSnapshot();
               read_options.fill_cache = false;
               IteratorOptions iter_options(zscore_key_start, -1, read_options, kBackward);
-              rocksdb::Iterator* rocksdb_it = zset_db_->NewIterator(read_options);
-              rocksdb_it->Seek(zscore_key_end);
-              rocksdb_it->Prev();
-              iter = new ZIterator(rocksdb_it, zset_db_.get(), iter_options, key);
+              iter = new ZIterator(zset_db_.get(), iter_options, key, zscore_key_end);
               n = t_size - 1;
-              for (; n > t_stop && iter->Valid(); iter->Next(), n--);
-              if (n != t_stop) {
-                delete iter;
-                return Status::Corruption("ziterate error");
+              if (n > t_stop) {
+                iter->Skip(n - t_stop);
+                if (!iter->Valid()) {
+                  delete iter;
+                  return Status::Corruption("ziterate error");
+                }
+                n = t_stop;
               }
               sms.resize(t_stop - t_start + 1);
               for (; n >= t_start && iter->Valid(); n--) {
-                sms[n - t_start] = {iter->score(), iter->member()};
+                sms[n - t_start] = {iter->score(), iter->member().ToString()};
                 iter->Next();
               }
             } else {
@@ -497,14 +593,16 @@ Status Nemo::ZRange(const std::string &key, const int64_t start, const int64_t s
                 return Status::Corruption("zscan error");
               }
               n = 0;
-              for (; n < t_start && iter->Valid(); iter->Next(), n++);
-
-              if (n < t_start) {
-                  delete iter;
-                  return Status::Corruption("ziterate error");
+              if (t_start > 0) {
+                  iter->Skip(t_start);
+                  if (!iter->Valid()) {
+                      delete iter;
+                      return Status::Corruption("ziterate error");
+                  }
+                  n = t_start;
               }
               for (; n <= t_stop && iter->Valid(); iter->Next(), n++) {
-                  sms.push_back({iter->score(), iter->member()});
+                  sms.push_back({iter->score(), iter->member().ToString()});
               }
             }
             delete iter;
@@ -516,6 +614,7 @@ Status Nemo::ZRange(const std::string &key, const int64_t start, const int64_t s
 }
 
 Status Nemo::ZRangebyscore(const std::string &key, const double mn, const double mx, std::vector<SM> &sms, bool is_lo, bool is_ro) {
+    MetricsScope metrics(metrics_, kCmdZRangebyscore, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -524,7 +623,7 @@ Status Nemo::ZRangebyscore(const std::string &key, const double mn, const double
 //    MutexLock l(&mutex_zset_);
     ZIterator *iter = ZScan(key, start, stop, -1, true);
     for (; iter->Valid(); iter->Next()) {
-        sms.push_back({iter->score(), iter->member()});
+        sms.push_back({iter->score(), iter->member().ToString()});
     }
     delete iter;
     return Status::OK();
@@ -532,165 +631,97 @@ Status Nemo::ZRangebyscore(const std::string &key, const double mn, const double
 
 // numkeys should equal keys.size()
 Status Nemo::ZUnionStore(const std::string &destination, const int numkeys, const std::vector<std::string>& keys, const std::vector<double>& weights = std::vector<double>(), Aggregate agg = SUM, int64_t *res = 0) {
-    std::map<std::string, double> mp_member_score;
-    *res = 0;
-
-    // we should lock destination and keys in order
-    // TODO: maybe a MultiRecordLock is a better way;
-    std::set<std::string> lock_keys(keys.begin(), keys.end());
-    lock_keys.insert(destination);
-
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      mutex_zset_record_.Lock(*iter);
-      //printf ("->ZUnionStore lock key(%s)\n", iter->c_str());
-    }
-
-    int weights_size = static_cast<int>(weights.size());
-    for (int key_i = 0; key_i < numkeys; key_i++) {
-        ZIterator *iter = ZScan(keys[key_i], ZSET_SCORE_MIN, ZSET_SCORE_MAX, -1);
-        for (; iter->Valid(); iter->Next()) {
-            std::string member = iter->member();
-
-            double weight = 1;
-            if (weights_size > key_i) {
-                weight = weights[key_i];
-            }
-
-            if (mp_member_score.find(member) == mp_member_score.end()) {
-                mp_member_score[member] = weight * iter->score();
-            } else {
-                double score = mp_member_score[member];
-                switch (agg) {
-                  case SUM: score += weight * iter->score(); break;
-                  case MIN: score = std::min(score, weight * iter->score()); break;
-                  case MAX: score = std::max(score, weight * iter->score()); break;
-                }
-                mp_member_score[member] = score;
-            }
-        }
-        
-        delete iter;
-    }
-
-    int64_t add_ret;
-    int64_t rem_ret;
-    std::map<std::string, double>::iterator it;
-    Status status;
-
-    status = ZRemrangebyrankNoLock(destination, 0, -1, &rem_ret);
-
-    for (it = mp_member_score.begin(); it != mp_member_score.end(); it++) {
-        status = ZAddNoLock(destination, it->second, it->first, &add_ret);
-        if (!status.ok()) {
-            break;
-        }
-    }
-
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      mutex_zset_record_.Unlock(*iter);
-      //printf ("<-ZUnionStore unlock key(%s)\n", iter->c_str());
-    }
-
-    *res = mp_member_score.size();
-    return Status::OK();
+    return ZStore(destination, numkeys, keys, weights, agg, false, res);
 }
 
 Status Nemo::ZInterStore(const std::string &destination, const int numkeys, const std::vector<std::string>& keys, const std::vector<double>& weights = std::vector<double>(), Aggregate agg = SUM, int64_t *res = 0) {
-    Status s;
     *res = 0;
 
     if (numkeys < 2) {
         return Status::OK();
     }
+    return ZStore(destination, numkeys, keys, weights, agg, true, res);
+}
 
-    std::string l_key = keys[0];
-    std::string old_score;
-    std::string member;
-    std::string db_key;
-    int64_t add_ret;
-    std::map<std::string, double> mp_member_score;
-    double l_weight = 1;
-    double r_weight = 1;
-    double l_score;
-    int key_i;
+// Merge the member ordered kZSet keys of the sources in one pass and write
+// the result as the whole destination by one batch, whose new version drops
+// the old members without reading them
+Status Nemo::ZStore(const std::string &destination, const int numkeys, const std::vector<std::string> &keys, const std::vector<double> &weights, Aggregate agg, bool inter, int64_t *res) {
+    if (destination.size() >= KEY_MAX_LENGTH || destination.size() <= 0) {
+       return Status::InvalidArgument("Invalid key length");
+    }
+    *res = 0;
 
-    // TODO: maybe a MultiRecordLock is a better way;
-    std::set<std::string> lock_keys(keys.begin(), keys.end());
-    lock_keys.insert(destination);
+    std::vector<std::string> lock_keys(keys);
+    lock_keys.push_back(destination);
+    MultiRecordLock l(&mutex_zset_record_, lock_keys);
 
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      mutex_zset_record_.Lock(*iter);
-      //printf ("->ZInterStore lock key(%s)\n", iter->c_str());
+    std::vector<ZLexIterator *> iters;
+    for (int key_i = 0; key_i < numkeys; key_i++) {
+        iters.push_back(ZScanbylex(keys[key_i], "", "", -1, true));
     }
+    MemberMerger<ZLexIterator> merger(iters);
 
+    rocksdb::WriteBatch batch;
+    std::vector<std::string> score_keys;
+    int64_t volume = 0;
     int weights_size = static_cast<int>(weights.size());
-    if (weights_size > 1) {
-        l_weight = weights[0];
-    }
-
-    ZIterator *iter = ZScan(l_key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, -1);
-    
-    for (; iter != NULL && iter->Valid(); iter->Next()) {
-        member = iter->member();
-        l_score = l_weight * iter->score();
-
-        for (key_i = 1; key_i < numkeys; key_i++) {
-          r_weight = 1;
-          if (weights_size > key_i) {
-              r_weight = weights[key_i];
-          }
-          
-          db_key = EncodeZSetKey(keys[key_i], member);
-          s = zset_db_->Get(rocksdb::ReadOptions(), db_key, &old_score);
+    for (; merger.Valid(); merger.Next()) {
+        const std::vector<int> &sources = merger.sources();
+        if (inter && (int)sources.size() < numkeys) {
+            // nothing is left in all sources once one is drained
+            if (merger.live() < numkeys) {
+                break;
+            }
+            continue;
+        }
 
-          if (s.ok()) {
-            double r_score = *((double *)old_score.data());
+        double score = 0;
+        for (size_t i = 0; i < sources.size(); i++) {
+            int key_i = sources[i];
+            double weight = 1;
+            if (weights_size > key_i) {
+                weight = weights[key_i];
+            }
+            double r_score = weight * *((double *)merger.iter(key_i)->value().data());
+            if (i == 0) {
+                score = r_score;
+                continue;
+            }
             switch (agg) {
-              case SUM: l_score += r_weight * r_score; break;
-              case MIN: l_score = std::min(l_score, r_weight * r_score); break;
-              case MAX: l_score = std::max(l_score, r_weight * r_score); break;
+              case SUM: score += r_score; break;
+              case MIN: score = std::min(score, r_score); break;
+              case MAX: score = std::max(score, r_score); break;
             }
-          } else if (s.IsNotFound()) {
-              break;
-          } else {
-              delete iter;
-              // unlock
-              for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-                mutex_zset_record_.Unlock(*iter);
-              }
-              return s;
-          }
         }
 
-        if (key_i >= numkeys) {
-            mp_member_score[member] = l_score;
-        }
+        const std::string &member = merger.member();
+        batch.Put(EncodeZSetKey(destination, member), rocksdb::Slice((char *)&score, sizeof(double)));
+        score_keys.push_back(EncodeZScoreKey(destination, member, score));
+        batch.Put(score_keys.back(), "");
+        volume += destination.size()*2+member.size()*2+sizeof(double)+sizeof(int64_t);
     }
-    delete iter;
-
-    int64_t rem_ret;
-    std::map<std::string, double>::iterator it;
 
-    s = ZRemrangebyrankNoLock(destination, 0, -1, &rem_ret);
-
-    for (it = mp_member_score.begin(); it != mp_member_score.end(); it++) {
-        s = ZAddNoLock(destination, it->second, it->first, &add_ret);
-        if (!s.ok()) {
-           break; 
-        }
-        (*res)++;
-    }
+    ZSetMeta meta;
+    meta.len = score_keys.size();
+    meta.vol = volume;
+    std::string meta_val;
+    meta.EncodeTo(meta_val);
+    batch.Put(EncodeZSizeKey(destination), meta_val);
+    metrics_->profiler()->Meta(kZSET_DB, destination, meta.len, meta.vol);
 
-    // unlock
-    for (auto iter = lock_keys.begin(); iter != lock_keys.end(); iter++) {
-      mutex_zset_record_.Unlock(*iter);
-      //printf ("<-ZInterStore lock key(%s)\n", iter->c_str());
+    std::sort(score_keys.begin(), score_keys.end());
+    ZRankIndex rank(zset_db_.get(), destination);
+    rank.Build(score_keys);
+    Status s = rank.Commit(w_opts_nolog(), &batch, true);
+    if (s.ok()) {
+        *res = score_keys.size();
     }
-
-    return Status::OK();
+    return s;
 }
 
 Status Nemo::ZRem(const std::string &key, const std::string &member, int64_t *res) {
+    MetricsScope metrics(metrics_, kCmdZRem, key);
     if (key.size() >= KEY_MAX_LENGTH || key.size() <= 0) {
        return Status::InvalidArgument("Invalid key length");
     }
@@ -702,19 +733,28 @@ Status Nemo::ZRem(const std::string &key, const std::string &member, int64_t *re
 
     //MutexLock l(&mutex_zset_);
     RecordLock l(&mutex_zset_record_, key);
+    ZRankIndex rank(zset_db_.get(), key);
 
     std::string db_key = EncodeZSetKey(key, member);
     s = zset_db_->Get(rocksdb::ReadOptions(), db_key, &old_score);
 
     if (s.ok()) {
+      s = rank.Open();
+      if (!s.ok()) {
+        return s;
+      }
       batch.Delete(db_key);
 
       double dscore = *((double *)old_score.data());
       std::string score_key = EncodeZScoreKey(key, member, dscore);
       batch.Delete(score_key);
+      s = rank.Update(score_key, -1);
+      if (!s.ok()) {
+        return s;
+      }
 
       if (IncrZLen(key, -1, -(key.size()*2+member.size()*2+sizeof(double)+sizeof(int64_t)),batch) == 0) {
-        s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+        s = rank.Commit(w_opts_nolog(), &batch);
         *res = 1;
         return s;
       } else {
@@ -736,11 +776,21 @@ Status Nemo::ZMRem(const std::string &key, const std::vector<std::string> &membe
 
     //MutexLock l(&mutex_zset_);
     RecordLock l(&mutex_zset_record_, key);
+    ZRankIndex rank(zset_db_.get(), key);
+    s = rank.Open();
+    if (!s.ok()) {
+        return s;
+    }
     *res = 0;
     int64_t sum = 0;
     int64_t volume = 0;     
+    // a member named twice is removed once
+    std::set<std::string> seen;
     for(std::string member:members)
     {
+        if (!seen.insert(member).second) {
+            continue;
+        }
         std::string db_key = EncodeZSetKey(key, member);
         s = zset_db_->Get(rocksdb::ReadOptions(), db_key, &old_score);
 
@@ -749,6 +799,10 @@ Status Nemo::ZMRem(const std::string &key, const std::vector<std::string> &membe
             double dscore = *((double *)old_score.data());
             std::string score_key = EncodeZScoreKey(key, member, dscore);
             batch.Delete(score_key);
+            s = rank.Update(score_key, -1);
+            if (!s.ok()) {
+                return s;
+            }
             (*res)++;
             sum++;
             volume += key.size()*2+member.size()*2+sizeof(double)+sizeof(int64_t);
@@ -764,7 +818,7 @@ Status Nemo::ZMRem(const std::string &key, const std::vector<std::string> &membe
             if (IncrZLen(key, -sum, -volume, batch) < 0) {
                 return Status::Corruption("incr zsize error");
             }
-        s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);             
+        s = rank.Commit(w_opts_nolog(), &batch);
     }
     else
     {
@@ -776,16 +830,30 @@ Status Nemo::ZMRem(const std::string &key, const std::vector<std::string> &membe
 
 
 Status Nemo::ZRank(const std::string &key, const std::string &member, int64_t *rank) {
+    MetricsScope metrics(metrics_, kCmdZRank, key);
     Status s;
     *rank = 0;
     std::string old_score;
 
 //    MutexLock l(&mutex_zset_);
 
+    rocksdb::ReadOptions read_options;
+    read_options.snapshot = zset_db_->GetSnapshot();
+    ZRankIndex index(zset_db_.get(), key, read_options.snapshot);
+    bool indexed = false;
     std::string db_key = EncodeZSetKey(key, member);
-    s = zset_db_->Get(rocksdb::ReadOptions(), db_key, &old_score);
-    int64_t count = 0;
+    s = zset_db_->Get(read_options, db_key, &old_score);
     if (s.ok()) {
+        s = index.Load(&indexed);
+    }
+    if (s.ok() && indexed) {
+        int64_t total = 0;
+        s = index.Rank(EncodeZScoreKey(key, member, *((double *)old_score.data())), rank, &total);
+    }
+    zset_db_->ReleaseSnapshot(read_options.snapshot);
+
+    int64_t count = 0;
+    if (s.ok() && !indexed) {
         ZIterator *iter = ZScan(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, -1, true);
         for (; iter->Valid() && iter->member().compare(member) != 0; iter->Next()) {
             count++;
@@ -805,10 +873,24 @@ Status Nemo::ZRevrank(const std::string &key, const std::string &member, int64_t
 
 //    MutexLock l(&mutex_zset_);
 
+    rocksdb::ReadOptions read_options;
+    read_options.snapshot = zset_db_->GetSnapshot();
+    ZRankIndex index(zset_db_.get(), key, read_options.snapshot);
+    bool indexed = false;
     std::string db_key = EncodeZSetKey(key, member);
-    s = zset_db_->Get(rocksdb::ReadOptions(), db_key, &old_score);
-    int64_t count = -1;
+    s = zset_db_->Get(read_options, db_key, &old_score);
     if (s.ok()) {
+        s = index.Load(&indexed);
+    }
+    if (s.ok() && indexed) {
+        int64_t total = 0;
+        s = index.Rank(EncodeZScoreKey(key, member, *((double *)old_score.data())), rank, &total);
+        *rank = total - 1 - *rank;
+    }
+    zset_db_->ReleaseSnapshot(read_options.snapshot);
+
+    int64_t count = -1;
+    if (s.ok() && !indexed) {
         ZIterator *iter = ZScan(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, -1, true);
         for (; iter->Valid() && iter->member().compare(member) != 0; iter->Next()) {
         }
@@ -824,6 +906,7 @@ Status Nemo::ZRevrank(const std::string &key, const std::string &member, int64_t
 }
 
 Status Nemo::ZScore(const std::string &key, const std::string &member, double *score) {
+    MetricsScope metrics(metrics_, kCmdZScore, key);
     Status s;
     *score = 0;
     std::string str_score;
@@ -836,6 +919,27 @@ Status Nemo::ZScore(const std::string &key, const std::string &member, double *s
     return s;
 }
 
+Status Nemo::ZMScore(const std::string &key, const std::vector<std::string> &members, std::vector<double> &scores, std::vector<Status> &statuses) {
+    std::vector<std::string> db_keys;
+    db_keys.reserve(members.size());
+    for (size_t i = 0; i < members.size(); i++) {
+        db_keys.push_back(EncodeZSetKey(key, members[i]));
+    }
+    std::vector<rocksdb::Slice> key_slices(db_keys.begin(), db_keys.end());
+    rocksdb::NemoBatchGetResult result;
+    zset_db_->BatchGet(rocksdb::ReadOptions(), key_slices, &result);
+
+    for (size_t i = 0; i < members.size(); i++) {
+        double score = 0;
+        if (result.statuses[i].ok()) {
+            score = *((const double *)(result.values[i].data()));
+        }
+        scores.push_back(score);
+        statuses.push_back(result.statuses[i]);
+    }
+    return Status::OK();
+}
+
 Status Nemo::ZRangebylex(const std::string &key, const std::string &min, const std::string &max, std::vector<std::string> &members , bool is_lo, bool is_ro ) {
 //    MutexLock l(&mutex_zset_);
     ZLexIterator *iter = ZScanbylex(key, min, max, -1, true);
@@ -845,7 +949,7 @@ Status Nemo::ZRangebylex(const std::string &key, const std::string &min, const s
             if(iter->member() == min)
                 iter->Next();
     for (; iter->Valid(); iter->Next()) {
-        members.push_back(iter->member());
+        members.push_back(iter->member().ToString());
     }
     if(is_ro)
         if(members.size()>0)
@@ -883,6 +987,11 @@ Status Nemo::ZRemrangebylex(const std::string &key, const std::string &min, cons
     int64_t volume = 0;
     //MutexLock l(&mutex_zset_);
     RecordLock l(&mutex_zset_record_, key);
+    ZRankIndex rank(zset_db_.get(), key);
+    Status s = rank.Open();
+    if (!s.ok()) {
+        return s;
+    }
 
     ZLexIterator *iter = ZScanbylex(key, min, max, -1);
     rocksdb::WriteBatch batch;
@@ -891,10 +1000,9 @@ Status Nemo::ZRemrangebylex(const std::string &key, const std::string &min, cons
     std::string size_key;
     std::string db_key;
     std::string member;
-    Status s;
     double dscore;
     if (iter->Valid()) {
-        member = iter->member();
+        member = iter->member().ToString();
         if (min == "" || (!is_lo && member.compare(min) == 0)) {
             db_key = EncodeZSetKey(key, member);
             s = zset_db_->Get(rocksdb::ReadOptions(), db_key, &old_score);
@@ -903,9 +1011,11 @@ Status Nemo::ZRemrangebylex(const std::string &key, const std::string &min, cons
               dscore = *((double *)old_score.data());
               score_key = EncodeZScoreKey(key, member, dscore);
               batch.Delete(score_key);
+              s = rank.Update(score_key, -1);
               (*count)++;
               volume += key.size()*2 + member.size()*2 + sizeof(double) + sizeof(int64_t);
-            } else {
+            }
+            if (!s.ok()) {
                 delete iter;
                 return s;
             }
@@ -915,7 +1025,7 @@ Status Nemo::ZRemrangebylex(const std::string &key, const std::string &min, cons
       iter->Next();
     }
     for (; iter->Valid(); iter->Next()) {
-        member = iter->member();
+        member = iter->member().ToString();
         if (max == "" || member.compare(max) < 0) {
             db_key = EncodeZSetKey(key, member);
             s = zset_db_->Get(rocksdb::ReadOptions(), db_key, &old_score);
@@ -924,9 +1034,11 @@ Status Nemo::ZRemrangebylex(const std::string &key, const std::string &min, cons
               dscore = *((double *)old_score.data());
               score_key = EncodeZScoreKey(key, member, dscore);
               batch.Delete(score_key);
+              s = rank.Update(score_key, -1);
               (*count)++;
               volume += key.size()*2 + member.size()*2 + sizeof(double) + sizeof(int64_t);
-            } else {
+            }
+            if (!s.ok()) {
                 delete iter;
                 return s;
             } 
@@ -938,9 +1050,11 @@ Status Nemo::ZRemrangebylex(const std::string &key, const std::string &min, cons
               dscore = *((double *)old_score.data());
               score_key = EncodeZScoreKey(key, member, dscore);
               batch.Delete(score_key);
+              s = rank.Update(score_key, -1);
               (*count)++;
               volume += key.size()*2 + member.size()*2 + sizeof(double) + sizeof(int64_t);
-            } else {
+            }
+            if (!s.ok()) {
                 delete iter;
                 return s;
             } 
@@ -948,7 +1062,7 @@ Status Nemo::ZRemrangebylex(const std::string &key, const std::string &min, cons
     }
     delete iter;
     if (IncrZLen(key, -(*count), -volume, batch) == 0) {
-        s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+        s = rank.Commit(w_opts_nolog(), &batch);
         return s;
     } else {
         return Status::Corruption("incr zsize error");
@@ -960,61 +1074,9 @@ Status Nemo::ZRemrangebyrank(const std::string &key, const int64_t start, const
        return Status::InvalidArgument("Invalid key length");
     }
 
-    rocksdb::WriteBatch batch;
-    std::string score_key;
-    std::string size_key;
-    std::string db_key;
-    *count = 0;
-    int64_t volume = 0;
-    Status s;
     //MutexLock l(&mutex_zset_);
     RecordLock l(&mutex_zset_record_, key);
-
-    int64_t t_size = 0;
-    ZCard(key,&t_size);
-    if (t_size >= 0) {
-        int64_t t_start = start >= 0 ? start : t_size + start;
-        int64_t t_stop = stop >= 0 ? stop : t_size + stop;
-        if (t_start < 0) {
-            t_start = 0;
-        }
-        if (t_stop > t_size - 1) {
-            t_stop = t_size - 1;
-        }
-        if (t_start > t_stop || t_start > t_size - 1 || t_stop < 0) {
-            return Status::OK();
-        } else {
-            ZIterator *iter = ZScan(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, -1);
-            if (iter == NULL) {
-                return Status::Corruption("zscan error");
-            }
-            int32_t n = 0;
-            for (; n < t_start && iter->Valid(); iter->Next(), n++);
-
-            if (n<t_start) {
-                delete iter;
-                return Status::Corruption("ziterate error");
-            } else {
-                for (; n <= t_stop && iter->Valid(); iter->Next(), n++) {
-                    db_key = EncodeZSetKey(key, iter->member());
-                    score_key = EncodeZScoreKey(key, iter->member(), iter->score());
-                    batch.Delete(db_key);
-                    batch.Delete(score_key);
-                    (*count)++;
-                    volume += key.size()*2 + iter->member().size()*2 + sizeof(double) + sizeof(int64_t);
-                }
-                delete iter;
-                if (IncrZLen(key, -(*count), -volume, batch) == 0) {
-                    s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
-                    return s;
-                } else {
-                    return Status::Corruption("incr zsize error");
-                }
-            }
-        }
-    } else {
-        return Status::Corruption("get zsize error");
-    }
+    return ZRemrangebyrankNoLock(key, start, stop, count);
 }
 
 Status Nemo::ZRemrangebyrankNoLock(const std::string &key, const int64_t start, const int64_t stop, int64_t* count) {
@@ -1039,32 +1101,34 @@ Status Nemo::ZRemrangebyrankNoLock(const std::string &key, const int64_t start,
         if (t_start > t_stop || t_start > t_size - 1 || t_stop < 0) {
             return Status::OK();
         } else {
-            ZIterator *iter = ZScan(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, -1);
+            ZRankIndex rank(zset_db_.get(), key);
+            s = rank.Open();
+            if (!s.ok()) {
+                return s;
+            }
+            ZIterator *iter = ZScanFromRank(key, t_start, rank, rocksdb::ReadOptions(), &s);
             if (iter == NULL) {
-                return Status::Corruption("zscan error");
+                return s.IsNotFound() ? Status::Corruption("ziterate error") : s;
             }
-            int32_t n = 0;
-            for (; n < t_start && iter->Valid(); iter->Next(), n++);
-
-            if (n<t_start) {
-                delete iter;
-                return Status::Corruption("ziterate error");
-            } else {
-                for (; n <= t_stop && iter->Valid(); iter->Next(), n++) {
-                    db_key = EncodeZSetKey(key, iter->member());
-                    score_key = EncodeZScoreKey(key, iter->member(), iter->score());
-                    batch.Delete(db_key);
-                    batch.Delete(score_key);
-                    (*count)++;
-                    volume += key.size()*2 + iter->member().size()*2 + sizeof(double) + sizeof(int64_t);
-                }
-                delete iter;
-                if (IncrZLen(key, -(*count), -volume, batch) == 0) {
-                    s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+            for (int64_t n = t_start; n <= t_stop && iter->Valid(); iter->Next(), n++) {
+                db_key = EncodeZSetKey(key, iter->member());
+                score_key = EncodeZScoreKey(key, iter->member(), iter->score());
+                batch.Delete(db_key);
+                batch.Delete(score_key);
+                s = rank.Update(score_key, -1);
+                if (!s.ok()) {
+                    delete iter;
                     return s;
-                } else {
-                    return Status::Corruption("incr zsize error");
                 }
+                (*count)++;
+                volume += key.size()*2 + iter->member().size()*2 + sizeof(double) + sizeof(int64_t);
+            }
+            delete iter;
+            if (IncrZLen(key, -(*count), -volume, batch) == 0) {
+                s = rank.Commit(w_opts_nolog(), &batch);
+                return s;
+            } else {
+                return Status::Corruption("incr zsize error");
             }
         }
     } else {
@@ -1088,6 +1152,11 @@ Status Nemo::ZRemrangebyscore(const std::string &key, const double mn, const dou
     double stop = is_ro ? mx - eps : mx;
     RecordLock l(&mutex_zset_record_, key);
     //MutexLock l(&mutex_zset_);
+    ZRankIndex rank(zset_db_.get(), key);
+    s = rank.Open();
+    if (!s.ok()) {
+        return s;
+    }
     
     ZIterator *iter = ZScan(key, start, stop, -1);
     for (; iter->Valid(); iter->Next()) {
@@ -1095,19 +1164,24 @@ Status Nemo::ZRemrangebyscore(const std::string &key, const double mn, const dou
         score_key = EncodeZScoreKey(key, iter->member(), iter->score());
         batch.Delete(db_key);
         batch.Delete(score_key);
+        s = rank.Update(score_key, -1);
+        if (!s.ok()) {
+            delete iter;
+            return s;
+        }
         (*count)++;
         volume += key.size()*2 + iter->member().size()*2 + sizeof(double) + sizeof(int64_t);
     }
     delete iter;
     if (IncrZLen(key, -(*count), -volume, batch) == 0) {
-        s = zset_db_->WriteWithOldKeyTTL(w_opts_nolog(), &batch);
+        s = rank.Commit(w_opts_nolog(), &batch);
         return s;
     } else {
         return Status::Corruption("incr zsize error");
     }
 }
 
-int Nemo::DoZSet(const std::string &key, const double score, const std::string &member, rocksdb::WriteBatch &writebatch) {
+int Nemo::DoZSet(const std::string &key, const double score, const std::string &member, rocksdb::WriteBatch &writebatch, ZRankIndex &rank) {
     Status s;
     std::string old_score;
     std::string score_key;
@@ -1122,8 +1196,14 @@ int Nemo::DoZSet(const std::string &key, const double score, const std::string &
         } else {
           score_key = EncodeZScoreKey(key, member, dval);
           writebatch.Delete(score_key);
+          if (!rank.Update(score_key, -1).ok()) {
+              return -1;
+          }
           score_key = EncodeZScoreKey(key, member, score);
           writebatch.Put(score_key, "");
+          if (!rank.Update(score_key, 1).ok()) {
+              return -1;
+          }
 
           std::string buf;
           buf.append((char *)(&score), sizeof(double));
@@ -1133,6 +1213,9 @@ int Nemo::DoZSet(const std::string &key, const double score, const std::string &
     } else if (s.IsNotFound()) {
         score_key = EncodeZScoreKey(key, member, score);
         writebatch.Put(score_key, "");
+        if (!rank.Update(score_key, 1).ok()) {
+            return -1;
+        }
 
         std::string buf;
         buf.append((char *)(&score), sizeof(double));
@@ -1170,6 +1253,7 @@ Status Nemo::ZDelKey(const std::string &key, int64_t *res) {
         meta.EncodeTo(meta_val);           
         //MutexLock l(&mutex_zset_);
         s = zset_db_->PutWithKeyVersion(rocksdb::WriteOptions(), size_key, meta_val);
+        metrics_->profiler()->Meta(kZSET_DB, key, 0, 0);
       }
     }
 
@@ -1202,7 +1286,10 @@ Status Nemo::ZExpire(const std::string &key, const int32_t seconds, int64_t *res
 
       if (seconds > 0) {
         //MutexLock l(&mutex_zset_);
-        s = zset_db_->Put(w_opts_nolog(), size_key, val, seconds);
+        s = expire_sweeper_->Index(DataType::kZSize, key, std::time(0) + seconds);
+        if (s.ok()) {
+          s = zset_db_->Put(w_opts_nolog(), size_key, val, seconds);
+        }
       } else { 
         int64_t count;
         s = ZDelKey(key, &count);
@@ -1288,7 +1375,10 @@ Status Nemo::ZExpireat(const std::string &key, const int32_t timestamp, int64_t
         s = ZDelKey(key, &count);
       } else {
         //MutexLock l(&mutex_zset_);
-        s = zset_db_->PutWithExpiredTime(w_opts_nolog(), size_key, val, timestamp);
+        s = expire_sweeper_->Index(DataType::kZSize, key, timestamp);
+        if (s.ok()) {
+          s = zset_db_->PutWithExpiredTime(w_opts_nolog(), size_key, val, timestamp);
+        }
       }
       *res = 1;
     }
@@ -1317,6 +1407,7 @@ int Nemo::IncrZLen(const std::string &key, int64_t incrCount, int64_t incrVol, r
 
     std::string size_key = EncodeZSizeKey(key);
     writebatch.Put(size_key, meta_val);
+    metrics_->profiler()->Meta(kZSET_DB, key, len, vol);
 
     //writebatch.Put(size_key, std::to_string(size));
 
@@ -1345,7 +1436,5 @@ ZmetaIterator * Nemo::ZmetaScan( const std::string &start, const std::string &en
 
     IteratorOptions iter_options(key_end, limit, read_options);
     
-    rocksdb::Iterator *it = zset_db_->NewIterator(read_options);
-    it->Seek(key_start);
-    return new ZmetaIterator(it, zset_db_.get(), iter_options,start);
+    return new ZmetaIterator(zset_db_.get(), iter_options, key_start);
 }
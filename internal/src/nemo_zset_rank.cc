@@ -0,0 +1,490 @@
+#include <string.h>
+
+#include "nemo_zset_rank.h"
+#include "nemo_zset.h"
+#include "nemo_write_group.h"
+#include "xdebug.h"
+
+using namespace nemo;
+
+static inline int64_t DecodeRankCount(const rocksdb::Slice &value) {
+    int64_t count = 0;
+    if (value.size() == sizeof(int64_t)) {
+        memcpy(&count, value.data(), sizeof(int64_t));
+    }
+    return count;
+}
+
+static inline std::string EncodeRankCount(int64_t count) {
+    return std::string((char *)&count, sizeof(int64_t));
+}
+
+ZRankIndex::ZRankIndex(rocksdb::DBNemo *db, const std::string &key, const rocksdb::Snapshot *snapshot)
+    : db_(db), group_(NULL), key_(key), built_(false) {
+    read_options_.snapshot = snapshot;
+    read_options_.fill_cache = false;
+    rank_prefix_.append(1, DataType::kZRank);
+    rank_prefix_.append(1, (uint8_t)key.size());
+    rank_prefix_.append(key);
+    score_prefix_ = EncodeZScorePrefix(key);
+}
+
+std::string ZRankIndex::BlockKey(int level, const rocksdb::Slice &boundary) const {
+    std::string buf(rank_prefix_);
+    buf.append(1, '0' + level);
+    buf.append(boundary.data(), boundary.size());
+    return buf;
+}
+
+Status ZRankIndex::Load(bool *exists) {
+    std::string val;
+    Status s = db_->Get(read_options_, BlockKey(2, ""), &val);
+    *exists = s.ok();
+    if (s.ok()) {
+        counts_[1][""] = DecodeRankCount(val);
+    } else if (s.IsNotFound()) {
+        s = Status::OK();
+    }
+    return s;
+}
+
+Status ZRankIndex::Rank(const std::string &score_key, int64_t *rank, int64_t *total) {
+    rocksdb::Slice entry(score_key);
+    entry.remove_prefix(score_prefix_.size());
+    *rank = 0;
+    *total = 0;
+
+    // level 2, all of it for the total; the block holding entry is left out
+    int64_t in_block = 0;
+    std::string boundary;
+    std::string prefix = BlockKey(2, "");
+    rocksdb::Iterator *it = db_->NewIterator(read_options_);
+    for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        rocksdb::Slice b = it->key();
+        b.remove_prefix(prefix.size());
+        int64_t count = DecodeRankCount(it->value());
+        *total += count;
+        if (b.compare(entry) <= 0) {
+            *rank += in_block;
+            boundary.assign(b.data(), b.size());
+            in_block = count;
+        }
+    }
+
+    // level 1 blocks of that block
+    in_block = 0;
+    prefix = BlockKey(1, "");
+    for (it->Seek(prefix + boundary); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        rocksdb::Slice b = it->key();
+        b.remove_prefix(prefix.size());
+        if (b.compare(entry) > 0) {
+            break;
+        }
+        *rank += in_block;
+        boundary.assign(b.data(), b.size());
+        in_block = DecodeRankCount(it->value());
+    }
+
+    // entries of that level 1 block before score_key
+    for (it->Seek(score_prefix_ + boundary); it->Valid() && it->key().compare(score_key) < 0; it->Next()) {
+        (*rank)++;
+    }
+    Status s = it->status();
+    delete it;
+    return s;
+}
+
+// Walk the level blocks from the one at from for the block holding the
+// entry at *rank, which becomes the offset of the entry in that block
+Status ZRankIndex::FindByRank(int level, const std::string &from, int64_t *rank, std::string *boundary) {
+    std::map<std::string, int64_t> &counts = counts_[level - 1];
+    if (built_) {
+        std::map<std::string, int64_t>::iterator it = counts.lower_bound(from);
+        for (; it != counts.end(); ++it) {
+            if (*rank < it->second) {
+                *boundary = it->first;
+                return Status::OK();
+            }
+            *rank -= it->second;
+        }
+        return Status::NotFound("rank out of range");
+    }
+
+    Status s = Status::NotFound("rank out of range");
+    std::string prefix = BlockKey(level, "");
+    rocksdb::Iterator *it = db_->NewIterator(read_options_);
+    for (it->Seek(prefix + from); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+        int64_t count = DecodeRankCount(it->value());
+        if (*rank < count) {
+            boundary->assign(it->key().data() + prefix.size(), it->key().size() - prefix.size());
+            s = Status::OK();
+            break;
+        }
+        *rank -= count;
+    }
+    if (s.IsNotFound() && !it->status().ok()) {
+        s = it->status();
+    }
+    delete it;
+    return s;
+}
+
+Status ZRankIndex::Seek(int64_t rank, std::string *score_key) {
+    std::string b2, b1;
+    if (rank < 0) {
+        return Status::NotFound("rank out of range");
+    }
+    Status s = FindByRank(2, "", &rank, &b2);
+    if (!s.ok()) {
+        return s;
+    }
+    s = FindByRank(1, b2, &rank, &b1);
+    if (s.IsNotFound()) {
+        return Status::Corruption("zset rank index mismatch");
+    } else if (!s.ok()) {
+        return s;
+    }
+
+    // the level 1 block holds less than 2 * ZSET_RANK_BLOCK entries, mostly
+    rocksdb::Iterator *it = db_->NewIterator(read_options_);
+    it->Seek(score_prefix_ + b1);
+    for (; rank > 0 && it->Valid() && it->key().starts_with(score_prefix_); rank--) {
+        it->Next();
+    }
+    if (it->Valid() && it->key().starts_with(score_prefix_)) {
+        score_key->assign(it->key().data(), it->key().size());
+    } else if (it->status().ok()) {
+        s = Status::Corruption("zset rank index mismatch");
+    } else {
+        s = it->status();
+    }
+    delete it;
+    return s;
+}
+
+Status ZRankIndex::Check(bool *consistent) {
+    std::vector<std::string> bounds[2];
+    std::vector<int64_t> counts[2];
+    std::vector<int64_t> expects[2];
+    *consistent = false;
+
+    rocksdb::Iterator *it = db_->NewIterator(read_options_);
+    for (int level = 1; level <= 2; level++) {
+        std::string prefix = BlockKey(level, "");
+        for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+            bounds[level - 1].push_back(it->key().ToString().substr(prefix.size()));
+            counts[level - 1].push_back(DecodeRankCount(it->value()));
+        }
+        expects[level - 1].assign(counts[level - 1].size(), 0);
+    }
+
+    bool has_index = !bounds[0].empty() && bounds[0][0].empty()
+        && !bounds[1].empty() && bounds[1][0].empty();
+    size_t pos[2] = {0, 0};
+    int64_t entries = 0;
+    for (it->Seek(score_prefix_); it->Valid() && it->key().starts_with(score_prefix_); it->Next()) {
+        entries++;
+        if (!has_index) {
+            break;
+        }
+        rocksdb::Slice entry = it->key();
+        entry.remove_prefix(score_prefix_.size());
+        for (int l = 0; l < 2; l++) {
+            while (pos[l] + 1 < bounds[l].size() && entry.compare(bounds[l][pos[l] + 1]) >= 0) {
+                pos[l]++;
+            }
+            expects[l][pos[l]]++;
+        }
+    }
+    Status s = it->status();
+    delete it;
+    if (!s.ok()) {
+        return s;
+    }
+
+    if (!has_index) {
+        *consistent = entries == 0 && bounds[0].empty() && bounds[1].empty();
+        return Status::OK();
+    }
+    if (counts[0] != expects[0] || counts[1] != expects[1]) {
+        return Status::OK();
+    }
+    // level 2 boundaries have to be level 1 ones
+    size_t j = 0;
+    for (size_t i = 0; i < bounds[1].size(); i++) {
+        while (j < bounds[0].size() && bounds[0][j] < bounds[1][i]) {
+            j++;
+        }
+        if (j == bounds[0].size() || bounds[0][j] != bounds[1][i]) {
+            return Status::OK();
+        }
+    }
+    *consistent = true;
+    return Status::OK();
+}
+
+Status ZRankIndex::Open() {
+    bool exists = false;
+    Status s = Load(&exists);
+    if (s.ok() && !exists) {
+        s = Build();
+    }
+    return s;
+}
+
+Status ZRankIndex::Build() {
+    rocksdb::Iterator *it = db_->NewIterator(read_options_);
+    stale_.clear();
+    for (it->Seek(rank_prefix_); it->Valid() && it->key().starts_with(rank_prefix_); it->Next()) {
+        stale_.push_back(it->key().ToString());
+    }
+
+    Reset();
+    std::string b1, b2;
+    int64_t n = 0;
+    for (it->Seek(score_prefix_); it->Valid() && it->key().starts_with(score_prefix_); it->Next(), n++) {
+        Count(it->key(), n, &b1, &b2);
+    }
+    Status s = it->status();
+    delete it;
+    built_ = true;
+    return s;
+}
+
+void ZRankIndex::Build(const std::vector<std::string> &score_keys) {
+    stale_.clear();
+    Reset();
+    std::string b1, b2;
+    for (size_t n = 0; n < score_keys.size(); n++) {
+        Count(score_keys[n], n, &b1, &b2);
+    }
+    built_ = true;
+}
+
+void ZRankIndex::Reset() {
+    for (int l = 0; l < 2; l++) {
+        counts_[l].clear();
+        counts_[l][""] = 0;
+        dirty_[l].clear();
+        dirty_[l].insert("");
+    }
+}
+
+// Count the n-th score key, b1 and b2 hold the boundaries of the blocks the
+// previous one went to
+void ZRankIndex::Count(const rocksdb::Slice &score_key, int64_t n, std::string *b1, std::string *b2) {
+    if (n > 0 && n % ZSET_RANK_BLOCK == 0) {
+        b1->assign(score_key.data() + score_prefix_.size(), score_key.size() - score_prefix_.size());
+        dirty_[0].insert(*b1);
+        if (n % (ZSET_RANK_BLOCK * ZSET_RANK_BLOCK) == 0) {
+            *b2 = *b1;
+            dirty_[1].insert(*b2);
+        }
+    }
+    counts_[0][*b1]++;
+    counts_[1][*b2]++;
+}
+
+// The level block holding entry, which is the one with the greatest boundary
+// not after it
+Status ZRankIndex::FindBlock(int level, const rocksdb::Slice &entry, std::string *boundary) {
+    std::map<std::string, int64_t> &counts = counts_[level - 1];
+    if (built_) {
+        std::map<std::string, int64_t>::iterator it = counts.upper_bound(entry.ToString());
+        --it;
+        *boundary = it->first;
+        return Status::OK();
+    }
+
+    Status s;
+    std::string prefix = BlockKey(level, "");
+    rocksdb::Iterator *it = db_->NewIterator(read_options_);
+    it->SeekForPrev(prefix + entry.ToString());
+    if (it->Valid() && it->key().starts_with(prefix)) {
+        boundary->assign(it->key().data() + prefix.size(), it->key().size() - prefix.size());
+        if (counts.find(*boundary) == counts.end()) {
+            counts[*boundary] = DecodeRankCount(it->value());
+        }
+    } else if (it->status().ok()) {
+        s = Status::Corruption("zset rank block missing");
+    } else {
+        s = it->status();
+    }
+    delete it;
+    return s;
+}
+
+Status ZRankIndex::Update(const std::string &score_key, int64_t delta) {
+    rocksdb::Slice entry(score_key);
+    entry.remove_prefix(score_prefix_.size());
+    std::string boundary;
+    for (int level = 1; level <= 2; level++) {
+        Status s = FindBlock(level, entry, &boundary);
+        if (!s.ok()) {
+            return s;
+        }
+        counts_[level - 1][boundary] += delta;
+        dirty_[level - 1].insert(boundary);
+    }
+    return Status::OK();
+}
+
+bool ZRankIndex::IsBoundary(int level, const std::string &boundary) {
+    std::map<std::string, int64_t>::iterator it = counts_[level - 1].find(boundary);
+    if (it != counts_[level - 1].end()) {
+        return true;
+    }
+    std::string val;
+    return db_->Get(read_options_, BlockKey(level, boundary), &val).ok();
+}
+
+// Empty blocks other than the first ones go away, their range joins the
+// block before. A level 1 block stays while a level 2 block starts at it.
+Status ZRankIndex::Flush(rocksdb::WriteBatch *batch) {
+    for (size_t i = 0; i < stale_.size(); i++) {
+        batch->Delete(stale_[i]);
+    }
+
+    std::set<std::string> dropped;
+    std::set<std::string>::iterator it;
+    for (it = dirty_[1].begin(); it != dirty_[1].end(); ++it) {
+        int64_t count = counts_[1][*it];
+        if (count < 0) {
+            return Status::Corruption("zset rank count below zero");
+        }
+        if (count == 0 && !it->empty()) {
+            batch->Delete(BlockKey(2, *it));
+            dropped.insert(*it);
+        } else {
+            batch->Put(BlockKey(2, *it), EncodeRankCount(count));
+        }
+    }
+    for (it = dropped.begin(); it != dropped.end(); ++it) {
+        counts_[1].erase(*it);
+        dirty_[1].erase(*it);
+    }
+
+    for (it = dirty_[0].begin(); it != dirty_[0].end(); ++it) {
+        int64_t count = counts_[0][*it];
+        if (count < 0) {
+            return Status::Corruption("zset rank count below zero");
+        }
+        if (count == 0 && !it->empty() && (dropped.count(*it) || !IsBoundary(2, *it))) {
+            batch->Delete(BlockKey(1, *it));
+            dropped.insert(*it);
+        } else {
+            batch->Put(BlockKey(1, *it), EncodeRankCount(count));
+        }
+    }
+    // the level 1 block at a dropped level 2 boundary is empty as well
+    for (it = dropped.begin(); it != dropped.end(); ++it) {
+        batch->Delete(BlockKey(1, *it));
+        counts_[0].erase(*it);
+        dirty_[0].erase(*it);
+    }
+    stale_.clear();
+    built_ = false;
+    return Status::OK();
+}
+
+// Cut the oversized blocks into blocks of about ZSET_RANK_BLOCK entries, or
+// ZSET_RANK_BLOCK level 1 blocks. Level 1 goes first since level 2 is cut
+// at level 1 boundaries.
+Status ZRankIndex::Split(const rocksdb::WriteOptions &options) {
+    rocksdb::WriteBatch batch;
+    Status s;
+    rocksdb::Iterator *it = db_->NewIterator(read_options_);
+    std::set<std::string>::iterator b;
+    for (b = dirty_[0].begin(); b != dirty_[0].end(); ++b) {
+        int64_t count = counts_[0][*b];
+        if (count <= 2 * ZSET_RANK_BLOCK) {
+            continue;
+        }
+        // the last block takes the rest, between one and two ZSET_RANK_BLOCK
+        std::string start = *b;
+        int64_t left = count;
+        it->Seek(score_prefix_ + *b);
+        for (int64_t i = 0; it->Valid() && it->key().starts_with(score_prefix_); it->Next(), i++) {
+            if (i > 0 && i % ZSET_RANK_BLOCK == 0 && left >= 2 * ZSET_RANK_BLOCK) {
+                batch.Put(BlockKey(1, start), EncodeRankCount(ZSET_RANK_BLOCK));
+                start = it->key().ToString().substr(score_prefix_.size());
+                left -= ZSET_RANK_BLOCK;
+            }
+            if (left < 2 * ZSET_RANK_BLOCK) {
+                break;
+            }
+        }
+        batch.Put(BlockKey(1, start), EncodeRankCount(left));
+    }
+    if (batch.Count() > 0) {
+        s = db_->WriteWithOldKeyTTL(options, &batch);
+        batch.Clear();
+    }
+
+    std::string prefix = BlockKey(1, "");
+    std::string prefix2 = BlockKey(2, "");
+    for (b = dirty_[1].begin(); s.ok() && b != dirty_[1].end(); ++b) {
+        int64_t count = counts_[1][*b];
+        if (count <= 2 * ZSET_RANK_BLOCK * ZSET_RANK_BLOCK) {
+            continue;
+        }
+        // the level 2 block ends where the next one starts
+        std::string end;
+        it->Seek(prefix2 + *b);
+        if (it->Valid()) {
+            it->Next();
+        }
+        if (it->Valid() && it->key().starts_with(prefix2)) {
+            end = prefix + it->key().ToString().substr(prefix2.size());
+        }
+        std::string start = *b;
+        int64_t acc = 0;
+        int64_t left = count;
+        for (it->Seek(prefix + *b); it->Valid() && it->key().starts_with(prefix); it->Next()) {
+            if (!end.empty() && it->key().compare(end) >= 0) {
+                break;
+            }
+            if (acc >= ZSET_RANK_BLOCK * ZSET_RANK_BLOCK && left - acc >= ZSET_RANK_BLOCK * ZSET_RANK_BLOCK) {
+                batch.Put(BlockKey(2, start), EncodeRankCount(acc));
+                start = it->key().ToString().substr(prefix.size());
+                left -= acc;
+                acc = 0;
+            }
+            acc += DecodeRankCount(it->value());
+        }
+        if (start != *b) {
+            batch.Put(BlockKey(2, start), EncodeRankCount(left));
+        }
+    }
+    if (s.ok() && batch.Count() > 0) {
+        s = db_->WriteWithOldKeyTTL(options, &batch);
+    }
+    delete it;
+    return s;
+}
+
+Status ZRankIndex::Commit(const rocksdb::WriteOptions &options, rocksdb::WriteBatch *batch,
+                          bool new_version) {
+    Status s = Flush(batch);
+    if (!s.ok()) {
+        return s;
+    }
+    if (new_version) {
+        s = db_->WriteWithKeyVersion(options, batch);
+    } else if (group_ != NULL) {
+        s = group_->Write(options, rocksdb::kNemoWriteOldKeyTTL, batch);
+    } else {
+        s = db_->WriteWithOldKeyTTL(options, batch);
+    }
+    if (!s.ok()) {
+        return s;
+    }
+    // the counts are right without the split, only the ranks get slower
+    Status split = Split(options);
+    if (!split.ok()) {
+        log_warn("split zset rank blocks of %s failed, %s", key_.c_str(), split.ToString().c_str());
+    }
+    dirty_[0].clear();
+    dirty_[1].clear();
+    return s;
+}
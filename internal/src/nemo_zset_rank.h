@@ -0,0 +1,92 @@
+#ifndef NEMO_INCLUDE_NEMO_ZSET_RANK_H_
+#define NEMO_INCLUDE_NEMO_ZSET_RANK_H_
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "nemo.h"
+#include "nemo_const.h"
+
+namespace nemo {
+
+// Rank index of one sorted set, a two level summary of its kZScore entries
+// kept beside them in zset_db_:
+//
+//   kZRank | len | key | '1' | boundary -> entries in [boundary, next '1' boundary)
+//   kZRank | len | key | '2' | boundary -> entries in [boundary, next '2' boundary)
+//
+// A boundary is a kZScore key without its prefix, i.e. the big endian score
+// followed by the member, and the first block of both levels starts at the
+// empty boundary. Every level 2 boundary is a level 1 boundary too. Level 1
+// blocks are split past 2 * ZSET_RANK_BLOCK entries and level 2 blocks past
+// 2 * ZSET_RANK_BLOCK^2, so a rank costs three seeks: one over the level 2
+// blocks, then at most ~2 * ZSET_RANK_BLOCK level 1 blocks and entries.
+//
+// Writers Open the index under the record lock, Update it for every kZScore
+// key they put or delete and Commit it with their batch. Sets written before
+// the index existed have none, readers fall back to scanning them and their
+// first write builds it.
+class ZRankIndex {
+public:
+    ZRankIndex(rocksdb::DBNemo *db, const std::string &key,
+               const rocksdb::Snapshot *snapshot = NULL);
+
+    // *exists is false if the set has no index yet
+    Status Load(bool *exists);
+    // Rank of score_key and the number of entries in the set
+    Status Rank(const std::string &score_key, int64_t *rank, int64_t *total);
+    // kZScore key of the entry at rank, NotFound past the last one
+    Status Seek(int64_t rank, std::string *score_key);
+    // Check the block counts against the entries, false if the set has
+    // entries but no index
+    Status Check(bool *consistent);
+
+    // Load the index for an update, building it if the set has none
+    Status Open();
+    // Count the entries into new blocks, replacing the current ones
+    Status Build();
+    // Count the sorted kZScore keys of a set that replaces the current one
+    // under a new version, which hides the current blocks
+    void Build(const std::vector<std::string> &score_keys);
+    Status Update(const std::string &score_key, int64_t delta);
+    // Add the changed blocks to batch and write it, then split the blocks
+    // that outgrew their limit. new_version writes batch by
+    // WriteWithKeyVersion, for a batch holding the whole new set
+    Status Commit(const rocksdb::WriteOptions &options, rocksdb::WriteBatch *batch,
+                  bool new_version = false);
+    // Commit writes batch, unless new_version, through group
+    void SetWriteGroup(WriteGroup *group) { group_ = group; }
+
+private:
+    rocksdb::DBNemo *db_;
+    WriteGroup *group_;
+    std::string key_;
+    rocksdb::ReadOptions read_options_;
+    std::string rank_prefix_;
+    std::string score_prefix_;
+
+    // boundary -> count of the blocks read or changed, per level
+    std::map<std::string, int64_t> counts_[2];
+    std::set<std::string> dirty_[2];
+    // counts_ holds every block, none of them written yet
+    bool built_;
+    std::vector<std::string> stale_;
+
+    std::string BlockKey(int level, const rocksdb::Slice &boundary) const;
+    Status FindBlock(int level, const rocksdb::Slice &entry, std::string *boundary);
+    Status FindByRank(int level, const std::string &from, int64_t *rank, std::string *boundary);
+    bool IsBoundary(int level, const std::string &boundary);
+    void Reset();
+    void Count(const rocksdb::Slice &score_key, int64_t n, std::string *b1, std::string *b2);
+    Status Flush(rocksdb::WriteBatch *batch);
+    Status Split(const rocksdb::WriteOptions &options);
+
+    ZRankIndex(const ZRankIndex&);
+    void operator=(const ZRankIndex&);
+};
+
+}
+#endif
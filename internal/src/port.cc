@@ -15,6 +15,7 @@
 #include <sys/time.h>
 #include <string.h>
 #include <cstdlib>
+#include <algorithm>
 
 #include "xdebug.h"
 
@@ -37,6 +38,8 @@ void Mutex::Lock() { PthreadCall("lock", pthread_mutex_lock(&mu_)); }
 
 void Mutex::Unlock() { PthreadCall("unlock", pthread_mutex_unlock(&mu_)); }
 
+bool Mutex::TryLock() { return pthread_mutex_trylock(&mu_) == 0; }
+
 
 CondVar::CondVar(Mutex* mu)
     : mu_(mu) {
@@ -49,6 +52,15 @@ void CondVar::Wait() {
   PthreadCall("wait", pthread_cond_wait(&cv_, &mu_->mu_));
 }
 
+bool CondVar::TimedWait(uint64_t abs_time_us) {
+  struct timespec ts;
+  ts.tv_sec = static_cast<time_t>(abs_time_us / 1000000);
+  ts.tv_nsec = static_cast<long>((abs_time_us % 1000000) * 1000);
+  int err = pthread_cond_timedwait(&cv_, &mu_->mu_, &ts);
+  PthreadCall("timedwait", err);
+  return err == ETIMEDOUT;
+}
+
 void CondVar::Signal() {
   PthreadCall("signal", pthread_cond_signal(&cv_));
 }
@@ -97,70 +109,186 @@ void RefMutex::Unlock() {
   PthreadCall("unlock", pthread_mutex_unlock(&mu_));
 }
 
+struct RecordMutex::KeyMutex {
+  pthread_mutex_t mu;
+  int refs;
+  std::string key;
+};
+
+RecordMutex::RecordMutex(size_t stripes, bool exact)
+  : keys_(NULL), key_count_(0) {
+  size_t n = 1;
+  while (n < stripes) {
+    n <<= 1;
+  }
+  mask_ = n - 1;
+
+  void *mem = NULL;
+  PthreadCall("alloc stripes", posix_memalign(&mem, kCacheLineSize, n * sizeof(PaddedMutex)));
+  stripes_ = static_cast<PaddedMutex *>(mem);
+  for (size_t i = 0; i < n; i++) {
+    PthreadCall("init mutex", pthread_mutex_init(&stripes_[i].mu, nullptr));
+  }
+  if (exact) {
+    keys_ = new KeyMap[n];
+  }
+}
+
 RecordMutex::~RecordMutex() {
-  mutex_.Lock();
-  
-  std::unordered_map<std::string, RefMutex *>::const_iterator it = records_.begin();
-  for (; it != records_.end(); it++) {
-    delete it->second;
+  for (size_t i = 0; i <= mask_; i++) {
+    PthreadCall("destroy mutex", pthread_mutex_destroy(&stripes_[i].mu));
   }
-  mutex_.Unlock();
+  free(stripes_);
+  // every lock is given back by now, so the maps are empty
+  delete[] keys_;
 }
 
 int64_t RecordMutex::GetUsage() {
-  int64_t size = 0;
-  mutex_.Lock();
-  size = charge_;
-  mutex_.Unlock();
-  return size;
+  return sizeof(RecordMutex) + (mask_ + 1) * sizeof(PaddedMutex) +
+    (keys_ == NULL ? 0 : (mask_ + 1) * sizeof(KeyMap) + key_count_.load() * sizeof(KeyMutex));
 }
 
-const int64_t kEstimatePairSize = sizeof(std::string) + sizeof(RefMutex) + sizeof(std::pair<std::string, void *>);
+// FNV-1a with a final mix, the low bits pick the stripe
+size_t RecordMutex::Stripe(const rocksdb::Slice &key) const {
+  uint64_t h = 14695981039346656037ULL;
+  for (size_t i = 0; i < key.size(); i++) {
+    h ^= static_cast<unsigned char>(key[i]);
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return static_cast<size_t>(h) & mask_;
+}
 
-void RecordMutex::Lock(const std::string &key) {
-  mutex_.Lock();
-  std::unordered_map<std::string, RefMutex *>::const_iterator it = records_.find(key);
+static thread_local LockWaits lock_waits;
 
-  if (it != records_.end()) {
-    //log_info ("tid=(%u) >Lock key=(%s) exist, map_size=%u", pthread_self(), key.c_str(), records_.size());
-    RefMutex *ref_mutex = it->second;
-    ref_mutex->Ref();
-    mutex_.Unlock();
+LockWaits *ThisThreadLockWaits() {
+  return &lock_waits;
+}
 
-    ref_mutex->Lock();
-    //log_info ("tid=(%u) <Lock key=(%s) exist", pthread_self(), key.c_str());
-  } else {
-    //log_info ("tid=(%u) >Lock key=(%s) new, map_size=%u ++", pthread_self(), key.c_str(), records_.size());
-    RefMutex *ref_mutex = new RefMutex();
+void RecordMutex::LockTimed(pthread_mutex_t *mu) {
+  if (pthread_mutex_trylock(mu) == 0) {
+    return;
+  }
+  struct timeval start, end;
+  gettimeofday(&start, NULL);
+  PthreadCall("lock", pthread_mutex_lock(mu));
+  gettimeofday(&end, NULL);
+  lock_waits.waits++;
+  lock_waits.micros += (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+}
 
-    records_.insert(std::make_pair(key, ref_mutex));
-    ref_mutex->Ref();
-    charge_ += kEstimatePairSize + key.size();
-    mutex_.Unlock();
+#ifndef NDEBUG
+// Locks of RecordMutex tables the calling thread holds, to check the order
+// it takes them in
+static thread_local std::vector<std::pair<const RecordMutex *, RecordMutex::Held> > held_locks;
+#endif
+
+void RecordMutex::CheckOrder(const Held &held) {
+#ifndef NDEBUG
+  for (size_t i = 0; i < held_locks.size(); i++) {
+    if (held_locks[i].first != this) {
+      continue;
+    }
+    const Held &prev = held_locks[i].second;
+    assert(prev.stripe < held.stripe ||
+           (prev.key != NULL && prev.stripe == held.stripe && prev.key->key < held.key->key));
+  }
+  held_locks.push_back(std::make_pair(this, held));
+#endif
+}
 
-    ref_mutex->Lock();
-    //log_info ("tid=(%u) <Lock key=(%s) new", pthread_self(), key.c_str());
+void RecordMutex::ForgetHeld(const Held &held) {
+#ifndef NDEBUG
+  for (size_t i = held_locks.size(); i > 0; i--) {
+    if (held_locks[i - 1].first == this && held_locks[i - 1].second.stripe == held.stripe &&
+        held_locks[i - 1].second.key == held.key) {
+      held_locks.erase(held_locks.begin() + (i - 1));
+      return;
+    }
+  }
+  assert(false);
+#endif
+}
+
+RecordMutex::Held RecordMutex::Acquire(size_t stripe, const rocksdb::Slice &key) {
+  Held held;
+  held.stripe = stripe;
+  held.key = NULL;
+  if (keys_ == NULL) {
+    CheckOrder(held);
+    LockTimed(&stripes_[stripe].mu);
+    return held;
   }
+
+  PthreadCall("lock", pthread_mutex_lock(&stripes_[stripe].mu));
+  KeyMutex *&k = keys_[stripe][key.ToString()];
+  if (k == NULL) {
+    k = new KeyMutex;
+    PthreadCall("init mutex", pthread_mutex_init(&k->mu, nullptr));
+    k->refs = 0;
+    k->key = key.ToString();
+    key_count_++;
+  }
+  k->refs++;
+  PthreadCall("unlock", pthread_mutex_unlock(&stripes_[stripe].mu));
+
+  held.key = k;
+  CheckOrder(held);
+  LockTimed(&k->mu);
+  return held;
+}
+
+RecordMutex::Held RecordMutex::Lock(const rocksdb::Slice &key) {
+  return Acquire(Stripe(key), key);
 }
 
-void RecordMutex::Unlock(const std::string &key) {
-  mutex_.Lock();
-  std::unordered_map<std::string, RefMutex *>::const_iterator it = records_.find(key);
-  
-  //log_info ("tid=(%u) >Unlock key=(%s) new, map_size=%u --", pthread_self(), key.c_str(), records_.size());
-  if (it != records_.end()) {
-    RefMutex *ref_mutex = it->second;
+void RecordMutex::Unlock(const Held &held) {
+  ForgetHeld(held);
+  if (held.key == NULL) {
+    PthreadCall("unlock", pthread_mutex_unlock(&stripes_[held.stripe].mu));
+    return;
+  }
+
+  KeyMutex *k = held.key;
+  PthreadCall("unlock", pthread_mutex_unlock(&k->mu));
+  PthreadCall("lock", pthread_mutex_lock(&stripes_[held.stripe].mu));
+  if (--k->refs == 0) {
+    keys_[held.stripe].erase(k->key);
+    PthreadCall("destroy mutex", pthread_mutex_destroy(&k->mu));
+    delete k;
+    key_count_--;
+  }
+  PthreadCall("unlock", pthread_mutex_unlock(&stripes_[held.stripe].mu));
+}
 
-    if (ref_mutex->IsLastRef()) {
-      charge_ -= kEstimatePairSize + key.size();
-      records_.erase(it);
+void RecordMutex::MultiLock(const std::vector<rocksdb::Slice> &keys, std::vector<Held> *held) {
+  std::vector<std::pair<size_t, rocksdb::Slice> > order;
+  order.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); i++) {
+    order.push_back(std::make_pair(Stripe(keys[i]), keys[i]));
+  }
+  std::sort(order.begin(), order.end(),
+            [](const std::pair<size_t, rocksdb::Slice> &a, const std::pair<size_t, rocksdb::Slice> &b) {
+              return a.first < b.first || (a.first == b.first && a.second.compare(b.second) < 0);
+            });
+
+  held->clear();
+  held->reserve(order.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    if (i > 0 && order[i].first == order[i - 1].first &&
+        (keys_ == NULL || order[i].second == order[i - 1].second)) {
+      continue;
     }
-    ref_mutex->Unlock();
-    ref_mutex->Unref();
+    held->push_back(Acquire(order[i].first, order[i].second));
   }
+}
 
-  mutex_.Unlock();
-  //log_info ("tid=(%u) <Unlock key=(%s) new", pthread_self(), key.c_str());
+void RecordMutex::MultiUnlock(const std::vector<Held> &held) {
+  for (size_t i = held.size(); i > 0; i--) {
+    Unlock(held[i - 1]);
+  }
 }
 
 }  // namespace port
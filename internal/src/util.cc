@@ -402,6 +402,56 @@ int stringmatchlen(const char *pattern, int patternLen, const char *string, int
     return 0;
 }
 
+std::string PrefixSuccessor(const std::string &prefix) {
+    std::string succ = prefix;
+    while (!succ.empty()) {
+        if (static_cast<uint8_t>(succ.back()) != 0xff) {
+            succ.back()++;
+            break;
+        }
+        succ.pop_back();
+    }
+    return succ;
+}
+
+void MetaKeyRange(char prefix, const std::string &start, const std::string &end, KeyRanges *ranges) {
+    std::string b(1, prefix), e(1, prefix);
+    b.append(start);
+    if (end.empty()) {
+        e = PrefixSuccessor(e);
+    } else {
+        e.append(end);
+    }
+    if (b < e) {
+        ranges->push_back(std::make_pair(b, e));
+    }
+}
+
+// A key shorter than start or end sorts after it if it is greater than the
+// same length prefix of it
+void DataKeyRanges(char prefix, const std::string &start, const std::string &end, KeyRanges *ranges) {
+    for (size_t len = 0; len <= 0xff; len++) {
+        std::string head(1, prefix);
+        head.push_back((char)(uint8_t)len);
+        std::string b = head, e = head;
+        if (start.size() <= len) {
+            b.append(start);
+        } else {
+            b = PrefixSuccessor(b.append(start, 0, len));
+        }
+        if (end.empty()) {
+            e = PrefixSuccessor(e);
+        } else if (end.size() <= len) {
+            e.append(end);
+        } else {
+            e = PrefixSuccessor(e.append(end, 0, len));
+        }
+        if (b < e) {
+            ranges->push_back(std::make_pair(b, e));
+        }
+    }
+}
+
 int is_dir(const char* filename) {
     struct stat buf;
     int ret = stat(filename,&buf);
@@ -20,6 +20,7 @@ class NemoHashTest : public NemoTest
 protected:
     static const unsigned int maxHMSetNum_ = 100;
 	static const unsigned int maxHMGetNum_ = 200;
+	int res_;
 };
 
 #endif
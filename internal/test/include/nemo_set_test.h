@@ -36,7 +36,9 @@ public:
 	bool isAllInKey(string key, vector<string> &members) { //for SRandMember test
 		bool flag = true;
 		for (vector<string>::iterator iter = members.begin(); iter != members.end(); iter++) {
-			if (!(n_->SIsMember(key, *iter)))
+			bool isMember = false;
+			n_->SIsMember(key, *iter, &isMember);
+			if (!isMember)
 			{
 				flag = false;
 				break;
@@ -57,7 +59,7 @@ public:
     for (; siter->Valid(); siter->Next())
 		//while(siter->Next())
 		{
-			n_->SRem(key, siter->member(), &resTemp);
+			n_->SRem(key, siter->member().ToString(), &resTemp);
 		}
 		delete siter;
 		for (int64_t index = 0; index != num; index++)
@@ -77,7 +79,7 @@ public:
     for (; siter->Valid(); siter->Next())
     {
 		//while(siter->Next()) {
-			n_->SRem(key, siter->member(), &resTemp);
+			n_->SRem(key, siter->member().ToString(), &resTemp);
 		}
 		delete siter;
 		for (int64_t index = numStart; index != numEnd; index++)
@@ -91,7 +93,7 @@ public:
 		int64_t resTemp;
 		//while (siter->Next()) {
     for (; siter->Valid(); siter->Next()) {
-			n_->SRem(key, siter->member(), &resTemp);
+			n_->SRem(key, siter->member().ToString(), &resTemp);
 		}
 		delete siter;
 	}
@@ -18,7 +18,7 @@ TEST_F(NemoHashTest, TestHSet)
 {
 	log_message("============================HASHTEST START===========================");
 	log_message("============================HASHTEST START===========================");
-#define LoopPositiveProcess(TestMessage) s_ = n_->HSet(key, field, val);\
+#define LoopPositiveProcess(TestMessage) s_ = n_->HSet(key, field, val, &res_);\
 					CHECK_STATUS(OK);\
     				n_->HGet(key, field, &getVal);\
 					EXPECT_EQ(val, getVal);\
@@ -33,7 +33,7 @@ TEST_F(NemoHashTest, TestHSet)
 	val = GetRandomVal_();
 
 	s_.OK();//key
-	s_ = n_->HSet(key, field, val);
+	s_ = n_->HSet(key, field, val, &res_);
 	CHECK_STATUS(OK);
 	n_->HGet(key, field, &getVal);
 	EXPECT_EQ(val, getVal);
@@ -45,7 +45,7 @@ TEST_F(NemoHashTest, TestHSet)
 	s_.OK();//keyڵ
 	field = GetRandomField_();
 	val = GetRandomVal_();
-	s_ = n_->HSet(key, field, val);
+	s_ = n_->HSet(key, field, val, &res_);
 	CHECK_STATUS(OK);
 	n_->HGet(key, field, &getVal);
 	EXPECT_EQ(val, getVal);
@@ -56,7 +56,7 @@ TEST_F(NemoHashTest, TestHSet)
 
 	s_.OK();//keyڵfieldڵ
 	val = GetRandomVal_();
-	s_ = n_->HSet(key, field, val);
+	s_ = n_->HSet(key, field, val, &res_);
 	CHECK_STATUS(OK);
 	n_->HGet(key, field, &getVal);
 	EXPECT_EQ(val, getVal);
@@ -129,24 +129,24 @@ TEST_F(NemoHashTest, TestHGet)
 	key = GetRandomKey_();
 	field = GetRandomField_();
 	val = GetRandomVal_();
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	GetLoopOKProcess("ԭkeyڣfieldڣԭvalǿ");
 	
 	s_.OK();//ԭkeyڣfieldڣԭvalǿ
 	field = GetRandomField_();
 	val = GetRandomVal_();
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	n_->HDel(key, field);
 	GetLoopNotFoundProcess("ԭkeyڣfieldڣԭvalǿ");
 
 	s_.OK();//ԭkeyڣfieldڣԭvalΪ
 	val = "";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	GetLoopOKProcess("ԭkeyڣfieldڣԭvalΪ");
 
 	s_.OK();//ԭkeyڣfieldڣԭvalȡ󳤶
 	val = GetRandomBytes_(maxValLen_);
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	GetLoopOKProcess("ԭkeyڣfieldڣԭvalȡ󳤶");	
 }
 
@@ -167,7 +167,7 @@ TEST_F(NemoHashTest, TestHDel)
 	
 	s_.OK();//ԭkeyڣfield
 	val = GetRandomVal_();
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
     s_ = n_->HDel(key, field);
 	CHECK_STATUS(OK);
 	if(s_.ok())
@@ -186,13 +186,13 @@ TEST_F(NemoHashTest, TestHDel)
 
 TEST_F(NemoHashTest, TestHExist)
 {
-	#define HExistLoopPositiveProcess(Message) isExist = n_->HExists(key, field);\
+	#define HExistLoopPositiveProcess(Message) n_->HExists(key, field, &isExist);\
 										EXPECT_EQ(true, isExist);\
 										if(isExist)\
 											log_success(Message);\
 										else\
 											log_fail(Message)
-	#define HExistLoopNegativeProcess(Message) isExist = n_->HExists(key, field);\
+	#define HExistLoopNegativeProcess(Message) n_->HExists(key, field, &isExist);\
 										EXPECT_EQ(false, isExist);\
 										if(!isExist)\
 											log_success(Message);\
@@ -210,12 +210,12 @@ TEST_F(NemoHashTest, TestHExist)
 
 	s_.OK();//ԭkeyڣfieldڣvalΪ
 	val = "";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	HExistLoopPositiveProcess("ԭkeyڣfieldڣvalΪ");
 
 	s_.OK();//ԭkeyڣfieldڣvalǿ
 	val = GetRandomVal_();
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	HExistLoopPositiveProcess("ԭkeyڣfieldڣvalΪ");
 	
 	s_.OK();//
@@ -243,7 +243,7 @@ TEST_F(NemoHashTest, TestHKeys)
 	fields.clear();
 	field = GetRandomKey_();
 	val = GetRandomVal_();
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	n_->HDel(key, field);
 	s_ = n_->HKeys(key, fields);
 	CHECK_STATUS(OK);
@@ -259,7 +259,7 @@ TEST_F(NemoHashTest, TestHKeys)
 	log_message("======keyΪ%s, field%s%d%s%d", key.c_str(), (key+"_").c_str(), fieldsIndexStart, (key+"_").c_str(), fieldsIndexStart+fieldsNum-1);
 	for(int fieldsIndex = fieldsIndexStart; fieldsIndex != fieldsIndexStart + fieldsNum; fieldsIndex++)
 	{
-		n_->HSet(key, key+"_"+itoa(fieldsIndex), itoa(fieldsIndex));
+		n_->HSet(key, key+"_"+itoa(fieldsIndex), itoa(fieldsIndex), &res_);
 	}
 	fields.clear();
 	s_ = n_->HKeys(key, fields);
@@ -317,7 +317,7 @@ TEST_F(NemoHashTest, TestHGetall)
 	for(int fieldsIndex = fieldsIndexStart; fieldsIndex != fieldsIndexStart+fieldsNum; fieldsIndex++)
 	{
 		field = key + "_" + itoa(fieldsIndex);
-		n_->HSet(key, field, itoa(fieldsIndex));
+		n_->HSet(key, field, itoa(fieldsIndex), &res_);
 	}
 	s_ = n_->HGetall(key, fvs);
 	CHECK_STATUS(OK);
@@ -360,7 +360,7 @@ TEST_F(NemoHashTest, TestHLen)
 	s_.OK();//key/keyfieldӦֵ
 	key = GetRandomKey_();
 	field = GetRandomField_();
-	retLen = n_->HLen(key);
+	n_->HLen(key, &retLen);
 	EXPECT_EQ(0, retLen);
 	if(retLen == 0)
 		log_success("key/keyfieldӦֵ");
@@ -381,9 +381,9 @@ TEST_F(NemoHashTest, TestHLen)
 	for(int fieldsIndex = fieldsIndexStart; fieldsIndex != fieldsIndexStart+fieldsNum; fieldsIndex++)
 	{
 		field = key + "_" + itoa(fieldsIndex);
-		n_->HSet(key, field, itoa(fieldsIndex));
+		n_->HSet(key, field, itoa(fieldsIndex), &res_);
 	}
-	retLen = n_->HLen(key);
+	n_->HLen(key, &retLen);
 	EXPECT_EQ(fieldsNum, retLen);
 	if(retLen == fieldsNum)
 		log_success("keyڣfields");
@@ -396,6 +396,7 @@ TEST_F(NemoHashTest, TestHMSet)
 	log_message("\n========TestHMSet========");
 	string key, field, val, getVal;
 	vector<nemo::FV> fvs;
+	int resList[maxHMSetNum_];
 	bool flag;
 	int fvsNum = GetRandomUint_(1, maxHMSetNum_);
 	for(int index = 0; index != fvsNum; index++)
@@ -407,7 +408,7 @@ TEST_F(NemoHashTest, TestHMSet)
 	
 	s_.OK();//KeyΪ
 	key = "";
-	s_ = n_->HMSet(key, fvs);
+	s_ = n_->HMSet(key, fvs, resList);
 	CHECK_STATUS(OK);
 	if(s_.ok())
 		log_success("KeyΪ");
@@ -416,7 +417,7 @@ TEST_F(NemoHashTest, TestHMSet)
 
 	s_.OK();//KeyǿգFSֵĿ
 	key = GetRandomKey_();
-	s_ = n_->HMSet(key, fvs);
+	s_ = n_->HMSet(key, fvs, resList);
 	CHECK_STATUS(OK);
 	flag = true;
 	for(vector<nemo::FV>::iterator iter = fvs.begin(); iter != fvs.end(); iter++)
@@ -443,7 +444,7 @@ TEST_F(NemoHashTest, TestHMSet)
 		val = GetRandomVal_();
 		fvs.push_back({field, val});
 	}
-	s_ = n_->HMSet(key, fvs);
+	s_ = n_->HMSet(key, fvs, resList);
 	flag = true;
 	for(vector<nemo::FV>::iterator iter = fvs.begin(); iter != fvs.end(); iter++)
 	{
@@ -477,7 +478,7 @@ TEST_F(NemoHashTest, TestHMGet)
 	{
 		field = GetRandomField_();
 		val = GetRandomVal_();
-		n_->HSet(key, field, val);
+		n_->HSet(key, field, val, &res_);
 		fields.push_back(field);
 		fvs.push_back({field, val});
 		hgetNum--;
@@ -546,7 +547,7 @@ TEST_F(NemoHashTest, TestHMGet)
 	{
 		field = GetRandomField_();
 		val = GetRandomVal_();
-		n_->HSet(key, field, val);
+		n_->HSet(key, field, val, &res_);
 		fields.push_back(field);
 		fvs.push_back({field, val});
 		hgetNum--;
@@ -572,28 +573,88 @@ TEST_F(NemoHashTest, TestHMGet)
 	fvss.clear();
 }
 
+TEST_F(NemoHashTest, TestHMGetBatch)
+{
+	log_message("\n========TestHMGetBatch========");
+	string key, val;
+	vector<string> fields;
+	vector<rocksdb::Slice> fieldSlices;
+	rocksdb::NemoBatchGetResult result;
+	int res;
+	int64_t count;
+	bool flag = true;
+
+	key = GetRandomKey_();
+	for(int i = 0; i < 10; i++)
+		fields.push_back("field_" + to_string(i));
+	for(int i = 0; i < 10; i += 2)
+		n_->HSet(key, fields[i], "val_" + to_string(i), &res);
+	//out of order, with a field asked twice
+	for(int i = 9; i >= 0; i--)
+		fieldSlices.push_back(fields[i]);
+	fieldSlices.push_back(fields[0]);
+	s_ = n_->HMGetBatch(key, fieldSlices, &result);
+	CHECK_STATUS(OK);
+	ASSERT_EQ(11U, result.values.size());
+	for(int i = 0; i < 11; i++)
+	{
+		int j = i == 10 ? 0 : 9 - i;
+		if(j % 2 == 0)
+			flag = flag && result.statuses[i].ok() && result.values[i].ToString() == "val_" + to_string(j);
+		else
+			flag = flag && result.statuses[i].IsNotFound();
+	}
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("HMGetBatch in the order of the fields");
+	else
+		log_fail("HMGetBatch in the order of the fields");
+
+	//the fields of a deleted key are older than its version
+	n_->Del(key, &count);
+	n_->HSet(key, fields[1], "val_new", &res);
+	s_ = n_->HMGetBatch(key, fieldSlices, &result);
+	flag = true;
+	for(int i = 0; i < 11; i++)
+	{
+		if(fieldSlices[i] == fields[1])
+			flag = flag && result.statuses[i].ok() && result.values[i] == "val_new";
+		else
+			flag = flag && result.statuses[i].IsNotFound();
+	}
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("HMGetBatch after Del");
+	else
+		log_fail("HMGetBatch after Del");
+	n_->Del(key, &count);
+}
+
 TEST_F(NemoHashTest, TestHSetnx)
 {
 	log_message("\n========TestHSetnx========");
 
 	string key, field, val;
+	int64_t res;
 	
 	s_.OK();//keyfieldsӦԭֵǲڵ
 	key = GetRandomKey_();
 	field = GetRandomField_();
 	val = GetRandomVal_();
-	s_ = n_->HSetnx(key, field, val);
+	s_ = n_->HSetnx(key, field, val, &res);
 	CHECK_STATUS(OK);
-	if(s_.ok())
+	EXPECT_EQ(1, res);
+	if(s_.ok() && res == 1)
 		log_success("keyfieldsӦԭֵǲڵ");
 	else
 		log_fail("keyfieldsӦԭֵǲڵ");
 
 	s_.OK();//keyfieldsӦԭֵǴڵ
 	val = GetRandomVal_();
-	s_ = n_->HSetnx(key, field, val);
-	CHECK_STATUS(Corruption);
-	if(s_.IsCorruption())
+	s_ = n_->HSetnx(key, field, val, &res);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(0, res);
+	if(s_.ok() && res == 0)
 		log_success("keyfieldsӦԭֵǴڵ");
 	else
 		log_fail("keyfieldsӦԭֵǴڵ");
@@ -608,7 +669,7 @@ TEST_F(NemoHashTest, TestHStrlen)
 	s_.OK();//keyfieldӦֵ
 	key = GetRandomKey_();
 	field = GetRandomField_();
-	retValLen = n_->HStrlen(key, field);
+	n_->HStrlen(key, field, &retValLen);
 	EXPECT_EQ(0, retValLen);
 	if(0 == retValLen)
 		log_success("keyfieldӦֵ");
@@ -617,8 +678,8 @@ TEST_F(NemoHashTest, TestHStrlen)
 
 	s_.OK();//keyfieldӦֵvalΪ0
 	val = "";
-	n_->HSet(key, field, val);
-	retValLen = n_->HStrlen(key, field);
+	n_->HSet(key, field, val, &res_);
+	n_->HStrlen(key, field, &retValLen);
 	EXPECT_EQ(0, retValLen);
 	if(0 == retValLen)
 		log_success("keyfieldӦֵvalΪ0");
@@ -627,8 +688,8 @@ TEST_F(NemoHashTest, TestHStrlen)
 
 	s_.OK();//keyfieldӦֵvalһ
 	val = GetRandomVal_();
-	n_->HSet(key, field, val);
-	retValLen = n_->HStrlen(key, field);
+	n_->HSet(key, field, val, &res_);
+	n_->HStrlen(key, field, &retValLen);
 	EXPECT_EQ(val.length(), retValLen);
 	if(val.length() == retValLen)
 		log_success("keyfieldӦֵvalһ");
@@ -637,8 +698,8 @@ TEST_F(NemoHashTest, TestHStrlen)
 
 	s_.OK();//keyfieldӦֵval
 	val = GetRandomBytes_(maxValLen_);
-	n_->HSet(key, field, val);
-	retValLen = n_->HStrlen(key, field);
+	n_->HSet(key, field, val, &res_);
+	n_->HStrlen(key, field, &retValLen);
 	//EXPECT_EQ(maxValLen_, retValLen);	
 	EXPECT_EQ(val.length(), retValLen);
 	if(maxValLen_ == retValLen)
@@ -692,7 +753,7 @@ TEST_F(NemoHashTest, TestHScan)
 	log_message("========Key is %s, field from %s_%d to %s_%d", key.c_str(), key.c_str(), numPre+0, key.c_str(), numPre+totalFieldsNum-1);
 	for(int32_t index = 0; index != totalFieldsNum; index++)
 	{
-		n_->HSet(key, key + "_" + itoa(numPre+index), itoa(numPre+index));
+		n_->HSet(key, key + "_" + itoa(numPre+index), itoa(numPre+index), &res_);
 	}
 	
 #define HScanLoopProcess(endCompare, limit, message)  \
@@ -781,7 +842,7 @@ TEST_F(NemoHashTest, TestHScan)
 	for(int32_t index2 = 0; index2 != totalFieldsNum2; index2++)
 	{
 		field2 = key2 + "_" + itoa(numPre+index2);
-		n_->HSet(key2, field2, itoa(numPre+index2));
+		n_->HSet(key2, field2, itoa(numPre+index2), &res_);
 	}
 	hiter = n_->HScan("", "", "", -1);
 	index = 0;
@@ -824,7 +885,7 @@ TEST_F(NemoHashTest, TestHVals)
 	key = GetRandomKey_();
 	field = GetRandomField_();
 	val = GetRandomVal_();
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	n_->HDel(key, field);
 	val.clear();
 	s_ = n_->HVals(key, vals);
@@ -848,7 +909,7 @@ TEST_F(NemoHashTest, TestHVals)
 	{
 		field = key + "_" +	itoa(numPre+index);
 		val = itoa(numPre+index);
-		n_->HSet(key, field, val);
+		n_->HSet(key, field, val, &res_);
 	}
 
 	s_.OK();//keyڣfields
@@ -873,7 +934,7 @@ TEST_F(NemoHashTest, TestHVals)
 	{
 		field2 = key2 + "_" + itoa(numPre+index);
 		val2 = itoa(numPre+index);
-		n_->HSet(key2, field2, val2);
+		n_->HSet(key2, field2, val2, &res_);
 	}
 	vals.clear();
 	s_ = n_->HVals("", vals);
@@ -917,7 +978,7 @@ TEST_F(NemoHashTest, TestHIncrby)
 	key = GetRandomKey_();
 	field = GetRandomField_();
 	val = "13";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	by = 4;
 	s_ = n_->HIncrby(key, field, by, newVal);
 	CHECK_STATUS(OK);
@@ -929,53 +990,53 @@ TEST_F(NemoHashTest, TestHIncrby)
 
 	by = 4;
 	s_.OK();//keyfieldӦֵ
-	n_->HSet(key, field, "2");
+	n_->HSet(key, field, "2", &res_);
 	n_->HDel(key, field);
 	newVal = "0";
 	HIncybyPositiveLoopProcess(by, "keyfieldӦֵ");
 
 	s_.OK();//keyfieldӦvalֻһӺ
 	val = "+";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	newVal = "0";
 	HIncybyNegativeLoopProcess(Corruption, 0, "keyfieldӦvalֻһӺ");
 
 	s_.OK();//keyfieldӦvalֻһ
 	val = "-";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	newVal = "0";
 	HIncybyNegativeLoopProcess(Corruption, 0, "keyfieldӦvalֻһ");
 	
 	s_.OK();//keyfieldӦvalȫ
 	val = "123#A";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	newVal = "0";
 	HIncybyNegativeLoopProcess(Corruption, 0, "keyfieldӦvalȫ");
 
 	s_.OK();//keyfieldӦvalΪ0000
 	val = "00000";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	newVal = "0";
 	by = 5;
 	HIncybyPositiveLoopProcess(5, "keyfieldӦvalΪ0000");
 
 	s_.OK();//keyfieldӦval+ţ磺+10
 	val = "+10";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	newVal = "0";
 	by = 5;
 	HIncybyPositiveLoopProcess(15, "keyfieldӦval+ţ磺+10");
 
 	s_.OK();//keyfieldӦval+ţ磺-10
 	val = "-10";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	newVal = "0";
 	by = 5;
 	HIncybyPositiveLoopProcess(-5, "keyfieldӦval+ţ磺-10");
 
 	s_.OK();///С
 	val = to_string(LLONG_MAX);
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	newVal = "0";
 	by = 5;
 	HIncybyNegativeLoopProcess(Invalid, 0, "/С");
@@ -992,7 +1053,7 @@ TEST_F(NemoHashTest, TestHIncrbyfloat)
 	field = GetRandomField_();
 	val = "12.3";
 	by = 1.2;
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	s_ = n_->HIncrbyfloat(key, field, by, newVal);
 	CHECK_STATUS(OK);
 	diff = atof(newVal.c_str()) - atof(val.c_str()) - by;
@@ -1016,7 +1077,7 @@ TEST_F(NemoHashTest, TestHIncrbyfloat)
 	s_.OK();//keyfieldӦԭvalзַ
 	val = "1.23jfkdj";
 	newVal = "0.0";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	s_ = n_->HIncrbyfloat(key, field, by, newVal);
 	CHECK_STATUS(Corruption);
 	EXPECT_EQ(string("0.0"), newVal);
@@ -1028,7 +1089,7 @@ TEST_F(NemoHashTest, TestHIncrbyfloat)
 	s_.OK();//keyfieldӦֵֻһ+
 	val = "+";
 	newVal = "0.0";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	s_ = n_->HIncrbyfloat(key, field, by, newVal);
 	CHECK_STATUS(Corruption);
 	EXPECT_EQ(string("0.0"), newVal);
@@ -1040,7 +1101,7 @@ TEST_F(NemoHashTest, TestHIncrbyfloat)
 	s_.OK();//keyfieldӦֵֻһ-
 	val = "-";
 	newVal = "0.0";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	s_ = n_->HIncrbyfloat(key, field, by, newVal);
 	CHECK_STATUS(Corruption);
 	EXPECT_EQ(string("0.0"), newVal);
@@ -1053,7 +1114,7 @@ TEST_F(NemoHashTest, TestHIncrbyfloat)
 	val = "+11.3";
 	by = 23.4;
 	newVal = "0.0";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	s_ = n_->HIncrbyfloat(key, field, by, newVal);
 	CHECK_STATUS(OK);
 	diff = atof(newVal.c_str()) - atof(val.c_str()) - by;
@@ -1067,7 +1128,7 @@ TEST_F(NemoHashTest, TestHIncrbyfloat)
 	val = "-13.4";
 	by = 22.34;
 	newVal = "0.0";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	s_ = n_->HIncrbyfloat(key, field, by, newVal);
 	CHECK_STATUS(OK);
 	diff = atof(newVal.c_str()) - atof(val.c_str()) - by;
@@ -1081,7 +1142,7 @@ TEST_F(NemoHashTest, TestHIncrbyfloat)
 	val = "3.34";
 	by = 7.66;
 	newVal = "0.0";
-	n_->HSet(key, field, val);
+	n_->HSet(key, field, val, &res_);
 	s_ = n_->HIncrbyfloat(key, field, by, newVal);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(string("11"), newVal);
@@ -1093,3 +1154,163 @@ TEST_F(NemoHashTest, TestHIncrbyfloat)
 	log_message("============================HASHTEST END===========================");
 	log_message("============================HASHTEST END===========================\n\n");
 }
+
+TEST_F(NemoHashTest, TestMetaCacheVersion)
+{
+	log_message("========TestMetaCacheVersion========");
+	string key, field, val, getVal;
+	int res;
+	int64_t count, len;
+	key = GetRandomKey_();
+	field = GetRandomField_();
+	val = GetRandomVal_();
+
+	s_ = n_->HSet(key, field, val, &res);
+	CHECK_STATUS(OK);
+	s_ = n_->Del(key, &count);
+	CHECK_STATUS(OK);
+
+	// the version bumped by Del must be seen by the next HGet and HSet
+	s_ = n_->HGet(key, field, &getVal);
+	CHECK_STATUS(NotFound);
+	s_ = n_->HSet(key, field + "_new", val, &res);
+	CHECK_STATUS(OK);
+	s_ = n_->HGet(key, field, &getVal);
+	CHECK_STATUS(NotFound);
+	s_ = n_->HGet(key, field + "_new", &getVal);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(val, getVal);
+	n_->HLen(key, &len);
+	EXPECT_EQ(1, len);
+
+	rocksdb::NemoMetaCacheStats stats;
+	n_->GetDBByType(nemo::HASH_DB)->GetMetaCacheStats(&stats);
+	EXPECT_LT(0U, stats.hits);
+	if(s_.ok() && val == getVal && len == 1)
+		log_success("meta cache follows the key version");
+	else
+		log_fail("meta cache follows the key version");
+	n_->Del(key, &count);
+}
+
+TEST_F(NemoHashTest, TestRowCache)
+{
+	log_message("========TestRowCache========");
+	string key, field, val, getVal;
+	int res;
+	int64_t count;
+	string newVal;
+	key = GetRandomKey_();
+	field = GetRandomField_();
+	val = GetRandomVal_();
+	rocksdb::DBNemo *hash_db = n_->GetDBByType(nemo::HASH_DB);
+	rocksdb::DBNemo *kv_db = n_->GetDBByType(nemo::KV_DB);
+	hash_db->SetRowCacheCapacity(1 << 20);
+	kv_db->SetRowCacheCapacity(1 << 20);
+
+	// the writes refresh the cached values
+	s_ = n_->HSet(key, field, val, &res);
+	CHECK_STATUS(OK);
+	n_->HGet(key, field, &getVal);
+	s_ = n_->HSet(key, field, val + "_new", &res);
+	CHECK_STATUS(OK);
+	s_ = n_->HGet(key, field, &getVal);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(val + "_new", getVal);
+	s_ = n_->HIncrby(key, "num", 3, newVal);
+	n_->HGet(key, "num", &getVal);
+	s_ = n_->HIncrby(key, "num", 4, newVal);
+	s_ = n_->HGet(key, "num", &getVal);
+	EXPECT_EQ("7", getVal);
+
+	// and the version bumped by Del invalidates them
+	s_ = n_->Del(key, &count);
+	CHECK_STATUS(OK);
+	s_ = n_->HGet(key, field, &getVal);
+	CHECK_STATUS(NotFound);
+	s_ = n_->HSet(key, "other", val, &res);
+	s_ = n_->HGet(key, field, &getVal);
+	CHECK_STATUS(NotFound);
+
+	s_ = n_->Set(key, val);
+	n_->Get(key, &getVal);
+	s_ = n_->Incrby(key + "_num", 5, newVal);
+	n_->Get(key + "_num", &getVal);
+	s_ = n_->Incrby(key + "_num", 5, newVal);
+	s_ = n_->Get(key + "_num", &getVal);
+	CHECK_STATUS(OK);
+	EXPECT_EQ("10", getVal);
+	s_ = n_->Del(key + "_num", &count);
+	s_ = n_->Get(key + "_num", &getVal);
+	CHECK_STATUS(NotFound);
+
+	rocksdb::NemoRowCacheStats stats;
+	n_->GetRowCacheStats(&stats);
+	EXPECT_LT(0U, stats.hits);
+	EXPECT_LT(0U, stats.entries);
+	uint64_t usage_on, usage_off;
+	n_->GetUsage(nemo::USAGE_TYPE_NEMO, &usage_on);
+	hash_db->SetRowCacheCapacity(0);
+	kv_db->SetRowCacheCapacity(0);
+	n_->GetUsage(nemo::USAGE_TYPE_NEMO, &usage_off);
+	EXPECT_LT(usage_off, usage_on);
+	if(stats.hits > 0 && usage_off < usage_on)
+		log_success("row cache follows the writes and the key version");
+	else
+		log_fail("row cache follows the writes and the key version");
+	n_->Del(key, &count);
+}
+
+TEST_F(NemoHashTest, TestBGTaskScheduler)
+{
+	log_message("\n========TestBGTaskScheduler========");
+	string keyPre = "nemo_bgtask_";
+	int keyNum = 20, fieldNum = 1000, rounds = 100;
+	int res;
+	int64_t count;
+	nemo::BGTaskStats before;
+	n_->GetBGTaskStats(&before);
+	for(int r = 0; r < rounds; r++)
+	{
+		for(int k = 0; k < keyNum; k++)
+		{
+			string key = keyPre + itoa(k);
+			//A large hash on the first round, a few fields on the next ones
+			int fields = r == 0 ? fieldNum : 10;
+			for(int f = 0; f < fields; f++)
+				n_->HSet(key, itoa(f), "v", &res);
+			n_->Del(key, &count);
+		}
+		if(r % 25 == 0)
+			n_->Compact(nemo::kHASH_DB, false);
+		if(r % 50 == 49)
+			n_->Compact(nemo::kHASH_DB, true);
+	}
+
+	nemo::BGTaskStats stats;
+	for(int i = 0; i < 600; i++)
+	{
+		n_->GetBGTaskStats(&stats);
+		if(stats.pending == 0 && stats.running == 0)
+			break;
+		usleep(100000);
+	}
+	uint64_t added = stats.added - before.added;
+	uint64_t done = stats.executed + stats.merged + stats.dropped
+		- before.executed - before.merged - before.dropped;
+	bool flag = stats.pending == 0 && stats.running == 0 && added == done
+		&& added >= (uint64_t)keyNum * rounds && stats.merged > before.merged
+		&& stats.dropped == before.dropped;
+	int64_t len = 0, total = 0;
+	for(int k = 0; k < keyNum; k++)
+	{
+		n_->HLen(keyPre + itoa(k), &len);
+		total += len;
+	}
+	flag = flag && total == 0;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("background tasks of repeated Del are merged and all run");
+	else
+		log_fail("background tasks of repeated Del are merged and all run");
+}
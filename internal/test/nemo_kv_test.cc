@@ -1,12 +1,15 @@
 #include <string>
 #include <vector>
 #include <sys/time.h>
+#include <thread>
 #include <cstdlib>
 #include <cstdlib>
 
 #include "gtest/gtest.h"
 #include "xdebug.h"
 #include "nemo.h"
+#include "nemo_bit_kernel.h"
+#include "nemo_volume_iterator.h"
 
 //#include "stdint.h"
 #include "nemo_kv_test.h"
@@ -1429,7 +1432,7 @@ TEST_F(NemoKVTest, TestScan)
 	*/
 
 	bool flag1, flag2, flag3;
-	string key, val;
+	string key, val, lastKey;
 	string keyPre = "nemo_scan_test";
 	int64_t totalKeyNum = 3;
 	int64_t numPre = 10000;
@@ -1460,9 +1463,10 @@ TEST_F(NemoKVTest, TestScan)
 	{
 		//EXPECT_EQ(string("nemo_scan_test") + itoa(numPre + index), kIterPtr->key());
 		index++;
+		lastKey = kIterPtr->key().ToString();
 	}
-	EXPECT_EQ(string("nemo_scan_test") + itoa(numPre+totalKeyNum-1), kIterPtr->key());
-	if(keyPre + itoa(numPre+totalKeyNum-1) == kIterPtr->key())
+	EXPECT_EQ(string("nemo_scan_test") + itoa(numPre+totalKeyNum-1), lastKey);
+	if(keyPre + itoa(numPre+totalKeyNum-1) == lastKey)
 		flag2 = true;
 	EXPECT_EQ(totalKeyNum, index);
 	if(index == totalKeyNum)
@@ -1488,10 +1492,11 @@ TEST_F(NemoKVTest, TestScan)
   for (; kIterPtr->Valid(); kIterPtr->Next())
 	{
 		index++;
+		lastKey = kIterPtr->key().ToString();
 		//EXPECT_EQ(string("nomo_scan_test") + itoa(numPre+index), kIterPtr->key());
 	}
-	EXPECT_EQ(string("nemo_scan_test") + itoa(numPre+totalKeyNum-1), kIterPtr->key());
-	if(string("nemo_scan_test") + itoa(numPre+totalKeyNum-1) == kIterPtr->key())
+	EXPECT_EQ(string("nemo_scan_test") + itoa(numPre+totalKeyNum-1), lastKey);
+	if(string("nemo_scan_test") + itoa(numPre+totalKeyNum-1) == lastKey)
 		flag2 = true;
 	EXPECT_EQ(totalKeyNum, index);
 	if(index == totalKeyNum)
@@ -1517,10 +1522,11 @@ TEST_F(NemoKVTest, TestScan)
   for (; kIterPtr->Valid(); kIterPtr->Next())
 	{
 		index++;
+		lastKey = kIterPtr->key().ToString();
 		//EXPECT_EQ(keyPre + itoa(numPre + index), kIterPtr->key());
 	}
-	EXPECT_EQ(keyPre + itoa(numPre + totalKeyNum - 1), kIterPtr->key());
-	if(keyPre + itoa(numPre + totalKeyNum - 1) == kIterPtr->key())
+	EXPECT_EQ(keyPre + itoa(numPre + totalKeyNum - 1), lastKey);
+	if(keyPre + itoa(numPre + totalKeyNum - 1) == lastKey)
 		flag2 = true;
 	EXPECT_EQ(totalKeyNum, index);
 	if(index == totalKeyNum)
@@ -1546,9 +1552,10 @@ TEST_F(NemoKVTest, TestScan)
   for (; kIterPtr->Valid(); kIterPtr->Next())
 	{
 		index++;
+		lastKey = kIterPtr->key().ToString();
 	}
-	EXPECT_EQ(keyPre + itoa(numPre + endInt), kIterPtr->key());
-	if(keyPre + itoa(numPre + endInt) == kIterPtr->key())
+	EXPECT_EQ(keyPre + itoa(numPre + endInt), lastKey);
+	if(keyPre + itoa(numPre + endInt) == lastKey)
 		flag2 = true;
 	EXPECT_EQ(endInt, index - 1);
 	if(endInt == index)
@@ -1616,9 +1623,10 @@ TEST_F(NemoKVTest, TestScan)
 	//while(kIterPtr->Next())
 	{
 		index++;
+		lastKey = kIterPtr->key().ToString();
 	}
-	EXPECT_EQ(keyPre + itoa(numPre + limit -1 ), kIterPtr->key());
-	if(keyPre + itoa(numPre + limit -1 ) == kIterPtr->key())
+	EXPECT_EQ(keyPre + itoa(numPre + limit -1 ), lastKey);
+	if(keyPre + itoa(numPre + limit -1 ) == lastKey)
 		flag2 = true;
 	EXPECT_EQ(limit, index);
 	if(limit-1 == index)
@@ -1825,6 +1833,997 @@ TEST_F(NemoKVTest, TestExpireat)
 		log_fail("key");
 }
 
+TEST_F(NemoKVTest, TestPfAdd)
+{
+	log_message("\n========TestPfAdd========");
+	string key, val;
+	vector<string> values, keys;
+	bool update;
+	int result;
+
+	key = GetRandomKey_();
+	values.clear();
+	values.push_back("a");
+	values.push_back("b");
+	values.push_back("c");
+	s_ = n_->PfAdd(key, values, update);
+	CHECK_STATUS(OK);
+	EXPECT_TRUE(update);
+	s_ = n_->PfAdd(key, values, update);
+	EXPECT_FALSE(update);
+	keys.clear();
+	keys.push_back(key);
+	s_ = n_->PfCount(keys, result);
+	EXPECT_EQ(3, result);
+	if(s_.ok() && result == 3 && !update)
+		log_success("sparse PfAdd");
+	else
+		log_fail("sparse PfAdd");
+
+	//past HLL_SPARSE_MAX_REGISTERS the registers are packed dense
+	for(int i = 0; i < 100; i++)
+	{
+		values.clear();
+		for(int j = 0; j < 1000; j++)
+			values.push_back(to_string(i * 1000 + j));
+		s_ = n_->PfAdd(key, values, update);
+	}
+	CHECK_STATUS(OK);
+	s_ = n_->Get(key, &val);
+	EXPECT_EQ(string("HYLL"), val.substr(0, 4));
+	EXPECT_EQ(0, val[4]);
+	s_ = n_->PfCount(keys, result);
+	EXPECT_NEAR(100003, result, 100003 * 0.02);
+	if(s_.ok() && result > 100003 * 0.98 && result < 100003 * 1.02)
+		log_success("dense PfAdd, PfCount=%d", result);
+	else
+		log_fail("dense PfAdd, PfCount=%d", result);
+
+	//values written before the header existed keep counting
+	string oldKey = GetRandomKey_();
+	val.assign(1 << 17, 0);
+	val[5] = 1;
+	s_ = n_->Set(oldKey, val);
+	keys.clear();
+	keys.push_back(oldKey);
+	s_ = n_->PfCount(keys, result);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(1, result);
+	values.clear();
+	values.push_back("d");
+	s_ = n_->PfAdd(oldKey, values, update);
+	CHECK_STATUS(OK);
+	s_ = n_->PfCount(keys, result);
+	EXPECT_EQ(2, result);
+	n_->Get(oldKey, &val);
+	EXPECT_EQ(string("HYLL"), val.substr(0, 4));
+	EXPECT_EQ(1, val[5]);
+	if(s_.ok() && result == 2)
+		log_success("legacy PfAdd");
+	else
+		log_fail("legacy PfAdd");
+
+	s_ = n_->Set(oldKey, "not a hll");
+	s_ = n_->PfAdd(oldKey, values, update);
+	CHECK_STATUS(Corruption);
+
+	string destKey = GetRandomKey_();
+	keys.clear();
+	keys.push_back(destKey);
+	keys.push_back(key);
+	s_ = n_->PfMerge(keys);
+	CHECK_STATUS(OK);
+	keys.pop_back();
+	s_ = n_->PfCount(keys, result);
+	EXPECT_NEAR(100003, result, 100003 * 0.02);
+	if(s_.ok() && result > 100003 * 0.98 && result < 100003 * 1.02)
+		log_success("PfMerge, PfCount=%d", result);
+	else
+		log_fail("PfMerge, PfCount=%d", result);
+}
+
+TEST_F(NemoKVTest, TestBitKernel)
+{
+	log_message("\n========TestBitKernel========");
+	string key1, key2, destKey, val1, val2, getVal;
+	int64_t res, len, expect;
+	bool flag;
+
+	//every kernel the cpu runs against a byte at a time loop
+	srand(7);
+	for(int level = nemo::kBitKernelScalar; level < nemo::kBitKernelLevels; level++)
+	{
+		const nemo::BitKernel *kernel = nemo::GetBitKernel((nemo::BitKernelLevel)level);
+		if(kernel == NULL)
+			continue;
+		flag = true;
+		for(int i = 0; i < 500; i++)
+		{
+			size_t n = rand() % 1000, off = rand() % 8;
+			vector<uint8_t> a(n + off, 0), b(n + off);
+			for(size_t j = off; j < a.size(); j++)
+			{
+				a[j] = (i % 3 == 0) ? rand() : 0xff * (i % 3 - 1);
+				b[j] = rand();
+			}
+			if(n > 0 && i % 2)
+				a[off + rand() % n] = rand();
+			uint64_t count = 0;
+			for(size_t j = off; j < a.size(); j++)
+				count += __builtin_popcount(a[j]);
+			size_t find0 = 0, find1 = 0;
+			while(find0 < n && a[off + find0] == 0) find0++;
+			while(find1 < n && a[off + find1] == 0xff) find1++;
+			flag = flag && kernel->count(&a[off], n) == count;
+			flag = flag && kernel->find(&a[off], n, 0) == find0 && kernel->find(&a[off], n, 0xff) == find1;
+			for(int op = nemo::kBitOpNot; op <= nemo::kBitOpXor; op++)
+			{
+				vector<uint8_t> got(a), want(a);
+				kernel->op((nemo::BitOpType)op, &got[off], op == nemo::kBitOpNot ? NULL : &b[off], n);
+				for(size_t j = off; j < want.size(); j++)
+					want[j] = op == nemo::kBitOpNot ? ~want[j] : op == nemo::kBitOpAnd ? want[j] & b[j] : op == nemo::kBitOpOr ? want[j] | b[j] : want[j] ^ b[j];
+				flag = flag && got == want;
+			}
+		}
+		EXPECT_TRUE(flag);
+		if(flag)
+			log_success("%s kernel", kernel->name);
+		else
+			log_fail("%s kernel", kernel->name);
+	}
+
+	//bitmap commands over values longer than any vector
+	key1 = GetRandomKey_();
+	key2 = GetRandomKey_();
+	destKey = GetRandomKey_();
+	val1.assign(4099, 0);
+	val1[4000] = 0x10;
+	val2.assign(3001, (char)0xff);
+	s_ = n_->Set(key1, val1);
+	s_ = n_->Set(key2, val2);
+	s_ = n_->BitCount(key2, 1, -2, &res);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(2999 * 8, res);
+	s_ = n_->BitPos(key1, 1, &res);
+	EXPECT_EQ(4000 * 8 + 3, res);
+	s_ = n_->BitPos(key2, 0, &res);
+	EXPECT_EQ(3001 * 8, res);
+	s_ = n_->BitPos(key2, 0, 0, -1, &res);
+	EXPECT_EQ(-1, res);
+	vector<string> srcKeys;
+	srcKeys.push_back(key1);
+	srcKeys.push_back(key2);
+	s_ = n_->BitOp(nemo::kBitOpOr, destKey, srcKeys, &len);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(4099, len);
+	n_->BitCount(destKey, &res);
+	expect = 3001 * 8 + 1;
+	EXPECT_EQ(expect, res);
+	s_ = n_->BitOp(nemo::kBitOpAnd, destKey, srcKeys, &len);
+	n_->BitCount(destKey, &res);
+	EXPECT_EQ(0, res);
+	s_ = n_->BitOp(nemo::kBitOpXor, destKey, srcKeys, &len);
+	n_->Get(destKey, &getVal);
+	EXPECT_EQ(val2 + string(val1, 3001), getVal);
+	srcKeys.pop_back();
+	s_ = n_->BitOp(nemo::kBitOpNot, destKey, srcKeys, &len);
+	n_->BitCount(destKey, &res);
+	EXPECT_EQ(4099 * 8 - 1, res);
+	if(res == 4099 * 8 - 1 && getVal.size() == 4099)
+		log_success("BitCount, BitPos and BitOp");
+	else
+		log_fail("BitCount, BitPos and BitOp");
+}
+
+TEST_F(NemoKVTest, TestMGetBatch)
+{
+	log_message("\n========TestMGetBatch========");
+	vector<string> keys, vals;
+	vector<rocksdb::Slice> keySlices;
+	rocksdb::NemoBatchGetResult result;
+	vector<nemo::KVS> kvss;
+	bool flag = true;
+
+	for(int i = 0; i < 100; i++)
+	{
+		keys.push_back(GetRandomKey_() + to_string(i));
+		vals.push_back(GetRandomVal_());
+		if(i % 3)
+			n_->Set(keys[i], vals[i]);
+		else if(i % 2)
+			n_->Set(keys[i], vals[i], 1);
+	}
+	sleep(2);
+	keySlices.assign(keys.begin(), keys.end());
+	s_ = n_->MGetBatch(keySlices, &result);
+	CHECK_STATUS(OK);
+	s_ = n_->MGet(keys, kvss);
+	ASSERT_EQ(100U, result.values.size());
+	ASSERT_EQ(100U, kvss.size());
+	for(int i = 0; i < 100; i++)
+	{
+		if(i % 3)
+			flag = flag && result.statuses[i].ok() && result.values[i] == vals[i] && kvss[i].val == vals[i];
+		else
+			flag = flag && result.statuses[i].IsNotFound() && kvss[i].status.IsNotFound();
+	}
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("MGetBatch, with missing and expired keys");
+	else
+		log_fail("MGetBatch, with missing and expired keys");
+}
+
+TEST_F(NemoKVTest, TestKeyFilter)
+{
+	log_message("\n========TestKeyFilter========");
+	//Off by default
+	string dbs[] = {nemo::KV_DB, nemo::HASH_DB, nemo::LIST_DB, nemo::ZSET_DB, nemo::SET_DB};
+	for(int i = 0; i < 5; i++)
+		n_->GetDBByType(dbs[i])->EnableKeyFilter(10);
+	string key = GetRandomKey_();
+	vector<string> keys;
+	int hres;
+	int64_t res;
+	keys.push_back(key + "_kv");
+	keys.push_back(key + "_hash");
+	keys.push_back(key + "_list");
+	keys.push_back(key + "_zset");
+	keys.push_back(key + "_set");
+	n_->Set(keys[0], GetRandomVal_());
+	n_->HSet(keys[1], "field", GetRandomVal_(), &hres);
+	n_->LPush(keys[2], GetRandomVal_(), &res);
+	n_->ZAdd(keys[3], 1.0, "member", &res);
+	n_->SAdd(keys[4], "member", &res);
+
+	rocksdb::NemoKeyFilterStats stats;
+	for(int i = 0; i < 100; i++)
+	{
+		n_->GetKeyFilterStats(&stats);
+		if(stats.ready)
+			break;
+		usleep(100000);
+	}
+	EXPECT_TRUE(stats.ready);
+
+	//Keys written before and after the filters were built, beside missing ones
+	keys.push_back(key + "_late");
+	n_->HSet(keys[5], "field", GetRandomVal_(), &hres);
+	vector<string> probes(keys);
+	probes.push_back(key + "_missing");
+	probes.push_back(keys[0]);
+	s_ = n_->Exists(probes, &res);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(7, res);
+	if(res == 7)
+		log_success("Exists of every type, missing and repeated keys");
+	else
+		log_fail("Exists of every type, missing and repeated keys");
+
+	string types[] = {"string", "hash", "list", "zset", "set", "hash"};
+	bool flag = true;
+	string type;
+	for(int i = 0; i < 6; i++)
+	{
+		s_ = n_->Type(keys[i], &type);
+		flag = flag && s_.ok() && type == types[i];
+	}
+	s_ = n_->Type(key + "_missing", &type);
+	flag = flag && s_.ok() && type == "none";
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("Type of every type and of a missing key");
+	else
+		log_fail("Type of every type and of a missing key");
+
+	n_->TTL(key + "_missing", &res);
+	EXPECT_EQ(-2, res);
+	n_->Del(key + "_missing", &res);
+	EXPECT_EQ(0, res);
+	n_->Del(keys[3], &res);
+	EXPECT_EQ(1, res);
+	s_ = n_->Type(keys[3], &type);
+	EXPECT_EQ("none", type);
+	if(res == 1 && type == "none")
+		log_success("TTL and Del of missing keys, Del of a zset");
+	else
+		log_fail("TTL and Del of missing keys, Del of a zset");
+}
+
+TEST_F(NemoKVTest, TestScanBounds)
+{
+	log_message("\n========TestScanBounds========");
+	string keyPre = "nemo_scan_bounds_";
+	string val = GetRandomVal_();
+	for(int i = 0; i < 5; i++)
+		n_->Set(keyPre + itoa(i), val);
+
+	//KScan stops at end, KScanRO before it
+	nemo::KIterator *kIterPtr = n_->KScan(keyPre + "1", keyPre + "3", -1);
+	nemo::KIteratorRO *kIterROPtr = n_->KScanRO(keyPre + "1", keyPre + "3", -1);
+	int index = 1;
+	bool flag = true;
+	for(; kIterPtr->Valid(); kIterPtr->Next(), index++)
+		flag = flag && kIterPtr->key() == keyPre + itoa(index) && kIterPtr->value() == val;
+	flag = flag && index == 4;
+	for(index = 1; kIterROPtr->Valid(); kIterROPtr->Next(), index++)
+		flag = flag && kIterROPtr->key() == keyPre + itoa(index);
+	flag = flag && index == 3 && kIterPtr->key().empty();
+	delete kIterPtr;
+	delete kIterROPtr;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("KScan and KScanRO stop at end");
+	else
+		log_fail("KScan and KScanRO stop at end");
+
+	//Neither HGetall nor ZRange runs into the fields of a deleted neighbour
+	string key = keyPre + "hash";
+	int hres;
+	int64_t res;
+	for(int i = 0; i < 3; i++)
+	{
+		n_->HSet(key, itoa(i), val, &hres);
+		n_->HSet(key + "_", itoa(i), val, &hres);
+		n_->ZAdd(key, i, itoa(i), &res);
+		n_->ZAdd(key + "_", i, itoa(i), &res);
+	}
+	n_->Del(key + "_", &res);
+	vector<nemo::FV> fvs;
+	vector<nemo::SM> sms;
+	n_->HGetall(key, fvs);
+	n_->ZRange(key, -2, -1, sms);
+	flag = fvs.size() == 3 && fvs[2].field == "2" && fvs[2].val == val
+		&& sms.size() == 2 && sms[0].member == "1" && sms[1].member == "2";
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("HGetall and ZRange beside a deleted key");
+	else
+		log_fail("HGetall and ZRange beside a deleted key");
+	n_->Del(key, &res);
+	for(int i = 0; i < 5; i++)
+		n_->Del(keyPre + itoa(i), &res);
+}
+
+TEST_F(NemoKVTest, TestKeysAndScanCursor)
+{
+	log_message("\n========TestKeysAndScanCursor========");
+	string keyPre = "nemo_keys_test_";
+	int hres;
+	int64_t res;
+	for(int i = 0; i < 20; i++)
+	{
+		n_->Set(keyPre + "kv_" + itoa(i), GetRandomVal_());
+		n_->HSet(keyPre + "hash_" + itoa(i), "field", GetRandomVal_(), &hres);
+		n_->SAdd(keyPre + "set_" + itoa(i), "member", &res);
+	}
+
+	vector<string> keys;
+	s_ = n_->Keys(keyPre + "*", keys);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(60, (int)keys.size());
+	keys.clear();
+	s_ = n_->Keys(keyPre + "[hs]*_1?", keys);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(20, (int)keys.size());
+	keys.clear();
+	s_ = n_->Keys("*keys_test_kv_1", keys);
+	EXPECT_EQ(1, (int)keys.size());
+	if(keys.size() == 1)
+		log_success("Keys with a prefix, a class and no prefix");
+	else
+		log_fail("Keys with a prefix, a class and no prefix");
+
+	//Resumes where the cursor left off, whatever the db
+	string cursor = "0", nextCursor;
+	int total = 0, calls = 0;
+	do
+	{
+		s_ = n_->Scan(cursor, keyPre + "*", 7, keys, &nextCursor);
+		CHECK_STATUS(OK);
+		total += keys.size();
+		cursor = nextCursor;
+		calls++;
+	} while(cursor != "0" && calls < 100);
+	EXPECT_EQ(60, total);
+	if(total == 60)
+		log_success("Scan of 60 keys 7 by 7 in %d calls", calls);
+	else
+		log_fail("Scan of 60 keys 7 by 7 in %d calls", calls);
+	s_ = n_->Scan(string("x"), keyPre + "*", 7, keys, &nextCursor);
+	CHECK_STATUS(InvalidArgument);
+
+	for(int i = 0; i < 20; i++)
+	{
+		n_->Del(keyPre + "kv_" + itoa(i), &res);
+		n_->Del(keyPre + "hash_" + itoa(i), &res);
+		n_->Del(keyPre + "set_" + itoa(i), &res);
+	}
+}
+
+TEST_F(NemoKVTest, TestVolumeIndex)
+{
+	log_message("\n========TestVolumeIndex========");
+	string keyPre = "nemo_volume_index_";
+	string start = keyPre, end = keyPre + "~";
+	string val(2000, 'v');
+	int hres;
+	int64_t res;
+	for(int i = 0; i < 4000; i++)
+	{
+		n_->Set(keyPre + itoa(i), val);
+		if(i % 20 == 0)
+			for(int j = 0; j < 50; j++)
+				n_->HSet(keyPre + "hash_" + itoa(i), itoa(j), val, &hres);
+	}
+	n_->Compact(nemo::kALL, true);
+
+	//Off by one sample step per db at each end of the range
+	int64_t tolerance = 4 * rocksdb::NemoVolumeCollectorFactory::kDefaultSampleBytes;
+	nemo::VolumeIndex index(n_);
+	nemo::VolumeIterator *vit = new nemo::VolumeIterator(n_, start, end);
+	vit->targetScan(1LL << 60);
+	int64_t exact = vit->totalVolume(), approx = 0;
+	delete vit;
+	s_ = index.Volume(start, end, &approx);
+	CHECK_STATUS(OK);
+	EXPECT_LE(llabs(approx - exact), tolerance);
+	if(llabs(approx - exact) <= tolerance)
+		log_success("Volume %lld of %lld", (long long)approx, (long long)exact);
+	else
+		log_fail("Volume %lld of %lld", (long long)approx, (long long)exact);
+
+	string key;
+	s_ = index.TargetKey(start, end, exact / 2, &key);
+	CHECK_STATUS(OK);
+	vit = new nemo::VolumeIterator(n_, start, key + '\0');
+	vit->targetScan(1LL << 60);
+	int64_t upto = vit->totalVolume();
+	delete vit;
+	EXPECT_LE(llabs(upto - exact / 2), tolerance);
+	if(llabs(upto - exact / 2) <= tolerance)
+		log_success("TargetKey %s at %lld of %lld", key.c_str(), (long long)upto, (long long)(exact / 2));
+	else
+		log_fail("TargetKey %s at %lld of %lld", key.c_str(), (long long)upto, (long long)(exact / 2));
+
+	//The samples are merged again only once the files changed
+	uint64_t rebuilds = index.rebuilds();
+	s_ = index.TargetKey(start, end, exact + tolerance + 1, &key);
+	CHECK_STATUS(NotFound);
+	EXPECT_EQ(rebuilds, index.rebuilds());
+
+	for(int i = 0; i < 4000; i++)
+	{
+		n_->Del(keyPre + itoa(i), &res);
+		if(i % 20 == 0)
+			n_->Del(keyPre + "hash_" + itoa(i), &res);
+	}
+}
+
+TEST_F(NemoKVTest, TestRangeDel)
+{
+	log_message("\n========TestRangeDel========");
+	string keyPre = "nemo_rangedel_";
+	string start = keyPre + "b", end = keyPre + "d";
+	//Shorter and longer than the bounds, at them and beside them
+	string keys[] = {keyPre, keyPre + "a", keyPre + "b", keyPre + "bb", keyPre + "c", keyPre + "c1", keyPre + "d", keyPre + "d0"};
+	bool inside[] = {false, false, true, true, true, true, false, false};
+	int num = sizeof(keys) / sizeof(keys[0]);
+	int hres;
+	int64_t res;
+	for(int i = 0; i < num; i++)
+	{
+		n_->Set(keys[i], "v");
+		for(int j = 0; j < 3; j++)
+		{
+			n_->HSet(keys[i], itoa(j), "v", &hres);
+			n_->LPush(keys[i], "v", &res);
+			n_->SAdd(keys[i], itoa(j), &res);
+			n_->ZAdd(keys[i], j, itoa(j), &res);
+		}
+	}
+
+	s_ = n_->RangeDel(start, end);
+	CHECK_STATUS(OK);
+	bool flag = true;
+	for(int i = 0; i < num; i++)
+	{
+		string val;
+		vector<nemo::FV> fvs;
+		int64_t llen = 0, scard = 0, zcard = 0;
+		bool found = n_->Get(keys[i], &val).ok();
+		n_->HGetall(keys[i], fvs);
+		n_->LLen(keys[i], &llen);
+		n_->SCard(keys[i], &scard);
+		n_->ZCard(keys[i], &zcard);
+		int64_t left = inside[i] ? 0 : 3;
+		flag = flag && found == !inside[i] && (int64_t)fvs.size() == left
+			&& llen == left && scard == left && zcard == left;
+	}
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("RangeDel keeps the keys beside the bounds");
+	else
+		log_fail("RangeDel keeps the keys beside the bounds");
+
+	//A deleted key comes back with none of its old fields
+	n_->HSet(keys[3], "new", "v", &hres);
+	n_->ZAdd(keys[3], 0, "new", &res);
+	vector<nemo::FV> fvs;
+	int64_t zcard = 0;
+	n_->HGetall(keys[3], fvs);
+	n_->ZCard(keys[3], &zcard);
+	flag = fvs.size() == 1 && fvs[0].field == "new" && zcard == 1;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("Key written again after RangeDel");
+	else
+		log_fail("Key written again after RangeDel");
+
+	//A limit deletes the first keys of each type only
+	string limitPre = keyPre + "limit_";
+	for(int i = 0; i < 4; i++)
+	{
+		n_->Set(limitPre + itoa(i), "v");
+		n_->HSet(limitPre + itoa(i), "f", "v", &hres);
+	}
+	s_ = n_->RangeDel(limitPre, limitPre + "~", 2);
+	CHECK_STATUS(OK);
+	flag = true;
+	for(int i = 0; i < 4; i++)
+	{
+		string val;
+		bool found = n_->Get(limitPre + itoa(i), &val).ok();
+		bool hfound = n_->HGet(limitPre + itoa(i), "f", &val).ok();
+		flag = flag && found == (i >= 2) && hfound == (i >= 2);
+	}
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("RangeDel with a limit");
+	else
+		log_fail("RangeDel with a limit");
+
+	s_ = n_->RangeDelFiles(keyPre, keyPre + "~");
+	CHECK_STATUS(OK);
+	fvs.clear();
+	n_->HGetall(keys[0], fvs);
+	EXPECT_EQ(0, (int)fvs.size());
+}
+
+TEST_F(NemoKVTest, TestRawScanSaveAll)
+{
+	log_message("\n========TestRawScanSaveAll========");
+	string keyPre = "nemo_rawscan_";
+	string keys[] = {keyPre + "a", keyPre + "b", keyPre + "bb", keyPre + "c"};
+	bool inside[] = {false, true, true, false};
+	int num = sizeof(keys) / sizeof(keys[0]);
+	int hres;
+	int64_t res;
+	for(int i = 0; i < num; i++)
+	{
+		n_->Set(keys[i], "v");
+		for(int j = 0; j < 3; j++)
+		{
+			n_->HSet(keys[i], itoa(j), "v", &hres);
+			n_->LPush(keys[i], "v", &res);
+			n_->SAdd(keys[i], itoa(j), &res);
+			n_->ZAdd(keys[i], j, itoa(j), &res);
+		}
+	}
+
+	s_ = n_->RawScanSaveAll("./tmp_raw_scan", keyPre + "b", keyPre + "c", true);
+	CHECK_STATUS(OK);
+	//Saved twice, the files of the first save are replaced
+	s_ = n_->RawScanSaveAll("./tmp_raw_scan", keyPre + "b", keyPre + "c", true);
+	CHECK_STATUS(OK);
+
+	nemo::Options options;
+	nemo::Nemo *dst = new nemo::Nemo(string("./tmp_raw_scan_dst/"), options);
+	s_ = dst->IngestFile("./tmp_raw_scan");
+	CHECK_STATUS(OK);
+	bool flag = true;
+	for(int i = 0; i < num; i++)
+	{
+		string val;
+		vector<nemo::FV> fvs;
+		int64_t llen = 0, scard = 0, zcard = 0;
+		bool found = dst->Get(keys[i], &val).ok();
+		dst->HGetall(keys[i], fvs);
+		dst->LLen(keys[i], &llen);
+		dst->SCard(keys[i], &scard);
+		dst->ZCard(keys[i], &zcard);
+		int64_t left = inside[i] ? 3 : 0;
+		flag = flag && found == inside[i] && (int64_t)fvs.size() == left
+			&& llen == left && scard == left && zcard == left;
+	}
+	delete dst;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("IngestFile loads the keys of the range only");
+	else
+		log_fail("IngestFile loads the keys of the range only");
+}
+
+TEST_F(NemoKVTest, TestBGSave)
+{
+	log_message("\n========TestBGSave========");
+	string keyPre = "nemo_bgsave_";
+	int hres;
+	int64_t res;
+	n_->Set(keyPre + "kv", "v");
+	n_->Set(keyPre + "expire", "v", 1);
+	n_->HSet(keyPre + "hash", "f", "v", &hres);
+	n_->LPush(keyPre + "list", "v", &res);
+	n_->SAdd(keyPre + "set", "m", &res);
+	n_->ZAdd(keyPre + "zset", 1, "m", &res);
+	n_->PutWithHandle(n_->GetMetaHandle(), keyPre + "meta", "v", false);
+
+	nemo::Snapshots snapshots;
+	s_ = n_->BGSaveGetSnapshot(snapshots);
+	CHECK_STATUS(OK);
+	s_ = n_->BGSave(snapshots, "./tmp_bgsave");
+	CHECK_STATUS(OK);
+	//Written after the save
+	n_->Set(keyPre + "after", "v");
+	n_->Del(keyPre + "kv", &res);
+
+	nemo::Options options;
+	nemo::Nemo *restored = new nemo::Nemo(string("./tmp_bgsave/"), options);
+	string val, hval, lval;
+	int64_t scard = 0, zcard = 0;
+	bool flag = restored->Get(keyPre + "kv", &val).ok() && val == "v"
+		&& restored->HGet(keyPre + "hash", "f", &hval).ok()
+		&& restored->LIndex(keyPre + "list", 0, &lval).ok()
+		&& restored->SCard(keyPre + "set", &scard).ok() && scard == 1
+		&& restored->ZCard(keyPre + "zset", &zcard).ok() && zcard == 1
+		&& restored->GetWithHandle(restored->GetMetaHandle(), keyPre + "meta", &val).ok()
+		&& restored->Get(keyPre + "after", &val).IsNotFound();
+	sleep(2);
+	flag = flag && restored->Get(keyPre + "expire", &val).IsNotFound();
+	delete restored;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("BGSave restores the dbs as of the save");
+	else
+		log_fail("BGSave restores the dbs as of the save");
+}
+
+TEST_F(NemoKVTest, TestExpireSweep)
+{
+	log_message("\n========TestExpireSweep========");
+	//The keys are indexed with a sweeper only, whose own rounds are far apart
+	delete n_;
+	nemo::Options options;
+	options.target_file_size_base = 20*1024*1024;
+	options.expire_sweep_rate = 10000;
+	options.expire_sweep_interval = 3600 * 1000;
+	n_ = new nemo::Nemo(string("./tmp/"), options);
+	string keyPre = "nemo_expire_sweep_";
+	int keyNum = 100;
+	int hres;
+	int64_t res;
+	nemo::ExpireStats before;
+	n_->GetExpireStats(&before);
+	for(int k = 0; k < keyNum; k++)
+	{
+		n_->Set(keyPre + "kv_" + itoa(k), "v", 1);
+		n_->HSet(keyPre + "hash_" + itoa(k), "f", "v", &hres);
+		n_->Expire(keyPre + "hash_" + itoa(k), 1, &res);
+	}
+	//Persisted before it expires, its entry is stale
+	n_->Set(keyPre + "persist", "v", 1);
+	n_->Persist(keyPre + "persist", &res);
+
+	sleep(3);
+	int64_t expired = 0;
+	s_ = n_->SweepExpired(1 << 30, &expired);
+	CHECK_STATUS(OK);
+	nemo::ExpireStats stats;
+	n_->GetExpireStats(&stats);
+	string val;
+	bool flag = stats.indexed - before.indexed >= (uint64_t)keyNum * 2 + 1
+		&& stats.expired - before.expired >= (uint64_t)keyNum * 2
+		&& stats.stale > before.stale
+		&& n_->Get(keyPre + "persist", &val).ok();
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("the keys expired are swept and the stale entries dropped");
+	else
+		log_fail("the keys expired are swept and the stale entries dropped");
+
+	//The kv keys are deleted, the hashes emptied under a new version
+	int32_t ttl = 0;
+	s_ = n_->GetDBByType(nemo::KV_DB)->GetKeyTTL(rocksdb::ReadOptions(), keyPre + "kv_0", &ttl);
+	int64_t hlen = -1;
+	n_->HSet(keyPre + "hash_0", "g", "v", &hres);
+	n_->HLen(keyPre + "hash_0", &hlen);
+	flag = s_.IsNotFound() && ttl != -2 && hlen == 1;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("the keys swept are deleted or given a new version");
+	else
+		log_fail("the keys swept are deleted or given a new version");
+
+	//Indexed behind the timestamp the last sweep stopped at, by this sweep
+	//or the one of the sweeper thread
+	n_->GetExpireStats(&before);
+	n_->SetWithExpireAt(keyPre + "past", "v", time(NULL) - 10);
+	s_ = n_->SweepExpired(1 << 30, &expired);
+	CHECK_STATUS(OK);
+	n_->GetExpireStats(&stats);
+	ttl = 0;
+	s_ = n_->GetDBByType(nemo::KV_DB)->GetKeyTTL(rocksdb::ReadOptions(), keyPre + "past", &ttl);
+	flag = stats.expired - before.expired >= 1 && s_.IsNotFound() && ttl != -2;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("a key indexed behind the last sweep is swept");
+	else
+		log_fail("a key indexed behind the last sweep is swept");
+}
+
+TEST_F(NemoKVTest, TestMetrics)
+{
+	log_message("\n========TestMetrics========");
+	string keyPre = "nemo_metrics_";
+	int keyNum = 10;
+	int64_t count;
+	n_->EnableMetrics(true, 1);
+	n_->ResetMetrics();
+	vector<string> keys;
+	for(int k = 0; k < keyNum; k++)
+	{
+		string val;
+		n_->Set(keyPre + itoa(k), "v");
+		n_->Get(keyPre + itoa(k), &val);
+		keys.push_back(keyPre + itoa(k));
+	}
+	//The Dels of MDel are part of it
+	n_->MDel(keys, &count);
+	vector<nemo::CommandMetrics> metrics;
+	n_->GetMetrics(&metrics);
+	n_->EnableMetrics(false);
+
+	bool flag = true;
+	int found = 0;
+	for(size_t i = 0; i < metrics.size(); i++)
+	{
+		const nemo::CommandMetrics &m = metrics[i];
+		if(m.name == "set" || m.name == "get")
+		{
+			found++;
+			flag = flag && m.calls == (uint64_t)keyNum && m.perf_samples == m.calls
+				&& m.p50 <= m.p99 && m.p99 <= m.max;
+		}
+		if(m.name == "get")
+		{
+			flag = flag && m.gets >= (uint64_t)keyNum && m.bytes_read > 0;
+		}
+		if(m.name == "set")
+		{
+			flag = flag && m.bytes_written > 0;
+		}
+		if(m.name == "mdel")
+		{
+			found++;
+			flag = flag && m.calls == 1;
+		}
+		if(m.name == "del")
+		{
+			flag = false;
+		}
+	}
+	flag = flag && found == 3;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("the calls, latencies and reads of the commands are counted");
+	else
+		log_fail("the calls, latencies and reads of the commands are counted");
+}
+
+TEST_F(NemoKVTest, TestOpen)
+{
+	log_message("\n========TestOpen========");
+	nemo::Options options;
+	options.lazy_open = true;
+	nemo::Nemo *n = NULL;
+	s_ = nemo::Nemo::Open("./tmp_open/", options, &n);
+	bool flag = s_.ok() && n != NULL;
+	if(flag)
+	{
+		vector<nemo::DBOpenStats> stats;
+		n->GetOpenStats(&stats);
+		int deferred = 0;
+		for(size_t i = 0; i < stats.size(); i++)
+		{
+			if(stats[i].deferred)
+				deferred++;
+		}
+		flag = stats.size() == 8 && deferred == 2;
+
+		//The first access opens the meta db
+		flag = flag && n->GetMetaHandle() != NULL;
+		n->GetOpenStats(&stats);
+		deferred = 0;
+		for(size_t i = 0; i < stats.size(); i++)
+		{
+			if(stats[i].deferred)
+				deferred++;
+		}
+		flag = flag && deferred == 1;
+		delete n;
+	}
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("the meta and raft dbs are opened at their first access");
+	else
+		log_fail("the meta and raft dbs are opened at their first access");
+
+	//The dbs of ./tmp/ are held by n_, the failure is returned
+	options.lazy_open = false;
+	n = NULL;
+	s_ = nemo::Nemo::Open("./tmp/", options, &n);
+	flag = !s_.ok() && n == NULL;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("a db that fails to open is returned as a Status");
+	else
+		log_fail("a db that fails to open is returned as a Status");
+}
+
+TEST_F(NemoKVTest, TestKeyProfiler)
+{
+	log_message("\n========TestKeyProfiler========");
+	string hotKey = "nemo_profiler_hot";
+	string bigKey = "nemo_profiler_big";
+	int callNum = 500;
+	int fieldNum = 50;
+	int64_t count;
+	int res;
+	n_->EnableKeyProfiler(true, 1);
+	n_->ResetKeyProfile();
+	for(int i = 0; i < callNum; i++)
+	{
+		string val;
+		n_->Set(hotKey, "v");
+		n_->Get(hotKey, &val);
+		n_->Get("nemo_profiler_cold_" + itoa(i), &val);
+	}
+	for(int i = 0; i < fieldNum; i++)
+	{
+		n_->HSet(bigKey, "field_" + itoa(i), "v", &res);
+	}
+	nemo::KeyProfile profile;
+	n_->GetKeyProfile(&profile);
+
+	bool flag = profile.samples >= (uint64_t)callNum * 3 && !profile.hot_keys.empty();
+	flag = flag && profile.hot_keys[0].type == nemo::KV_DB && profile.hot_keys[0].key == hotKey
+		&& profile.hot_keys[0].calls >= (uint64_t)callNum * 2;
+	bool found = false;
+	for(size_t i = 0; i < profile.big_keys.size(); i++)
+	{
+		if(profile.big_keys[i].type == nemo::HASH_DB && profile.big_keys[i].key == bigKey)
+		{
+			found = profile.big_keys[i].len == fieldNum;
+		}
+	}
+	flag = flag && found;
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("the hot keys and the big keys are found");
+	else
+		log_fail("the hot keys and the big keys are found");
+
+	//A deleted key is no longer a big key
+	n_->Del(bigKey, &count);
+	n_->GetKeyProfile(&profile);
+	n_->EnableKeyProfiler(false);
+	flag = true;
+	for(size_t i = 0; i < profile.big_keys.size(); i++)
+	{
+		if(profile.big_keys[i].key == bigKey)
+			flag = false;
+	}
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("the deleted big keys are dropped");
+	else
+		log_fail("the deleted big keys are dropped");
+}
+
+TEST_F(NemoKVTest, TestWriteGroup)
+{
+	log_message("\n========TestWriteGroup========");
+	string keyPre = "nemo_write_group_";
+	int threadNum = 8;
+	int keyNum = 200;
+	nemo::Options options;
+	options.write_group = true;
+	nemo::Nemo *n = new nemo::Nemo(string("./tmp_write_group/"), options);
+
+	vector<std::thread> threads;
+	for(int t = 0; t < threadNum; t++)
+	{
+		threads.push_back(std::thread([n, t, keyNum, keyPre]() {
+			int hres;
+			int64_t res;
+			for(int i = 0; i < keyNum; i++)
+			{
+				string key = keyPre + itoa(t) + "_" + itoa(i);
+				n->Set(key, "v");
+				n->HSet(key, "f", "v", &hres);
+				n->SAdd(key, "m", &res);
+				n->ZAdd(key, i, "m", &res);
+				n->LPush(key, "v", &res);
+			}
+		}));
+	}
+	for(size_t t = 0; t < threads.size(); t++)
+		threads[t].join();
+
+	vector<nemo::WriteFuture> futures;
+	for(int i = 0; i < keyNum; i++)
+		futures.push_back(n->SetAsync(keyPre + "async_" + itoa(i), itoa(i)));
+	bool flag = true;
+	for(size_t i = 0; i < futures.size(); i++)
+		flag = flag && futures[i].Wait().ok() && futures[i].Ready();
+
+	for(int t = 0; t < threadNum; t++)
+	{
+		for(int i = 0; i < keyNum; i++)
+		{
+			string key = keyPre + itoa(t) + "_" + itoa(i);
+			string val, hval;
+			int64_t llen = 0, scard = 0, zcard = 0;
+			flag = flag && n->Get(key, &val).ok() && val == "v"
+				&& n->HGet(key, "f", &hval).ok() && hval == "v"
+				&& n->SCard(key, &scard).ok() && scard == 1
+				&& n->ZCard(key, &zcard).ok() && zcard == 1
+				&& n->LLen(key, &llen).ok() && llen == 1;
+		}
+	}
+	for(int i = 0; i < keyNum; i++)
+	{
+		string val;
+		flag = flag && n->Get(keyPre + "async_" + itoa(i), &val).ok() && val == itoa(i);
+	}
+	//The kv writes which bypass the group land after the SetAsync before them
+	n->SetAsync(keyPre + "incr", "5");
+	string newVal;
+	n->Incrby(keyPre + "incr", 1, newVal);
+	n->SetAsync(keyPre + "del", "v");
+	int64_t delCount = 0;
+	n->Del(keyPre + "del", &delCount);
+	string delVal;
+	flag = flag && newVal == "6" && delCount == 1 && n->Get(keyPre + "del", &delVal).IsNotFound();
+	//Every write went through a group, in fewer groups than writes
+	nemo::WriteGroupStats stats;
+	n->GetWriteGroupStats(&stats);
+	flag = flag && stats.writes == (uint64_t)(threadNum * keyNum * 5 + keyNum + 2)
+		&& stats.groups > 0 && stats.groups <= stats.writes && stats.max_group >= 1;
+	log_message("%llu writes in %llu groups, at most %llu in one", (unsigned long long)stats.writes,
+		(unsigned long long)stats.groups, (unsigned long long)stats.max_group);
+	delete n;
+
+	//A default future is done and OK
+	nemo::WriteFuture done;
+	flag = flag && done.Ready() && done.Wait().ok();
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("the grouped writes from many threads are all written");
+	else
+		log_fail("the grouped writes from many threads are all written");
+
+	//Without write_group the write is done before SetAsync returns
+	nemo::WriteFuture future = n_->SetAsync(keyPre + "nogroup", "v");
+	string val;
+	flag = future.Ready() && future.Wait().ok() && n_->Get(keyPre + "nogroup", &val).ok() && val == "v";
+	EXPECT_TRUE(flag);
+	if(flag)
+		log_success("SetAsync writes at once without write_group");
+	else
+		log_fail("SetAsync writes at once without write_group");
+}
+
 TEST_F(NemoKVTest, TestSetWithExpireAt)
 {
 	string key, val, getVal;
@@ -987,6 +987,46 @@ TEST_F(NemoListTest, TestLInsert)
 		log_fail("Keyڣlistݽṹûpivot");
 }
 
+TEST_F(NemoListTest, TestIndexedOrder)
+{
+	log_message("\n========TestIndexedOrder========");
+	string key, val;
+	int64_t llen, rem_count;
+	vector<nemo::IV> ivs;
+
+	s_.OK();//LInsert and LRem move the elements on either side of the change
+	key = "IndexedOrder_Test";
+	write_list(10, key);
+	n_->LInsert(key, nemo::BEFORE, key + "_1", "head_side", &llen);
+	n_->LInsert(key, nemo::AFTER, key + "_8", "tail_side", &llen);
+	EXPECT_EQ(12, llen);
+	n_->LPush(key, "dup", &llen);
+	n_->RPush(key, "dup", &llen);
+	n_->LInsert(key, nemo::AFTER, key + "_4", "dup", &llen);
+	n_->LRem(key, 0, "dup", &rem_count);
+	EXPECT_EQ(3, rem_count);
+
+	const char *expect[] = {"_0", "head_side", "_1", "_2", "_3", "_4", "_5", "_6", "_7", "_8", "tail_side", "_9"};
+	ivs.clear();
+	s_ = n_->LRange(key, 0, -1, ivs);
+	CHECK_STATUS(OK);
+	ASSERT_EQ(12, (int64_t)ivs.size());
+	bool same = true;
+	for (int64_t i = 0; i != 12; i++)
+	{
+		val = expect[i][0] == '_' ? key + expect[i] : expect[i];
+		EXPECT_EQ(i, ivs[i].index);
+		EXPECT_EQ(val, ivs[i].val);
+		same = same && val == ivs[i].val;
+	}
+	n_->LIndex(key, -2, &val);
+	EXPECT_EQ("tail_side", val);
+	if(s_.ok() && same && val == "tail_side")
+		log_success("LInsert and LRem keep the order");
+	else
+		log_fail("LInsert and LRem keep the order");
+}
+
 TEST_F(NemoListTest, TestLRem)
 {
 	log_message("\n========TestLRem========");
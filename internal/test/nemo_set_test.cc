@@ -184,7 +184,7 @@ TEST_F(NemoSetTest, TestSCard) {
 
 	s_.OK();//ԭkeyڣԭkeyڣĲSetṹ
 	key = GetRandomKey_();
-	card = n_->SCard(key);
+	n_->SCard(key, &card);
 	EXPECT_EQ(0, card);
 	if (0 == card) {
 		log_success("ԭkeyڣԭkeyڣĲSetṹ");
@@ -198,7 +198,7 @@ TEST_F(NemoSetTest, TestSCard) {
 	for(int index = 0; index != num; index++) {
 		n_->SAdd(key, key+"_"+itoa(index), &res);
 	}
-	card = n_->SCard(key);
+	n_->SCard(key, &card);
 	EXPECT_EQ(num, card);
 	if (num == card) {
 		log_success("ԭkeyڣSetݽṹ");
@@ -362,7 +362,8 @@ TEST_F(NemoSetTest, TestSUnionStore) {
 	s_ = n_->SUnionStore(keyDst, keys, &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(40, res);
-	bool flagTemp = n_->SIsMember(keyDst, "0");
+	bool flagTemp;
+	n_->SIsMember(keyDst, "0", &flagTemp);
 	EXPECT_EQ(false, flagTemp);//"SUnionStore_Test_Src3_0"һεkeyDst
 	if (s_.ok() && 40==res && !flagTemp) {
 		log_success("destinationڣSetԪأkeysԪزغ");
@@ -570,7 +571,8 @@ TEST_F(NemoSetTest, TestSInterStore) {
 	s_ = n_->SInterStore(keyDst, keys, &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(20, res);
-	bool flag = n_->SIsMember(keyDst, keyDst+"_0");
+	bool flag;
+	n_->SIsMember(keyDst, keyDst+"_0", &flag);
 	EXPECT_EQ(false, flag);
 	if (s_.ok() && 20 == res && !flag) {
 		log_success("destinationڣkeysΪ2غϵԪ");
@@ -823,7 +825,8 @@ TEST_F(NemoSetTest, TestSDiffStore) {
 	s_ = n_->SDiffStore(keyDst, keys, &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(10, res);
-	bool flag = n_->SIsMember(keyDst, keyDst+"_0");
+	bool flag;
+	n_->SIsMember(keyDst, keyDst+"_0", &flag);
 	EXPECT_EQ(false, flag);
 	if (s_.ok() && 10 == res && !flag) {
 		log_success("destinationڣkeysΪ2غϵԪ");
@@ -957,7 +960,7 @@ TEST_F(NemoSetTest, TestSIsMember) {
 	s_.OK();//key
 	key = GetRandomKey_();
 	member = GetRandomVal_();
-	retBool = n_->SIsMember(key, member);
+	n_->SIsMember(key, member, &retBool);
 	EXPECT_EQ(false, retBool);
 	if (false == retBool) {
 		log_success("key");
@@ -967,7 +970,7 @@ TEST_F(NemoSetTest, TestSIsMember) {
 
 	s_.OK();//keySetݽṹ,Ұmember
 	n_->SAdd(key, member, &res);
-	retBool = n_->SIsMember(key, member);
+	n_->SIsMember(key, member, &retBool);
 	EXPECT_EQ(true, retBool);
 	if (true == retBool) {
 		log_success("keySetݽṹ,Ұmember");
@@ -977,7 +980,7 @@ TEST_F(NemoSetTest, TestSIsMember) {
 
 	s_.OK();//"keySetݽṹmember"
 	member = GetRandomVal_();
-	retBool = n_->SIsMember(key, member);
+	n_->SIsMember(key, member, &retBool);
 	EXPECT_EQ(false, retBool);
 	if (false == retBool) {
 		log_success("keySetݽṹmember");
@@ -986,6 +989,36 @@ TEST_F(NemoSetTest, TestSIsMember) {
 	}
 }
 
+TEST_F(NemoSetTest, TestSMIsMember) {
+	log_message("\n========TestSMIsMember========");
+
+	string key;
+	vector<string> members;
+	vector<bool> isMembers;
+	int64_t res;
+
+	key = GetRandomKey_();
+	for (int i = 0; i < 20; i++) {
+		members.push_back("member_" + to_string(i));
+		if (i % 2 == 0) {
+			n_->SAdd(key, members[i], &res);
+		}
+	}
+	s_ = n_->SMIsMember(key, members, isMembers);
+	CHECK_STATUS(OK);
+	ASSERT_EQ(20U, isMembers.size());
+	bool flag = true;
+	for (int i = 0; i < 20; i++) {
+		flag = flag && isMembers[i] == (i % 2 == 0);
+	}
+	EXPECT_TRUE(flag);
+	if (flag) {
+		log_success("SMIsMember");
+	} else {
+		log_fail("SMIsMember");
+	}
+}
+
 TEST_F(NemoSetTest, TestSPop) {
 	log_message("\n========TestSPop========");
 
@@ -1009,7 +1042,7 @@ TEST_F(NemoSetTest, TestSPop) {
 	nemo::SIterator* siter = n_->SScan(key, -1);
   for (; siter->Valid(); siter->Next()) {
 	//while (siter->Next()) {
-		n_->SRem(key, siter->member(), &resTemp);
+		n_->SRem(key, siter->member().ToString(), &resTemp);
 	}
 	delete siter;
 	member = GetRandomVal_();
@@ -1036,7 +1069,7 @@ TEST_F(NemoSetTest, TestSPop) {
 		}
 		num--;
 	}
-	card = n_->SCard(key);
+	n_->SCard(key, &card);
 	EXPECT_EQ(true, flag);
 	EXPECT_EQ(0, card);
 	if (flag && 0 == card) {
@@ -1186,8 +1219,8 @@ TEST_F(NemoSetTest, TestSMove) {
 	s_ = n_->SMove(keySrc, keyDst, member, &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(1, res);
-	cardSrc = n_->SCard(keySrc);
-	cardDst = n_->SCard(keyDst);
+	n_->SCard(keySrc, &cardSrc);
+	n_->SCard(keyDst, &cardDst);
 	EXPECT_EQ(0, cardSrc);
 	EXPECT_EQ(1, cardDst);
 	if (s_.ok() && res==1 && 0==cardSrc && 1==cardDst) {
@@ -1208,8 +1241,8 @@ TEST_F(NemoSetTest, TestSMove) {
 	s_ = n_->SMove(keySrc, keyDst, itoa(GetRandomUint_(0, 9)), &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(1, res);
-	cardSrc = n_->SCard(keySrc);
-	cardDst = n_->SCard(keyDst);
+	n_->SCard(keySrc, &cardSrc);
+	n_->SCard(keyDst, &cardDst);
 	EXPECT_EQ(9, cardSrc);
 	EXPECT_EQ(11, cardDst);
 	if (s_.ok() && res==1 && 9==cardSrc&& 11==cardDst) {
@@ -1228,8 +1261,8 @@ TEST_F(NemoSetTest, TestSMove) {
 	s_ = n_->SMove(keySrc, keyDst, itoa(GetRandomUint_(numStart, numEnd-1)), &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(1, res);
-	cardSrc = n_->SCard(keySrc);
-	cardDst = n_->SCard(keyDst);
+	n_->SCard(keySrc, &cardSrc);
+	n_->SCard(keyDst, &cardDst);
 	EXPECT_EQ(9, cardSrc);
 	EXPECT_EQ(10, cardDst);
 	if (s_.ok() && res==1 && 9 == cardSrc && 10 == cardDst) {
@@ -5,6 +5,7 @@
 #include <cstdlib>
 #include <string>
 #include <cmath>
+#include <algorithm>
 
 #include "gtest/gtest.h"
 #include "xdebug.h"
@@ -106,7 +107,7 @@ TEST_F(NemoZSetTest, TestZCard) {
 	s_.OK();//ԭkey
 	key = GetRandomKey_();
 	n_->ZRemrangebyscore(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, &resTemp);
-	card = n_->ZCard(key);
+	n_->ZCard(key, &card);
 	EXPECT_EQ(0, card);
 	if (card == 0) {
 		log_success("ԭkey");
@@ -118,7 +119,7 @@ TEST_F(NemoZSetTest, TestZCard) {
 	key = "ZCardTest";
 	int64_t num = 10;
 	write_zset_random_score(key, num);
-	card = n_->ZCard(key);
+	n_->ZCard(key, &card);
 	EXPECT_EQ(num, card);
 	if (card == num) {
 		log_success("ԭkey");
@@ -136,7 +137,7 @@ TEST_F(NemoZSetTest, TestZCount) {
 
 	s_.OK();//key/keyڣûzsetṹ
 	key = GetRandomKey_();
-	count = n_->ZCount(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX);
+	n_->ZCount(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, &count);
 	EXPECT_EQ(0, count);
 	if (count == 0) {
 		log_success("key/keyڣûzsetṹ");
@@ -150,7 +151,7 @@ TEST_F(NemoZSetTest, TestZCount) {
 	write_zset_up_score(key, 20);
 	begin = GetRandomFloat_(0, num-2);
 	end = GetRandomFloat_(ceil(begin), num-1);
-	count = n_->ZCount(key, begin, end);
+	n_->ZCount(key, begin, end, &count);
 	EXPECT_EQ(floor(end)-ceil(begin)+1, count);
 	if (floor(end)-ceil(begin)+1 == count) {
 		log_success("floor(end)-ceil(begin)+1, count");
@@ -161,7 +162,7 @@ TEST_F(NemoZSetTest, TestZCount) {
 	s_.OK();//keyڣҴzsetṹbegin>end
 	begin = GetRandomFloat_(1, num-2);
 	end = GetRandomFloat_(0, begin-1);
-	count = n_->ZCount(key, begin, end);
+	n_->ZCount(key, begin, end, &count);
 	EXPECT_EQ(0, count);
 	if (count == 0) {
 		log_success("keyڣҴzsetṹbegin>end");
@@ -179,7 +180,7 @@ TEST_F(NemoZSetTest, TestZCount) {
 	n_->ZAdd(key, score, member, &res);
 	begin = 3.00001;
 	end = ZSET_SCORE_MAX;
-	count = n_->ZCount(key, begin, end, true);
+	n_->ZCount(key, begin, end, &count, true);
 	EXPECT_EQ(1, count);
 	if (count == 1) {
 		log_success("keyڣҴzsetṹbegin<end;is_lo=trueǷ");
@@ -190,7 +191,7 @@ TEST_F(NemoZSetTest, TestZCount) {
 	s_.OK();//keyڣҴzsetṹbegin<end;is_ro=trueǷ
 	begin = ZSET_SCORE_MIN;
 	end = 3.00003;
-	count = n_->ZCount(key, begin, end, false, true);
+	n_->ZCount(key, begin, end, &count, false, true);
 	EXPECT_EQ(1, count);
 	if (1 == count) {
 		log_success("keyڣҴzsetṹbegin<end;is_ro=trueǷ");
@@ -452,7 +453,7 @@ TEST_F(NemoZSetTest, TestZUnionStore) {
 	s_ = n_->ZUnionStore(destination, num_keys, keys, weights, agg, &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(0, res);
-	zcard = n_->ZCard(destination);
+	n_->ZCard(destination, &zcard);
 	EXPECT_EQ(0, zcard);
 	if (s_.ok() && res == 0 && zcard == 0) {
 		log_success("destinationڣnumkeys=1keysΪkeyweightsĬϣagg=sum");
@@ -471,7 +472,7 @@ TEST_F(NemoZSetTest, TestZUnionStore) {
 	s_ = n_->ZUnionStore(destination, num_keys, keys, weights, agg, &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(0, res);
-	zcard = n_->ZCard(destination);
+	n_->ZCard(destination, &zcard);
 	EXPECT_EQ(0, zcard);
 	if (s_.ok() && res == 0 && zcard == 0) {
 		log_success("destinationڣnumkeys=0keysΪkeyweightsĬϣagg=sum");
@@ -485,7 +486,7 @@ TEST_F(NemoZSetTest, TestZUnionStore) {
 	s_ = n_->ZUnionStore(destination, num_keys, keys, weights, agg, &res);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(10, res);
-	zcard = n_->ZCard(destination);
+	n_->ZCard(destination, &zcard);
 	EXPECT_EQ(10, zcard);
 	if(s_.ok() && res == 10 && zcard == 10) {
 		log_success("destinationڣnumkeys=1keysΪkeyweightsĬϣagg=sum");
@@ -500,7 +501,7 @@ TEST_F(NemoZSetTest, TestZUnionStore) {
 	res = 0;
 	s_ = n_->ZUnionStore(destination, num_keys, keys, weights, agg, &res);
 	CHECK_STATUS(OK);
-	zcard = n_->ZCard(destination);
+	n_->ZCard(destination, &zcard);
 	EXPECT_EQ(10, zcard);
 	if (s_.ok() && res == 0 && zcard == 0) {
 		log_success("destinationڣnumkeys>1keysΪkeyweightsĬϣagg=sum");
@@ -810,6 +811,61 @@ TEST_F(NemoZSetTest, TestZInterStore) {
 	}
 }
 
+TEST_F(NemoZSetTest, TestZStoreIntoSource) {
+	log_message("\n========TestZStoreIntoSource========");
+	string key1, key2;
+	int64_t res, rank, zcard, num;
+	vector<string> keys;
+	vector<double> weights;
+	vector<pair<double, string> > expect;
+	vector<nemo::SM> sms;
+
+	s_.OK();//destination among the sources, old members replaced and ranks right
+	key1 = "ZStoreIntoSource_Test1";
+	key2 = "ZStoreIntoSource_Test2";
+	n_->ZRemrangebyscore(key1, ZSET_SCORE_MIN, ZSET_SCORE_MAX, &res);
+	n_->ZRemrangebyscore(key2, ZSET_SCORE_MIN, ZSET_SCORE_MAX, &res);
+	for (int64_t index = 0; index != 2500; index++) {
+		if (index < 1500) {
+			sms.push_back({(double)index, itoa(index)});
+		}
+		if (index >= 1000) {
+			n_->ZAdd(key2, index, itoa(index), &res);
+		}
+		expect.push_back(make_pair((index >= 1000 && index < 1500) ? 2.0 * index : index, itoa(index)));
+	}
+	n_->ZMAdd(key1, sms, &res);
+	sort(expect.begin(), expect.end());
+	keys.push_back(key1);
+	keys.push_back(key2);
+	s_ = n_->ZUnionStore(key1, 2, keys, weights, SUM, &res);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(2500, res);
+	n_->ZCard(key1, &zcard);
+	EXPECT_EQ(2500, zcard);
+
+	num = expect.size();
+	bool same = true;
+	for (int64_t pos = 0; pos < num; pos += 37) {
+		n_->ZRank(key1, expect[pos].second, &rank);
+		EXPECT_EQ(pos, rank);
+		same = same && pos == rank;
+	}
+	s_ = n_->ChecknRecover(nemo::kZSET_DB, key1);
+	CHECK_STATUS(OK);
+
+	s_ = n_->ZInterStore(key2, 2, keys, weights, MAX, &res);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(1500, res);
+	n_->ZCard(key2, &zcard);
+	EXPECT_EQ(1500, zcard);
+	if (s_.ok() && same && res == 1500 && zcard == 1500) {
+		log_success("destination among the sources, old members replaced and ranks right");
+	} else {
+		log_fail("destination among the sources, old members replaced and ranks right");
+	}
+}
+
 TEST_F(NemoZSetTest, TestZRangebyscore) {
 	log_message("\n========TestZRangebyscore========");
 	string key;
@@ -1010,6 +1066,64 @@ TEST_F(NemoZSetTest, TestZRevrank) {
 	}
 }
 
+TEST_F(NemoZSetTest, TestRankIndex) {
+	log_message("\n========TestRankIndex========");
+	string key;
+	int64_t res, rank, count, num;
+	vector<pair<double, string> > expect;
+	vector<nemo::SM> sms;
+
+	s_.OK();//ranks stay right across block splits, ties, removals and moves
+	key = "RankIndex_Test";
+	num = 2000;
+	n_->ZRemrangebyscore(key, ZSET_SCORE_MIN, ZSET_SCORE_MAX, &res);
+	for (int64_t index = 0; index != num; index++) {
+		double score = (index * 7919) % 300;
+		expect.push_back(make_pair(score, itoa(index)));
+		sms.push_back({score, itoa(index)});
+		if (sms.size() == 500) {
+			n_->ZMAdd(key, sms, &res);
+			sms.clear();
+		}
+	}
+	sort(expect.begin(), expect.end());
+	s_ = n_->ZRemrangebyrank(key, 100, 899, &count);
+	CHECK_STATUS(OK);
+	EXPECT_EQ(800, count);
+	expect.erase(expect.begin() + 100, expect.begin() + 900);
+	string moved = expect[5].second;
+	string new_score;
+	n_->ZIncrby(key, moved, 1000, new_score);
+	expect.erase(expect.begin() + 5);
+	expect.push_back(make_pair(1000.0, moved));
+	num = expect.size();
+
+	bool same = true;
+	for (int64_t pos = 0; pos < num; pos += 37) {
+		n_->ZRank(key, expect[pos].second, &rank);
+		EXPECT_EQ(pos, rank);
+		same = same && pos == rank;
+		n_->ZRevrank(key, expect[pos].second, &rank);
+		EXPECT_EQ(num - 1 - pos, rank);
+		same = same && num - 1 - pos == rank;
+	}
+	sms.clear();
+	s_ = n_->ZRange(key, 600, 609, sms);
+	CHECK_STATUS(OK);
+	ASSERT_EQ(10, (int64_t)sms.size());
+	for (int64_t i = 0; i != 10; i++) {
+		EXPECT_EQ(expect[600 + i].second, sms[i].member);
+		same = same && expect[600 + i].second == sms[i].member;
+	}
+	s_ = n_->ChecknRecover(nemo::kZSET_DB, key);
+	CHECK_STATUS(OK);
+	if (s_.ok() && same) {
+		log_success("ranks stay right across block splits, ties, removals and moves");
+	} else {
+		log_fail("ranks stay right across block splits, ties, removals and moves");
+	}
+}
+
 TEST_F(NemoZSetTest, TestZScore) {
 	log_message("\n========TestZScore========");
 	string key, member;
@@ -1067,6 +1181,40 @@ TEST_F(NemoZSetTest, TestZScore) {
 	}
 }
 
+TEST_F(NemoZSetTest, TestZMScore) {
+	log_message("\n========TestZMScore========");
+	string key;
+	vector<string> members;
+	vector<double> scores;
+	vector<nemo::Status> statuses;
+	int64_t res;
+
+	key = GetRandomKey_();
+	for (int i = 0; i < 20; i++) {
+		members.push_back("member_" + to_string(i));
+		if (i % 2 == 0) {
+			n_->ZAdd(key, i * 1.5, members[i], &res);
+		}
+	}
+	s_ = n_->ZMScore(key, members, scores, statuses);
+	CHECK_STATUS(OK);
+	ASSERT_EQ(20U, scores.size());
+	bool flag = true;
+	for (int i = 0; i < 20; i++) {
+		if (i % 2 == 0) {
+			flag = flag && statuses[i].ok() && fabs(scores[i] - i * 1.5) < eps;
+		} else {
+			flag = flag && statuses[i].IsNotFound();
+		}
+	}
+	EXPECT_TRUE(flag);
+	if (flag) {
+		log_success("ZMScore");
+	} else {
+		log_fail("ZMScore");
+	}
+}
+
 TEST_F(NemoZSetTest, TestZRangelex) {
 	log_message("\n========TestZRangelex========");
 	string key, member, min, max;
@@ -1079,7 +1227,7 @@ TEST_F(NemoZSetTest, TestZRangelex) {
 	min = "";
 	max = "";
 	members.clear();
-	s_ = n_->ZRangebylex(key, min, max, members);
+	s_ = n_->ZRangebylex(key, min, max, members, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_TRUE(member.empty());
 	if (s_.ok() && members.empty()) {
@@ -1096,7 +1244,7 @@ TEST_F(NemoZSetTest, TestZRangelex) {
 	min = "a";
 	max = "z";
 	members.clear();
-	s_ = n_->ZRangebylex(key, min, max, members);
+	s_ = n_->ZRangebylex(key, min, max, members, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_TRUE(members.empty());
 	if (s_.ok() && members.empty()) {
@@ -1109,7 +1257,7 @@ TEST_F(NemoZSetTest, TestZRangelex) {
 	minInt = GetRandomUint_(0, num-2);
 	maxInt = GetRandomUint_(minInt+1, num-1);
 	members.clear();
-	s_ = n_->ZRangebylex(key, itoa(minInt), itoa(maxInt), members);
+	s_ = n_->ZRangebylex(key, itoa(minInt), itoa(maxInt), members, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(maxInt-minInt+1, members.size());
 	if (s_.ok() && maxInt-minInt+1==members.size()) {
@@ -1122,7 +1270,7 @@ TEST_F(NemoZSetTest, TestZRangelex) {
 	min = "";
 	max = "";
 	members.clear();
-	s_ = n_->ZRangebylex(key, min, max, members);
+	s_ = n_->ZRangebylex(key, min, max, members, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(num, members.size());
 	if (s_.ok() && num == members.size()) {
@@ -1150,7 +1298,7 @@ TEST_F(NemoZSetTest, TestZRangelex) {
 	max = "";
 	write_zset_same_score(key, num);
 	members.clear();
-	s_ = n_->ZRangebylex(key, min, max, members);
+	s_ = n_->ZRangebylex(key, min, max, members, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(num, members.size());
 	EXPECT_TRUE(isSorted(members));
@@ -1171,7 +1319,7 @@ TEST_F(NemoZSetTest, TestZLexcount) {
 	min = "";
 	max = "";
 	count = -1;
-	s_ = n_->ZLexcount(key, min, max, &count);
+	s_ = n_->ZLexcount(key, min, max, &count, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(0, count);
 	if (s_.ok() && 0 == count) {
@@ -1191,7 +1339,7 @@ TEST_F(NemoZSetTest, TestZLexcount) {
 	min = itoa(minInt + numPre);
 	max = itoa(maxInt + numPre);
 	count = -1;
-	s_ = n_->ZLexcount(key, min, max, &count);
+	s_ = n_->ZLexcount(key, min, max, &count, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(0, count);
 	if (s_.ok() && count == 0) {
@@ -1206,7 +1354,7 @@ TEST_F(NemoZSetTest, TestZLexcount) {
 	min = itoa(minInt + numPre);
 	max = itoa(maxInt + numPre);
 	count = -1;
-	s_ = n_->ZLexcount(key, min, max, &count);
+	s_ = n_->ZLexcount(key, min, max, &count, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(maxInt-minInt+1, count);
 	if (s_.ok() && count == maxInt-minInt+1) {
@@ -1219,7 +1367,7 @@ TEST_F(NemoZSetTest, TestZLexcount) {
 	min = "";
 	max = "";
 	count = -1;
-	s_ = n_->ZLexcount(key, min, max, &count);
+	s_ = n_->ZLexcount(key, min, max, &count, false, false);
 	CHECK_STATUS(OK);
 	EXPECT_EQ(num, count);
 	if (s_.ok() && count == num) {
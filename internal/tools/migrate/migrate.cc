@@ -0,0 +1,152 @@
+#include <iostream>
+#include <assert.h>
+#include <stdio.h>
+#include "xdebug.h"
+#include <string>
+#include <vector>
+#include "nemo.h"
+#include "nemo_const.h"
+
+#include "rocksdb/db.h"
+
+using namespace std;
+
+// Copies the raw keys and values, with their version and timestamp, of
+// the per type dbs under db_path into the column families of db_path/cf.
+// The old dbs are moved to db_path/premigrate once the copy is flushed.
+
+const size_t kBatchBytes = 4 * 1024 * 1024;
+const string kBackupDir = "premigrate";
+
+void Usage() {
+  cout << "Usage: " << endl;
+  cout << "./migrate db_path" << endl;
+  cout << "convert db_path from one db per type to the column family layout" << endl;
+}
+
+rocksdb::Status CopyDB(const string &src_path, rocksdb::DB *dst, rocksdb::ColumnFamilyHandle *cf, uint64_t *count) {
+  rocksdb::Options options;
+  rocksdb::DB *src;
+  rocksdb::Status s = rocksdb::DB::OpenForReadOnly(options, src_path, &src);
+  if (!s.ok()) {
+    return s;
+  }
+
+  rocksdb::ReadOptions read_options;
+  read_options.fill_cache = false;
+  rocksdb::WriteOptions write_options;
+  write_options.disableWAL = true;
+
+  rocksdb::WriteBatch batch;
+  rocksdb::Iterator *it = src->NewIterator(read_options);
+  for (it->SeekToFirst(); s.ok() && it->Valid(); it->Next()) {
+    batch.Put(cf, it->key(), it->value());
+    (*count)++;
+    if (batch.GetDataSize() >= kBatchBytes) {
+      s = dst->Write(write_options, &batch);
+      batch.Clear();
+    }
+  }
+  if (s.ok()) {
+    s = it->status();
+  }
+  if (s.ok() && batch.Count() > 0) {
+    s = dst->Write(write_options, &batch);
+  }
+  delete it;
+  delete src;
+  return s;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 2) {
+    Usage();
+    log_err("not enough parameter");
+  }
+  std::string path(argv[1]);
+  if (path[path.length() - 1] != '/') {
+    path.append("/");
+  }
+
+  const string types[] = {nemo::KV_DB, nemo::HASH_DB, nemo::LIST_DB, nemo::ZSET_DB,
+    nemo::SET_DB, nemo::META_DB, nemo::RAFT_DB, nemo::EXPIRE_DB};
+  const int type_num = sizeof(types) / sizeof(types[0]);
+  vector<bool> present(type_num, true);
+
+  if (nemo::is_dir((path + nemo::CF_LAYOUT_DB + "/CURRENT").c_str()) == 1) {
+    log_err("%s is already in the column family layout", path.c_str());
+  }
+  for (int i = 0; i < type_num; i++) {
+    if (nemo::is_dir((path + types[i] + "/CURRENT").c_str()) != 1) {
+      // the data dirs of before the expire index have none
+      if (types[i] == nemo::EXPIRE_DB) {
+        present[i] = false;
+        continue;
+      }
+      log_err("%s%s is not a db", path.c_str(), types[i].c_str());
+    }
+  }
+
+  // Same column families as Nemo::OpenColumnFamilies, kv in the default one
+  rocksdb::DBOptions db_options;
+  db_options.create_if_missing = true;
+  db_options.create_missing_column_families = true;
+  rocksdb::ColumnFamilyOptions cf_options;
+  cf_options.disable_auto_compactions = true;
+  std::vector<rocksdb::ColumnFamilyDescriptor> column_families;
+  column_families.push_back(rocksdb::ColumnFamilyDescriptor(rocksdb::kDefaultColumnFamilyName, cf_options));
+  for (int i = 1; i < type_num; i++) {
+    column_families.push_back(rocksdb::ColumnFamilyDescriptor(types[i], cf_options));
+  }
+
+  log_info("Prepare DB...");
+  std::vector<rocksdb::ColumnFamilyHandle*> handles;
+  rocksdb::DB *dst;
+  rocksdb::Status s = rocksdb::DB::Open(db_options, path + nemo::CF_LAYOUT_DB, column_families, &handles, &dst);
+  if (!s.ok()) {
+    log_err("open %s%s failed : %s", path.c_str(), nemo::CF_LAYOUT_DB.c_str(), s.ToString().c_str());
+  }
+
+  for (int i = 0; s.ok() && i < type_num; i++) {
+    if (!present[i]) {
+      continue;
+    }
+    uint64_t count = 0;
+    log_info("Migrate %s Begin", types[i].c_str());
+    s = CopyDB(path + types[i], dst, handles[i], &count);
+    if (s.ok()) {
+      // the copy skipped the WAL
+      s = dst->Flush(rocksdb::FlushOptions(), handles[i]);
+    }
+    if (s.ok()) {
+      log_info("Migrate %s Finished, %lu keys", types[i].c_str(), count);
+    }
+  }
+
+  for (auto handle : handles) {
+    delete handle;
+  }
+  delete dst;
+
+  if (!s.ok()) {
+    nemo::delete_dir((path + nemo::CF_LAYOUT_DB).c_str());
+    log_err("Migrate Failed : %s", s.ToString().c_str());
+  }
+
+  // Nemo refuses to open a data dir with both layouts
+  nemo::mkpath((path + kBackupDir).c_str(), 0755);
+  for (int i = 0; i < type_num; i++) {
+    if (!present[i]) {
+      continue;
+    }
+    string from = path + types[i];
+    string to = path + kBackupDir + "/" + types[i];
+    if (rename(from.c_str(), to.c_str()) != 0) {
+      log_err("move %s to %s failed", from.c_str(), to.c_str());
+    }
+  }
+  log_info("Migrate Finished, the old dbs are in %s%s, open with column_family_layout",
+      path.c_str(), kBackupDir.c_str());
+  return 0;
+}
@@ -0,0 +1,592 @@
+#include <iostream>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <sys/time.h>
+#include "xdebug.h"
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <thread>
+#include <random>
+#include <algorithm>
+#include "nemo.h"
+#include "nemo_volume_iterator.h"
+
+using namespace std;
+
+// YCSB style workloads over the commands of each type and the admin scans
+// and deletes. Every workload runs threads clients for ops operations each,
+// after warmup operations each that are not measured, and reports the
+// throughput and the p50/p99/p999 latencies of its reads and writes, as text
+// or as one json object per workload.
+
+void Usage() {
+  cout << "Usage: " << endl;
+  cout << "./nemo_bench [--name=value]..." << endl;
+  cout << "  --db=./nemo_bench_db/      db path" << endl;
+  cout << "  --workloads=kv             comma separated, of kv, hash, list, zset, set, bitmap, hll," << endl;
+  cout << "                             scan, volume, rangedel, rawscan" << endl;
+  cout << "  --threads=8                clients of the type workloads, the admin ones run one" << endl;
+  cout << "  --ops=100000               operations per client" << endl;
+  cout << "  --warmup=10000             operations per client before measuring" << endl;
+  cout << "  --keys=100000              keys per type loaded and picked from" << endl;
+  cout << "  --fields=16                fields, members or bits per collection key" << endl;
+  cout << "  --load=1                   load the keys first" << endl;
+  cout << "  --dist=zipfian             uniform, zipfian or latest, where writes insert new keys" << endl;
+  cout << "  --zipf=0.99                zipfian constant" << endl;
+  cout << "  --read=0.5                 ratio of reads" << endl;
+  cout << "  --ttl_ratio=0              ratio of writes giving the key a ttl" << endl;
+  cout << "  --ttl=3600                 seconds" << endl;
+  cout << "  --value_size=100           bytes" << endl;
+  cout << "  --value_dist=fixed         fixed, or uniform in [1, 2 * value_size]" << endl;
+  cout << "  --range=1000               keys per scan, volume, rangedel or rawscan operation" << endl;
+  cout << "  --format=text              text or json" << endl;
+  cout << "Example: " << endl;
+  cout << "./nemo_bench --workloads=kv,hash,zset --dist=zipfian --read=0.95 --format=json" << endl;
+}
+
+struct BenchOptions {
+  string db;
+  vector<string> workloads;
+  int threads;
+  int64_t ops;
+  int64_t warmup;
+  int64_t keys;
+  int64_t fields;
+  bool load;
+  string dist;
+  double zipf;
+  double read;
+  double ttl_ratio;
+  int ttl;
+  int value_size;
+  string value_dist;
+  int64_t range;
+  string format;
+
+  BenchOptions() : db("./nemo_bench_db/"), threads(8), ops(100000), warmup(10000),
+                   keys(100000), fields(16), load(true), dist("zipfian"), zipf(0.99),
+                   read(0.5), ttl_ratio(0), ttl(3600), value_size(100),
+                   value_dist("fixed"), range(1000), format("text") {
+    workloads.push_back("kv");
+  }
+};
+
+inline int64_t NowMicros() {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return static_cast<uint64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+// Zipfian ranks of [0, n), rank 0 the most popular, as the YCSB generator
+// of Gray et al. "Quickly generating billion-record synthetic databases"
+class Zipfian {
+public:
+  Zipfian(uint64_t n, double theta) : n_(n), theta_(theta) {
+    zetan_ = Zeta(n, theta);
+    alpha_ = 1.0 / (1.0 - theta);
+    eta_ = (1 - pow(2.0 / n, 1 - theta)) / (1 - Zeta(2, theta) / zetan_);
+  }
+
+  uint64_t Next(double u) const {
+    double uz = u * zetan_;
+    if (uz < 1.0) {
+      return 0;
+    }
+    if (uz < 1.0 + pow(0.5, theta_)) {
+      return 1;
+    }
+    uint64_t rank = static_cast<uint64_t>(n_ * pow(eta_ * u - eta_ + 1, alpha_));
+    return rank < n_ ? rank : n_ - 1;
+  }
+
+private:
+  static double Zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for (uint64_t i = 1; i <= n; i++) {
+      sum += 1.0 / pow(i, theta);
+    }
+    return sum;
+  }
+
+  uint64_t n_;
+  double theta_;
+  double zetan_;
+  double alpha_;
+  double eta_;
+};
+
+// FNV-1a of the rank, so that the popular keys of zipfian are spread over
+// the key space instead of packed at its start, as the YCSB scrambled one
+inline uint64_t Scramble(uint64_t rank) {
+  uint64_t hash = 14695981039346656037ULL;
+  for (int i = 0; i < 8; i++) {
+    hash ^= (rank >> (i * 8)) & 0xff;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+inline string Key(const string &workload, uint64_t index) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%012" PRIu64, index);
+  return "nb_" + workload + "_" + buf;
+}
+
+// The key space of a workload, the keys loaded and those inserted since by
+// latest
+class KeyChooser {
+public:
+  KeyChooser(const BenchOptions &options)
+    : dist_(options.dist),
+      zipfian_(options.keys > 1 ? options.keys : 2, options.zipf),
+      keys_(options.keys),
+      inserted_(options.keys) {
+  }
+
+  uint64_t Next(double u) {
+    if (dist_ == "uniform") {
+      return static_cast<uint64_t>(u * keys_) % keys_;
+    }
+    uint64_t rank = zipfian_.Next(u);
+    if (dist_ == "latest") {
+      uint64_t last = inserted_.load(std::memory_order_relaxed) - 1;
+      return rank <= last ? last - rank : 0;
+    }
+    return Scramble(rank) % keys_;
+  }
+
+  // The index of a write, a new key for latest
+  uint64_t NextWrite(double u) {
+    if (dist_ == "latest") {
+      return inserted_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return Next(u);
+  }
+
+private:
+  string dist_;
+  Zipfian zipfian_;
+  uint64_t keys_;
+  std::atomic<uint64_t> inserted_;
+};
+
+struct Client {
+  std::mt19937_64 rng;
+  std::uniform_real_distribution<double> uniform;
+  vector<int64_t> read_used;
+  vector<int64_t> write_used;
+  int64_t errors;
+
+  Client(int seed) : rng(seed), uniform(0.0, 1.0), errors(0) {}
+  double Next() { return uniform(rng); }
+};
+
+class Bench {
+public:
+  Bench(nemo::Nemo *n, const BenchOptions &options) : n_(n), options_(options) {
+    std::mt19937_64 rng(301);
+    int max_size = options.value_dist == "uniform" ? options.value_size * 2 : options.value_size;
+    values_.resize(max_size > 0 ? max_size : 1);
+    for (size_t i = 0; i < values_.size(); i++) {
+      values_[i] = 'a' + rng() % 26;
+    }
+  }
+
+  int Run(const string &workload);
+
+private:
+  bool Admin(const string &workload) const {
+    return workload == "scan" || workload == "volume" || workload == "rangedel" || workload == "rawscan";
+  }
+  // The keys the workload runs on, the admin ones on the kv and hash keys
+  string KeyWorkload(const string &workload) const {
+    return Admin(workload) ? "kv" : workload;
+  }
+
+  rocksdb::Slice Value(Client *c) const {
+    size_t size = options_.value_size;
+    if (options_.value_dist == "uniform") {
+      size = 1 + static_cast<size_t>(c->Next() * (values_.size() - 1));
+    }
+    return rocksdb::Slice(values_.data(), size);
+  }
+
+  void Load(const string &workload);
+  void Write(const string &workload, Client *c, uint64_t index, uint64_t member, bool with_ttl, nemo::Status *s);
+  void Read(const string &workload, Client *c, uint64_t index, nemo::Status *s);
+  void AdminOp(const string &workload, Client *c, int64_t op, nemo::Status *s);
+  void Worker(const string &workload, Client *c, int64_t ops, KeyChooser *chooser);
+  void Report(const string &workload, int threads, int64_t micros, vector<Client *> &clients);
+
+  nemo::Nemo *n_;
+  BenchOptions options_;
+  string values_;
+};
+
+void Bench::Load(const string &workload) {
+  int64_t st = NowMicros();
+  Client c(0);
+  nemo::Status s, first;
+  int64_t errors = 0;
+  for (int64_t i = 0; i < options_.keys; i++) {
+    int64_t members = workload == "kv" ? 1 : options_.fields;
+    for (int64_t f = 0; f < members; f++) {
+      Write(workload, &c, i, f, false, &s);
+      if (!s.ok() && errors++ == 0) {
+        first = s;
+      }
+    }
+    if (workload == "kv" && i % 8 == 0) {
+      // and a few hashes for the admin workloads to scan
+      int res;
+      s = n_->HSet(Key("kv", i), "f", Value(&c), &res);
+      if (!s.ok() && errors++ == 0) {
+        first = s;
+      }
+    }
+  }
+  // on stderr, apart from the report
+  fprintf(stderr, "loaded %" PRId64 " %s keys in %.2f s, errors %" PRId64 "%s%s\n", options_.keys,
+          workload.c_str(), (NowMicros() - st) / 1000000.0, errors,
+          errors > 0 ? ", first " : "", errors > 0 ? first.ToString().c_str() : "");
+}
+
+// member is the field, member or bit, with_ttl then gives the key a ttl
+void Bench::Write(const string &workload, Client *c, uint64_t index, uint64_t member, bool with_ttl,
+                  nemo::Status *s) {
+  string key = Key(workload, index);
+  int64_t res;
+  if (workload == "kv") {
+    *s = n_->Set(key, Value(c), with_ttl ? options_.ttl : 0);
+    return;
+  } else if (workload == "hash") {
+    int hres;
+    *s = n_->HSet(key, to_string(member), Value(c), &hres);
+  } else if (workload == "list") {
+    // push and pop, to keep the length at the fields loaded
+    *s = n_->RPush(key, Value(c).ToString(), &res);
+    if (s->ok() && res > options_.fields) {
+      string val;
+      *s = n_->LPop(key, &val);
+    }
+  } else if (workload == "zset") {
+    *s = n_->ZAdd(key, c->Next() * options_.keys, to_string(member), &res);
+  } else if (workload == "set") {
+    *s = n_->SAdd(key, to_string(member), &res);
+  } else if (workload == "bitmap") {
+    *s = n_->BitSet(key, member * 8 + c->Next() * 8, c->Next() < 0.5, &res);
+  } else if (workload == "hll") {
+    bool update;
+    vector<string> values(1, to_string(static_cast<uint64_t>(c->Next() * options_.keys)));
+    *s = n_->PfAdd(key, values, update);
+  }
+  if (s->ok() && with_ttl) {
+    *s = n_->Expire(key, options_.ttl, &res);
+  }
+}
+
+void Bench::Read(const string &workload, Client *c, uint64_t index, nemo::Status *s) {
+  string key = Key(workload, index);
+  string member = to_string(static_cast<uint64_t>(c->Next() * options_.fields));
+  string val;
+  if (workload == "kv") {
+    *s = n_->Get(key, &val);
+  } else if (workload == "hash") {
+    *s = n_->HGet(key, member, &val);
+  } else if (workload == "list") {
+    if (c->Next() < 0.5) {
+      *s = n_->LIndex(key, static_cast<int64_t>(c->Next() * options_.fields), &val);
+    } else {
+      vector<nemo::IV> ivs;
+      *s = n_->LRange(key, 0, 9, ivs);
+    }
+  } else if (workload == "zset") {
+    if (c->Next() < 0.5) {
+      double score;
+      *s = n_->ZScore(key, member, &score);
+    } else {
+      vector<nemo::SM> sms;
+      *s = n_->ZRange(key, 0, 9, sms);
+    }
+  } else if (workload == "set") {
+    bool is_member;
+    *s = n_->SIsMember(key, member, &is_member);
+  } else if (workload == "bitmap") {
+    int64_t res;
+    if (c->Next() < 0.9) {
+      *s = n_->BitGet(key, static_cast<int64_t>(c->Next() * options_.fields * 8), &res);
+    } else {
+      *s = n_->BitCount(key, &res);
+    }
+  } else if (workload == "hll") {
+    int result;
+    vector<string> keys(1, key);
+    *s = n_->PfCount(keys, result);
+  }
+}
+
+// Each one over range keys from a random one
+void Bench::AdminOp(const string &workload, Client *c, int64_t op, nemo::Status *s) {
+  uint64_t first = static_cast<uint64_t>(c->Next() * options_.keys);
+  string start = Key("kv", first);
+  string end = Key("kv", first + options_.range);
+  if (workload == "scan") {
+    string cursor = "0";
+    string next;
+    string pattern = "nb_kv_*";
+    vector<string> keys;
+    int64_t scanned = 0;
+    do {
+      keys.clear();
+      *s = n_->Scan(cursor, pattern, 100, keys, &next);
+      scanned += 100;
+      cursor = next;
+    } while (s->ok() && cursor != "0" && scanned < options_.range);
+  } else if (workload == "volume") {
+    nemo::VolumeIterator it(n_, start, end, options_.range, false);
+    while (it.Valid()) {
+      it.Next();
+    }
+    *s = nemo::Status::OK();
+  } else if (workload == "rangedel") {
+    *s = n_->RangeDel(start, end);
+  } else if (workload == "rawscan") {
+    string path = options_.db + "rawscan_" + to_string(op);
+    *s = n_->RawScanSaveAll(path, start, end, true);
+  }
+}
+
+void Bench::Worker(const string &workload, Client *c, int64_t ops, KeyChooser *chooser) {
+  nemo::Status s;
+  for (int64_t i = 0; i < ops; i++) {
+    bool read = false;
+    int64_t st = NowMicros();
+    if (Admin(workload)) {
+      AdminOp(workload, c, i, &s);
+    } else if (c->Next() < options_.read) {
+      read = true;
+      Read(workload, c, chooser->Next(c->Next()), &s);
+    } else {
+      uint64_t member = static_cast<uint64_t>(c->Next() * options_.fields);
+      bool with_ttl = options_.ttl_ratio > 0 && c->Next() < options_.ttl_ratio;
+      Write(workload, c, chooser->NextWrite(c->Next()), member, with_ttl, &s);
+    }
+    int64_t used = NowMicros() - st;
+    if (read) {
+      c->read_used.push_back(used);
+    } else {
+      c->write_used.push_back(used);
+    }
+    if (!s.ok() && !s.IsNotFound()) {
+      c->errors++;
+    }
+  }
+}
+
+struct Latency {
+  int64_t count;
+  int64_t p50;
+  int64_t p99;
+  int64_t p999;
+  int64_t max;
+};
+
+static Latency Percentiles(vector<int64_t> *used) {
+  Latency l = {0, 0, 0, 0, 0};
+  sort(used->begin(), used->end());
+  size_t cnt = used->size();
+  if (cnt > 0) {
+    l.count = cnt;
+    l.p50 = (*used)[cnt / 2];
+    l.p99 = (*used)[cnt * 99 / 100];
+    l.p999 = (*used)[cnt * 999 / 1000];
+    l.max = (*used)[cnt - 1];
+  }
+  return l;
+}
+
+void Bench::Report(const string &workload, int threads, int64_t micros, vector<Client *> &clients) {
+  vector<int64_t> reads, writes;
+  int64_t errors = 0;
+  for (size_t i = 0; i < clients.size(); i++) {
+    reads.insert(reads.end(), clients[i]->read_used.begin(), clients[i]->read_used.end());
+    writes.insert(writes.end(), clients[i]->write_used.begin(), clients[i]->write_used.end());
+    errors += clients[i]->errors;
+  }
+  Latency r = Percentiles(&reads);
+  Latency w = Percentiles(&writes);
+  double seconds = micros / 1000000.0;
+  double throughput = (r.count + w.count) / (seconds > 0 ? seconds : 1);
+
+  if (options_.format == "json") {
+    printf ("{\"workload\":\"%s\",\"dist\":\"%s\",\"threads\":%d,\"read_ratio\":%.3f,"
+            "\"ttl_ratio\":%.3f,\"value_size\":%d,\"seconds\":%.3f,\"ops_per_sec\":%.1f,\"errors\":%" PRId64 ","
+            "\"read\":{\"count\":%" PRId64 ",\"p50\":%" PRId64 ",\"p99\":%" PRId64 ",\"p999\":%" PRId64 ",\"max\":%" PRId64 "},"
+            "\"write\":{\"count\":%" PRId64 ",\"p50\":%" PRId64 ",\"p99\":%" PRId64 ",\"p999\":%" PRId64 ",\"max\":%" PRId64 "}}\n",
+            workload.c_str(), options_.dist.c_str(), threads, options_.read, options_.ttl_ratio,
+            options_.value_size, seconds, throughput, errors,
+            r.count, r.p50, r.p99, r.p999, r.max, w.count, w.p50, w.p99, w.p999, w.max);
+  } else {
+    printf ("%-8s %9.0f ops/s %8.2f s, errors %" PRId64 "\n", workload.c_str(), throughput, seconds, errors);
+    if (r.count > 0) {
+      printf ("  read  %9" PRId64 " p50 %6" PRId64 " us p99 %6" PRId64 " us p999 %7" PRId64 " us max %8" PRId64 " us\n",
+              r.count, r.p50, r.p99, r.p999, r.max);
+    }
+    if (w.count > 0) {
+      printf ("  %-5s %9" PRId64 " p50 %6" PRId64 " us p99 %6" PRId64 " us p999 %7" PRId64 " us max %8" PRId64 " us\n",
+              Admin(workload) ? "op" : "write", w.count, w.p50, w.p99, w.p999, w.max);
+    }
+  }
+  fflush(stdout);
+}
+
+int Bench::Run(const string &workload) {
+  if (options_.load) {
+    Load(KeyWorkload(workload));
+  }
+  // the admin ones are single client and have no warmup
+  int threads = Admin(workload) ? 1 : options_.threads;
+  int64_t ops = Admin(workload) ? max<int64_t>(1, options_.ops / 1000) : options_.ops;
+  KeyChooser chooser(options_);
+
+  vector<Client *> clients;
+  for (int t = 0; t < threads; t++) {
+    clients.push_back(new Client(t + 1));
+  }
+  vector<thread> workers;
+  if (!Admin(workload) && options_.warmup > 0) {
+    for (int t = 0; t < threads; t++) {
+      workers.push_back(thread(&Bench::Worker, this, workload, clients[t], options_.warmup, &chooser));
+    }
+    for (int t = 0; t < threads; t++) {
+      workers[t].join();
+    }
+    workers.clear();
+    for (int t = 0; t < threads; t++) {
+      clients[t]->read_used.clear();
+      clients[t]->write_used.clear();
+      clients[t]->errors = 0;
+    }
+  }
+  for (int t = 0; t < threads; t++) {
+    clients[t]->read_used.reserve(ops);
+    clients[t]->write_used.reserve(ops);
+  }
+
+  int64_t st = NowMicros();
+  for (int t = 0; t < threads; t++) {
+    workers.push_back(thread(&Bench::Worker, this, workload, clients[t], ops, &chooser));
+  }
+  for (int t = 0; t < threads; t++) {
+    workers[t].join();
+  }
+  Report(workload, threads, NowMicros() - st, clients);
+
+  for (int t = 0; t < threads; t++) {
+    delete clients[t];
+  }
+  return 0;
+}
+
+static bool ParseArgs(int argc, char **argv, BenchOptions *options) {
+  for (int i = 1; i < argc; i++) {
+    string arg(argv[i]);
+    size_t eq = arg.find('=');
+    if (arg.compare(0, 2, "--") != 0 || eq == string::npos) {
+      return false;
+    }
+    string name = arg.substr(2, eq - 2);
+    string value = arg.substr(eq + 1);
+    if (name == "db") {
+      options->db = value.empty() || value[value.size() - 1] == '/' ? value : value + "/";
+    } else if (name == "workloads") {
+      options->workloads.clear();
+      size_t pos = 0;
+      while (pos <= value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == string::npos) {
+          comma = value.size();
+        }
+        options->workloads.push_back(value.substr(pos, comma - pos));
+        pos = comma + 1;
+      }
+    } else if (name == "threads") {
+      options->threads = atoi(value.c_str());
+    } else if (name == "ops") {
+      options->ops = strtoll(value.c_str(), NULL, 10);
+    } else if (name == "warmup") {
+      options->warmup = strtoll(value.c_str(), NULL, 10);
+    } else if (name == "keys") {
+      options->keys = strtoll(value.c_str(), NULL, 10);
+    } else if (name == "fields") {
+      options->fields = strtoll(value.c_str(), NULL, 10);
+    } else if (name == "load") {
+      options->load = atoi(value.c_str()) != 0;
+    } else if (name == "dist") {
+      options->dist = value;
+    } else if (name == "zipf") {
+      options->zipf = atof(value.c_str());
+    } else if (name == "read") {
+      options->read = atof(value.c_str());
+    } else if (name == "ttl_ratio") {
+      options->ttl_ratio = atof(value.c_str());
+    } else if (name == "ttl") {
+      options->ttl = atoi(value.c_str());
+    } else if (name == "value_size") {
+      options->value_size = atoi(value.c_str());
+    } else if (name == "value_dist") {
+      options->value_dist = value;
+    } else if (name == "range") {
+      options->range = strtoll(value.c_str(), NULL, 10);
+    } else if (name == "format") {
+      options->format = value;
+    } else {
+      return false;
+    }
+  }
+
+  const char *kWorkloads[] = {"kv", "hash", "list", "zset", "set", "bitmap", "hll",
+                              "scan", "volume", "rangedel", "rawscan"};
+  for (size_t i = 0; i < options->workloads.size(); i++) {
+    if (find(kWorkloads, kWorkloads + 11, options->workloads[i]) == kWorkloads + 11) {
+      return false;
+    }
+  }
+  return !options->db.empty() && options->threads > 0 && options->ops > 0
+    && options->warmup >= 0 && options->keys > 0 && options->fields > 0
+    && (options->dist == "uniform" || options->dist == "zipfian" || options->dist == "latest")
+    && options->zipf > 0 && options->zipf < 1
+    && options->read >= 0 && options->read <= 1
+    && options->ttl_ratio >= 0 && options->ttl_ratio <= 1 && options->ttl > 0
+    && options->value_size > 0
+    && (options->value_dist == "fixed" || options->value_dist == "uniform")
+    && options->range > 0
+    && (options->format == "text" || options->format == "json");
+}
+
+int main(int argc, char **argv)
+{
+  BenchOptions options;
+  if (!ParseArgs(argc, argv, &options)) {
+    Usage();
+    log_err("invalid parameter");
+  }
+
+  nemo::Options option;
+  log_info("Prepare DB...");
+  nemo::Nemo* db = new nemo::Nemo(options.db, option);
+  assert(db);
+
+  Bench bench(db, options);
+  for (size_t i = 0; i < options.workloads.size(); i++) {
+    bench.Run(options.workloads[i]);
+  }
+  delete db;
+  return 0;
+}
@@ -10,6 +10,7 @@ void Usage() {
   std::cout << "Usage: " << std::endl;
   std::cout << "./nemock db_path type pattern" << std::endl;
   std::cout << "type is one of: kv, hash, list, zset, set, all" << std::endl;
+  std::cout << "zset also checks the rank index of each set against its members" << std::endl;
   std::cout << "Example: " << std::endl;
   std::cout << "./nemock ./db list \\*" << std::endl;
 }
@@ -0,0 +1 @@
+internal/src/nemo_bg_scheduler.cc
\ No newline at end of file
@@ -0,0 +1 @@
+internal/src/nemo_bit_kernel.cc
\ No newline at end of file
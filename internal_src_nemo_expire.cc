@@ -0,0 +1 @@
+internal/src/nemo_expire.cc
\ No newline at end of file
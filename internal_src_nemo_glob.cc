@@ -0,0 +1 @@
+internal/src/nemo_glob.cc
\ No newline at end of file
@@ -0,0 +1 @@
+internal/src/nemo_metrics.cc
\ No newline at end of file
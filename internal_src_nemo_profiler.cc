@@ -0,0 +1 @@
+internal/src/nemo_profiler.cc
\ No newline at end of file
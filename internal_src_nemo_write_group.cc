@@ -0,0 +1 @@
+internal/src/nemo_write_group.cc
\ No newline at end of file
@@ -0,0 +1 @@
+internal/src/nemo_zset_rank.cc
\ No newline at end of file